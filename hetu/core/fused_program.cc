@@ -0,0 +1,69 @@
+#include "hetu/core/fused_program.h"
+
+namespace hetu {
+
+std::string FusedOpCode2Str(FusedOpCode code) {
+  switch (code) {
+    case FusedOpCode::ADD: return "add";
+    case FusedOpCode::SUB: return "sub";
+    case FusedOpCode::MUL: return "mul";
+    case FusedOpCode::DIV: return "div";
+    case FusedOpCode::ADD_CONST: return "add_const";
+    case FusedOpCode::SUB_CONST: return "sub_const";
+    case FusedOpCode::SUB_FROM_CONST: return "sub_from_const";
+    case FusedOpCode::MUL_CONST: return "mul_const";
+    case FusedOpCode::DIV_CONST: return "div_const";
+    case FusedOpCode::DIV_FROM_CONST: return "div_from_const";
+    case FusedOpCode::POW_CONST: return "pow_const";
+    case FusedOpCode::NEGATE: return "negate";
+    case FusedOpCode::RECIPROCAL: return "reciprocal";
+    case FusedOpCode::EXP: return "exp";
+    case FusedOpCode::LOG: return "log";
+    case FusedOpCode::SQRT: return "sqrt";
+    case FusedOpCode::RSQRT: return "rsqrt";
+    case FusedOpCode::ABS: return "abs";
+    case FusedOpCode::RELU: return "relu";
+    case FusedOpCode::SIGMOID: return "sigmoid";
+    case FusedOpCode::TANH: return "tanh";
+    case FusedOpCode::GELU: return "gelu";
+    case FusedOpCode::DROPOUT: return "dropout";
+    default:
+      HT_VALUE_ERROR << "Unknown fused op code: " << static_cast<int32_t>(code);
+      __builtin_unreachable();
+  }
+}
+
+std::ostream& operator<<(std::ostream& os, FusedOpCode code) {
+  os << FusedOpCode2Str(code);
+  return os;
+}
+
+std::ostream& operator<<(std::ostream& os, const FusedProgram& program) {
+  os << "FusedProgram(num_inputs=" << program.num_inputs << ", instrs=[";
+  for (size_t i = 0; i < program.instrs.size(); i++) {
+    const auto& instr = program.instrs[i];
+    if (i > 0)
+      os << ", ";
+    os << "r" << (program.num_inputs + i) << "=" << instr.code << "(r"
+       << instr.lhs;
+    if (instr.rhs >= 0)
+      os << ", r" << instr.rhs;
+    else if (instr.code >= FusedOpCode::ADD_CONST &&
+             instr.code <= FusedOpCode::POW_CONST)
+      os << ", " << instr.value;
+    else if (instr.code == FusedOpCode::DROPOUT)
+      os << ", p=" << instr.value;
+    os << ")";
+  }
+  os << "], outputs=[";
+  for (size_t i = 0; i < program.outputs.size(); i++) {
+    if (i > 0)
+      os << ", ";
+    os << (program.outputs[i].mask ? "mask(r" : "r") << program.outputs[i].reg
+       << (program.outputs[i].mask ? ")" : "");
+  }
+  os << "])";
+  return os;
+}
+
+} // namespace hetu
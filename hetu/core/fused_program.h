@@ -0,0 +1,96 @@
+#pragma once
+
+#include "hetu/common/macros.h"
+#include <vector>
+
+namespace hetu {
+
+// Elementwise operations that can be evaluated inside a fused group.
+enum class FusedOpCode : int8_t {
+  // binary operations over two registers
+  ADD = 0,
+  SUB,
+  MUL,
+  DIV,
+  // operations with a constant `value`
+  ADD_CONST,
+  SUB_CONST,
+  SUB_FROM_CONST,
+  MUL_CONST,
+  DIV_CONST,
+  DIV_FROM_CONST,
+  POW_CONST,
+  // unary operations
+  NEGATE,
+  RECIPROCAL,
+  EXP,
+  LOG,
+  SQRT,
+  RSQRT,
+  ABS,
+  RELU,
+  SIGMOID,
+  TANH,
+  GELU,
+  // keeps an element with probability 1 - `value`, see DropoutCpu
+  DROPOUT,
+  NUM_FUSED_OP_CODES
+};
+
+std::string FusedOpCode2Str(FusedOpCode code);
+std::ostream& operator<<(std::ostream&, FusedOpCode);
+
+constexpr bool IsBinaryFusedOp(FusedOpCode code) {
+  return code <= FusedOpCode::DIV;
+}
+
+// One step of a fused program. Registers [0, num_inputs) hold the inputs of
+// the group and the i-th instruction writes register num_inputs + i.
+struct FusedInstr {
+  FusedOpCode code;
+  int32_t lhs;
+  int32_t rhs{-1};
+  double value{0};
+
+  bool operator==(const FusedInstr& rhs_) const {
+    return code == rhs_.code && lhs == rhs_.lhs && rhs == rhs_.rhs &&
+      value == rhs_.value;
+  }
+};
+
+// A register written to an output of the group. For a dropout register,
+// `mask` selects its keep mask (of type bool) rather than its value.
+struct FusedOutput {
+  int32_t reg;
+  bool mask{false};
+
+  bool operator==(const FusedOutput& rhs) const {
+    return reg == rhs.reg && mask == rhs.mask;
+  }
+};
+
+struct FusedProgram {
+  int32_t num_inputs{0};
+  std::vector<FusedInstr> instrs;
+  std::vector<FusedOutput> outputs;
+
+  int32_t num_registers() const {
+    return num_inputs + static_cast<int32_t>(instrs.size());
+  }
+
+  size_t num_dropouts() const {
+    size_t ret = 0;
+    for (const auto& instr : instrs)
+      ret += (instr.code == FusedOpCode::DROPOUT);
+    return ret;
+  }
+
+  bool operator==(const FusedProgram& rhs) const {
+    return num_inputs == rhs.num_inputs && instrs == rhs.instrs &&
+      outputs == rhs.outputs;
+  }
+};
+
+std::ostream& operator<<(std::ostream&, const FusedProgram&);
+
+} // namespace hetu
@@ -1196,9 +1196,9 @@ NDArray NDArray::dequantization(const NDArray& input,
   else 
     out = NDArray::empty(input->shape(), input->device(), dqtype, stream_id);
   Stream stream(input->device(), stream_id);
-  HT_DISPATCH_KERNEL_CUDA_ONLY(input->device().type(), __FUNCTION__,
-                               hetu::impl::DeQuantization, input, absmax, code,
-                               out, blocksize, stream);
+  HT_DISPATCH_KERNEL_CPU_AND_CUDA(input->device().type(), __FUNCTION__,
+                                  hetu::impl::DeQuantization, input, absmax, code,
+                                  out, blocksize, stream);
   return out;
 }
 
@@ -1241,10 +1241,10 @@ NDArrayList NDArray::fused_layernorm(const NDArray& input, const NDArray& ln_sca
     : NDArray::empty(normalized_shape, input->device(), input->dtype(),
                      stream_id);
   Stream stream(input->device(), stream_id);
-  HT_DISPATCH_KERNEL_CUDA_ONLY(input->device().type(), __FUNCTION__,
-                               hetu::impl::FusedLayerNorm, input,
-                               ln_scale, ln_bias, savemean, savevar, 
-                               out, normalized_shape.size(), eps, stream);  
+  HT_DISPATCH_KERNEL_CPU_AND_CUDA(input->device().type(), __FUNCTION__,
+                                  hetu::impl::FusedLayerNorm, input,
+                                  ln_scale, ln_bias, savemean, savevar, 
+                                  out, normalized_shape.size(), eps, stream);  
   return {out, savemean, savevar};
 }
 
@@ -1262,10 +1262,10 @@ NDArrayList NDArray::fused_rmsnorm(const NDArray& input, const NDArray& ln_scale
     : NDArray::empty(normalized_shape, input->device(), input->dtype(),
                      stream_id);
   Stream stream(input->device(), stream_id);
-  HT_DISPATCH_KERNEL_CUDA_ONLY(input->device().type(), __FUNCTION__,
-                               hetu::impl::FusedRMSNorm, input,
-                               ln_scale, savevar, 
-                               out, normalized_shape.size(), eps, stream);  
+  HT_DISPATCH_KERNEL_CPU_AND_CUDA(input->device().type(), __FUNCTION__,
+                                  hetu::impl::FusedRMSNorm, input,
+                                  ln_scale, savevar, 
+                                  out, normalized_shape.size(), eps, stream);  
   return {out, savevar};
 }
 
@@ -1524,9 +1524,9 @@ NDArrayList NDArray::quantization(const NDArray& input,
   else 
     out = NDArray::empty(input->shape(), input->device(), qtype, stream_id);
   Stream stream(input->device(), stream_id);
-  HT_DISPATCH_KERNEL_CUDA_ONLY(input->device().type(), __FUNCTION__,
-                               hetu::impl::Quantization, input, absmax_, code,
-                               out, blocksize, stochastic, stream);
+  HT_DISPATCH_KERNEL_CPU_AND_CUDA(input->device().type(), __FUNCTION__,
+                                  hetu::impl::Quantization, input, absmax_, code,
+                                  out, blocksize, stochastic, stream);
   return {absmax_, out};
 }
 
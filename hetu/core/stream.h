@@ -17,6 +17,9 @@ constexpr StreamIndex kCollectiveStream = 6;
 constexpr StreamIndex kSwitchCollectiveStream = 7;
 constexpr StreamIndex kOffloadStream = 8;
 constexpr StreamIndex kBridgeStream = 9;
+// first of the streams used by dataloader workers, up to kCheckpointStream
+constexpr StreamIndex kDataloaderStream = 10;
+constexpr StreamIndex kCheckpointStream = 14;
 constexpr StreamIndex kJoinStream = HT_NUM_STREAMS_PER_DEVICE - 1;
 
 using PackedStreamId = uint16_t;
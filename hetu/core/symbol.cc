@@ -8,9 +8,15 @@ template class Symbol<int64_t>;
 template class SymbolDef<double>;
 template class Symbol<double>;
 
+template <typename T>
+std::atomic<uint64_t> SymbolDef<T>::_leaf_generation{1};
+
 template <typename T>
 T SymbolDef<T>::get_val() const {
   if (_input_1 != nullptr && _input_2 != nullptr) {
+    if (_cached_generation ==
+        _leaf_generation.load(std::memory_order_relaxed))
+      return _cached_val;
     switch (_op) {
       case SymbolOp::ADD: 
         return _input_1->get_val() + _input_2->get_val();
@@ -51,8 +57,10 @@ bool is_SyShape_leaf(const SyShape& sy_shape) {
 
 HTShape get_HTShape_from_SyShape(const SyShape& sy_shape) {
   HTShape shape;
+  shape.reserve(sy_shape.size());
   for (const auto& x : sy_shape) {
-    shape.push_back(std::move(x->get_val()));
+    // avoid copying the shared pointer
+    shape.push_back(x.get()->get_val());
   }
   return shape;
 }
@@ -98,4 +106,105 @@ std::string Symbol<T>::symbol_info() const {
       return os.str(); 
     }
 
+template <typename T>
+int32_t SymbolProgram<T>::Add(const Symbol<T>& symbol) {
+  HT_ASSERT(symbol.is_defined()) << "Cannot add an undefined symbol";
+  return AddNode(symbol.operator->());
+}
+
+template <typename T>
+int32_t SymbolProgram<T>::AddNode(const std::shared_ptr<SymbolDef<T>>& node) {
+  auto it = _node_regs.find(node.get());
+  if (it != _node_regs.end())
+    return it->second;
+  int32_t reg;
+  if (node->_input_1 != nullptr && node->_input_2 != nullptr) {
+    // operands are added before, so registers are in topological order
+    int32_t lhs = AddNode(node->_input_1);
+    int32_t rhs = AddNode(node->_input_2);
+    auto key = std::make_tuple(static_cast<int32_t>(node->_op), lhs, rhs);
+    auto inst_it = _inst_regs.find(key);
+    if (inst_it != _inst_regs.end()) {
+      reg = inst_it->second;
+    } else {
+      reg = _insts.size();
+      _insts.push_back({static_cast<int32_t>(node->_op), lhs, rhs, nullptr});
+      _inst_regs.emplace(key, reg);
+    }
+    _nodes.emplace_back(node, reg);
+  } else if (node->_input_1 == nullptr && node->_input_2 == nullptr && node->_is_leaf) {
+    reg = _insts.size();
+    _insts.push_back({LOAD, -1, -1, node.get()});
+    _leaves.push_back(node);
+  } else {
+    // malformed symbols are never evaluated
+    reg = _insts.size();
+    _insts.push_back({INVALID, -1, -1, nullptr});
+  }
+  _node_regs.emplace(node.get(), reg);
+  _regs.resize(_insts.size());
+  _valid.resize(_insts.size(), 0);
+  return reg;
+}
+
+template <typename T>
+void SymbolProgram<T>::Run() {
+  size_t num_insts = _insts.size();
+  for (size_t i = 0; i < num_insts; i++) {
+    const auto& inst = _insts[i];
+    if (inst.opcode == LOAD) {
+      _valid[i] = inst.leaf->_is_instantiated;
+      _regs[i] = inst.leaf->_val;
+      continue;
+    }
+    if (inst.opcode == INVALID)
+      continue;
+    _valid[i] = _valid[inst.lhs] && _valid[inst.rhs];
+    if (!_valid[i])
+      continue;
+    T lhs = _regs[inst.lhs], rhs = _regs[inst.rhs];
+    switch (static_cast<SymbolOp>(inst.opcode)) {
+      case SymbolOp::ADD:
+        _regs[i] = lhs + rhs;
+        break;
+      case SymbolOp::SUB:
+        _regs[i] = lhs - rhs;
+        break;
+      case SymbolOp::MUL:
+        _regs[i] = lhs * rhs;
+        break;
+      case SymbolOp::DIV:
+        _valid[i] = rhs != 0;
+        if (_valid[i])
+          _regs[i] = lhs / rhs;
+        break;
+      default:
+        // unsupported by get_val() as well
+        _valid[i] = 0;
+    }
+  }
+  uint64_t generation =
+    SymbolDef<T>::_leaf_generation.load(std::memory_order_relaxed);
+  for (auto& node_and_reg : _nodes) {
+    if (!_valid[node_and_reg.second])
+      continue;
+    node_and_reg.first->_cached_val = _regs[node_and_reg.second];
+    node_and_reg.first->_cached_generation = generation;
+  }
+}
+
+template <typename T>
+void SymbolProgram<T>::Clear() {
+  _insts.clear();
+  _regs.clear();
+  _valid.clear();
+  _node_regs.clear();
+  _inst_regs.clear();
+  _nodes.clear();
+  _leaves.clear();
+}
+
+template class SymbolProgram<int64_t>;
+template class SymbolProgram<double>;
+
 } // namespace hetu
@@ -2,8 +2,10 @@
 
 #include "hetu/utils/shared_ptr_wrapper.h"
 #include "hetu/core/ndarray_meta.h"
+#include <atomic>
 #include <vector>
 #include <string>
+#include <unordered_map>
 
 namespace hetu {
 
@@ -15,15 +17,27 @@ enum class SymbolOp {
   REM
 };
 
+template <typename T>
+class SymbolProgram;
+
 template <typename T>
 class SymbolDef : public shared_ptr_target  {
   private:
+    friend class SymbolProgram<T>;
+
     bool _is_leaf = false; // SymbolDef(T _val) is the only way to make it a leaf
     bool _is_instantiated = false; // SymbolDef(T _val) and set_val() are the only two ways to instantiate 
     T _val{};
     SymbolOp _op;
     std::shared_ptr<SymbolDef> _input_1;
     std::shared_ptr<SymbolDef> _input_2;
+    // value of a non-leaf symbol evaluated by a SymbolProgram, which is valid
+    // until any leaf value changes
+    T _cached_val{};
+    uint64_t _cached_generation{0};
+
+    // bumped whenever a leaf value changes
+    static std::atomic<uint64_t> _leaf_generation;
 
   public:
     SymbolDef(): _is_leaf(true) {
@@ -84,8 +98,11 @@ class SymbolDef : public shared_ptr_target  {
 
     void set_val(T val) {
       HT_ASSERT(_is_leaf) << "Only leaf symbol can use set_val() method";
+      if (_is_instantiated && _val == val)
+        return;
       _is_instantiated = true;
       _val = val;
+      _leaf_generation.fetch_add(1, std::memory_order_relaxed);
     }
 
     T get_val() const;
@@ -152,6 +169,79 @@ using DoubleSymbol = Symbol<double>;
 using SyShape = std::vector<IntSymbol>;
 using SyShapeList = std::vector<SyShape>;
 
+// Symbols compiled into a flat register program. Every distinct leaf and
+// every distinct (op, operands) pair gets one register, so subexpressions
+// shared by symbols, or built separately by the same ops, are evaluated
+// once. Run evaluates all registers in a single pass after leaf values are
+// set, and caches the values in the symbols, so that get_val() of them does
+// not walk the trees until a leaf changes. Symbols that fail to evaluate,
+// e.g., with uninstantiated leaves, are left to get_val() to report.
+template <typename T>
+class SymbolProgram {
+ public:
+  // Returns the register of the symbol.
+  int32_t Add(const Symbol<T>& symbol);
+
+  void Add(const std::vector<Symbol<T>>& symbols) {
+    for (const auto& symbol : symbols)
+      if (symbol.is_defined())
+        Add(symbol);
+  }
+
+  void Run();
+
+  T value(int32_t reg) const {
+    HT_ASSERT(_valid[reg]) << "Register " << reg << " is not evaluated";
+    return _regs[reg];
+  }
+
+  size_t num_registers() const {
+    return _insts.size();
+  }
+
+  size_t num_symbols() const {
+    return _node_regs.size();
+  }
+
+  void Clear();
+
+ protected:
+  // LOAD reads the value of a leaf, INVALID stands for a malformed symbol,
+  // and the others are SymbolOp on the registers lhs and rhs
+  struct Instruction {
+    int32_t opcode;
+    int32_t lhs;
+    int32_t rhs;
+    SymbolDef<T>* leaf;
+  };
+
+  static constexpr int32_t LOAD = -1;
+  static constexpr int32_t INVALID = -2;
+
+  struct InstructionHash {
+    size_t operator()(const std::tuple<int32_t, int32_t, int32_t>& key) const {
+      return (static_cast<size_t>(std::get<0>(key)) << 58) ^
+        (static_cast<size_t>(std::get<1>(key)) << 29) ^
+        static_cast<size_t>(std::get<2>(key));
+    }
+  };
+
+  int32_t AddNode(const std::shared_ptr<SymbolDef<T>>& node);
+
+  std::vector<Instruction> _insts;
+  std::vector<T> _regs;
+  std::vector<uint8_t> _valid;
+  std::unordered_map<const SymbolDef<T>*, int32_t> _node_regs;
+  std::unordered_map<std::tuple<int32_t, int32_t, int32_t>, int32_t,
+                     InstructionHash>
+    _inst_regs;
+  // non-leaf symbols to cache values in, held alive with the leaves
+  std::vector<std::pair<std::shared_ptr<SymbolDef<T>>, int32_t>> _nodes;
+  std::vector<std::shared_ptr<SymbolDef<T>>> _leaves;
+};
+
+using IntSymbolProgram = SymbolProgram<int64_t>;
+
 bool is_SyShape_leaf(const SyShape& sy_shape);
 HTShape get_HTShape_from_SyShape(const SyShape& sy_shape);
 void set_HTShape_to_SyShape(const HTShape& ht_shape, SyShape& sy_shape);
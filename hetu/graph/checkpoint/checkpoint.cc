@@ -0,0 +1,816 @@
+#include "hetu/graph/checkpoint/checkpoint.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/utils/json/json.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <unordered_set>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+using json = nlohmann::json;
+
+namespace hetu {
+namespace graph {
+
+namespace {
+
+constexpr char kMetadataKey[] = "__metadata__";
+constexpr char kChecksumKey[] = "hetu.checksum";
+constexpr char kShardsKey[] = "hetu.shards";
+// alignment of O_DIRECT offsets, lengths and buffers
+constexpr size_t kDirectIOAlignment = 4096;
+
+// slicing-by-8 tables of the reflected polynomial 0x82F63B78
+struct Crc32cTables {
+  uint32_t table[8][256];
+
+  Crc32cTables() {
+    for (uint32_t i = 0; i < 256; i++) {
+      uint32_t crc = i;
+      for (int k = 0; k < 8; k++)
+        crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+      table[0][i] = crc;
+    }
+    for (uint32_t i = 0; i < 256; i++)
+      for (int t = 1; t < 8; t++)
+        table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xff];
+  }
+};
+
+uint32_t Crc32cTable(const uint8_t* data, size_t num_bytes, uint32_t crc) {
+  static const Crc32cTables tables;
+  const auto& t = tables.table;
+  for (; num_bytes >= 8; data += 8, num_bytes -= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, 8);
+    word ^= crc;
+    crc = t[7][word & 0xff] ^ t[6][(word >> 8) & 0xff] ^
+      t[5][(word >> 16) & 0xff] ^ t[4][(word >> 24) & 0xff] ^
+      t[3][(word >> 32) & 0xff] ^ t[2][(word >> 40) & 0xff] ^
+      t[1][(word >> 48) & 0xff] ^ t[0][word >> 56];
+  }
+  for (; num_bytes > 0; data++, num_bytes--)
+    crc = (crc >> 8) ^ t[0][(crc ^ *data) & 0xff];
+  return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) uint32_t
+Crc32cSSE42(const uint8_t* data, size_t num_bytes, uint32_t crc) {
+  uint64_t crc64 = crc;
+  for (; num_bytes >= 8; data += 8, num_bytes -= 8) {
+    uint64_t word;
+    std::memcpy(&word, data, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+  crc = static_cast<uint32_t>(crc64);
+  for (; num_bytes > 0; data++, num_bytes--)
+    crc = _mm_crc32_u8(crc, *data);
+  return crc;
+}
+#endif
+
+// A byte range of the file (or of its data section) backed by memory.
+struct Segment {
+  size_t offset;
+  size_t size;
+  const uint8_t* data;
+};
+
+// Calls fn(data, offset, size) for every piece of the segments, which are
+// sorted by offset and back to back, inside [begin, end).
+template <typename Fn>
+void ForEachSegmentPiece(const std::vector<Segment>& segments, size_t begin,
+                         size_t end, Fn&& fn) {
+  auto it = std::upper_bound(
+    segments.begin(), segments.end(), begin,
+    [](size_t pos, const Segment& segment) { return pos < segment.offset; });
+  if (it != segments.begin())
+    it--;
+  for (; it != segments.end() && it->offset < end; it++) {
+    size_t piece_begin = MAX(begin, it->offset);
+    size_t piece_end = MIN(end, it->offset + it->size);
+    if (piece_begin < piece_end)
+      fn(it->data + (piece_begin - it->offset), piece_begin,
+         piece_end - piece_begin);
+  }
+}
+
+std::vector<uint32_t> ChunkedCrc32c(const std::vector<Segment>& segments,
+                                    size_t total_bytes, size_t chunk_bytes) {
+  size_t num_chunks = (total_bytes + chunk_bytes - 1) / chunk_bytes;
+  std::vector<uint32_t> checksums(num_chunks);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic, 1)
+#endif
+  for (size_t c = 0; c < num_chunks; c++) {
+    uint32_t crc = 0;
+    ForEachSegmentPiece(segments, c * chunk_bytes,
+                        MIN((c + 1) * chunk_bytes, total_bytes),
+                        [&](const uint8_t* data, size_t, size_t size) {
+                          crc = Crc32c(data, size, crc);
+                        });
+    checksums[c] = crc;
+  }
+  return checksums;
+}
+
+// Returns 0 on success, or the errno of the failure.
+int PWriteAll(int fd, const uint8_t* data, size_t size, size_t offset) {
+  while (size > 0) {
+    ssize_t written = pwrite(fd, data, size, offset);
+    if (written < 0) {
+      if (errno == EINTR)
+        continue;
+      return errno;
+    }
+    data += written;
+    size -= written;
+    offset += written;
+  }
+  return 0;
+}
+
+// Writes the segments to fd in chunks of `chunk_bytes` in parallel. With
+// `direct_io`, each chunk is gathered into an aligned buffer and padded to
+// the alignment, so the file has to be truncated to `total_bytes` after.
+int WriteChunks(int fd, const std::vector<Segment>& segments,
+                size_t total_bytes, size_t chunk_bytes, bool direct_io) {
+  size_t num_chunks = (total_bytes + chunk_bytes - 1) / chunk_bytes;
+  std::atomic<int> err{0};
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    uint8_t* buffer = nullptr;
+    if (direct_io &&
+        posix_memalign(reinterpret_cast<void**>(&buffer), kDirectIOAlignment,
+                       chunk_bytes) != 0) {
+      buffer = nullptr;
+      err = ENOMEM;
+    }
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 1)
+#endif
+    for (size_t c = 0; c < num_chunks; c++) {
+      if (err != 0)
+        continue;
+      size_t begin = c * chunk_bytes;
+      size_t end = MIN(begin + chunk_bytes, total_bytes);
+      if (direct_io) {
+        ForEachSegmentPiece(segments, begin, end,
+                            [&](const uint8_t* data, size_t offset,
+                                size_t size) {
+                              std::memcpy(buffer + (offset - begin), data,
+                                          size);
+                            });
+        size_t padded = (end - begin + kDirectIOAlignment - 1) /
+          kDirectIOAlignment * kDirectIOAlignment;
+        std::memset(buffer + (end - begin), 0, padded - (end - begin));
+        int ret = PWriteAll(fd, buffer, padded, begin);
+        if (ret != 0)
+          err = ret;
+      } else {
+        ForEachSegmentPiece(segments, begin, end,
+                            [&](const uint8_t* data, size_t offset,
+                                size_t size) {
+                              int ret = PWriteAll(fd, data, size, offset);
+                              if (ret != 0)
+                                err = ret;
+                            });
+      }
+    }
+    free(buffer);
+  }
+  return err;
+}
+
+void WriteSafetensors(const std::string& path, const std::string& header,
+                      const std::vector<Segment>& data_segments,
+                      size_t data_bytes, size_t chunk_bytes, bool direct_io) {
+  // 8 bytes of little-endian header size, followed by the header
+  std::string prefix(8, '\0');
+  uint64_t header_size = header.size();
+  for (int i = 0; i < 8; i++)
+    prefix[i] = static_cast<char>((header_size >> (8 * i)) & 0xff);
+  prefix += header;
+  std::vector<Segment> segments;
+  segments.push_back(
+    {0, prefix.size(), reinterpret_cast<const uint8_t*>(prefix.data())});
+  for (const auto& segment : data_segments)
+    segments.push_back(
+      {prefix.size() + segment.offset, segment.size, segment.data});
+  size_t total_bytes = prefix.size() + data_bytes;
+
+  std::string tmp_path = path + ".tmp";
+  int fd = -1;
+  if (direct_io) {
+    fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_DIRECT, 0644);
+    if (fd < 0) {
+      HT_LOG_WARN << "Failed to open " << tmp_path << " with O_DIRECT ("
+                  << std::strerror(errno) << "), falling back to buffered "
+                  << "writes";
+      direct_io = false;
+    }
+  }
+  if (fd < 0)
+    fd = open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  HT_RUNTIME_ERROR_IF(fd < 0)
+    << "Failed to open " << tmp_path << ": " << std::strerror(errno);
+  int err = WriteChunks(fd, segments, total_bytes, chunk_bytes, direct_io);
+  if (err == 0 && direct_io && ftruncate(fd, total_bytes) != 0)
+    err = errno;
+  if (err == 0 && fsync(fd) != 0)
+    err = errno;
+  close(fd);
+  if (err == 0 && rename(tmp_path.c_str(), path.c_str()) != 0)
+    err = errno;
+  if (err != 0) {
+    unlink(tmp_path.c_str());
+    HT_RUNTIME_ERROR << "Failed to write " << path << ": "
+                     << std::strerror(err);
+  }
+}
+
+bool IsEmptyRegion(const ShardRegion& region) {
+  return NumEl(region.shape) == 0;
+}
+
+bool SameRegion(const ShardRegion& lhs, const ShardRegion& rhs) {
+  return lhs.begin == rhs.begin && lhs.shape == rhs.shape;
+}
+
+ShardRegion Intersect(const ShardRegion& lhs, const ShardRegion& rhs) {
+  ShardRegion ret{HTShape(lhs.begin.size()), HTShape(lhs.begin.size())};
+  for (size_t d = 0; d < lhs.begin.size(); d++) {
+    int64_t begin = MAX(lhs.begin[d], rhs.begin[d]);
+    int64_t end =
+      MIN(lhs.begin[d] + lhs.shape[d], rhs.begin[d] + rhs.shape[d]);
+    ret.begin[d] = begin;
+    ret.shape[d] = MAX(end - begin, 0);
+  }
+  return ret;
+}
+
+// Copies `overlap` of the global tensor from `src` holding `src_region` to
+// `dst` holding `dst_region`. Trailing dimensions covered by all three
+// regions are merged into one run of memcpy.
+void CopyOverlap(const uint8_t* src, const ShardRegion& src_region,
+                 uint8_t* dst, const ShardRegion& dst_region,
+                 const ShardRegion& overlap, size_t elem_bytes) {
+  int64_t ndim = overlap.shape.size();
+  auto src_stride = Shape2Stride(src_region.shape);
+  auto dst_stride = Shape2Stride(dst_region.shape);
+  int64_t run_dim = ndim;
+  size_t run = 1;
+  while (run_dim > 0) {
+    int64_t d = run_dim - 1;
+    run *= overlap.shape[d];
+    run_dim = d;
+    if (overlap.shape[d] != src_region.shape[d] ||
+        overlap.shape[d] != dst_region.shape[d])
+      break;
+  }
+  int64_t num_runs = 1;
+  for (int64_t d = 0; d < run_dim; d++)
+    num_runs *= overlap.shape[d];
+  size_t src_base = 0, dst_base = 0;
+  for (int64_t d = 0; d < ndim; d++) {
+    src_base += (overlap.begin[d] - src_region.begin[d]) * src_stride[d];
+    dst_base += (overlap.begin[d] - dst_region.begin[d]) * dst_stride[d];
+  }
+#ifdef _OPENMP
+#pragma omp parallel for if (num_runs > 1024)
+#endif
+  for (int64_t r = 0; r < num_runs; r++) {
+    size_t src_offset = src_base, dst_offset = dst_base;
+    int64_t rest = r;
+    for (int64_t d = run_dim - 1; d >= 0; d--) {
+      int64_t index = rest % overlap.shape[d];
+      rest /= overlap.shape[d];
+      src_offset += index * src_stride[d];
+      dst_offset += index * dst_stride[d];
+    }
+    std::memcpy(dst + dst_offset * elem_bytes, src + src_offset * elem_bytes,
+                run * elem_bytes);
+  }
+}
+
+} // namespace
+
+uint32_t Crc32c(const void* data, size_t num_bytes, uint32_t crc) {
+  const auto* bytes = reinterpret_cast<const uint8_t*>(data);
+  crc = ~crc;
+#if defined(__x86_64__)
+  static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+  if (has_sse42)
+    return ~Crc32cSSE42(bytes, num_bytes, crc);
+#endif
+  return ~Crc32cTable(bytes, num_bytes, crc);
+}
+
+std::string DataType2SafetensorsDType(DataType dtype) {
+  switch (dtype) {
+    HT_DATA_TYPE_CASE_RETURN(kUInt8, "U8");
+    HT_DATA_TYPE_CASE_RETURN(kInt8, "I8");
+    HT_DATA_TYPE_CASE_RETURN(kInt16, "I16");
+    HT_DATA_TYPE_CASE_RETURN(kInt32, "I32");
+    HT_DATA_TYPE_CASE_RETURN(kInt64, "I64");
+    HT_DATA_TYPE_CASE_RETURN(kFloat16, "F16");
+    HT_DATA_TYPE_CASE_RETURN(kBFloat16, "BF16");
+    HT_DATA_TYPE_CASE_RETURN(kFloat32, "F32");
+    HT_DATA_TYPE_CASE_RETURN(kFloat64, "F64");
+    HT_DATA_TYPE_CASE_RETURN(kBool, "BOOL");
+    default:
+      HT_NOT_IMPLEMENTED << "Data type " << dtype
+                         << " is not supported by safetensors";
+      __builtin_unreachable();
+  }
+}
+
+DataType SafetensorsDType2DataType(const std::string& dtype) {
+  static const std::unordered_map<std::string, DataType> dtypes = {
+    {"U8", kUInt8},     {"I8", kInt8},       {"I16", kInt16},
+    {"I32", kInt32},    {"I64", kInt64},     {"F16", kFloat16},
+    {"BF16", kBFloat16}, {"F32", kFloat32},  {"F64", kFloat64},
+    {"BOOL", kBool}};
+  auto it = dtypes.find(dtype);
+  HT_NOT_IMPLEMENTED_IF(it == dtypes.end())
+    << "Safetensors dtype " << dtype << " is not supported";
+  return it->second;
+}
+
+ShardRegion GetShardRegion(const HTShape& global_shape,
+                           const DistributedStates& ds, int32_t device_index) {
+  ShardRegion region{HTShape(global_shape.size(), 0), global_shape};
+  if (ds.is_none() || ds.get_device_num() == 1)
+    return region;
+  HT_VALUE_ERROR_IF(device_index < 0 || device_index >= ds.get_device_num())
+    << "Invalid device index " << device_index << " of "
+    << ds.get_device_num() << " devices";
+  HT_VALUE_ERROR_IF(ds.get_dim(-2) > 1)
+    << "Partial states have no region of the global tensor: "
+    << ds.ds_info();
+  auto state_index = ds.map_device_to_state_index(device_index);
+  for (const auto& kv : ds.get_states()) {
+    int32_t dim = kv.first, splits = kv.second;
+    if (dim < 0 || splits == 1)
+      continue;
+    HT_VALUE_ERROR_IF(dim >= static_cast<int32_t>(global_shape.size()) ||
+                      global_shape[dim] % splits != 0)
+      << "Cannot split dimension " << dim << " of " << global_shape
+      << " into " << splits << " shards";
+    region.shape[dim] = global_shape[dim] / splits;
+    region.begin[dim] = state_index[dim] * region.shape[dim];
+  }
+  return region;
+}
+
+/******************************************************
+ * CheckpointWriter
+ ******************************************************/
+
+CheckpointWriter::CheckpointWriter(size_t chunk_bytes, bool direct_io,
+                                   size_t max_host_bytes)
+: _chunk_bytes(chunk_bytes),
+  _direct_io(direct_io),
+  _max_host_bytes(max_host_bytes),
+  _host_budget(std::make_shared<HostBudget>()) {
+  HT_VALUE_ERROR_IF(_chunk_bytes == 0) << "Chunk size must be positive";
+  // O_DIRECT writes whole blocks
+  if (_direct_io)
+    _chunk_bytes = (_chunk_bytes + kDirectIOAlignment - 1) /
+      kDirectIOAlignment * kDirectIOAlignment;
+}
+
+CheckpointWriter::~CheckpointWriter() {
+  for (auto& future : _pending) {
+    try {
+      future.get();
+    } catch (const std::exception& e) {
+      HT_LOG_ERROR << "Checkpoint failed: " << e.what();
+    }
+  }
+}
+
+void CheckpointWriter::ReserveHostBytes(size_t num_bytes) {
+  std::unique_lock<std::mutex> lock(_host_budget->mutex);
+  // a save larger than the budget goes alone
+  if (_max_host_bytes > 0)
+    _host_budget->cv.wait(lock, [&]() {
+      return _host_budget->in_flight == 0 ||
+        _host_budget->in_flight + num_bytes <= _max_host_bytes;
+    });
+  _host_budget->in_flight += num_bytes;
+  _reserved_host_bytes += num_bytes;
+}
+
+void CheckpointWriter::ReleaseHostBytes() {
+  {
+    std::lock_guard<std::mutex> lock(_host_budget->mutex);
+    _host_budget->in_flight -= std::exchange(_reserved_host_bytes, 0);
+  }
+  _host_budget->cv.notify_all();
+}
+
+size_t CheckpointWriter::host_bytes_in_flight() const {
+  std::lock_guard<std::mutex> lock(_host_budget->mutex);
+  return _host_budget->in_flight;
+}
+
+std::shared_future<void>
+CheckpointWriter::Save(const std::string& path,
+                       const std::vector<CheckpointTensor>& tensors,
+                       const std::map<std::string, std::string>& metadata) {
+  size_t num_bytes = 0;
+  for (const auto& tensor : tensors) {
+    HT_VALUE_ERROR_IF(!tensor.data.is_defined())
+      << "Tensor " << tensor.name << " is undefined";
+    num_bytes += tensor.data->numel() * DataType2Size(tensor.data->dtype());
+  }
+  ReserveHostBytes(num_bytes);
+  // snapshot on the caller, so the tensors are free to change once we return
+  std::vector<CheckpointTensor> snapshots;
+  snapshots.reserve(tensors.size());
+  try {
+    for (const auto& tensor : tensors) {
+      const auto& data = tensor.data;
+      auto snapshot = NDArray::empty(data->shape(), Device(kCPU),
+                                     data->dtype(), kBlockingStream);
+      NDArray::copy(data, kBlockingStream, snapshot);
+      if (!data->device().is_cpu())
+        Stream(data->device(), kBlockingStream).Sync();
+      snapshots.push_back(
+        {tensor.name, snapshot, tensor.ds, tensor.device_index});
+    }
+  } catch (...) {
+    ReleaseHostBytes();
+    throw;
+  }
+  return SaveSnapshot(path, snapshots, metadata);
+}
+
+std::shared_future<void>
+CheckpointWriter::SaveSnapshot(const std::string& path,
+                               const std::vector<CheckpointTensor>& tensors,
+                               const std::map<std::string, std::string>& metadata,
+                               std::function<void()> ready) {
+  // the reservation goes with this save whatever happens
+  auto reserved_bytes = std::exchange(_reserved_host_bytes, 0);
+  auto release = [budget = _host_budget, reserved_bytes]() {
+    {
+      std::lock_guard<std::mutex> lock(budget->mutex);
+      budget->in_flight -= reserved_bytes;
+    }
+    budget->cv.notify_all();
+  };
+  auto snapshots = std::make_shared<NDArrayList>();
+  std::unordered_set<std::string> names;
+  json header = json::object();
+  json shards = json::object();
+  size_t data_bytes = 0;
+  std::vector<Segment> segments;
+  try {
+    // tensors of larger elements go first, so that every tensor is aligned
+    // to its element size in the 8-byte aligned data section
+    std::vector<const CheckpointTensor*> order;
+    for (const auto& tensor : tensors) {
+      HT_VALUE_ERROR_IF(!tensor.data.is_defined() ||
+                        !tensor.data->device().is_cpu() ||
+                        !tensor.data->is_contiguous())
+        << "Snapshot of " << tensor.name
+        << " should be a contiguous host array";
+      order.push_back(&tensor);
+    }
+    std::stable_sort(
+      order.begin(), order.end(),
+      [](const CheckpointTensor* lhs, const CheckpointTensor* rhs) {
+        return DataType2Size(lhs->data->dtype()) >
+          DataType2Size(rhs->data->dtype());
+      });
+    for (const auto* tensor_ptr : order) {
+      const auto& tensor = *tensor_ptr;
+      HT_VALUE_ERROR_IF(tensor.name == kMetadataKey ||
+                        !names.insert(tensor.name).second)
+        << "Invalid or duplicated tensor name " << tensor.name;
+      const auto& data = tensor.data;
+      size_t num_bytes = data->numel() * DataType2Size(data->dtype());
+      header[tensor.name] = {
+        {"dtype", DataType2SafetensorsDType(data->dtype())},
+        {"shape", data->shape()},
+        {"data_offsets", {data_bytes, data_bytes + num_bytes}}};
+      if (tensor.ds.is_valid() && tensor.ds.get_device_num() > 1) {
+        HTShape global_shape = data->shape();
+        for (size_t d = 0; d < global_shape.size(); d++)
+          global_shape[d] *= tensor.ds.get_dim(d);
+        auto region =
+          GetShardRegion(global_shape, tensor.ds, tensor.device_index);
+        shards[tensor.name] = {{"global_shape", global_shape},
+                               {"begin", region.begin}};
+      }
+      if (num_bytes > 0)
+        segments.push_back(
+          {data_bytes, num_bytes,
+           reinterpret_cast<const uint8_t*>(data->raw_data_ptr())});
+      data_bytes += num_bytes;
+      snapshots->push_back(data);
+    }
+  } catch (...) {
+    release();
+    throw;
+  }
+  json header_metadata(metadata);
+  if (!shards.empty())
+    header_metadata[kShardsKey] = shards.dump();
+
+  // forget the saves that succeeded, and keep errors for Wait
+  _pending.erase(
+    std::remove_if(_pending.begin(), _pending.end(),
+                   [](const std::shared_future<void>& future) {
+                     if (future.wait_for(std::chrono::seconds(0)) !=
+                         std::future_status::ready)
+                       return false;
+                     try {
+                       future.get();
+                       return true;
+                     } catch (...) {
+                       return false;
+                     }
+                   }),
+    _pending.end());
+  auto chunk_bytes = _chunk_bytes;
+  auto direct_io = _direct_io;
+  auto future =
+    hetu::impl::GetCPUStream(kCheckpointStream)
+      .EnqueueTask(
+        [=]() mutable {
+          // release the snapshot and the reservation however the task ends
+          std::shared_ptr<void> guard(nullptr, [&](void*) {
+            snapshots->clear();
+            release();
+          });
+          if (ready)
+            ready();
+          auto checksums = ChunkedCrc32c(segments, data_bytes, chunk_bytes);
+          header_metadata[kChecksumKey] =
+            json({{"algorithm", "crc32c"},
+                  {"chunk_bytes", chunk_bytes},
+                  {"values", checksums}})
+              .dump();
+          header[kMetadataKey] = header_metadata;
+          auto header_str = header.dump();
+          // the data section is 8-byte aligned
+          header_str.append((8 - header_str.size() % 8) % 8, ' ');
+          WriteSafetensors(path, header_str, segments, data_bytes,
+                           chunk_bytes, direct_io);
+        },
+        "CheckpointSave")
+      .share();
+  _pending.push_back(future);
+  return future;
+}
+
+void CheckpointWriter::Wait() {
+  auto pending = std::move(_pending);
+  _pending.clear();
+  std::exception_ptr error;
+  for (auto& future : pending) {
+    try {
+      future.get();
+    } catch (...) {
+      if (!error)
+        error = std::current_exception();
+    }
+  }
+  if (error)
+    std::rethrow_exception(error);
+}
+
+/******************************************************
+ * SafetensorsFile
+ ******************************************************/
+
+SafetensorsFile::SafetensorsFile(const std::string& path)
+: _mapping(std::make_shared<MmapShard>(path)) {
+  uint64_t header_size = 0;
+  HT_VALUE_ERROR_IF(_mapping->size() < 8)
+    << "File " << path << " is too small for safetensors";
+  for (int i = 0; i < 8; i++)
+    header_size |= static_cast<uint64_t>(_mapping->data()[i]) << (8 * i);
+  HT_VALUE_ERROR_IF(header_size > _mapping->size() - 8)
+    << "Invalid header size " << header_size << " of " << path;
+  _data_offset = 8 + header_size;
+  size_t data_bytes = _mapping->size() - _data_offset;
+  json header;
+  try {
+    header = json::parse(_mapping->data() + 8, _mapping->data() + _data_offset);
+  } catch (const json::exception& e) {
+    HT_VALUE_ERROR << "Invalid header of " << path << ": " << e.what();
+  }
+  for (const auto& item : header.items()) {
+    if (item.key() == kMetadataKey) {
+      for (const auto& kv : item.value().items())
+        _metadata[kv.key()] = kv.value().get<std::string>();
+      continue;
+    }
+    Entry entry;
+    entry.dtype = SafetensorsDType2DataType(item.value().at("dtype"));
+    HTShape shape = item.value().at("shape").get<HTShape>();
+    auto offsets = item.value().at("data_offsets").get<std::vector<size_t>>();
+    HT_VALUE_ERROR_IF(offsets.size() != 2 || offsets[0] > offsets[1] ||
+                      offsets[1] > data_bytes ||
+                      offsets[1] - offsets[0] !=
+                        NumEl(shape) * DataType2Size(entry.dtype))
+      << "Invalid data offsets of " << item.key() << " in " << path;
+    entry.begin = offsets[0];
+    entry.end = offsets[1];
+    entry.global_shape = shape;
+    entry.region = {HTShape(shape.size(), 0), shape};
+    _names.push_back(item.key());
+    _entries.emplace(item.key(), std::move(entry));
+  }
+  auto it = _metadata.find(kShardsKey);
+  if (it != _metadata.end()) {
+    auto shards = json::parse(it->second);
+    for (const auto& item : shards.items()) {
+      auto& entry = _entries.at(item.key());
+      entry.global_shape = item.value().at("global_shape").get<HTShape>();
+      entry.region.begin = item.value().at("begin").get<HTShape>();
+      HT_VALUE_ERROR_IF(entry.global_shape.size() != entry.region.shape.size())
+        << "Mismatched global shape of " << item.key() << " in " << path;
+    }
+  }
+}
+
+const SafetensorsFile::Entry&
+SafetensorsFile::entry(const std::string& name) const {
+  auto it = _entries.find(name);
+  HT_VALUE_ERROR_IF(it == _entries.end())
+    << "Tensor " << name << " is not in " << path();
+  return it->second;
+}
+
+NDArray SafetensorsFile::Get(const std::string& name) const {
+  const auto& e = entry(name);
+  if (e.begin == e.end)
+    return NDArray::empty(e.region.shape, Device(kCPU), e.dtype,
+                          kBlockingStream);
+  auto meta = NDArrayMeta()
+                .set_dtype(e.dtype)
+                .set_shape(e.region.shape)
+                .set_device(Device(kCPU));
+  uint8_t* ptr = _mapping->data() + _data_offset + e.begin;
+  // files of other writers may leave tensors unaligned
+  if (reinterpret_cast<uintptr_t>(ptr) % DataType2Size(e.dtype) != 0) {
+    auto ret = NDArray::empty(e.region.shape, Device(kCPU), e.dtype,
+                              kBlockingStream);
+    std::memcpy(ret->raw_data_ptr(), ptr, e.end - e.begin);
+    return ret;
+  }
+  auto mapping = _mapping;
+  // the deleter holds the mapping as long as the array is alive
+  auto storage = std::make_shared<NDArrayStorage>(BorrowToMemoryPool(
+    Device(kCPU), ptr, e.end - e.begin, [mapping](DataPtr) {}));
+  return NDArray(meta, storage);
+}
+
+const HTShape& SafetensorsFile::global_shape(const std::string& name) const {
+  return entry(name).global_shape;
+}
+
+const ShardRegion& SafetensorsFile::region(const std::string& name) const {
+  return entry(name).region;
+}
+
+bool SafetensorsFile::Verify() const {
+  auto it = _metadata.find(kChecksumKey);
+  if (it == _metadata.end())
+    return true;
+  auto checksum = json::parse(it->second);
+  HT_NOT_IMPLEMENTED_IF(checksum.at("algorithm") != "crc32c")
+    << "Checksum " << checksum.at("algorithm") << " is not supported";
+  size_t chunk_bytes = checksum.at("chunk_bytes");
+  auto expected = checksum.at("values").get<std::vector<uint32_t>>();
+  size_t data_bytes = _mapping->size() - _data_offset;
+  std::vector<Segment> segments;
+  if (data_bytes > 0)
+    segments.push_back({0, data_bytes, _mapping->data() + _data_offset});
+  return ChunkedCrc32c(segments, data_bytes, chunk_bytes) == expected;
+}
+
+/******************************************************
+ * CheckpointReader
+ ******************************************************/
+
+CheckpointReader::CheckpointReader(const std::vector<std::string>& paths) {
+  for (const auto& path : paths) {
+    auto file = std::make_shared<SafetensorsFile>(path);
+    for (const auto& name : file->names()) {
+      auto& shards = _shards[name];
+      if (!shards.empty()) {
+        HT_VALUE_ERROR_IF(file->global_shape(name) !=
+                          shards.front()->global_shape(name))
+          << "Tensor " << name << " has shape " << file->global_shape(name)
+          << " in " << path << " but "
+          << shards.front()->global_shape(name) << " in "
+          << shards.front()->path();
+        HT_VALUE_ERROR_IF(file->Get(name)->dtype() !=
+                          shards.front()->Get(name)->dtype())
+          << "Tensor " << name << " has different dtypes in " << path
+          << " and " << shards.front()->path();
+      }
+      shards.push_back(file);
+    }
+    _files.push_back(std::move(file));
+  }
+}
+
+std::vector<std::string> CheckpointReader::names() const {
+  std::vector<std::string> ret;
+  ret.reserve(_shards.size());
+  for (const auto& kv : _shards)
+    ret.push_back(kv.first);
+  std::sort(ret.begin(), ret.end());
+  return ret;
+}
+
+const HTShape& CheckpointReader::global_shape(const std::string& name) const {
+  auto it = _shards.find(name);
+  HT_VALUE_ERROR_IF(it == _shards.end())
+    << "Tensor " << name << " is not in the checkpoint";
+  return it->second.front()->global_shape(name);
+}
+
+DataType CheckpointReader::dtype(const std::string& name) const {
+  auto it = _shards.find(name);
+  HT_VALUE_ERROR_IF(it == _shards.end())
+    << "Tensor " << name << " is not in the checkpoint";
+  return it->second.front()->Get(name)->dtype();
+}
+
+NDArray CheckpointReader::Load(const std::string& name) const {
+  const auto& shape = global_shape(name);
+  return LoadRegion(name, {HTShape(shape.size(), 0), shape});
+}
+
+NDArray CheckpointReader::Load(const std::string& name,
+                               const DistributedStates& ds,
+                               int32_t device_index) const {
+  return LoadRegion(name,
+                    GetShardRegion(global_shape(name), ds, device_index));
+}
+
+NDArray CheckpointReader::LoadRegion(const std::string& name,
+                                     const ShardRegion& region) const {
+  auto it = _shards.find(name);
+  HT_VALUE_ERROR_IF(it == _shards.end())
+    << "Tensor " << name << " is not in the checkpoint";
+  const auto& shards = it->second;
+  for (const auto& file : shards)
+    if (SameRegion(file->region(name), region))
+      return file->Get(name);
+
+  auto ret = NDArray::empty(region.shape, Device(kCPU), dtype(name),
+                            kBlockingStream);
+  auto* dst = reinterpret_cast<uint8_t*>(ret->raw_data_ptr());
+  size_t elem_bytes = DataType2Size(ret->dtype());
+  // duplicated shards of the same region are copied once
+  std::vector<ShardRegion> copied;
+  int64_t num_copied = 0;
+  for (const auto& file : shards) {
+    const auto& src_region = file->region(name);
+    auto overlap = Intersect(src_region, region);
+    if (IsEmptyRegion(overlap) ||
+        std::any_of(copied.begin(), copied.end(),
+                    [&](const ShardRegion& other) {
+                      return SameRegion(other, src_region);
+                    }))
+      continue;
+    auto src = file->Get(name);
+    CopyOverlap(reinterpret_cast<const uint8_t*>(src->raw_data_ptr()),
+                src_region, dst, region, overlap, elem_bytes);
+    copied.push_back(src_region);
+    num_copied += NumEl(overlap.shape);
+  }
+  HT_VALUE_ERROR_IF(num_copied != NumEl(region.shape))
+    << "Shards of " << name << " cover " << num_copied << " of "
+    << NumEl(region.shape) << " elements of the region";
+  return ret;
+}
+
+bool CheckpointReader::Verify() const {
+  for (const auto& file : _files)
+    if (!file->Verify())
+      return false;
+  return true;
+}
+
+} // namespace graph
+} // namespace hetu
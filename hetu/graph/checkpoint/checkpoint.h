@@ -0,0 +1,213 @@
+#pragma once
+
+#include "hetu/core/ndarray.h"
+#include "hetu/graph/distributed_states.h"
+#include "hetu/graph/data/mmap_dataloader.h"
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <map>
+#include <mutex>
+
+namespace hetu {
+namespace graph {
+
+class CheckpointWriter;
+class SafetensorsFile;
+class CheckpointReader;
+
+// CRC-32C of `num_bytes` bytes, continuing from `crc`.
+uint32_t Crc32c(const void* data, size_t num_bytes, uint32_t crc = 0);
+
+std::string DataType2SafetensorsDType(DataType dtype);
+
+DataType SafetensorsDType2DataType(const std::string& dtype);
+
+// The part of a global tensor held by one device: `shape` elements from
+// `begin` along every dimension.
+struct ShardRegion {
+  HTShape begin;
+  HTShape shape;
+};
+
+// The region held by the `device_index`-th device of `ds`. Tensors with
+// invalid (i.e., none) states are not sharded.
+ShardRegion GetShardRegion(const HTShape& global_shape,
+                           const DistributedStates& ds, int32_t device_index);
+
+// A tensor to save. If `ds` is valid, `data` is the local shard of the
+// `device_index`-th device, and the region is recorded so that readers can
+// reshard it.
+struct CheckpointTensor {
+  std::string name;
+  NDArray data;
+  DistributedStates ds;
+  int32_t device_index{0};
+};
+
+// Writes safetensors files in the background. Save takes a host snapshot of
+// the tensors before it returns, so training may go on updating them while
+// the file is written on kCheckpointStream. The data is written in chunks of
+// `chunk_bytes` by parallel pwrite calls, directly from the snapshot, or
+// through aligned buffers with O_DIRECT if `direct_io` is set. Every chunk
+// of the data is checksummed. Files are written to a temporary name and
+// renamed once complete. If `max_host_bytes` is non-zero, snapshots of the
+// pending saves hold at most that many bytes (or one save of any size), and
+// new saves wait for earlier ones to free their snapshots.
+class CheckpointWriter {
+ public:
+  CheckpointWriter(size_t chunk_bytes = 64 << 20, bool direct_io = false,
+                   size_t max_host_bytes = 0);
+
+  ~CheckpointWriter();
+
+  CheckpointWriter(const CheckpointWriter&) = delete;
+  CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+  // Pending computation on `tensors` should be done before the call.
+  std::shared_future<void>
+  Save(const std::string& path, const std::vector<CheckpointTensor>& tensors,
+       const std::map<std::string, std::string>& metadata = {});
+
+  // Blocks until `num_bytes` more of snapshots fit in the budget, and
+  // reserves them for the next SaveSnapshot.
+  void ReserveHostBytes(size_t num_bytes);
+
+  // Gives back the bytes reserved for the next SaveSnapshot, when the caller
+  // fails to take the snapshots.
+  void ReleaseHostBytes();
+
+  // Saves contiguous host arrays taken as snapshots by the caller, which
+  // should reserve their bytes in advance. They are written once `ready`
+  // returns, e.g., after the asynchronous copies filling them are done, and
+  // are not referenced by the writer after that.
+  std::shared_future<void>
+  SaveSnapshot(const std::string& path,
+               const std::vector<CheckpointTensor>& tensors,
+               const std::map<std::string, std::string>& metadata = {},
+               std::function<void()> ready = {});
+
+  // Waits for all saves and rethrows the first error.
+  void Wait();
+
+  size_t chunk_bytes() const {
+    return _chunk_bytes;
+  }
+
+  bool direct_io() const {
+    return _direct_io;
+  }
+
+  size_t max_host_bytes() const {
+    return _max_host_bytes;
+  }
+
+  size_t host_bytes_in_flight() const;
+
+ protected:
+  // bytes of snapshots held by pending saves, shared with their tasks
+  struct HostBudget {
+    std::mutex mutex;
+    std::condition_variable cv;
+    size_t in_flight{0};
+  };
+
+  size_t _chunk_bytes;
+  bool _direct_io;
+  size_t _max_host_bytes;
+  std::shared_ptr<HostBudget> _host_budget;
+  size_t _reserved_host_bytes{0};
+  std::vector<std::shared_future<void>> _pending;
+};
+
+// A memory-mapped safetensors file. Tensors are views of the mapping in the
+// CPU memory pool, whose copy-on-write pages leave the file untouched.
+class SafetensorsFile {
+ public:
+  SafetensorsFile(const std::string& path);
+
+  const std::string& path() const {
+    return _mapping->path();
+  }
+
+  const std::vector<std::string>& names() const {
+    return _names;
+  }
+
+  bool has(const std::string& name) const {
+    return _entries.find(name) != _entries.end();
+  }
+
+  const std::map<std::string, std::string>& metadata() const {
+    return _metadata;
+  }
+
+  NDArray Get(const std::string& name) const;
+
+  // The global shape and the region of `name` if it is a shard, or its own
+  // shape and the whole of it otherwise.
+  const HTShape& global_shape(const std::string& name) const;
+  const ShardRegion& region(const std::string& name) const;
+
+  // Checks the chunked checksums written by CheckpointWriter. Files of other
+  // writers have nothing to check.
+  bool Verify() const;
+
+ protected:
+  struct Entry {
+    DataType dtype;
+    size_t begin;
+    size_t end;
+    HTShape global_shape;
+    ShardRegion region;
+  };
+
+  const Entry& entry(const std::string& name) const;
+
+  std::shared_ptr<MmapShard> _mapping;
+  size_t _data_offset;
+  std::vector<std::string> _names;
+  std::unordered_map<std::string, Entry> _entries;
+  std::map<std::string, std::string> _metadata;
+};
+
+// Reads tensors from the files saved by all devices, and reshards them to
+// the states asked for.
+class CheckpointReader {
+ public:
+  CheckpointReader(const std::vector<std::string>& paths);
+
+  bool has(const std::string& name) const {
+    return _shards.find(name) != _shards.end();
+  }
+
+  // Names of the tensors in any of the files, sorted.
+  std::vector<std::string> names() const;
+
+  const HTShape& global_shape(const std::string& name) const;
+
+  DataType dtype(const std::string& name) const;
+
+  // The whole tensor.
+  NDArray Load(const std::string& name) const;
+
+  // The shard of the `device_index`-th device of `ds`. A saved shard of the
+  // same region is returned without copying, otherwise the region is
+  // gathered from the saved shards overlapping it.
+  NDArray Load(const std::string& name, const DistributedStates& ds,
+               int32_t device_index) const;
+
+  // Checks all files, see SafetensorsFile::Verify.
+  bool Verify() const;
+
+ protected:
+  NDArray LoadRegion(const std::string& name, const ShardRegion& region) const;
+
+  std::vector<std::shared_ptr<SafetensorsFile>> _files;
+  // files holding a shard of each tensor
+  std::unordered_map<std::string, std::vector<std::shared_ptr<SafetensorsFile>>>
+    _shards;
+};
+
+} // namespace graph
+} // namespace hetu
@@ -25,7 +25,7 @@ void Dataloader::init_states() {
     _data = reshape_tensor(start, ending);
   }
   _samples_num = _data->shape(0);
-  _queue_size = 3;
+  HT_ASSERT(_queue_size > 0) << "Invalid queue size " << _queue_size << ".";
   _batch_size = std::min(_batch_size, _samples_num / _queue_size);
   HT_ASSERT(_batch_size > 0) << "Invalid batch size.";
   _batch_num = _drop_last ? (_samples_num / _batch_size)
@@ -48,7 +48,7 @@ void Dataloader::init_states() {
     shuffled.resize(_batch_num);
     std::iota(shuffled.begin(), shuffled.end(), 0);
     std::random_shuffle(shuffled.begin(), shuffled.end());
-    HT_LOG_INFO << shuffled;
+    HT_LOG_TRACE << "Shuffled batches of " << _name << ": " << shuffled;
   }
   for (int i = 0; i < _queue_size; ++i) {
     int next_idx = _index + _batch_size;
@@ -93,9 +93,7 @@ NDArray Dataloader::_get_arr(int batch_idx) {
   }
   int cur_index = _index;
   int next_index = _index + _batch_size;
-  HT_LOG_INFO << _shuffle;
   if (_shuffle) {
-    HT_LOG_INFO << shuffled[batch_idx];
     cur_index = _batch_size * shuffled[(batch_idx + _queue_size) % _batch_num];
     next_index = _batch_size * (shuffled[(batch_idx + _queue_size) % _batch_num] + 1);
   }
@@ -103,7 +101,9 @@ NDArray Dataloader::_get_arr(int batch_idx) {
   _arr_map[_max_key] = temp_id;
   NDArray res = _arrs[_arr_map[batch_idx]];
   hetu::impl::CPUStream cpu_stream(instantiation_ctx().stream());
-  HT_LOG_INFO << temp_id << " " <<  batch_idx <<" "<< cur_index << " " << next_index << " " << res;
+  HT_LOG_TRACE << "Dataloader " << _name << " returns batch " << batch_idx
+               << " from slot " << temp_id << " and preloads samples "
+               << cur_index << " to " << next_index;
   processers[temp_id] = cpu_stream.EnqueueTask(
   [this, cur_index, next_index, temp_id]() {
     this->pre_load(cur_index, next_index, temp_id);
@@ -20,13 +20,14 @@ class Dataloader{
   Dataloader() = default;
   Dataloader(NDArray raw_data, int batch_size, int num_workers = 0,
              DataloaderName name = "default", bool shuffle = false,
-             bool drop_last = true):
+             bool drop_last = true, int queue_size = 3):
   _data(std::move(raw_data)),
   _num_workers(num_workers),
   _batch_size(batch_size),
   _name(name),
   _shuffle(shuffle),
   _drop_last(drop_last),
+  _queue_size(queue_size),
   _dp_rank(-1),
   _dp_nrank(-1) {
     init_states();
@@ -86,6 +87,7 @@ class Dataloader{
     _name = resource._name;
     _shuffle = resource._shuffle;
     _drop_last = resource._drop_last;
+    _queue_size = resource._queue_size;
     _dp_rank = -1;
     _dp_nrank = -1;
     init_states();
@@ -98,9 +100,11 @@ class Dataloader{
     _name = resource._name;
     _shuffle = resource._shuffle;
     _drop_last = resource._drop_last;
+    _queue_size = resource._queue_size;
     _dp_rank = -1;
     _dp_nrank = -1;
     init_states();
+    return *this;
   }
 
   void init_states();
@@ -137,6 +141,10 @@ class Dataloader{
     return _num_workers;
   }
 
+  int queue_size() const {
+    return _queue_size;
+  }
+
   DataType dtype() const {
     return _data->dtype();
   }
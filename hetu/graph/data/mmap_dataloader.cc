@@ -0,0 +1,241 @@
+#include "hetu/graph/data/mmap_dataloader.h"
+#include "hetu/graph/ops/variable.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <numeric>
+#include <random>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace hetu {
+namespace graph {
+
+MmapShard::MmapShard(const std::string& path) : _path(path) {
+  int fd = open(path.c_str(), O_RDONLY);
+  HT_RUNTIME_ERROR_IF(fd < 0)
+    << "Failed to open " << path << ": " << std::strerror(errno);
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    HT_RUNTIME_ERROR << "Failed to stat " << path << ": "
+                     << std::strerror(errno);
+  }
+  _size = st.st_size;
+  if (_size > 0) {
+    void* ptr =
+      mmap(nullptr, _size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (ptr == MAP_FAILED) {
+      close(fd);
+      HT_RUNTIME_ERROR << "Failed to mmap " << path << ": "
+                       << std::strerror(errno);
+    }
+    _data = reinterpret_cast<uint8_t*>(ptr);
+    madvise(_data, _size, MADV_SEQUENTIAL);
+  }
+  // the mapping stays valid after the descriptor is closed
+  close(fd);
+}
+
+MmapShard::~MmapShard() {
+  if (_data != nullptr)
+    munmap(_data, _size);
+}
+
+void MmapShard::Prefetch(size_t offset, size_t num_bytes) const {
+  if (num_bytes == 0)
+    return;
+  static const size_t page_size = sysconf(_SC_PAGESIZE);
+  size_t begin = offset / page_size * page_size;
+  size_t end = MIN(offset + num_bytes, _size);
+  madvise(_data + begin, end - begin, MADV_WILLNEED);
+  volatile uint8_t sink = 0;
+  for (size_t pos = begin; pos < end; pos += page_size)
+    sink ^= _data[pos];
+  (void) sink;
+}
+
+MmapDataset::MmapDataset(const std::vector<std::string>& paths,
+                         HTShape sample_shape, DataType dtype)
+: _sample_shape(std::move(sample_shape)), _dtype(dtype) {
+  HT_VALUE_ERROR_IF(paths.empty()) << "No shards are provided";
+  _sample_bytes = NumEl(_sample_shape) * DataType2Size(_dtype);
+  HT_VALUE_ERROR_IF(_sample_bytes == 0)
+    << "Invalid sample shape " << _sample_shape;
+  _shard_begin.push_back(0);
+  for (const auto& path : paths) {
+    auto shard = std::make_shared<MmapShard>(path);
+    HT_VALUE_ERROR_IF(shard->size() % _sample_bytes != 0)
+      << "Shard " << path << " of " << shard->size()
+      << " bytes does not hold whole samples of " << _sample_bytes
+      << " bytes";
+    _shard_begin.push_back(_shard_begin.back() +
+                           shard->size() / _sample_bytes);
+    _shards.push_back(std::move(shard));
+  }
+}
+
+size_t MmapDataset::ShardOf(int64_t sample) const {
+  return std::upper_bound(_shard_begin.begin(), _shard_begin.end(), sample) -
+    _shard_begin.begin() - 1;
+}
+
+template <typename Func>
+void MmapDataset::ForEachPiece(int64_t begin, int64_t end, Func&& fn) const {
+  HT_VALUE_ERROR_IF(begin < 0 || begin > end || end > num_samples())
+    << "Invalid samples [" << begin << ", " << end << ") of "
+    << num_samples();
+  for (size_t shard = ShardOf(begin); begin < end; shard++) {
+    int64_t piece_end = std::min(end, _shard_begin[shard + 1]);
+    if (piece_end > begin)
+      fn(*_shards[shard], begin - _shard_begin[shard], piece_end - begin);
+    begin = piece_end;
+  }
+}
+
+NDArray MmapDataset::Slice(int64_t begin, int64_t end) const {
+  HTShape shape = {end - begin};
+  shape.insert(shape.end(), _sample_shape.begin(), _sample_shape.end());
+  auto meta = NDArrayMeta().set_dtype(_dtype).set_shape(shape).set_device(
+    Device(kCPU));
+  HT_VALUE_ERROR_IF(begin < 0 || begin > end || end > num_samples())
+    << "Invalid samples [" << begin << ", " << end << ") of "
+    << num_samples();
+  size_t shard = ShardOf(begin);
+  if (end > begin && end <= _shard_begin[shard + 1]) {
+    auto mapping = _shards[shard];
+    void* ptr = mapping->data() + (begin - _shard_begin[shard]) * _sample_bytes;
+    // the deleter holds the mapping as long as the array is alive
+    auto storage = std::make_shared<NDArrayStorage>(BorrowToMemoryPool(
+      Device(kCPU), ptr, (end - begin) * _sample_bytes,
+      [mapping](DataPtr) {}));
+    return NDArray(meta, storage);
+  }
+  auto ret = NDArray::empty(shape, Device(kCPU), _dtype, kBlockingStream);
+  auto* dst = reinterpret_cast<uint8_t*>(ret->raw_data_ptr());
+  ForEachPiece(begin, end,
+               [&](const MmapShard& shard, int64_t first, int64_t num) {
+                 std::memcpy(dst, shard.data() + first * _sample_bytes,
+                             num * _sample_bytes);
+                 dst += num * _sample_bytes;
+               });
+  return ret;
+}
+
+void MmapDataset::Prefetch(int64_t begin, int64_t end) const {
+  ForEachPiece(begin, end,
+               [&](const MmapShard& shard, int64_t first, int64_t num) {
+                 shard.Prefetch(first * _sample_bytes, num * _sample_bytes);
+               });
+}
+
+MmapDataloader::MmapDataloader(std::shared_ptr<MmapDataset> dataset,
+                               int batch_size, int prefetch_depth,
+                               int num_workers, bool shuffle, bool drop_last,
+                               uint64_t seed)
+: _dataset(std::move(dataset)),
+  _batch_size(batch_size),
+  _prefetch_depth(prefetch_depth),
+  _num_workers(num_workers),
+  _shuffle(shuffle),
+  _drop_last(drop_last),
+  _seed(seed) {
+  HT_VALUE_ERROR_IF(_batch_size <= 0) << "Invalid batch size " << _batch_size;
+  HT_VALUE_ERROR_IF(_prefetch_depth <= 0)
+    << "Invalid prefetch depth " << _prefetch_depth;
+  HT_VALUE_ERROR_IF(_num_workers <= 0 ||
+                    _num_workers > kCheckpointStream - kDataloaderStream)
+    << "The number of dataloader workers should be in [1, "
+    << kCheckpointStream - kDataloaderStream << "], got " << _num_workers;
+  reset(0);
+}
+
+MmapDataloader::~MmapDataloader() {
+  WaitAll();
+}
+
+void MmapDataloader::set_dp_rank(int dp_rank, int dp_nrank) {
+  HT_VALUE_ERROR_IF(dp_nrank <= 0 || dp_rank < 0 || dp_rank >= dp_nrank)
+    << "Invalid dp rank " << dp_rank << " of " << dp_nrank;
+  _dp_rank = dp_rank;
+  _dp_nrank = dp_nrank;
+  reset(_epoch);
+}
+
+void MmapDataloader::reset(int epoch) {
+  WaitAll();
+  // drop the tail so that every rank gets the same number of samples
+  int64_t samples_per_rank = _dataset->num_samples() / _dp_nrank;
+  _rank_begin = samples_per_rank * _dp_rank;
+  _rank_end = _rank_begin + samples_per_rank;
+  _batch_num = _drop_last ? samples_per_rank / _batch_size
+                          : DIVUP(samples_per_rank, _batch_size);
+  _epoch = epoch;
+  _batch_idx = 0;
+  _order.resize(_batch_num);
+  std::iota(_order.begin(), _order.end(), 0);
+  if (_shuffle) {
+    std::mt19937_64 rng(_seed + epoch);
+    std::shuffle(_order.begin(), _order.end(), rng);
+  }
+  _slots.assign(_prefetch_depth, NDArray());
+  _futures.clear();
+  _futures.resize(_prefetch_depth);
+  for (int i = 0; i < std::min(_prefetch_depth, _batch_num); i++)
+    Enqueue(i);
+}
+
+std::pair<int64_t, int64_t> MmapDataloader::batch_range(int batch_idx) const {
+  int64_t begin = _rank_begin + int64_t(_order[batch_idx]) * _batch_size;
+  return {begin, std::min(begin + _batch_size, _rank_end)};
+}
+
+void MmapDataloader::Enqueue(int batch_idx) {
+  auto range = batch_range(batch_idx);
+  int slot = batch_idx % _prefetch_depth;
+  auto cpu_stream = hetu::impl::GetCPUStream(
+    kDataloaderStream + batch_idx % _num_workers);
+  _futures[slot] = cpu_stream.EnqueueTask(
+    [this, range, slot]() {
+      _dataset->Prefetch(range.first, range.second);
+      _slots[slot] = _dataset->Slice(range.first, range.second);
+    },
+    "DataloaderPrefetch");
+}
+
+void MmapDataloader::WaitAll() {
+  for (auto& future : _futures)
+    if (future.valid())
+      future.wait();
+}
+
+NDArray MmapDataloader::next_batch() {
+  if (_batch_idx >= _batch_num)
+    return NDArray();
+  int slot = _batch_idx % _prefetch_depth;
+  if (_futures[slot].valid())
+    _futures[slot].get();
+  NDArray ret = std::move(_slots[slot]);
+  _slots[slot] = NDArray();
+  HT_LOG_TRACE << "Dataloader batch " << _batch_idx << " of epoch " << _epoch
+               << ": samples " << batch_range(_batch_idx).first << " to "
+               << batch_range(_batch_idx).second;
+  if (_batch_idx + _prefetch_depth < _batch_num)
+    Enqueue(_batch_idx + _prefetch_depth);
+  _batch_idx++;
+  return ret;
+}
+
+Tensor MmapDataloader::get_arr() {
+  NDArray res = next_batch();
+  if (!res.is_defined())
+    return Tensor();
+  return MakeVariableOp(res, false, res->meta().dtype, false,
+                        DistributedStatesHierarchy(),
+                        OpMeta().set_eager_device(res->meta().device));
+}
+
+} // namespace graph
+} // namespace hetu
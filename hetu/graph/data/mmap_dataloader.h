@@ -0,0 +1,184 @@
+#pragma once
+
+#include "hetu/core/ndarray.h"
+#include "hetu/core/stream.h"
+#include "hetu/common/macros.h"
+#include "hetu/graph/operator.h"
+#include <future>
+
+namespace hetu {
+namespace graph {
+
+class MmapShard;
+class MmapDataset;
+class MmapDataloader;
+
+// A read-only memory mapping of one binary shard. Pages are copy-on-write,
+// so arrays viewing the mapping may be modified without touching the file.
+class MmapShard {
+ public:
+  MmapShard(const std::string& path);
+
+  ~MmapShard();
+
+  MmapShard(const MmapShard&) = delete;
+  MmapShard& operator=(const MmapShard&) = delete;
+
+  const std::string& path() const {
+    return _path;
+  }
+
+  size_t size() const {
+    return _size;
+  }
+
+  uint8_t* data() const {
+    return _data;
+  }
+
+  // Asks the kernel to read [offset, offset + num_bytes) ahead and touches
+  // every page of it, so that later reads do not fault.
+  void Prefetch(size_t offset, size_t num_bytes) const;
+
+ protected:
+  std::string _path;
+  size_t _size{0};
+  uint8_t* _data{nullptr};
+};
+
+// Fixed-shape samples stored back to back in one or more binary shards,
+// e.g., token ids written by numpy.ndarray.tofile. Samples are numbered
+// across shards in the given order.
+class MmapDataset {
+ public:
+  MmapDataset(const std::vector<std::string>& paths, HTShape sample_shape,
+              DataType dtype);
+
+  int64_t num_samples() const {
+    return _shard_begin.back();
+  }
+
+  const HTShape& sample_shape() const {
+    return _sample_shape;
+  }
+
+  DataType dtype() const {
+    return _dtype;
+  }
+
+  size_t sample_bytes() const {
+    return _sample_bytes;
+  }
+
+  size_t num_shards() const {
+    return _shards.size();
+  }
+
+  // Samples [begin, end) as one array. It views the mapping without copying
+  // if the samples lie in one shard, otherwise they are gathered into an
+  // array from the CPU memory pool.
+  NDArray Slice(int64_t begin, int64_t end) const;
+
+  // Faults in the pages of samples [begin, end).
+  void Prefetch(int64_t begin, int64_t end) const;
+
+ protected:
+  // index of the shard holding the `sample`-th sample
+  size_t ShardOf(int64_t sample) const;
+
+  // Calls `fn(shard, first sample in shard, num samples)` for every piece
+  // of [begin, end) inside one shard.
+  template <typename Func>
+  void ForEachPiece(int64_t begin, int64_t end, Func&& fn) const;
+
+  std::vector<std::shared_ptr<MmapShard>> _shards;
+  // first global sample of each shard, plus the total number of samples
+  std::vector<int64_t> _shard_begin;
+  HTShape _sample_shape;
+  DataType _dtype;
+  size_t _sample_bytes;
+};
+
+// Streams batches of an MmapDataset. Batches are contiguous samples, so most
+// of them are views of the mapping. Up to `prefetch_depth` batches are
+// prepared ahead by `num_workers` CPU streams. With `shuffle`, the order of
+// batches is permuted per epoch by a generator seeded with `seed + epoch`,
+// which is the same on every rank. After set_dp_rank, each rank reads an
+// equal contiguous part of the samples.
+class MmapDataloader {
+ public:
+  MmapDataloader(std::shared_ptr<MmapDataset> dataset, int batch_size,
+                 int prefetch_depth = 3, int num_workers = 1,
+                 bool shuffle = false, bool drop_last = true,
+                 uint64_t seed = 0);
+
+  ~MmapDataloader();
+
+  MmapDataloader(const MmapDataloader&) = delete;
+  MmapDataloader& operator=(const MmapDataloader&) = delete;
+
+  void set_dp_rank(int dp_rank, int dp_nrank);
+
+  // Restarts from the first batch of `epoch`.
+  void reset(int epoch = 0);
+
+  // The next batch of the epoch, or an undefined array at its end.
+  NDArray next_batch();
+
+  Tensor get_arr();
+
+  int batch_num() const {
+    return _batch_num;
+  }
+
+  int batch_size() const {
+    return _batch_size;
+  }
+
+  int prefetch_depth() const {
+    return _prefetch_depth;
+  }
+
+  int num_workers() const {
+    return _num_workers;
+  }
+
+  int epoch() const {
+    return _epoch;
+  }
+
+  const MmapDataset& dataset() const {
+    return *_dataset;
+  }
+
+ protected:
+  // samples [begin, end) of the `batch_idx`-th batch of the epoch
+  std::pair<int64_t, int64_t> batch_range(int batch_idx) const;
+
+  void Enqueue(int batch_idx);
+
+  void WaitAll();
+
+  std::shared_ptr<MmapDataset> _dataset;
+  int _batch_size;
+  int _prefetch_depth;
+  int _num_workers;
+  bool _shuffle;
+  bool _drop_last;
+  uint64_t _seed;
+  int _dp_rank{0};
+  int _dp_nrank{1};
+
+  int64_t _rank_begin;
+  int64_t _rank_end;
+  int _batch_num;
+  int _epoch{0};
+  int _batch_idx{0};
+  std::vector<int> _order;
+  // in flight batches, indexed by batch_idx % prefetch_depth
+  std::vector<NDArray> _slots;
+  std::vector<std::future<void>> _futures;
+};
+
+} // namespace graph
+} // namespace hetu
@@ -0,0 +1,320 @@
+#include "hetu/graph/data/sequence_packing.h"
+#include "hetu/impl/utils/dispatch.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace hetu {
+namespace graph {
+
+int64_t PackingPlan::num_seqs() const {
+  int64_t ret = 0;
+  for (const auto& micro_batch : micro_batches)
+    ret += micro_batch.size();
+  return ret;
+}
+
+int64_t PackingPlan::num_tokens() const {
+  return std::accumulate(packed_seqlens.begin(), packed_seqlens.end(),
+                         int64_t(0));
+}
+
+namespace {
+
+inline int64_t AlignUp(int64_t num_tokens, int64_t alignment) {
+  return DIVUP(num_tokens, alignment) * alignment;
+}
+
+// Copies the sequences of every micro batch into `packed` and fills the
+// rest of the micro batch with `pad_token`. The cumulative lengths are
+// skipped if `cu_seqlens` is null. Micro batches are independent, so they
+// are packed in parallel.
+template <typename spec_t>
+void PackMicroBatches(const std::vector<const spec_t*>& seqs,
+                      const std::vector<int64_t>& seqlens,
+                      const PackingPlan& plan, spec_t pad_token,
+                      spec_t* packed, int32_t* cu_seqlens) {
+  size_t num_micro_batches = plan.num_micro_batches();
+  std::vector<int64_t> token_offsets(num_micro_batches + 1, 0);
+  std::vector<int64_t> cu_offsets(num_micro_batches + 1, 0);
+  for (size_t i = 0; i < num_micro_batches; i++) {
+    token_offsets[i + 1] = token_offsets[i] + plan.packed_seqlens[i];
+    cu_offsets[i + 1] = cu_offsets[i] + plan.micro_batches[i].size() + 1;
+  }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (size_t i = 0; i < num_micro_batches; i++) {
+    spec_t* dst = packed + token_offsets[i];
+    int32_t* cu = cu_seqlens ? cu_seqlens + cu_offsets[i] : nullptr;
+    int64_t num_tokens = 0;
+    if (cu)
+      *cu++ = 0;
+    for (auto seq : plan.micro_batches[i]) {
+      std::memcpy(dst + num_tokens, seqs[seq], seqlens[seq] * sizeof(spec_t));
+      num_tokens += seqlens[seq];
+      if (cu)
+        *cu++ = static_cast<int32_t>(num_tokens);
+    }
+    std::fill(dst + num_tokens, dst + plan.packed_seqlens[i], pad_token);
+  }
+}
+
+} // namespace
+
+PackingPlan PlanFirstFitDecreasing(const std::vector<int64_t>& seqlens,
+                                   int64_t max_seqlen, int64_t alignment,
+                                   bool static_shape) {
+  HT_VALUE_ERROR_IF(max_seqlen <= 0 || alignment <= 0)
+    << "Invalid max seqlen " << max_seqlen << " or alignment " << alignment;
+  std::vector<int64_t> order(seqlens.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int64_t a, int64_t b) {
+    return seqlens[a] > seqlens[b];
+  });
+  // A max tree over the room left in each micro batch. Micro batches that
+  // are not opened yet have all the room, so descending to the leftmost
+  // leaf with enough room gives the first fit in O(log n).
+  size_t num_leaves = 1;
+  while (num_leaves < seqlens.size())
+    num_leaves <<= 1;
+  std::vector<int64_t> room(2 * num_leaves, max_seqlen);
+  PackingPlan plan;
+  std::vector<int64_t> used;
+  for (auto seq : order) {
+    int64_t seqlen = seqlens[seq];
+    HT_VALUE_ERROR_IF(seqlen < 0 || seqlen > max_seqlen)
+      << "Cannot pack a sequence of " << seqlen << " tokens into micro "
+      << "batches of " << max_seqlen << " tokens";
+    size_t node = 1;
+    while (node < num_leaves)
+      node = room[2 * node] >= seqlen ? 2 * node : 2 * node + 1;
+    size_t micro_batch = node - num_leaves;
+    if (micro_batch == plan.micro_batches.size()) {
+      plan.micro_batches.emplace_back();
+      used.push_back(0);
+    }
+    plan.micro_batches[micro_batch].push_back(seq);
+    used[micro_batch] += seqlen;
+    room[node] -= seqlen;
+    for (node >>= 1; node > 0; node >>= 1)
+      room[node] = std::max(room[2 * node], room[2 * node + 1]);
+  }
+  for (auto num_tokens : used)
+    plan.packed_seqlens.push_back(
+      static_shape ? max_seqlen : AlignUp(num_tokens, alignment));
+  return plan;
+}
+
+PackingPlan PlanWithOptionMatrix(const std::vector<int64_t>& seqlens,
+                                 const NDArray& option_matrix,
+                                 int64_t alignment) {
+  HT_VALUE_ERROR_IF(alignment <= 0) << "Invalid alignment " << alignment;
+  HT_VALUE_ERROR_IF(option_matrix->ndim() != 2 ||
+                    option_matrix->shape(0) !=
+                      static_cast<int64_t>(seqlens.size()))
+    << "Expected an option matrix of " << seqlens.size()
+    << " rows, got shape " << option_matrix->shape();
+  HT_VALUE_ERROR_IF(!option_matrix->is_cpu() ||
+                    !option_matrix->is_contiguous())
+    << "The option matrix should be a contiguous host array";
+  int64_t num_seqs = option_matrix->shape(0);
+  int64_t num_micro_batches = option_matrix->shape(1);
+  PackingPlan plan;
+  plan.micro_batches.resize(num_micro_batches);
+  HT_DISPATH_SWITCH(
+    option_matrix->dtype(), "PlanWithOptionMatrix",
+    HT_DISPATH_CASE(hetu::DataType::BOOL, spec_t, [&]() {
+      const spec_t* options = option_matrix->data_ptr<spec_t>();
+      for (int64_t j = 0; j < num_micro_batches; j++)
+        for (int64_t i = 0; i < num_seqs; i++)
+          if (options[i * num_micro_batches + j])
+            plan.micro_batches[j].push_back(i);
+    }) HT_DISPATH_CASE_INTEGER_TYPES(spec_t, [&]() {
+      const spec_t* options = option_matrix->data_ptr<spec_t>();
+      for (int64_t j = 0; j < num_micro_batches; j++)
+        for (int64_t i = 0; i < num_seqs; i++)
+          if (options[i * num_micro_batches + j])
+            plan.micro_batches[j].push_back(i);
+    }));
+  for (const auto& micro_batch : plan.micro_batches) {
+    int64_t num_tokens = 0;
+    for (auto seq : micro_batch)
+      num_tokens += seqlens[seq];
+    plan.packed_seqlens.push_back(AlignUp(num_tokens, alignment));
+  }
+  return plan;
+}
+
+void PackSequences(const NDArrayList& seqs, const PackingPlan& plan,
+                   int64_t pad_token, NDArray& packed, NDArray& cu_seqlens) {
+  HT_VALUE_ERROR_IF(seqs.empty()) << "No sequences to pack";
+  std::vector<int64_t> seqlens;
+  for (const auto& seq : seqs) {
+    HT_VALUE_ERROR_IF(!seq->is_cpu() || !seq->is_contiguous() ||
+                      seq->dtype() != seqs.front()->dtype())
+      << "Sequences should be contiguous host arrays of the same dtype";
+    seqlens.push_back(seq->numel());
+  }
+  HT_VALUE_ERROR_IF(packed->dtype() != seqs.front()->dtype() ||
+                    static_cast<int64_t>(packed->numel()) != plan.num_tokens())
+    << "Expected " << plan.num_tokens() << " packed tokens of "
+    << seqs.front()->dtype() << ", got " << packed->meta();
+  HT_VALUE_ERROR_IF(cu_seqlens->dtype() != kInt32 ||
+                    static_cast<int64_t>(cu_seqlens->numel()) !=
+                      plan.num_seqs() +
+                        static_cast<int64_t>(plan.num_micro_batches()))
+    << "Expected " << plan.num_seqs() + plan.num_micro_batches()
+    << " int32 cu_seqlens, got " << cu_seqlens->meta();
+  for (const auto& micro_batch : plan.micro_batches)
+    for (auto seq : micro_batch)
+      HT_VALUE_ERROR_IF(seq < 0 || seq >= static_cast<int64_t>(seqs.size()))
+        << "Invalid sequence " << seq << " of " << seqs.size();
+  HT_DISPATCH_INTEGER_TYPES(seqs.front()->dtype(), spec_t, "PackSequences",
+                            [&]() {
+                              std::vector<const spec_t*> ptrs;
+                              for (const auto& seq : seqs)
+                                ptrs.push_back(seq->data_ptr<spec_t>());
+                              PackMicroBatches<spec_t>(
+                                ptrs, seqlens, plan,
+                                static_cast<spec_t>(pad_token),
+                                packed->data_ptr<spec_t>(),
+                                cu_seqlens->data_ptr<int32_t>());
+                            });
+}
+
+NDArrayList SplitPackedMicroBatches(const PackingPlan& plan,
+                                    const NDArray& packed) {
+  NDArrayList ret;
+  int64_t offset = packed->storage_offset();
+  for (auto packed_seqlen : plan.packed_seqlens) {
+    auto meta = packed->meta();
+    meta.set_shape({packed_seqlen});
+    ret.emplace_back(meta, packed->storage(), offset);
+    offset += packed_seqlen;
+  }
+  return ret;
+}
+
+NDArrayList SplitPackedCuSeqlens(const PackingPlan& plan,
+                                 const NDArray& cu_seqlens) {
+  NDArrayList ret;
+  int64_t offset = cu_seqlens->storage_offset();
+  for (const auto& micro_batch : plan.micro_batches) {
+    int64_t num = micro_batch.size() + 1;
+    auto meta = cu_seqlens->meta();
+    meta.set_shape({num});
+    ret.emplace_back(meta, cu_seqlens->storage(), offset);
+    offset += num;
+  }
+  return ret;
+}
+
+namespace {
+
+template <typename spec_t>
+void BucketAndPack(const spec_t* data, DataType dtype, int64_t num_rows,
+                   int64_t row_len, spec_t pad, int64_t alignment,
+                   bool static_shape, std::vector<PackedBucket>& buckets) {
+  // the input of a row drops its last token and the label drops its first,
+  // so both have one token less than the row
+  std::vector<int64_t> seqlens(num_rows);
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for (int64_t r = 0; r < num_rows; r++) {
+    const spec_t* row = data + r * row_len;
+    seqlens[r] = row_len - std::count(row, row + row_len, pad) - 1;
+  }
+  std::vector<int64_t> order(num_rows);
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int64_t a, int64_t b) {
+    return seqlens[a] > seqlens[b];
+  });
+  for (auto r : order)
+    for (auto& bucket : buckets)
+      if (seqlens[r] > bucket.min_seqlen && seqlens[r] <= bucket.max_seqlen) {
+        bucket.rows.push_back(r);
+        break;
+      }
+  while (!buckets.empty() && buckets.back().rows.empty())
+    buckets.pop_back();
+
+  int64_t num_buckets = buckets.size();
+  std::vector<std::vector<int64_t>> bucket_seqlens(num_buckets);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int64_t k = 0; k < num_buckets; k++) {
+    for (auto r : buckets[k].rows)
+      bucket_seqlens[k].push_back(seqlens[r]);
+    buckets[k].plan = PlanFirstFitDecreasing(
+      bucket_seqlens[k], buckets[k].max_seqlen, alignment, static_shape);
+  }
+  // allocate outside the parallel region as the memory pool is shared
+  for (auto& bucket : buckets) {
+    int64_t num_tokens = bucket.plan.num_tokens();
+    int64_t num_cu_seqlens =
+      bucket.plan.num_seqs() + bucket.plan.num_micro_batches();
+    bucket.input = NDArray::empty({num_tokens}, Device(kCPU), dtype,
+                                  kBlockingStream);
+    bucket.label = NDArray::empty({num_tokens}, Device(kCPU), dtype,
+                                  kBlockingStream);
+    bucket.cu_seqlens = NDArray::empty({num_cu_seqlens}, Device(kCPU), kInt32,
+                                       kBlockingStream);
+  }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int64_t k = 0; k < num_buckets; k++) {
+    auto& bucket = buckets[k];
+    std::vector<const spec_t*> inputs, labels;
+    for (auto r : bucket.rows) {
+      inputs.push_back(data + r * row_len);
+      labels.push_back(data + r * row_len + 1);
+    }
+    PackMicroBatches<spec_t>(inputs, bucket_seqlens[k], bucket.plan, pad,
+                             bucket.input->data_ptr<spec_t>(),
+                             bucket.cu_seqlens->data_ptr<int32_t>());
+    PackMicroBatches<spec_t>(labels, bucket_seqlens[k], bucket.plan, pad,
+                             bucket.label->data_ptr<spec_t>(), nullptr);
+  }
+}
+
+} // namespace
+
+std::vector<PackedBucket>
+BucketAndPackGlobalBatch(const NDArray& global_batch, int64_t pad_token,
+                         const std::vector<int64_t>& bucket_sizes,
+                         int64_t alignment, bool static_shape) {
+  HT_VALUE_ERROR_IF(global_batch->ndim() != 2 || !global_batch->is_cpu() ||
+                    !global_batch->is_contiguous())
+    << "The global batch should be a contiguous 2-D host array, got "
+    << global_batch->meta();
+  HT_VALUE_ERROR_IF(bucket_sizes.size() < 2)
+    << "Expected at least 2 bucket sizes, got " << bucket_sizes;
+  // checked ahead as errors cannot leave the parallel regions
+  for (size_t k = 0; k + 1 < bucket_sizes.size(); k++)
+    HT_VALUE_ERROR_IF(bucket_sizes[k] <= bucket_sizes[k + 1] ||
+                      bucket_sizes[k + 1] < 0)
+      << "Bucket sizes should be descending and non-negative, got "
+      << bucket_sizes;
+  HT_VALUE_ERROR_IF(alignment <= 0) << "Invalid alignment " << alignment;
+  std::vector<PackedBucket> buckets(bucket_sizes.size() - 1);
+  for (size_t k = 0; k < buckets.size(); k++) {
+    buckets[k].max_seqlen = bucket_sizes[k];
+    buckets[k].min_seqlen = bucket_sizes[k + 1];
+  }
+  HT_DISPATCH_INTEGER_TYPES(
+    global_batch->dtype(), spec_t, "BucketAndPackGlobalBatch", [&]() {
+      BucketAndPack<spec_t>(global_batch->data_ptr<spec_t>(),
+                            global_batch->dtype(), global_batch->shape(0),
+                            global_batch->shape(1),
+                            static_cast<spec_t>(pad_token), alignment,
+                            static_shape, buckets);
+    });
+  return buckets;
+}
+
+} // namespace graph
+} // namespace hetu
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "hetu/core/ndarray.h"
+
+namespace hetu {
+namespace graph {
+
+// Which sequences are packed into each micro batch, and the length of each
+// micro batch after padding.
+struct PackingPlan {
+  std::vector<std::vector<int64_t>> micro_batches;
+  std::vector<int64_t> packed_seqlens;
+
+  size_t num_micro_batches() const {
+    return micro_batches.size();
+  }
+
+  int64_t num_seqs() const;
+
+  int64_t num_tokens() const;
+};
+
+// Packs sequences into micro batches of at most `max_seqlen` tokens by
+// first-fit decreasing: every sequence, from the longest, goes to the first
+// micro batch with enough room. Micro batches are padded to `max_seqlen` if
+// `static_shape`, otherwise to a multiple of `alignment`.
+PackingPlan PlanFirstFitDecreasing(const std::vector<int64_t>& seqlens,
+                                   int64_t max_seqlen, int64_t alignment = 1,
+                                   bool static_shape = false);
+
+// Packs sequence i into micro batch j if `option_matrix[i][j]` is non-zero.
+// Micro batches are padded to a multiple of `alignment`.
+PackingPlan PlanWithOptionMatrix(const std::vector<int64_t>& seqlens,
+                                 const NDArray& option_matrix,
+                                 int64_t alignment = 1);
+
+// Writes the micro batches of `plan` back to back into `packed`, which holds
+// plan.num_tokens() elements of the dtype of `seqs`. For each micro batch,
+// the cumulative lengths of its sequences (starting from 0 and excluding
+// the padding) are written back to back into the int32 `cu_seqlens`, which
+// holds plan.num_seqs() + plan.num_micro_batches() elements.
+void PackSequences(const NDArrayList& seqs, const PackingPlan& plan,
+                   int64_t pad_token, NDArray& packed, NDArray& cu_seqlens);
+
+// Views of micro batch `i` in the outputs of PackSequences.
+NDArrayList SplitPackedMicroBatches(const PackingPlan& plan,
+                                    const NDArray& packed);
+NDArrayList SplitPackedCuSeqlens(const PackingPlan& plan,
+                                 const NDArray& cu_seqlens);
+
+// Sequences with seqlen in (min_seqlen, max_seqlen], packed as inputs and
+// labels (shifted by one token) of next token prediction.
+struct PackedBucket {
+  int64_t max_seqlen;
+  int64_t min_seqlen;
+  // row in the global batch of each sequence, longest first
+  std::vector<int64_t> rows;
+  PackingPlan plan;
+  NDArray input;
+  NDArray label;
+  NDArray cu_seqlens;
+};
+
+// Buckets the rows of a padded global batch ([num_seqs, max_len]) by their
+// numbers of non-pad tokens minus one, with bucket k holding seqlens in
+// (bucket_sizes[k + 1], bucket_sizes[k]] for descending `bucket_sizes`, and
+// packs every bucket by first-fit decreasing. Buckets after the last
+// non-empty one are not returned, and rows that fit in no bucket are
+// dropped. Buckets are planned and packed in parallel.
+std::vector<PackedBucket>
+BucketAndPackGlobalBatch(const NDArray& global_batch, int64_t pad_token,
+                         const std::vector<int64_t>& bucket_sizes,
+                         int64_t alignment = 1, bool static_shape = false);
+
+} // namespace graph
+} // namespace hetu
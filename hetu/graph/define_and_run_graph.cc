@@ -11,6 +11,7 @@
 #include "hetu/graph/recompute/recompute.h"
 #include "hetu/graph/offload/activation_cpu_offload.h"
 #include "hetu/impl/memory/CUDACachingMemoryPool.cuh"
+#include "hetu/impl/profiler/profiler.h"
 #include <queue>
 
 namespace hetu {
@@ -139,6 +140,28 @@ DeviceGroupUnion DefineAndRunGraph::GetVariableDeviceGroupUnionInner(const Tenso
   return device_group_union;
 }
 
+std::shared_future<void>
+DefineAndRunGraph::SaveCheckpointAsync(const std::string& path, size_t max_host_bytes,
+                                       const std::map<std::string, std::string>& metadata) {
+  HT_RUNTIME_ERROR_IF(!_is_active)
+    << "Cannot save checkpoint before any exec graph is run";
+  auto local_device = hetu::impl::comm::GetLocalDevice();
+  auto& exec_graph = _exec_graph_plan_pool[_active_exec_plan].exec_graph;
+  HT_RUNTIME_ERROR_IF(!exec_graph->NeedRank(hetu::impl::comm::DeviceToWorldRank(local_device)))
+    << local_device << " holds no params of the active exec graph";
+  if (_checkpoint_writer == nullptr || _checkpoint_writer->max_host_bytes() != max_host_bytes) {
+    if (_checkpoint_writer != nullptr)
+      _checkpoint_writer->Wait();
+    _checkpoint_writer = std::make_unique<CheckpointWriter>(64 << 20, false, max_host_bytes);
+  }
+  return exec_graph->SaveCheckpointAsync(*_checkpoint_writer, path, metadata);
+}
+
+void DefineAndRunGraph::WaitCheckpoint() {
+  if (_checkpoint_writer != nullptr)
+    _checkpoint_writer->Wait();
+}
+
 void DefineAndRunGraph::MergeGraph(DefineAndRunGraph& another_graph) {
   HT_ASSERT(_op_indexing.size() == another_graph._op_indexing.size())
     << "two graph op indexing should be aligned";
@@ -291,6 +314,41 @@ void DefineAndRunGraph::DeducePipeline(size_t compute_strategy_id, int32_t pipel
   CUR_STRATEGY_ID = old_strategy_id;
 }
 
+// Following boost::hash_combine
+static inline void HashCombine(size_t& seed, size_t value) {
+  seed ^= value + 0x9e3779b9 + (seed << 6) + (seed >> 2);
+}
+
+size_t DefineAndRunGraph::ExecPlanSignature(size_t compute_strategy_id,
+                                            size_t optimize_strategy_id,
+                                            const TensorList& fetches) {
+  std::vector<TensorId> fetch_ids;
+  fetch_ids.reserve(fetches.size());
+  for (const auto& fetch : fetches)
+    fetch_ids.push_back(fetch->id());
+  std::sort(fetch_ids.begin(), fetch_ids.end());
+  fetch_ids.erase(std::unique(fetch_ids.begin(), fetch_ids.end()),
+                  fetch_ids.end());
+  size_t seed = 0;
+  HashCombine(seed, compute_strategy_id);
+  HashCombine(seed, optimize_strategy_id);
+  for (auto fetch_id : fetch_ids)
+    HashCombine(seed, fetch_id);
+  return seed;
+}
+
+size_t DefineAndRunGraph::FeedShapeSignature(const Tensor2ShapeMap& feed_dict_shape) {
+  // 各个tensor的hash直接相加，从而与feed dict的遍历顺序无关
+  size_t signature = feed_dict_shape.size();
+  for (const auto& kv : feed_dict_shape) {
+    size_t seed = std::hash<TensorId>()(kv.first);
+    for (auto dim : kv.second)
+      HashCombine(seed, std::hash<int64_t>()(dim));
+    signature += seed;
+  }
+  return signature;
+}
+
 // 推导define graph的shape plan
 // 以及exec graph的exec shape plan
 // 请注意二者的区别
@@ -1178,38 +1236,49 @@ NDArrayList DefineAndRunGraph::Run(const Tensor& loss, const TensorList& fetches
     }
   }
 
+  TIK(graph_plan);
   size_t next_active_exec_plan;
   std::vector<size_t> next_active_shape_plan_list(num_micro_batches);
   int64_t micro_batch_idx = 0;
-  size_t exec_plan_pool_size = _exec_graph_plan_pool.size();
   bool in_exec_plan_pool = false;
-  for (size_t i = 0; i < exec_plan_pool_size; i++)  {
-    const auto& exec_graph_plan = _exec_graph_plan_pool[i];
-    bool exec_plan_matched = true;
+  auto exec_plan_matched = [&](const ExecGraphPlan& exec_graph_plan) -> bool {
     // 先看strategy匹配不
     if (static_cast<size_t>(compute_strategy_id) != exec_graph_plan.compute_strategy_id
         || static_cast<size_t>(optimize_strategy_id) != exec_graph_plan.optimize_strategy_id) {
-      exec_plan_matched = false;
+      return false;
     }
     // 再看fetch匹配不
     if (fetches.size() < exec_graph_plan.fetches.size()) {
-      exec_plan_matched = false;
+      return false;
     }
-    // HT_LOG_INFO << i << "\n" << fetches << "\n" << exec_graph_plan.fetches
-    // << " " << exec_graph_plan.global_topo.size();
     for (const auto& fetch : fetches) {
       if (std::find(exec_graph_plan.fetches.begin(), exec_graph_plan.fetches.end(), fetch) == exec_graph_plan.fetches.end()) {
         HT_LOG_TRACE << local_device << ": exec_graph_plan fetches are " << exec_graph_plan.fetches 
           << " and the mismatch fetch is " << fetch;
-        exec_plan_matched = false;
-        break;
+        return false;
       }
     }
-    if (exec_plan_matched) {
-      HT_LOG_TRACE << local_device << ": plan matched";
-      in_exec_plan_pool = true;
-      next_active_exec_plan = i;
-      break;
+    return true;
+  };
+  // 先用signature在索引中O(1)查找
+  // 未命中时再遍历整个pool
+  size_t exec_plan_signature = ExecPlanSignature(compute_strategy_id, optimize_strategy_id, fetches);
+  auto exec_plan_it = _exec_plan_index.find(exec_plan_signature);
+  if (exec_plan_it != _exec_plan_index.end()
+      && exec_plan_matched(_exec_graph_plan_pool[exec_plan_it->second])) {
+    HT_LOG_TRACE << local_device << ": plan matched by signature";
+    in_exec_plan_pool = true;
+    next_active_exec_plan = exec_plan_it->second;
+  } else {
+    size_t exec_plan_pool_size = _exec_graph_plan_pool.size();
+    for (size_t i = 0; i < exec_plan_pool_size; i++)  {
+      if (exec_plan_matched(_exec_graph_plan_pool[i])) {
+        HT_LOG_TRACE << local_device << ": plan matched";
+        in_exec_plan_pool = true;
+        next_active_exec_plan = i;
+        _exec_plan_index[exec_plan_signature] = i;
+        break;
+      }
     }
   }
 
@@ -1246,8 +1315,10 @@ NDArrayList DefineAndRunGraph::Run(const Tensor& loss, const TensorList& fetches
     new_plan.fetches = fetches;
     // 新的exec plan就是exec plan pool中的最后一个
     next_active_exec_plan = _exec_graph_plan_pool.size() - 1;
+    _exec_plan_index[exec_plan_signature] = next_active_exec_plan;
     // 新的shape plan就是shape plan pool中的第一个
     next_active_shape_plan_list[micro_batch_idx] = 0;
+    new_plan.shape_plan_index[FeedShapeSignature(feed_dict_shape_list[micro_batch_idx])].push_back(0);
     micro_batch_idx++; 
     HT_LOG_DEBUG << local_device << ": [Graph Plan] add a new shape plan and an exec graph to the pool end...";
   } 
@@ -1255,47 +1326,71 @@ NDArrayList DefineAndRunGraph::Run(const Tensor& loss, const TensorList& fetches
   // 但可能feed dict不一样
   // 这种情况下我们不需要生成新的exec graph
   // 但需要推导新的shape plan
+  auto& exec_graph_plan = _exec_graph_plan_pool[next_active_exec_plan];
+  auto shape_plan_matched = [&](size_t i, int64_t idx) -> bool {
+    const auto& shape_plan = exec_graph_plan.shape_plan_pool[i];
+    for (const auto& kv : feed_dict) {
+      if (kv.second.size() == 0) continue;
+      auto it = shape_plan.find(kv.first);
+      // 1、有可能是feed_dict发生了改变（在依据global topo生成的shape plan中没有feed dict）
+      // 2、有可能是feed_dict的shape发生了改变（shape对不上）
+      if (it == shape_plan.end()) {
+        HT_LOG_TRACE << local_device << ": cannot find feed dict tensor " << kv.first << " in shape plan " << i;
+        return false;
+      }
+      if (it->second != feed_dict_shape_list[idx][kv.first]) {
+        HT_LOG_TRACE << local_device << ": feed dict tensor " << kv.first << " shape is " << feed_dict_shape_list[idx][kv.first]
+          << " but its shape in shape plan " << i << " is " << it->second;
+        return false;
+      }
+    }
+    return true;
+  };
+  size_t num_deduced_shape_plans = 0;
   for (auto idx = micro_batch_idx; idx < num_micro_batches; idx++) {
-    auto& exec_graph_plan = _exec_graph_plan_pool[next_active_exec_plan];
-    auto shape_plan_pool_size = exec_graph_plan.shape_plan_pool.size();
     bool in_shape_plan_pool = false;
-    for (size_t i = 0; i < shape_plan_pool_size; i++) {
-      const auto& shape_plan = exec_graph_plan.shape_plan_pool[i];
-      bool shape_plan_matched = true;
-      for (const auto& kv : feed_dict) {
-        if (kv.second.size() == 0) continue;
-        auto it = shape_plan.find(kv.first);
-        // 1、有可能是feed_dict发生了改变（在依据global topo生成的shape plan中没有feed dict）
-        // 2、有可能是feed_dict的shape发生了改变（shape对不上）
-        // HT_LOG_TRACE << local_device << ": shape plan is " << shape_plan << " and key to match is " << kv.first << ":" << feed_dict_shape_list[idx][kv.first];
-        if (it == shape_plan.end()) {
-          HT_LOG_TRACE << local_device << ": cannot find feed dict tensor " << kv.first << " in shape plan " << i;
-          shape_plan_matched = false;
-          break;
-        }
-        if (it->second != feed_dict_shape_list[idx][kv.first]) {
-          HT_LOG_TRACE << local_device << ": feed dict tensor " << kv.first << " shape is " << feed_dict_shape_list[idx][kv.first]
-            << " but its shape in shape plan " << i << " is " << it->second;
-          shape_plan_matched = false;
-          break;
-        }
-      }
-      if (shape_plan_matched) {
+    // 同样先用feed shape的signature查找
+    // 只有该signature第一次出现时才遍历整个shape plan pool
+    auto& candidates = exec_graph_plan.shape_plan_index[FeedShapeSignature(feed_dict_shape_list[idx])];
+    for (auto i : candidates) {
+      if (shape_plan_matched(i, idx)) {
         in_shape_plan_pool = true;
         next_active_shape_plan_list[idx] = i;
-        HT_LOG_DEBUG << next_active_shape_plan_list[idx] << "-th shape plan is matched for micro batch " << idx;
         break;
       }
     }
+    if (!in_shape_plan_pool) {
+      auto shape_plan_pool_size = exec_graph_plan.shape_plan_pool.size();
+      for (size_t i = 0; i < shape_plan_pool_size; i++) {
+        if (shape_plan_matched(i, idx)) {
+          in_shape_plan_pool = true;
+          next_active_shape_plan_list[idx] = i;
+          candidates.push_back(i);
+          break;
+        }
+      }
+    }
+    if (in_shape_plan_pool) {
+      HT_LOG_DEBUG << next_active_shape_plan_list[idx] << "-th shape plan is matched for micro batch " << idx;
+    }
     // 如果不在shape_plan_pool中
     // 需要推导新的shape plan
-    if (!in_shape_plan_pool) {
+    else {
       HT_LOG_DEBUG << "DeduceShapePlan needed for micro batch " << idx;
       DeduceShapePlan(exec_graph_plan, feed_dict, feed_dict_shape_list[idx]);
       // 新的shape plan就是shape plan pool中的最后一个
       next_active_shape_plan_list[idx] = exec_graph_plan.shape_plan_pool.size() - 1;
+      candidates.push_back(next_active_shape_plan_list[idx]);
+      num_deduced_shape_plans++;
     }
   }
+  TOK(graph_plan);
+  HT_LOG_DEBUG << local_device << ": [Graph Plan] plan lookup end, "
+    << num_deduced_shape_plans << " shape plans deduced in " << COST_MICROSEC(graph_plan) << " us";
+  auto plan_profiler_optional = hetu::impl::Profile::get_cur_profile();
+  if (plan_profiler_optional) {
+    (*plan_profiler_optional)->push("graph_plan", COST_MICROSEC(graph_plan) / 1e3);
+  }
 
   // 准备运行挑选出的active exec graph
   auto& exec_graph = _exec_graph_plan_pool[next_active_exec_plan].exec_graph;
@@ -29,6 +29,7 @@ class ExecGraphPlan {
   Tensor2TensorMap tensor_to_exec_tensor_mapping;
   OpRefList global_topo; // cache the global topo to accelerate ineferring new shape plan
   std::vector<Tensor2ShapeMap> shape_plan_pool; // single exec graph with multi shape plan
+  std::unordered_map<size_t, std::vector<size_t>> shape_plan_index; // feed shape signature到shape plan的索引
   TensorList fetches; // most likey useless
 
   // forbid copy constructor to avoid high cost
@@ -110,6 +111,10 @@ class DefineAndRunGraph : public Graph {
     return _exec_graph_plan_pool[num];
   }
 
+  size_t num_exec_plans() const {
+    return _exec_graph_plan_pool.size();
+  }
+
   void RecordBeforeZero(const Tensor& tensor, const DistributedStatesHierarchy& ds_hierarchy) {
     HT_ASSERT(_ds_hierarchy_before_zero.find(tensor->id()) ==_ds_hierarchy_before_zero.end())
       << tensor << " is already recorded in the ds hierarchy before zero mapping";
@@ -118,6 +123,17 @@ class DefineAndRunGraph : public Graph {
 
   void MergeGraph(DefineAndRunGraph& another_graph);
 
+  // Saves the local params and optimizer states of the active exec graph to
+  // `path` in the background, see ExecutableGraph::SaveCheckpointAsync. If
+  // `max_host_bytes` is non-zero, snapshots of the pending saves hold at
+  // most that many bytes of host memory.
+  std::shared_future<void>
+  SaveCheckpointAsync(const std::string& path, size_t max_host_bytes = 0,
+                      const std::map<std::string, std::string>& metadata = {});
+
+  // Waits for all pending saves and rethrows the first error.
+  void WaitCheckpoint();
+
  protected:
   Operator& MakeOpInner(std::shared_ptr<OpInterface> body, TensorList inputs,
                         OpMeta op_meta);
@@ -128,6 +144,15 @@ class DefineAndRunGraph : public Graph {
                        const FeedDict& feed_dict,
                        Tensor2ShapeMap& feed_dict_shape);
 
+  // Signatures to look up the exec plan of the strategies and fetches, and
+  // the shape plan of the shapes fed, in O(1). Feed shape signatures do not
+  // depend on the order of the feed dict.
+  static size_t ExecPlanSignature(size_t compute_strategy_id,
+                                  size_t optimize_strategy_id,
+                                  const TensorList& fetches);
+
+  static size_t FeedShapeSignature(const Tensor2ShapeMap& feed_dict_shape);
+
   DeviceGroupUnion DeducePlacementGroup(Operator& op, Op2DGUnionMap& dg_union_map);
 
   void Instantiate(OpRefList&& global_topo,
@@ -158,6 +183,7 @@ class DefineAndRunGraph : public Graph {
     _param_switcher_pool.clear();
     _grad_switcher_pool.clear();
     _exec_graph_plan_pool.clear();
+    _exec_plan_index.clear();
     Graph::Clear();
   }
   
@@ -184,12 +210,16 @@ class DefineAndRunGraph : public Graph {
   std::unordered_map<std::pair<size_t, size_t>, std::unordered_map<DataType, std::shared_ptr<SwitchExecGraph>>> _param_switcher_pool; // 目前其实只会有transfer param
   std::unordered_map<std::pair<size_t, size_t>, std::unordered_map<DataType, std::shared_ptr<SwitchExecGraph>>> _grad_switcher_pool; // 目前其实只会有accumulate grad
   std::vector<ExecGraphPlan> _exec_graph_plan_pool;
+  std::unordered_map<size_t, size_t> _exec_plan_index; // exec plan signature到exec plan的索引
   // deprecated: now support single exec graph with multi shape plan
   // and we store multi shape plan into ExecGraphPlan
   // std::vector<Tensor2ShapeMap> _shape_plan_pool; 
   size_t _active_exec_plan;
   bool _is_active = false;
 
+  // 异步保存checkpoint用的writer
+  std::unique_ptr<CheckpointWriter> _checkpoint_writer;
+
   // 如果判断不需要进行grad的热切换
   // 此值为true时仍会进行grad热切换的topo计算
   // 为false时则什么都不做
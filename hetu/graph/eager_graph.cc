@@ -1,6 +1,9 @@
 #include "hetu/graph/eager_graph.h"
+#include "hetu/graph/ops/EmbeddingLookup.h"
 #include "hetu/graph/ops/variable.h"
 #include "hetu/impl/profiler/profiler.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/impl/stream/CUDAStream.h"
 
 namespace hetu {
 namespace graph {
@@ -11,43 +14,29 @@ Operator& EagerGraph::MakeOpInner(std::shared_ptr<OpInterface> body,
   auto& op = MakeAndAddOp(std::move(body), std::move(inputs), std::move(op_meta));
 
   // Eager instantiation and execution
-  Device placement = op->eager_device();
-  if (placement.is_undetermined()) {
-      if (op->op_indicator() == VARIABLE_OP) {
-      const auto& opimpl = reinterpret_cast<const VariableOpImpl&>(op->body());
-      placement = opimpl.device();
-    }
-  }
-  if (placement.is_undetermined()) {
-    if (op->num_inputs() > 0) {
-      placement = op->input(0)->device();
-    } else {
-      placement = Device(kCPU);
-    }
-  }
-  StreamIndex stream_id = get_suggested_stream_index(op);
-
-  HT_LOG_DEBUG << "Instantiating op " << op << " (placement=" << placement
-    << ", stream_index=" << stream_id << ")";
-  bool ok = op->Instantiate(placement, stream_id);
-  HT_RUNTIME_ERROR_IF(!ok) << "Failed to place op " << op->name() << " on device " << placement;
+  auto dispatch = GetDispatch(op);
+  HT_LOG_DEBUG << "Instantiating op " << op << " (placement="
+    << dispatch.placement << ", stream_index=" << dispatch.stream_index << ")";
+  bool ok = op->Instantiate(dispatch.placement, dispatch.stream_index);
+  HT_RUNTIME_ERROR_IF(!ok) << "Failed to place op " << op->name() << " on device " << dispatch.placement;
   
+  auto stream = op->instantiation_ctx().stream();
   NDArrayList input_arrays;
   input_arrays.reserve(op->num_inputs());
+  // Sparse updates only read the indexed slices of embedding gradients
+  bool is_sparse_update = op->type() == quote(SparseSGDUpdateOp) ||
+                          op->type() == quote(SparseAdamOp);
   // Insert Contiguous ops
-  if (op->body().require_contig_inputs()) {
-    for (auto& input : op->inputs()) {
-      if (!input->is_contiguous()) {
-        input_arrays.push_back(
-          NDArray::contiguous(_preserved_data[input->id()],
-                              op->instantiation_ctx().stream_index));
-      } else {
-        input_arrays.push_back(_preserved_data[input->id()]);
-      }
+  for (auto& input : op->inputs()) {
+    if (!is_sparse_update)
+      SetDenseGradIfUnset(input);
+    const auto& input_array = GetPreservedData(input);
+    if (dispatch.require_contig_inputs && !input->is_contiguous()) {
+      input_arrays.push_back(
+        NDArray::contiguous(input_array, dispatch.stream_index));
+    } else {
+      input_arrays.push_back(input_array);
     }
-  } else {
-    for (auto& input : op->inputs())
-      input_arrays.push_back(_preserved_data[input->id()]);
   }
 
   HT_LOG_DEBUG << op << " inputs: " << input_arrays;
@@ -56,17 +45,131 @@ Operator& EagerGraph::MakeOpInner(std::shared_ptr<OpInterface> body,
   if (profiler_optional) {
     auto profiler = *profiler_optional;
     profiler->push(op);
+    // the profiler reads the events later
+    _profiled_ops.insert(op->id());
   }
   // Note: The usage should be marked inside kernels, 
   // but we still mark here in case we forget to do so in some kernels. 
-  NDArray::MarkUsedBy(input_arrays, op->instantiation_ctx().stream());
-  NDArray::MarkUsedBy(output_arrays, op->instantiation_ctx().stream());
-  for (size_t i = 0; i < op->num_outputs(); i++)
-    _preserved_data[op->output(i)->id()] = output_arrays[i];
+  // Arrays used by blocking streams are ready once the kernels return.
+  // Otherwise inputs and outputs are marked at once to share an event, and
+  // the memory pools skip arrays only used by the streams allocating them.
+  if (!stream.is_blocking()) {
+    input_arrays.insert(input_arrays.end(), output_arrays.begin(),
+                        output_arrays.end());
+    NDArray::MarkUsedBy(input_arrays, stream);
+  }
   HT_LOG_DEBUG << op << " outputs: " << output_arrays;
+  for (size_t i = 0; i < op->num_outputs(); i++)
+    PreserveData(op->output(i), std::move(output_arrays[i]));
+  if (op->num_outputs() > 0 && !GetIndexedSlices(op->output(0)).empty())
+    _unset_dense_grads.insert(op->output(0)->id());
   return _op_indexing[op->id()];
 }
 
+EagerDispatch EagerGraph::GetDispatch(Operator& op) {
+  // variables are placed on their own devices
+  if (op->op_indicator() == VARIABLE_OP && op->eager_device().is_undetermined()) {
+    const auto& opimpl = reinterpret_cast<const VariableOpImpl&>(op->body());
+    auto placement = opimpl.device();
+    if (placement.is_undetermined())
+      placement = Device(kCPU);
+    return {placement, get_suggested_stream_index(op),
+            op->body().require_contig_inputs()};
+  }
+  EagerDispatchKey key{op->type(), op->eager_device(),
+                       op->num_inputs() > 0 ? op->input(0)->device()
+                                            : Device()};
+  auto it = _dispatch_cache.find(key);
+  if (it != _dispatch_cache.end())
+    return it->second;
+  Device placement = key.eager_device;
+  if (placement.is_undetermined()) {
+    if (op->num_inputs() > 0) {
+      placement = key.input_device;
+    } else {
+      placement = Device(kCPU);
+    }
+  }
+  EagerDispatch dispatch{placement, get_suggested_stream_index(op),
+                         op->body().require_contig_inputs()};
+  return _dispatch_cache.emplace(std::move(key), dispatch).first->second;
+}
+
+const NDArray& EagerGraph::GetPreservedData(const Tensor& tensor) const {
+  auto it = _preserved_data.find(tensor->id());
+  HT_RUNTIME_ERROR_IF(it == _preserved_data.end())
+    << "Cannot find data for tensor " << tensor;
+  return it->second;
+}
+
+void EagerGraph::SetDenseGradIfUnset(const Tensor& tensor) {
+  if (_unset_dense_grads.empty() || _unset_dense_grads.erase(tensor->id()) == 0)
+    return;
+  auto& producer = _op_indexing[tensor->producer_id()];
+  SetDenseGradient(producer, GetPreservedData(producer->output(1)),
+                   GetPreservedData(producer->output(2)),
+                   _preserved_data[tensor->id()]);
+  // later syncs on the producer cover the dense gradient as well
+  producer->instantiation_ctx().stop[0]->Record(
+    producer->instantiation_ctx().stream());
+}
+
+void EagerGraph::PreserveData(const Tensor& tensor, NDArray data) {
+  if (_recycled_data_nodes.empty()) {
+    _preserved_data[tensor->id()] = std::move(data);
+    return;
+  }
+  auto node = std::move(_recycled_data_nodes.back());
+  _recycled_data_nodes.pop_back();
+  node.key() = tensor->id();
+  node.mapped() = std::move(data);
+  auto ret = _preserved_data.insert(std::move(node));
+  if (!ret.inserted)
+    ret.position->second = std::move(ret.node.mapped());
+}
+
+void EagerGraph::InstantiateOpEvents(OpInstantiationContext& inst_ctx,
+                                     const Device& device) {
+  auto& recycled =
+    _recycled_events[device.is_cuda() ? device : Device(kCPU)];
+  for (auto* event : {&inst_ctx.start[0], &inst_ctx.stop[0]}) {
+    if (!recycled.empty()) {
+      *event = std::move(recycled.back());
+      recycled.pop_back();
+    } else if (device.is_cuda()) {
+      *event = std::make_unique<hetu::impl::CUDAEvent>(device, EVENT_TIMING);
+    } else {
+      *event = std::make_unique<hetu::impl::CPUEvent>(EVENT_TIMING);
+    }
+  }
+}
+
+void EagerGraph::RemoveOp(Operator& op) {
+  if (!_unset_dense_grads.empty() && op->num_outputs() > 0)
+    _unset_dense_grads.erase(op->output(0)->id());
+  _runtime_ctxs.remove(op->id());
+  _op_to_num_destructed_outputs.erase(op->id());
+  auto& inst_ctx = op->instantiation_ctx();
+  if (_profiled_ops.erase(op->id()) == 0) {
+    for (auto* event : {&inst_ctx.start[0], &inst_ctx.stop[0]}) {
+      if (*event == nullptr || (*event)->enable_timing() != EVENT_TIMING)
+        continue;
+      auto& recycled = _recycled_events[(*event)->device()];
+      if (recycled.size() < MAX_NUM_RECYCLED_RECORDS)
+        recycled.push_back(std::move(*event));
+    }
+  }
+  Operator::for_each_output_tensor(op, [&](Tensor& tensor) {
+    auto node = _preserved_data.extract(tensor->id());
+    if (!node.empty() &&
+        _recycled_data_nodes.size() < MAX_NUM_RECYCLED_RECORDS) {
+      node.mapped() = NDArray();
+      _recycled_data_nodes.push_back(std::move(node));
+    }
+  });
+  Graph::RemoveOp(op);
+}
+
 void EagerGraph::ResetVariableDataInner(const Tensor& tensor,
                                         const Initializer& init) {
   init.Init(GetVariableDataInner(tensor));
@@ -113,6 +216,7 @@ void EagerGraph::RemoveTensor(const Tensor& tensor) {
 NDArray EagerGraph::GetOrCompute(Tensor& tensor) {
   // This function should only be called from Tensor.
   // So we do not need to check the existence.
+  SetDenseGradIfUnset(tensor);
   tensor->producer()->Sync();
   return _preserved_data[tensor->id()];
 }
@@ -124,6 +228,7 @@ NDArrayList EagerGraph::Run(const TensorList& fetches,
   std::unordered_set<OpId> to_sync_op_ids;
   to_sync_op_ids.reserve(fetches.size());
   for (auto& fetch : fetches) {
+    SetDenseGradIfUnset(fetch);
     auto it = _preserved_data.find(fetch->id());
     HT_VALUE_ERROR_IF(it == _preserved_data.end())
       << "Tensor " << fetch->name() << " cannot be found in graph " << id();
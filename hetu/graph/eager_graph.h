@@ -5,6 +5,37 @@
 namespace hetu {
 namespace graph {
 
+// Placement and stream of an eager op, which only depend on the op type, the
+// eager device of the op and the device of its first input.
+struct EagerDispatchKey {
+  OpType type;
+  Device eager_device;
+  Device input_device;
+
+  bool operator==(const EagerDispatchKey& other) const {
+    return type == other.type && eager_device == other.eager_device &&
+      input_device == other.input_device;
+  }
+};
+
+struct EagerDispatchKeyHash {
+  size_t operator()(const EagerDispatchKey& key) const {
+    auto hash = std::hash<OpType>()(key.type);
+    // Following boost::hash_combine
+    hash ^= std::hash<Device>()(key.eager_device) + 0x9e3779b9 + (hash << 6) +
+      (hash >> 2);
+    hash ^= std::hash<Device>()(key.input_device) + 0x9e3779b9 + (hash << 6) +
+      (hash >> 2);
+    return hash;
+  }
+};
+
+struct EagerDispatch {
+  Device placement;
+  StreamIndex stream_index;
+  bool require_contig_inputs;
+};
+
 class EagerGraph : public Graph {
  protected:
   friend class Graph;
@@ -26,6 +57,11 @@ class EagerGraph : public Graph {
     return GraphType::EAGER;
   }
 
+  // Eager ops only run a single micro batch, so only one pair of events is
+  // created, and events of removed ops are reused.
+  void InstantiateOpEvents(OpInstantiationContext& inst_ctx,
+                           const Device& device) override;
+
  protected:
   Operator& MakeOpInner(std::shared_ptr<OpInterface> body, TensorList inputs,
                         OpMeta op_meta);
@@ -48,19 +84,42 @@ class EagerGraph : public Graph {
   
   void RemoveTensor(const Tensor& tensor);
 
-  void RemoveOp(Operator& op) override {
-    _runtime_ctxs.remove(op->id());
-    _op_to_num_destructed_outputs.erase(op->id());
-    Graph::RemoveOp(op);
-  }
+  void RemoveOp(Operator& op) override;
   
   void Clear() override {
     _runtime_ctxs.clear();
+    _dispatch_cache.clear();
+    _recycled_events.clear();
+    _recycled_data_nodes.clear();
+    _profiled_ops.clear();
+    _unset_dense_grads.clear();
     Graph::Clear();
   }
 
+  EagerDispatch GetDispatch(Operator& op);
+
+  const NDArray& GetPreservedData(const Tensor& tensor) const;
+
+  void PreserveData(const Tensor& tensor, NDArray data);
+
+  // Sets the dense gradient of an embedding table with indexed slices if it
+  // has not been set yet (see EmbeddingLookupGradientOpImpl).
+  void SetDenseGradIfUnset(const Tensor& tensor);
+
+  static constexpr size_t MAX_NUM_RECYCLED_RECORDS = 1024;
+
   RuntimeContext _runtime_ctxs;
   std::unordered_map<OpId, size_t> _op_to_num_destructed_outputs;
+  std::unordered_map<EagerDispatchKey, EagerDispatch, EagerDispatchKeyHash>
+    _dispatch_cache;
+  // start and stop events of removed ops on each device
+  std::unordered_map<Device, std::vector<std::unique_ptr<Event>>>
+    _recycled_events;
+  // nodes of the preserved data of removed ops
+  std::vector<Tensor2NDArrayMap::node_type> _recycled_data_nodes;
+  std::unordered_set<OpId> _profiled_ops;
+  // dense gradients of embedding tables only computed as indexed slices
+  TensorIdSet _unset_dense_grads;
 };
 
 } // namespace graph
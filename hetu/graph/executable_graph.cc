@@ -4,6 +4,7 @@
 #include "hetu/graph/autocast/autocast.h"
 #include "hetu/graph/recompute/recompute.h"
 #include "hetu/graph/offload/activation_cpu_offload.h"
+#include "hetu/graph/fusion/elementwise_fusion.h"
 #include "hetu/impl/communication/comm_group.h"
 #include "hetu/impl/communication/nccl_comm_group.h"
 #include "hetu/impl/profiler/profiler.h"
@@ -1099,6 +1100,20 @@ void ExecutableGraph::GetExecEnvs() {
     }
   }
 
+  env = std::getenv("HETU_MULTI_TENSOR_UPDATE");
+  if (env != nullptr) {
+    if (std::string(env) == "ON") {
+      _multi_tensor_update = true;
+    } else if (std::string(env) == "OFF") {
+      _multi_tensor_update = false;
+    } else {
+      HT_RUNTIME_ERROR << "Unknown hetu multi-tensor update setting: " + std::string(env);
+    }
+  } else {
+    // 默认在CPU上分组执行dense update
+    _multi_tensor_update = true;
+  }
+
   env = std::getenv("HETU_SHAPE_MISMATCH");
   if (env != nullptr) {
     if (std::string(env) == "NO_MISMATCH") {
@@ -1321,7 +1336,7 @@ NDArrayList ExecutableGraph::CrucialRun(const TensorList& fetches,
   HT_LOG_DEBUG << local_device << ": 2-plus. memory plan[begin]";
   // TODO: cache memory plan
   size_t memory_size = 0;
-  auto memory_plan = GenerateMemoryPlan(memory_size, tasks, tensor2degrees_list, feed_dict);
+  auto memory_plan = GenerateMemoryPlan(memory_size, tasks, feed_dict);
   auto memory_space = NDArray::empty({memory_size}, local_device, kInt64, kComputingStream);
   HT_LOG_DEBUG << "Memory plan is generated and allocated";
   if (_memory_profile_level == MEMORY_PROFILE_LEVEL::INFO)
@@ -1386,6 +1401,8 @@ NDArrayList ExecutableGraph::CrucialRun(const TensorList& fetches,
     for (auto& tensor: _leaf_symbolic_tensor_list) {
       tensor->set_symbolic_shape(GetTensorShape(tensor));
     }
+    // evaluate all symbolic shapes of the micro batch at once
+    _symbol_program.Run();
     // micro batch i>0 reuse: 
     // 0. shared weight which was recved in micro batch 0
     // 1. f32 -> fp16, bf16 weight which was transfered in micro batch 0
@@ -1725,6 +1742,14 @@ NDArrayList ExecutableGraph::Run(const Tensor& loss, const TensorList& fetches,
       InsertContiguousOp(topo_before_contiguous);
       Graph::pop_graph_ctx();
       HT_LOG_DEBUG << local_device << ": [Execution Plan] insert contiguous op end...";
+
+      // fuse elementwise ops on cpu
+      OpRefList topo_before_fusion = Graph::TopoSort(fetches, num_ops(), is_op_computed);
+      HT_LOG_DEBUG << local_device << ": [Execution Plan] elementwise fusion begin...";
+      Graph::push_graph_ctx(id()); // ensure the new ops created in execute_graph
+      ElementwiseFusion::FuseElementwiseOps(topo_before_fusion, fetches);
+      Graph::pop_graph_ctx();
+      HT_LOG_DEBUG << local_device << ": [Execution Plan] elementwise fusion end...";
       is_execute_plan_changed = true;
       break;
     }
@@ -1914,7 +1939,19 @@ NDArrayList ExecutableGraph::Run(const Tensor& loss, const TensorList& fetches,
         }
       }
     }
-    HT_LOG_DEBUG << local_device << ": [Execution Plan] get leaf symbolic tensor list end...";
+    // 将所有symbolic shape编译为一个寄存器程序
+    // 每个micro batch设置完叶子节点后只需线性执行一遍
+    _symbol_program.Clear();
+    for (auto& op_ref : updated_topo) {
+      for (auto& output : op_ref.get()->outputs()) {
+        if (output->symbolic()) {
+          _symbol_program.Add(output->symbolic_shape());
+        }
+      }
+    }
+    HT_LOG_DEBUG << local_device << ": [Execution Plan] get leaf symbolic tensor list end, "
+      << _symbol_program.num_symbols() << " symbols compiled into "
+      << _symbol_program.num_registers() << " registers...";
 
     HT_LOG_DEBUG << local_device << ": [Execution Plan] get transfer & grad map and running-once tensor & op begin...";
     // some special ops only run at the begining
@@ -2,7 +2,9 @@
 
 #include "hetu/graph/graph.h"
 #include "hetu/graph/profiler.h"
+#include "hetu/graph/checkpoint/checkpoint.h"
 #include "hetu/graph/init/initializer.h"
+#include "hetu/graph/memory_plan/memory_planner.h"
 #include "hetu/graph/ops/Communication.h"
 #include "hetu/graph/ops/ParallelAttention.h"
 #include "hetu/graph/ops/group.h"
@@ -68,6 +70,15 @@ class ExecutableGraph : public Graph {
                   const FeedDict& feed_dict = {}, const int num_micro_batches = 1,
                   RunLevel run_level = RunLevel::UPDATE, const double grad_scale = 1);
 
+  // Snapshots the local params and optimizer states into host memory, and
+  // saves them with `writer` in the background. Every bucket is copied as a
+  // whole on kCheckpointStream, after the computation issued so far. Only
+  // the optimizer updates of later runs wait for the copies, so that the
+  // snapshot is consistent while the next steps go on.
+  std::shared_future<void>
+  SaveCheckpointAsync(CheckpointWriter& writer, const std::string& path,
+                      const std::map<std::string, std::string>& metadata = {});
+
   GraphType type() const {
     return GraphType::EXECUTABLE;
   }
@@ -230,6 +241,14 @@ class ExecutableGraph : public Graph {
   }
 
  protected:
+  // Copies the buckets into host snapshots for SaveCheckpointAsync, whose
+  // host bytes have been reserved in `writer`.
+  std::shared_future<void>
+  SnapshotBuckets(CheckpointWriter& writer,
+                  const std::vector<std::shared_ptr<ParamBuffer>>& buckets,
+                  const std::string& path,
+                  const std::map<std::string, std::string>& metadata);
+
   DeviceGroup GetPrevStage();
 
   DeviceGroup GetNextStage();
@@ -282,16 +301,9 @@ class ExecutableGraph : public Graph {
   void GetExecEnvs();
   
   // memory plan相关
-  void AllocMemory(size_t& memory_size, MemoryPlan& memory_plan,
-                            MemoryBlockList& temporary_free_memory, MemoryBlockList& free_memory, MicroBatchTensorId tensor_id,
-                            size_t alloc_memory_size);
-  
-  void FreeMemory(MemoryPlan& memory_plan, MemoryBlockList& free_memory,
-                  MicroBatchTensorId tensor_id);
-  
   MemoryPlan GenerateMemoryPlan(size_t& memory_size, std::vector<std::pair<bool, size_t>> tasks,
-                                std::vector<Tensor2IntMap> tensor2degrees_list,
-                                const FeedDict& feed_dict);
+                                const FeedDict& feed_dict,
+                                MemoryPlanStrategy strategy = MemoryPlanStrategy::BEST_FIT);
 
   // plan相关
   ExecutePlan _execute_plan;
@@ -321,6 +333,7 @@ class ExecutableGraph : public Graph {
   std::unordered_map<DataType, std::shared_ptr<ParamBuffer>> _current_grad_buffer_map;
   std::unordered_map<DataType, std::shared_ptr<ParamBuffer>> _accumulate_grad_buffer_map;
   TensorList _leaf_symbolic_tensor_list;
+  IntSymbolProgram _symbol_program; // 所有exec tensor的symbolic shape
   Tensor2TensorMap _transfer_map; // origin param到transfer param的映射（注意substitute comm op后会对其进行修正）
   Tensor2TensorMap _grad_map; // origin param到grad的映射（注意substitute comm op后会对其进行修正）
   bool _use_current_grad_buffer{false};
@@ -339,6 +352,9 @@ class ExecutableGraph : public Graph {
   // 记录当前图的grad计算完的event
   // 即意味着可以开始切换grad了
   std::unordered_map<TensorId, std::unique_ptr<Event>> _run_grad_events; // 注意这里的TensorId是未substitue comm op后的grad
+  // 记录checkpoint快照拷贝完的event
+  // 之后的optimizer update需要等待它, 以免覆盖还未拷贝的param
+  std::shared_ptr<Event> _checkpoint_snapshot_event;
 
   // 分别记录param op到两个bridge的subgraph的映射
   std::unordered_map<OpId, std::shared_ptr<SubGraph>> _optimize_compute_bridge_subgraph_map;
@@ -357,6 +373,7 @@ class ExecutableGraph : public Graph {
   bool _p2p_single_communicator;
   bool _bridge_single_communicator;
   bool _overlap_grad_reduce;
+  bool _multi_tensor_update;
   int32_t _shape_mismatch_flag;
   int32_t _straggler_flag;
   std::string _straggler_log_file_path;
@@ -0,0 +1,316 @@
+#include "hetu/graph/fusion/elementwise_fusion.h"
+#include "hetu/graph/ops/op_headers.h"
+#include <unordered_set>
+
+namespace hetu {
+namespace graph {
+
+bool ElementwiseFusion::enabled() {
+  char* env = std::getenv("HETU_ELEMENTWISE_FUSION");
+  if (env != nullptr) {
+    if (std::string(env) == "OFF") {
+      return false;
+    } else if (std::string(env) != "ON") {
+      HT_RUNTIME_ERROR << "Unknown hetu elementwise fusion setting: " + std::string(env);
+    }
+  }
+  return true;
+}
+
+bool ElementwiseFusion::GetFusedOpCode(Operator& op, FusedOpCode& code,
+                                       double& value) {
+  const auto& type = op->type();
+  value = 0;
+  if (type == "AddElewiseOp") {
+    code = FusedOpCode::ADD;
+  } else if (type == "SubElewiseOp") {
+    code = FusedOpCode::SUB;
+  } else if (type == "MulElewiseOp") {
+    code = FusedOpCode::MUL;
+  } else if (type == "DivElewiseOp") {
+    code = FusedOpCode::DIV;
+  } else if (type == "AddByConstOp") {
+    code = FusedOpCode::ADD_CONST;
+    value = dynamic_cast<AddByConstOpImpl&>(op->body()).const_value();
+  } else if (type == "SubByConstOp") {
+    code = FusedOpCode::SUB_CONST;
+    value = dynamic_cast<SubByConstOpImpl&>(op->body()).const_value();
+  } else if (type == "SubFromConstOp") {
+    code = FusedOpCode::SUB_FROM_CONST;
+    value = dynamic_cast<SubFromConstOpImpl&>(op->body()).const_value();
+  } else if (type == "MulByConstOp") {
+    code = FusedOpCode::MUL_CONST;
+    value = dynamic_cast<MulByConstOpImpl&>(op->body()).const_value();
+  } else if (type == "DivByConstOp") {
+    code = FusedOpCode::DIV_CONST;
+    value = dynamic_cast<DivByConstOpImpl&>(op->body()).const_value();
+  } else if (type == "DivFromConstOp") {
+    code = FusedOpCode::DIV_FROM_CONST;
+    value = dynamic_cast<DivFromConstOpImpl&>(op->body()).const_value();
+  } else if (type == "PowTensorAndConstOp") {
+    code = FusedOpCode::POW_CONST;
+    value = dynamic_cast<PowTensorAndConstOpImpl&>(op->body()).exponent();
+  } else if (type == "NegateOp") {
+    code = FusedOpCode::NEGATE;
+  } else if (type == "ReciprocalOp") {
+    code = FusedOpCode::RECIPROCAL;
+  } else if (type == "ExpOp") {
+    code = FusedOpCode::EXP;
+  } else if (type == "LogOp") {
+    code = FusedOpCode::LOG;
+  } else if (type == "SqrtOp") {
+    code = FusedOpCode::SQRT;
+  } else if (type == "ReciprocalSqrtOp") {
+    code = FusedOpCode::RSQRT;
+  } else if (type == "AbsOp") {
+    code = FusedOpCode::ABS;
+  } else if (type == "ReluOp") {
+    code = FusedOpCode::RELU;
+  } else if (type == "SigmoidOp") {
+    code = FusedOpCode::SIGMOID;
+  } else if (type == "TanhOp") {
+    code = FusedOpCode::TANH;
+  } else if (type == "GeluOp") {
+    code = FusedOpCode::GELU;
+  } else if (type == "DropoutOp") {
+    code = FusedOpCode::DROPOUT;
+    value = 1 - dynamic_cast<DropoutOpImpl&>(op->body()).keep_prob();
+  } else {
+    return false;
+  }
+  return true;
+}
+
+bool ElementwiseFusion::IsFusibleOp(Operator& op) {
+  FusedOpCode code;
+  double value;
+  if (!GetFusedOpCode(op, code, value))
+    return false;
+  if (!op->placement().is_cpu() || is_inplace_op(op) ||
+      op->num_in_dep_linkers() > 0)
+    return false;
+  // dropout seeds of recomputed ops are shared through the runtime context
+  if (op->op_meta().origin_op_id != -1 ||
+      op->op_meta().get_recompute(op->graph().COMPUTE_STRATEGY_ID,
+                                  op->suggested_hetero_id()))
+    return false;
+  const auto& output = op->output(0);
+  auto dtype = output->dtype();
+  if (dtype != kFloat16 && dtype != kBFloat16 && dtype != kFloat32 &&
+      dtype != kFloat64)
+    return false;
+  for (const auto& input : op->inputs()) {
+    if (input->dtype() != dtype || !input->placement().is_cpu())
+      return false;
+  }
+  return true;
+}
+
+void ElementwiseFusion::FuseElementwiseOps(const OpRefList& topo_order,
+                                           const TensorList& fetches) {
+  if (!enabled())
+    return;
+  std::unordered_map<OpId, size_t> topo_index;
+  for (size_t i = 0; i < topo_order.size(); i++)
+    topo_index[topo_order[i].get()->id()] = i;
+  std::unordered_set<TensorId> fetch_ids;
+  for (const auto& fetch : fetches)
+    fetch_ids.insert(fetch->id());
+
+  std::vector<FusionGroup> groups;
+  std::unordered_map<OpId, size_t> op_to_group;
+
+  // Whether `tensor` (transitively) depends on an op of group `group_id`,
+  // seeing every other group as a single node, i.e., whether putting a
+  // consumer of `tensor` into the group would form a cycle.
+  auto depends_on_group = [&](const Tensor& tensor, size_t group_id) {
+    std::unordered_set<OpId> visited;
+    std::vector<Operator> stack{tensor->producer()};
+    while (!stack.empty()) {
+      auto op = stack.back();
+      stack.pop_back();
+      if (!visited.insert(op->id()).second)
+        continue;
+      auto it = op_to_group.find(op->id());
+      if (it != op_to_group.end() && it->second == group_id)
+        return true;
+      if (it != op_to_group.end()) {
+        for (auto& member : groups[it->second].ops)
+          for (const auto& input : member.get()->inputs())
+            stack.push_back(input->producer());
+      } else {
+        for (const auto& input : op->inputs())
+          stack.push_back(input->producer());
+      }
+    }
+    return false;
+  };
+
+  for (size_t i = 0; i < topo_order.size(); i++) {
+    auto& op = topo_order[i].get();
+    if (!IsFusibleOp(op))
+      continue;
+    if (Operator::any_output_tensor_of(op, [&](const Tensor& output) {
+          return fetch_ids.find(output->id()) != fetch_ids.end();
+        }))
+      continue;
+    const auto& output = op->output(0);
+    // join the group of a producer with the same shape and data type
+    size_t joined = groups.size();
+    for (const auto& input : op->inputs()) {
+      auto it = op_to_group.find(input->producer()->id());
+      if (it == op_to_group.end() || input->shape() != output->shape() ||
+          input->dtype() != output->dtype() ||
+          input->placement() != output->placement())
+        continue;
+      bool acyclic = true;
+      for (const auto& other : op->inputs()) {
+        auto other_it = op_to_group.find(other->producer()->id());
+        if (other_it != op_to_group.end() && other_it->second == it->second)
+          continue;
+        if (depends_on_group(other, it->second)) {
+          acyclic = false;
+          break;
+        }
+      }
+      if (acyclic) {
+        joined = it->second;
+        break;
+      }
+    }
+    if (joined == groups.size())
+      groups.emplace_back();
+    groups[joined].ops.push_back(topo_order[i]);
+    op_to_group[op->id()] = joined;
+  }
+
+  size_t num_fused_ops = 0, num_fused_groups = 0;
+  for (size_t g = 0; g < groups.size(); g++) {
+    if (groups[g].ops.size() < 2)
+      continue;
+    if (EmitFusedGroup(groups[g], op_to_group, g, topo_index)) {
+      num_fused_ops += groups[g].ops.size();
+      num_fused_groups++;
+    }
+  }
+  HT_LOG_DEBUG << "[Fusion] fused " << num_fused_ops
+               << " elementwise ops into " << num_fused_groups << " groups";
+}
+
+bool ElementwiseFusion::EmitFusedGroup(
+  const FusionGroup& group, const std::unordered_map<OpId, size_t>& op_to_group,
+  size_t group_id, std::unordered_map<OpId, size_t>& topo_index) {
+  auto& cur_exec_graph =
+    dynamic_cast<ExecutableGraph&>(Graph::GetGraph(Graph::cur_graph_ctx()));
+  auto in_group = [&](const Operator& op) {
+    auto it = op_to_group.find(op->id());
+    return it != op_to_group.end() && it->second == group_id;
+  };
+  // consumers that are not in the topo order have been deleted by former
+  // passes and will never run
+  auto is_external_consumer = [&](const Operator& op) {
+    return !in_group(op) && topo_index.find(op->id()) != topo_index.end();
+  };
+
+  // registers: external inputs first, then one per op
+  TensorList inputs;
+  std::unordered_map<TensorId, int32_t> tensor_to_reg;
+  for (auto& op_ref : group.ops) {
+    for (const auto& input : op_ref.get()->inputs()) {
+      if (in_group(input->producer()) ||
+          tensor_to_reg.find(input->id()) != tensor_to_reg.end())
+        continue;
+      tensor_to_reg[input->id()] = inputs.size();
+      inputs.push_back(input);
+    }
+  }
+  FusedProgram program;
+  program.num_inputs = inputs.size();
+  for (size_t k = 0; k < group.ops.size(); k++) {
+    auto& op = group.ops[k].get();
+    FusedInstr instr;
+    GetFusedOpCode(op, instr.code, instr.value);
+    instr.lhs = tensor_to_reg.at(op->input(0)->id());
+    if (IsBinaryFusedOp(instr.code)) {
+      instr.rhs = tensor_to_reg.at(op->input(1)->id());
+      // keep the chained register on the left of commutative ops so that
+      // the specialized kernels match more programs
+      if ((instr.code == FusedOpCode::ADD || instr.code == FusedOpCode::MUL) &&
+          instr.lhs < program.num_inputs && instr.rhs >= program.num_inputs)
+        std::swap(instr.lhs, instr.rhs);
+    }
+    tensor_to_reg[op->output(0)->id()] = program.num_inputs + k;
+    program.instrs.push_back(instr);
+  }
+
+  // outputs: tensors consumed outside the group
+  TensorList old_outputs;
+  std::vector<NDArrayMeta> output_metas;
+  for (size_t k = 0; k < group.ops.size(); k++) {
+    auto& op = group.ops[k].get();
+    for (size_t j = 0; j < op->num_outputs(); j++) {
+      const auto& output = op->output(j);
+      if (!Tensor::any_consumer_of(output, [&](const OpRef& consumer) {
+            return is_external_consumer(consumer.get());
+          }))
+        continue;
+      program.outputs.push_back({static_cast<int32_t>(program.num_inputs + k),
+                                 j == 1});
+      old_outputs.push_back(output);
+      output_metas.push_back(output->meta());
+    }
+  }
+  if (old_outputs.empty())
+    return false;
+
+  auto& tail = group.ops.back().get();
+  HT_LOG_DEBUG << "[Fusion] fuse " << group.ops.size() << " ops ending with "
+               << tail << " into " << program;
+  auto outputs = MakeFusedGroupOp(
+    inputs, std::move(program), std::move(output_metas),
+    OpMeta().set_name(tail->name() + "_fused").set_is_deduce_states(false));
+  auto& fused_op = outputs.front()->producer();
+  // groups emitted later may feed the new op
+  topo_index[fused_op->id()] = topo_index.at(tail->id());
+  fused_op->set_fw_op_id(tail->fw_op_id());
+  for (size_t i = 0; i < outputs.size(); i++) {
+    auto& old_output = old_outputs[i];
+    auto& new_output = outputs[i];
+    if (old_output->symbolic())
+      new_output->copy_symbolic_shape(old_output->symbolic_shape());
+    cur_exec_graph.RecordExecTensor(new_output);
+    if (old_output->has_cur_ds_union())
+      new_output->set_cur_ds_union(old_output->cur_ds_union());
+  }
+  if (tail->output(0)->placement_group_union().size() != 0)
+    fused_op->MapToParallelDevices(tail->output(0)->placement_group_union());
+  fused_op->Instantiate(tail->placement(), kComputingStream);
+  auto cur_subgraph = cur_exec_graph.GetSubGraph(tail);
+  if (cur_subgraph != nullptr) {
+    cur_exec_graph.AddOpToSubGraph(fused_op, cur_subgraph->global_name(),
+                                   cur_exec_graph.GetSubGraphOpType(tail));
+  }
+
+  for (size_t i = 0; i < outputs.size(); i++) {
+    auto& old_output = old_outputs[i];
+    for (int c = old_output->num_consumers() - 1; c >= 0; c--) {
+      auto& consumer = old_output->consumer(c);
+      if (!is_external_consumer(consumer))
+        continue;
+      for (int j = 0; j < consumer->num_inputs(); j++) {
+        if (consumer->input(j)->id() == old_output->id())
+          Graph::ReplaceInput(consumer, j, outputs[i]);
+      }
+      for (int j = 0; j < consumer->num_in_dep_linkers(); j++) {
+        if (consumer->in_dep_linker(j)->id() == old_output->id())
+          Graph::ReplaceInDepLinker(consumer, j, outputs[i]);
+      }
+    }
+  }
+  for (auto& op_ref : group.ops)
+    cur_exec_graph.DeleteExecOp(op_ref.get());
+  return true;
+}
+
+} // namespace graph
+} // namespace hetu
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "hetu/graph/common.h"
+#include "hetu/graph/executable_graph.h"
+#include "hetu/graph/graph.h"
+#include "hetu/core/fused_program.h"
+#include <functional>
+
+namespace hetu {
+namespace graph {
+
+// Replaces chains of elementwise (and broadcast) operators on CPU by a single
+// FusedGroupOp, so that intermediate tensors are never written to memory.
+// It is on by default; set HETU_ELEMENTWISE_FUSION=OFF to disable it.
+class ElementwiseFusion {
+ public:
+  static bool enabled();
+
+  static void FuseElementwiseOps(const OpRefList& topo_order,
+                                 const TensorList& fetches);
+
+ protected:
+  struct FusionGroup {
+    OpRefList ops;
+  };
+
+  // Returns the code of `op` if it can be evaluated inside a fused group and
+  // its constant (if any) in `value`.
+  static bool GetFusedOpCode(Operator& op, FusedOpCode& code, double& value);
+
+  static bool IsFusibleOp(Operator& op);
+
+  static bool EmitFusedGroup(const FusionGroup& group,
+                             const std::unordered_map<OpId, size_t>& op_to_group,
+                             size_t group_id,
+                             std::unordered_map<OpId, size_t>& topo_index);
+};
+
+} // namespace graph
+} // namespace hetu
@@ -9,6 +9,8 @@
 #include "hetu/graph/ops/sum.h"
 #include "hetu/graph/ops/Contiguous.h"
 #include "hetu/impl/communication/comm_group.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/impl/stream/CUDAStream.h"
 #include <thread>
 
 namespace hetu {
@@ -103,6 +105,23 @@ Operator& Graph::MakeOp(std::shared_ptr<OpInterface> body, TensorList inputs,
   return op;
 }
 
+void Graph::InstantiateOpEvents(OpInstantiationContext& inst_ctx,
+                                const Device& device) {
+  if (device.is_cuda()) {
+    for (size_t i = 0; i < HT_MAX_NUM_MICRO_BATCHES; i++) {
+      inst_ctx.start[i] =
+        std::make_unique<hetu::impl::CUDAEvent>(device, EVENT_TIMING);
+      inst_ctx.stop[i] =
+        std::make_unique<hetu::impl::CUDAEvent>(device, EVENT_TIMING);
+    }
+  } else {
+    for (size_t i = 0; i < HT_MAX_NUM_MICRO_BATCHES; i++) {
+      inst_ctx.start[i] = std::make_unique<hetu::impl::CPUEvent>(EVENT_TIMING);
+      inst_ctx.stop[i] = std::make_unique<hetu::impl::CPUEvent>(EVENT_TIMING);
+    }
+  }
+}
+
 TensorList Graph::Gradients(const TensorList& ys, const TensorList& xs,
                             const TensorList& grad_ys, int32_t num_ops_hint) {
   for (const auto& y : ys) {
@@ -140,6 +140,11 @@ class Graph {
 
   virtual GraphType type() const = 0;
 
+  // Creates the start and stop events of an op instantiated on `device`, a
+  // pair for every micro batch.
+  virtual void InstantiateOpEvents(OpInstantiationContext& inst_ctx,
+                                   const Device& device);
+
   uint32_t num_ops() const {
     return _op_indexing.size();
   }
@@ -0,0 +1,282 @@
+#include "hetu/graph/memory_plan/memory_planner.h"
+#include <algorithm>
+#include <numeric>
+#include <queue>
+#include <set>
+
+namespace hetu {
+namespace graph {
+
+std::string MemoryPlanStrategy2Str(MemoryPlanStrategy strategy) {
+  switch (strategy) {
+    case MemoryPlanStrategy::BEST_FIT: return "BEST_FIT";
+    case MemoryPlanStrategy::GREEDY_BY_SIZE: return "GREEDY_BY_SIZE";
+    default:
+      HT_VALUE_ERROR << "Unknown memory plan strategy: "
+                     << static_cast<int>(strategy);
+      __builtin_unreachable();
+  }
+}
+
+std::ostream& operator<<(std::ostream& os, const MemoryPlanStats& stats) {
+  os << "MemoryPlanStats(planned_size=" << stats.planned_size
+     << ", peak_live_size=" << stats.peak_live_size
+     << ", naive_size=" << stats.naive_size << ")";
+  return os;
+}
+
+namespace {
+
+// Free blocks indexed both by offset, to merge neighbours, and by size, to
+// find the best fit, so that each operation is O(log n).
+class FreeBlocks {
+ public:
+  // Returns the offset of a block of `size` units, growing the space at
+  // `top` if no free block fits.
+  size_t Alloc(size_t size, size_t& top) {
+    auto it = _by_size.lower_bound({size, 0});
+    if (it != _by_size.end()) {
+      auto [block_size, offset] = *it;
+      Erase(offset, block_size);
+      if (block_size > size)
+        Insert(offset + size, block_size - size);
+      return offset;
+    }
+    // A free block at the top only needs to grow by the missing part.
+    if (!_by_offset.empty()) {
+      auto last = std::prev(_by_offset.end());
+      if (last->first + last->second == top) {
+        size_t offset = last->first;
+        Erase(offset, last->second);
+        top = offset + size;
+        return offset;
+      }
+    }
+    size_t offset = top;
+    top += size;
+    return offset;
+  }
+
+  void Free(size_t offset, size_t size) {
+    auto next = _by_offset.lower_bound(offset);
+    if (next != _by_offset.begin()) {
+      auto prev = std::prev(next);
+      if (prev->first + prev->second == offset) {
+        offset = prev->first;
+        size += prev->second;
+        Erase(prev->first, prev->second);
+      }
+    }
+    next = _by_offset.lower_bound(offset);
+    if (next != _by_offset.end() && offset + size == next->first) {
+      size += next->second;
+      Erase(next->first, next->second);
+    }
+    Insert(offset, size);
+  }
+
+ private:
+  void Insert(size_t offset, size_t size) {
+    _by_offset.emplace(offset, size);
+    _by_size.emplace(size, offset);
+  }
+
+  void Erase(size_t offset, size_t size) {
+    _by_offset.erase(offset);
+    _by_size.erase({size, offset});
+  }
+
+  std::map<size_t, size_t> _by_offset;
+  std::set<std::pair<size_t, size_t>> _by_size;
+};
+
+// Heights of the placed tensors over time, i.e., the lowest free offset at
+// every step. A segment tree over the distinct steps answers the highest
+// point in a range and raises a range to a new height, both in O(log n).
+class Skyline {
+ public:
+  explicit Skyline(size_t num_steps)
+  : _num_steps(MAX(num_steps, size_t(1))),
+    _max(4 * _num_steps, 0),
+    _assign(4 * _num_steps, 0),
+    _has_assign(4 * _num_steps, false) {}
+
+  size_t Max(size_t begin, size_t end) {
+    return Max(1, 0, _num_steps - 1, begin, end);
+  }
+
+  void Assign(size_t begin, size_t end, size_t height) {
+    Assign(1, 0, _num_steps - 1, begin, end, height);
+  }
+
+ private:
+  void Apply(size_t node, size_t height) {
+    _max[node] = height;
+    _assign[node] = height;
+    _has_assign[node] = true;
+  }
+
+  void PushDown(size_t node) {
+    if (_has_assign[node]) {
+      Apply(2 * node, _assign[node]);
+      Apply(2 * node + 1, _assign[node]);
+      _has_assign[node] = false;
+    }
+  }
+
+  size_t Max(size_t node, size_t lo, size_t hi, size_t begin, size_t end) {
+    if (end < lo || hi < begin)
+      return 0;
+    if (begin <= lo && hi <= end)
+      return _max[node];
+    PushDown(node);
+    size_t mid = lo + (hi - lo) / 2;
+    // Not MAX, which would evaluate the recursions twice.
+    return std::max(Max(2 * node, lo, mid, begin, end),
+                    Max(2 * node + 1, mid + 1, hi, begin, end));
+  }
+
+  void Assign(size_t node, size_t lo, size_t hi, size_t begin, size_t end,
+              size_t height) {
+    if (end < lo || hi < begin)
+      return;
+    if (begin <= lo && hi <= end) {
+      Apply(node, height);
+      return;
+    }
+    PushDown(node);
+    size_t mid = lo + (hi - lo) / 2;
+    Assign(2 * node, lo, mid, begin, end, height);
+    Assign(2 * node + 1, mid + 1, hi, begin, end, height);
+    _max[node] = MAX(_max[2 * node], _max[2 * node + 1]);
+  }
+
+  size_t _num_steps;
+  std::vector<size_t> _max;
+  std::vector<size_t> _assign;
+  std::vector<bool> _has_assign;
+};
+
+} // namespace
+
+MemoryPlan MemoryPlanner::Plan(const std::vector<TensorLifetime>& lifetimes,
+                               MemoryPlanStrategy strategy,
+                               MemoryPlanStats* stats) {
+  for (const auto& lifetime : lifetimes)
+    HT_ASSERT(lifetime.begin <= lifetime.end)
+      << "Invalid lifetime [" << lifetime.begin << ", " << lifetime.end
+      << "] of micro batch " << lifetime.tensor_id.first << " tensor "
+      << lifetime.tensor_id.second;
+  size_t planned_size = 0;
+  std::vector<size_t> offsets;
+  switch (strategy) {
+    case MemoryPlanStrategy::BEST_FIT:
+      offsets = PlanBestFit(lifetimes, planned_size);
+      break;
+    case MemoryPlanStrategy::GREEDY_BY_SIZE:
+      offsets = PlanGreedyBySize(lifetimes, planned_size);
+      break;
+    default:
+      HT_NOT_IMPLEMENTED << "Memory plan strategy "
+                         << MemoryPlanStrategy2Str(strategy)
+                         << " is not supported";
+  }
+  MemoryPlan memory_plan;
+  for (size_t i = 0; i < lifetimes.size(); i++)
+    memory_plan[lifetimes[i].tensor_id] = {offsets[i], lifetimes[i].size};
+  if (stats != nullptr) {
+    stats->planned_size = planned_size;
+    stats->peak_live_size = PeakLiveSize(lifetimes);
+    stats->naive_size = 0;
+    for (const auto& lifetime : lifetimes)
+      stats->naive_size += lifetime.size;
+  }
+  return memory_plan;
+}
+
+size_t
+MemoryPlanner::PeakLiveSize(const std::vector<TensorLifetime>& lifetimes) {
+  // Sweep over (step, size change) events; frees of a step come after its
+  // allocations since both tensors are alive at that step.
+  std::vector<std::pair<size_t, int64_t>> events;
+  events.reserve(lifetimes.size() * 2);
+  for (const auto& lifetime : lifetimes) {
+    events.emplace_back(lifetime.begin, lifetime.size);
+    if (lifetime.end != TensorLifetime::FOREVER)
+      events.emplace_back(lifetime.end + 1,
+                          -static_cast<int64_t>(lifetime.size));
+  }
+  std::sort(events.begin(), events.end());
+  int64_t live_size = 0, peak_live_size = 0;
+  for (auto& event : events) {
+    live_size += event.second;
+    peak_live_size = MAX(peak_live_size, live_size);
+  }
+  return peak_live_size;
+}
+
+std::vector<size_t>
+MemoryPlanner::PlanBestFit(const std::vector<TensorLifetime>& lifetimes,
+                           size_t& planned_size) {
+  std::vector<size_t> order(lifetimes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return lifetimes[a].begin < lifetimes[b].begin;
+  });
+  std::vector<size_t> offsets(lifetimes.size(), 0);
+  FreeBlocks free_blocks;
+  // Alive tensors ordered by their last step.
+  using EndAndIndex = std::pair<size_t, size_t>;
+  std::priority_queue<EndAndIndex, std::vector<EndAndIndex>,
+                      std::greater<EndAndIndex>>
+    alive;
+  planned_size = 0;
+  for (auto index : order) {
+    const auto& lifetime = lifetimes[index];
+    while (!alive.empty() && alive.top().first < lifetime.begin) {
+      auto freed = alive.top().second;
+      alive.pop();
+      free_blocks.Free(offsets[freed], lifetimes[freed].size);
+    }
+    offsets[index] = free_blocks.Alloc(lifetime.size, planned_size);
+    alive.emplace(lifetime.end, index);
+  }
+  return offsets;
+}
+
+std::vector<size_t>
+MemoryPlanner::PlanGreedyBySize(const std::vector<TensorLifetime>& lifetimes,
+                                size_t& planned_size) {
+  std::vector<size_t> order(lifetimes.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+    return lifetimes[a].size > lifetimes[b].size;
+  });
+  // Compress the steps to the distinct begins and ends.
+  std::vector<size_t> steps;
+  steps.reserve(lifetimes.size() * 2);
+  for (const auto& lifetime : lifetimes) {
+    steps.push_back(lifetime.begin);
+    steps.push_back(lifetime.end);
+  }
+  std::sort(steps.begin(), steps.end());
+  steps.erase(std::unique(steps.begin(), steps.end()), steps.end());
+  auto step_index = [&](size_t step) {
+    return std::lower_bound(steps.begin(), steps.end(), step) - steps.begin();
+  };
+  std::vector<size_t> offsets(lifetimes.size(), 0);
+  Skyline skyline(steps.size());
+  planned_size = 0;
+  for (auto index : order) {
+    const auto& lifetime = lifetimes[index];
+    size_t begin = step_index(lifetime.begin);
+    size_t end = step_index(lifetime.end);
+    offsets[index] = skyline.Max(begin, end);
+    skyline.Assign(begin, end, offsets[index] + lifetime.size);
+    planned_size = MAX(planned_size, offsets[index] + lifetime.size);
+  }
+  return offsets;
+}
+
+} // namespace graph
+} // namespace hetu
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "hetu/graph/common.h"
+#include <limits>
+
+namespace hetu {
+namespace graph {
+
+enum class MemoryPlanStrategy : int8_t {
+  // Walks the tensors in allocation order and places each one in the
+  // smallest free block that fits. O(n log n).
+  BEST_FIT = 0,
+  // Places the largest tensors first, each right above the highest tensor
+  // already placed within its lifetime. O(n log n). It does not depend on
+  // the allocation order, but never fills the gaps below a placed tensor.
+  GREEDY_BY_SIZE,
+};
+
+std::string MemoryPlanStrategy2Str(MemoryPlanStrategy strategy);
+
+// A tensor that occupies `size` units from step `begin` to step `end`, both
+// inclusive. Two tensors may share memory only if their lifetimes do not
+// overlap.
+struct TensorLifetime {
+  static constexpr size_t FOREVER = std::numeric_limits<size_t>::max();
+
+  MicroBatchTensorId tensor_id;
+  size_t size;
+  size_t begin;
+  size_t end;
+};
+
+struct MemoryPlanStats {
+  // Size of the planned memory space.
+  size_t planned_size{0};
+  // Largest total size of the tensors alive at the same step, which is a
+  // lower bound of `planned_size`.
+  size_t peak_live_size{0};
+  // Size without any reuse, i.e., the sum of all tensor sizes.
+  size_t naive_size{0};
+};
+
+std::ostream& operator<<(std::ostream& os, const MemoryPlanStats& stats);
+
+// Offline memory planner over tensor lifetimes. It knows nothing about the
+// graph, so it works for any model.
+class MemoryPlanner {
+ public:
+  static MemoryPlan Plan(const std::vector<TensorLifetime>& lifetimes,
+                         MemoryPlanStrategy strategy,
+                         MemoryPlanStats* stats = nullptr);
+
+  // Returns the largest total size of the tensors alive at the same step.
+  static size_t PeakLiveSize(const std::vector<TensorLifetime>& lifetimes);
+
+ protected:
+  static std::vector<size_t>
+  PlanBestFit(const std::vector<TensorLifetime>& lifetimes,
+              size_t& planned_size);
+
+  static std::vector<size_t>
+  PlanGreedyBySize(const std::vector<TensorLifetime>& lifetimes,
+                   size_t& planned_size);
+};
+
+} // namespace graph
+} // namespace hetu
@@ -190,9 +190,9 @@ class RuntimeContext {
   }
 
   ~RuntimeContext() {
-    for (auto& kv : _ctxs)
-      delete kv.second;
-    _ctxs.clear();
+    clear();
+    for (auto* op_ctx : _recycled_ctxs)
+      delete op_ctx;
   }
 
   OpRuntimeContext& get_or_create(OpId id) {
@@ -200,7 +200,13 @@ class RuntimeContext {
     if (it != _ctxs.end()) {
       return *it->second;
     } else {
-      auto* op_ctx = new OpRuntimeContext();
+      OpRuntimeContext* op_ctx;
+      if (!_recycled_ctxs.empty()) {
+        op_ctx = _recycled_ctxs.back();
+        _recycled_ctxs.pop_back();
+      } else {
+        op_ctx = new OpRuntimeContext();
+      }
       _ctxs[id] = op_ctx;
       return *op_ctx;
     }
@@ -218,11 +224,22 @@ class RuntimeContext {
     return *_ctxs.at(id);
   }
 
+  // Contexts of removed ops are cleared and kept for the next ops.
   void remove(OpId id) {
-    _ctxs.erase(id);
+    auto it = _ctxs.find(id);
+    if (it == _ctxs.end())
+      return;
+    it->second->clear();
+    if (_recycled_ctxs.size() < MAX_NUM_RECYCLED_CTXS)
+      _recycled_ctxs.push_back(it->second);
+    else
+      delete it->second;
+    _ctxs.erase(it);
   }
 
   void clear() {
+    for (auto& kv : _ctxs)
+      delete kv.second;
     _ctxs.clear();
   }
 
@@ -288,7 +305,9 @@ class RuntimeContext {
   }
 
  private:
+  static constexpr size_t MAX_NUM_RECYCLED_CTXS = 1024;
   std::unordered_map<OpId, OpRuntimeContext*> _ctxs; // 初始化时进行赋值
+  std::vector<OpRuntimeContext*> _recycled_ctxs;
   std::optional<std::reference_wrapper<Tensor2ShapeMap>> _shape_plan; // 初始化时进行赋值，每个tensor必须有一个对应的shape，没有则报错
   Tensor2NDArrayMap _allocation_plan; // 初始化后进行赋值，部分tensor可以有一个对应的allocation，没有则临时分配
   std::unordered_set<OpId> _skipped_plan; // 初始化后进行赋值，部分op不需要sync
@@ -1209,6 +1228,7 @@ DECLARE_OP_INDICATOR_CHECKER(sum, SUM_OP)
 DECLARE_OP_INDICATOR_CHECKER(slice, SLICE_OP)
 DECLARE_OP_INDICATOR_CHECKER(concat, CONCAT_OP)
 DECLARE_OP_INDICATOR_CHECKER(contiguous, CONTIGUOUS_OP)
+DECLARE_OP_INDICATOR_CHECKER(fused_group, FUSED_GROUP_OP)
 DECLARE_OP_INDICATOR_CHECKER(loss, LOSS_OP)
 DECLARE_OP_INDICATOR_CHECKER(loss_gradient, LOSS_GRADIENT_OP)
 DECLARE_OP_INDICATOR_CHECKER(optimizer_update, OPTIMIZER_UPDATE_OP)
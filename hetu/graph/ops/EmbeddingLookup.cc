@@ -20,8 +20,14 @@ void EmbeddingLookupOpImpl::DoCompute(Operator& op,
 
 TensorList EmbeddingLookupOpImpl::DoGradient(Operator& op,
                                              const TensorList& grad_outputs) const {
+  // Eager CPU training updates the looked-up rows only. Other graphs keep
+  // dense gradients, which they reduce and accumulate across micro-batches.
+  bool indexed_slices = op->graph().type() == GraphType::EAGER &&
+                        op->instantiation_ctx().placement.is_cpu() &&
+                        op->input(1)->dtype() == kInt64;
   auto grad_input = op->requires_grad(0) ? MakeEmbeddingLookupGradientOp(grad_outputs.at(0), op->input(1), op->output(0), op->input(0), 
-                                           _multi_offset, op->grad_op_meta().set_name(op->grad_name()))
+                                           _multi_offset, op->grad_op_meta().set_name(op->grad_name()),
+                                           indexed_slices)
                                         : Tensor();
   return {grad_input, Tensor()};
 }
@@ -79,6 +85,21 @@ void EmbeddingLookupGradientOpImpl::DoCompute(Operator& op,
   NDArray id_offset = inputs.at(1);
   if (offset(op) != 0) 
     id_offset = NDArray::sub(inputs.at(1), offset(op), op->instantiation_ctx().stream_index);
+  if (_indexed_slices) {
+    auto stream_index = op->instantiation_ctx().stream_index;
+    NDArray grad_output = inputs.at(0);
+    if (!grad_output->is_contiguous())
+      grad_output = NDArray::contiguous(grad_output, stream_index);
+    if (!id_offset->is_contiguous())
+      id_offset = NDArray::contiguous(id_offset, stream_index);
+    HT_DISPATCH_KERNEL_CPU_ONLY(
+      op->instantiation_ctx().placement.type(), type(), hetu::impl::EmbeddingLookupSparseGradient,
+      grad_output, id_offset, outputs.at(0)->shape(0), outputs.at(1), outputs.at(2),
+      op->instantiation_ctx().stream());
+    // the dense gradient is set lazily (see SetDenseGradient), since the
+    // sparse updates do not read it and zeroing it costs the whole table
+    return;
+  }
   HT_DISPATCH_KERNEL_CPU_AND_CUDA(
     op->instantiation_ctx().placement.type(), type(), hetu::impl::EmbeddingLookupGradient,
     inputs.at(0), id_offset, outputs.at(0), op->instantiation_ctx().stream());
@@ -88,7 +109,10 @@ HTShapeList
 EmbeddingLookupGradientOpImpl::DoInferShape(Operator& op,
                                             const HTShapeList& input_shapes,
                                             RuntimeContext &ctx) const {
-  return {input_shapes.at(3)};
+  if (!_indexed_slices)
+    return {input_shapes.at(3)};
+  int64_t num_ids = NumEl(input_shapes.at(1));
+  return {input_shapes.at(3), {num_ids}, {num_ids, input_shapes.at(3).at(1)}};
 }
 
 void EmbeddingLookupGradientOpImpl::DoDeduceStates(const TensorList& inputs, TensorList& outputs, 
@@ -131,10 +155,34 @@ Tensor MakeEmbeddingLookupOp(Tensor input, Tensor id, std::vector<int64_t> multi
           std::move(op_meta))->output(0);
 }
 
+TensorList GetIndexedSlices(const Tensor& grad) {
+  const auto& producer = grad->producer();
+  if (producer->type() != quote(EmbeddingLookupGradientOp) ||
+      grad->id() != producer->output(0)->id())
+    return {};
+  const auto& impl =
+    reinterpret_cast<const EmbeddingLookupGradientOpImpl&>(producer->body());
+  if (!impl.indexed_slices())
+    return {};
+  return {producer->output(1), producer->output(2)};
+}
+
+void SetDenseGradient(Operator& op, const NDArray& unique_ids,
+                      const NDArray& grad_values, NDArray& input_grad) {
+  HT_ASSERT(op->type() == quote(EmbeddingLookupGradientOp) &&
+            reinterpret_cast<const EmbeddingLookupGradientOpImpl&>(op->body())
+              .indexed_slices())
+    << "Op " << op << " does not output indexed slices";
+  HT_DISPATCH_KERNEL_CPU_ONLY(
+    op->instantiation_ctx().placement.type(), op->type(), hetu::impl::IndexedSlicesToDense,
+    unique_ids, grad_values, input_grad, op->instantiation_ctx().stream());
+}
+
 Tensor MakeEmbeddingLookupGradientOp(Tensor grad_output, Tensor id, Tensor ori_input, Tensor input,
-                                     std::vector<int64_t> multi_offset, OpMeta op_meta) {
+                                     std::vector<int64_t> multi_offset, OpMeta op_meta,
+                                     bool indexed_slices) {
   return Graph::MakeOp(
-          std::make_shared<EmbeddingLookupGradientOpImpl>(multi_offset),
+          std::make_shared<EmbeddingLookupGradientOpImpl>(multi_offset, indexed_slices),
           {std::move(grad_output), std::move(id), std::move(ori_input), std::move(input)},
           std::move(op_meta))->output(0);
 }
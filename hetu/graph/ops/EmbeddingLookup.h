@@ -74,17 +74,42 @@ protected:
 
 Tensor MakeEmbeddingLookupOp(Tensor input, Tensor id, std::vector<int64_t> multi_offset={0}, OpMeta op_meta = OpMeta());
 
+// With `indexed_slices`, the op also outputs the gradient as indexed slices,
+// i.e., the distinct ids padded with -1 and the summed gradient row of each
+// (see EmbeddingLookupSparseGradientCpu), so that optimizers only update the
+// looked-up rows. The dense gradient is then left unset by DoCompute, and the
+// graph sets it with SetDenseGradient once an op other than the sparse
+// updates or a fetch needs it.
+// Only eager graphs on CPU with int64 ids make such ops. Executable graphs
+// reduce gradients across devices and accumulate them across micro batches
+// with dense ops, and the CPU lookup kernels only take int64 ids.
 class EmbeddingLookupGradientOpImpl : public OpInterface {
  public:
-  EmbeddingLookupGradientOpImpl(std::vector<int64_t> multi_offset, OpMeta op_meta = OpMeta())
-  : OpInterface(quote(EmbeddingLookupGradientOp)), _multi_offset(multi_offset) {
+  EmbeddingLookupGradientOpImpl(std::vector<int64_t> multi_offset,
+                                bool indexed_slices = false,
+                                OpMeta op_meta = OpMeta())
+  : OpInterface(quote(EmbeddingLookupGradientOp)), _multi_offset(multi_offset),
+    _indexed_slices(indexed_slices) {
   }
 
 protected:
   std::vector<NDArrayMeta>
   DoInferMeta(const TensorList& inputs) const override {
     NDArrayMeta output_meta = inputs[3]->meta();
-    return {output_meta};
+    if (!_indexed_slices)
+      return {output_meta};
+    HTShape ids_shape, values_shape;
+    if (inputs[1]->has_shape() && inputs[3]->has_shape()) {
+      ids_shape = {static_cast<int64_t>(inputs[1]->numel())};
+      values_shape = {ids_shape[0], inputs[3]->shape(1)};
+    }
+    NDArrayMeta ids_meta = NDArrayMeta().set_dtype(kInt64)
+                                        .set_shape(ids_shape)
+                                        .set_device(inputs[1]->device());
+    NDArrayMeta values_meta = NDArrayMeta().set_dtype(inputs[3]->dtype())
+                                           .set_shape(values_shape)
+                                           .set_device(inputs[3]->device());
+    return {output_meta, ids_meta, values_meta};
   }
 
   void DoDeduceStates(const TensorList& inputs, TensorList& outputs, 
@@ -105,7 +130,12 @@ protected:
   }
 
   bool operator==(const OpInterface& rhs) const override {
-    return OpInterface::operator==(rhs);
+    if (OpInterface::operator==(rhs)) {
+      const auto& rhs_ =
+        reinterpret_cast<const EmbeddingLookupGradientOpImpl&>(rhs);
+      return indexed_slices() == rhs_.indexed_slices();
+    }
+    return false;
   }
 
   // for multi ds
@@ -120,12 +150,27 @@ protected:
     }
   }
 
+  bool indexed_slices() const {
+    return _indexed_slices;
+  }
+
  protected:
   std::vector<int64_t> _multi_offset;
+  bool _indexed_slices;
 };
 
+// The unique ids and gradient rows of `grad` if it is the dense output of an
+// EmbeddingLookupGradientOp with indexed slices, and an empty list otherwise.
+TensorList GetIndexedSlices(const Tensor& grad);
+
+// Scatters the indexed slices of `op`, an EmbeddingLookupGradientOp with
+// indexed slices, into its dense gradient `input_grad` on the stream of `op`.
+void SetDenseGradient(Operator& op, const NDArray& unique_ids,
+                      const NDArray& grad_values, NDArray& input_grad);
+
 Tensor MakeEmbeddingLookupGradientOp(Tensor grad_output, Tensor id, Tensor ori_input, Tensor input,
-                                     std::vector<int64_t> multi_offset, OpMeta op_meta = OpMeta());
+                                     std::vector<int64_t> multi_offset, OpMeta op_meta = OpMeta(),
+                                     bool indexed_slices = false);
 
 } // namespace graph
 } // namespace hetu
@@ -194,7 +194,7 @@ void FusedLayerNormOpImpl::DoDeduceHeterProp(const std::vector<int32_t>& inputs_
 void FusedLayerNormGradientOpImpl::DoCompute(Operator& op,const NDArrayList& inputs,
                                        NDArrayList& outputs,
                                        RuntimeContext& ctx) const {
-  HT_DISPATCH_KERNEL_CUDA_ONLY(
+  HT_DISPATCH_KERNEL_CPU_AND_CUDA(
     op->instantiation_ctx().placement.type(), type(), hetu::impl::FusedLayerNormGradient, inputs.at(0),
     inputs.at(1), inputs.at(2), inputs.at(3), outputs.at(0), outputs.at(1),
     outputs.at(2), inputs.at(4), inputs.at(5), normalized_shape().size(),
@@ -1036,11 +1036,11 @@ void ParallelAttentionOpImpl::DoCompute(Operator& op,
                                                    kFloat,
                                                    stream_idx);
       attn_ctx()->acc_out = reshaped_output;
-      HT_DISPATCH_KERNEL_CUDA_ONLY(op->instantiation_ctx().placement.type(), type(), hetu::impl::FlashAttn,
-                                   q, k, v, attn_ctx()->acc_out, q,
-                                   k, v, attn_ctx()->acc_out, attn_ctx()->acc_softmax_lse,
-                                   empty_ndarray, attn_ctx()->rng_state_list.at(0), p_dropout(), softmax_scale_,
-                                   true, return_softmax(), op->instantiation_ctx().stream());
+      HT_DISPATCH_KERNEL_CPU_AND_CUDA(op->instantiation_ctx().placement.type(), type(), hetu::impl::FlashAttn,
+                                      q, k, v, attn_ctx()->acc_out, q,
+                                      k, v, attn_ctx()->acc_out, attn_ctx()->acc_softmax_lse,
+                                      empty_ndarray, attn_ctx()->rng_state_list.at(0), p_dropout(), softmax_scale_,
+                                      true, return_softmax(), op->instantiation_ctx().stream());
     } else {
       HT_ASSERT(inputs.size() == 3)
         << "packing should have 3 inputs: qkv, cu_seqlens_q and cu_seqlens_k";
@@ -1058,13 +1058,13 @@ void ParallelAttentionOpImpl::DoCompute(Operator& op,
                                                    kFloat,
                                                    stream_idx);
       attn_ctx()->acc_out = NDArray::view(reshaped_output, {batch_size_mul_seq_len, q_num_heads, _head_dim});
-      HT_DISPATCH_KERNEL_CUDA_ONLY(op->instantiation_ctx().placement.type(), type(), hetu::impl::FlashAttnVarlen, 
-                                   attn_ctx()->q, attn_ctx()->k, attn_ctx()->v, cu_seqlens_q, cu_seqlens_k, attn_ctx()->acc_out, attn_ctx()->q,
-                                   attn_ctx()->k, attn_ctx()->v, attn_ctx()->acc_out, attn_ctx()->acc_softmax_lse,
-                                   empty_ndarray, attn_ctx()->rng_state_list.at(0), 
-                                   max_seqlen_q(), max_seqlen_k(), 
-                                   p_dropout(), softmax_scale_, false,
-                                   true, return_softmax(), op->instantiation_ctx().stream());
+      HT_DISPATCH_KERNEL_CPU_AND_CUDA(op->instantiation_ctx().placement.type(), type(), hetu::impl::FlashAttnVarlen, 
+                                      attn_ctx()->q, attn_ctx()->k, attn_ctx()->v, cu_seqlens_q, cu_seqlens_k, attn_ctx()->acc_out, attn_ctx()->q,
+                                      attn_ctx()->k, attn_ctx()->v, attn_ctx()->acc_out, attn_ctx()->acc_softmax_lse,
+                                      empty_ndarray, attn_ctx()->rng_state_list.at(0), 
+                                      max_seqlen_q(), max_seqlen_k(), 
+                                      p_dropout(), softmax_scale_, false,
+                                      true, return_softmax(), op->instantiation_ctx().stream());
       // HT_LOG_INFO << "Varlen attn cu_seqlens_q is " << cu_seqlens_q;
     }
   }
@@ -1226,12 +1226,12 @@ void ParallelAttentionGradientOpImpl::DoCompute(Operator& op, const NDArrayList&
       << "there should only be one single rng_state when cp is off"
       << ", but for attn ctx of mirco batch " << _attn_ctx_num << ", the rng_state num is " << attn_ctx()->rng_state_list.size();
     if (!_packing) {
-      HT_DISPATCH_KERNEL_CUDA_ONLY(op->instantiation_ctx().placement.type(), type(),
-                                   hetu::impl::FlashAttnGradient, reshaped_grad_output,
-                                   attn_ctx()->q, attn_ctx()->k, attn_ctx()->v, attn_ctx()->acc_out,
-                                   attn_ctx()->acc_softmax_lse, attn_ctx()->rng_state_list.at(0), 
-                                   dq, dk, dv, p_dropout(), softmax_scale_,
-                                   true, op->instantiation_ctx().stream());
+      HT_DISPATCH_KERNEL_CPU_AND_CUDA(op->instantiation_ctx().placement.type(), type(),
+                                      hetu::impl::FlashAttnGradient, reshaped_grad_output,
+                                      attn_ctx()->q, attn_ctx()->k, attn_ctx()->v, attn_ctx()->acc_out,
+                                      attn_ctx()->acc_softmax_lse, attn_ctx()->rng_state_list.at(0), 
+                                      dq, dk, dv, p_dropout(), softmax_scale_,
+                                      true, op->instantiation_ctx().stream());
       // flash-attn already supports uncontiguous outputs
       /*
       // concat dq, dk, dv to reshaped_grad_input
@@ -1254,12 +1254,12 @@ void ParallelAttentionGradientOpImpl::DoCompute(Operator& op, const NDArrayList&
       auto dk_new = NDArray::view(NDArray::contiguous(dk), {batch_size_mul_seq_len, kv_num_heads, _head_dim});
       auto dv_new = NDArray::view(NDArray::contiguous(dv), {batch_size_mul_seq_len, kv_num_heads, _head_dim});
       reshaped_grad_output = NDArray::view(reshaped_grad_output, {batch_size_mul_seq_len, q_num_heads, _head_dim});
-      HT_DISPATCH_KERNEL_CUDA_ONLY(op->instantiation_ctx().placement.type(), type(),
-                                   hetu::impl::FlashAttnVarlenGradient, reshaped_grad_output,
-                                   attn_ctx()->q, attn_ctx()->k, attn_ctx()->v, cu_seqlens_q, cu_seqlens_k, 
-                                   attn_ctx()->acc_out, attn_ctx()->acc_softmax_lse, attn_ctx()->rng_state_list.at(0), 
-                                   dq_new, dk_new, dv_new, max_seqlen_q(), max_seqlen_k(), p_dropout(), softmax_scale_, false,
-                                   true, op->instantiation_ctx().stream());
+      HT_DISPATCH_KERNEL_CPU_AND_CUDA(op->instantiation_ctx().placement.type(), type(),
+                                      hetu::impl::FlashAttnVarlenGradient, reshaped_grad_output,
+                                      attn_ctx()->q, attn_ctx()->k, attn_ctx()->v, cu_seqlens_q, cu_seqlens_k, 
+                                      attn_ctx()->acc_out, attn_ctx()->acc_softmax_lse, attn_ctx()->rng_state_list.at(0), 
+                                      dq_new, dk_new, dv_new, max_seqlen_q(), max_seqlen_k(), p_dropout(), softmax_scale_, false,
+                                      true, op->instantiation_ctx().stream());
       dq_new = NDArray::view(dq_new, dq_shape);
       dk_new = NDArray::view(dk_new, dk_shape);
       dv_new = NDArray::view(dv_new, dv_shape);
@@ -299,7 +299,7 @@ void FusedRMSNormOpImpl::DoDeduceHeterProp(const std::vector<int32_t>& inputs_he
 void FusedRMSNormGradientOpImpl::DoCompute(Operator& op,const NDArrayList& inputs,
                                            NDArrayList& outputs,
                                            RuntimeContext& ctx) const {
-  HT_DISPATCH_KERNEL_CUDA_ONLY(
+  HT_DISPATCH_KERNEL_CPU_AND_CUDA(
     op->instantiation_ctx().placement.type(), type(), hetu::impl::FusedRMSNormGradient, inputs.at(0),
     inputs.at(1), inputs.at(2), outputs.at(0), outputs.at(1),
     inputs.at(3),normalized_shape().size(),
@@ -37,9 +37,9 @@ void RotaryOpImpl::DoCompute(Operator& op,
   }
   NDArray cos_ = NDArray::unsqueeze(NDArray::slice(cos, HTShape{0, 0}, HTShape{x->shape(1), cos->shape(2)}), 1);
   NDArray sin_ = NDArray::unsqueeze(NDArray::slice(sin, HTShape{0, 0}, HTShape{x->shape(1), sin->shape(2)}), 1);
-  HT_DISPATCH_KERNEL_CUDA_ONLY(op->instantiation_ctx().placement.type(), type(),
-                               hetu::impl::Rotary, x1, x2, cos_, sin_, o1, o2,
-                               false, op->instantiation_ctx().stream());
+  HT_DISPATCH_KERNEL_CPU_AND_CUDA(op->instantiation_ctx().placement.type(), type(),
+                                  hetu::impl::Rotary, x1, x2, cos_, sin_, o1, o2,
+                                  false, op->instantiation_ctx().stream());
   if (!inplace()) {
     HTShape begin_pos_remain = {0, 0, 0, 2 * rotary_dim};
     HTShape remain_size = x->shape();
@@ -103,9 +103,9 @@ void RotaryGradientOpImpl::DoCompute(Operator& op, const NDArrayList& inputs, ND
   }
   NDArray cos_ = NDArray::unsqueeze(NDArray::slice(cos, HTShape{0, 0}, HTShape{dout->shape(1), cos->shape(2)}), 1);
   NDArray sin_ = NDArray::unsqueeze(NDArray::slice(sin, HTShape{0, 0}, HTShape{dout->shape(1), sin->shape(2)}), 1);
-  HT_DISPATCH_KERNEL_CUDA_ONLY(op->instantiation_ctx().placement.type(), type(),
-                               hetu::impl::Rotary, dout1, dout2, cos_, sin_, dx1, dx2,
-                               true, op->instantiation_ctx().stream());
+  HT_DISPATCH_KERNEL_CPU_AND_CUDA(op->instantiation_ctx().placement.type(), type(),
+                                  hetu::impl::Rotary, dout1, dout2, cos_, sin_, dx1, dx2,
+                                  true, op->instantiation_ctx().stream());
   if (!inplace()) {
     HTShape begin_pos_remain = {0, 0, 0, 2 * rotary_dim};
     HTShape remain_size = dout->shape();
@@ -95,7 +95,7 @@ void VocabParallelCrossEntropyOpImpl::DoCompute(
     auto vocab_end_index = vocab_start_index + vocab_size_per_partition;
     HTShape predict_logits_shape = {preds->shape(0), 1};
     NDArray predict_logits_partial = NDArray::empty(predict_logits_shape, preds->device(), preds->dtype()); // cuda malloc
-    HT_DISPATCH_KERNEL_CUDA_ONLY(op->instantiation_ctx().placement.type(), type(),
+    HT_DISPATCH_KERNEL_CPU_AND_CUDA(op->instantiation_ctx().placement.type(), type(),
                                 hetu::impl::VocabParallelCrossEntropy, vocab_parallel_logits,
                                 labels, vocab_start_index, vocab_end_index, ignored_index(),
                                 predict_logits_partial, log_sum_exp_logits, op->instantiation_ctx().stream());
@@ -207,7 +207,7 @@ void VocabParallelCrossEntropyGradientOpImpl::DoCompute(
     auto vocab_end_index = vocab_start_index + vocab_size_per_partition;
     NDArray softmax = ctx.get_or_create(op->fw_op_id()).pop_ndarray("softmax");
 
-    HT_DISPATCH_KERNEL_CUDA_ONLY(op->instantiation_ctx().placement.type(), type(),
+    HT_DISPATCH_KERNEL_CPU_AND_CUDA(op->instantiation_ctx().placement.type(), type(),
                                 hetu::impl::VocabParallelCrossEntropyGradient, softmax,
                                 labels, vocab_start_index, vocab_end_index, ignored_index(), 
                                 broadcasted, outputs.at(0), op->instantiation_ctx().stream());
@@ -2,6 +2,7 @@
 #include "hetu/graph/headers.h"
 #include "hetu/impl/stream/CPUStream.h"
 #include "hetu/impl/stream/CUDAStream.h"
+#include "hetu/impl/memory/HostStagingPool.h"
 
 namespace hetu {
 namespace graph {
@@ -17,11 +18,7 @@ bool DataH2DOpImpl::DoInstantiate(Operator& op, const Device& placement,
   auto& inst_ctx = op->instantiation_ctx();
   inst_ctx.placement = placement;
   inst_ctx.stream_index = stream_id;
-  auto enable_timing = op->graph().EVENT_TIMING;
-  for (size_t i = 0; i < HT_MAX_NUM_MICRO_BATCHES; i++) {
-    inst_ctx.start[i] = std::make_unique<hetu::impl::CUDAEvent>(inst_ctx.placement, enable_timing);
-    inst_ctx.stop[i] = std::make_unique<hetu::impl::CUDAEvent>(inst_ctx.placement, enable_timing);
-  }
+  op->graph().InstantiateOpEvents(inst_ctx, inst_ctx.placement);
   op->output(0)->set_placement(placement);
   return true;
 }
@@ -52,11 +49,7 @@ bool DataD2HOpImpl::DoInstantiate(Operator& op, const Device& placement,
   auto& inst_ctx = op->instantiation_ctx();
   inst_ctx.placement = op->input(0)->placement();
   inst_ctx.stream_index = stream_id;
-  auto enable_timing = op->graph().EVENT_TIMING;
-  for (size_t i = 0; i < HT_MAX_NUM_MICRO_BATCHES; i++) {
-    inst_ctx.start[i] = std::make_unique<hetu::impl::CUDAEvent>(op->input(0)->placement(), enable_timing);
-    inst_ctx.stop[i] = std::make_unique<hetu::impl::CUDAEvent>(op->input(0)->placement(), enable_timing);
-  }
+  op->graph().InstantiateOpEvents(inst_ctx, inst_ctx.placement);
   op->output(0)->set_placement(placement);
   return true;
 }
@@ -68,6 +61,30 @@ TensorList DataD2HOpImpl::DoGradient(Operator& op,
                                : Tensor()};
 }
 
+NDArrayList DataD2HOpImpl::DoAllocOutputs(Operator& op,
+                                          const NDArrayList& inputs,
+                                          RuntimeContext& runtime_ctx) const {
+  if (!op->op_meta().is_offload)
+    return OpInterface::DoAllocOutputs(op, inputs, runtime_ctx);
+  // Note: the instantiated placement of D2H ops is the source device,
+  // so the host output is allocated explicitly here.
+  auto output_id = op->output(0)->id();
+  if (runtime_ctx.has_shape_plan() &&
+      runtime_ctx.has_runtime_allocation(output_id))
+    return {runtime_ctx.get_runtime_allocation(output_id)};
+  const auto& shape = runtime_ctx.has_shape_plan()
+    ? runtime_ctx.get_runtime_shape(output_id)
+    : inputs.front()->shape();
+  auto meta = NDArrayMeta()
+                .set_device(device())
+                .set_dtype(op->output(0)->dtype())
+                .set_shape(shape);
+  auto storage = std::make_shared<NDArrayStorage>(
+    hetu::impl::GetHostStagingPool().AllocDataSpace(
+      meta.numel() * DataType2Size(meta.dtype), inputs.front()->device()));
+  return {NDArray(meta, storage)};
+}
+
 void DataD2HOpImpl::DoCompute(Operator& op, const NDArrayList& inputs,
                               NDArrayList& outputs,
                               RuntimeContext& runtime_ctx) const {
@@ -82,6 +82,10 @@ class DataD2HOpImpl final : public OpInterface {
     return {input_shapes.front()};
   }
 
+  // Offloaded activations are staged in the pinned host staging pool.
+  NDArrayList DoAllocOutputs(Operator& op, const NDArrayList& inputs,
+                             RuntimeContext& runtime_ctx) const override;
+
   void DoCompute(Operator& op, const NDArrayList& inputs, NDArrayList& outputs,
                  RuntimeContext& runtime_ctx) const override;
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "hetu/core/stream.h"
+#include "hetu/core/fused_program.h"
 
 namespace hetu {
 namespace impl {
@@ -24,6 +25,9 @@ DECLARE_KERNEL_CPU_AND_CUDA(Abs, const NDArray&, NDArray&, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(AbsGradient, const NDArray&, const NDArray&, NDArray&, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(Adam, const NDArray&, NDArray&, NDArray&, NDArray&, NDArray&,
                             float, float, float, float, float, bool, const Stream&);
+DECLARE_KERNEL_CPU(AdamUpdateIndexedSlices, const NDArray&, const NDArray&, NDArray&,
+                   NDArray&, NDArray&, NDArray&, float, float, float, float,
+                   float, bool, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(Arange, double, double, NDArray&, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(ArraySet, NDArray&, double, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(AddConst, const NDArray&, double, NDArray&,
@@ -158,40 +162,44 @@ DECLARE_KERNEL_CPU_AND_CUDA(EmbeddingLookup, const NDArray&, const NDArray&,
                             NDArray&, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(EmbeddingLookupGradient, const NDArray&,
                             const NDArray&, NDArray&, const Stream&);
+DECLARE_KERNEL_CPU(EmbeddingLookupSparseGradient, const NDArray&, const NDArray&,
+                   int64_t, NDArray&, NDArray&, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(Exp, const NDArray&, NDArray&, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(Eye, NDArray&, const Stream&);
-DECLARE_KERNEL_CUDA(FlashAttn, const NDArray&, const NDArray&, const NDArray&,        
-                    NDArray&, NDArray&, NDArray&, NDArray&, NDArray&, NDArray&,     
-                    NDArray&, NDArray&, const float, const float,
-                    const bool, const bool, const Stream&);
-DECLARE_KERNEL_CUDA(FlashAttnGradient, const NDArray&, const NDArray&, const NDArray&,        
-                    const NDArray&, NDArray&, NDArray&, NDArray&, NDArray&, NDArray&,     
-                    NDArray&, const float, const float, const bool, const Stream&);
-DECLARE_KERNEL_CUDA(FlashAttnVarlen, const NDArray&, const NDArray&,const NDArray&,
-                    const NDArray&, const NDArray&, NDArray&, NDArray&, NDArray&, 
-                    NDArray&, NDArray&, NDArray&, NDArray&, NDArray& rng_state,
-                    const int, const int, const float, const float, const bool, 
-                    const bool, const bool, const Stream&);
-DECLARE_KERNEL_CUDA(FlashAttnVarlenGradient, const NDArray&, const NDArray&, const NDArray&,        
-                    const NDArray&, const NDArray&, const NDArray&, 
-                    NDArray&, NDArray&, NDArray&, NDArray&, NDArray&,     
-                    NDArray&, const int, const int, const float, const float, 
-                    const bool, const bool, const Stream&);
+DECLARE_KERNEL_CPU_AND_CUDA(FlashAttn, const NDArray&, const NDArray&, const NDArray&,        
+                            NDArray&, NDArray&, NDArray&, NDArray&, NDArray&, NDArray&,     
+                            NDArray&, NDArray&, const float, const float,
+                            const bool, const bool, const Stream&);
+DECLARE_KERNEL_CPU_AND_CUDA(FlashAttnGradient, const NDArray&, const NDArray&, const NDArray&,        
+                            const NDArray&, NDArray&, NDArray&, NDArray&, NDArray&, NDArray&,     
+                            NDArray&, const float, const float, const bool, const Stream&);
+DECLARE_KERNEL_CPU_AND_CUDA(FlashAttnVarlen, const NDArray&, const NDArray&,const NDArray&,
+                            const NDArray&, const NDArray&, NDArray&, NDArray&, NDArray&, 
+                            NDArray&, NDArray&, NDArray&, NDArray&, NDArray& rng_state,
+                            const int, const int, const float, const float, const bool, 
+                            const bool, const bool, const Stream&);
+DECLARE_KERNEL_CPU_AND_CUDA(FlashAttnVarlenGradient, const NDArray&, const NDArray&, const NDArray&,        
+                            const NDArray&, const NDArray&, const NDArray&, 
+                            NDArray&, NDArray&, NDArray&, NDArray&, NDArray&,     
+                            NDArray&, const int, const int, const float, const float, 
+                            const bool, const bool, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(Floor, const NDArray&, NDArray&, const Stream&);
-DECLARE_KERNEL_CUDA(FusedLayerNorm, const NDArray&, const NDArray&,
-                    const NDArray&, NDArray&, NDArray&, NDArray&,
-                    int64_t, float,
-                    const Stream&);
-DECLARE_KERNEL_CUDA(FusedLayerNormGradient, const NDArray&, const NDArray&,
-                    const NDArray&, const NDArray&, NDArray&, NDArray&, NDArray&,
-                    const NDArray&, const NDArray&, int64_t, float, bool,
-                    const Stream&);
-DECLARE_KERNEL_CUDA(FusedRMSNorm, const NDArray&, const NDArray&,
-                    NDArray&, NDArray&, int64_t, float,
-                    const Stream&);
-DECLARE_KERNEL_CUDA(FusedRMSNormGradient, const NDArray&, const NDArray&,
-                    const NDArray&, NDArray&, NDArray&, const NDArray&, 
-                    int64_t, float, bool, const Stream&);
+DECLARE_KERNEL_CPU(FusedGroup, const NDArrayList&, const FusedProgram&,
+                   const std::vector<uint64_t>&, NDArrayList&, const Stream&);
+DECLARE_KERNEL_CPU_AND_CUDA(FusedLayerNorm, const NDArray&, const NDArray&,
+                            const NDArray&, NDArray&, NDArray&, NDArray&,
+                            int64_t, float,
+                            const Stream&);
+DECLARE_KERNEL_CPU_AND_CUDA(FusedLayerNormGradient, const NDArray&, const NDArray&,
+                            const NDArray&, const NDArray&, NDArray&, NDArray&, NDArray&,
+                            const NDArray&, const NDArray&, int64_t, float, bool,
+                            const Stream&);
+DECLARE_KERNEL_CPU_AND_CUDA(FusedRMSNorm, const NDArray&, const NDArray&,
+                            NDArray&, NDArray&, int64_t, float,
+                            const Stream&);
+DECLARE_KERNEL_CPU_AND_CUDA(FusedRMSNormGradient, const NDArray&, const NDArray&,
+                            const NDArray&, NDArray&, NDArray&, const NDArray&, 
+                            int64_t, float, bool, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(Gather, const NDArray&, const NDArray&, NDArray&,
                             size_t, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(GatherGradient, const NDArray&, const NDArray&, 
@@ -201,6 +209,8 @@ DECLARE_KERNEL_CPU_AND_CUDA(GeluGradient, const NDArray&, const NDArray&,
                             NDArray&, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(IndexAdd, const NDArray&, const NDArray&, NDArray&,
                             size_t, const Stream&);
+DECLARE_KERNEL_CPU(IndexedSlicesToDense, const NDArray&, const NDArray&, NDArray&,
+                   const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(InstanceNorm, const NDArray&, NDArray&, NDArray&,
                             NDArray&, float, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(InstanceNormGradient, const NDArray&,
@@ -258,6 +268,13 @@ DECLARE_KERNEL_CPU_AND_CUDA(MulConst, const NDArray&, double, NDArray&,
                             const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(MulElewise, const NDArray&, const NDArray&,
                             NDArray&, const Stream&);
+DECLARE_KERNEL_CPU(MultiTensorAdam, const NDArrayList&, const NDArrayList&,
+                   const NDArrayList&, const NDArrayList&, const NDArrayList&,
+                   const NDArrayList&, float, float, float, float, float,
+                   float, float, NDArray&, bool, const Stream&);
+DECLARE_KERNEL_CPU(MultiTensorSGDUpdate, const NDArrayList&, const NDArrayList&,
+                   const NDArrayList&, const NDArrayList&, float, float, bool,
+                   float, float, NDArray&, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(NLLLoss, const NDArray& pred,
                             const NDArray& label, NDArray& loss, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(NLLLossGradient, const NDArray& pred,
@@ -289,8 +306,12 @@ DECLARE_KERNEL_CPU_AND_CUDA(ReduceMean, const NDArray&, NDArray&,
                             const int64_t*, int64_t, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(ReduceMin, const NDArray&, NDArray&, const int64_t*,
                             int64_t, const Stream&);
+DECLARE_KERNEL_CPU_AND_CUDA(ReduceProd, const NDArray&, NDArray&,
+                            const int64_t*, int64_t, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(ReduceSum, const NDArray&, NDArray&, const int64_t*,
                             int64_t, const Stream&);
+DECLARE_KERNEL_CPU(DNNLReduce, const NDArray&, NDArray&, const HTAxes&,
+                   ReductionType, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(Relu, const NDArray&, NDArray&, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(ReluGradient, const NDArray&, const NDArray&,
                             NDArray&, const Stream&);
@@ -300,11 +321,13 @@ DECLARE_KERNEL_CPU_AND_CUDA(Reshape, const NDArray&, NDArray&, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(Roll, const NDArray&, const HTShape&, const HTAxes&,
                             NDArray&, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(RollGradient, const NDArray&, NDArray&, const Stream&);
-DECLARE_KERNEL_CUDA(Rotary, const NDArray&, const NDArray&, const NDArray&, 
-                    const NDArray&, NDArray&, NDArray&, bool, const Stream&);
+DECLARE_KERNEL_CPU_AND_CUDA(Rotary, const NDArray&, const NDArray&, const NDArray&, 
+                            const NDArray&, NDArray&, NDArray&, bool, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(Round, const NDArray&, NDArray&, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(SGDUpdate, const NDArray&, NDArray&, NDArray&,
                             float, float, bool, const Stream&);
+DECLARE_KERNEL_CPU(SGDUpdateIndexedSlices, const NDArray&, const NDArray&, NDArray&,
+                   NDArray&, float, float, bool, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(SGDUpdateWithGradScaler, const NDArray&, const NDArray&, NDArray&, NDArray&,
                             float, float, bool, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(Sigmoid, const NDArray&, NDArray&, const Stream&);
@@ -350,12 +373,12 @@ DECLARE_KERNEL_CPU_AND_CUDA(TriuTril, const NDArray&, NDArray&, bool,
                             int64_t, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(UpdateScale, NDArray&, NDArray&, const NDArray&, double, 
                             double, int, const Stream&);
-DECLARE_KERNEL_CUDA(VocabParallelCrossEntropy, const NDArray&, const NDArray&, 
-                    const int64_t, const int64_t, const int64_t, NDArray&, 
-                    NDArray&, const Stream&);
-DECLARE_KERNEL_CUDA(VocabParallelCrossEntropyGradient, const NDArray&, const NDArray&, 
-                    const int64_t, const int64_t, const int64_t, const NDArray&, 
-                    NDArray&, const Stream&);                    
+DECLARE_KERNEL_CPU_AND_CUDA(VocabParallelCrossEntropy, const NDArray&, const NDArray&, 
+                            const int64_t, const int64_t, const int64_t, NDArray&, 
+                            NDArray&, const Stream&);
+DECLARE_KERNEL_CPU_AND_CUDA(VocabParallelCrossEntropyGradient, const NDArray&, const NDArray&, 
+                            const int64_t, const int64_t, const int64_t, const NDArray&, 
+                            NDArray&, const Stream&);                    
 DECLARE_KERNEL_CPU_AND_CUDA(Where, const NDArray&, const NDArray&,
                             const NDArray&, NDArray&, const Stream&);
 DECLARE_KERNEL_CPU_AND_CUDA(NormalInits, NDArray&, double, double, uint64_t,
@@ -25,6 +25,7 @@
 #include "hetu/graph/ops/Exp.h"
 #include "hetu/graph/ops/EmbeddingLookup.h"
 #include "hetu/graph/ops/Floor.h"
+#include "hetu/graph/ops/FusedGroup.h"
 #include "hetu/graph/ops/Gather.h"
 #include "hetu/graph/ops/Gelu.h"
 #include "hetu/graph/ops/group.h"
@@ -51,8 +51,8 @@ void MomentumUpdateOpImpl::DoCompute(Operator& op, const NDArrayList& inputs,
   NDArray velocity = inputs.at(2);
   HT_DISPATCH_KERNEL_CPU_AND_CUDA(op->instantiation_ctx().placement.type(),
                                   type(), hetu::impl::SGDUpdate, grad, param,
-                                  velocity, learning_rate(), 0, false,
-                                  op->instantiation_ctx().stream());
+                                  velocity, learning_rate(), momentum(),
+                                  nesterov(), op->instantiation_ctx().stream());
 }
 
 void AdamOpImpl::DoCompute(Operator& op, const NDArrayList& inputs,
@@ -79,6 +79,119 @@ void AdamOpImpl::DoCompute(Operator& op, const NDArrayList& inputs,
                                   op->instantiation_ctx().stream());
 }
 
+void SparseSGDUpdateOpImpl::DoCompute(Operator& op, const NDArrayList& inputs,
+                                      NDArrayList& outputs,
+                                      RuntimeContext& runtime_ctx) const {
+  NDArray& param = outputs.at(0);
+  NDArray velocity = momentum() != 0 ? inputs.at(2) : NDArray();
+  const NDArray& unique_ids = inputs.at(inputs.size() - 2);
+  const NDArray& grad_values = inputs.at(inputs.size() - 1);
+  HT_DISPATCH_KERNEL_CPU_ONLY(op->instantiation_ctx().placement.type(),
+                              type(), hetu::impl::SGDUpdateIndexedSlices,
+                              unique_ids, grad_values, param, velocity,
+                              learning_rate(), momentum(), nesterov(),
+                              op->instantiation_ctx().stream());
+}
+
+void SparseAdamOpImpl::DoCompute(Operator& op, const NDArrayList& inputs,
+                                 NDArrayList& outputs,
+                                 RuntimeContext& runtime_ctx) const {
+  NDArray& param = outputs.at(0);
+  NDArray& mean = const_cast<NDArray&>(inputs.at(2));
+  NDArray& variance = const_cast<NDArray&>(inputs.at(3));
+  NDArray& step = const_cast<NDArray&>(inputs.at(4));
+  int64_t step_num = inputs.at(4)->item<int64_t>();
+  HT_DISPATCH_KERNEL_CPU_ONLY(op->instantiation_ctx().placement.type(),
+                              type(), hetu::impl::AdamUpdateIndexedSlices,
+                              inputs.at(5), inputs.at(6), param, mean,
+                              variance, step, learning_rate(step_num),
+                              beta1(), beta2(), eps(), weight_decay(step_num),
+                              true, op->instantiation_ctx().stream());
+}
+
+bool GetMultiTensorUpdateKey(const Operator& op, const NDArrayList& inputs,
+                             MultiTensorUpdateKey& key) {
+  if (!op->instantiation_ctx().placement.is_cpu())
+    return false;
+  key = MultiTensorUpdateKey();
+  key.type = op->type();
+  size_t num_states;
+  if (key.type == quote(SGDUpdateOp)) {
+    const auto& impl = dynamic_cast<const SGDUpdateOpImpl&>(op->body());
+    key.lr = impl.learning_rate();
+    num_states = 0;
+  } else if (key.type == quote(MomemtumUpdateOp)) {
+    const auto& impl = dynamic_cast<const MomentumUpdateOpImpl&>(op->body());
+    key.lr = impl.learning_rate();
+    key.momentum = impl.momentum();
+    key.nesterov = impl.nesterov();
+    num_states = 1;
+  } else if (key.type == quote(AdamOp)) {
+    const auto& impl = dynamic_cast<const AdamOpImpl&>(op->body());
+    key.step = inputs.at(4)->item<int64_t>();
+    key.lr = impl.learning_rate(key.step);
+    key.beta1 = impl.beta1();
+    key.beta2 = impl.beta2();
+    key.eps = impl.eps();
+    key.weight_decay = impl.weight_decay(key.step);
+    num_states = 2;
+  } else {
+    return false;
+  }
+  // gradients and states must be contiguous arrays like the parameter
+  const NDArray& param = inputs.at(0);
+  key.dtype = param->dtype();
+  key.device = param->device();
+  key.stream_index = op->instantiation_ctx().stream_index;
+  if (key.dtype != kFloat16 && key.dtype != kBFloat16 &&
+      key.dtype != kFloat32 && key.dtype != kFloat64)
+    return false;
+  for (size_t i = 0; i < 2 + num_states; i++) {
+    const NDArray& array = inputs.at(i);
+    if (array->dtype() != key.dtype || array->device() != key.device ||
+        array->numel() != param->numel() || !array->is_contiguous())
+      return false;
+  }
+  return true;
+}
+
+void ComputeMultiTensorUpdate(const MultiTensorUpdateKey& key,
+                              const std::vector<NDArrayList>& inputs,
+                              const Stream& stream) {
+  NDArrayList params, grads, masters;
+  for (const auto& op_inputs : inputs) {
+    params.push_back(op_inputs.at(0));
+    grads.push_back(op_inputs.at(1));
+  }
+  // no unscaling, clipping or finite check, as the per-tensor kernels
+  NDArray found_inf;
+  if (key.type == quote(AdamOp)) {
+    NDArrayList means, variances, steps;
+    for (const auto& op_inputs : inputs) {
+      means.push_back(op_inputs.at(2));
+      variances.push_back(op_inputs.at(3));
+      steps.push_back(op_inputs.at(4));
+    }
+    HT_DISPATCH_KERNEL_CPU_ONLY(key.device.type(), key.type,
+                                hetu::impl::MultiTensorAdam, grads, params,
+                                masters, means, variances, steps, key.lr,
+                                key.beta1, key.beta2, key.eps,
+                                key.weight_decay, 1.0f, 0.0f, found_inf, true,
+                                stream);
+  } else {
+    NDArrayList velocities;
+    if (key.type == quote(MomemtumUpdateOp)) {
+      for (const auto& op_inputs : inputs)
+        velocities.push_back(op_inputs.at(2));
+    }
+    HT_DISPATCH_KERNEL_CPU_ONLY(key.device.type(), key.type,
+                                hetu::impl::MultiTensorSGDUpdate, grads,
+                                params, masters, velocities, key.lr,
+                                key.momentum, key.nesterov, 1.0f, 0.0f,
+                                found_inf, stream);
+  }
+}
+
 // old version: manually implement zero
 /*
 void AdamOpImpl::DoCompute(Operator& op, const NDArrayList& inputs,
@@ -297,5 +410,34 @@ Tensor MakeAdamOp(Tensor param, Tensor grad, Tensor mean, Tensor variance,
     ->output(0);
 }
 
+Tensor MakeSparseSGDUpdateOp(Tensor param, Tensor grad, Tensor velocity,
+                             Tensor unique_ids, Tensor grad_values,
+                             OptimizerParamScheduler param_scheduler,
+                             float momentum, bool nesterov, OpMeta op_meta) {
+  TensorList inputs = {std::move(param), std::move(grad)};
+  if (momentum != 0)
+    inputs.push_back(std::move(velocity));
+  inputs.push_back(std::move(unique_ids));
+  inputs.push_back(std::move(grad_values));
+  return Graph::MakeOp(std::make_shared<SparseSGDUpdateOpImpl>(
+                         param_scheduler, momentum, nesterov),
+                       std::move(inputs), std::move(op_meta))
+    ->output(0);
+}
+
+Tensor MakeSparseAdamOp(Tensor param, Tensor grad, Tensor mean,
+                        Tensor variance, Tensor step, Tensor unique_ids,
+                        Tensor grad_values,
+                        OptimizerParamScheduler param_scheduler, float beta1,
+                        float beta2, float eps, OpMeta op_meta) {
+  return Graph::MakeOp(std::make_shared<SparseAdamOpImpl>(
+                         param_scheduler, beta1, beta2, eps),
+                       {std::move(param), std::move(grad), std::move(mean),
+                        std::move(variance), std::move(step),
+                        std::move(unique_ids), std::move(grad_values)},
+                       std::move(op_meta))
+    ->output(0);
+}
+
 } // namespace graph
 } // namespace hetu
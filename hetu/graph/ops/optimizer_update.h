@@ -202,6 +202,145 @@ class AdamOpImpl : public OptimizerUpdateOpInterface {
   NDArray _adam_step;
 };
 
+// Sparse updates of an embedding table with the indexed slices of its
+// gradient (see GetIndexedSlices) as the last two inputs. Only the listed
+// rows of the parameter and its states are updated. The dense gradient is
+// kept as the second input, like other update ops. CPU only.
+class SparseSGDUpdateOpImpl final : public OptimizerUpdateOpInterface {
+ public:
+  SparseSGDUpdateOpImpl(OptimizerParamScheduler param_scheduler,
+                        float momentum = 0, bool nesterov = false)
+  : OptimizerUpdateOpInterface(quote(SparseSGDUpdateOp), param_scheduler),
+    _momentum(momentum),
+    _nesterov(nesterov) {
+    HT_VALUE_ERROR_IF(momentum < 0 || momentum > 1)
+      << "Invalid momemtum: " << momentum;
+  }
+
+  bool inplace_at(size_t input_position) const override {
+    // param, grad[, velocity], unique ids and grad values
+    return input_position == 0 || (momentum() != 0 && input_position == 2);
+  }
+
+ protected:
+  void DoCompute(Operator& op, const NDArrayList& inputs, NDArrayList& outputs,
+                 RuntimeContext& runtime_ctx) const override;
+
+ public:
+  bool operator==(const OpInterface& rhs) const override {
+    if (OptimizerUpdateOpInterface::operator==(rhs)) {
+      const auto& rhs_ = reinterpret_cast<const SparseSGDUpdateOpImpl&>(rhs);
+      return momentum() == rhs_.momentum() && nesterov() == rhs_.nesterov();
+    }
+    return false;
+  }
+
+  float momentum() const {
+    return _momentum;
+  }
+
+  bool nesterov() const {
+    return _nesterov;
+  }
+
+ protected:
+  float _momentum;
+  bool _nesterov;
+};
+
+class SparseAdamOpImpl final : public OptimizerUpdateOpInterface {
+ public:
+  SparseAdamOpImpl(OptimizerParamScheduler param_scheduler, float beta1 = 0.9,
+                   float beta2 = 0.999, float eps = 1e-8)
+  : OptimizerUpdateOpInterface(quote(SparseAdamOp), param_scheduler),
+    _beta1(beta1),
+    _beta2(beta2),
+    _eps(eps) {
+    HT_VALUE_ERROR_IF(beta1 < 0 || beta1 > 1)
+      << "Invalid beta1: " << beta1;
+    HT_VALUE_ERROR_IF(beta2 < 0 || beta2 > 1)
+      << "Invalid beta2: " << beta2;
+  }
+
+  bool inplace_at(size_t input_position) const override {
+    // param, grad, mean, variance, step, unique ids and grad values
+    return input_position == 0 || (input_position >= 2 && input_position <= 4);
+  }
+
+ protected:
+  void DoCompute(Operator& op, const NDArrayList& inputs, NDArrayList& outputs,
+                 RuntimeContext& runtime_ctx) const override;
+
+ public:
+  bool operator==(const OpInterface& rhs) const override {
+    if (OptimizerUpdateOpInterface::operator==(rhs)) {
+      const auto& rhs_ = reinterpret_cast<const SparseAdamOpImpl&>(rhs);
+      return beta1() == rhs_.beta1() && beta2() == rhs_.beta2() &&
+        eps() == rhs_.eps();
+    }
+    return false;
+  }
+
+  float beta1() const {
+    return _beta1;
+  }
+
+  float beta2() const {
+    return _beta2;
+  }
+
+  float eps() const {
+    return _eps;
+  }
+
+  float weight_decay(int64_t step) const {
+    return _param_scheduler.get_wd(step);
+  }
+
+ protected:
+  float _beta1;
+  float _beta2;
+  float _eps;
+};
+
+// Dense SGD, momentum and Adam updates on CPU can be applied in groups by
+// the multi-tensor kernels, one task per group instead of one per parameter.
+// Updates of a group share the op type, the hyper-parameters of the current
+// step, the dtype, the device and the stream.
+struct MultiTensorUpdateKey {
+  OpType type;
+  DataType dtype;
+  Device device;
+  StreamIndex stream_index;
+  int64_t step{0};
+  float lr{0};
+  float momentum{0};
+  bool nesterov{false};
+  float beta1{0};
+  float beta2{0};
+  float eps{0};
+  float weight_decay{0};
+
+  bool operator==(const MultiTensorUpdateKey& rhs) const {
+    return type == rhs.type && dtype == rhs.dtype && device == rhs.device &&
+      stream_index == rhs.stream_index && step == rhs.step && lr == rhs.lr &&
+      momentum == rhs.momentum && nesterov == rhs.nesterov &&
+      beta1 == rhs.beta1 && beta2 == rhs.beta2 && eps == rhs.eps &&
+      weight_decay == rhs.weight_decay;
+  }
+};
+
+// Returns whether the update `op` with `inputs` can be applied by the
+// multi-tensor kernels, and its group in `key` if so.
+bool GetMultiTensorUpdateKey(const Operator& op, const NDArrayList& inputs,
+                             MultiTensorUpdateKey& key);
+
+// Applies the updates of group `key`, given by their inputs, with a single
+// kernel on `stream`. Waiting for the inputs is up to the caller.
+void ComputeMultiTensorUpdate(const MultiTensorUpdateKey& key,
+                              const std::vector<NDArrayList>& inputs,
+                              const Stream& stream);
+
 Tensor MakeSGDUpdateOp(Tensor param, Tensor grad, OptimizerParamScheduler param_scheduler,
                        OpMeta op_meta = OpMeta());
 
@@ -218,5 +357,18 @@ Tensor MakeAdamOp(Tensor param, Tensor grad,
                   float beta2 = 0.999, float eps = 1e-8,
                   OpMeta op_meta = OpMeta());
 
+Tensor MakeSparseSGDUpdateOp(Tensor param, Tensor grad, Tensor velocity,
+                             Tensor unique_ids, Tensor grad_values,
+                             OptimizerParamScheduler param_scheduler,
+                             float momentum, bool nesterov,
+                             OpMeta op_meta = OpMeta());
+
+Tensor MakeSparseAdamOp(Tensor param, Tensor grad, Tensor mean,
+                        Tensor variance, Tensor step, Tensor unique_ids,
+                        Tensor grad_values,
+                        OptimizerParamScheduler param_scheduler,
+                        float beta1 = 0.9, float beta2 = 0.999,
+                        float eps = 1e-8, OpMeta op_meta = OpMeta());
+
 } // namespace graph
 } // namespace hetu
\ No newline at end of file
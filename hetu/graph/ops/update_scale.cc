@@ -7,9 +7,9 @@ namespace graph {
 void UpdateScaleOpImpl::DoCompute(Operator& op, 
                                   const NDArrayList& inputs, NDArrayList& outputs,
                                   RuntimeContext& ctx) const {
-  HT_DISPATCH_KERNEL_CUDA_ONLY(op->instantiation_ctx().placement.type(), type(), hetu::impl::UpdateScale,
-                               outputs.at(0), outputs.at(1), inputs.at(2), growth_factor(), backoff_factor(),  
-                               growth_interval(), op->instantiation_ctx().stream());
+  HT_DISPATCH_KERNEL_CPU_AND_CUDA(op->instantiation_ctx().placement.type(), type(), hetu::impl::UpdateScale,
+                                  outputs.at(0), outputs.at(1), inputs.at(2), growth_factor(), backoff_factor(),  
+                                  growth_interval(), op->instantiation_ctx().stream());
 }
 
 TensorList UpdateScaleOpImpl::DoGradient(Operator& op, const TensorList& grad_outputs) const {
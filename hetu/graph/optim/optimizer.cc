@@ -4,6 +4,7 @@
 #include "hetu/graph/ops/Arithmetics.h"
 #include "hetu/graph/ops/ones_like.h"
 #include "hetu/graph/ops/optimizer_update.h"
+#include "hetu/graph/ops/EmbeddingLookup.h"
 #include "hetu/graph/graph.h"
 #include "hetu/graph/define_and_run_graph.h"
 
@@ -51,6 +52,9 @@ void Optimizer::ApplyZero(const GradAndVarList& grads_and_vars) {
   for (const auto& grad_and_var : grads_and_vars) {
     const Tensor& grad = grad_and_var.first;
     const Tensor& var = grad_and_var.second;
+    // eager graphs have no ds hierarchy to fix
+    if (var->graph().type() != GraphType::DEFINE_AND_RUN)
+      continue;
     // 需要记录未应用zero前的var的ds hierarchy
     // 后续define graph实例化具体的optimize-compute bridge subgraph时需要
     dynamic_cast<DefineAndRunGraph&>(var->graph()).RecordBeforeZero(var, var->ds_hierarchy());
@@ -103,12 +107,17 @@ Tensor Optimizer::MakeStates(const Tensor& variable, const Tensor& grad, const O
   // HT_ASSERT (ds_variable.is_valid() && ds_grad.is_valid()) 
   //   << "Diastributed States for varibale " << variable << " must be valid!";  
   // HT_LOG_INFO << variable->name() + "_" + state_name << " directly use grad " << grad << ": " << grad_ds_hierarchy.get(1).ds_union_info();
-  Tensor states = MakeParallelVariableOp(ZerosInitializer(), grad->global_shape(),
-                                         grad_ds_hierarchy, {0}, grad->dtype(), false, {},
-                                         OpMeta()
-                                          .set_device_group_hierarchy(producer->device_group_hierarchy())
-                                          .set_eager_device(producer->eager_device())
-                                          .set_name(variable->name() + "_" + state_name));  
+  auto states_op_meta = OpMeta()
+                          .set_device_group_hierarchy(producer->device_group_hierarchy())
+                          .set_eager_device(producer->eager_device())
+                          .set_name(variable->name() + "_" + state_name);
+  // eager graphs keep local tensors without ds
+  Tensor states = grad_ds_hierarchy.size() == 0
+    ? MakeVariableOp(ZerosInitializer(), grad->shape(), grad->dtype(), false,
+                     grad_ds_hierarchy, std::move(states_op_meta))
+    : MakeParallelVariableOp(ZerosInitializer(), grad->global_shape(),
+                             grad_ds_hierarchy, {0}, grad->dtype(), false, {},
+                             std::move(states_op_meta));
   Graph::MarkAsOptimizerVariable(states);
   if (state_dict.find(variable->id()) == state_dict.end()) {
     state_dict[variable->id()] = {};
@@ -143,6 +152,14 @@ Tensor SGDOptimizer::ApplyDense(const GradAndVar& grad_and_var, const Tensor& in
                           .set_device_group_hierarchy(var->producer()->device_group_hierarchy())
                           .set_name("Update_" + var->name())
                           .set_is_deduce_states(false);
+  // embedding tables trained by eager CPU graphs update the looked-up rows
+  auto indexed_slices = GetIndexedSlices(grad);
+  if (!indexed_slices.empty()) {
+    Tensor velocity = momentum() != 0 ? MakeStates(var, grad, "velocity") : Tensor();
+    return MakeSparseSGDUpdateOp(var, grad, velocity, indexed_slices.at(0),
+                                 indexed_slices.at(1), param_scheduler(),
+                                 momentum(), nesterov(), update_op_meta);
+  }
   if (momentum() == 0) {
     if (infinite_count != Tensor())
       return MakeSGDUpdateWithGradScalerOp(var, grad, infinite_count, param_scheduler(), update_op_meta);
@@ -176,9 +193,14 @@ Tensor AdamOptimizer::ApplyDense(const GradAndVar& grad_and_var, const Tensor& i
   }
   state_dict[var->id()]["step"] = step;
   // variable: dup in dp group, grad: reduce-scatter in dp group, mean & variance: same as grad
-
-
-
+  auto indexed_slices = GetIndexedSlices(grad);
+  if (!indexed_slices.empty()) {
+    return MakeSparseAdamOp(var, grad, MakeStates(var, grad, "mean"),
+                            MakeStates(var, grad, "variance"), step,
+                            indexed_slices.at(0), indexed_slices.at(1),
+                            param_scheduler(), beta1(), beta2(), eps(),
+                            update_op_meta);
+  }
   return MakeAdamOp(var, grad, MakeStates(var, grad, "mean"),
                     MakeStates(var, grad, "variance"),
                     param_scheduler(), step, beta1(), beta2(),
@@ -2,8 +2,11 @@
 #include "hetu/graph/switch_exec_graph.h"
 #include "hetu/graph/operator.h"
 #include "hetu/graph/subgraph.h"
+#include "hetu/graph/ops/optimizer_update.h"
 #include "hetu/impl/communication/comm_group.h"
 #include "hetu/impl/communication/nccl_comm_group.h"
+#include "hetu/impl/memory/HostStagingPool.h"
+#include "hetu/impl/stream/CPUStream.h"
 
 namespace hetu {
 namespace graph {
@@ -71,6 +74,86 @@ NDArray ExecutableGraph::GetDetachedVariableDataInner(const Tensor& tensor) {
   return NDArray::to(it_1->second, Device(kCPU));
 }
 
+std::shared_future<void>
+ExecutableGraph::SaveCheckpointAsync(CheckpointWriter& writer,
+                                     const std::string& path,
+                                     const std::map<std::string, std::string>& metadata) {
+  HT_ASSERT(_use_origin_param_and_optimizer_buckets)
+    << "SaveCheckpointAsync needs the origin param and optimizer buckets";
+  std::vector<std::shared_ptr<ParamBuffer>> buckets;
+  size_t num_bytes = 0;
+  for (const auto& kv : _origin_param_and_optimizer_buckets_map) {
+    for (const auto& bucket : kv.second->buckets()) {
+      if (bucket->IsEmpty() || !bucket->IsAllocated())
+        continue;
+      // 在预留host预算之前检查, 以免出错时预算不被释放
+      for (const auto& tensor : bucket->tensor_list())
+        HT_NOT_IMPLEMENTED_IF(tensor->cur_ds_union().is_hetero())
+          << "Cannot save " << tensor << " with hetero distributed states yet";
+      buckets.push_back(bucket);
+      num_bytes += bucket->size();
+    }
+  }
+  // 如果host上的快照超出预算, 这里会等之前的checkpoint落盘
+  writer.ReserveHostBytes(num_bytes);
+  try {
+    return SnapshotBuckets(writer, buckets, path, metadata);
+  } catch (...) {
+    writer.ReleaseHostBytes();
+    throw;
+  }
+}
+
+// An event on the streams of `device`, so that checkpoints of graphs on
+// CPUs can be saved asynchronously as well.
+static std::shared_ptr<Event> MakeSnapshotEvent(const Device& device) {
+  if (device.is_cuda())
+    return std::make_shared<hetu::impl::CUDAEvent>(device, false);
+  return std::make_shared<hetu::impl::CPUEvent>(false);
+}
+
+std::shared_future<void>
+ExecutableGraph::SnapshotBuckets(CheckpointWriter& writer,
+                                 const std::vector<std::shared_ptr<ParamBuffer>>& buckets,
+                                 const std::string& path,
+                                 const std::map<std::string, std::string>& metadata) {
+  auto local_device = hetu::impl::comm::GetLocalDevice();
+  // 快照在已发射的计算(包括update)之后开始
+  Stream snapshot_stream(local_device, kCheckpointStream);
+  for (auto stream_index : {kComputingStream, kSwitchComputingStream}) {
+    auto event = MakeSnapshotEvent(local_device);
+    event->Record(Stream(local_device, stream_index));
+    event->Block(snapshot_stream);
+  }
+  std::vector<CheckpointTensor> tensors;
+  for (const auto& bucket : buckets) {
+    // 整个bucket一次性拷贝到pinned的host staging buffer
+    auto device_data = bucket->AsNDArray();
+    auto host_meta = NDArrayMeta().set_dtype(bucket->dtype())
+                                  .set_device(Device(kCPU))
+                                  .set_shape(device_data->shape());
+    auto host_data = NDArray(host_meta, std::make_shared<NDArrayStorage>(
+      hetu::impl::GetHostStagingPool().AllocDataSpace(bucket->size(), local_device)));
+    NDArray::copy(device_data, kCheckpointStream, host_data);
+    NDArray::MarkUsedBy(device_data, snapshot_stream);
+    for (const auto& tensor : bucket->tensor_list()) {
+      auto meta = NDArrayMeta().set_dtype(tensor->dtype())
+                               .set_device(Device(kCPU))
+                               .set_shape(tensor->shape());
+      tensors.push_back({tensor->name(),
+                         NDArray(meta, host_data->storage(), bucket->GetElementOffset(tensor)),
+                         tensor->get_local_distributed_states(),
+                         static_cast<int32_t>(tensor->local_placement_group_idx())});
+    }
+  }
+  // 之后的optimizer update需要等待快照拷贝完
+  _checkpoint_snapshot_event = MakeSnapshotEvent(local_device);
+  _checkpoint_snapshot_event->Record(snapshot_stream);
+  auto snapshot_event = _checkpoint_snapshot_event;
+  return writer.SaveSnapshot(path, tensors, metadata,
+                             [snapshot_event]() { snapshot_event->Sync(); });
+}
+
 NDArray& ExecutableGraph::AllocVariableDataInner(const Tensor& tensor,
                                                  const Initializer& init,
                                                  uint64_t seed,
@@ -360,15 +443,97 @@ void ExecutableGraph::PostRun(std::vector<RuntimeContext>& runtime_ctx_list, Ten
     << "RunLevel::COMPUTE_ONLY shouldn't call PostRun()";
   auto num_micro_batches = runtime_ctx_list.size();
   auto micro_batch_id = num_micro_batches - 1;
+  auto& runtime_ctx = runtime_ctx_list[micro_batch_id];
+  // CPU上的dense update先不执行
+  // 等所有grad reduce完后按MultiTensorUpdateKey分组用multi-tensor kernel执行
+  OpRefList deferred_updates;
+  std::vector<NDArrayList> deferred_inputs;
+  std::vector<MultiTensorUpdateKey> deferred_keys;
+  auto op_handler = [&](Operator& op, Tensor2NDArrayMap& tensor2data, size_t micro_batch_id) {
+    auto status = PostOpHandler(op, tensor2data, micro_batch_id);
+    if (status.need_skip || !_multi_tensor_update || _run_level != RunLevel::UPDATE
+        || !is_optimizer_update_op(op)) {
+      return status;
+    }
+    NDArrayList inputs;
+    inputs.reserve(op->num_inputs());
+    for (const auto& input : op->inputs()) {
+      auto preserved_it = _preserved_data.find(input->id());
+      if (preserved_it != _preserved_data.end()) {
+        inputs.push_back(preserved_it->second);
+        continue;
+      }
+      auto it = tensor2data.find(input->id());
+      HT_ASSERT(it != tensor2data.end() && it->second.is_defined())
+        << "Cannot find input " << input << " of " << op;
+      inputs.push_back(it->second);
+    }
+    MultiTensorUpdateKey key;
+    if (!GetMultiTensorUpdateKey(op, inputs, key)) {
+      return status;
+    }
+    deferred_updates.push_back(std::ref(op));
+    deferred_inputs.push_back(std::move(inputs));
+    deferred_keys.push_back(std::move(key));
+    status.need_skip = true;
+    return status;
+  };
   for (const auto& [param_id, cur_subgraph] : _compute_optimize_bridge_subgraph_sorted) {
     // 执行该subgraph
     // HT_LOG_INFO << cur_subgraph->global_name() << " run begin";
-    cur_subgraph->run(tensor2data, _preserved_data, runtime_ctx_list[micro_batch_id], micro_batch_id, SubGraphOpType::UPDATE, true,
-                      [this](Operator& op, Tensor2NDArrayMap& tensor2data, size_t micro_batch_id) { return PostOpHandler(op, tensor2data, micro_batch_id); });
+    cur_subgraph->run(tensor2data, _preserved_data, runtime_ctx, micro_batch_id, SubGraphOpType::UPDATE, true, op_handler);
     // HT_LOG_INFO << cur_subgraph->global_name() << " run end";
   }
-  _terminate_subgraph->run(tensor2data, _preserved_data, runtime_ctx_list[micro_batch_id], micro_batch_id, SubGraphOpType::UPDATE, true,
+  // 按update的顺序分组
+  std::vector<std::vector<size_t>> groups;
+  for (size_t i = 0; i < deferred_updates.size(); i++) {
+    auto it = std::find_if(groups.begin(), groups.end(), [&](const std::vector<size_t>& group) {
+      return deferred_keys[group.front()] == deferred_keys[i];
+    });
+    if (it == groups.end()) {
+      groups.push_back({i});
+    } else {
+      it->push_back(i);
+    }
+  }
+  for (const auto& group : groups) {
+    // 只有一个update时直接执行原算子
+    if (group.size() == 1) {
+      auto& op = deferred_updates[group.front()].get();
+      auto& inputs = deferred_inputs[group.front()];
+      NDArrayList outputs = op->Compute(inputs, runtime_ctx, micro_batch_id);
+      NDArray::MarkUsedBy(inputs, op->instantiation_ctx().stream());
+      tensor2data[op->output(0)->id()] = outputs.at(0);
+      tensor2data.erase(op->input(1)->id());
+      continue;
+    }
+    const auto& stream = deferred_updates[group.front()].get()->instantiation_ctx().stream();
+    std::vector<NDArrayList> group_inputs;
+    group_inputs.reserve(group.size());
+    for (auto i : group) {
+      auto& op = deferred_updates[i].get();
+      op->BlockOrSyncAllInputs(runtime_ctx, micro_batch_id);
+      op->instantiation_ctx().start[micro_batch_id]->Record(stream);
+      group_inputs.push_back(deferred_inputs[i]);
+    }
+    ComputeMultiTensorUpdate(deferred_keys[group.front()], group_inputs, stream);
+    for (auto i : group) {
+      auto& op = deferred_updates[i].get();
+      op->instantiation_ctx().stop[micro_batch_id]->Record(stream);
+      NDArray::MarkUsedBy(deferred_inputs[i], stream);
+      // 原地更新param
+      tensor2data[op->output(0)->id()] = deferred_inputs[i].at(0);
+      tensor2data.erase(op->input(1)->id());
+    }
+  }
+  HT_LOG_DEBUG << "[Update] " << deferred_updates.size() << " cpu updates in "
+               << groups.size() << " multi-tensor groups";
+  _terminate_subgraph->run(tensor2data, _preserved_data, runtime_ctx, micro_batch_id, SubGraphOpType::UPDATE, true,
                            [this](Operator& op, Tensor2NDArrayMap& tensor2data, size_t micro_batch_id) { return PostOpHandler(op, tensor2data, micro_batch_id); });
+  // 所有update都已经等待过checkpoint快照了
+  if (_run_level == RunLevel::UPDATE) {
+    _checkpoint_snapshot_event = nullptr;
+  }
 }
 
 OpHandlerStatus ExecutableGraph::PostOpHandler(Operator& op, Tensor2NDArrayMap& tensor2data, size_t micro_batch_id) {
@@ -429,6 +594,11 @@ OpHandlerStatus ExecutableGraph::PostOpHandler(Operator& op, Tensor2NDArrayMap&
     }
     // 要进行梯度更新
     else if (_run_level == RunLevel::UPDATE) {
+      // update会原地修改param和optimizer states
+      // 需要等checkpoint快照拷贝完
+      if (_checkpoint_snapshot_event != nullptr) {
+        _checkpoint_snapshot_event->Block(op->instantiation_ctx().stream());
+      }
       // 如果有累积梯度那么此时要加上
       // 这里的逻辑和上面的正好反过来
       if (_accumulate_grad_buffer_map[op->input(1)->dtype()]->IsAllocated()) {
@@ -469,157 +639,24 @@ OpHandlerStatus ExecutableGraph::PostOpHandler(Operator& op, Tensor2NDArrayMap&
   return status;
 }
 
-void ExecutableGraph::AllocMemory(size_t& memory_size, MemoryPlan& memory_plan,
-                                  MemoryBlockList& temporary_free_memory, MemoryBlockList& free_memory, MicroBatchTensorId tensor_id,
-                                  size_t alloc_memory_size) {
-  // Best Fit strategy
-  sort(temporary_free_memory.begin(), temporary_free_memory.end(),
-       [&](MemoryBlock a, MemoryBlock b) { return a.second < b.second; });
-
-  // 找temp free memory中最小的能容纳下的块
-  // 并进行split
-  for (auto block_iter = temporary_free_memory.begin(); block_iter != temporary_free_memory.end(); block_iter++) {
-    auto block_size = block_iter->second;
-    if (block_size >= alloc_memory_size) {
-      auto block_ptr = block_iter->first;
-      temporary_free_memory.erase(block_iter);
-      memory_plan[tensor_id] = {block_ptr, alloc_memory_size};
-      auto remain_size = block_size - alloc_memory_size;
-      if (remain_size > 0) {
-        temporary_free_memory.push_back({block_ptr + alloc_memory_size, remain_size});
-      }
-      return;
-    }
-  }
-
-  sort(free_memory.begin(), free_memory.end(),
-       [&](MemoryBlock a, MemoryBlock b) { return a.second < b.second; });
-
-  // 同上
-  // free memory更珍贵
-  for (auto block_iter = free_memory.begin(); block_iter != free_memory.end(); block_iter++) {
-    auto block_size = block_iter->second;
-    if (block_size >= alloc_memory_size) {
-      auto block_ptr = block_iter->first;
-      free_memory.erase(block_iter);
-      memory_plan[tensor_id] = {block_ptr, alloc_memory_size};
-      auto remain_size = block_size - alloc_memory_size;
-      if (remain_size > 0) {
-        free_memory.push_back({block_ptr + alloc_memory_size, remain_size});
-      }
-      return;
-    }
-  }
-
-  memory_plan[tensor_id] = {memory_size, alloc_memory_size};
-  memory_size += alloc_memory_size;
-}
-
-void ExecutableGraph::FreeMemory(MemoryPlan& memory_plan, MemoryBlockList& free_memory,
-                                 MicroBatchTensorId tensor_id) {
-  // free memory space and merge with adjacent free blocks
-  auto free_block_ptr = memory_plan[tensor_id].first;
-  auto free_block_size = memory_plan[tensor_id].second;
-  for (auto i = 0; i < free_memory.size(); i++) {
-    auto block_head = free_memory[i].first;
-    auto block_tail = block_head + free_memory[i].second;
-    if (block_tail == free_block_ptr) {
-      free_block_ptr = block_head;
-      free_block_size += free_memory[i].second;
-      free_memory.erase(free_memory.begin() + i);
-      i--;
-    } else if (free_block_ptr + free_block_size == block_head) {
-      free_block_size += free_memory[i].second;
-      free_memory.erase(free_memory.begin() + i);
-      i--;
-    }
-  }
-  free_memory.push_back({free_block_ptr, free_block_size});
-}
-
 MemoryPlan ExecutableGraph::GenerateMemoryPlan(size_t& memory_size, std::vector<std::pair<bool, size_t>> tasks,
-                                               std::vector<Tensor2IntMap> tensor2degrees_list,    
-                                               const FeedDict& feed_dict){
-  memory_size = 0;
-  MemoryPlan memory_plan;
-  MemoryBlockList temporary_free_memory[HT_NUM_STREAMS_PER_DEVICE];
-  MemoryBlockList free_memory;
-  std::map<MemoryBlock, int> storage_use_count;
-
-  auto& subgraphs = GetAllSubGraphs();
-  std::vector<OpList> block_ops;
-  std::vector<std::string> block_name = {"GPTBlock", "LLamaBlock"};
-  for (auto [name, subgraph] : subgraphs) {
-    std::function<OpList(std::shared_ptr<SubGraph>)> get_all_ops = [&](std::shared_ptr<SubGraph> subgraph){
-      OpList ops;
-      for (auto [name, op] : subgraph->ops()) 
-        ops.push_back(op);  
-      for (auto [name, op] : subgraph->bwd_ops()) 
-        ops.push_back(op); 
-      for (auto [name, child] : subgraph->subgraphs()) {
-        auto child_ops = get_all_ops(child);
-        for (auto op : child_ops) 
-          ops.push_back(op);
-      }
-      return ops;
-    };
-    for (auto bname : block_name) {
-      if (subgraph->subgraph_type() == SubGraphType::MODULE && subgraph->module_type() == bname) {
-        block_ops.push_back(get_all_ops(subgraph));
-      }
-    }
-  }
-  if (block_ops.size() <= 0) {
-    HT_LOG_WARN << "The topology graph only supports segmentation using GPTBlock or LLamaBlock as the block, but find none of them. If you define other types of block, please add the class name to the list above.";
-  }
-  std::set<OpId> fw_block_start_op, fw_block_end_op;
-  for (auto ops : block_ops) {
-    std::vector<int> in_degree(ops.size(), 0), out_degree(ops.size(), 0);
-    for (int i = 0; i < ops.size(); i++) {
-      for (auto& output : ops[i]->outputs()) {
-        for (auto consumer : output->consumers()) {
-          for (int j = 0; j < ops.size(); j++) {
-            if (consumer.get()->graph_id() == ops[j]->graph_id() && consumer.get()->id() == ops[j]->id()) {
-              in_degree[j]++;
-              out_degree[i]++;
-            }
-          }
-        }
-      }
-    }
-    int start_op_cnt = 0, end_op_cnt = 0;
-    for (int i = 0; i < ops.size(); i++) {
-      // workaround: comm op还会出现在subgraph中而被当成是block start/end op
-      // 后续应该将comm op单独处理成bridge subgraph中（python端定义会用户不友好）
-      if (is_comm_op(ops[i])) {
-        HT_RUNTIME_ERROR << "subgraphs should not consists of comm op";
-      }
-      if (in_degree[i] == 0) {
-        start_op_cnt++;
-        fw_block_start_op.insert(ops[i]->id());
-        HT_LOG_DEBUG << ops[i] << " is a block start op, the inputs are " << ops[i]->inputs();
-      }
-      if (out_degree[i] == 0) {
-        end_op_cnt++;
-        fw_block_end_op.insert(ops[i]->id());
-        HT_LOG_DEBUG << ops[i] << " is a block end op, the inputs are " << ops[i]->inputs();
-      }
-    }
-    HT_ASSERT(start_op_cnt == 1 && end_op_cnt == 1) 
-      << "Each block only has a start operator and an end operator.";
-  }
+                                               const FeedDict& feed_dict,
+                                               MemoryPlanStrategy strategy) {
+  // 按执行顺序给每个op编号(step)，记录每个tensor从被分配到最后一次被使用的区间，
+  // 然后交给与模型结构无关的MemoryPlanner离线规划
+  std::vector<TensorLifetime> lifetimes;
+  // 不需要分配的view/inplace输出与输入共享同一个lifetime
+  std::map<MicroBatchTensorId, size_t> lifetime_index;
+  size_t step = 0;
 
   for (size_t i = 0; i < tasks.size(); i++) {
     auto& task = tasks[i];
     bool is_forward = task.first;
     size_t& micro_batch_id = task.second;
-    auto& tensor2degrees = tensor2degrees_list[micro_batch_id];
     bool grad_accumulation_finished = ((i == tasks.size() - 1) && is_forward == false);
     OpRefList &topo = is_forward ? _execute_plan.local_fw_topo : _execute_plan.local_bw_topo;
     const TensorIdSet& dtype_transfer_tensor = _execute_plan.dtype_transfer_tensor;
-    const TensorIdSet& shared_weight_tensor = _execute_plan.shared_weight_tensor;
     const OpIdSet& shared_weight_p2p = _execute_plan.shared_weight_p2p;
-    const OpIdSet& shared_weight_grad_p2p = _execute_plan.shared_weight_grad_p2p;
     const TensorIdSet& accumulated_tensor = _execute_plan.accumulated_tensor;
     const OpIdSet& accumulated_ops = _execute_plan.accumulated_ops;
 
@@ -638,136 +675,83 @@ MemoryPlan ExecutableGraph::GenerateMemoryPlan(size_t& memory_size, std::vector<
       executable_topo.push_back(op_ref);
     }
 
-    std::vector<MicroBatchTensorId> release_tensor;
+    size_t task_begin = step;
+    // multi-stream的tensor无法精确判断何时可以复用
+    // 保守地让其在整个task内都存活
+    std::vector<size_t> task_long_lifetimes;
+    std::vector<size_t> forever_lifetimes;
     for (auto& op_ref : executable_topo) {
       auto& op = op_ref.get();
-      auto clear_tensor_and_merge_space = [&](){
-        for (auto& micro_tensor_id : release_tensor) {
-          FreeMemory(memory_plan, free_memory, micro_tensor_id);
-          storage_use_count[memory_plan[micro_tensor_id]] = 0;
-          storage_use_count.erase(memory_plan[micro_tensor_id]);
-        }
-        release_tensor.clear();
-        // 将所有stream上的temp free memory全部放回到free memory
-        for (auto stream_id = 0; stream_id < HT_NUM_STREAMS_PER_DEVICE; stream_id++) {
-          for (auto& space : temporary_free_memory[stream_id]) {
-            auto free_block_ptr = space.first;
-            auto free_block_size = space.second;
-            for (auto i = 0; i < free_memory.size(); i++) {
-              auto block_head = free_memory[i].first;
-              auto block_tail = block_head + free_memory[i].second;
-              if (block_tail == free_block_ptr) {
-                free_block_ptr = block_head;
-                free_block_size += free_memory[i].second;
-                free_memory.erase(free_memory.begin() + i);
-                i--;
-              } else if (free_block_ptr + free_block_size == block_head) {
-                free_block_size += free_memory[i].second;
-                free_memory.erase(free_memory.begin() + i);
-                i--;
-              }
-            }
-            free_memory.push_back({free_block_ptr, free_block_size});
-          }
-          temporary_free_memory[stream_id].clear();
-        }
-      };
-
-      // fw block的开头和bw block的结尾
-      // 全部进行清空
-      if (is_forward && fw_block_start_op.find(op->id()) != fw_block_start_op.end() || !is_forward && fw_block_end_op.find(op->fw_op_id()) != fw_block_end_op.end()) {
-        clear_tensor_and_merge_space();
-      }
       if (is_optimizer_update_op(op) || is_data_transfer_op(op)) {
         continue;
       }
+      auto used_by_multi_stream = [&](const Tensor& tensor) {
+        for (auto &consumer_ref : tensor->consumers()) {
+          auto& consumer = consumer_ref.get();
+          if (consumer->stream_index() != tensor->producer()->stream_index()) {
+            return true;
+          }
+        }
+        return false;
+      };
       // TODO: maybe too heuristic
-      // 可以reuse的会累积storage_use_count
+      // 可以reuse的输出与输入共享lifetime
       if (op->type() == "TransposeOp"|| is_slice_op(op) ||
           (op->type() == "ArrayReshapeOp" || op->type() == "ArrayReshapeGradientOp") && op->inputs().at(0)->is_contiguous() || 
           is_inplace_op(op) || is_all_reduce_op(op) || is_reduce_scatter_op(op)) {
-        auto input_id = op->inputs().at(0)->id();
-        auto output_id = op->outputs().at(0)->id();
-        if (memory_plan.find({micro_batch_id, input_id}) != memory_plan.end()
-            && storage_use_count.find(memory_plan[{micro_batch_id, input_id}]) != storage_use_count.end()
-            && storage_use_count[memory_plan[{micro_batch_id, input_id}]] > 0) {
-          memory_plan[{micro_batch_id, output_id}] = memory_plan[{micro_batch_id, input_id}];
-          storage_use_count[memory_plan[{micro_batch_id, input_id}]] += tensor2degrees[output_id];
+        auto it = lifetime_index.find({micro_batch_id, op->inputs().at(0)->id()});
+        if (it != lifetime_index.end()) {
+          lifetime_index[{micro_batch_id, op->outputs().at(0)->id()}] = it->second;
         }
       } 
       // 其余情况需要分配
       else {
         for (auto& output : op->outputs()) {
-          auto tensor_id = output->id();
           int64_t numElem = output->numel();
           numElem = DIVUP(numElem * DataType2Size(output->dtype()), 256) * 256 / DataType2Size(kInt64);
-          AllocMemory(memory_size, memory_plan, temporary_free_memory[op->stream_index()], free_memory, {micro_batch_id, tensor_id}, numElem);
-          storage_use_count[memory_plan[{micro_batch_id, tensor_id}]] = tensor2degrees[tensor_id];
+          lifetime_index[{micro_batch_id, output->id()}] = lifetimes.size();
+          // accumulated tensor在产生后即可释放
+          lifetimes.push_back({{micro_batch_id, output->id()}, static_cast<size_t>(numElem), step, step});
         }
       }
-
-      for (size_t i = 0; i < op->num_outputs(); i++) {
-        auto tensor_id = op->output(i)->id();
-        if (memory_plan.find({micro_batch_id, tensor_id}) == memory_plan.end()) {
-          // HT_LOG_WARN << op << " output: micro batch " << micro_batch_id << " tensor " << op->output(i) << " is not in memory_plan";
-          continue;
-        }
-        if (storage_use_count.find(memory_plan[{micro_batch_id, tensor_id}]) == storage_use_count.end()) {
-          // HT_LOG_WARN << op << " output: micro batch " << micro_batch_id << " tensor " << op->output(i) << " is not in storage_use_count";
-          continue;
-        }
-        if (accumulated_tensor.find(tensor_id) != accumulated_tensor.end() 
-            || storage_use_count[memory_plan[{micro_batch_id, tensor_id}]] == 0) {
-          FreeMemory(memory_plan, temporary_free_memory[op->stream_index()], {micro_batch_id, tensor_id});
-          storage_use_count[memory_plan[{ micro_batch_id, tensor_id}]] = 0;
-          storage_use_count.erase(memory_plan[{ micro_batch_id, tensor_id}]);
-          // if (op->placement().index() == 0) std::cout << "tensor " << tensor_id << ' ' << "free" << ' ' << memory_plan[{micro_batch_id, tensor_id}].first << ' ' << memory_plan[{micro_batch_id, tensor_id}].second << std::endl;
+      for (const auto& output : op->outputs()) {
+        auto it = lifetime_index.find({micro_batch_id, output->id()});
+        if (it != lifetime_index.end()) {
+          lifetimes[it->second].end = MAX(lifetimes[it->second].end, step);
         }
       }
-
       for (const auto& input : op->inputs()) {
-        auto used_by_multi_stream = [&](const Tensor& tensor) {
-          for (auto &consumer_ref : tensor->consumers()) {
-            auto& consumer = consumer_ref.get();
-            if (consumer->stream_index() != tensor->producer()->stream_index()) {
-              return true;
-            }
-          }
-          return false;
-        };
-        if (memory_plan.find({micro_batch_id, input->id()}) == memory_plan.end()) {
-          // HT_LOG_WARN << op << " input: micro batch " << micro_batch_id << " tensor " << input << " is not in memory_plan";
+        auto it = lifetime_index.find({micro_batch_id, input->id()});
+        if (it == lifetime_index.end() || accumulated_tensor.find(input->id()) != accumulated_tensor.end()) {
           continue;
         }
-        if (storage_use_count.find(memory_plan[{micro_batch_id, input->id()}]) == storage_use_count.end()) {
-          // HT_LOG_WARN << op << " input: micro batch " << micro_batch_id << " tensor " << input << " is not in storage_use_count";
-          continue;
-        }
-        if (accumulated_tensor.find(input->id()) != accumulated_tensor.end()) {
-          continue;
-        }
-        if (--storage_use_count[memory_plan[{micro_batch_id, input->id()}]] == 0
-            && !is_pipeline_stage_recv_op(input->producer()) && !is_pipeline_stage_send_op(op)) {
-          if (used_by_multi_stream(input) == false) {
-            FreeMemory(memory_plan, temporary_free_memory[op->stream_index()], {micro_batch_id, input->id()});
-            storage_use_count[memory_plan[{micro_batch_id, input->id()}]] = 0;
-            storage_use_count.erase(memory_plan[{micro_batch_id, input->id()}]);
-            // if (op->placement().index() == 0) std::cout << "tensor " << input->id() << ' ' << "free" << ' ' << memory_plan[{micro_batch_id, input->id()}].first << ' ' << memory_plan[{micro_batch_id, input->id()}].second << std::endl;
-          }
-          // multi-stream的memory plan暂时无法处理
-          // 只能是下一个block再去全部free
-          else {
-            release_tensor.push_back({micro_batch_id, input->id()});
-          }
+        lifetimes[it->second].end = MAX(lifetimes[it->second].end, step);
+        // pipeline send/recv的tensor不会被释放
+        if (is_pipeline_stage_recv_op(input->producer()) || is_pipeline_stage_send_op(op)) {
+          forever_lifetimes.push_back(it->second);
+        } else if (used_by_multi_stream(input)) {
+          task_long_lifetimes.push_back(it->second);
         }
       }
-      // fw block的结尾或者bw block的开头
-      // 再次清空
-      if (is_forward && fw_block_end_op.find(op->id()) != fw_block_end_op.end() || !is_forward && fw_block_start_op.find(op->fw_op_id()) != fw_block_start_op.end()) {
-        clear_tensor_and_merge_space();
-      }
+      step++;
+    }
+    for (auto index : task_long_lifetimes) {
+      lifetimes[index].begin = MIN(lifetimes[index].begin, task_begin);
+      lifetimes[index].end = MAX(lifetimes[index].end, step > 0 ? step - 1 : 0);
+    }
+    for (auto index : forever_lifetimes) {
+      lifetimes[index].end = TensorLifetime::FOREVER;
     }
   }
+
+  MemoryPlanStats stats;
+  auto memory_plan = MemoryPlanner::Plan(lifetimes, strategy, &stats);
+  for (auto& [tensor_id, index] : lifetime_index) {
+    memory_plan[tensor_id] = memory_plan[lifetimes[index].tensor_id];
+  }
+  memory_size = stats.planned_size;
+  HT_LOG_DEBUG << "Memory plan of " << lifetimes.size() << " tensors over " << step
+               << " ops by " << MemoryPlanStrategy2Str(strategy) << ": " << stats;
   return memory_plan;
 }
 
@@ -0,0 +1,174 @@
+#include "hetu/impl/communication/half_reduction.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace hetu {
+namespace impl {
+namespace comm {
+
+namespace {
+
+template <ReductionType red_type>
+inline float ReduceFloat(float a, float b) {
+  if constexpr (red_type == kSUM)
+    return a + b;
+  else if constexpr (red_type == kPROD)
+    return a * b;
+  else if constexpr (red_type == kMAX)
+    return a > b ? a : b;
+  else
+    return a < b ? a : b;
+}
+
+template <typename spec_t, ReductionType red_type>
+void ReduceHalfScalar(const spec_t* a, spec_t* b, size_t begin, size_t end) {
+  for (size_t i = begin; i < end; i++)
+    b[i] = ReduceFloat<red_type>(static_cast<float>(a[i]),
+                                 static_cast<float>(b[i]));
+}
+
+#if defined(__x86_64__)
+// The intrinsics below are compiled for the features they need only, and
+// called after checking the CPU, so the library runs on any x86-64 host.
+// max/min_ps return the second operand unless the first is greater (less),
+// the same as ReduceFloat.
+template <ReductionType red_type>
+__attribute__((target("avx"))) inline __m256 ReduceFloat8(__m256 a, __m256 b) {
+  if constexpr (red_type == kSUM)
+    return _mm256_add_ps(a, b);
+  else if constexpr (red_type == kPROD)
+    return _mm256_mul_ps(a, b);
+  else if constexpr (red_type == kMAX)
+    return _mm256_max_ps(a, b);
+  else
+    return _mm256_min_ps(a, b);
+}
+
+// Returns the number of elements reduced, a multiple of 8.
+template <ReductionType red_type>
+__attribute__((target("avx,f16c"))) size_t
+ReduceFloat16F16C(const float16* a, float16* b, size_t n) {
+  // fp32_to_fp16 turns every NaN into a quiet NaN without payload
+  const __m128i nan_bits = _mm_set1_epi16(0x7E00);
+  const __m128i sign_bits = _mm_set1_epi16(static_cast<int16_t>(0x8000));
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 x = _mm256_cvtph_ps(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)));
+    __m256 y = _mm256_cvtph_ps(
+      _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i)));
+    __m256 r = ReduceFloat8<red_type>(x, y);
+    __m128i h = _mm256_cvtps_ph(r, _MM_FROUND_TO_NEAREST_INT);
+    __m256i is_nan = _mm256_castps_si256(_mm256_cmp_ps(r, r, _CMP_UNORD_Q));
+    __m128i nan_mask = _mm_packs_epi32(_mm256_castsi256_si128(is_nan),
+                                       _mm256_extractf128_si256(is_nan, 1));
+    h = _mm_blendv_epi8(
+      h, _mm_or_si128(_mm_and_si128(h, sign_bits), nan_bits), nan_mask);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b + i), h);
+  }
+  return i;
+}
+
+__attribute__((target("avx2"))) inline __m256
+BFloat16x8ToFloat(const bfloat16* ptr) {
+  __m128i bits = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+  return _mm256_castsi256_ps(
+    _mm256_slli_epi32(_mm256_cvtepu16_epi32(bits), 16));
+}
+
+// Rounds like fp32_to_bf16 rather than with vcvtneps2bf16, which flushes
+// denormals to zero.
+__attribute__((target("avx2"))) inline __m128i FloatToBFloat16x8(__m256 r) {
+  __m256i u = _mm256_castps_si256(r);
+  __m256i rounding_bias =
+    _mm256_add_epi32(_mm256_and_si256(_mm256_srli_epi32(u, 16),
+                                      _mm256_set1_epi32(1)),
+                     _mm256_set1_epi32(0x7FFF));
+  __m256i bits = _mm256_srli_epi32(_mm256_add_epi32(u, rounding_bias), 16);
+  __m256i is_nan = _mm256_castps_si256(_mm256_cmp_ps(r, r, _CMP_UNORD_Q));
+  bits = _mm256_blendv_epi8(bits, _mm256_set1_epi32(0x7FC0), is_nan);
+  // every lane is below 2^16, so the saturating pack keeps them as is
+  return _mm_packus_epi32(_mm256_castsi256_si128(bits),
+                          _mm256_extracti128_si256(bits, 1));
+}
+
+template <ReductionType red_type>
+__attribute__((target("avx2"))) size_t
+ReduceBFloat16AVX2(const bfloat16* a, bfloat16* b, size_t n) {
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256 r = ReduceFloat8<red_type>(BFloat16x8ToFloat(a + i),
+                                      BFloat16x8ToFloat(b + i));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(b + i), FloatToBFloat16x8(r));
+  }
+  return i;
+}
+#endif
+
+template <ReductionType red_type>
+void ReduceHalfLoops(DataType dtype, const void* in, void* inout, size_t n,
+                     bool vectorized) {
+  vectorized = vectorized && IsHalfReductionVectorized(dtype);
+  size_t i = 0;
+  if (dtype == kFloat16) {
+    const auto* a = reinterpret_cast<const float16*>(in);
+    auto* b = reinterpret_cast<float16*>(inout);
+#if defined(__x86_64__)
+    if (vectorized)
+      i = ReduceFloat16F16C<red_type>(a, b, n);
+#endif
+    ReduceHalfScalar<float16, red_type>(a, b, i, n);
+  } else {
+    const auto* a = reinterpret_cast<const bfloat16*>(in);
+    auto* b = reinterpret_cast<bfloat16*>(inout);
+#if defined(__x86_64__)
+    if (vectorized)
+      i = ReduceBFloat16AVX2<red_type>(a, b, n);
+#endif
+    ReduceHalfScalar<bfloat16, red_type>(a, b, i, n);
+  }
+}
+
+} // namespace
+
+bool IsHalfReductionVectorized(DataType dtype) {
+#if defined(__x86_64__)
+  static const bool has_f16c =
+    __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+  static const bool has_avx2 = __builtin_cpu_supports("avx2");
+  if (dtype == kFloat16)
+    return has_f16c;
+  if (dtype == kBFloat16)
+    return has_avx2;
+#endif
+  return false;
+}
+
+void ReduceHalf(DataType dtype, ReductionType red_type, const void* in,
+                void* inout, size_t num_elements, bool vectorized) {
+  HT_ASSERT(dtype == kFloat16 || dtype == kBFloat16)
+    << "Data type " << dtype << " is not a half-precision type";
+  switch (red_type) {
+    case kSUM:
+      return ReduceHalfLoops<kSUM>(dtype, in, inout, num_elements,
+                                   vectorized);
+    case kPROD:
+      return ReduceHalfLoops<kPROD>(dtype, in, inout, num_elements,
+                                    vectorized);
+    case kMAX:
+      return ReduceHalfLoops<kMAX>(dtype, in, inout, num_elements,
+                                   vectorized);
+    case kMIN:
+      return ReduceHalfLoops<kMIN>(dtype, in, inout, num_elements,
+                                   vectorized);
+    default:
+      HT_NOT_IMPLEMENTED << "Reduction type " << red_type
+                         << " is not supported for half-precision types";
+  }
+}
+
+} // namespace comm
+} // namespace impl
+} // namespace hetu
@@ -0,0 +1,23 @@
+#pragma once
+
+#include "hetu/core/dtype.h"
+#include "hetu/core/reduction_type.h"
+
+namespace hetu {
+namespace impl {
+namespace comm {
+
+// Computes inout[i] = in[i] (op) inout[i] on float16 or bfloat16 buffers,
+// widening to float32 and rounding back to nearest even. SUM, PROD, MAX and
+// MIN are supported. The loops use F16C (float16) or AVX2 (bfloat16) when
+// the CPU has them and `vectorized` is set; the results are bit-identical
+// to the scalar loops, including denormals.
+void ReduceHalf(DataType dtype, ReductionType red_type, const void* in,
+                void* inout, size_t num_elements, bool vectorized = true);
+
+// Whether ReduceHalf runs vectorized loops for `dtype` on this CPU.
+bool IsHalfReductionVectorized(DataType dtype);
+
+} // namespace comm
+} // namespace impl
+} // namespace hetu
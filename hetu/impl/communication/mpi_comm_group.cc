@@ -1,6 +1,11 @@
 #include "hetu/impl/communication/mpi_comm_group.h"
+#include "hetu/impl/communication/half_reduction.h"
 #include "hetu/impl/stream/CPUStream.h"
 #include "hetu/impl/utils/ndarray_utils.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
 #include <numeric>
 #include <mutex>
 
@@ -19,7 +24,65 @@ DECLARE_HT_EXCEPTION(mpi_error);
 
 namespace {
 
-inline MPI_Op to_MPI_Op(ReductionType red_type) {
+// MPI has no 16-bit floating point types, so float16 and bfloat16 are sent
+// as opaque 2-byte types and reduced by user-defined ops, which widen to
+// float32, reduce and round back. They are created right after MPI_Init.
+static MPI_Datatype mpi_float16_type = MPI_DATATYPE_NULL;
+static MPI_Datatype mpi_bfloat16_type = MPI_DATATYPE_NULL;
+constexpr ReductionType kHalfReductionTypes[] = {kSUM, kPROD, kMAX, kMIN};
+static MPI_Op mpi_float16_ops[4] = {MPI_OP_NULL, MPI_OP_NULL, MPI_OP_NULL,
+                                    MPI_OP_NULL};
+static MPI_Op mpi_bfloat16_ops[4] = {MPI_OP_NULL, MPI_OP_NULL, MPI_OP_NULL,
+                                     MPI_OP_NULL};
+
+// Computes inout[i] = in[i] (op) inout[i], as MPI_User_function requires.
+template <ReductionType red_type>
+void reduce_float16(void* in, void* inout, int* len, MPI_Datatype*) {
+  ReduceHalf(kFloat16, red_type, in, inout, *len);
+}
+
+template <ReductionType red_type>
+void reduce_bfloat16(void* in, void* inout, int* len, MPI_Datatype*) {
+  ReduceHalf(kBFloat16, red_type, in, inout, *len);
+}
+
+template <ReductionType red_type>
+void CreateHalfReductionOps(int index) {
+  MPI_CALL(MPI_Op_create(reduce_float16<red_type>, 1, &mpi_float16_ops[index]));
+  MPI_CALL(
+    MPI_Op_create(reduce_bfloat16<red_type>, 1, &mpi_bfloat16_ops[index]));
+}
+
+void CreateHalfTypesAndOps() {
+  MPI_CALL(MPI_Type_contiguous(2, MPI_BYTE, &mpi_float16_type));
+  MPI_CALL(MPI_Type_commit(&mpi_float16_type));
+  MPI_CALL(MPI_Type_contiguous(2, MPI_BYTE, &mpi_bfloat16_type));
+  MPI_CALL(MPI_Type_commit(&mpi_bfloat16_type));
+  CreateHalfReductionOps<kSUM>(0);
+  CreateHalfReductionOps<kPROD>(1);
+  CreateHalfReductionOps<kMAX>(2);
+  CreateHalfReductionOps<kMIN>(3);
+}
+
+void FreeHalfTypesAndOps() {
+  for (int i = 0; i < 4; i++) {
+    if (mpi_float16_ops[i] != MPI_OP_NULL)
+      MPI_Op_free(&mpi_float16_ops[i]);
+    if (mpi_bfloat16_ops[i] != MPI_OP_NULL)
+      MPI_Op_free(&mpi_bfloat16_ops[i]);
+  }
+  if (mpi_float16_type != MPI_DATATYPE_NULL)
+    MPI_Type_free(&mpi_float16_type);
+  if (mpi_bfloat16_type != MPI_DATATYPE_NULL)
+    MPI_Type_free(&mpi_bfloat16_type);
+}
+
+inline MPI_Op to_MPI_Op(ReductionType red_type, DataType dtype) {
+  if (dtype == kFloat16 || dtype == kBFloat16) {
+    for (int i = 0; i < 4; i++)
+      if (kHalfReductionTypes[i] == red_type)
+        return dtype == kFloat16 ? mpi_float16_ops[i] : mpi_bfloat16_ops[i];
+  }
   switch (red_type) {
     case kSUM: return MPI_SUM;
     case kPROD: return MPI_PROD;
@@ -42,6 +105,8 @@ inline MPI_Datatype to_MPI_Datatype(DataType dtype) {
     case kInt16: return MPI_SHORT;
     case kInt32: return MPI_INT;
     case kInt64: return MPI_LONG;
+    case kFloat16: return mpi_float16_type;
+    case kBFloat16: return mpi_bfloat16_type;
     case kFloat32: return MPI_FLOAT;
     case kFloat64: return MPI_DOUBLE;
     default:
@@ -58,6 +123,8 @@ inline int to_num_bytes(DataType dtype) {
     case kInt16: return 2;
     case kInt32: return 4;
     case kInt64: return 8;
+    case kFloat16: return 2;
+    case kBFloat16: return 2;
     case kFloat32: return 4;
     case kFloat64: return 8;
     default:
@@ -67,6 +134,56 @@ inline int to_num_bytes(DataType dtype) {
   }
 }
 
+// Bucket size of the pipelined AllReduceCoalesce, 4 MB by default.
+size_t GetCoalesceBucketBytes() {
+  static size_t bucket_bytes = []() {
+    constexpr size_t default_bucket_mb = 4;
+    // Bucket offsets are int64_t bytes.
+    constexpr size_t max_bucket_mb =
+      std::numeric_limits<int64_t>::max() >> 20;
+    size_t bucket_mb = default_bucket_mb;
+    const char* bucket_mb_str = std::getenv("HETU_MPI_BUCKET_SIZE_MB");
+    if (bucket_mb_str != NULL) {
+      try {
+        bucket_mb = std::stoul(bucket_mb_str);
+      } catch (const std::exception& e) {
+        HT_LOG_WARN
+          << "Invalid HETU_MPI_BUCKET_SIZE_MB: " << bucket_mb_str
+          << " is set, please provide an integer"
+          << ", default value will be used in this process.";
+      }
+      if (bucket_mb == 0 || bucket_mb > max_bucket_mb) {
+        HT_LOG_WARN << "HETU_MPI_BUCKET_SIZE_MB must be in [1, "
+                    << max_bucket_mb << "]"
+                    << ", default value will be used in this process.";
+        bucket_mb = default_bucket_mb;
+      }
+    }
+    return bucket_mb << 20;
+  }();
+  return bucket_bytes;
+}
+
+// Copies bytes [begin, end) of the flat layout of `arrays`, whose byte
+// offsets are `offsets`, into (`to_buffer`) or out of the same range of
+// `buffer`.
+void CopyFlatRange(const NDArrayList& arrays,
+                   const std::vector<int64_t>& offsets, uint8_t* buffer,
+                   int64_t begin, int64_t end, bool to_buffer) {
+  size_t i = std::upper_bound(offsets.begin(), offsets.end(), begin) -
+    offsets.begin() - 1;
+  for (; i < arrays.size() && offsets[i] < end; i++) {
+    int64_t lo = MAX(begin, offsets[i]);
+    int64_t hi = MIN(end, offsets[i + 1]);
+    auto* data = static_cast<uint8_t*>(arrays[i]->raw_data_ptr()) +
+      (lo - offsets[i]);
+    if (to_buffer)
+      std::memcpy(buffer + lo, data, hi - lo);
+    else
+      std::memcpy(data, buffer + lo, hi - lo);
+  }
+}
+
 static std::once_flag mpi_init_flag;
 static int mpi_world_rank = -1;
 static int mpi_world_size = -1;
@@ -104,12 +221,14 @@ static void MPI_Init_Once() {
       << "Failed to get the world rank and/or size. "
       << "(Got rank " << mpi_world_rank << " and size " << mpi_world_size
       << ".)";
+    CreateHalfTypesAndOps();
     // register exit handler
     HT_ASSERT(std::atexit([]() {
                 MPICallGuard guard;
                 HT_LOG_DEBUG << "Destructing MPI comm groups...";
                 mpi_comm_groups.clear();
                 worldwide_mpi_comm_groups.clear();
+                FreeHalfTypesAndOps();
                 MPI_CALL(MPI_Finalize());
                 HT_LOG_DEBUG << "Destructed MPI comm groups";
               }) == 0)
@@ -221,7 +340,7 @@ void MPICommunicationGroupDef::AllReduce(const NDArray& input, NDArray& output,
   void* recv_buf = output->raw_data_ptr();
   auto numel = input->numel();
   auto mpi_dtype = to_MPI_Datatype(input->dtype());
-  auto mpi_red_op = to_MPI_Op(red_type);
+  auto mpi_red_op = to_MPI_Op(red_type, input->dtype());
   _latest_future = CPUStream(_stream).EnqueueTask(
     [send_buf, recv_buf, numel, mpi_dtype, mpi_red_op, this]() {
       MPICallGuard mpi_guard;
@@ -236,42 +355,80 @@ void MPICommunicationGroupDef::AllReduceCoalesce(const NDArrayList& inputs,
                                                  NDArrayList& outputs,
                                                  NDArray contiguous_buffers,
                                                  ReductionType red_type) {
-  size_t n_bytes = 0;
+  HT_ASSERT(inputs.size() == outputs.size())
+    << "Got " << inputs.size() << " inputs and " << outputs.size()
+    << " outputs for AllReduceCoalesce.";
+  if (inputs.empty())
+    return;
+  // Byte offsets of the arrays in the flat layout.
+  int64_t num_bytes_per_element = DataType2Size(inputs[0]->dtype());
+  std::vector<int64_t> offsets(inputs.size() + 1, 0);
   for (size_t i = 0; i < inputs.size(); i++) {
     HT_ASSERT_CPU_DEVICE(inputs[i]);
     HT_ASSERT_CPU_DEVICE(outputs[i]);
     HT_ASSERT_EXCHANGABLE(inputs[i], outputs[i]);
-    n_bytes += inputs[i]->numel();
+    HT_ASSERT_SAME_DTYPE(inputs[i], inputs[0]);
+    offsets[i + 1] = offsets[i] + inputs[i]->numel() * num_bytes_per_element;
   }
-  HT_ASSERT(contiguous_buffers->numel() >= n_bytes);
   auto mpi_dtype = to_MPI_Datatype(inputs[0]->dtype());
-  auto mpi_red_op = to_MPI_Op(red_type);
-
-  if (contiguous_buffers->numel() > 0) {
-    void* buffer_ptr = contiguous_buffers->raw_data_ptr();
+  auto mpi_red_op = to_MPI_Op(red_type, inputs[0]->dtype());
+
+  if (contiguous_buffers.is_defined() && contiguous_buffers->numel() > 0) {
+    HT_ASSERT_CPU_DEVICE(contiguous_buffers);
+    HT_ASSERT_SAME_DTYPE(contiguous_buffers, inputs[0]);
+    HT_ASSERT(contiguous_buffers->numel() * num_bytes_per_element >=
+              offsets.back())
+      << "The contiguous buffer of AllReduceCoalesce is too small: "
+      << contiguous_buffers->numel() << " elements for "
+      << offsets.back() / num_bytes_per_element << ".";
+    auto* buffer_ptr =
+      static_cast<uint8_t*>(contiguous_buffers->raw_data_ptr());
+    // Arrays that already live in the buffer (see MakeCoalescedViews) are
+    // reduced in place, skipping the pack and unpack passes.
+    bool in_place = true;
+    for (size_t i = 0; i < inputs.size() && in_place; i++)
+      in_place = inputs[i]->raw_data_ptr() == buffer_ptr + offsets[i] &&
+        outputs[i]->raw_data_ptr() == buffer_ptr + offsets[i];
+    int64_t bucket_bytes = GetCoalesceBucketBytes();
+    bucket_bytes = MAX(bucket_bytes / num_bytes_per_element, int64_t(1)) *
+      num_bytes_per_element;
     _latest_future = CPUStream(_stream).EnqueueTask(
-      [inputs, outputs, buffer_ptr, mpi_dtype, mpi_red_op, this]() {
-        int offset = 0;
-        int num_bytes_per_element = to_num_bytes(inputs[0]->dtype());
-        for (size_t i = 0; i < inputs.size(); i++) {
-          void* send_buf = inputs[i]->raw_data_ptr();
-          int num_bytes = inputs[i]->numel() * num_bytes_per_element;
-          std::memcpy(buffer_ptr + offset, send_buf, num_bytes);
-          offset += num_bytes;
-        }
-        MPICallGuard mpi_guard;
-        MPI_CALL(MPI_Allreduce(MPI_IN_PLACE, buffer_ptr,
-                               int(offset / num_bytes_per_element), mpi_dtype,
-                               mpi_red_op, _comm));
-        offset = 0;
-        for (size_t i = 0; i < outputs.size(); i++) {
-          void* recv_buf = outputs[i]->raw_data_ptr();
-          int num_bytes = outputs[i]->numel() * num_bytes_per_element;
-          std::memcpy(recv_buf, buffer_ptr + offset, num_bytes);
-          offset += num_bytes;
+      [inputs, outputs, offsets, buffer_ptr, in_place, num_bytes_per_element,
+       bucket_bytes, mpi_dtype, mpi_red_op, this]() {
+        // Buckets are pipelined: bucket b is packed and its reduction is
+        // started before bucket b - 1 is waited for and unpacked, so the
+        // copies overlap with the reductions in flight.
+        int64_t total_bytes = offsets.back();
+        int64_t num_buckets = DIVUP(total_bytes, bucket_bytes);
+        std::vector<MPI_Request> requests(num_buckets, MPI_REQUEST_NULL);
+        auto finish_bucket = [&](int64_t bucket) {
+          {
+            MPICallGuard mpi_guard;
+            MPI_CALL(MPI_Wait(&requests[bucket], MPI_STATUS_IGNORE));
+          }
+          if (!in_place)
+            CopyFlatRange(outputs, offsets, buffer_ptr, bucket * bucket_bytes,
+                          MIN((bucket + 1) * bucket_bytes, total_bytes), false);
+        };
+        for (int64_t bucket = 0; bucket < num_buckets; bucket++) {
+          int64_t begin = bucket * bucket_bytes;
+          int64_t end = MIN(begin + bucket_bytes, total_bytes);
+          if (!in_place)
+            CopyFlatRange(inputs, offsets, buffer_ptr, begin, end, true);
+          {
+            MPICallGuard mpi_guard;
+            MPI_CALL(MPI_Iallreduce(
+              MPI_IN_PLACE, buffer_ptr + begin,
+              static_cast<int>((end - begin) / num_bytes_per_element),
+              mpi_dtype, mpi_red_op, _comm, &requests[bucket]));
+          }
+          if (bucket > 0)
+            finish_bucket(bucket - 1);
         }
+        finish_bucket(num_buckets - 1);
       },
       "AllReduceCoalesce(reduction=" + ReductionType2Str(red_type) + ")");
+    NDArray::MarkUsedBy(contiguous_buffers, _stream);
   } else {
     _latest_future = CPUStream(_stream).EnqueueTask(
       [inputs, outputs, mpi_dtype, mpi_red_op, this]() {
@@ -324,7 +481,7 @@ void MPICommunicationGroupDef::Reduce(const NDArray& input, NDArray& output,
   }
   auto numel = input->numel();
   auto mpi_dtype = to_MPI_Datatype(input->dtype());
-  auto mpi_red_op = to_MPI_Op(red_type);
+  auto mpi_red_op = to_MPI_Op(red_type, input->dtype());
   _latest_future = CPUStream(_stream).EnqueueTask(
     [send_buf, recv_buf, numel, mpi_dtype, mpi_red_op, root, this]() {
       MPICallGuard mpi_guard;
@@ -376,7 +533,7 @@ void MPICommunicationGroupDef::ReduceScatter(const NDArray& input,
   void* send_buf = input->raw_data_ptr();
   void* recv_buf = output->raw_data_ptr();
   auto mpi_dtype = to_MPI_Datatype(input->dtype());
-  auto mpi_red_op = to_MPI_Op(red_type);
+  auto mpi_red_op = to_MPI_Op(red_type, input->dtype());
   _latest_future = CPUStream(_stream).EnqueueTask(
     [send_buf, recv_buf, output_size, mpi_dtype, mpi_red_op, this]() {
       MPICallGuard mpi_guard;
@@ -813,6 +970,28 @@ Device MPISetUpDeviceMappingAndAssignLocalDeviceOnce(
 //   return ranks;
 // }
 
+NDArrayList MakeCoalescedViews(const NDArray& flat_buffer,
+                               const HTShapeList& shapes) {
+  HT_ASSERT_CPU_DEVICE(flat_buffer);
+  HT_ASSERT(flat_buffer->is_contiguous())
+    << "The flat buffer must be contiguous.";
+  NDArrayList views;
+  views.reserve(shapes.size());
+  int64_t offset = flat_buffer->storage_offset();
+  for (const auto& shape : shapes) {
+    auto meta = NDArrayMeta()
+                  .set_dtype(flat_buffer->dtype())
+                  .set_shape(shape)
+                  .set_device(flat_buffer->device());
+    views.emplace_back(meta, flat_buffer->storage(), offset);
+    offset += meta.numel();
+  }
+  HT_ASSERT(offset - flat_buffer->storage_offset() <= flat_buffer->numel())
+    << "The flat buffer of " << flat_buffer->numel()
+    << " elements cannot hold arrays of shapes " << shapes << ".";
+  return views;
+}
+
 } // namespace comm
 } // namespace impl
 } // namespace hetu
\ No newline at end of file
@@ -119,6 +119,11 @@ class MPICommunicationGroup final
 int GetMPIWorldRank();
 int GetMPIWorldSize();
 int GetMPIGroupRank(const std::vector<int>& world_ranks);
+// Splits a flat buffer into consecutive contiguous arrays of the given shapes.
+// Arrays living in such views are all-reduced by AllReduceCoalesce in place,
+// without packing them into the buffer first.
+NDArrayList MakeCoalescedViews(const NDArray& flat_buffer,
+                               const HTShapeList& shapes);
 void MPISetUpDeviceMappingWithAssignedLocalDeviceOnce(const Device& local_device);
 Device MPISetUpDeviceMappingAndAssignLocalDeviceOnce(
   const std::map<DeviceType, int>& resources = {{kCUDA, 8}},
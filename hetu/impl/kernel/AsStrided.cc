@@ -1,26 +1,12 @@
 #include "hetu/core/ndarray.h"
 #include "hetu/core/stream.h"
 #include "hetu/impl/utils/common_utils.h"
+#include "hetu/impl/utils/strided_copy.h"
 #include "hetu/impl/stream/CPUStream.h"
 
 namespace hetu {
 namespace impl {
 
-template <typename spec_t>
-void asstrided_cpu(const spec_t *input, spec_t *output, size_t size,
-                   const int64_t *stride_in, const int64_t *stride_out, int ndim) {
-  for (size_t idx = 0; idx < size; ++idx) {
-    int index = 0;
-    size_t ind = idx;
-    for (int i = 0; i < ndim; i++) {
-      int tmp_index = ind / stride_out[i];
-      index += tmp_index * stride_in[i];
-      ind = ind % stride_out[i];
-    }
-    output[idx] = input[index];
-  }
-}
-
 void AsStridedCpu(const NDArray& input, NDArray& output, const HTShape& stride,
                   const Stream& stream) {
   HT_ASSERT_CPU_DEVICE(input);
@@ -28,17 +14,16 @@ void AsStridedCpu(const NDArray& input, NDArray& output, const HTShape& stride,
   CPUStream cpu_stream(stream);
 
   size_t size = output->numel();
-  int ndim = output->ndim();
 
   if (size == 0)
     return;
   HT_DISPATCH_FLOATING_TYPES(
     input->dtype(), spec_t, "AsStridedCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
-      [input, output, stride, size, ndim]() {
-        asstrided_cpu<spec_t>(
-          input->data_ptr<spec_t>(), output->data_ptr<spec_t>(), size, 
-          stride.data(), output->stride().data(), ndim);
+      [input, output, stride]() {
+        StridedCopy<spec_t>(input->data_ptr<spec_t>(),
+                            output->data_ptr<spec_t>(), output->shape(),
+                            stride, output->stride());
       },"AsStrided");     
     });
   NDArray::MarkUsedBy({input, output}, stream);
@@ -54,19 +39,18 @@ void array_zero_set_cpu(spec_t* input, size_t size) {
   }
 }
 
+// Strides may overlap, so the gradient is accumulated serially.
 template <typename spec_t>
-void asstrided_gradient_cpu(const spec_t *input, spec_t *output, size_t size,
-                            const int64_t *stride_in, const int64_t *stride_out, int ndim) {
-  for (size_t idx = 0; idx < size; ++idx) {
-    int index = 0;
-    size_t ind = idx;
-    for (int i = 0; i < ndim; i++) {
-      int tmp_index = ind / stride_out[i];
-      index += tmp_index * stride_in[i];
-      ind = ind % stride_out[i];
-    }
-    output[index] += input[idx];
-  }
+void asstrided_gradient_cpu(const spec_t* output_grad, spec_t* input_grad,
+                            const HTShape& shape, const HTStride& stride_out,
+                            const HTStride& stride_in) {
+  StridedForEachRow(
+    shape, stride_out, stride_in, false,
+    [&](int64_t o_idx, int64_t i_idx, int64_t size, int64_t o_inner,
+        int64_t i_inner) {
+      for (int64_t k = 0; k < size; ++k)
+        input_grad[i_idx + k * i_inner] += output_grad[o_idx + k * o_inner];
+    });
 }
 
 void AsStridedGradientCpu(const NDArray& output, NDArray& input,
@@ -76,19 +60,18 @@ void AsStridedGradientCpu(const NDArray& output, NDArray& input,
 
   CPUStream cpu_stream(stream);
   size_t size = output->numel();
-  int ndim = output->ndim();
 
   if (size == 0)
     return;
   HT_DISPATCH_FLOATING_TYPES(
-    input->dtype(), spec_t, "AsStridedGradientCuda", [&]() {
+    input->dtype(), spec_t, "AsStridedGradientCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
-      [input, output, stride, size, ndim]() {
+      [input, output, stride]() {
         array_zero_set_cpu<spec_t>(
           input->data_ptr<spec_t>(), input->numel());
         asstrided_gradient_cpu<spec_t>(
-          output->data_ptr<spec_t>(), input->data_ptr<spec_t>(), size, 
-          stride.data(), output->stride().data(), ndim);
+          output->data_ptr<spec_t>(), input->data_ptr<spec_t>(),
+          output->shape(), output->stride(), stride);
       },
       "AsStridedGradient");     
     });
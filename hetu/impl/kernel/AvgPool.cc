@@ -85,15 +85,15 @@ void AvgPoolCpu(const NDArray& input, const size_t kernel_H,
   size_t output_size = input_N * input_C * output_H * output_W;
 
   CPUStream cpu_stream(stream);
-  dnnl::engine eng(dnnl::engine::kind::cpu, 0);
   
   if (output_size == 0)
     return;
   HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
     input->dtype(), spec_t, "AvgPoolCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
-        [eng, input, output, kernel_H, kernel_W,
+        [input, output, kernel_H, kernel_W,
         padding, stride]() {
+        const auto& eng = hetu::cpu::GetDNNLEngine();
         auto dnnltype = hetu::cpu::dtype_to_dnnltype(input->dtype());
         auto src_md = dnnl::memory::desc(input->shape(), dnnltype, dnnl::memory::format_tag::nchw);
         auto src_mem = dnnl::memory(src_md, eng, input->data_ptr<spec_t>());
@@ -107,21 +107,24 @@ void AvgPoolCpu(const NDArray& input, const size_t kernel_H,
         dnnl::memory::dims dilation = {0, 0};
         dnnl::memory::dims padding_dims_l = {int(padding), int(padding)};
         dnnl::memory::dims padding_dims_r = {int(padding), int(padding)};
-        auto pooling_pd = dnnl::pooling_forward::primitive_desc(eng,
-                dnnl::prop_kind::forward_training, dnnl::algorithm::pooling_avg_include_padding, 
-                src_md, dst_md, strides_dims, kernel_dims, dilation, padding_dims_l, padding_dims_r);
+        hetu::cpu::DNNLPrimitiveKey key("avgpool");
+        key << dnnltype << input->shape() << output->shape()
+            << kernel_H << kernel_W << padding << stride;
+        auto pooling = hetu::cpu::GetOrCreateDNNLPrimitive<dnnl::pooling_forward>(key, [&]() {
+          return dnnl::pooling_forward::primitive_desc(eng,
+                  dnnl::prop_kind::forward_training, dnnl::algorithm::pooling_avg_include_padding, 
+                  src_md, dst_md, strides_dims, kernel_dims, dilation, padding_dims_l, padding_dims_r);
+        });
 
-        auto workspace_mem = dnnl::memory(pooling_pd.workspace_desc(), eng);
-
-        auto pooling_prim = dnnl::pooling_forward(pooling_pd);
+        auto workspace_mem = dnnl::memory(pooling->pd.workspace_desc(), eng);
 
         std::unordered_map<int, dnnl::memory> pooling_args;
         pooling_args.insert({DNNL_ARG_SRC, src_mem});
         pooling_args.insert({DNNL_ARG_DST, dst_mem});
         pooling_args.insert({DNNL_ARG_WORKSPACE, workspace_mem});
 
-        dnnl::stream engine_stream(eng);
-        pooling_prim.execute(engine_stream, pooling_args);
+        auto& engine_stream = hetu::cpu::GetDNNLStream();
+        pooling->prim.execute(engine_stream, pooling_args);
         engine_stream.wait();
       },
       "AvgPool");
@@ -140,14 +143,14 @@ void AvgPoolGradientCpu(const NDArray& output_Y, const NDArray& gradient_Y,
   HT_ASSERT_SAME_DEVICE(output_Y, gradient_X);
 
   CPUStream cpu_stream(stream);
-  dnnl::engine eng(dnnl::engine::kind::cpu, 0);
 
   HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
     input_X->dtype(), spec_t, "AvgPoolGradientCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
-        [eng, output_Y, gradient_Y,
+        [output_Y, gradient_Y,
         input_X, gradient_X, kernel_H, kernel_W,
         padding, stride]() {
+        const auto& eng = hetu::cpu::GetDNNLEngine();
         auto dnnltype = hetu::cpu::dtype_to_dnnltype(input_X->dtype());
         auto src_md = dnnl::memory::desc(input_X->shape(), dnnltype, dnnl::memory::format_tag::nchw);
         auto src_mem = dnnl::memory(src_md, eng, input_X->data_ptr<spec_t>());
@@ -167,18 +170,26 @@ void AvgPoolGradientCpu(const NDArray& output_Y, const NDArray& gradient_Y,
         dnnl::memory::dims dilation = {0, 0};
         dnnl::memory::dims padding_dims_l = {int(padding), int(padding)};
         dnnl::memory::dims padding_dims_r = {int(padding), int(padding)};
-        auto pooling_pd = dnnl::pooling_forward::primitive_desc(eng,
-                dnnl::prop_kind::forward_training, dnnl::algorithm::pooling_avg_include_padding, 
-                src_md, dst_md, strides_dims, kernel_dims, dilation, padding_dims_l, padding_dims_r);
-        
-        auto pooling_bwd_pd = dnnl::pooling_backward::primitive_desc(eng,
-                dnnl::algorithm::pooling_avg_include_padding, 
-                gsrc_md, gdst_md, strides_dims, kernel_dims, dilation, 
-                padding_dims_l, padding_dims_r, pooling_pd);
-
-        auto workspace_mem = dnnl::memory(pooling_pd.workspace_desc(), eng);
-
-        auto pooling_prim = dnnl::pooling_backward(pooling_bwd_pd);
+        hetu::cpu::DNNLPrimitiveKey fwd_key("avgpool");
+        fwd_key << dnnltype << input_X->shape() << output_Y->shape()
+                << kernel_H << kernel_W << padding << stride;
+        auto pooling_fwd = hetu::cpu::GetOrCreateDNNLPrimitive<dnnl::pooling_forward>(fwd_key, [&]() {
+          return dnnl::pooling_forward::primitive_desc(eng,
+                  dnnl::prop_kind::forward_training, dnnl::algorithm::pooling_avg_include_padding, 
+                  src_md, dst_md, strides_dims, kernel_dims, dilation, padding_dims_l, padding_dims_r);
+        });
+
+        hetu::cpu::DNNLPrimitiveKey key("avgpool_backward");
+        key << dnnltype << gradient_X->shape() << gradient_Y->shape()
+            << kernel_H << kernel_W << padding << stride;
+        auto pooling = hetu::cpu::GetOrCreateDNNLPrimitive<dnnl::pooling_backward>(key, [&]() {
+          return dnnl::pooling_backward::primitive_desc(eng,
+                  dnnl::algorithm::pooling_avg_include_padding, 
+                  gsrc_md, gdst_md, strides_dims, kernel_dims, dilation, 
+                  padding_dims_l, padding_dims_r, pooling_fwd->pd);
+        });
+
+        auto workspace_mem = dnnl::memory(pooling_fwd->pd.workspace_desc(), eng);
 
         std::unordered_map<int, dnnl::memory> pooling_args;
         pooling_args.insert({DNNL_ARG_SRC, src_mem});
@@ -187,8 +198,8 @@ void AvgPoolGradientCpu(const NDArray& output_Y, const NDArray& gradient_Y,
         pooling_args.insert({DNNL_ARG_DIFF_DST, gdst_mem});
         pooling_args.insert({DNNL_ARG_WORKSPACE, workspace_mem});
 
-        dnnl::stream engine_stream(eng);
-        pooling_prim.execute(engine_stream, pooling_args);
+        auto& engine_stream = hetu::cpu::GetDNNLStream();
+        pooling->prim.execute(engine_stream, pooling_args);
         engine_stream.wait();
       },
       "AvgPoolGradient");     
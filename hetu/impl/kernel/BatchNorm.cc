@@ -22,13 +22,13 @@ void BatchNormCpu(const NDArray& input_X, const NDArray& bn_scale,
   HT_ASSERT_SAME_DEVICE(input_X, save_var);
 
   CPUStream cpu_stream(stream);
-  dnnl::engine eng(dnnl::engine::kind::cpu, 0);
 
   HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
     input_X->dtype(), spec_t, "BatchNormCuda", [&]() {
         auto _future = cpu_stream.EnqueueTask(
-        [eng, input_X, bn_scale, bn_bias,
+        [input_X, bn_scale, bn_bias,
          output_Y, save_mean, save_var, momentum, eps]() {
+        const auto& eng = hetu::cpu::GetDNNLEngine();
         auto dnnltype = hetu::cpu::dtype_to_dnnltype(input_X->dtype());
         auto src_md = dnnl::memory::desc(input_X->shape(), dnnltype, input_X->stride());
         auto dst_md = dnnl::memory::desc(output_Y->shape(), dnnltype, output_Y->stride());
@@ -39,15 +39,18 @@ void BatchNormCpu(const NDArray& input_X, const NDArray& bn_scale,
         auto scale_mem = dnnl::memory(scaleshift_md, eng, bn_scale->data_ptr<spec_t>());
         auto shift_mem = dnnl::memory(scaleshift_md, eng, bn_bias->data_ptr<spec_t>());
 
-        auto bnorm_pd = dnnl::batch_normalization_forward::primitive_desc(eng,
-                dnnl::prop_kind::forward_training, src_md, dst_md, float(eps),
-                dnnl::normalization_flags::use_scale | dnnl::normalization_flags::use_shift);
+        hetu::cpu::DNNLPrimitiveKey key("batch_norm");
+        key << dnnltype << input_X->shape() << input_X->stride()
+            << output_Y->stride() << float(eps);
+        auto bnorm = hetu::cpu::GetOrCreateDNNLPrimitive<dnnl::batch_normalization_forward>(key, [&]() {
+          return dnnl::batch_normalization_forward::primitive_desc(eng,
+                  dnnl::prop_kind::forward_training, src_md, dst_md, float(eps),
+                  dnnl::normalization_flags::use_scale | dnnl::normalization_flags::use_shift);
+        });
 
-        auto mean_mem = dnnl::memory(bnorm_pd.mean_desc(), eng, save_mean->data_ptr<spec_t>());
-        auto variance_mem = dnnl::memory(bnorm_pd.variance_desc(), eng, save_var->data_ptr<spec_t>());
-        auto workspace_mem = dnnl::memory(bnorm_pd.workspace_desc(), eng);
-
-        auto bnorm_prim = dnnl::batch_normalization_forward(bnorm_pd);
+        auto mean_mem = dnnl::memory(bnorm->pd.mean_desc(), eng, save_mean->data_ptr<spec_t>());
+        auto variance_mem = dnnl::memory(bnorm->pd.variance_desc(), eng, save_var->data_ptr<spec_t>());
+        auto workspace_mem = dnnl::memory(bnorm->pd.workspace_desc(), eng);
 
         std::unordered_map<int, dnnl::memory> bnorm_args;
         bnorm_args.insert({DNNL_ARG_SRC, src_mem});
@@ -58,8 +61,8 @@ void BatchNormCpu(const NDArray& input_X, const NDArray& bn_scale,
         bnorm_args.insert({DNNL_ARG_WORKSPACE, workspace_mem});
         bnorm_args.insert({DNNL_ARG_DST, dst_mem});
 
-        dnnl::stream engine_stream(eng);
-        bnorm_prim.execute(engine_stream, bnorm_args);
+        auto& engine_stream = hetu::cpu::GetDNNLStream();
+        bnorm->prim.execute(engine_stream, bnorm_args);
         engine_stream.wait();
       },
       "BatchNorm");
@@ -85,12 +88,12 @@ void BatchNormGradientCpu(const NDArray& gradient_Y, const NDArray& input_X,
   HT_ASSERT_SAME_DEVICE(gradient_Y, save_var);
 
   CPUStream cpu_stream(stream);
-  dnnl::engine eng(dnnl::engine::kind::cpu, 0);
   HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
     input_X->dtype(), spec_t, "BatchNormGradientCpu", [&]() {
         auto _future = cpu_stream.EnqueueTask(
-        [eng, gradient_Y, input_X, bn_scale, gradient_X,
+        [gradient_Y, input_X, bn_scale, gradient_X,
          gradient_bn_scale, gradient_bn_bias, save_mean, save_var, eps]() {
+        const auto& eng = hetu::cpu::GetDNNLEngine();
         auto dnnltype = hetu::cpu::dtype_to_dnnltype(input_X->dtype());
         auto src_md = dnnl::memory::desc(input_X->shape(), dnnltype, dnnl::memory::format_tag::nchw);
         auto gdst_md = dnnl::memory::desc(gradient_Y->shape(), dnnltype, dnnl::memory::format_tag::nchw);
@@ -108,17 +111,19 @@ void BatchNormGradientCpu(const NDArray& gradient_Y, const NDArray& input_X,
         auto gbias_mem = dnnl::memory(scaleshift_md, eng, gradient_bn_bias->data_ptr<spec_t>());
 
         // Create primitive descriptor.
-        auto bnorm_pd = dnnl::batch_normalization_forward::primitive_desc(eng,
-                dnnl::prop_kind::forward_training, src_md, gdst_md, float(eps),
-                dnnl::normalization_flags::use_scale | dnnl::normalization_flags::use_shift);
-
-        auto bnorm_bwd_pd = dnnl::batch_normalization_backward::primitive_desc(eng,
-                dnnl::prop_kind::backward, src_md, gdst_md, src_md, float(eps),
-                dnnl::normalization_flags::use_scale | dnnl::normalization_flags::use_shift, bnorm_pd);
+        hetu::cpu::DNNLPrimitiveKey key("batch_norm_backward");
+        key << dnnltype << input_X->shape() << gradient_Y->shape()
+            << save_mean->shape() << save_mean->stride() << float(eps);
+        auto bnorm = hetu::cpu::GetOrCreateDNNLPrimitive<dnnl::batch_normalization_backward>(key, [&]() {
+          auto bnorm_pd = dnnl::batch_normalization_forward::primitive_desc(eng,
+                  dnnl::prop_kind::forward_training, src_md, gdst_md, float(eps),
+                  dnnl::normalization_flags::use_scale | dnnl::normalization_flags::use_shift);
+          return dnnl::batch_normalization_backward::primitive_desc(eng,
+                  dnnl::prop_kind::backward, src_md, gdst_md, src_md, float(eps),
+                  dnnl::normalization_flags::use_scale | dnnl::normalization_flags::use_shift, bnorm_pd);
+        });
         
-        auto workspace_mem = dnnl::memory(bnorm_bwd_pd.workspace_desc(), eng);
-
-        auto bnorm_prim = dnnl::batch_normalization_backward(bnorm_bwd_pd);
+        auto workspace_mem = dnnl::memory(bnorm->pd.workspace_desc(), eng);
 
         std::unordered_map<int, dnnl::memory> bnorm_args;
         bnorm_args.insert({DNNL_ARG_SRC, src_mem});
@@ -131,8 +136,8 @@ void BatchNormGradientCpu(const NDArray& gradient_Y, const NDArray& input_X,
         bnorm_args.insert({DNNL_ARG_DIFF_DST, gdst_mem});
         bnorm_args.insert({DNNL_ARG_DIFF_SRC, gsrc_mem});
 
-        dnnl::stream engine_stream(eng);
-        bnorm_prim.execute(engine_stream, bnorm_args);
+        auto& engine_stream = hetu::cpu::GetDNNLStream();
+        bnorm->prim.execute(engine_stream, bnorm_args);
         engine_stream.wait();
       },
          "BatchNormGradient");
@@ -54,7 +54,7 @@ void BinaryElewiseToolCpu(const NDArray& inputA, const NDArray& inputB,
       auto _future = cpu_stream.EnqueueTask(
         [inputA, inputB, output, A_dims, A_stride,
          B_dims, B_stride, out_strides, op]() {
-          dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+          const auto& eng = hetu::cpu::GetDNNLEngine();
           auto dnnltype = hetu::cpu::dtype_to_dnnltype(inputA->dtype());
           auto src_A_md = dnnl::memory::desc(A_dims, dnnltype, A_stride);
           auto src_B_md = dnnl::memory::desc(B_dims, dnnltype, B_stride);
@@ -65,19 +65,16 @@ void BinaryElewiseToolCpu(const NDArray& inputA, const NDArray& inputB,
           auto src_B_mem = dnnl::memory(src_B_md, eng, inputB->data_ptr<spec_t>());
           auto dst_mem = dnnl::memory(dst_md, eng, output->data_ptr<spec_t>());
 
-          auto binary_pd = dnnl::binary::primitive_desc(eng, op,
-                  src_A_md, src_B_md, dst_md);
-
-          // Create the primitive.
-          auto binary_prim = dnnl::binary(binary_pd);
+          // Create (or reuse) the primitive.
+          auto binary = hetu::cpu::GetOrCreateDNNLBinary(op, src_A_md, src_B_md, dst_md);
 
           // Primitive arguments. Set up in-place execution by assigning src_0 as DST.
           std::unordered_map<int, dnnl::memory> binary_args;
           binary_args.insert({DNNL_ARG_SRC_0, src_A_mem});
           binary_args.insert({DNNL_ARG_SRC_1, src_B_mem});
           binary_args.insert({DNNL_ARG_DST, dst_mem});
-          dnnl::stream engine_stream(eng);
-          binary_prim.execute(engine_stream, binary_args);
+          auto& engine_stream = hetu::cpu::GetDNNLStream();
+          binary->prim.execute(engine_stream, binary_args);
           engine_stream.wait();
         },
         "BinaryEleWise");
@@ -33,7 +33,6 @@ void BroadcastCpu(const NDArray& input, NDArray& output, const Stream& stream) {
   HT_ASSERT_SAME_DEVICE(input, output);
 
   CPUStream cpu_stream(stream);
-  dnnl::engine eng(dnnl::engine::kind::cpu, 0);
 
   size_t size = output->numel();
   size_t input_size = input->numel();
@@ -57,7 +56,6 @@ void BroadcastGradientCpu(const NDArray& input, NDArray& output,
   HT_ASSERT_SAME_DEVICE(input, output);
 
   CPUStream cpu_stream(stream);
-  dnnl::engine eng(dnnl::engine::kind::cpu, 0);
 
   size_t size = output->numel();
   size_t input_size = input->numel();
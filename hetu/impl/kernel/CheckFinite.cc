@@ -0,0 +1,98 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/core/stream.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/impl/utils/common_utils.h"
+#include "hetu/impl/utils/omp_utils.h"
+#include <cmath>
+
+namespace hetu {
+namespace impl {
+
+namespace {
+
+// Flags of non-finite values, OR-ed over the whole input.
+enum CheckNumericFlag : int {
+  kHasNaN = 1,
+  kHasNegInf = 2,
+  kHasPosInf = 4,
+};
+
+template <typename spec_t>
+int check_numeric_cpu(const spec_t* input, size_t size, int64_t ndims,
+                      const int64_t* stride, const int64_t* c_shape,
+                      bool contiguous) {
+  int flags = 0;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) reduction(| : flags)
+#endif
+  for (size_t idx = 0; idx < size; idx++) {
+    int64_t in_idx =
+      contiguous ? idx : hetu::impl::get_index(idx, ndims, stride, c_shape);
+    float val = static_cast<float>(input[in_idx]);
+    if (std::isnan(val))
+      flags |= kHasNaN;
+    else if (std::isinf(val))
+      flags |= val < 0 ? kHasNegInf : kHasPosInf;
+  }
+  return flags;
+}
+
+int CheckNumericFlags(const NDArray& input) {
+  int flags = 0;
+  HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
+    input->dtype(), spec_t, "CheckNumericCpu", [&]() {
+      flags = check_numeric_cpu<spec_t>(
+        input->data_ptr<spec_t>(), input->numel(), input->ndim(),
+        input->stride().data(), input->shape().data(),
+        input->is_contiguous());
+    });
+  return flags;
+}
+
+} // namespace
+
+// output[0] is set to 1 if any element is NaN or Inf, and 0 otherwise.
+void CheckFiniteCpu(const NDArray& input, NDArray& output,
+                    const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(input);
+  HT_ASSERT_SAME_DEVICE(input, output);
+
+  size_t size = input->numel();
+  if (size == 0)
+    return;
+
+  CPUStream cpu_stream(stream);
+  auto _future = cpu_stream.EnqueueTask(
+    [input, output]() {
+      output->data_ptr<float>()[0] = CheckNumericFlags(input) != 0 ? 1.f : 0.f;
+    },
+    "CheckFinite");
+  NDArray::MarkUsedBy({input, output}, stream);
+}
+
+// output[0], output[1] and output[2] are set to 1 if any element is NaN,
+// -Inf and +Inf, respectively.
+void CheckNumericCpu(const NDArray& input, NDArray& output,
+                     const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(input);
+  HT_ASSERT_SAME_DEVICE(input, output);
+
+  size_t size = input->numel();
+  if (size == 0)
+    return;
+
+  CPUStream cpu_stream(stream);
+  auto _future = cpu_stream.EnqueueTask(
+    [input, output]() {
+      int flags = CheckNumericFlags(input);
+      float* ptr = output->data_ptr<float>();
+      ptr[0] = (flags & kHasNaN) ? 1.f : 0.f;
+      ptr[1] = (flags & kHasNegInf) ? 1.f : 0.f;
+      ptr[2] = (flags & kHasPosInf) ? 1.f : 0.f;
+    },
+    "CheckNumeric");
+  NDArray::MarkUsedBy({input, output}, stream);
+}
+
+} // namespace impl
+} // namespace hetu
@@ -2,52 +2,19 @@
 #include "hetu/core/stream.h"
 #include "hetu/impl/utils/common_utils.h"
 #include "hetu/impl/utils/omp_utils.h"
+#include "hetu/impl/utils/strided_copy.h"
 #include "hetu/impl/utils/dnnl_utils.h"
 #include "hetu/impl/stream/CPUStream.h"
 
 namespace hetu {
 namespace impl {
 
-template <typename spec_t>
-void concatenate_cpu(const spec_t* input, spec_t* output, int input_width,
-                     int output_width, int offset, int concat_size,
-                     size_t size) {
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static)
-#endif
-  for (size_t idx = 0; idx < size; ++idx) {
-    int post_ind = idx % concat_size;
-    int prev_ind = idx / concat_size;
-    int mid_ind = prev_ind % input_width + offset;
-    prev_ind = prev_ind / input_width;
-    int out_ind = (prev_ind * output_width + mid_ind) * concat_size + post_ind;
-    output[out_ind] = input[idx];
-  }
-}
-
-template <typename spec_t>
-void concatenate_gradient_cpu(const spec_t* output_grad, spec_t* input_grad,
-                              int input_width, int output_width, int offset,
-                              int concat_size, size_t size) {
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static)
-#endif
-  for (size_t idx = 0; idx < size; ++idx) {
-    int post_ind = idx % concat_size;
-    int prev_ind = idx / concat_size;
-    int mid_ind = prev_ind % input_width + offset;
-    prev_ind = prev_ind / input_width;
-    int out_ind = (prev_ind * output_width + mid_ind) * concat_size + post_ind;
-    input_grad[idx] = output_grad[out_ind];
-  }
-}
-
 void ConcatenateCpu(const NDArrayList& inputs, NDArray& output, size_t axis,
                     const Stream& stream) {
   HT_ASSERT_CPU_DEVICE(output);
 
   CPUStream cpu_stream(stream);
-  dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+  const auto& eng = hetu::cpu::GetDNNLEngine();
 
   for (size_t i = 0; i < inputs.size(); ++i)
     HT_ASSERT_SAME_DEVICE(inputs[i], output);
@@ -66,15 +33,18 @@ void ConcatenateCpu(const NDArrayList& inputs, NDArray& output, size_t axis,
           src_mems.push_back(mem);
       }
 
-      // Create primitive descriptor.
-      auto concat_pd = dnnl::concat::primitive_desc(eng, axis, src_mds);
+      // Create (or reuse) the primitive.
+      hetu::cpu::DNNLPrimitiveKey key("concatenate");
+      key << dnnltype << axis << inputs.size();
+      for (size_t i = 0; i < inputs.size(); ++i)
+        key << inputs[i]->shape() << inputs[i]->stride();
+      auto concat = hetu::cpu::GetOrCreateDNNLPrimitive<dnnl::concat>(key, [&]() {
+        return dnnl::concat::primitive_desc(eng, axis, src_mds);
+      });
 
       // Create destination (dst) memory object using the memory descriptor
       // created by the primitive.
-      auto dst_mem = dnnl::memory(concat_pd.dst_desc(), eng, output->data_ptr<spec_t>());
-
-      // Create the primitive.
-      auto concat_prim = dnnl::concat(concat_pd);
+      auto dst_mem = dnnl::memory(concat->pd.dst_desc(), eng, output->data_ptr<spec_t>());
 
       // Primitive arguments.
       std::unordered_map<int, dnnl::memory> concat_args;
@@ -82,9 +52,9 @@ void ConcatenateCpu(const NDArrayList& inputs, NDArray& output, size_t axis,
           concat_args.insert({DNNL_ARG_MULTIPLE_SRC + i, src_mems[i]});
       concat_args.insert({DNNL_ARG_DST, dst_mem});
       auto _future = cpu_stream.EnqueueTask(
-      [concat_prim, concat_args, eng]() {
-        dnnl::stream engine_stream(eng);
-        concat_prim.execute(engine_stream, concat_args);
+      [concat, concat_args]() {
+        auto& engine_stream = hetu::cpu::GetDNNLStream();
+        concat->prim.execute(engine_stream, concat_args);
         engine_stream.wait();
       },
       "Concatenate");
@@ -99,7 +69,6 @@ void ConcatenateGradientCpu(const NDArray& output_grad, NDArray& input_grad,
   HT_ASSERT_SAME_DEVICE(output_grad, input_grad);
 
   CPUStream cpu_stream(stream);
-  dnnl::engine eng(dnnl::engine::kind::cpu, 0);
 
   size_t size = input_grad->numel();
   size_t now_ndim = output_grad->ndim();
@@ -120,13 +89,16 @@ void ConcatenateGradientCpu(const NDArray& output_grad, NDArray& input_grad,
   int input_width = input_grad->shape(axis);
   if (size == 0 || input_width == 0 || output_width == 0)
     return;
+  // The input gradient is the slice of the output gradient starting at
+  // `offset` along `axis`.
+  int64_t o_offset = offset * output_grad->stride(axis);
   HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
     input_grad->dtype(), spec_t, "ConcatenateGradientCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
-      [output_grad, input_grad, input_width, output_width, offset, concat_size, size]() {
-      concatenate_gradient_cpu<spec_t>(
-        output_grad->data_ptr<spec_t>(), input_grad->data_ptr<spec_t>(),
-        input_width, output_width, offset, concat_size, size);
+      [output_grad, input_grad, o_offset]() {
+        StridedCopy<spec_t>(output_grad->data_ptr<spec_t>() + o_offset,
+                            input_grad->data_ptr<spec_t>(), input_grad->shape(),
+                            output_grad->stride(), input_grad->stride());
       },
       "ConcatGradient");  
     });
@@ -15,13 +15,13 @@ void Conv2dCpu(const NDArray& input_x, const NDArray& input_f, NDArray& output,
   HT_ASSERT_SAME_DEVICE(input_x, output);
 
   CPUStream cpu_stream(stream);
-  dnnl::engine eng(dnnl::engine::kind::cpu, 0);
 
   HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
     input_x->dtype(), spec_t, "Conv2dCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
-      [input_x, input_f, output, eng, 
+      [input_x, input_f, output,
       padding_h, padding_w, stride_h, stride_w]() {
+        const auto& eng = hetu::cpu::GetDNNLEngine();
         auto dnnltype = hetu::cpu::dtype_to_dnnltype(input_x->dtype());
         auto conv_src_md = dnnl::memory::desc(input_x->shape(), dnnltype, 
                                               dnnl::memory::format_tag::nchw);
@@ -39,14 +39,16 @@ void Conv2dCpu(const NDArray& input_x, const NDArray& input_f, NDArray& output,
         dnnl::memory::dims padding_dims_l = {int(padding_h), int(padding_w)};
         dnnl::memory::dims padding_dims_r = {int(padding_h), int(padding_w)};
 
-        // Create primitive descriptor.
-        auto conv_pd = dnnl::convolution_forward::primitive_desc(eng,
-                dnnl::prop_kind::forward_training, dnnl::algorithm::convolution_direct,
-                conv_src_md, conv_weights_md, conv_dst_md,
-                strides_dims, padding_dims_l, padding_dims_r);
-
-        // Create the primitive.
-        auto conv_prim = dnnl::convolution_forward(conv_pd);
+        // Create (or reuse) the primitive.
+        hetu::cpu::DNNLPrimitiveKey key("conv2d");
+        key << dnnltype << input_x->shape() << input_f->shape() << output->shape()
+            << strides_dims << padding_dims_l << padding_dims_r;
+        auto conv = hetu::cpu::GetOrCreateDNNLPrimitive<dnnl::convolution_forward>(key, [&]() {
+          return dnnl::convolution_forward::primitive_desc(eng,
+                  dnnl::prop_kind::forward_training, dnnl::algorithm::convolution_direct,
+                  conv_src_md, conv_weights_md, conv_dst_md,
+                  strides_dims, padding_dims_l, padding_dims_r);
+        });
 
         // Primitive arguments.
         std::unordered_map<int, dnnl::memory> conv_args;
@@ -54,8 +56,8 @@ void Conv2dCpu(const NDArray& input_x, const NDArray& input_f, NDArray& output,
         conv_args.insert({DNNL_ARG_WEIGHTS, conv_weights_mem});
         conv_args.insert({DNNL_ARG_DST, conv_dst_mem});
 
-        dnnl::stream engine_stream(eng);
-        conv_prim.execute(engine_stream, conv_args);
+        auto& engine_stream = hetu::cpu::GetDNNLStream();
+        conv->prim.execute(engine_stream, conv_args);
         engine_stream.wait();
       },
       "Conv2d"); 
@@ -73,12 +75,12 @@ void Conv2dGradientofFilterCpu(const NDArray& input_x,
   HT_ASSERT_SAME_DEVICE(input_x, gradient_f);
 
   CPUStream cpu_stream(stream);
-  dnnl::engine eng(dnnl::engine::kind::cpu, 0); 
   HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
     input_x->dtype(), spec_t, "Conv2dGradientofFilterCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
-      [input_x, gradient_y, gradient_f, eng,
+      [input_x, gradient_y, gradient_f,
       padding_h, padding_w, stride_h, stride_w]() {
+      const auto& eng = hetu::cpu::GetDNNLEngine();
       auto dnnltype = hetu::cpu::dtype_to_dnnltype(input_x->dtype());
       auto conv_src_md = dnnl::memory::desc(input_x->shape(), dnnltype, 
                                             dnnl::memory::format_tag::nchw);
@@ -95,19 +97,20 @@ void Conv2dGradientofFilterCpu(const NDArray& input_x,
       dnnl::memory::dims padding_dims_l = {int(padding_h), int(padding_w)};
       dnnl::memory::dims padding_dims_r = {int(padding_h), int(padding_w)};
 
-      // Create primitive descriptor.
-      auto conv_pd = dnnl::convolution_forward::primitive_desc(eng,
-              dnnl::prop_kind::forward_training, dnnl::algorithm::convolution_direct,
-              conv_src_md, conv_weights_md, conv_dst_md,
-              strides_dims, padding_dims_l, padding_dims_r);
-      
-      auto conv_bwd_pd = dnnl::convolution_backward_weights::primitive_desc(eng,
-              dnnl::algorithm::convolution_direct,
-              conv_src_md, conv_dst_md, conv_weights_md,
-              strides_dims, padding_dims_l, padding_dims_r, conv_pd);
-
-      // Create the primitive.
-      auto conv_prim = dnnl::convolution_backward_weights(conv_bwd_pd);
+      // Create (or reuse) the primitive.
+      hetu::cpu::DNNLPrimitiveKey key("conv2d_backward_weights");
+      key << dnnltype << input_x->shape() << gradient_f->shape() << gradient_y->shape()
+          << strides_dims << padding_dims_l << padding_dims_r;
+      auto conv = hetu::cpu::GetOrCreateDNNLPrimitive<dnnl::convolution_backward_weights>(key, [&]() {
+        auto conv_pd = dnnl::convolution_forward::primitive_desc(eng,
+                dnnl::prop_kind::forward_training, dnnl::algorithm::convolution_direct,
+                conv_src_md, conv_weights_md, conv_dst_md,
+                strides_dims, padding_dims_l, padding_dims_r);
+        return dnnl::convolution_backward_weights::primitive_desc(eng,
+                dnnl::algorithm::convolution_direct,
+                conv_src_md, conv_dst_md, conv_weights_md,
+                strides_dims, padding_dims_l, padding_dims_r, conv_pd);
+      });
 
       // Primitive arguments.
       std::unordered_map<int, dnnl::memory> conv_args;
@@ -115,8 +118,8 @@ void Conv2dGradientofFilterCpu(const NDArray& input_x,
       conv_args.insert({DNNL_ARG_DIFF_WEIGHTS, conv_weights_mem});
       conv_args.insert({DNNL_ARG_DIFF_DST, conv_dst_mem});
 
-      dnnl::stream engine_stream(eng);
-      conv_prim.execute(engine_stream, conv_args);   
+      auto& engine_stream = hetu::cpu::GetDNNLStream();
+      conv->prim.execute(engine_stream, conv_args);
       engine_stream.wait();      
       },
       "Conv2dFilter");  
@@ -133,12 +136,12 @@ void Conv2dGradientofDataCpu(const NDArray& input_f, const NDArray& gradient_y,
   HT_ASSERT_SAME_DEVICE(input_f, gradient_x);
 
   CPUStream cpu_stream(stream);
-  dnnl::engine eng(dnnl::engine::kind::cpu, 0);
   HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
     input_f->dtype(), spec_t, "Conv2dGradientofDataCpu", [&]() {
     auto _future = cpu_stream.EnqueueTask(
-      [input_f, gradient_y, gradient_x, eng,
+      [input_f, gradient_y, gradient_x,
       padding_h, padding_w, stride_h, stride_w]() {
+      const auto& eng = hetu::cpu::GetDNNLEngine();
       auto dnnltype = hetu::cpu::dtype_to_dnnltype(input_f->dtype());
       auto conv_src_md = dnnl::memory::desc(gradient_x->shape(), dnnltype, 
                                             dnnl::memory::format_tag::nchw);
@@ -155,19 +158,20 @@ void Conv2dGradientofDataCpu(const NDArray& input_f, const NDArray& gradient_y,
       dnnl::memory::dims padding_dims_l = {int(padding_h), int(padding_w)};
       dnnl::memory::dims padding_dims_r = {int(padding_h), int(padding_w)};
 
-      // Create primitive descriptor.
-      auto conv_pd = dnnl::convolution_forward::primitive_desc(eng,
-              dnnl::prop_kind::forward_training, dnnl::algorithm::convolution_direct,
-              conv_src_md, conv_weights_md, conv_dst_md,
-              strides_dims, padding_dims_l, padding_dims_r);
-      
-      auto conv_bwd_pd = dnnl::convolution_backward_data::primitive_desc(eng,
-              dnnl::algorithm::convolution_direct,
-              conv_src_md, conv_weights_md, conv_dst_md,
-              strides_dims, padding_dims_l, padding_dims_r, conv_pd);
-
-      // Create the primitive.
-      auto conv_prim = dnnl::convolution_backward_data(conv_bwd_pd);
+      // Create (or reuse) the primitive.
+      hetu::cpu::DNNLPrimitiveKey key("conv2d_backward_data");
+      key << dnnltype << gradient_x->shape() << input_f->shape() << gradient_y->shape()
+          << strides_dims << padding_dims_l << padding_dims_r;
+      auto conv = hetu::cpu::GetOrCreateDNNLPrimitive<dnnl::convolution_backward_data>(key, [&]() {
+        auto conv_pd = dnnl::convolution_forward::primitive_desc(eng,
+                dnnl::prop_kind::forward_training, dnnl::algorithm::convolution_direct,
+                conv_src_md, conv_weights_md, conv_dst_md,
+                strides_dims, padding_dims_l, padding_dims_r);
+        return dnnl::convolution_backward_data::primitive_desc(eng,
+                dnnl::algorithm::convolution_direct,
+                conv_src_md, conv_weights_md, conv_dst_md,
+                strides_dims, padding_dims_l, padding_dims_r, conv_pd);
+      });
 
       // Primitive arguments.
       std::unordered_map<int, dnnl::memory> conv_args;
@@ -175,8 +179,8 @@ void Conv2dGradientofDataCpu(const NDArray& input_f, const NDArray& gradient_y,
       conv_args.insert({DNNL_ARG_WEIGHTS, conv_weights_mem});
       conv_args.insert({DNNL_ARG_DIFF_DST, conv_dst_mem});
 
-      dnnl::stream engine_stream(eng);
-      conv_prim.execute(engine_stream, conv_args);         
+      auto& engine_stream = hetu::cpu::GetDNNLStream();
+      conv->prim.execute(engine_stream, conv_args);
       },
       "Conv2dData");
     });
@@ -194,12 +198,12 @@ void Conv2dAddBiasCpu(const NDArray& input_x, const NDArray& input_f,
   HT_ASSERT_SAME_DEVICE(input_x, output);
 
   CPUStream cpu_stream(stream);
-  dnnl::engine eng(dnnl::engine::kind::cpu, 0);
   HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
     input_x->dtype(), spec_t, "Conv2dAddBiasCpu", [&]() {
     auto _future = cpu_stream.EnqueueTask(
-      [input_x, input_f, output, bias, eng, 
+      [input_x, input_f, output, bias,
       padding_h, padding_w, stride_h, stride_w]() {
+      const auto& eng = hetu::cpu::GetDNNLEngine();
       auto dnnltype = hetu::cpu::dtype_to_dnnltype(input_x->dtype());
       auto conv_src_md = dnnl::memory::desc(input_x->shape(), dnnltype, 
                                             dnnl::memory::format_tag::nchw);
@@ -219,14 +223,16 @@ void Conv2dAddBiasCpu(const NDArray& input_x, const NDArray& input_f,
       dnnl::memory::dims padding_dims_l = {int(padding_h), int(padding_w)};
       dnnl::memory::dims padding_dims_r = {int(padding_h), int(padding_w)};
 
-      // Create primitive descriptor.
-      auto conv_pd = dnnl::convolution_forward::primitive_desc(eng,
-              dnnl::prop_kind::forward_training, dnnl::algorithm::convolution_direct,
-              conv_src_md, conv_weights_md, conv_bias_md, conv_dst_md,
-              strides_dims, padding_dims_l, padding_dims_r);
-
-      // Create the primitive.
-      auto conv_prim = dnnl::convolution_forward(conv_pd);
+      // Create (or reuse) the primitive.
+      hetu::cpu::DNNLPrimitiveKey key("conv2d_bias");
+      key << dnnltype << input_x->shape() << input_f->shape() << bias->shape()
+          << output->shape() << strides_dims << padding_dims_l << padding_dims_r;
+      auto conv = hetu::cpu::GetOrCreateDNNLPrimitive<dnnl::convolution_forward>(key, [&]() {
+        return dnnl::convolution_forward::primitive_desc(eng,
+                dnnl::prop_kind::forward_training, dnnl::algorithm::convolution_direct,
+                conv_src_md, conv_weights_md, conv_bias_md, conv_dst_md,
+                strides_dims, padding_dims_l, padding_dims_r);
+      });
 
       // Primitive arguments.
       std::unordered_map<int, dnnl::memory> conv_args;
@@ -235,8 +241,8 @@ void Conv2dAddBiasCpu(const NDArray& input_x, const NDArray& input_f,
       conv_args.insert({DNNL_ARG_BIAS, conv_bias_mem});
       conv_args.insert({DNNL_ARG_DST, conv_dst_mem});
 
-      dnnl::stream engine_stream(eng);
-      conv_prim.execute(engine_stream, conv_args); 
+      auto& engine_stream = hetu::cpu::GetDNNLStream();
+      conv->prim.execute(engine_stream, conv_args);
       },
       "Conv2dBias");
     });
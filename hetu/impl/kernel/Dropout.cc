@@ -0,0 +1,129 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/core/stream.h"
+#include "hetu/impl/random/CPURandomState.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/impl/utils/common_utils.h"
+#include "hetu/impl/utils/cpu_math.h"
+#include "hetu/impl/utils/omp_utils.h"
+
+namespace hetu {
+namespace impl {
+
+namespace {
+
+// The keep mask of element idx only depends on (seed, idx), so the result
+// does not depend on the number of threads.
+template <typename spec_t>
+void dropout_cpu(const spec_t* input, spec_t* output, bool* mask,
+                 float drop_rate, uint64_t seed, size_t size, int64_t ndims,
+                 const int64_t* in_stride, const int64_t* out_stride,
+                 const int64_t* mask_stride, const int64_t* c_shape,
+                 bool contiguous) {
+  const uint64_t key = hetu::cpu::SplitMix64(seed);
+  const float scale = 1.0f / (1 - drop_rate);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (size_t idx = 0; idx < size; idx++) {
+    bool keep = hetu::cpu::CounterUniform(key, idx) >= drop_rate;
+    int64_t in_idx = idx, out_idx = idx, mask_idx = idx;
+    if (!contiguous) {
+      in_idx = hetu::impl::get_index(idx, ndims, in_stride, c_shape);
+      out_idx = hetu::impl::get_index(idx, ndims, out_stride, c_shape);
+      mask_idx = hetu::impl::get_index(idx, ndims, mask_stride, c_shape);
+    }
+    output[out_idx] = keep
+      ? static_cast<spec_t>(static_cast<float>(input[in_idx]) * scale)
+      : static_cast<spec_t>(0);
+    mask[mask_idx] = keep;
+  }
+}
+
+template <typename spec_t>
+void dropout_gradient_cpu(const spec_t* grad, const bool* fw_mask,
+                          spec_t* output, float drop_rate, size_t size,
+                          int64_t ndims, const int64_t* grad_stride,
+                          const int64_t* mask_stride,
+                          const int64_t* out_stride, const int64_t* c_shape,
+                          bool contiguous) {
+  const float scale = 1.0f / (1 - drop_rate);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (size_t idx = 0; idx < size; idx++) {
+    int64_t grad_idx = idx, mask_idx = idx, out_idx = idx;
+    if (!contiguous) {
+      grad_idx = hetu::impl::get_index(idx, ndims, grad_stride, c_shape);
+      mask_idx = hetu::impl::get_index(idx, ndims, mask_stride, c_shape);
+      out_idx = hetu::impl::get_index(idx, ndims, out_stride, c_shape);
+    }
+    output[out_idx] = fw_mask[mask_idx]
+      ? static_cast<spec_t>(static_cast<float>(grad[grad_idx]) * scale)
+      : static_cast<spec_t>(0);
+  }
+}
+
+} // namespace
+
+void DropoutCpu(const NDArray& input, double drop_rate, uint64_t seed,
+                NDArray& output, NDArray& mask, const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(input);
+  HT_ASSERT_SAME_DEVICE(input, output);
+  HT_ASSERT_SAME_DEVICE(input, mask);
+  HT_ASSERT_SAME_SHAPE(input, output);
+  HT_ASSERT_SAME_SHAPE(input, mask);
+  size_t size = input->numel();
+  if (size == 0)
+    return;
+  if (seed == 0)
+    seed = GenNextRandomSeed();
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(input->dtype(), spec_t, "DropoutCpu", [&]() {
+    auto _future = cpu_stream.EnqueueTask(
+      [input, output, mask, drop_rate, seed, size]() {
+        bool contiguous = input->is_contiguous() && output->is_contiguous() &&
+          mask->is_contiguous();
+        dropout_cpu<spec_t>(
+          input->data_ptr<spec_t>(), output->data_ptr<spec_t>(),
+          mask->data_ptr<bool>(), static_cast<float>(drop_rate), seed, size,
+          input->ndim(), input->stride().data(), output->stride().data(),
+          mask->stride().data(), input->shape().data(), contiguous);
+      },
+      "Dropout");
+  });
+  NDArray::MarkUsedBy({input, output, mask}, stream);
+}
+
+void DropoutGradientCpu(const NDArray& grad, const NDArray& fw_mask,
+                        double drop_rate, NDArray& output,
+                        const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(grad);
+  HT_ASSERT_SAME_DEVICE(grad, fw_mask);
+  HT_ASSERT_SAME_DEVICE(grad, output);
+  HT_ASSERT_SAME_SHAPE(grad, fw_mask);
+  HT_ASSERT_SAME_SHAPE(grad, output);
+  size_t size = grad->numel();
+  if (size == 0)
+    return;
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(
+    grad->dtype(), spec_t, "DropoutGradientCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [grad, fw_mask, output, drop_rate, size]() {
+          bool contiguous = grad->is_contiguous() &&
+            fw_mask->is_contiguous() && output->is_contiguous();
+          dropout_gradient_cpu<spec_t>(
+            grad->data_ptr<spec_t>(), fw_mask->data_ptr<bool>(),
+            output->data_ptr<spec_t>(), static_cast<float>(drop_rate), size,
+            grad->ndim(), grad->stride().data(), fw_mask->stride().data(),
+            output->stride().data(), grad->shape().data(), contiguous);
+        },
+        "DropoutGradient");
+    });
+  NDArray::MarkUsedBy({grad, fw_mask, output}, stream);
+}
+
+} // namespace impl
+} // namespace hetu
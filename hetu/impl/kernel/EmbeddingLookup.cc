@@ -1,8 +1,11 @@
 #include "hetu/core/ndarray.h"
 #include "hetu/core/stream.h"
 #include "hetu/impl/utils/common_utils.h"
+#include "hetu/impl/utils/cpu_math.h"
 #include "hetu/impl/utils/omp_utils.h"
 #include "hetu/impl/stream/CPUStream.h"
+#include <algorithm>
+#include <vector>
 
 namespace hetu {
 namespace impl {
@@ -27,6 +30,106 @@ void embedding_lookup_cpu(const spec_t* input, const int64_t* ids, size_t size,
   }
 }
 
+namespace {
+
+// Positions of the valid ids grouped by id: the ids at positions
+// order[offsets[k]], ..., order[offsets[k + 1] - 1] all equal unique[k].
+// Ids out of [0, num_rows) are dropped, as the forward pass outputs zeros
+// for them (e.g., ids of other partitions of a vocab parallel table).
+struct IdSegments {
+  std::vector<int64_t> unique;
+  std::vector<int64_t> offsets;
+  std::vector<int64_t> order;
+
+  inline int64_t num_segments() const {
+    return unique.size();
+  }
+};
+
+// Sorts (id, position) pairs with a parallel merge sort: chunks are sorted
+// by separate threads and then merged pairwise in log2(#chunks) rounds.
+IdSegments SortIdSegments(const int64_t* ids, size_t size, int64_t num_rows) {
+  using IdPos = std::pair<int64_t, int64_t>;
+  std::vector<IdPos> pairs;
+  pairs.reserve(size);
+  for (size_t i = 0; i < size; i++)
+    if (ids[i] >= 0 && ids[i] < num_rows)
+      pairs.emplace_back(ids[i], i);
+  const int64_t n = pairs.size();
+  const int64_t num_chunks =
+    MAX(MIN(static_cast<int64_t>(hetu::omp::OMP_GET_MAX_THREADS()),
+            DIVUP(n, int64_t(4096))),
+        int64_t(1));
+  auto chunk_begin = [&](int64_t c) {
+    return MIN(n, c * DIVUP(n, num_chunks));
+  };
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int64_t c = 0; c < num_chunks; c++)
+    std::sort(pairs.begin() + chunk_begin(c), pairs.begin() + chunk_begin(c + 1));
+  if (num_chunks > 1) {
+    std::vector<IdPos> buffer(n);
+    for (int64_t width = 1; width < num_chunks; width *= 2) {
+      int64_t num_merges = DIVUP(num_chunks, 2 * width);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+      for (int64_t m = 0; m < num_merges; m++) {
+        int64_t lo = chunk_begin(2 * m * width);
+        int64_t mid = chunk_begin(MIN((2 * m + 1) * width, num_chunks));
+        int64_t hi = chunk_begin(MIN((2 * m + 2) * width, num_chunks));
+        std::merge(pairs.begin() + lo, pairs.begin() + mid,
+                   pairs.begin() + mid, pairs.begin() + hi,
+                   buffer.begin() + lo);
+      }
+      pairs.swap(buffer);
+    }
+  }
+  IdSegments segs;
+  segs.order.resize(n);
+  for (int64_t i = 0; i < n; i++) {
+    segs.order[i] = pairs[i].second;
+    if (i == 0 || pairs[i].first != pairs[i - 1].first) {
+      segs.unique.push_back(pairs[i].first);
+      segs.offsets.push_back(i);
+    }
+  }
+  segs.offsets.push_back(n);
+  return segs;
+}
+
+// Sums the gradient rows of each segment. Every output row is written by
+// exactly one thread, so duplicated ids need no atomics. Row k of the
+// output is row unique[k] if `by_id`, and row k otherwise.
+template <typename spec_t>
+void segment_sum_rows_cpu(const spec_t* output_grad, const IdSegments& segs,
+                          size_t length, bool by_id, spec_t* output) {
+  using acc_t = hetu::cpu::acc_type<spec_t>;
+  const int64_t num_segments = segs.num_segments();
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    std::vector<acc_t> acc(length);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic, 16)
+#endif
+    for (int64_t k = 0; k < num_segments; k++) {
+      std::fill(acc.begin(), acc.end(), acc_t(0));
+      for (int64_t p = segs.offsets[k]; p < segs.offsets[k + 1]; p++) {
+        const spec_t* grad_ptr = output_grad + segs.order[p] * length;
+#pragma omp simd
+        for (size_t i = 0; i < length; i++)
+          acc[i] += static_cast<acc_t>(grad_ptr[i]);
+      }
+      spec_t* out_ptr = output + (by_id ? segs.unique[k] : k) * length;
+      for (size_t i = 0; i < length; i++)
+        out_ptr[i] = static_cast<spec_t>(acc[i]);
+    }
+  }
+}
+
 template <typename spec_t>
 void array_zero_set_cpu(spec_t* input, size_t size) {
 #ifdef _OPENMP
@@ -37,21 +140,23 @@ void array_zero_set_cpu(spec_t* input, size_t size) {
   }
 }
 
+// Copies row k of `values` to row ids[k] of `output` for non-negative ids.
 template <typename spec_t>
-void embedding_lookup_gradient_cpu(const spec_t* output_grad, const int64_t* ids,
-                                   size_t size, size_t length,
-                                   spec_t* input_grad) {
+void scatter_rows_cpu(const int64_t* ids, const spec_t* values,
+                      int64_t num_ids, size_t length, spec_t* output) {
 #ifdef _OPENMP
 #pragma omp parallel for schedule(static)
 #endif
-  for (size_t idx = 0; idx < size / length; ++idx) {
-    int id = int(ids[idx]);
-    for (size_t i = 0; i < length; i++) {
-      input_grad[length * id + i] +=  output_grad[length * idx + i];
-    }
+  for (int64_t k = 0; k < num_ids; k++) {
+    if (ids[k] < 0)
+      continue;
+    std::copy(values + k * length, values + (k + 1) * length,
+              output + ids[k] * length);
   }
 }
 
+} // namespace
+
 void EmbeddingLookupCpu(const NDArray& input, const NDArray& id,
                         NDArray& output, const Stream& stream) {
   HT_ASSERT_CPU_DEVICE(input);
@@ -108,18 +213,113 @@ void EmbeddingLookupGradientCpu(const NDArray& output_grad, const NDArray& id,
   if (size == 0 || length == 0)
     return;
   HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
-    input_grad->dtype(), spec_t, "EmbeddingLookupGradientCuda", [&]() {
+    input_grad->dtype(), spec_t, "EmbeddingLookupGradientCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
       [input_grad, output_grad, id, size, length]() {
+      auto segs = SortIdSegments(id->data_ptr<int64_t>(), id->numel(),
+                                 input_grad->shape(0));
       array_zero_set_cpu(input_grad->data_ptr<spec_t>(), size);
-      embedding_lookup_gradient_cpu(output_grad->data_ptr<spec_t>(),
-                                    id->data_ptr<int64_t>(), output_grad->numel(), length,
-                                    input_grad->data_ptr<spec_t>());
+      segment_sum_rows_cpu(output_grad->data_ptr<spec_t>(), segs, length,
+                           true, input_grad->data_ptr<spec_t>());
       },
       "EmbbedingLookupGradient");  
     });
   NDArray::MarkUsedBy({output_grad, id, input_grad}, stream);
 }
 
+// Gradient of the embedding table as indexed slices: unique_ids[k] is the
+// k-th distinct valid id in ascending order and grad_values[k] is the sum of
+// its gradient rows. Both have one entry per looked-up id; the unused tail
+// of unique_ids is filled with -1 and that of grad_values with zeros. Ids
+// out of [0, num_rows) are dropped. Unlike EmbeddingLookupGradientCpu, the
+// cost is independent of the table size.
+void EmbeddingLookupSparseGradientCpu(const NDArray& output_grad,
+                                      const NDArray& id, int64_t num_rows,
+                                      NDArray& unique_ids,
+                                      NDArray& grad_values,
+                                      const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(output_grad);
+  HT_ASSERT_SAME_DEVICE(output_grad, id);
+  HT_ASSERT_SAME_DEVICE(output_grad, unique_ids);
+  HT_ASSERT_SAME_DEVICE(output_grad, grad_values);
+  HT_ASSERT(id->dtype() == kInt64 && unique_ids->dtype() == kInt64)
+    << "Ids must be int64, got " << id->dtype() << " and "
+    << unique_ids->dtype();
+  HT_ASSERT(output_grad->is_contiguous() && id->is_contiguous() &&
+            unique_ids->is_contiguous() && grad_values->is_contiguous())
+    << "Sparse embedding gradient only supports contiguous arrays.";
+  size_t size = id->numel();
+  size_t length = output_grad->shape(-1);
+  HT_ASSERT(output_grad->numel() == size * length &&
+            unique_ids->numel() == size &&
+            grad_values->numel() == size * length)
+    << "Shapes mismatched: output_grad " << output_grad->shape() << ", id "
+    << id->shape() << ", unique_ids " << unique_ids->shape()
+    << ", grad_values " << grad_values->shape();
+  if (size == 0 || length == 0)
+    return;
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
+    output_grad->dtype(), spec_t, "EmbeddingLookupSparseGradientCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [output_grad, id, num_rows, unique_ids, grad_values, size, length]() {
+          auto segs =
+            SortIdSegments(id->data_ptr<int64_t>(), size, num_rows);
+          int64_t num_unique = segs.num_segments();
+          auto* ids_ptr = unique_ids->data_ptr<int64_t>();
+          std::copy(segs.unique.begin(), segs.unique.end(), ids_ptr);
+          std::fill(ids_ptr + num_unique, ids_ptr + size, int64_t(-1));
+          auto* values_ptr = grad_values->data_ptr<spec_t>();
+          segment_sum_rows_cpu(output_grad->data_ptr<spec_t>(), segs, length,
+                               false, values_ptr);
+          array_zero_set_cpu(values_ptr + num_unique * length,
+                             (size - num_unique) * length);
+        },
+        "EmbeddingLookupSparseGradient");
+    });
+  NDArray::MarkUsedBy({output_grad, id, unique_ids, grad_values}, stream);
+}
+
+// Scatters the indexed slices of EmbeddingLookupSparseGradientCpu into the
+// dense gradient of the table. Ids are distinct, so rows are copied in
+// parallel without conflicts.
+void IndexedSlicesToDenseCpu(const NDArray& unique_ids,
+                             const NDArray& grad_values, NDArray& input_grad,
+                             const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(input_grad);
+  HT_ASSERT_SAME_DEVICE(input_grad, unique_ids);
+  HT_ASSERT_SAME_DEVICE(input_grad, grad_values);
+  HT_ASSERT_SAME_DTYPE(input_grad, grad_values);
+  HT_ASSERT(unique_ids->dtype() == kInt64)
+    << "Ids must be int64, got " << unique_ids->dtype();
+  HT_ASSERT(input_grad->ndim() == 2 && input_grad->is_contiguous() &&
+            unique_ids->is_contiguous() && grad_values->is_contiguous())
+    << "Indexed slices only scatter into contiguous 2-D arrays.";
+  HT_ASSERT(grad_values->numel() == unique_ids->numel() * input_grad->shape(1))
+    << "Shapes mismatched: unique_ids " << unique_ids->shape()
+    << ", grad_values " << grad_values->shape() << ", input_grad "
+    << input_grad->shape();
+  int64_t num_ids = unique_ids->numel();
+  size_t length = input_grad->shape(1);
+  size_t size = input_grad->numel();
+  if (size == 0)
+    return;
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
+    input_grad->dtype(), spec_t, "IndexedSlicesToDenseCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [unique_ids, grad_values, input_grad, num_ids, length, size]() {
+          array_zero_set_cpu(input_grad->data_ptr<spec_t>(), size);
+          scatter_rows_cpu(unique_ids->data_ptr<int64_t>(),
+                           grad_values->data_ptr<spec_t>(), num_ids, length,
+                           input_grad->data_ptr<spec_t>());
+        },
+        "IndexedSlicesToDense");
+    });
+  NDArray::MarkUsedBy({unique_ids, grad_values, input_grad}, stream);
+}
+
 } // namespace impl
 } // namespace hetu
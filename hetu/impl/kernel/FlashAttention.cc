@@ -0,0 +1,648 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/core/stream.h"
+#include "hetu/impl/random/CPURandomState.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/impl/utils/common_utils.h"
+#include "hetu/impl/utils/cpu_math.h"
+#include "hetu/impl/utils/omp_utils.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+namespace hetu {
+namespace impl {
+
+namespace {
+
+// Attention is computed tile by tile as in FlashAttention: a tile of
+// kAttnBlockM queries is kept in float while tiles of kAttnBlockN keys and
+// values stream through, with an online softmax that rescales the partial
+// outputs. The full score matrix is never materialized; the working set of
+// a thread is a few hundred KB for head sizes up to 256.
+constexpr int64_t kAttnBlockM = 32;
+constexpr int64_t kAttnBlockN = 64;
+
+// Element (b, t, h, :) of a q/k/v-like array, where t is the token index
+// within sequence b. Fixed-length arrays are [batch_size, seqlen, nheads,
+// head_size]; variable-length ones are [total_tokens, nheads, head_size]
+// with sequence b starting at token start[b].
+template <typename T>
+struct AttnTensor {
+  T* ptr;
+  int64_t batch_stride;
+  int64_t token_stride;
+  int64_t head_stride;
+
+  inline T* row(int64_t b, int64_t token, int64_t h) const {
+    return ptr + b * batch_stride + token * token_stride + h * head_stride;
+  }
+};
+
+template <typename spec_t, typename T = spec_t>
+AttnTensor<T> MakeAttnTensor(const NDArray& arr, bool varlen) {
+  HT_ASSERT(arr->stride(-1) == 1)
+    << "Input tensor must have contiguous last dimension";
+  if (varlen)
+    return {arr->data_ptr<spec_t>(), 0, arr->stride(0), arr->stride(1)};
+  return {arr->data_ptr<spec_t>(), arr->stride(0), arr->stride(1),
+          arr->stride(2)};
+}
+
+struct AttnProblem {
+  int64_t batch_size;
+  int64_t num_heads;
+  int64_t num_heads_k;
+  int64_t head_size;
+  int64_t max_seqlen_q;
+  int64_t max_seqlen_k;
+  // Per-sequence token offsets and lengths.
+  std::vector<int64_t> q_start, q_len, k_start, k_len;
+  float softmax_scale;
+  bool is_causal;
+  float p_dropout;
+  uint64_t dropout_key;
+  // [batch_size, num_heads, max_seqlen_q]
+  float* softmax_lse;
+
+  inline int64_t group_size() const {
+    return num_heads / num_heads_k;
+  }
+
+  // Number of keys visible to query i of sequence b. The causal mask is
+  // aligned to the bottom-right corner when seqlen_q != seqlen_k.
+  inline int64_t num_keys(int64_t b, int64_t i) const {
+    if (!is_causal)
+      return k_len[b];
+    return MAX(MIN(i + k_len[b] - q_len[b] + 1, k_len[b]), int64_t(0));
+  }
+
+  inline float* lse(int64_t b, int64_t h) const {
+    return softmax_lse + (b * num_heads + h) * max_seqlen_q;
+  }
+
+  // Whether the attention probability (b, h, i, j) is kept by dropout.
+  inline bool keep(int64_t b, int64_t h, int64_t i, int64_t j) const {
+    uint64_t idx = ((b * num_heads + h) * max_seqlen_q + i) * max_seqlen_k + j;
+    return hetu::cpu::CounterUniform(dropout_key, idx) >= p_dropout;
+  }
+};
+
+inline int64_t ReadSeqlen(const NDArray& cu_seqlens, int64_t i) {
+  if (cu_seqlens->dtype() == kInt64)
+    return cu_seqlens->data_ptr<int64_t>()[i];
+  return cu_seqlens->data_ptr<int32_t>()[i];
+}
+
+// Must be called by the stream task since cu_seqlens may be produced by
+// previous tasks on the stream.
+AttnProblem MakeAttnProblem(const NDArray& q, const NDArray& k,
+                            const NDArray& cu_seqlens_q,
+                            const NDArray& cu_seqlens_k, int64_t max_seqlen_q,
+                            int64_t max_seqlen_k, NDArray& softmax_lse,
+                            float p_dropout, uint64_t seed,
+                            float softmax_scale, bool is_causal) {
+  AttnProblem prob;
+  bool varlen = cu_seqlens_q.is_defined();
+  prob.batch_size = varlen ? cu_seqlens_q->numel() - 1 : q->shape(0);
+  prob.num_heads = q->shape(-2);
+  prob.num_heads_k = k->shape(-2);
+  prob.head_size = q->shape(-1);
+  prob.max_seqlen_q = varlen ? max_seqlen_q : q->shape(1);
+  prob.max_seqlen_k = varlen ? max_seqlen_k : k->shape(1);
+  HT_ASSERT(prob.num_heads % prob.num_heads_k == 0)
+    << "Number of heads in key/value must divide number of heads in query";
+  HT_ASSERT(softmax_lse->dtype() == kFloat32)
+    << "softmax_lse must be float32, got " << softmax_lse->dtype();
+  for (int64_t b = 0; b < prob.batch_size; b++) {
+    if (varlen) {
+      prob.q_start.push_back(ReadSeqlen(cu_seqlens_q, b));
+      prob.q_len.push_back(ReadSeqlen(cu_seqlens_q, b + 1) -
+                           prob.q_start.back());
+      prob.k_start.push_back(ReadSeqlen(cu_seqlens_k, b));
+      prob.k_len.push_back(ReadSeqlen(cu_seqlens_k, b + 1) -
+                           prob.k_start.back());
+      HT_ASSERT(prob.q_len.back() <= prob.max_seqlen_q &&
+                prob.k_len.back() <= prob.max_seqlen_k)
+        << "Sequence " << b << " is longer than max_seqlen";
+    } else {
+      prob.q_start.push_back(0);
+      prob.q_len.push_back(prob.max_seqlen_q);
+      prob.k_start.push_back(0);
+      prob.k_len.push_back(prob.max_seqlen_k);
+    }
+  }
+  prob.softmax_scale = softmax_scale;
+  prob.is_causal = is_causal;
+  prob.p_dropout = p_dropout;
+  prob.dropout_key = hetu::cpu::SplitMix64(seed);
+  prob.softmax_lse = softmax_lse->data_ptr<float>();
+  return prob;
+}
+
+// Converts `num_rows` rows of head h starting from token `token` of
+// sequence b into a dense [num_rows, head_size] float tile.
+template <typename spec_t, typename acc_t>
+inline void LoadTile(const AttnTensor<const spec_t>& t, int64_t b,
+                     int64_t token, int64_t h, int64_t num_rows,
+                     int64_t head_size, acc_t scale, acc_t* tile) {
+  for (int64_t r = 0; r < num_rows; r++) {
+    const spec_t* src = t.row(b, token + r, h);
+    acc_t* dst = tile + r * head_size;
+#pragma omp simd
+    for (int64_t d = 0; d < head_size; d++)
+      dst[d] = static_cast<acc_t>(src[d]) * scale;
+  }
+}
+
+template <typename acc_t>
+inline acc_t Dot(const acc_t* a, const acc_t* b, int64_t n) {
+  acc_t ret = 0;
+#pragma omp simd reduction(+ : ret)
+  for (int64_t d = 0; d < n; d++)
+    ret += a[d] * b[d];
+  return ret;
+}
+
+template <typename acc_t>
+inline void Axpy(acc_t alpha, const acc_t* x, acc_t* y, int64_t n) {
+#pragma omp simd
+  for (int64_t d = 0; d < n; d++)
+    y[d] += alpha * x[d];
+}
+
+template <typename spec_t>
+void flash_attn_cpu(const AttnTensor<const spec_t>& q,
+                    const AttnTensor<const spec_t>& k,
+                    const AttnTensor<const spec_t>& v,
+                    const AttnTensor<spec_t>& out, const AttnProblem& prob) {
+  using acc_t = hetu::cpu::acc_type<spec_t>;
+  const int64_t dim = prob.head_size;
+  const int64_t num_m_blocks = DIVUP(prob.max_seqlen_q, kAttnBlockM);
+  const int64_t num_tasks = prob.batch_size * prob.num_heads * num_m_blocks;
+  const acc_t rp_dropout = acc_t(1) / (1 - prob.p_dropout);
+  const acc_t neg_inf = -std::numeric_limits<acc_t>::infinity();
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    std::vector<acc_t> q_tile(kAttnBlockM * dim), k_tile(kAttnBlockN * dim),
+      v_tile(kAttnBlockN * dim), acc(kAttnBlockM * dim),
+      scores(kAttnBlockM * kAttnBlockN), row_max(kAttnBlockM),
+      row_sum(kAttnBlockM);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (int64_t task = 0; task < num_tasks; task++) {
+      int64_t m_block = task % num_m_blocks;
+      int64_t h = (task / num_m_blocks) % prob.num_heads;
+      int64_t b = task / (num_m_blocks * prob.num_heads);
+      int64_t m_begin = m_block * kAttnBlockM;
+      if (m_begin >= prob.q_len[b])
+        continue;
+      int64_t rows = MIN(kAttnBlockM, prob.q_len[b] - m_begin);
+      int64_t hk = h / prob.group_size();
+      LoadTile(q, b, prob.q_start[b] + m_begin, h, rows, dim,
+               static_cast<acc_t>(prob.softmax_scale), q_tile.data());
+      std::fill(acc.begin(), acc.end(), acc_t(0));
+      std::fill(row_max.begin(), row_max.end(), neg_inf);
+      std::fill(row_sum.begin(), row_sum.end(), acc_t(0));
+      // Keys visible to the last row are a superset of the others'.
+      int64_t n_end = prob.num_keys(b, m_begin + rows - 1);
+      for (int64_t n_begin = 0; n_begin < n_end; n_begin += kAttnBlockN) {
+        int64_t cols = MIN(kAttnBlockN, n_end - n_begin);
+        LoadTile(k, b, prob.k_start[b] + n_begin, hk, cols, dim, acc_t(1),
+                 k_tile.data());
+        LoadTile(v, b, prob.k_start[b] + n_begin, hk, cols, dim, acc_t(1),
+                 v_tile.data());
+        for (int64_t i = 0; i < rows; i++) {
+          int64_t visible =
+            MIN(prob.num_keys(b, m_begin + i) - n_begin, cols);
+          if (visible <= 0)
+            continue;
+          const acc_t* q_i = q_tile.data() + i * dim;
+          acc_t* acc_i = acc.data() + i * dim;
+          acc_t* s_i = scores.data() + i * kAttnBlockN;
+          acc_t m_new = row_max[i];
+          for (int64_t j = 0; j < visible; j++) {
+            s_i[j] = Dot(q_i, k_tile.data() + j * dim, dim);
+            m_new = MAX(m_new, s_i[j]);
+          }
+          acc_t correction = std::exp(row_max[i] - m_new);
+          row_sum[i] *= correction;
+#pragma omp simd
+          for (int64_t d = 0; d < dim; d++)
+            acc_i[d] *= correction;
+          for (int64_t j = 0; j < visible; j++) {
+            acc_t p = std::exp(s_i[j] - m_new);
+            // The normalizer excludes dropout as in FlashAttention.
+            row_sum[i] += p;
+            if (prob.p_dropout > 0)
+              p = prob.keep(b, h, m_begin + i, n_begin + j) ? p * rp_dropout
+                                                             : acc_t(0);
+            Axpy(p, v_tile.data() + j * dim, acc_i, dim);
+          }
+          row_max[i] = m_new;
+        }
+      }
+      float* lse = prob.lse(b, h);
+      for (int64_t i = 0; i < rows; i++) {
+        spec_t* o_i = out.row(b, prob.q_start[b] + m_begin + i, h);
+        const acc_t* acc_i = acc.data() + i * dim;
+        // Rows without any visible key produce zeros.
+        acc_t inv_sum = row_sum[i] > 0 ? acc_t(1) / row_sum[i] : acc_t(0);
+        for (int64_t d = 0; d < dim; d++)
+          o_i[d] = static_cast<spec_t>(acc_i[d] * inv_sum);
+        lse[m_begin + i] = row_sum[i] > 0
+          ? static_cast<float>(row_max[i] + std::log(row_sum[i]))
+          : std::numeric_limits<float>::infinity();
+      }
+    }
+  }
+}
+
+// The backward pass recomputes the probabilities from softmax_lse tile by
+// tile. It runs in two passes so that no output is accumulated by more
+// than one thread: dq over query tiles, then dk and dv over key tiles.
+template <typename spec_t>
+void flash_attn_gradient_cpu(const AttnTensor<const spec_t>& dout,
+                             const AttnTensor<const spec_t>& q,
+                             const AttnTensor<const spec_t>& k,
+                             const AttnTensor<const spec_t>& v,
+                             const AttnTensor<const spec_t>& out,
+                             const AttnTensor<spec_t>& dq,
+                             const AttnTensor<spec_t>& dk,
+                             const AttnTensor<spec_t>& dv,
+                             const AttnProblem& prob) {
+  using acc_t = hetu::cpu::acc_type<spec_t>;
+  const int64_t dim = prob.head_size;
+  const acc_t scale = static_cast<acc_t>(prob.softmax_scale);
+  const acc_t rp_dropout = acc_t(1) / (1 - prob.p_dropout);
+  const int64_t num_m_blocks = DIVUP(prob.max_seqlen_q, kAttnBlockM);
+  const int64_t num_n_blocks = DIVUP(prob.max_seqlen_k, kAttnBlockN);
+  // delta_i = dout_i . out_i, i.e., rowsum(dP * P).
+  std::vector<acc_t> delta(prob.batch_size * prob.num_heads *
+                           prob.max_seqlen_q);
+  auto delta_of = [&](int64_t b, int64_t h) {
+    return delta.data() + (b * prob.num_heads + h) * prob.max_seqlen_q;
+  };
+  auto probability = [&](int64_t b, int64_t h, int64_t i, int64_t j, acc_t s,
+                         acc_t lse, acc_t dp, acc_t& p_dropped,
+                         acc_t& ds) {
+    acc_t p = std::exp(s - lse);
+    p_dropped = p;
+    if (prob.p_dropout > 0) {
+      bool keep = prob.keep(b, h, i, j);
+      p_dropped = keep ? p * rp_dropout : acc_t(0);
+      dp = keep ? dp * rp_dropout : acc_t(0);
+    }
+    ds = p * (dp - delta_of(b, h)[i]);
+  };
+
+  const int64_t num_q_tasks = prob.batch_size * prob.num_heads * num_m_blocks;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    std::vector<acc_t> q_tile(kAttnBlockM * dim), do_tile(kAttnBlockM * dim),
+      dq_acc(kAttnBlockM * dim), k_tile(kAttnBlockN * dim),
+      v_tile(kAttnBlockN * dim);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (int64_t task = 0; task < num_q_tasks; task++) {
+      int64_t m_block = task % num_m_blocks;
+      int64_t h = (task / num_m_blocks) % prob.num_heads;
+      int64_t b = task / (num_m_blocks * prob.num_heads);
+      int64_t m_begin = m_block * kAttnBlockM;
+      if (m_begin >= prob.q_len[b])
+        continue;
+      int64_t rows = MIN(kAttnBlockM, prob.q_len[b] - m_begin);
+      int64_t hk = h / prob.group_size();
+      int64_t token = prob.q_start[b] + m_begin;
+      LoadTile(q, b, token, h, rows, dim, acc_t(1), q_tile.data());
+      LoadTile(dout, b, token, h, rows, dim, acc_t(1), do_tile.data());
+      for (int64_t i = 0; i < rows; i++) {
+        const spec_t* o_i = out.row(b, token + i, h);
+        const acc_t* do_i = do_tile.data() + i * dim;
+        acc_t sum = 0;
+        for (int64_t d = 0; d < dim; d++)
+          sum += do_i[d] * static_cast<acc_t>(o_i[d]);
+        delta_of(b, h)[m_begin + i] = sum;
+      }
+      std::fill(dq_acc.begin(), dq_acc.end(), acc_t(0));
+      const float* lse = prob.lse(b, h);
+      int64_t n_end = prob.num_keys(b, m_begin + rows - 1);
+      for (int64_t n_begin = 0; n_begin < n_end; n_begin += kAttnBlockN) {
+        int64_t cols = MIN(kAttnBlockN, n_end - n_begin);
+        LoadTile(k, b, prob.k_start[b] + n_begin, hk, cols, dim, acc_t(1),
+                 k_tile.data());
+        LoadTile(v, b, prob.k_start[b] + n_begin, hk, cols, dim, acc_t(1),
+                 v_tile.data());
+        for (int64_t i = 0; i < rows; i++) {
+          int64_t visible =
+            MIN(prob.num_keys(b, m_begin + i) - n_begin, cols);
+          const acc_t* q_i = q_tile.data() + i * dim;
+          const acc_t* do_i = do_tile.data() + i * dim;
+          acc_t* dq_i = dq_acc.data() + i * dim;
+          for (int64_t j = 0; j < visible; j++) {
+            acc_t s = scale * Dot(q_i, k_tile.data() + j * dim, dim);
+            acc_t dp = Dot(do_i, v_tile.data() + j * dim, dim);
+            acc_t p_dropped, ds;
+            probability(b, h, m_begin + i, n_begin + j, s,
+                        lse[m_begin + i], dp, p_dropped, ds);
+            Axpy(ds, k_tile.data() + j * dim, dq_i, dim);
+          }
+        }
+      }
+      for (int64_t i = 0; i < rows; i++) {
+        spec_t* dq_i = dq.row(b, token + i, h);
+        for (int64_t d = 0; d < dim; d++)
+          dq_i[d] = static_cast<spec_t>(dq_acc[i * dim + d] * scale);
+      }
+    }
+  }
+
+  // Query heads sharing a key/value head are handled by the same task.
+  const int64_t num_kv_tasks =
+    prob.batch_size * prob.num_heads_k * num_n_blocks;
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    std::vector<acc_t> q_tile(kAttnBlockM * dim), do_tile(kAttnBlockM * dim),
+      k_tile(kAttnBlockN * dim), v_tile(kAttnBlockN * dim),
+      dk_acc(kAttnBlockN * dim), dv_acc(kAttnBlockN * dim);
+#ifdef _OPENMP
+#pragma omp for schedule(dynamic)
+#endif
+    for (int64_t task = 0; task < num_kv_tasks; task++) {
+      int64_t n_block = task % num_n_blocks;
+      int64_t hk = (task / num_n_blocks) % prob.num_heads_k;
+      int64_t b = task / (num_n_blocks * prob.num_heads_k);
+      int64_t n_begin = n_block * kAttnBlockN;
+      if (n_begin >= prob.k_len[b])
+        continue;
+      int64_t cols = MIN(kAttnBlockN, prob.k_len[b] - n_begin);
+      int64_t token = prob.k_start[b] + n_begin;
+      LoadTile(k, b, token, hk, cols, dim, acc_t(1), k_tile.data());
+      LoadTile(v, b, token, hk, cols, dim, acc_t(1), v_tile.data());
+      std::fill(dk_acc.begin(), dk_acc.end(), acc_t(0));
+      std::fill(dv_acc.begin(), dv_acc.end(), acc_t(0));
+      // The first query that sees key n_begin.
+      int64_t m_first = prob.is_causal
+        ? MAX(n_begin - (prob.k_len[b] - prob.q_len[b]), int64_t(0))
+        : int64_t(0);
+      for (int64_t g = 0; g < prob.group_size(); g++) {
+        int64_t h = hk * prob.group_size() + g;
+        const float* lse = prob.lse(b, h);
+        for (int64_t m_begin = m_first / kAttnBlockM * kAttnBlockM;
+             m_begin < prob.q_len[b]; m_begin += kAttnBlockM) {
+          int64_t rows = MIN(kAttnBlockM, prob.q_len[b] - m_begin);
+          LoadTile(q, b, prob.q_start[b] + m_begin, h, rows, dim, acc_t(1),
+                   q_tile.data());
+          LoadTile(dout, b, prob.q_start[b] + m_begin, h, rows, dim, acc_t(1),
+                   do_tile.data());
+          for (int64_t i = 0; i < rows; i++) {
+            int64_t visible =
+              MIN(prob.num_keys(b, m_begin + i) - n_begin, cols);
+            const acc_t* q_i = q_tile.data() + i * dim;
+            const acc_t* do_i = do_tile.data() + i * dim;
+            for (int64_t j = 0; j < visible; j++) {
+              acc_t s = scale * Dot(q_i, k_tile.data() + j * dim, dim);
+              acc_t dp = Dot(do_i, v_tile.data() + j * dim, dim);
+              acc_t p_dropped, ds;
+              probability(b, h, m_begin + i, n_begin + j, s,
+                          lse[m_begin + i], dp, p_dropped, ds);
+              Axpy(p_dropped, do_i, dv_acc.data() + j * dim, dim);
+              Axpy(ds, q_i, dk_acc.data() + j * dim, dim);
+            }
+          }
+        }
+      }
+      for (int64_t j = 0; j < cols; j++) {
+        spec_t* dk_j = dk.row(b, token + j, hk);
+        spec_t* dv_j = dv.row(b, token + j, hk);
+        for (int64_t d = 0; d < dim; d++) {
+          dk_j[d] = static_cast<spec_t>(dk_acc[j * dim + d] * scale);
+          dv_j[d] = static_cast<spec_t>(dv_acc[j * dim + d]);
+        }
+      }
+    }
+  }
+}
+
+void PadForFlashAttn(const NDArray& arr, NDArray& padded, int64_t head_size,
+                     const Stream& stream) {
+  if (head_size % 8 != 0) {
+    HTShape pad_shape = {0, 8 - head_size % 8};
+    NDArray::pad(arr, pad_shape, "constant", 0, stream.stream_index(), padded);
+  } else {
+    padded = arr;
+  }
+}
+
+void LaunchFlashAttnCpu(const NDArray& q, const NDArray& k, const NDArray& v,
+                        const NDArray& cu_seqlens_q,
+                        const NDArray& cu_seqlens_k, NDArray& out,
+                        NDArray& softmax_lse, NDArray& rng_state,
+                        int64_t max_seqlen_q, int64_t max_seqlen_k,
+                        float p_dropout, float softmax_scale,
+                        bool zero_tensors, bool is_causal,
+                        bool return_softmax, const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(q);
+  HT_ASSERT_SAME_DEVICE(q, k);
+  HT_ASSERT_SAME_DEVICE(q, v);
+  HT_ASSERT_SAME_DEVICE(q, out);
+  HT_ASSERT_SAME_DEVICE(q, softmax_lse);
+  HT_ASSERT(k->dtype() == q->dtype() && v->dtype() == q->dtype() &&
+            out->dtype() == q->dtype())
+    << "query, key, value and out must have the same dtype";
+  HT_ASSERT(!return_softmax)
+    << "Returning the attention probabilities is not supported on CPU";
+  if (q->numel() == 0)
+    return;
+  uint64_t seed = p_dropout > 0 ? GenNextRandomSeed() : 0;
+  bool varlen = cu_seqlens_q.is_defined();
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(q->dtype(), spec_t, "FlashAttnCpu", [&]() {
+    auto _future = cpu_stream.EnqueueTask(
+      [q, k, v, cu_seqlens_q, cu_seqlens_k, out, softmax_lse, rng_state,
+       max_seqlen_q, max_seqlen_k, p_dropout, softmax_scale, zero_tensors,
+       is_causal, seed, varlen]() mutable {
+        if (zero_tensors) {
+          std::fill_n(out->data_ptr<spec_t>(), out->numel(), spec_t(0));
+          std::fill_n(softmax_lse->data_ptr<float>(), softmax_lse->numel(),
+                      -std::numeric_limits<float>::infinity());
+        }
+        if (rng_state.is_defined() && rng_state->numel() >= 2) {
+          rng_state->data_ptr<int64_t>()[0] = static_cast<int64_t>(seed);
+          rng_state->data_ptr<int64_t>()[1] = 0;
+        }
+        auto prob = MakeAttnProblem(q, k, cu_seqlens_q, cu_seqlens_k,
+                                    max_seqlen_q, max_seqlen_k, softmax_lse,
+                                    p_dropout, seed, softmax_scale, is_causal);
+        flash_attn_cpu<spec_t>(
+          MakeAttnTensor<spec_t, const spec_t>(q, varlen),
+          MakeAttnTensor<spec_t, const spec_t>(k, varlen),
+          MakeAttnTensor<spec_t, const spec_t>(v, varlen),
+          MakeAttnTensor<spec_t>(out, varlen), prob);
+      },
+      "FlashAttn");
+  });
+  NDArray::MarkUsedBy({q, k, v, cu_seqlens_q, cu_seqlens_k, out, softmax_lse,
+                       rng_state},
+                      stream);
+}
+
+void LaunchFlashAttnGradientCpu(
+  const NDArray& dout, const NDArray& q, const NDArray& k, const NDArray& v,
+  const NDArray& cu_seqlens_q, const NDArray& cu_seqlens_k, const NDArray& out,
+  NDArray& softmax_lse, const NDArray& rng_state, NDArray& dq, NDArray& dk,
+  NDArray& dv, int64_t max_seqlen_q, int64_t max_seqlen_k, float p_dropout,
+  float softmax_scale, bool zero_tensors, bool is_causal,
+  const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(q);
+  HT_ASSERT_SAME_DEVICE(q, dout);
+  HT_ASSERT_SAME_DEVICE(q, k);
+  HT_ASSERT_SAME_DEVICE(q, v);
+  HT_ASSERT_SAME_DEVICE(q, out);
+  HT_ASSERT_SAME_DEVICE(q, dq);
+  HT_ASSERT_SAME_DEVICE(q, dk);
+  HT_ASSERT_SAME_DEVICE(q, dv);
+  HT_ASSERT(k->dtype() == q->dtype() && v->dtype() == q->dtype() &&
+            out->dtype() == q->dtype() && dout->dtype() == q->dtype())
+    << "query, key, value, out and dout must have the same dtype";
+  if (q->numel() == 0)
+    return;
+  bool varlen = cu_seqlens_q.is_defined();
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(q->dtype(), spec_t, "FlashAttnGradientCpu", [&]() {
+    auto _future = cpu_stream.EnqueueTask(
+      [dout, q, k, v, cu_seqlens_q, cu_seqlens_k, out, softmax_lse, rng_state,
+       dq, dk, dv, max_seqlen_q, max_seqlen_k, p_dropout, softmax_scale,
+       zero_tensors, is_causal, varlen]() mutable {
+        if (zero_tensors) {
+          for (auto* grad : {&dq, &dk, &dv})
+            std::fill_n((*grad)->data_ptr<spec_t>(), (*grad)->numel(),
+                        spec_t(0));
+        }
+        uint64_t seed = p_dropout > 0
+          ? static_cast<uint64_t>(rng_state->data_ptr<int64_t>()[0])
+          : 0;
+        auto prob = MakeAttnProblem(q, k, cu_seqlens_q, cu_seqlens_k,
+                                    max_seqlen_q, max_seqlen_k, softmax_lse,
+                                    p_dropout, seed, softmax_scale, is_causal);
+        flash_attn_gradient_cpu<spec_t>(
+          MakeAttnTensor<spec_t, const spec_t>(dout, varlen),
+          MakeAttnTensor<spec_t, const spec_t>(q, varlen),
+          MakeAttnTensor<spec_t, const spec_t>(k, varlen),
+          MakeAttnTensor<spec_t, const spec_t>(v, varlen),
+          MakeAttnTensor<spec_t, const spec_t>(out, varlen),
+          MakeAttnTensor<spec_t>(dq, varlen), MakeAttnTensor<spec_t>(dk, varlen),
+          MakeAttnTensor<spec_t>(dv, varlen), prob);
+      },
+      "FlashAttnGradient");
+  });
+  NDArray::MarkUsedBy({dout, q, k, v, cu_seqlens_q, cu_seqlens_k, out,
+                       softmax_lse, rng_state, dq, dk, dv},
+                      stream);
+}
+
+} // namespace
+
+void FlashAttnCpu(
+  const NDArray& q, // batch_size x seqlen_q x num_heads x head_size
+  const NDArray& k, // batch_size x seqlen_k x num_heads_k x head_size
+  const NDArray& v, // batch_size x seqlen_k x num_heads_k x head_size
+  NDArray& out_, // batch_size x seqlen_q x num_heads x head_size
+  NDArray& q_padded, // batch_size x seqlen_q x num_heads x head_size_rounded
+  NDArray& k_padded, // batch_size x seqlen_k x num_heads_k x head_size_rounded
+  NDArray& v_padded, // batch_size x seqlen_k x num_heads_k x head_size_rounded
+  NDArray& out_padded, // batch_size x seqlen_q x num_heads x head_size_rounded
+  NDArray& softmax_lse, // batch_size × num_heads × seqlen_q
+  NDArray& p, // unused on CPU
+  NDArray& rng_state, // 2  kCPU  kInt64
+  const float p_dropout, const float softmax_scale, const bool is_causal,
+  const bool return_softmax, const Stream& stream) {
+  int64_t head_size = q->shape(3);
+  PadForFlashAttn(q, q_padded, head_size, stream);
+  PadForFlashAttn(k, k_padded, head_size, stream);
+  PadForFlashAttn(v, v_padded, head_size, stream);
+  LaunchFlashAttnCpu(q, k, v, NDArray(), NDArray(), out_, softmax_lse,
+                     rng_state, q->shape(1), k->shape(1), p_dropout,
+                     softmax_scale, false, is_causal, return_softmax, stream);
+  PadForFlashAttn(out_, out_padded, head_size, stream);
+}
+
+void FlashAttnVarlenCpu(
+  const NDArray& q, // total_q x num_heads x head_size
+  const NDArray& k, // total_k x num_heads_k x head_size
+  const NDArray& v, // total_k x num_heads_k x head_size
+  const NDArray& cu_seqlens_q, // b+1
+  const NDArray& cu_seqlens_k, // b+1
+  NDArray& out_, // total_q x num_heads x head_size
+  NDArray& q_padded, NDArray& k_padded, NDArray& v_padded,
+  NDArray& out_padded,
+  NDArray& softmax_lse, // batch_size × num_heads × max_seqlen_q
+  NDArray& p, // unused on CPU
+  NDArray& rng_state, // 2  kCPU  kInt64
+  const int max_seqlen_q, const int max_seqlen_k, const float p_dropout,
+  const float softmax_scale, const bool zero_tensors, const bool is_causal,
+  const bool return_softmax, const Stream& stream) {
+  int64_t head_size = q->shape(2);
+  PadForFlashAttn(q, q_padded, head_size, stream);
+  PadForFlashAttn(k, k_padded, head_size, stream);
+  PadForFlashAttn(v, v_padded, head_size, stream);
+  LaunchFlashAttnCpu(q, k, v, cu_seqlens_q, cu_seqlens_k, out_, softmax_lse,
+                     rng_state, max_seqlen_q, max_seqlen_k, p_dropout,
+                     softmax_scale, zero_tensors, is_causal, return_softmax,
+                     stream);
+  PadForFlashAttn(out_, out_padded, head_size, stream);
+}
+
+void FlashAttnGradientCpu(
+  const NDArray& dout, // batch_size x seqlen_q x num_heads, x head_size_og
+  const NDArray& q, // batch_size x seqlen_q x num_heads x head_size
+  const NDArray& k, // batch_size x seqlen_k x num_heads_k x head_size
+  const NDArray& v, // batch_size x seqlen_k x num_heads_k x head_size
+  NDArray& out, // batch_size x seqlen_q x num_heads x head_size
+  NDArray& softmax_lse, // b x h x seqlen_q
+  NDArray& rng_state,
+  NDArray& dq_, // batch_size x seqlen_q x num_heads x head_size
+  NDArray& dk_, // batch_size x seqlen_k x num_heads_k x head_size
+  NDArray& dv_, // batch_size x seqlen_k x num_heads_k x head_size
+  const float p_dropout, // probability to drop
+  const float softmax_scale, const bool is_causal, const Stream& stream) {
+  LaunchFlashAttnGradientCpu(dout, q, k, v, NDArray(), NDArray(), out,
+                             softmax_lse, rng_state, dq_, dk_, dv_,
+                             q->shape(1), k->shape(1), p_dropout,
+                             softmax_scale, false, is_causal, stream);
+}
+
+void FlashAttnVarlenGradientCpu(
+  const NDArray& dout, // total_q x num_heads x head_size
+  const NDArray& q, // total_q x num_heads x head_size
+  const NDArray& k, // total_k x num_heads_k x head_size
+  const NDArray& v, // total_k x num_heads_k x head_size
+  const NDArray& cu_seqlens_q, // b+1
+  const NDArray& cu_seqlens_k, // b+1
+  NDArray& out, // total_q x num_heads x head_size
+  NDArray& softmax_lse, // b x h x max_seqlen_q
+  NDArray& rng_state,
+  NDArray& dq_, // total_q x num_heads x head_size
+  NDArray& dk_, // total_k x num_heads_k x head_size
+  NDArray& dv_, // total_k x num_heads_k x head_size
+  const int max_seqlen_q, const int max_seqlen_k, const float p_dropout,
+  const float softmax_scale, const bool zero_tensors, const bool is_causal,
+  const Stream& stream) {
+  LaunchFlashAttnGradientCpu(dout, q, k, v, cu_seqlens_q, cu_seqlens_k, out,
+                             softmax_lse, rng_state, dq_, dk_, dv_,
+                             max_seqlen_q, max_seqlen_k, p_dropout,
+                             softmax_scale, zero_tensors, is_causal, stream);
+}
+
+} // namespace impl
+} // namespace hetu
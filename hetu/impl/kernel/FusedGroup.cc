@@ -0,0 +1,456 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/core/fused_program.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/impl/utils/common_utils.h"
+#include "hetu/impl/utils/cpu_math.h"
+#include "hetu/impl/utils/omp_utils.h"
+#include <array>
+#include <cmath>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+namespace hetu {
+namespace impl {
+
+namespace {
+
+// Elements of the inner dimension evaluated together. The registers of a
+// block stay in L1, so intermediate values never go to memory.
+constexpr int64_t kFusedBlockSize = 256;
+
+// Evaluates one operation on one element. `Code` is a template argument so
+// that every loop below is compiled for a single operation.
+template <FusedOpCode Code, typename acc_t>
+inline acc_t FusedApply(acc_t a, acc_t b, acc_t value, uint64_t key,
+                        int64_t idx, bool& keep) {
+  if constexpr (Code == FusedOpCode::ADD) {
+    return a + b;
+  } else if constexpr (Code == FusedOpCode::SUB) {
+    return a - b;
+  } else if constexpr (Code == FusedOpCode::MUL) {
+    return a * b;
+  } else if constexpr (Code == FusedOpCode::DIV) {
+    return a / b;
+  } else if constexpr (Code == FusedOpCode::ADD_CONST) {
+    return a + value;
+  } else if constexpr (Code == FusedOpCode::SUB_CONST) {
+    return a - value;
+  } else if constexpr (Code == FusedOpCode::SUB_FROM_CONST) {
+    return value - a;
+  } else if constexpr (Code == FusedOpCode::MUL_CONST) {
+    return a * value;
+  } else if constexpr (Code == FusedOpCode::DIV_CONST) {
+    return a / value;
+  } else if constexpr (Code == FusedOpCode::DIV_FROM_CONST) {
+    return value / a;
+  } else if constexpr (Code == FusedOpCode::POW_CONST) {
+    return std::pow(a, value);
+  } else if constexpr (Code == FusedOpCode::NEGATE) {
+    return -a;
+  } else if constexpr (Code == FusedOpCode::RECIPROCAL) {
+    return acc_t(1) / a;
+  } else if constexpr (Code == FusedOpCode::EXP) {
+    return std::exp(a);
+  } else if constexpr (Code == FusedOpCode::LOG) {
+    return std::log(a);
+  } else if constexpr (Code == FusedOpCode::SQRT) {
+    return std::sqrt(a);
+  } else if constexpr (Code == FusedOpCode::RSQRT) {
+    return acc_t(1) / std::sqrt(a);
+  } else if constexpr (Code == FusedOpCode::ABS) {
+    return std::abs(a);
+  } else if constexpr (Code == FusedOpCode::RELU) {
+    return a < acc_t(0) ? acc_t(0) : a;
+  } else if constexpr (Code == FusedOpCode::SIGMOID) {
+    return acc_t(1) / (acc_t(1) + std::exp(-a));
+  } else if constexpr (Code == FusedOpCode::TANH) {
+    return std::tanh(a);
+  } else if constexpr (Code == FusedOpCode::GELU) {
+    return a * acc_t(0.5) *
+      (acc_t(1) + std::erf(a * acc_t(0.70710678118654757274)));
+  } else if constexpr (Code == FusedOpCode::DROPOUT) {
+    // Same numbers as DropoutCpu, with `value` being the drop rate.
+    const float drop_rate = static_cast<float>(value);
+    keep = hetu::cpu::CounterUniform(key, idx) >= drop_rate;
+    return keep ? a * static_cast<acc_t>(1.0f / (1 - drop_rate)) : acc_t(0);
+  } else {
+    static_assert(Code != Code, "Unknown fused op code");
+  }
+}
+
+#define HT_FUSED_OP_CODE_CASES(MACRO)                                          \
+  MACRO(ADD) MACRO(SUB) MACRO(MUL) MACRO(DIV) MACRO(ADD_CONST)                 \
+  MACRO(SUB_CONST) MACRO(SUB_FROM_CONST) MACRO(MUL_CONST) MACRO(DIV_CONST)     \
+  MACRO(DIV_FROM_CONST) MACRO(POW_CONST) MACRO(NEGATE) MACRO(RECIPROCAL)       \
+  MACRO(EXP) MACRO(LOG) MACRO(SQRT) MACRO(RSQRT) MACRO(ABS) MACRO(RELU)        \
+  MACRO(SIGMOID) MACRO(TANH) MACRO(GELU) MACRO(DROPOUT)
+
+// Arguments shared by all blocks. After dropping size-1 dimensions and
+// merging the ones that are contiguous in all inputs, the output is viewed
+// as rows of `shape[ndim - 1]` elements.
+template <typename spec_t>
+struct FusedGroupArgs {
+  const FusedProgram* program;
+  int ndim;
+  int64_t shape[HT_MAX_NDIM];
+  std::vector<const spec_t*> inputs;
+  std::vector<std::array<int64_t, HT_MAX_NDIM>> in_strides;
+  std::vector<void*> outputs;
+  // SplitMix64 of the seed of each dropout instruction
+  std::vector<uint64_t> keys;
+
+  int64_t inner() const {
+    return shape[ndim - 1];
+  }
+
+  // Offset of the first element of `row` in input `i`.
+  int64_t RowOffset(size_t i, int64_t row) const {
+    int64_t offset = 0;
+    for (int d = ndim - 2; d >= 0; d--) {
+      offset += (row % shape[d]) * in_strides[i][d];
+      row /= shape[d];
+    }
+    return offset;
+  }
+};
+
+template <FusedOpCode Code, typename acc_t>
+void RunFusedInstr(acc_t* out, const acc_t* lhs, const acc_t* rhs,
+                   acc_t value, uint64_t key, int64_t base, int64_t len,
+                   bool* mask) {
+  for (int64_t j = 0; j < len; j++) {
+    bool keep = true;
+    out[j] = FusedApply<Code, acc_t>(
+      lhs[j], IsBinaryFusedOp(Code) ? rhs[j] : acc_t(0), value, key, base + j,
+      keep);
+    if constexpr (Code == FusedOpCode::DROPOUT)
+      mask[j] = keep;
+  }
+}
+
+// Returns `len` elements of input `i` from `begin` of `row` in the
+// accumulation type, converting (or gathering) into `buf` if needed.
+template <typename spec_t, typename acc_t>
+const acc_t* LoadFusedBlock(const FusedGroupArgs<spec_t>& args, int32_t i,
+                            int64_t row, int64_t begin, int64_t len,
+                            acc_t* buf) {
+  int64_t stride = args.in_strides[i][args.ndim - 1];
+  const spec_t* input =
+    args.inputs[i] + args.RowOffset(i, row) + begin * stride;
+  if (stride == 1) {
+    if constexpr (std::is_same<spec_t, acc_t>::value)
+      return input;
+    for (int64_t j = 0; j < len; j++)
+      buf[j] = static_cast<acc_t>(input[j]);
+  } else if (stride == 0) {
+    std::fill(buf, buf + len, static_cast<acc_t>(input[0]));
+  } else {
+    for (int64_t j = 0; j < len; j++)
+      buf[j] = static_cast<acc_t>(input[j * stride]);
+  }
+  return buf;
+}
+
+template <typename spec_t, typename acc_t>
+void StoreFusedBlock(const FusedGroupArgs<spec_t>& args, int32_t reg,
+                     int64_t base, int64_t len, const acc_t* value,
+                     const bool* mask) {
+  const auto& outputs = args.program->outputs;
+  for (size_t o = 0; o < outputs.size(); o++) {
+    if (outputs[o].reg != reg)
+      continue;
+    if (outputs[o].mask) {
+      std::copy(mask, mask + len,
+                reinterpret_cast<bool*>(args.outputs[o]) + base);
+    } else {
+      spec_t* dst = reinterpret_cast<spec_t*>(args.outputs[o]) + base;
+      for (int64_t j = 0; j < len; j++)
+        dst[j] = static_cast<spec_t>(value[j]);
+    }
+  }
+}
+
+// A linear chain whose k-th operation reads the (k-1)-th result and, if
+// binary, one input. The sequence of operations is known at compile time,
+// so the block is evaluated in place without decoding any instruction.
+template <typename spec_t, typename acc_t, FusedOpCode... Codes>
+struct FusedChain {
+  static void RunBlock(const FusedGroupArgs<spec_t>& args, int64_t row,
+                       int64_t begin, int64_t len) {
+    acc_t value[kFusedBlockSize], rhs[kFusedBlockSize];
+    bool mask[kFusedBlockSize];
+    const acc_t* lhs = LoadFusedBlock(args, args.program->instrs[0].lhs, row,
+                                      begin, len, value);
+    Run(std::make_index_sequence<sizeof...(Codes)>(), args, row, begin, len,
+        lhs, value, rhs, mask);
+  }
+
+ private:
+  template <size_t... Ks>
+  static void Run(std::index_sequence<Ks...>,
+                  const FusedGroupArgs<spec_t>& args, int64_t row,
+                  int64_t begin, int64_t len, const acc_t* lhs, acc_t* value,
+                  acc_t* rhs, bool* mask) {
+    (Step<Codes, Ks>(args, row, begin, len, Ks == 0 ? lhs : value, value,
+                     rhs, mask),
+     ...);
+  }
+
+  template <FusedOpCode Code, size_t K>
+  static void Step(const FusedGroupArgs<spec_t>& args, int64_t row,
+                   int64_t begin, int64_t len, const acc_t* lhs, acc_t* value,
+                   acc_t* rhs, bool* mask) {
+    const auto& instr = args.program->instrs[K];
+    const acc_t* rhs_ = IsBinaryFusedOp(Code)
+      ? LoadFusedBlock(args, instr.rhs, row, begin, len, rhs)
+      : nullptr;
+    int64_t base = row * args.inner() + begin;
+    RunFusedInstr<Code, acc_t>(value, lhs, rhs_,
+                               static_cast<acc_t>(instr.value), args.keys[K],
+                               base, len, mask);
+    StoreFusedBlock(args, args.program->num_inputs + K, base, len, value,
+                    mask);
+  }
+};
+
+template <typename spec_t>
+using FusedChainFn = void (*)(const FusedGroupArgs<spec_t>&, int64_t, int64_t,
+                              int64_t);
+
+// The sequences specialized at compile time, mostly from transformer blocks.
+// Any other program goes through the block interpreter.
+template <typename spec_t>
+const std::vector<std::pair<std::vector<FusedOpCode>, FusedChainFn<spec_t>>>&
+SpecializedFusedChains() {
+  using acc_t = hetu::cpu::acc_type<spec_t>;
+  using C = FusedOpCode;
+  static const std::vector<
+    std::pair<std::vector<FusedOpCode>, FusedChainFn<spec_t>>>
+    chains = {
+      // bias + activation
+      {{C::ADD, C::GELU}, FusedChain<spec_t, acc_t, C::ADD, C::GELU>::RunBlock},
+      {{C::ADD, C::RELU}, FusedChain<spec_t, acc_t, C::ADD, C::RELU>::RunBlock},
+      // bias + activation + dropout
+      {{C::ADD, C::GELU, C::DROPOUT},
+       FusedChain<spec_t, acc_t, C::ADD, C::GELU, C::DROPOUT>::RunBlock},
+      // scale + bias + activation + dropout
+      {{C::MUL, C::ADD, C::GELU, C::DROPOUT},
+       FusedChain<spec_t, acc_t, C::MUL, C::ADD, C::GELU,
+                  C::DROPOUT>::RunBlock},
+      // bias + dropout (+ residual)
+      {{C::ADD, C::DROPOUT},
+       FusedChain<spec_t, acc_t, C::ADD, C::DROPOUT>::RunBlock},
+      {{C::ADD, C::DROPOUT, C::ADD},
+       FusedChain<spec_t, acc_t, C::ADD, C::DROPOUT, C::ADD>::RunBlock},
+      // dropout + residual
+      {{C::DROPOUT, C::ADD},
+       FusedChain<spec_t, acc_t, C::DROPOUT, C::ADD>::RunBlock},
+      // scale + shift, e.g., attention scores with a mask
+      {{C::MUL, C::ADD}, FusedChain<spec_t, acc_t, C::MUL, C::ADD>::RunBlock},
+      {{C::MUL_CONST, C::ADD},
+       FusedChain<spec_t, acc_t, C::MUL_CONST, C::ADD>::RunBlock},
+    };
+  return chains;
+}
+
+template <typename spec_t>
+FusedChainFn<spec_t> FindSpecializedFusedChain(const FusedProgram& program) {
+  const int32_t num_inputs = program.num_inputs;
+  for (size_t k = 0; k < program.instrs.size(); k++) {
+    const auto& instr = program.instrs[k];
+    bool chained = (k == 0) ? (instr.lhs < num_inputs)
+                            : (instr.lhs == num_inputs + int32_t(k) - 1);
+    if (!chained || instr.rhs >= num_inputs)
+      return nullptr;
+  }
+  for (const auto& chain : SpecializedFusedChains<spec_t>()) {
+    if (chain.first.size() != program.instrs.size())
+      continue;
+    bool matched = true;
+    for (size_t k = 0; k < chain.first.size() && matched; k++)
+      matched = (chain.first[k] == program.instrs[k].code);
+    if (matched)
+      return chain.second;
+  }
+  return nullptr;
+}
+
+// Interprets any program one block at a time: loads the inputs of the block
+// into registers, runs each instruction as a loop over the block and stores
+// the outputs. `regs`, `masks` and `ptrs` are scratch space of the calling
+// thread, with `ptrs` pointing to the data of every register.
+template <typename spec_t, typename acc_t>
+void InterpretFusedBlock(const FusedGroupArgs<spec_t>& args, int64_t row,
+                         int64_t begin, int64_t len, acc_t* regs, bool* masks,
+                         const acc_t** ptrs) {
+  const auto& program = *args.program;
+  const int32_t num_inputs = program.num_inputs;
+  for (int32_t i = 0; i < num_inputs; i++)
+    ptrs[i] = LoadFusedBlock(args, i, row, begin, len,
+                             regs + i * kFusedBlockSize);
+  int64_t base = row * args.inner() + begin;
+  for (size_t k = 0; k < program.instrs.size(); k++) {
+    const auto& instr = program.instrs[k];
+    int32_t reg = num_inputs + k;
+    acc_t* out = regs + reg * kFusedBlockSize;
+    const acc_t* lhs = ptrs[instr.lhs];
+    const acc_t* rhs = instr.rhs >= 0 ? ptrs[instr.rhs] : nullptr;
+    bool* mask = masks + reg * kFusedBlockSize;
+    acc_t value = static_cast<acc_t>(instr.value);
+    switch (instr.code) {
+#define HT_FUSED_INSTR_CASE(CODE)                                              \
+  case FusedOpCode::CODE:                                                      \
+    RunFusedInstr<FusedOpCode::CODE, acc_t>(out, lhs, rhs, value,              \
+                                            args.keys[k], base, len, mask);    \
+    break;
+      HT_FUSED_OP_CODE_CASES(HT_FUSED_INSTR_CASE)
+#undef HT_FUSED_INSTR_CASE
+      default:
+        HT_NOT_IMPLEMENTED << "Fused op code " << instr.code
+                           << " is not supported";
+    }
+    ptrs[reg] = out;
+    StoreFusedBlock(args, reg, base, len, out, mask);
+  }
+}
+
+template <typename spec_t>
+void fused_group_cpu(const FusedGroupArgs<spec_t>& args) {
+  using acc_t = hetu::cpu::acc_type<spec_t>;
+  const int64_t inner = args.inner();
+  const int64_t blocks_per_row = DIVUP(inner, kFusedBlockSize);
+  int64_t num_rows = 1;
+  for (int d = 0; d < args.ndim - 1; d++)
+    num_rows *= args.shape[d];
+  const int64_t num_blocks = num_rows * blocks_per_row;
+  auto chain = FindSpecializedFusedChain<spec_t>(*args.program);
+  const int32_t num_registers = args.program->num_registers();
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    std::vector<acc_t> regs;
+    std::unique_ptr<bool[]> masks;
+    std::vector<const acc_t*> ptrs;
+    if (chain == nullptr) {
+      regs.resize(num_registers * kFusedBlockSize);
+      masks.reset(new bool[num_registers * kFusedBlockSize]);
+      ptrs.resize(num_registers);
+    }
+#ifdef _OPENMP
+#pragma omp for schedule(static)
+#endif
+    for (int64_t block = 0; block < num_blocks; block++) {
+      int64_t row = block / blocks_per_row;
+      int64_t begin = (block % blocks_per_row) * kFusedBlockSize;
+      int64_t len = MIN(kFusedBlockSize, inner - begin);
+      if (chain != nullptr)
+        chain(args, row, begin, len);
+      else
+        InterpretFusedBlock<spec_t, acc_t>(args, row, begin, len, regs.data(),
+                                           masks.get(), ptrs.data());
+    }
+  }
+}
+
+} // namespace
+
+void FusedGroupCpu(const NDArrayList& inputs, const FusedProgram& program,
+                   const std::vector<uint64_t>& seeds, NDArrayList& outputs,
+                   const Stream& stream) {
+  HT_ASSERT(!inputs.empty() && !outputs.empty())
+    << "Fused group requires inputs and outputs";
+  HT_ASSERT(static_cast<int32_t>(inputs.size()) == program.num_inputs &&
+            outputs.size() == program.outputs.size())
+    << "Fused group got " << inputs.size() << " inputs and " << outputs.size()
+    << " outputs for " << program;
+  for (const auto& input : inputs) {
+    HT_ASSERT_CPU_DEVICE(input);
+    HT_ASSERT_SAME_DTYPE(input, inputs.front());
+  }
+  const HTShape& shape = outputs.front()->shape();
+  for (const auto& output : outputs) {
+    HT_ASSERT_SAME_DEVICE(inputs.front(), output);
+    HT_ASSERT(output->shape() == shape && output->is_contiguous())
+      << "Outputs of a fused group should be contiguous and of the same "
+      << "shape, got " << output->shape() << " and " << shape;
+  }
+  size_t size = outputs.front()->numel();
+  if (size == 0)
+    return;
+
+  // Broadcast strides of every input over the output shape.
+  const int ndim = shape.size();
+  std::vector<HTStride> in_strides(inputs.size(), HTStride(ndim, 0));
+  for (size_t i = 0; i < inputs.size(); i++) {
+    int offset = ndim - inputs[i]->ndim();
+    HT_ASSERT(offset >= 0) << "Cannot broadcast " << inputs[i]->shape()
+                           << " to " << shape;
+    for (int d = offset; d < ndim; d++) {
+      int64_t dim = inputs[i]->shape(d - offset);
+      HT_ASSERT(dim == shape[d] || dim == 1)
+        << "Cannot broadcast " << inputs[i]->shape() << " to " << shape;
+      if (dim == shape[d])
+        in_strides[i][d] = inputs[i]->stride(d - offset);
+    }
+  }
+  // One seed per dropout, in the order of the instructions.
+  HT_ASSERT(seeds.size() == program.num_dropouts())
+    << "Fused group got " << seeds.size() << " seeds for "
+    << program.num_dropouts() << " dropouts";
+  std::vector<uint64_t> keys(program.instrs.size(), 0);
+  for (size_t k = 0, s = 0; k < program.instrs.size(); k++)
+    if (program.instrs[k].code == FusedOpCode::DROPOUT)
+      keys[k] = hetu::cpu::SplitMix64(seeds[s++]);
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(
+    inputs.front()->dtype(), spec_t, "FusedGroupCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [inputs, outputs, program, shape, in_strides, keys]() {
+          FusedGroupArgs<spec_t> args;
+          args.program = &program;
+          args.keys = keys;
+          args.ndim = 0;
+          args.in_strides.resize(inputs.size());
+          for (size_t d = 0; d < shape.size(); d++) {
+            if (shape[d] == 1)
+              continue;
+            // Merge with the previous dimension if it is contiguous with
+            // this one in every input.
+            bool mergeable = args.ndim > 0;
+            for (size_t i = 0; i < inputs.size() && mergeable; i++)
+              mergeable = args.in_strides[i][args.ndim - 1] ==
+                in_strides[i][d] * shape[d];
+            if (mergeable) {
+              args.shape[args.ndim - 1] *= shape[d];
+              for (size_t i = 0; i < inputs.size(); i++)
+                args.in_strides[i][args.ndim - 1] = in_strides[i][d];
+            } else {
+              args.shape[args.ndim] = shape[d];
+              for (size_t i = 0; i < inputs.size(); i++)
+                args.in_strides[i][args.ndim] = in_strides[i][d];
+              args.ndim++;
+            }
+          }
+          if (args.ndim == 0) {
+            args.shape[0] = 1;
+            for (size_t i = 0; i < inputs.size(); i++)
+              args.in_strides[i][0] = 0;
+            args.ndim = 1;
+          }
+          for (const auto& input : inputs)
+            args.inputs.push_back(input->data_ptr<spec_t>());
+          for (const auto& output : outputs)
+            args.outputs.push_back(output->raw_data_ptr());
+          fused_group_cpu<spec_t>(args);
+        },
+        "FusedGroup");
+    });
+  NDArray::MarkUsedBy(inputs, stream);
+  NDArray::MarkUsedBy(outputs, stream);
+}
+
+} // namespace impl
+} // namespace hetu
@@ -0,0 +1,322 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/core/stream.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/impl/utils/common_utils.h"
+#include "hetu/impl/utils/cpu_math.h"
+#include "hetu/impl/utils/omp_utils.h"
+#include <cmath>
+#include <vector>
+
+namespace hetu {
+namespace impl {
+
+namespace {
+
+// The input is viewed as [n1, n2], where n2 is the number of elements in
+// the last `reduce_dims` dims. Each row is normalized by one thread in two
+// passes over the row, which stays in L1/L2 for hidden sizes up to tens
+// of thousands. `mean_arr` and `var_arr` are float arrays of n1 elements,
+// and `var_arr` holds the inverse standard deviation as the CUDA kernels do.
+inline void GetNormDims(const NDArray& in_arr, int64_t reduce_dims,
+                        int64_t& n1, int64_t& n2) {
+  HT_ASSERT(reduce_dims > 0 && reduce_dims <= in_arr->ndim())
+    << "Invalid reduce_dims " << reduce_dims << " for shape "
+    << in_arr->shape();
+  n2 = 1;
+  for (int64_t i = in_arr->ndim() - reduce_dims; i < in_arr->ndim(); i++)
+    n2 *= in_arr->shape(i);
+  n1 = n2 == 0 ? 0 : in_arr->numel() / n2;
+}
+
+template <typename spec_t, bool rms_only>
+void fused_norm_cpu(const spec_t* input, const spec_t* gamma,
+                    const spec_t* beta, float* mean, float* invvar,
+                    spec_t* output, int64_t n1, int64_t n2, float eps) {
+  using acc_t = hetu::cpu::acc_type<spec_t>;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int64_t i1 = 0; i1 < n1; i1++) {
+    const spec_t* x = input + i1 * n2;
+    spec_t* y = output + i1 * n2;
+    acc_t mu = 0, sigma2 = 0;
+    if (!rms_only) {
+#pragma omp simd reduction(+ : mu)
+      for (int64_t i2 = 0; i2 < n2; i2++)
+        mu += static_cast<acc_t>(x[i2]);
+      mu /= n2;
+    }
+#pragma omp simd reduction(+ : sigma2)
+    for (int64_t i2 = 0; i2 < n2; i2++) {
+      acc_t diff = static_cast<acc_t>(x[i2]) - mu;
+      sigma2 += diff * diff;
+    }
+    sigma2 /= n2;
+    acc_t rstd = acc_t(1) / std::sqrt(sigma2 + static_cast<acc_t>(eps));
+    if (!rms_only)
+      mean[i1] = static_cast<float>(mu);
+    invvar[i1] = static_cast<float>(rstd);
+#pragma omp simd
+    for (int64_t i2 = 0; i2 < n2; i2++) {
+      acc_t val = (static_cast<acc_t>(x[i2]) - mu) * rstd *
+        static_cast<acc_t>(gamma[i2]);
+      if (!rms_only)
+        val += static_cast<acc_t>(beta[i2]);
+      y[i2] = static_cast<spec_t>(val);
+    }
+  }
+}
+
+template <typename acc_t>
+inline acc_t ClampByMagnitude(acc_t gamma, float eps) {
+  const acc_t min_gamma = static_cast<acc_t>(eps);
+  if (gamma >= 0)
+    return gamma < min_gamma ? min_gamma : gamma;
+  return gamma > -min_gamma ? -min_gamma : gamma;
+}
+
+// Computes the input gradient row by row, and accumulates the gradients of
+// gamma (and beta) into per-thread partial sums that are reduced at the
+// end, so that all three are produced in a single pass over the rows.
+// In the memory efficient mode, `input_or_output` is the normalized output
+// and the normalized input is recovered as (y - beta) / gamma.
+template <typename spec_t, bool rms_only, bool memory_efficient>
+void fused_norm_gradient_cpu(const spec_t* dout, const spec_t* input_or_output,
+                             const spec_t* gamma, const spec_t* beta,
+                             const float* mean, const float* invvar,
+                             spec_t* grad_input, spec_t* grad_gamma,
+                             spec_t* grad_beta, int64_t n1, int64_t n2,
+                             float eps) {
+  using acc_t = hetu::cpu::acc_type<spec_t>;
+  const int64_t num_parts =
+    MAX(MIN(static_cast<int64_t>(hetu::omp::OMP_GET_MAX_THREADS()), n1), 1);
+  std::vector<acc_t> part_grad_gamma(num_parts * n2, 0);
+  std::vector<acc_t> part_grad_beta(rms_only ? 0 : num_parts * n2, 0);
+  std::vector<acc_t> clamped_gamma(n2);
+  for (int64_t i2 = 0; i2 < n2; i2++)
+    clamped_gamma[i2] = ClampByMagnitude(static_cast<acc_t>(gamma[i2]), eps);
+  const acc_t* k_gamma = clamped_gamma.data();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int64_t part = 0; part < num_parts; part++) {
+    acc_t* p_gamma = part_grad_gamma.data() + part * n2;
+    acc_t* p_beta = rms_only ? nullptr : part_grad_beta.data() + part * n2;
+    int64_t begin = n1 * part / num_parts, end = n1 * (part + 1) / num_parts;
+    for (int64_t i1 = begin; i1 < end; i1++) {
+      const spec_t* dy = dout + i1 * n2;
+      const spec_t* h = input_or_output + i1 * n2;
+      spec_t* dx = grad_input + i1 * n2;
+      const acc_t c_invvar = static_cast<acc_t>(invvar[i1]);
+      const acc_t c_mean =
+        (rms_only || memory_efficient) ? acc_t(0) : static_cast<acc_t>(mean[i1]);
+      // xhat is the normalized input before the affine transform.
+      auto xhat = [&](int64_t i2) -> acc_t {
+        acc_t c_h = static_cast<acc_t>(h[i2]);
+        if (memory_efficient) {
+          if (!rms_only)
+            c_h -= static_cast<acc_t>(beta[i2]);
+          return c_h / k_gamma[i2];
+        }
+        return (c_h - c_mean) * c_invvar;
+      };
+      acc_t sum_loss1 = 0, sum_loss2 = 0;
+#pragma omp simd reduction(+ : sum_loss1, sum_loss2)
+      for (int64_t i2 = 0; i2 < n2; i2++) {
+        acc_t c_loss = static_cast<acc_t>(dy[i2]);
+        acc_t c_xhat = xhat(i2);
+        acc_t c_gamma = static_cast<acc_t>(gamma[i2]);
+        if (!rms_only) {
+          sum_loss1 += c_loss * c_gamma;
+          p_beta[i2] += c_loss;
+        }
+        if (memory_efficient) {
+          acc_t c_h = static_cast<acc_t>(h[i2]);
+          if (!rms_only)
+            c_h -= static_cast<acc_t>(beta[i2]);
+          sum_loss2 += c_loss * c_h;
+        } else {
+          sum_loss2 += c_loss * c_gamma * c_xhat;
+        }
+        p_gamma[i2] += c_loss * c_xhat;
+      }
+      const acc_t f_h = static_cast<acc_t>(n2);
+      const acc_t term1 = (acc_t(1) / f_h) * c_invvar;
+#pragma omp simd
+      for (int64_t i2 = 0; i2 < n2; i2++) {
+        acc_t c_loss = static_cast<acc_t>(dy[i2]);
+        acc_t f_grad_input = f_h * c_loss * static_cast<acc_t>(gamma[i2]) -
+          sum_loss1 - xhat(i2) * sum_loss2;
+        dx[i2] = static_cast<spec_t>(f_grad_input * term1);
+      }
+    }
+  }
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int64_t i2 = 0; i2 < n2; i2++) {
+    acc_t sum_gamma = 0, sum_beta = 0;
+    for (int64_t part = 0; part < num_parts; part++) {
+      sum_gamma += part_grad_gamma[part * n2 + i2];
+      if (!rms_only)
+        sum_beta += part_grad_beta[part * n2 + i2];
+    }
+    grad_gamma[i2] = static_cast<spec_t>(sum_gamma);
+    if (!rms_only)
+      grad_beta[i2] = static_cast<spec_t>(sum_beta);
+  }
+}
+
+} // namespace
+
+void FusedLayerNormCpu(const NDArray& in_arr, const NDArray& ln_scale,
+                       const NDArray& ln_bias, NDArray& mean_arr,
+                       NDArray& var_arr, NDArray& out_arr, int64_t reduce_dims,
+                       float eps, const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(in_arr);
+  HT_ASSERT_SAME_DEVICE(in_arr, ln_scale);
+  HT_ASSERT_SAME_DEVICE(in_arr, ln_bias);
+  HT_ASSERT_SAME_DEVICE(in_arr, mean_arr);
+  HT_ASSERT_SAME_DEVICE(in_arr, var_arr);
+  HT_ASSERT_SAME_DEVICE(in_arr, out_arr);
+  HT_ASSERT(in_arr->is_contiguous() && out_arr->is_contiguous())
+    << "FusedLayerNorm only supports contiguous arrays.";
+
+  int64_t n1, n2;
+  GetNormDims(in_arr, reduce_dims, n1, n2);
+  if (n1 == 0)
+    return;
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(
+    in_arr->dtype(), spec_t, "FusedLayerNormCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [in_arr, ln_scale, ln_bias, mean_arr, var_arr, out_arr, n1, n2,
+         eps]() {
+          fused_norm_cpu<spec_t, false>(
+            in_arr->data_ptr<spec_t>(), ln_scale->data_ptr<spec_t>(),
+            ln_bias->data_ptr<spec_t>(), mean_arr->data_ptr<float>(),
+            var_arr->data_ptr<float>(), out_arr->data_ptr<spec_t>(), n1, n2,
+            eps);
+        },
+        "FusedLayerNorm");
+    });
+  NDArray::MarkUsedBy({in_arr, ln_scale, ln_bias, mean_arr, var_arr, out_arr},
+                      stream);
+}
+
+void FusedRMSNormCpu(const NDArray& in_arr, const NDArray& ln_scale,
+                     NDArray& var_arr, NDArray& out_arr, int64_t reduce_dims,
+                     float eps, const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(in_arr);
+  HT_ASSERT_SAME_DEVICE(in_arr, ln_scale);
+  HT_ASSERT_SAME_DEVICE(in_arr, var_arr);
+  HT_ASSERT_SAME_DEVICE(in_arr, out_arr);
+  HT_ASSERT(in_arr->is_contiguous() && out_arr->is_contiguous())
+    << "FusedRMSNorm only supports contiguous arrays.";
+
+  int64_t n1, n2;
+  GetNormDims(in_arr, reduce_dims, n1, n2);
+  if (n1 == 0)
+    return;
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(
+    in_arr->dtype(), spec_t, "FusedRMSNormCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [in_arr, ln_scale, var_arr, out_arr, n1, n2, eps]() {
+          fused_norm_cpu<spec_t, true>(
+            in_arr->data_ptr<spec_t>(), ln_scale->data_ptr<spec_t>(), nullptr,
+            nullptr, var_arr->data_ptr<float>(), out_arr->data_ptr<spec_t>(),
+            n1, n2, eps);
+        },
+        "FusedRMSNorm");
+    });
+  NDArray::MarkUsedBy({in_arr, ln_scale, var_arr, out_arr}, stream);
+}
+
+void FusedLayerNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
+                               const NDArray& ln_scale, const NDArray& ln_bias,
+                               NDArray& grad_arr, NDArray& grad_scale,
+                               NDArray& grad_bias, const NDArray& mean_arr,
+                               const NDArray& var_arr, int64_t reduce_dims,
+                               float eps, bool inplace, const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(out_grads);
+  HT_ASSERT_SAME_DEVICE(out_grads, ln_scale);
+  HT_ASSERT_SAME_DEVICE(out_grads, in_arr);
+  HT_ASSERT_SAME_DEVICE(out_grads, mean_arr);
+  HT_ASSERT_SAME_DEVICE(out_grads, var_arr);
+  HT_ASSERT_SAME_DEVICE(out_grads, grad_scale);
+  HT_ASSERT_SAME_DEVICE(out_grads, grad_arr);
+  HT_ASSERT_SAME_DEVICE(out_grads, grad_bias);
+  HT_ASSERT(out_grads->is_contiguous() && in_arr->is_contiguous() &&
+            grad_arr->is_contiguous())
+    << "FusedLayerNormGradient only supports contiguous arrays.";
+
+  int64_t n1, n2;
+  GetNormDims(in_arr, reduce_dims, n1, n2);
+  if (n1 == 0)
+    return;
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(
+    in_arr->dtype(), spec_t, "FusedLayerNormGradientCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [out_grads, in_arr, ln_scale, ln_bias, grad_arr, grad_scale,
+         grad_bias, mean_arr, var_arr, n1, n2, eps, inplace]() {
+          auto fn = inplace ? fused_norm_gradient_cpu<spec_t, false, true>
+                            : fused_norm_gradient_cpu<spec_t, false, false>;
+          fn(out_grads->data_ptr<spec_t>(), in_arr->data_ptr<spec_t>(),
+             ln_scale->data_ptr<spec_t>(), ln_bias->data_ptr<spec_t>(),
+             mean_arr->data_ptr<float>(), var_arr->data_ptr<float>(),
+             grad_arr->data_ptr<spec_t>(), grad_scale->data_ptr<spec_t>(),
+             grad_bias->data_ptr<spec_t>(), n1, n2, eps);
+        },
+        "FusedLayerNormGradient");
+    });
+  NDArray::MarkUsedBy({out_grads, in_arr, ln_scale, ln_bias, grad_arr,
+                       grad_scale, grad_bias, mean_arr, var_arr},
+                      stream);
+}
+
+void FusedRMSNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
+                             const NDArray& ln_scale, NDArray& grad_arr,
+                             NDArray& grad_scale, const NDArray& var_arr,
+                             int64_t reduce_dims, float eps, bool inplace,
+                             const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(out_grads);
+  HT_ASSERT_SAME_DEVICE(out_grads, ln_scale);
+  HT_ASSERT_SAME_DEVICE(out_grads, in_arr);
+  HT_ASSERT_SAME_DEVICE(out_grads, var_arr);
+  HT_ASSERT_SAME_DEVICE(out_grads, grad_scale);
+  HT_ASSERT_SAME_DEVICE(out_grads, grad_arr);
+  HT_ASSERT(out_grads->is_contiguous() && in_arr->is_contiguous() &&
+            grad_arr->is_contiguous())
+    << "FusedRMSNormGradient only supports contiguous arrays.";
+
+  int64_t n1, n2;
+  GetNormDims(in_arr, reduce_dims, n1, n2);
+  if (n1 == 0)
+    return;
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(
+    in_arr->dtype(), spec_t, "FusedRMSNormGradientCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [out_grads, in_arr, ln_scale, grad_arr, grad_scale, var_arr, n1, n2,
+         eps, inplace]() {
+          auto fn = inplace ? fused_norm_gradient_cpu<spec_t, true, true>
+                            : fused_norm_gradient_cpu<spec_t, true, false>;
+          fn(out_grads->data_ptr<spec_t>(), in_arr->data_ptr<spec_t>(),
+             ln_scale->data_ptr<spec_t>(), nullptr, nullptr,
+             var_arr->data_ptr<float>(), grad_arr->data_ptr<spec_t>(),
+             grad_scale->data_ptr<spec_t>(), nullptr, n1, n2, eps);
+        },
+        "FusedRMSNormGradient");
+    });
+  NDArray::MarkUsedBy(
+    {out_grads, in_arr, ln_scale, grad_arr, grad_scale, var_arr}, stream);
+}
+
+} // namespace impl
+} // namespace hetu
@@ -47,8 +47,8 @@ void InstanceNormCpu(const NDArray& in_arr, NDArray& mean_arr, NDArray& var_arr,
     in_arr->dtype(), spec_t, "InstanceNormCpu", [&]() {
       cpu_stream.EnqueueTask(
       [stream, in_arr, mean_arr, var_arr, out_arr, eps, last_2dim, ndim]() {
-      dnnl::engine eng(dnnl::engine::kind::cpu, 0);
-      dnnl::stream engine_stream(eng); 
+      const auto& eng = hetu::cpu::GetDNNLEngine();
+      auto& engine_stream = hetu::cpu::GetDNNLStream(); 
       auto dnnltype = hetu::cpu::dtype_to_dnnltype(in_arr->dtype());
       auto src_md = dnnl::memory::desc(in_arr->shape(), dnnltype, in_arr->stride());
       auto dst_md = dnnl::memory::desc(mean_arr->shape(), dnnltype, mean_arr->stride());
@@ -60,12 +60,9 @@ void InstanceNormCpu(const NDArray& in_arr, NDArray& mean_arr, NDArray& var_arr,
         hetu::cpu::read_from_dnnl_memory(mean_arr->data_ptr<spec_t>(), src_mem);
       else {
 
-        // Create primitive descriptor.
-        auto reduction_pd = dnnl::reduction::primitive_desc(
-                eng, dnnl::algorithm::reduction_mean, src_md, dst_md, float(0.f), float(0.f));
-
-        // Create the primitive.
-        auto reduction_prim = dnnl::reduction(reduction_pd);
+        // Create (or reuse) the primitive.
+        auto reduction = hetu::cpu::GetOrCreateDNNLReduction(
+                dnnl::algorithm::reduction_mean, src_md, dst_md);
 
         // Primitive arguments.
         std::unordered_map<int, dnnl::memory> reduction_args;
@@ -73,7 +70,7 @@ void InstanceNormCpu(const NDArray& in_arr, NDArray& mean_arr, NDArray& var_arr,
         reduction_args.insert({DNNL_ARG_DST, dst_mem});
 
         // Primitive execution: Reduction (Sum).
-        reduction_prim.execute(engine_stream, reduction_args);
+        reduction->prim.execute(engine_stream, reduction_args);
       }
 
       engine_stream.wait();
@@ -89,12 +86,9 @@ void InstanceNormCpu(const NDArray& in_arr, NDArray& mean_arr, NDArray& var_arr,
         hetu::cpu::read_from_dnnl_memory(var_arr->data_ptr<spec_t>(), src_mem);
       else {
 
-        // Create primitive descriptor.
-        auto reduction_pd = dnnl::reduction::primitive_desc(
-                eng, dnnl::algorithm::reduction_mean, src_md, dst_md, float(0.f), float(0.f));
-
-        // Create the primitive.
-        auto reduction_prim = dnnl::reduction(reduction_pd);
+        // Create (or reuse) the primitive.
+        auto reduction = hetu::cpu::GetOrCreateDNNLReduction(
+                dnnl::algorithm::reduction_mean, src_md, dst_md);
 
         // Primitive arguments.
         std::unordered_map<int, dnnl::memory> reduction_args;
@@ -102,7 +96,7 @@ void InstanceNormCpu(const NDArray& in_arr, NDArray& mean_arr, NDArray& var_arr,
         reduction_args.insert({DNNL_ARG_DST, dst_mem});
 
         // Primitive execution: Reduction (Sum).
-        reduction_prim.execute(engine_stream, reduction_args);
+        reduction->prim.execute(engine_stream, reduction_args);
         engine_stream.wait();
       }
       std_normal_transform<spec_t>(
@@ -168,8 +162,8 @@ void InstanceNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
       spec_t* dbias = dbias_arr->data_ptr<spec_t>();
       spec_t* dy_mul_x = dy_mul_x_arr->data_ptr<spec_t>();
       
-      dnnl::engine eng(dnnl::engine::kind::cpu, 0);
-      dnnl::stream engine_stream(eng); 
+      const auto& eng = hetu::cpu::GetDNNLEngine();
+      auto& engine_stream = hetu::cpu::GetDNNLStream(); 
       auto dnnltype = hetu::cpu::dtype_to_dnnltype(in_arr->dtype());
       auto src_md = dnnl::memory::desc(in_arr->shape(), dnnltype, in_arr->stride());
       auto dst_md = dnnl::memory::desc(mean_arr->shape(), dnnltype, mean_arr->stride());
@@ -181,12 +175,9 @@ void InstanceNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
         hetu::cpu::read_from_dnnl_memory(dbias, src_mem);
       else {
 
-        // Create primitive descriptor.
-        auto reduction_pd = dnnl::reduction::primitive_desc(
-                eng, dnnl::algorithm::reduction_sum, src_md, dst_md, float(0.f), float(0.f));
-
-        // Create the primitive.
-        auto reduction_prim = dnnl::reduction(reduction_pd);
+        // Create (or reuse) the primitive.
+        auto reduction = hetu::cpu::GetOrCreateDNNLReduction(
+                dnnl::algorithm::reduction_sum, src_md, dst_md);
 
         // Primitive arguments.
         std::unordered_map<int, dnnl::memory> reduction_args;
@@ -194,7 +185,7 @@ void InstanceNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
         reduction_args.insert({DNNL_ARG_DST, dst_mem});
 
         // Primitive execution: Reduction (Sum).
-        reduction_prim.execute(engine_stream, reduction_args);
+        reduction->prim.execute(engine_stream, reduction_args);
       } 
       engine_stream.wait();
       // Create src memory objects.
@@ -202,11 +193,9 @@ void InstanceNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
       auto src_B_mem = dnnl::memory(src_md, eng, in_arr->data_ptr<spec_t>());
       auto dymulx_mem = dnnl::memory(src_md, eng, dy_mul_x);
 
-      auto binary_pd = dnnl::binary::primitive_desc(eng, dnnl::algorithm::binary_mul,
-                                                    src_md, src_md, src_md);
-
-      // Create the primitive.
-      auto binary_prim = dnnl::binary(binary_pd);
+      // Create (or reuse) the primitive.
+      auto binary = hetu::cpu::GetOrCreateDNNLBinary(dnnl::algorithm::binary_mul,
+                                                     src_md, src_md, src_md);
 
       // Primitive arguments. Set up in-place execution by assigning src_0 as DST.
       std::unordered_map<int, dnnl::memory> binary_args;
@@ -215,7 +204,7 @@ void InstanceNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
       binary_args.insert({DNNL_ARG_DST, dymulx_mem});
 
       // Primitive execution: binary with ReLU.
-      binary_prim.execute(engine_stream, binary_args);
+      binary->prim.execute(engine_stream, binary_args);
       engine_stream.wait();
 
       dst_mem = dnnl::memory(dst_md, eng, dscale);
@@ -224,12 +213,9 @@ void InstanceNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
         hetu::cpu::read_from_dnnl_memory(dscale, dymulx_mem);
       else {
 
-        // Create primitive descriptor.
-        auto reduction_pd = dnnl::reduction::primitive_desc(
-                eng, dnnl::algorithm::reduction_sum, src_md, dst_md, float(0.f), float(0.f));
-
-        // Create the primitive.
-        auto reduction_prim = dnnl::reduction(reduction_pd);
+        // Create (or reuse) the primitive.
+        auto reduction = hetu::cpu::GetOrCreateDNNLReduction(
+                dnnl::algorithm::reduction_sum, src_md, dst_md);
 
         // Primitive arguments.
         std::unordered_map<int, dnnl::memory> reduction_args;
@@ -237,7 +223,7 @@ void InstanceNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
         reduction_args.insert({DNNL_ARG_DST, dst_mem});
 
         // Primitive execution: Reduction (Sum).
-        reduction_prim.execute(engine_stream, reduction_args);
+        reduction->prim.execute(engine_stream, reduction_args);
       } 
       engine_stream.wait();
       calculate_grad_kernel<spec_t>(
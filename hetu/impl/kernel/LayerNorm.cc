@@ -72,8 +72,8 @@ void LayerNormCpu(const NDArray& in_arr, const NDArray& ln_scale,
       cpu_stream.EnqueueTask(
       [stream, in_arr, ln_scale, ln_bias, mean_arr, var_arr, out_arr, temp_strideA, temp_strideC,
        eps, last_dims, ndim]() {
-      dnnl::engine eng(dnnl::engine::kind::cpu, 0);
-      dnnl::stream engine_stream(eng);
+      const auto& eng = hetu::cpu::GetDNNLEngine();
+      auto& engine_stream = hetu::cpu::GetDNNLStream();
       auto dnnltype = hetu::cpu::dtype_to_dnnltype(in_arr->dtype());
       auto src_md = dnnl::memory::desc(in_arr->shape(), dnnltype, in_arr->stride());
       auto dst_md = dnnl::memory::desc(mean_arr->shape(), dnnltype, mean_arr->stride());
@@ -85,12 +85,9 @@ void LayerNormCpu(const NDArray& in_arr, const NDArray& ln_scale,
         hetu::cpu::read_from_dnnl_memory(mean_arr->data_ptr<spec_t>(), src_mem);
       else {
 
-        // Create primitive descriptor.
-        auto reduction_pd = dnnl::reduction::primitive_desc(
-                eng, dnnl::algorithm::reduction_mean, src_md, dst_md, float(0.f), float(0.f));
-
-        // Create the primitive.
-        auto reduction_prim = dnnl::reduction(reduction_pd);
+        // Create (or reuse) the primitive.
+        auto reduction = hetu::cpu::GetOrCreateDNNLReduction(
+                dnnl::algorithm::reduction_mean, src_md, dst_md);
 
         // Primitive arguments.
         std::unordered_map<int, dnnl::memory> reduction_args;
@@ -98,7 +95,7 @@ void LayerNormCpu(const NDArray& in_arr, const NDArray& ln_scale,
         reduction_args.insert({DNNL_ARG_DST, dst_mem});
 
         // Primitive execution: Reduction (Sum).
-        reduction_prim.execute(engine_stream, reduction_args);
+        reduction->prim.execute(engine_stream, reduction_args);
       }
       engine_stream.wait();
 
@@ -113,12 +110,9 @@ void LayerNormCpu(const NDArray& in_arr, const NDArray& ln_scale,
         hetu::cpu::read_from_dnnl_memory(var_arr->data_ptr<spec_t>(), src_mem);
       else {
 
-        // Create primitive descriptor.
-        auto reduction_pd = dnnl::reduction::primitive_desc(
-                eng, dnnl::algorithm::reduction_mean, src_md, dst_md, float(0.f), float(0.f));
-
-        // Create the primitive.
-        auto reduction_prim = dnnl::reduction(reduction_pd);
+        // Create (or reuse) the primitive.
+        auto reduction = hetu::cpu::GetOrCreateDNNLReduction(
+                dnnl::algorithm::reduction_mean, src_md, dst_md);
 
         // Primitive arguments.
         std::unordered_map<int, dnnl::memory> reduction_args;
@@ -126,7 +120,7 @@ void LayerNormCpu(const NDArray& in_arr, const NDArray& ln_scale,
         reduction_args.insert({DNNL_ARG_DST, dst_mem});
 
         // Primitive execution: Reduction (Sum).
-        reduction_prim.execute(engine_stream, reduction_args);
+        reduction->prim.execute(engine_stream, reduction_args);
       }
       engine_stream.wait();
 
@@ -214,7 +208,7 @@ void LayerNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
       [stream, out_grads, in_arr, ln_scale, grad_scale, grad_bias, grad_arr, mean_arr, var_arr, 
       ds_arr, db_arr, dy_mul_x_arr, gscale_arr,
       reduce_dims, eps, ndim, lastdims, total_elements, size]() {
-      dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+      const auto& eng = hetu::cpu::GetDNNLEngine();
       spec_t* ds = ds_arr->data_ptr<spec_t>();
       spec_t* db = db_arr->data_ptr<spec_t>();
       spec_t* dy_mul_x = dy_mul_x_arr->data_ptr<spec_t>();
@@ -228,7 +222,7 @@ void LayerNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
         scale_stride[ndim - 1 - i] = stride_size;
         stride_size *= scale_shape[ndim - 1 - i];
       }
-      dnnl::stream engine_stream(eng);
+      auto& engine_stream = hetu::cpu::GetDNNLStream();
       auto dnnltype = hetu::cpu::dtype_to_dnnltype(in_arr->dtype());
       auto src_md = dnnl::memory::desc(in_arr->shape(), dnnltype, in_arr->stride());
       auto scale_md = dnnl::memory::desc(scale_shape, dnnltype, scale_stride);
@@ -242,12 +236,9 @@ void LayerNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
         hetu::cpu::read_from_dnnl_memory(grad_bias->data_ptr<spec_t>(), src_mem);
       else {
 
-        // Create primitive descriptor.
-        auto reduction_pd = dnnl::reduction::primitive_desc(
-                eng, dnnl::algorithm::reduction_sum, src_md, scale_md, float(0.f), float(0.f));
-
-        // Create the primitive.
-        auto reduction_prim = dnnl::reduction(reduction_pd);
+        // Create (or reuse) the primitive.
+        auto reduction = hetu::cpu::GetOrCreateDNNLReduction(
+                dnnl::algorithm::reduction_sum, src_md, scale_md);
 
         // Primitive arguments.
         std::unordered_map<int, dnnl::memory> reduction_args;
@@ -255,7 +246,7 @@ void LayerNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
         reduction_args.insert({DNNL_ARG_DST, scale_mem});
 
         // Primitive execution: Reduction (Sum).
-        reduction_prim.execute(engine_stream, reduction_args);
+        reduction->prim.execute(engine_stream, reduction_args);
       } 
       engine_stream.wait();
 
@@ -270,12 +261,9 @@ void LayerNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
         hetu::cpu::read_from_dnnl_memory(grad_scale->data_ptr<spec_t>(), src_mem);
       else {
 
-        // Create primitive descriptor.
-        auto reduction_pd = dnnl::reduction::primitive_desc(
-                eng, dnnl::algorithm::reduction_sum, src_md, scale_md, float(0.f), float(0.f));
-
-        // Create the primitive.
-        auto reduction_prim = dnnl::reduction(reduction_pd);
+        // Create (or reuse) the primitive.
+        auto reduction = hetu::cpu::GetOrCreateDNNLReduction(
+                dnnl::algorithm::reduction_sum, src_md, scale_md);
 
         // Primitive arguments.
         std::unordered_map<int, dnnl::memory> reduction_args;
@@ -283,7 +271,7 @@ void LayerNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
         reduction_args.insert({DNNL_ARG_DST, scale_mem});
 
         // Primitive execution: Reduction (Sum).
-        reduction_prim.execute(engine_stream, reduction_args);
+        reduction->prim.execute(engine_stream, reduction_args);
       } 
 
       src_mem = dnnl::memory(src_md, eng, out_grads->data_ptr<spec_t>());
@@ -292,12 +280,9 @@ void LayerNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
         hetu::cpu::read_from_dnnl_memory(db, src_mem);
       else {
 
-        // Create primitive descriptor.
-        auto reduction_pd = dnnl::reduction::primitive_desc(
-                eng, dnnl::algorithm::reduction_sum, src_md, mean_md, float(0.f), float(0.f));
-
-        // Create the primitive.
-        auto reduction_prim = dnnl::reduction(reduction_pd);
+        // Create (or reuse) the primitive.
+        auto reduction = hetu::cpu::GetOrCreateDNNLReduction(
+                dnnl::algorithm::reduction_sum, src_md, mean_md);
 
         // Primitive arguments.
         std::unordered_map<int, dnnl::memory> reduction_args;
@@ -305,7 +290,7 @@ void LayerNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
         reduction_args.insert({DNNL_ARG_DST, mean_mem});
 
         // Primitive execution: Reduction (Sum).
-        reduction_prim.execute(engine_stream, reduction_args);
+        reduction->prim.execute(engine_stream, reduction_args);
       } 
       
 
@@ -314,11 +299,9 @@ void LayerNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
       auto src_B_mem = dnnl::memory(src_md, eng, in_arr->data_ptr<spec_t>());
       auto mdst_mem = dnnl::memory(src_md, eng, dy_mul_x);
 
-      auto binary_pd = dnnl::binary::primitive_desc(eng, dnnl::algorithm::binary_mul,
-                                                    src_md, src_md, src_md);
-
-      // Create the primitive.
-      auto binary_prim = dnnl::binary(binary_pd);
+      // Create (or reuse) the primitive.
+      auto binary = hetu::cpu::GetOrCreateDNNLBinary(dnnl::algorithm::binary_mul,
+                                                     src_md, src_md, src_md);
 
       // Primitive arguments. Set up in-place execution by assigning src_0 as DST.
       std::unordered_map<int, dnnl::memory> binary_args;
@@ -327,7 +310,7 @@ void LayerNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
       binary_args.insert({DNNL_ARG_DST, mdst_mem});
 
       // Primitive execution: binary with ReLU.
-      binary_prim.execute(engine_stream, binary_args);
+      binary->prim.execute(engine_stream, binary_args);
       engine_stream.wait();
 
       mean_mem = dnnl::memory(mean_md, eng, ds);
@@ -335,12 +318,9 @@ void LayerNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
         hetu::cpu::read_from_dnnl_memory(ds, mdst_mem);
       else {
 
-        // Create primitive descriptor.
-        auto reduction_pd = dnnl::reduction::primitive_desc(
-                eng, dnnl::algorithm::reduction_sum, src_md, mean_md, float(0.f), float(0.f));
-
-        // Create the primitive.
-        auto reduction_prim = dnnl::reduction(reduction_pd);
+        // Create (or reuse) the primitive.
+        auto reduction = hetu::cpu::GetOrCreateDNNLReduction(
+                dnnl::algorithm::reduction_sum, src_md, mean_md);
 
         // Primitive arguments.
         std::unordered_map<int, dnnl::memory> reduction_args;
@@ -348,7 +328,7 @@ void LayerNormGradientCpu(const NDArray& out_grads, const NDArray& in_arr,
         reduction_args.insert({DNNL_ARG_DST, mean_mem});
 
         // Primitive execution: Reduction (Sum).
-        reduction_prim.execute(engine_stream, reduction_args);
+        reduction->prim.execute(engine_stream, reduction_args);
       } 
       engine_stream.wait();
 
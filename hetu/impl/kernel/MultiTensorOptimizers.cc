@@ -0,0 +1,354 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/core/stream.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/impl/utils/common_utils.h"
+#include "hetu/impl/utils/cpu_math.h"
+#include "hetu/impl/utils/ndarray_utils.h"
+#include "hetu/impl/utils/omp_utils.h"
+#include <cmath>
+#include <vector>
+
+namespace hetu {
+namespace impl {
+
+namespace {
+
+// Multi-tensor optimizer steps update a whole list of parameters in one
+// task. All tensors are cut into chunks of at most kMultiTensorChunkSize
+// elements, and a single parallel loop over the chunks of all tensors runs
+// each step, so small tensors do not pay one task and one parallel region
+// each, and large ones are still split across threads.
+//
+// Optionally, gradients are unscaled by `grad_scale` and clipped by their
+// global L2 norm, and the step is skipped if any gradient is not finite.
+// Half-precision parameters can be updated through float32 master copies,
+// in which case the optimizer states are float32 as well.
+//
+// The update ops of a graph are applied in such groups on CPU (see
+// ComputeMultiTensorUpdate); each kernel matches its per-tensor counterpart
+// in Optimizers.cc.
+constexpr int64_t kMultiTensorChunkSize = 1 << 16;
+
+struct TensorChunk {
+  int64_t tensor;
+  int64_t begin;
+  int64_t end;
+};
+
+std::vector<TensorChunk> MakeTensorChunks(const NDArrayList& tensors) {
+  std::vector<TensorChunk> chunks;
+  for (size_t t = 0; t < tensors.size(); t++) {
+    int64_t numel = tensors[t]->numel();
+    for (int64_t begin = 0; begin < numel; begin += kMultiTensorChunkSize)
+      chunks.push_back(
+        {static_cast<int64_t>(t), begin,
+         MIN(begin + kMultiTensorChunkSize, numel)});
+  }
+  return chunks;
+}
+
+template <typename T>
+std::vector<T*> GetDataPtrs(const NDArrayList& tensors) {
+  std::vector<T*> ptrs;
+  ptrs.reserve(tensors.size());
+  for (const auto& tensor : tensors)
+    ptrs.push_back(tensor->data_ptr<T>());
+  return ptrs;
+}
+
+// Returns the coefficient to multiply gradients with, or 0 if the step
+// should be skipped due to non-finite gradients.
+template <typename spec_t>
+float ComputeGradCoefficient(const std::vector<spec_t*>& grads,
+                             const std::vector<TensorChunk>& chunks,
+                             float grad_scale, float max_grad_norm,
+                             bool check_finite, bool& found_inf) {
+  found_inf = false;
+  if (max_grad_norm <= 0 && !check_finite)
+    return grad_scale;
+  double sum_squares = 0;
+  const int64_t num_chunks = chunks.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) reduction(+ : sum_squares)
+#endif
+  for (int64_t c = 0; c < num_chunks; c++) {
+    const spec_t* g = grads[chunks[c].tensor];
+    float partial = 0;
+#ifdef _OPENMP
+#pragma omp simd reduction(+ : partial)
+#endif
+    for (int64_t i = chunks[c].begin; i < chunks[c].end; i++) {
+      float val = static_cast<float>(g[i]);
+      partial += val * val;
+    }
+    sum_squares += partial;
+  }
+  // NaN or Inf in any gradient propagates to the sum.
+  if (!std::isfinite(sum_squares)) {
+    found_inf = true;
+    return 0;
+  }
+  float coef = grad_scale;
+  if (max_grad_norm > 0) {
+    double norm = std::sqrt(sum_squares) * grad_scale;
+    if (norm > max_grad_norm)
+      coef *= static_cast<float>(max_grad_norm / (norm + 1e-6));
+  }
+  return coef;
+}
+
+// Parameters are read from and written to `master` if it is not null, and
+// `param` receives the rounded result.
+template <typename spec_t, typename state_t>
+void multi_tensor_sgd_cpu(const std::vector<spec_t*>& grads,
+                          const std::vector<spec_t*>& params,
+                          const std::vector<float*>& masters,
+                          const std::vector<state_t*>& velocities,
+                          const std::vector<TensorChunk>& chunks, float coef,
+                          float lr, float momentum, bool nesterov) {
+  using acc_t = hetu::cpu::acc_type<spec_t>;
+  const int64_t num_chunks = chunks.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int64_t c = 0; c < num_chunks; c++) {
+    const int64_t t = chunks[c].tensor;
+    const spec_t* g = grads[t];
+    spec_t* p = params[t];
+    float* w = masters.empty() ? nullptr : masters[t];
+    state_t* v = velocities.empty() ? nullptr : velocities[t];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for (int64_t i = chunks[c].begin; i < chunks[c].end; i++) {
+      acc_t grad = static_cast<acc_t>(g[i]) * coef;
+      acc_t weight = w ? static_cast<acc_t>(w[i]) : static_cast<acc_t>(p[i]);
+      if (momentum == 0) {
+        weight -= lr * grad;
+      } else {
+        acc_t vel = static_cast<acc_t>(v[i]);
+        if (!nesterov) {
+          vel = momentum * vel - lr * grad;
+          weight += vel;
+        } else {
+          vel = momentum * (vel - lr * grad);
+          weight += vel - lr * grad;
+        }
+        v[i] = static_cast<state_t>(vel);
+      }
+      if (w)
+        w[i] = static_cast<float>(weight);
+      p[i] = static_cast<spec_t>(weight);
+    }
+  }
+}
+
+template <typename spec_t, typename state_t>
+void multi_tensor_adam_cpu(const std::vector<spec_t*>& grads,
+                           const std::vector<spec_t*>& params,
+                           const std::vector<float*>& masters,
+                           const std::vector<state_t*>& means,
+                           const std::vector<state_t*>& variances,
+                           const std::vector<TensorChunk>& chunks, float coef,
+                           int64_t step, float lr, float beta1, float beta2,
+                           float eps, float weight_decay) {
+  using acc_t = hetu::cpu::acc_type<spec_t>;
+  const acc_t bias1 = acc_t(1 - std::pow(beta1, float(step)));
+  const acc_t bias2 = std::sqrt(acc_t(1 - std::pow(beta2, float(step))));
+  const int64_t num_chunks = chunks.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic)
+#endif
+  for (int64_t c = 0; c < num_chunks; c++) {
+    const int64_t t = chunks[c].tensor;
+    const spec_t* g = grads[t];
+    spec_t* p = params[t];
+    float* w = masters.empty() ? nullptr : masters[t];
+    state_t* m = means[t];
+    state_t* v = variances[t];
+#ifdef _OPENMP
+#pragma omp simd
+#endif
+    for (int64_t i = chunks[c].begin; i < chunks[c].end; i++) {
+      acc_t grad = static_cast<acc_t>(g[i]) * coef;
+      acc_t weight = w ? static_cast<acc_t>(w[i]) : static_cast<acc_t>(p[i]);
+      acc_t mean = static_cast<acc_t>(m[i]) * beta1 + grad * (1 - beta1);
+      acc_t var =
+        static_cast<acc_t>(v[i]) * beta2 + grad * grad * (1 - beta2);
+      weight -= lr * ((mean / bias1) / (std::sqrt(var) / bias2 + eps) +
+                      weight_decay * weight);
+      m[i] = static_cast<state_t>(mean);
+      v[i] = static_cast<state_t>(var);
+      if (w)
+        w[i] = static_cast<float>(weight);
+      p[i] = static_cast<spec_t>(weight);
+    }
+  }
+}
+
+void CheckMultiTensorArgs(const NDArrayList& grads, const NDArrayList& params,
+                          const NDArrayList& master_params,
+                          const std::vector<const NDArrayList*>& states) {
+  HT_ASSERT(grads.size() == params.size())
+    << "Got " << grads.size() << " gradients for " << params.size()
+    << " parameters";
+  HT_ASSERT(master_params.empty() || master_params.size() == params.size())
+    << "Got " << master_params.size() << " master parameters for "
+    << params.size() << " parameters";
+  for (size_t t = 0; t < params.size(); t++) {
+    HT_ASSERT_CPU_DEVICE(params[t]);
+    HT_ASSERT_EXCHANGABLE(grads[t], params[t]);
+    HT_ASSERT(params[t]->is_contiguous() && grads[t]->is_contiguous())
+      << "Multi-tensor updates only support contiguous arrays";
+    HT_ASSERT(params[t]->dtype() == params[0]->dtype())
+      << "All parameters must have the same dtype, got "
+      << params[t]->dtype() << " and " << params[0]->dtype();
+    // States follow the master parameters if there are any.
+    const NDArray& ref = master_params.empty() ? params[t] : master_params[t];
+    if (!master_params.empty()) {
+      HT_ASSERT_CPU_DEVICE(ref);
+      HT_ASSERT(ref->dtype() == kFloat32 && ref->is_contiguous() &&
+                ref->numel() == params[t]->numel())
+        << "Master parameters must be contiguous float32 arrays of the "
+        << "same size as the parameters, got " << ref->meta();
+    }
+    for (const auto* state_list : states) {
+      HT_ASSERT(state_list->size() == params.size())
+        << "Got " << state_list->size() << " optimizer states for "
+        << params.size() << " parameters";
+      HT_ASSERT_EXCHANGABLE(state_list->at(t), ref);
+      HT_ASSERT(state_list->at(t)->is_contiguous())
+        << "Multi-tensor updates only support contiguous arrays";
+    }
+  }
+}
+
+inline void WriteFoundInf(const NDArray& found_inf, bool value) {
+  if (found_inf.is_defined())
+    found_inf->data_ptr<float>()[0] = value ? 1.f : 0.f;
+}
+
+} // namespace
+
+void MultiTensorSGDUpdateCpu(const NDArrayList& grads,
+                             const NDArrayList& params,
+                             const NDArrayList& master_params,
+                             const NDArrayList& velocities, float lr,
+                             float momentum, bool nesterov, float grad_scale,
+                             float max_grad_norm, NDArray& found_inf,
+                             const Stream& stream) {
+  std::vector<const NDArrayList*> states;
+  if (momentum != 0)
+    states.push_back(&velocities);
+  CheckMultiTensorArgs(grads, params, master_params, states);
+  if (params.empty())
+    return;
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(
+    params[0]->dtype(), spec_t, "MultiTensorSGDUpdateCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [grads, params, master_params, velocities, lr, momentum, nesterov,
+         grad_scale, max_grad_norm, found_inf]() {
+          auto chunks = MakeTensorChunks(params);
+          auto grad_ptrs = GetDataPtrs<spec_t>(grads);
+          bool skip;
+          float coef =
+            ComputeGradCoefficient(grad_ptrs, chunks, grad_scale,
+                                   max_grad_norm, found_inf.is_defined(), skip);
+          WriteFoundInf(found_inf, skip);
+          if (skip)
+            return;
+          NDArrayList no_states;
+          const auto& vels = momentum != 0 ? velocities : no_states;
+          if (master_params.empty()) {
+            multi_tensor_sgd_cpu<spec_t, spec_t>(
+              grad_ptrs, GetDataPtrs<spec_t>(params), {},
+              GetDataPtrs<spec_t>(vels), chunks, coef, lr, momentum,
+              nesterov);
+          } else {
+            multi_tensor_sgd_cpu<spec_t, float>(
+              grad_ptrs, GetDataPtrs<spec_t>(params),
+              GetDataPtrs<float>(master_params), GetDataPtrs<float>(vels),
+              chunks, coef, lr, momentum, nesterov);
+          }
+        },
+        "MultiTensorSGDUpdate");
+    });
+  NDArray::MarkUsedBy(grads, stream);
+  NDArray::MarkUsedBy(params, stream);
+  NDArray::MarkUsedBy(master_params, stream);
+  NDArray::MarkUsedBy(velocities, stream);
+  NDArray::MarkUsedBy({found_inf}, stream);
+}
+
+// Every parameter has its own step, as the update ops do, but all steps
+// must hold the same value. The first one is used for bias corrections.
+void MultiTensorAdamCpu(const NDArrayList& grads, const NDArrayList& params,
+                        const NDArrayList& master_params,
+                        const NDArrayList& means, const NDArrayList& variances,
+                        const NDArrayList& steps, float lr, float beta1,
+                        float beta2, float eps, float weight_decay,
+                        float grad_scale, float max_grad_norm,
+                        NDArray& found_inf, bool update_step,
+                        const Stream& stream) {
+  CheckMultiTensorArgs(grads, params, master_params, {&means, &variances});
+  HT_ASSERT(steps.size() == params.size())
+    << "Got " << steps.size() << " steps for " << params.size()
+    << " parameters";
+  for (const auto& step : steps) {
+    HT_ASSERT_CPU_DEVICE(step);
+    HT_ASSERT(step->dtype() == kInt64 && step->numel() == 1)
+      << "Step must be a single int64 value, got " << step->meta();
+  }
+  if (params.empty())
+    return;
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(
+    params[0]->dtype(), spec_t, "MultiTensorAdamCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [grads, params, master_params, means, variances, steps, lr, beta1,
+         beta2, eps, weight_decay, grad_scale, max_grad_norm, found_inf,
+         update_step]() {
+          auto chunks = MakeTensorChunks(params);
+          auto grad_ptrs = GetDataPtrs<spec_t>(grads);
+          bool skip;
+          float coef =
+            ComputeGradCoefficient(grad_ptrs, chunks, grad_scale,
+                                   max_grad_norm, found_inf.is_defined(), skip);
+          WriteFoundInf(found_inf, skip);
+          // Skipped steps do not count, as in GradScaler.
+          if (skip)
+            return;
+          int64_t step = steps[0]->data_ptr<int64_t>()[0];
+          if (master_params.empty()) {
+            multi_tensor_adam_cpu<spec_t, spec_t>(
+              grad_ptrs, GetDataPtrs<spec_t>(params), {},
+              GetDataPtrs<spec_t>(means), GetDataPtrs<spec_t>(variances),
+              chunks, coef, step, lr, beta1, beta2, eps, weight_decay);
+          } else {
+            multi_tensor_adam_cpu<spec_t, float>(
+              grad_ptrs, GetDataPtrs<spec_t>(params),
+              GetDataPtrs<float>(master_params), GetDataPtrs<float>(means),
+              GetDataPtrs<float>(variances), chunks, coef, step, lr, beta1,
+              beta2, eps, weight_decay);
+          }
+          if (update_step) {
+            for (const auto& step_array : steps)
+              step_array->data_ptr<int64_t>()[0] = step + 1;
+          }
+        },
+        "MultiTensorAdam");
+    });
+  NDArray::MarkUsedBy(grads, stream);
+  NDArray::MarkUsedBy(params, stream);
+  NDArray::MarkUsedBy(master_params, stream);
+  NDArray::MarkUsedBy(means, stream);
+  NDArray::MarkUsedBy(variances, stream);
+  NDArray::MarkUsedBy(steps, stream);
+  NDArray::MarkUsedBy({found_inf}, stream);
+}
+
+} // namespace impl
+} // namespace hetu
@@ -18,7 +18,7 @@ void NormCpu(const NDArray& input, NDArray& output, int64_t dim, int64_t p, cons
   input->dtype(), spec_t, "NormCpu", [&]() {
     auto _future = cpu_stream.EnqueueTask(
     [stream, input, output, dim, p]() {
-      dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+      const auto& eng = hetu::cpu::GetDNNLEngine();
       auto dnnltype = hetu::cpu::dtype_to_dnnltype(input->dtype());
       dnnl::memory::dims in_shape = input->shape();
       dnnl::memory::dims in_stride = input->stride();
@@ -40,20 +40,17 @@ void NormCpu(const NDArray& input, NDArray& output, int64_t dim, int64_t p, cons
         hetu::cpu::read_from_dnnl_memory(output->data_ptr<spec_t>(), src_mem);
       else {
 
-        // Create primitive descriptor.
-        auto reduction_pd = dnnl::reduction::primitive_desc(
-                eng, dnnl::algorithm::reduction_norm_lp_sum, src_md, dst_md, float(p), float(0.f));
-
-        // Create the primitive.
-        auto reduction_prim = dnnl::reduction(reduction_pd);
+        // Create (or reuse) the primitive.
+        auto reduction = hetu::cpu::GetOrCreateDNNLReduction(
+                dnnl::algorithm::reduction_norm_lp_sum, src_md, dst_md, float(p));
 
         // Primitive arguments.
         std::unordered_map<int, dnnl::memory> reduction_args;
         reduction_args.insert({DNNL_ARG_SRC, src_mem});
         reduction_args.insert({DNNL_ARG_DST, dst_mem});
 
-        dnnl::stream engine_stream(eng);
-        reduction_prim.execute(engine_stream, reduction_args);
+        auto& engine_stream = hetu::cpu::GetDNNLStream();
+        reduction->prim.execute(engine_stream, reduction_args);
         engine_stream.wait();
     }
   },"Norm");
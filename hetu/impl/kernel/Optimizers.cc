@@ -88,20 +88,23 @@ void SGDUpdateCpu(const NDArray& grad, NDArray& param, NDArray& velocity,
  NDArray::MarkUsedBy({grad, param, velocity}, stream);
 }
 
+// Weights are decayed decoupled from the gradient, as in AdamW, like the
+// sparse update below does for the listed rows.
 template <typename spec_t>
 void adam_update_cpu(const spec_t* grad, spec_t* param, spec_t* mean,
                      spec_t* variance, int64_t step, float lr, float beta1, 
                      float beta2, float eps, float weight_decay, size_t size) {
+  spec_t bias1 = spec_t(1 - std::pow(beta1, float(step)));
+  spec_t bias2 = std::sqrt(spec_t(1 - std::pow(beta2, float(step))));
 #ifdef _OPENMP
 #pragma omp parallel for schedule(static)
 #endif
   for (size_t idx = 0; idx < size; idx++) {
     mean[idx] = mean[idx] * beta1 + grad[idx] * (1 - beta1);
-    variance[idx] = variance[idx] * beta2 + grad[idx] * (1 - beta2);
-    spec_t bias1 = spec_t(1 - std::pow(beta1, float(step)));
-    spec_t bias2 = std::sqrt(spec_t(1 - std::pow(beta2, float(step))));
-    param[idx] -= lr * (mean[idx] / bias1) / 
-                  (std::sqrt(variance[idx]) / bias2 + eps);
+    variance[idx] = variance[idx] * beta2 + grad[idx] * grad[idx] * (1 - beta2);
+    param[idx] -= lr * ((mean[idx] / bias1) /
+                          (std::sqrt(variance[idx]) / bias2 + eps) +
+                        weight_decay * param[idx]);
   }
 }
 
@@ -126,16 +129,167 @@ void AdamCpu(const NDArray& grad, NDArray& param, NDArray& mean,
   CPUStream cpu_stream(stream);
   HT_DISPATCH_FLOATING_TYPES(param->dtype(), spec_t, "AdamUpdateCpu", [&]() {
     auto _future = cpu_stream.EnqueueTask(
-    [grad, param, mean, variance, lr, beta1, beta2, weight_decay, eps, step, size]() {
+    [grad, param, mean, variance, lr, beta1, beta2, weight_decay, eps, step,
+     update_step, size]() {
       adam_update_cpu<spec_t>(
             grad->data_ptr<spec_t>(), param->data_ptr<spec_t>(), 
             mean->data_ptr<spec_t>(), variance->data_ptr<spec_t>(), 
             step->data_ptr<int64_t>()[0], lr, beta1, beta2, eps, weight_decay, size);      
+      // in place, so that the step variable advances
+      if (update_step)
+        step->data_ptr<int64_t>()[0]++;
     },"Adam");
   });
-  if (update_step)
-    step = NDArray::add(step, 1, kBlockingStream);
-  NDArray::MarkUsedBy({grad, param, mean, variance}, stream);
+  NDArray::MarkUsedBy({grad, param, mean, variance, step}, stream);
+}
+
+// Sparse updates with gradients as indexed slices (see
+// EmbeddingLookupSparseGradientCpu): row k of `grad_values` is the gradient
+// of row unique_ids[k] of `param`, and negative ids are padding. Only the
+// listed rows of the parameter and its states are read or written, and the
+// states of the other rows are left as is (i.e., lazy momentum and Adam).
+// Ids are distinct, so rows are updated in parallel without conflicts.
+// Adam decays the weights of the listed rows only, decoupled from the
+// gradient as in AdamW.
+template <typename spec_t>
+void sgd_update_indexed_slices_cpu(const int64_t* ids, const spec_t* grad,
+                                   spec_t* param, spec_t* velocity, float lr,
+                                   float momentum, bool nesterov,
+                                   int64_t num_ids, int64_t length) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int64_t k = 0; k < num_ids; k++) {
+    if (ids[k] < 0)
+      continue;
+    const spec_t* g = grad + k * length;
+    spec_t* p = param + ids[k] * length;
+    spec_t* v = velocity == nullptr ? nullptr : velocity + ids[k] * length;
+    for (int64_t i = 0; i < length; i++) {
+      if (momentum == 0) {
+        p[i] -= lr * g[i];
+      } else if (!nesterov) {
+        v[i] = momentum * v[i] - lr * g[i];
+        p[i] = p[i] + v[i];
+      } else {
+        float temp = lr * g[i];
+        v[i] = momentum * (v[i] - temp);
+        p[i] = p[i] + v[i] - temp;
+      }
+    }
+  }
+}
+
+template <typename spec_t>
+void adam_update_indexed_slices_cpu(const int64_t* ids, const spec_t* grad,
+                                    spec_t* param, spec_t* mean,
+                                    spec_t* variance, int64_t step, float lr,
+                                    float beta1, float beta2, float eps,
+                                    float weight_decay, int64_t num_ids,
+                                    int64_t length) {
+  spec_t bias1 = spec_t(1 - std::pow(beta1, float(step)));
+  spec_t bias2 = std::sqrt(spec_t(1 - std::pow(beta2, float(step))));
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int64_t k = 0; k < num_ids; k++) {
+    if (ids[k] < 0)
+      continue;
+    int64_t offset = ids[k] * length;
+    const spec_t* g = grad + k * length;
+    for (int64_t i = 0; i < length; i++) {
+      spec_t& m = mean[offset + i];
+      spec_t& v = variance[offset + i];
+      m = m * beta1 + g[i] * (1 - beta1);
+      v = v * beta2 + g[i] * g[i] * (1 - beta2);
+      spec_t& p = param[offset + i];
+      p -= lr * ((m / bias1) / (std::sqrt(v) / bias2 + eps) +
+                 weight_decay * p);
+    }
+  }
+}
+
+inline void CheckIndexedSlices(const NDArray& unique_ids,
+                               const NDArray& grad_values,
+                               const NDArray& param) {
+  HT_ASSERT_CPU_DEVICE(param);
+  HT_ASSERT_SAME_DEVICE(param, unique_ids);
+  HT_ASSERT_SAME_DEVICE(param, grad_values);
+  HT_ASSERT_SAME_DTYPE(param, grad_values);
+  HT_ASSERT(unique_ids->dtype() == kInt64)
+    << "Ids must be int64, got " << unique_ids->dtype();
+  HT_ASSERT(param->ndim() == 2 && param->is_contiguous() &&
+            grad_values->is_contiguous() && unique_ids->is_contiguous())
+    << "Sparse updates only support contiguous 2-D parameters.";
+  HT_ASSERT(grad_values->numel() == unique_ids->numel() * param->shape(1))
+    << "Shapes mismatched: unique_ids " << unique_ids->shape()
+    << ", grad_values " << grad_values->shape() << ", param "
+    << param->shape();
+}
+
+void SGDUpdateIndexedSlicesCpu(const NDArray& unique_ids,
+                               const NDArray& grad_values, NDArray& param,
+                               NDArray& velocity, float lr, float momentum,
+                               bool nesterov, const Stream& stream) {
+  CheckIndexedSlices(unique_ids, grad_values, param);
+  if (momentum != 0) {
+    HT_ASSERT_CPU_DEVICE(velocity);
+    HT_ASSERT_EXCHANGABLE(velocity, param);
+  }
+  int64_t num_ids = unique_ids->numel();
+  int64_t length = param->shape(1);
+  if (num_ids == 0 || length == 0)
+    return;
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(
+    param->dtype(), spec_t, "SGDUpdateIndexedSlicesCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [unique_ids, grad_values, param, velocity, lr, momentum, nesterov,
+         num_ids, length]() {
+          sgd_update_indexed_slices_cpu<spec_t>(
+            unique_ids->data_ptr<int64_t>(), grad_values->data_ptr<spec_t>(),
+            param->data_ptr<spec_t>(),
+            momentum == 0 ? nullptr : velocity->data_ptr<spec_t>(), lr,
+            momentum, nesterov, num_ids, length);
+        },
+        "SGDUpdateIndexedSlices");
+    });
+  NDArray::MarkUsedBy({unique_ids, grad_values, param, velocity}, stream);
+}
+
+void AdamUpdateIndexedSlicesCpu(const NDArray& unique_ids,
+                                const NDArray& grad_values, NDArray& param,
+                                NDArray& mean, NDArray& variance,
+                                NDArray& step, float lr, float beta1,
+                                float beta2, float eps, float weight_decay,
+                                bool update_step, const Stream& stream) {
+  CheckIndexedSlices(unique_ids, grad_values, param);
+  HT_ASSERT_CPU_DEVICE(mean);
+  HT_ASSERT_CPU_DEVICE(variance);
+  HT_ASSERT_EXCHANGABLE(param, mean);
+  HT_ASSERT_EXCHANGABLE(param, variance);
+  int64_t num_ids = unique_ids->numel();
+  int64_t length = param->shape(1);
+  if (num_ids == 0 || length == 0)
+    return;
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(
+    param->dtype(), spec_t, "AdamUpdateIndexedSlicesCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [unique_ids, grad_values, param, mean, variance, step, lr, beta1,
+         beta2, eps, weight_decay, update_step, num_ids, length]() {
+          adam_update_indexed_slices_cpu<spec_t>(
+            unique_ids->data_ptr<int64_t>(), grad_values->data_ptr<spec_t>(),
+            param->data_ptr<spec_t>(), mean->data_ptr<spec_t>(),
+            variance->data_ptr<spec_t>(), step->data_ptr<int64_t>()[0], lr,
+            beta1, beta2, eps, weight_decay, num_ids, length);
+          if (update_step)
+            step->data_ptr<int64_t>()[0]++;
+        },
+        "AdamUpdateIndexedSlices");
+    });
+  NDArray::MarkUsedBy({unique_ids, grad_values, param, mean, variance, step},
+                      stream);
 }
 
 } // namespace impl
@@ -164,8 +164,10 @@ void AdamCuda(const NDArray& grad, NDArray& param, NDArray& mean,
                                             auto update_variance = variance * beta2 + grad * grad * (1 - beta2);
                                             spec_t bias1 = spec_t(1 - hetu::cuda::cuda_pow(beta1, float(cur_step)));
                                             spec_t bias2 = hetu::cuda::cuda_sqrt(spec_t(1 - hetu::cuda::cuda_pow(beta2, float(cur_step))));
-                                            auto update_param = param - (lr * (update_mean / bias1) / 
-                                                      (hetu::cuda::cuda_sqrt(update_variance) / bias2 + eps));
+                                            // decoupled weight decay as in AdamW, same as the CPU kernels
+                                            auto update_param = param - lr * ((update_mean / bias1) / 
+                                                      (hetu::cuda::cuda_sqrt(update_variance) / bias2 + eps) +
+                                                      weight_decay * param);
                                             return thrust::tuple<spec_t, spec_t, spec_t>{
                                               update_param,
                                               update_mean,
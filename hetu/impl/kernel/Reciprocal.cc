@@ -31,22 +31,21 @@ void ReciprocalCpu(const NDArray& input, NDArray& output,
     input->dtype(), spec_t, "ReciprocalCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
         [stream, input, output]() {
-        dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+        const auto& eng = hetu::cpu::GetDNNLEngine();
         auto dnnltype = hetu::cpu::dtype_to_dnnltype(input->dtype());
         auto mat_md = dnnl::memory::desc(input->shape(), dnnl::memory::data_type::f32, input->stride());
         auto src_mem = dnnl::memory(mat_md, eng, input->data_ptr<spec_t>());
         auto dst_mem = dnnl::memory(mat_md, eng, output->data_ptr<spec_t>());
 
-        auto Reciprocal_pd = dnnl::eltwise_forward::primitive_desc(eng, dnnl::prop_kind::forward_training,
-                            dnnl::algorithm::eltwise_pow, mat_md, mat_md, float(1.0), float(-1.f));
-        auto Reciprocal = dnnl::eltwise_forward(Reciprocal_pd);
+        auto Reciprocal = hetu::cpu::GetOrCreateDNNLEltwise(
+                          dnnl::algorithm::eltwise_pow, mat_md, mat_md, float(1.0), float(-1.f));
 
         std::unordered_map<int, dnnl::memory> reciprocal_args;
         reciprocal_args.insert({DNNL_ARG_SRC, src_mem});
         reciprocal_args.insert({DNNL_ARG_DST, dst_mem});      
 
-          dnnl::stream engine_stream(eng);
-          Reciprocal.execute(engine_stream, reciprocal_args);
+          auto& engine_stream = hetu::cpu::GetDNNLStream();
+          Reciprocal->prim.execute(engine_stream, reciprocal_args);
           engine_stream.wait();
         },"Reciprocal");
     });
@@ -2,20 +2,440 @@
 #include "hetu/core/stream.h"
 #include "hetu/impl/stream/CPUStream.h"
 #include "hetu/impl/utils/common_utils.h"
+#include "hetu/impl/utils/cpu_math.h"
 #include "hetu/impl/utils/dnnl_utils.h"
 #include "hetu/impl/utils/omp_utils.h"
+#include <algorithm>
+#include <limits>
 
 namespace hetu {
 namespace impl {
 
+namespace {
+
+// Independent accumulators per contiguous run, so that the compiler can
+// keep them in vector registers.
+constexpr int kReduceLanes = 32;
+// Output elements accumulated together when reducing over outer dims.
+constexpr int64_t kReduceColumnTile = 1024;
+// Minimum number of reduced elements per thread when a single output
+// element is reduced by several threads.
+constexpr int64_t kReduceSplitGrain = 32768;
+
+template <typename acc_t>
+struct SumOp {
+  static inline acc_t identity() {
+    return acc_t(0);
+  }
+  inline acc_t operator()(acc_t a, acc_t b) const {
+    return a + b;
+  }
+  static inline acc_t project(acc_t acc, int64_t) {
+    return acc;
+  }
+};
+
+template <typename acc_t>
+struct MeanOp : SumOp<acc_t> {
+  static inline acc_t project(acc_t acc, int64_t num_reduced) {
+    if (std::is_integral<acc_t>::value && num_reduced == 0)
+      return acc_t(0);
+    return acc / static_cast<acc_t>(num_reduced);
+  }
+};
+
+template <typename acc_t>
+struct ProdOp {
+  static inline acc_t identity() {
+    return acc_t(1);
+  }
+  inline acc_t operator()(acc_t a, acc_t b) const {
+    return a * b;
+  }
+  static inline acc_t project(acc_t acc, int64_t) {
+    return acc;
+  }
+};
+
+// Max and min propagate NaNs, as the CUDA kernels do.
+template <typename acc_t>
+struct MaxOp {
+  static inline acc_t identity() {
+    return std::numeric_limits<acc_t>::has_infinity
+      ? -std::numeric_limits<acc_t>::infinity()
+      : std::numeric_limits<acc_t>::lowest();
+  }
+  inline acc_t operator()(acc_t a, acc_t b) const {
+    return (a != a || a > b) ? a : b;
+  }
+  static inline acc_t project(acc_t acc, int64_t) {
+    return acc;
+  }
+};
+
+template <typename acc_t>
+struct MinOp {
+  static inline acc_t identity() {
+    return std::numeric_limits<acc_t>::has_infinity
+      ? std::numeric_limits<acc_t>::infinity()
+      : std::numeric_limits<acc_t>::max();
+  }
+  inline acc_t operator()(acc_t a, acc_t b) const {
+    return (a != a || a < b) ? a : b;
+  }
+  static inline acc_t project(acc_t acc, int64_t) {
+    return acc;
+  }
+};
+
+// Input dims split into the kept ones (outermost first, in the order of the
+// contiguous output) and the reduced ones (sorted by decreasing stride).
+// Size-1 dims are dropped and adjacent dims are coalesced when possible.
+struct ReduceLayout {
+  HTShape keep_shape;
+  HTStride keep_stride;
+  HTShape red_shape;
+  HTStride red_stride;
+  int64_t num_outputs{1};
+  int64_t num_reduced{1};
+};
+
+void CoalesceDims(HTShape& shape, HTStride& stride) {
+  if (shape.empty())
+    return;
+  size_t j = 0;
+  for (size_t i = 1; i < shape.size(); i++) {
+    if (stride[j] == shape[i] * stride[i]) {
+      shape[j] *= shape[i];
+      stride[j] = stride[i];
+    } else {
+      j++;
+      shape[j] = shape[i];
+      stride[j] = stride[i];
+    }
+  }
+  shape.resize(j + 1);
+  stride.resize(j + 1);
+}
+
+ReduceLayout MakeReduceLayout(const HTShape& shape, const HTStride& stride,
+                              const HTAxes& axes) {
+  ReduceLayout layout;
+  std::vector<bool> reduced(shape.size(), false);
+  for (auto axis : axes)
+    reduced[axis] = true;
+  std::vector<std::pair<int64_t, int64_t>> red_dims;
+  for (size_t i = 0; i < shape.size(); i++) {
+    int64_t size = shape[i];
+    if (reduced[i])
+      layout.num_reduced *= size;
+    else
+      layout.num_outputs *= size;
+    if (size == 1)
+      continue;
+    if (reduced[i]) {
+      red_dims.emplace_back(size, stride[i]);
+    } else {
+      layout.keep_shape.push_back(size);
+      layout.keep_stride.push_back(stride[i]);
+    }
+  }
+  // The order of reduced dims does not matter, so visit them in memory order.
+  std::stable_sort(red_dims.begin(), red_dims.end(),
+                   [](const std::pair<int64_t, int64_t>& a,
+                      const std::pair<int64_t, int64_t>& b) {
+                     return a.second > b.second;
+                   });
+  for (const auto& dim : red_dims) {
+    layout.red_shape.push_back(dim.first);
+    layout.red_stride.push_back(dim.second);
+  }
+  CoalesceDims(layout.keep_shape, layout.keep_stride);
+  CoalesceDims(layout.red_shape, layout.red_stride);
+  return layout;
+}
+
+// Combines `num` elements that are `stride` apart.
+template <typename spec_t, typename acc_t, typename op_t>
+inline acc_t ReduceRun(const spec_t* ptr, int64_t num, int64_t stride,
+                       const op_t& op) {
+  acc_t lanes[kReduceLanes];
+  for (int l = 0; l < kReduceLanes; l++)
+    lanes[l] = op_t::identity();
+  int64_t i = 0;
+  if (stride == 1) {
+    for (; i + kReduceLanes <= num; i += kReduceLanes) {
+#pragma omp simd
+      for (int l = 0; l < kReduceLanes; l++)
+        lanes[l] = op(lanes[l], static_cast<acc_t>(ptr[i + l]));
+    }
+  } else {
+    for (; i + kReduceLanes <= num; i += kReduceLanes)
+      for (int l = 0; l < kReduceLanes; l++)
+        lanes[l] = op(lanes[l], static_cast<acc_t>(ptr[(i + l) * stride]));
+  }
+  for (; i < num; i++)
+    lanes[0] = op(lanes[0], static_cast<acc_t>(ptr[i * stride]));
+  acc_t acc = lanes[0];
+  for (int l = 1; l < kReduceLanes; l++)
+    acc = op(acc, lanes[l]);
+  return acc;
+}
+
+// Combines the reduced elements [begin, end) (in row-major order of the
+// reduced dims) of the output element located at `base`.
+template <typename spec_t, typename acc_t, typename op_t>
+acc_t ReduceRange(const spec_t* base, const ReduceLayout& layout,
+                  int64_t begin, int64_t end, const op_t& op) {
+  const auto& shape = layout.red_shape;
+  const auto& stride = layout.red_stride;
+  if (begin >= end)
+    return op_t::identity();
+  if (shape.empty())
+    return static_cast<acc_t>(*base);
+  int64_t ndim = shape.size();
+  int64_t inner_size = shape[ndim - 1];
+  int64_t inner_stride = stride[ndim - 1];
+  HTShape index(ndim - 1);
+  int64_t offset = 0;
+  int64_t rest = begin / inner_size;
+  for (int64_t d = ndim - 2; d >= 0; d--) {
+    index[d] = rest % shape[d];
+    rest /= shape[d];
+    offset += index[d] * stride[d];
+  }
+  acc_t acc = op_t::identity();
+  int64_t inner_begin = begin % inner_size;
+  while (begin < end) {
+    int64_t num = std::min(inner_size - inner_begin, end - begin);
+    acc = op(acc, ReduceRun<spec_t, acc_t>(
+                    base + offset + inner_begin * inner_stride, num,
+                    inner_stride, op));
+    begin += num;
+    inner_begin = 0;
+    for (int64_t d = ndim - 2; d >= 0; d--) {
+      offset += stride[d];
+      if (++index[d] < shape[d])
+        break;
+      offset -= index[d] * stride[d];
+      index[d] = 0;
+    }
+  }
+  return acc;
+}
+
+// Each output element is reduced by a single thread.
+template <typename spec_t, typename acc_t, typename op_t>
+void ReduceRowsCpu(const spec_t* input, spec_t* output,
+                   const ReduceLayout& layout, const op_t& op) {
+  int64_t out_ndim = layout.keep_shape.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int64_t idx = 0; idx < layout.num_outputs; idx++) {
+    const spec_t* base = input +
+      get_index(idx, out_ndim, layout.keep_stride.data(),
+                layout.keep_shape.data());
+    acc_t acc = ReduceRange<spec_t, acc_t>(base, layout, 0,
+                                           layout.num_reduced, op);
+    output[idx] = static_cast<spec_t>(op_t::project(acc, layout.num_reduced));
+  }
+}
+
+// The innermost kept dim is contiguous, so a tile of output elements is
+// accumulated together while walking over the reduced dims.
+template <typename spec_t, typename acc_t, typename op_t>
+void ReduceColumnsCpu(const spec_t* input, spec_t* output,
+                      const ReduceLayout& layout, const op_t& op) {
+  int64_t outer_ndim = layout.keep_shape.size() - 1;
+  int64_t inner_size = layout.keep_shape[outer_ndim];
+  int64_t num_tiles = DIVUP(inner_size, kReduceColumnTile);
+  int64_t num_tasks = (layout.num_outputs / inner_size) * num_tiles;
+  const auto& red_shape = layout.red_shape;
+  const auto& red_stride = layout.red_stride;
+  int64_t red_ndim = red_shape.size();
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int64_t task = 0; task < num_tasks; task++) {
+    int64_t outer = task / num_tiles;
+    int64_t begin = (task % num_tiles) * kReduceColumnTile;
+    int64_t num = std::min(kReduceColumnTile, inner_size - begin);
+    const spec_t* base = input + begin +
+      get_index(outer, outer_ndim, layout.keep_stride.data(),
+                layout.keep_shape.data());
+    acc_t acc[kReduceColumnTile];
+    for (int64_t j = 0; j < num; j++)
+      acc[j] = op_t::identity();
+    HTShape index(red_ndim, 0);
+    int64_t offset = 0;
+    for (int64_t r = 0; r < layout.num_reduced; r++) {
+      const spec_t* ptr = base + offset;
+#pragma omp simd
+      for (int64_t j = 0; j < num; j++)
+        acc[j] = op(acc[j], static_cast<acc_t>(ptr[j]));
+      for (int64_t d = red_ndim - 1; d >= 0; d--) {
+        offset += red_stride[d];
+        if (++index[d] < red_shape[d])
+          break;
+        offset -= index[d] * red_stride[d];
+        index[d] = 0;
+      }
+    }
+    spec_t* out = output + outer * inner_size + begin;
+    for (int64_t j = 0; j < num; j++)
+      out[j] = static_cast<spec_t>(op_t::project(acc[j], layout.num_reduced));
+  }
+}
+
+// Too few output elements to keep all threads busy, so each of them is
+// reduced by all threads into per-chunk partial results.
+template <typename spec_t, typename acc_t, typename op_t>
+void ReduceSplitCpu(const spec_t* input, spec_t* output,
+                    const ReduceLayout& layout, int num_threads,
+                    const op_t& op) {
+  int64_t out_ndim = layout.keep_shape.size();
+  int64_t num_chunks = std::min<int64_t>(
+    num_threads, DIVUP(layout.num_reduced, kReduceSplitGrain));
+  int64_t chunk_size = DIVUP(layout.num_reduced, num_chunks);
+  std::vector<acc_t> partials(num_chunks);
+  for (int64_t idx = 0; idx < layout.num_outputs; idx++) {
+    const spec_t* base = input +
+      get_index(idx, out_ndim, layout.keep_stride.data(),
+                layout.keep_shape.data());
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+    for (int64_t c = 0; c < num_chunks; c++) {
+      int64_t begin = c * chunk_size;
+      int64_t end = std::min(begin + chunk_size, layout.num_reduced);
+      partials[c] = ReduceRange<spec_t, acc_t>(base, layout, begin, end, op);
+    }
+    acc_t acc = op_t::identity();
+    for (int64_t c = 0; c < num_chunks; c++)
+      acc = op(acc, partials[c]);
+    output[idx] = static_cast<spec_t>(op_t::project(acc, layout.num_reduced));
+  }
+}
+
+template <typename spec_t, typename acc_t, typename op_t>
+void reduce_cpu(const spec_t* input, spec_t* output,
+                const ReduceLayout& layout, const op_t& op) {
+  if (layout.num_outputs == 0)
+    return;
+  int num_threads = hetu::omp::OMP_GET_MAX_THREADS();
+  if (!layout.keep_shape.empty() && layout.keep_stride.back() == 1 &&
+      layout.keep_shape.back() >= kReduceLanes) {
+    ReduceColumnsCpu<spec_t, acc_t>(input, output, layout, op);
+  } else if (layout.num_outputs < num_threads &&
+             layout.num_reduced >= 2 * kReduceSplitGrain) {
+    ReduceSplitCpu<spec_t, acc_t>(input, output, layout, num_threads, op);
+  } else {
+    ReduceRowsCpu<spec_t, acc_t>(input, output, layout, op);
+  }
+}
+
+template <template <typename> class op_t>
+void LaunchReduceCpu(const NDArray& input, NDArray& output,
+                     const int64_t* axes, int64_t num_axes,
+                     const Stream& stream, const char* name) {
+  HT_ASSERT_CPU_DEVICE(input);
+  HT_ASSERT_SAME_DEVICE(input, output);
+  HT_ASSERT_SAME_DTYPE(input, output);
+  HT_ASSERT(output->is_contiguous())
+    << "Output of " << name << " must be contiguous";
+  HTAxes parsed_axes = NDArrayMeta::ParseAxes(HTAxes(axes, axes + num_axes),
+                                              input->ndim());
+  ReduceLayout layout =
+    MakeReduceLayout(input->shape(), input->stride(), parsed_axes);
+  HT_ASSERT_EQ(output->numel(), layout.num_outputs)
+    << "Output of " << name << " has " << output->numel()
+    << " elements, but " << layout.num_outputs << " are expected";
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
+    input->dtype(), spec_t, name, [&]() {
+      using acc_t = hetu::cpu::acc_type<spec_t>;
+      auto _future = cpu_stream.EnqueueTask(
+        [input, output, layout]() {
+          reduce_cpu<spec_t, acc_t>(input->data_ptr<spec_t>(),
+                                    output->data_ptr<spec_t>(), layout,
+                                    op_t<acc_t>());
+        },
+        name);
+    });
+  NDArray::MarkUsedBy({input, output}, stream);
+}
+
+} // namespace
+
+void ReduceMinCpu(const NDArray& input, NDArray& output, const int64_t* axes,
+                  int64_t num_axes, const Stream& stream) {
+  LaunchReduceCpu<MinOp>(input, output, axes, num_axes, stream,
+                         "ReduceMinCpu");
+}
+
+void ReduceMaxCpu(const NDArray& input, NDArray& output, const int64_t* axes,
+                  int64_t num_axes, const Stream& stream) {
+  LaunchReduceCpu<MaxOp>(input, output, axes, num_axes, stream,
+                         "ReduceMaxCpu");
+}
+
+void ReduceMeanCpu(const NDArray& input, NDArray& output, const int64_t* axes,
+                   int64_t num_axes, const Stream& stream) {
+  LaunchReduceCpu<MeanOp>(input, output, axes, num_axes, stream,
+                          "ReduceMeanCpu");
+}
+
+void ReduceSumCpu(const NDArray& input, NDArray& output, const int64_t* axes,
+                  int64_t num_axes, const Stream& stream) {
+  LaunchReduceCpu<SumOp>(input, output, axes, num_axes, stream,
+                         "ReduceSumCpu");
+}
+
+void ReduceProdCpu(const NDArray& input, NDArray& output, const int64_t* axes,
+                   int64_t num_axes, const Stream& stream) {
+  LaunchReduceCpu<ProdOp>(input, output, axes, num_axes, stream,
+                          "ReduceProdCpu");
+}
+
 void ReduceCpu(const NDArray& input, NDArray& output, const HTAxes& axes,
-                ReductionType red_type, const Stream& stream) {
+               ReductionType red_type, const Stream& stream) {
+  switch (red_type) {
+    case kSUM:
+      ReduceSumCpu(input, output, axes.data(), axes.size(), stream);
+      break;
+    case kMEAN:
+      ReduceMeanCpu(input, output, axes.data(), axes.size(), stream);
+      break;
+    case kMAX:
+      ReduceMaxCpu(input, output, axes.data(), axes.size(), stream);
+      break;
+    case kMIN:
+      ReduceMinCpu(input, output, axes.data(), axes.size(), stream);
+      break;
+    case kPROD:
+      ReduceProdCpu(input, output, axes.data(), axes.size(), stream);
+      break;
+    case kNONE:
+      HT_NOT_IMPLEMENTED << "Reduction type cannot be none";
+      __builtin_unreachable();
+    default:
+      HT_VALUE_ERROR << "Unknown reduction type: "
+                     << static_cast<int32_t>(red_type);
+      __builtin_unreachable();
+  }
+}
+
+// The former oneDNN-based implementation, which only supports SUM and MEAN.
+// It is kept as a baseline to benchmark the kernels above against.
+void DNNLReduceCpu(const NDArray& input, NDArray& output, const HTAxes& axes,
+                   ReductionType red_type, const Stream& stream) {
   HT_ASSERT_CPU_DEVICE(input);
   HT_ASSERT_SAME_DEVICE(input, output);
   CPUStream cpu_stream(stream);
   HTAxes parsed_axes = NDArrayMeta::ParseAxes(axes, input->ndim());
   HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
-  input->dtype(), spec_t, "ReduceCpu", [&]() {
+  input->dtype(), spec_t, "DNNLReduceCpu", [&]() {
     dnnl::memory::dims in_shape = input->shape();
     dnnl::memory::dims in_stride = input->stride();
     dnnl::memory::dims out_shape = input->shape();
@@ -30,7 +450,7 @@ void ReduceCpu(const NDArray& input, NDArray& output, const HTAxes& axes,
     }
     auto _future = cpu_stream.EnqueueTask(
       [input, output, in_shape, in_stride, out_shape, out_stride, red_type]() {
-        dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+        const auto& eng = hetu::cpu::GetDNNLEngine();
         auto dnnltype = hetu::cpu::dtype_to_dnnltype(input->dtype());
         auto src_md = dnnl::memory::desc(in_shape, dnnltype, in_stride);
         auto dst_md = dnnl::memory::desc(out_shape, dnnltype, out_stride);
@@ -50,12 +470,9 @@ void ReduceCpu(const NDArray& input, NDArray& output, const HTAxes& axes,
           hetu::cpu::read_from_dnnl_memory(output->data_ptr<spec_t>(), src_mem);
         }
         else {
-          // Create primitive descriptor.
-          auto reduction_pd = dnnl::reduction::primitive_desc(
-                  eng, algo, src_md, dst_md, float(0.f), float(0.f));
-
-          // Create the primitive.
-          auto reduction_prim = dnnl::reduction(reduction_pd);
+          // Create (or reuse) the primitive.
+          auto reduction = hetu::cpu::GetOrCreateDNNLReduction(
+                  algo, src_md, dst_md);
 
           // Primitive arguments.
           std::unordered_map<int, dnnl::memory> reduction_args;
@@ -63,8 +480,8 @@ void ReduceCpu(const NDArray& input, NDArray& output, const HTAxes& axes,
           reduction_args.insert({DNNL_ARG_DST, dst_mem});
 
           // Primitive execution: Reduction (Sum).
-          dnnl::stream engine_stream(eng);
-          reduction_prim.execute(engine_stream, reduction_args);
+          auto& engine_stream = hetu::cpu::GetDNNLStream();
+          reduction->prim.execute(engine_stream, reduction_args);
           engine_stream.wait();
         } 
       },"Reduce"); 
@@ -72,21 +489,5 @@ void ReduceCpu(const NDArray& input, NDArray& output, const HTAxes& axes,
   NDArray::MarkUsedBy({input, output}, stream);
 }
 
-void ReduceMinCpu(const NDArray& input, NDArray& output, const int64_t* axes,
-                  int64_t num_axes, const Stream& stream) {
-}
-
-void ReduceMaxCpu(const NDArray& input, NDArray& output, const int64_t* axes,
-                  int64_t num_axes, const Stream& stream) { 
-}
-
-void ReduceMeanCpu(const NDArray& input, NDArray& output, const int64_t* axes,
-                   int64_t num_axes, const Stream& stream) {
-}
-
-void ReduceSumCpu(const NDArray& input, NDArray& output, const int64_t* axes,
-                  int64_t num_axes, const Stream& stream) {
-}
-
 } // namespace impl
 } // namespace hetu
@@ -80,28 +80,25 @@ void ReluCpu(const NDArray& input, NDArray& output, const Stream& stream) {
   if (size == 0)
     return;
   CPUStream cpu_stream(stream);
-  dnnl::engine eng(dnnl::engine::kind::cpu, 0);
-  dnnl::stream engine_stream(eng);
   HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
     input->dtype(), spec_t, "ReluCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
         [stream, input, output]() {
-          dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+          const auto& eng = hetu::cpu::GetDNNLEngine();
           auto dnnltype = hetu::cpu::dtype_to_dnnltype(input->dtype());
           auto mat_md = dnnl::memory::desc(input->shape(), dnnltype, input->stride());
           auto src_mem = dnnl::memory(mat_md, eng, input->data_ptr<spec_t>());
           auto dst_mem = dnnl::memory(mat_md, eng, output->data_ptr<spec_t>());
 
-          auto Relu_pd = dnnl::eltwise_forward::primitive_desc(eng, dnnl::prop_kind::forward_training,
-                              dnnl::algorithm::eltwise_relu, mat_md, mat_md, float(0.0), float(0.0));
-          auto Relu = dnnl::eltwise_forward(Relu_pd);
+          auto Relu = hetu::cpu::GetOrCreateDNNLEltwise(
+                            dnnl::algorithm::eltwise_relu, mat_md, mat_md, float(0.0), float(0.0));
 
           std::unordered_map<int, dnnl::memory> relu_args;
           relu_args.insert({DNNL_ARG_SRC, src_mem});
           relu_args.insert({DNNL_ARG_DST, dst_mem});     
 
-          dnnl::stream engine_stream(eng);
-          Relu.execute(engine_stream, relu_args);
+          auto& engine_stream = hetu::cpu::GetDNNLStream();
+          Relu->prim.execute(engine_stream, relu_args);
           engine_stream.wait();
         },"Relu");
       
@@ -118,8 +115,6 @@ void ReluGradientCpu(const NDArray& input, const NDArray& output_grad,
   HT_ASSERT_EXCHANGABLE(input, input_grad);
 
   CPUStream cpu_stream(stream);
-  dnnl::engine eng(dnnl::engine::kind::cpu, 0);
-  dnnl::stream engine_stream(eng);
   size_t size = input_grad->numel();
   if (size == 0)
     return;
@@ -127,29 +122,24 @@ void ReluGradientCpu(const NDArray& input, const NDArray& output_grad,
     input->dtype(), spec_t, "ReluGradientCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
         [stream, input, output_grad, input_grad]() {
-          dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+          const auto& eng = hetu::cpu::GetDNNLEngine();
           auto dnnltype = hetu::cpu::dtype_to_dnnltype(input->dtype());
           auto mat_md = dnnl::memory::desc(input->shape(), dnnltype, input->stride());
           auto src_mem = dnnl::memory(mat_md, eng, input->data_ptr<spec_t>());
           auto g_dst_mem = dnnl::memory(mat_md, eng, output_grad->data_ptr<spec_t>());
           auto g_src_mem = dnnl::memory(mat_md, eng, input_grad->data_ptr<spec_t>());
 
-          auto Relu_pd = dnnl::eltwise_forward::primitive_desc(eng, dnnl::prop_kind::forward_training,
-                              dnnl::algorithm::eltwise_relu, mat_md, mat_md, float(0.0), float(0.0));
-
-          auto Relu_bwd_pd = dnnl::eltwise_backward::primitive_desc(eng,
-                dnnl::algorithm::eltwise_relu, mat_md, mat_md,
-                mat_md, float(0.0), float(0.0), Relu_pd);
-          
-          auto Relu_bwd = dnnl::eltwise_backward(Relu_bwd_pd);
+          auto Relu_bwd = hetu::cpu::GetOrCreateDNNLEltwiseBackward(
+                            dnnl::algorithm::eltwise_relu, mat_md, mat_md, mat_md,
+                            float(0.0), float(0.0));
 
           std::unordered_map<int, dnnl::memory> relu_args;
           relu_args.insert({DNNL_ARG_SRC, src_mem});
           relu_args.insert({DNNL_ARG_DIFF_DST, g_dst_mem});      
           relu_args.insert({DNNL_ARG_DIFF_SRC, g_src_mem});  
         
-          dnnl::stream engine_stream(eng);
-          Relu_bwd.execute(engine_stream, relu_args);
+          auto& engine_stream = hetu::cpu::GetDNNLStream();
+          Relu_bwd->prim.execute(engine_stream, relu_args);
           engine_stream.wait();
         },"ReluGradient");
     });
@@ -59,21 +59,20 @@ void SigmoidCpu(const NDArray& input, NDArray& output, const Stream& stream) {
     input->dtype(), spec_t, "SigmoidCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
         [stream, input, output]() {
-          dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+          const auto& eng = hetu::cpu::GetDNNLEngine();
           auto dnnltype = hetu::cpu::dtype_to_dnnltype(input->dtype());
           auto mat_md = dnnl::memory::desc(input->shape(), dnnltype, input->stride());
           auto src_mem = dnnl::memory(mat_md, eng, input->data_ptr<spec_t>());
           auto dst_mem = dnnl::memory(mat_md, eng, output->data_ptr<spec_t>());
 
-          auto Sigmoid_pd = dnnl::eltwise_forward::primitive_desc(eng, dnnl::prop_kind::forward_training,
-                              dnnl::algorithm::eltwise_logistic, mat_md, mat_md, float(0.0), float(0.0));
-          auto Sigmoid = dnnl::eltwise_forward(Sigmoid_pd);
+          auto Sigmoid = hetu::cpu::GetOrCreateDNNLEltwise(
+                            dnnl::algorithm::eltwise_logistic, mat_md, mat_md, float(0.0), float(0.0));
 
           std::unordered_map<int, dnnl::memory> sigmoid_args;
           sigmoid_args.insert({DNNL_ARG_SRC, src_mem});
           sigmoid_args.insert({DNNL_ARG_DST, dst_mem});
-          dnnl::stream engine_stream(eng);
-          Sigmoid.execute(engine_stream, sigmoid_args);
+          auto& engine_stream = hetu::cpu::GetDNNLStream();
+          Sigmoid->prim.execute(engine_stream, sigmoid_args);
           engine_stream.wait();
       }, "Sigmoid");   
     });
@@ -2,86 +2,35 @@
 #include "hetu/core/stream.h"
 #include "hetu/impl/utils/common_utils.h"
 #include "hetu/impl/utils/omp_utils.h"
+#include "hetu/impl/utils/strided_copy.h"
 #include "hetu/impl/stream/CPUStream.h"
 
 namespace hetu {
 namespace impl {
 
-// Out-of-place version of slice and its gradient
-/* It is replaced with in-place version. */
-template <typename spec_t>
-void slice_cpu(const spec_t* input, spec_t* output, const int64_t* output_shape,
-               const int64_t* input_shape, const int64_t* begin_pos,
-               size_t ndim, size_t size) {
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static)
-#endif
-  for (size_t idx = 0; idx < size; ++idx) {
-    size_t tmp_index = idx;
-    size_t i_index = 0;
-    int64_t i_mat = 1;
-    for (int i = ndim - 1; i >= 0; --i) {
-      int64_t offset = begin_pos[i] + tmp_index % output_shape[i];
-      tmp_index /= output_shape[i];
-      i_index += offset * i_mat;
-      i_mat *= input_shape[i];
-    }
-    output[idx] = input[i_index];
-  }
-}
-
-void slice_quantization(const uint8_t* input, uint8_t* output, const int64_t* output_shape,
-                        const int64_t* input_shape, const int64_t* begin_pos,
-                        size_t ndim, size_t size) {
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static)
-#endif
-  for (size_t idx = 0; idx < size / 2; ++idx) {
-    output[idx] = 0;
-  }
-  for (size_t idx = 0; idx < size; ++idx) {
-    size_t tmp_index = idx;
-    size_t i_index = 0;
-    int64_t i_mat = 1;
-    for (int i = ndim - 1; i >= 0; --i) {
-      int64_t offset = begin_pos[i] + tmp_index % output_shape[i];
-      tmp_index /= output_shape[i];
-      i_index += offset * i_mat;
-      i_mat *= input_shape[i];
-    }
-    int tmp = 0;
-    if (i_index % 2 == 0)
-      tmp = input[i_index / 2] >> 4;
-    else 
-      tmp = input[i_index / 2] & (0x0F);
-    if (idx % 2 == 0)
-      output[idx / 2] += (tmp << 4);
-    else 
-      output[idx / 2] += tmp;
-  }
+// 4-bit values are packed in pairs, high nibble first.
+void slice_quantization(const uint8_t* input, uint8_t* output,
+                        const HTShape& shape, const HTStride& in_stride,
+                        const HTStride& out_stride, int64_t in_offset,
+                        size_t size) {
+  std::memset(output, 0, DIVUP(size, 2));
+  auto layout = StridedLayout::Make(shape, in_stride, out_stride);
+  StridedForEachUnit(
+    layout.ndim, layout.shape, layout.src_stride, layout.dst_stride, size,
+    false, [&](int64_t, int64_t i_index, int64_t idx) {
+      i_index += in_offset;
+      int tmp = (i_index % 2 == 0) ? (input[i_index / 2] >> 4)
+                                   : (input[i_index / 2] & 0x0F);
+      output[idx / 2] |= (idx % 2 == 0) ? (tmp << 4) : tmp;
+    });
 }
 
-template <typename spec_t>
-void slice_gradient_cpu(const spec_t* input, spec_t* output,
-                        const int64_t* output_shape, const int64_t* input_shape,
-                        const int64_t* begin_pos, size_t ndim, size_t size) {
-#ifdef _OPENMP
-#pragma omp parallel for schedule(static)
-#endif
-  for (size_t idx = 0; idx < size; ++idx) {
-    output[idx] = 0;
-    size_t tmp_index = idx;
-    size_t i_index = 0;
-    int64_t i_mat = 1;
-    for (int i = ndim - 1; i >= 0; --i) {
-      int64_t offset = tmp_index % output_shape[i];
-      if (offset < begin_pos[i] || offset >= begin_pos[i] + input_shape[i]) {}
-      tmp_index /= output_shape[i];
-      i_index += (offset - begin_pos[i]) * i_mat;
-      i_mat *= input_shape[i];
-    }
-    output[idx] = input[i_index];
-  }
+// Offset of the element at `begin_pos` of an array with `stride`.
+static int64_t slice_offset(const HTShape& begin_pos, const HTStride& stride) {
+  int64_t offset = 0;
+  for (size_t i = 0; i < stride.size(); ++i)
+    offset += begin_pos[i] * stride[i];
+  return offset;
 }
 
 void SliceCpu(const NDArray& input, NDArray& output, const HTShape& begin_pos,
@@ -108,23 +57,25 @@ void SliceCpu(const NDArray& input, NDArray& output, const HTShape& begin_pos,
   if (size == 0)
     return;
   
-  HTShape pos = begin_pos;
-  HTShape i_shape = input->shape();
   HTShape o_shape = output->shape();
+  HTStride i_stride = input->stride();
+  HTStride o_stride = output->stride();
+  int64_t i_offset = slice_offset(begin_pos, i_stride);
   if (input->dtype() == kFloat4 || input->dtype() == kNFloat4) {
     auto _future = cpu_stream.EnqueueTask(
-        [input, output, o_shape, i_shape, pos, ndim, size]() {
+        [input, output, o_shape, i_stride, o_stride, i_offset, size]() {
         slice_quantization(input->data_ptr<uint8_t>(), output->data_ptr<uint8_t>(),
-                          o_shape.data(), i_shape.data(), pos.data(), ndim, size);
+                           o_shape, i_stride, o_stride, i_offset, size);
         }, "Slice");
   }
   else {
     HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
       input->dtype(), spec_t, "SliceCpu", [&]() {
         auto _future = cpu_stream.EnqueueTask(
-        [input, output, o_shape, i_shape, pos, ndim, size]() {
-        slice_cpu<spec_t>(input->data_ptr<spec_t>(), output->data_ptr<spec_t>(),
-                          o_shape.data(), i_shape.data(), pos.data(), ndim, size);
+        [input, output, o_shape, i_stride, o_stride, i_offset]() {
+        StridedCopy<spec_t>(input->data_ptr<spec_t>() + i_offset,
+                            output->data_ptr<spec_t>(), o_shape, i_stride,
+                            o_stride);
         }, "Slice");
       });
   }
@@ -155,16 +106,19 @@ void SliceGradientCpu(const NDArray& output_grad, NDArray& input_grad,
   if (size == 0)
     return;
   
-  HTShape pos = begin_pos;
-  HTShape i_shape = output_grad->shape();
-  HTShape o_shape = input_grad->shape();
+  // Zero the whole gradient and copy the output gradient into the slice.
+  HTShape o_shape = output_grad->shape();
+  HTStride o_stride = output_grad->stride();
+  HTStride i_stride = input_grad->stride();
+  int64_t i_offset = slice_offset(begin_pos, i_stride);
   HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
-    output_grad->dtype(), spec_t, "SliceGradientCuda", [&]() {
+    output_grad->dtype(), spec_t, "SliceGradientCpu", [&]() {
       cpu_stream.EnqueueTask(
-      [input_grad, output_grad, o_shape, i_shape, pos, ndim, size]() {
-      slice_gradient_cpu<spec_t>(
-        output_grad->data_ptr<spec_t>(), input_grad->data_ptr<spec_t>(),
-        o_shape.data(), i_shape.data(), pos.data(), ndim, size);
+      [input_grad, output_grad, o_shape, o_stride, i_stride, i_offset, size]() {
+      std::memset(input_grad->data_ptr<spec_t>(), 0, size * sizeof(spec_t));
+      StridedCopy<spec_t>(output_grad->data_ptr<spec_t>(),
+                          input_grad->data_ptr<spec_t>() + i_offset, o_shape,
+                          o_stride, i_stride);
       }, "SliceGradient");
     });
   NDArray::MarkUsedBy({output_grad, input_grad}, stream);
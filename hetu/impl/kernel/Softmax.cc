@@ -17,7 +17,7 @@ void SoftmaxCpu(const NDArray& input, NDArray& output, int64_t dim, const Stream
     input->dtype(), spec_t, "SoftmaxCuda", [&]() {
       auto _future = cpu_stream.EnqueueTask(
         [stream, input, output, dim]() {
-          dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+          const auto& eng = hetu::cpu::GetDNNLEngine();
           auto dnnltype = hetu::cpu::dtype_to_dnnltype(input->dtype());
           auto src_md = dnnl::memory::desc(input->shape(), dnnltype, input->stride());
           auto dst_md = dnnl::memory::desc(input->shape(), dnnltype, input->stride());
@@ -27,22 +27,18 @@ void SoftmaxCpu(const NDArray& input, NDArray& output, int64_t dim, const Stream
           // Softmax axis.
           const int axis = dim >= 0 ? dim : dim + input->ndim();
 
-          // Create primitive descriptor.
-          auto softmax_pd = dnnl::softmax_forward::primitive_desc(eng,
-                            dnnl::prop_kind::forward_training, 
-                            dnnl::algorithm::softmax_accurate, 
+          // Create (or reuse) the primitive.
+          auto softmax = hetu::cpu::GetOrCreateDNNLSoftmax(
+                            dnnl::algorithm::softmax_accurate,
                             src_md, dst_md, axis);
 
-          // Create the primitive.
-          auto softmax_prim = dnnl::softmax_forward(softmax_pd);
-
           // Primitive arguments. Set up in-place execution by assigning src as DST.
           std::unordered_map<int, dnnl::memory> softmax_args;
           softmax_args.insert({DNNL_ARG_SRC, src_mem});
           softmax_args.insert({DNNL_ARG_DST, dst_mem});
 
-          dnnl::stream engine_stream(eng);
-          softmax_prim.execute(engine_stream, softmax_args);
+          auto& engine_stream = hetu::cpu::GetDNNLStream();
+          softmax->prim.execute(engine_stream, softmax_args);
           engine_stream.wait();
         },"Softmax");
     });
@@ -60,7 +56,7 @@ void SoftmaxGradientCpu(const NDArray& input_Y, const NDArray& output_grad,
     input_Y->dtype(), spec_t, "SoftmaxGradientCuda", [&]() {
       auto _future = cpu_stream.EnqueueTask(
         [stream, input_Y, output_grad, input_grad, dim]() {
-          dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+          const auto& eng = hetu::cpu::GetDNNLEngine();
           auto dnnltype = hetu::cpu::dtype_to_dnnltype(input_Y->dtype());
           auto src_md = dnnl::memory::desc(input_Y->shape(), dnnltype, input_Y->stride());
           auto dst_md = dnnl::memory::desc(input_Y->shape(), dnnltype, input_Y->stride());
@@ -71,25 +67,18 @@ void SoftmaxGradientCpu(const NDArray& input_Y, const NDArray& output_grad,
           // Softmax axis.
           const int axis = dim;
 
-          // Create primitive descriptor.
-          auto softmax_pd = dnnl::softmax_forward::primitive_desc(eng,
-                            dnnl::prop_kind::forward_training, 
-                            dnnl::algorithm::softmax_accurate, 
-                            src_md, dst_md, axis);
-          
-          auto softmax_bwd_pd = dnnl::softmax_backward::primitive_desc(eng, dnnl::algorithm::softmax_accurate, 
-                                                                      src_md, dst_md, dst_md, axis, softmax_pd);
-
-          // Create the primitive.
-          auto softmax_prim = dnnl::softmax_backward(softmax_bwd_pd);
+          // Create (or reuse) the primitive.
+          auto softmax = hetu::cpu::GetOrCreateDNNLSoftmaxBackward(
+                            dnnl::algorithm::softmax_accurate,
+                            src_md, dst_md, dst_md, axis);
 
           // Primitive arguments. Set up in-place execution by assigning src as DST.
           std::unordered_map<int, dnnl::memory> softmax_args;
           softmax_args.insert({DNNL_ARG_DIFF_SRC, gsrc_mem});
           softmax_args.insert({DNNL_ARG_DIFF_DST, gdst_mem});
           softmax_args.insert({DNNL_ARG_DST, dst_mem});
-          dnnl::stream engine_stream(eng);
-          softmax_prim.execute(engine_stream, softmax_args);
+          auto& engine_stream = hetu::cpu::GetDNNLStream();
+          softmax->prim.execute(engine_stream, softmax_args);
           engine_stream.wait();
         },"SoftmaxGradient");
     });
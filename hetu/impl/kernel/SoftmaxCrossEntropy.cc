@@ -38,9 +38,9 @@ void SoftmaxCrossEntropyCpu(const NDArray& input, const NDArray& label,
     input->dtype(), spec_t, "SoftmaxCrossEntropyCuda", [&]() {
       cpu_stream.EnqueueTask(
         [input, label, output, workspace, stream, size]() {
-        dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+        const auto& eng = hetu::cpu::GetDNNLEngine();
         void* workspace_ptr = workspace->raw_data_ptr();
-        dnnl::stream engine_stream(eng);
+        auto& engine_stream = hetu::cpu::GetDNNLStream();
         auto dnnltype = hetu::cpu::dtype_to_dnnltype(input->dtype());
         auto src_md = dnnl::memory::desc(input->shape(), dnnltype, input->stride());
         auto dst_md = dnnl::memory::desc(input->shape(), dnnltype, input->stride());
@@ -49,19 +49,15 @@ void SoftmaxCrossEntropyCpu(const NDArray& input, const NDArray& label,
 
         // Softmax axis.
         const int axis = 1;
-        auto softmax_pd = dnnl::softmax_forward::primitive_desc(eng,
-                          dnnl::prop_kind::forward_training, 
-                          dnnl::algorithm::softmax_log, 
-                          src_md, dst_md, axis);
-
-        auto softmax_prim = dnnl::softmax_forward(softmax_pd);
+        auto softmax = hetu::cpu::GetOrCreateDNNLSoftmax(
+                          dnnl::algorithm::softmax_log, src_md, dst_md, axis);
 
         std::unordered_map<int, dnnl::memory> softmax_args;
         softmax_args.insert({DNNL_ARG_SRC, src_mem});
         softmax_args.insert({DNNL_ARG_DST, dst_mem});
 
         // Primitive execution.
-        softmax_prim.execute(engine_stream, softmax_args);
+        softmax->prim.execute(engine_stream, softmax_args);
         engine_stream.wait();
 
 
@@ -80,12 +76,9 @@ void SoftmaxCrossEntropyCpu(const NDArray& input, const NDArray& label,
         if (input->shape() == outshape)
           hetu::cpu::read_from_dnnl_memory(output->data_ptr<spec_t>(), rsrc_mem);
         else {
-          // Create primitive descriptor.
-          auto reduction_pd = dnnl::reduction::primitive_desc(
-                  eng, dnnl::algorithm::reduction_sum, rsrc_md, rdst_md, float(0.f), float(0.f));
-
-          // Create the primitive.
-          auto reduction_prim = dnnl::reduction(reduction_pd);
+          // Create (or reuse) the primitive.
+          auto reduction = hetu::cpu::GetOrCreateDNNLReduction(
+                  dnnl::algorithm::reduction_sum, rsrc_md, rdst_md);
 
           // Primitive arguments.
           std::unordered_map<int, dnnl::memory> reduction_args;
@@ -93,7 +86,7 @@ void SoftmaxCrossEntropyCpu(const NDArray& input, const NDArray& label,
           reduction_args.insert({DNNL_ARG_DST, rdst_mem});
 
           // Primitive execution: Reduction (Sum).
-          reduction_prim.execute(engine_stream, reduction_args);
+          reduction->prim.execute(engine_stream, reduction_args);
           engine_stream.wait();
         }
         },"SoftmaxCrossEntropy");
@@ -133,8 +126,8 @@ void SoftmaxCrossEntropyGradientCpu(const NDArray& input_y,
         [input_y, label, grad, output, workspace, stream, c_, size]() {
         void* workspace_ptr = workspace->raw_data_ptr();
         
-        dnnl::engine eng(dnnl::engine::kind::cpu, 0);
-        dnnl::stream engine_stream(eng);
+        const auto& eng = hetu::cpu::GetDNNLEngine();
+        auto& engine_stream = hetu::cpu::GetDNNLStream();
         
         auto src_md = dnnl::memory::desc(input_y->shape(), dnnl::memory::data_type::f32, input_y->stride());
         auto dst_md = dnnl::memory::desc(input_y->shape(), dnnl::memory::data_type::f32, input_y->stride());
@@ -143,19 +136,15 @@ void SoftmaxCrossEntropyGradientCpu(const NDArray& input_y,
 
         // Softmax axis.
         const int axis = 1;
-        auto softmax_pd = dnnl::softmax_forward::primitive_desc(eng,
-                          dnnl::prop_kind::forward_training, 
-                          dnnl::algorithm::softmax_accurate, 
-                          src_md, dst_md, axis);
-
-        auto softmax_prim = dnnl::softmax_forward(softmax_pd);
+        auto softmax = hetu::cpu::GetOrCreateDNNLSoftmax(
+                          dnnl::algorithm::softmax_accurate, src_md, dst_md, axis);
 
         std::unordered_map<int, dnnl::memory> softmax_args;
         softmax_args.insert({DNNL_ARG_SRC, src_mem});
         softmax_args.insert({DNNL_ARG_DST, dst_mem});
 
         // Primitive execution.
-        softmax_prim.execute(engine_stream, softmax_args);
+        softmax->prim.execute(engine_stream, softmax_args);
         engine_stream.wait();
 
         softmax_cross_entropy_gradient_cpu<spec_t>(
@@ -69,22 +69,21 @@ void SqrtCpu(const NDArray& input, NDArray& output, const Stream& stream) {
     input->dtype(), spec_t, "SqrtCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
         [stream, input, output, size]() {
-          dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+          const auto& eng = hetu::cpu::GetDNNLEngine();
           auto dnnltype = hetu::cpu::dtype_to_dnnltype(input->dtype());
           auto mat_md = dnnl::memory::desc(input->shape(), dnnltype, input->stride());
           auto src_mem = dnnl::memory(mat_md, eng, input->data_ptr<spec_t>());
           auto dst_mem = dnnl::memory(mat_md, eng, output->data_ptr<spec_t>());
 
-          auto Sqrt_pd = dnnl::eltwise_forward::primitive_desc(eng, dnnl::prop_kind::forward_training,
-                              dnnl::algorithm::eltwise_sqrt, mat_md, mat_md);
-          auto Sqrt = dnnl::eltwise_forward(Sqrt_pd);
+          auto Sqrt = hetu::cpu::GetOrCreateDNNLEltwise(
+                            dnnl::algorithm::eltwise_sqrt, mat_md, mat_md);
 
           std::unordered_map<int, dnnl::memory> sqrt_args;
           sqrt_args.insert({DNNL_ARG_SRC, src_mem});
           sqrt_args.insert({DNNL_ARG_DST, dst_mem});      
 
-          dnnl::stream engine_stream(eng);
-          Sqrt.execute(engine_stream, sqrt_args);
+          auto& engine_stream = hetu::cpu::GetDNNLStream();
+          Sqrt->prim.execute(engine_stream, sqrt_args);
           engine_stream.wait();
         },"Sqrt");
     });
@@ -105,22 +104,21 @@ void ReciprocalSqrtCpu(const NDArray& output_grad, NDArray& input_grad,
     input_grad->dtype(), spec_t, "ReciprocalSqrtCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
         [stream, input_grad, output_grad, size]() {
-          dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+          const auto& eng = hetu::cpu::GetDNNLEngine();
           auto dnnltype = hetu::cpu::dtype_to_dnnltype(input_grad->dtype());
           auto mat_md = dnnl::memory::desc(input_grad->shape(), dnnltype, input_grad->stride());
           auto src_mem = dnnl::memory(mat_md, eng, output_grad->data_ptr<spec_t>());
           auto dst_mem = dnnl::memory(mat_md, eng, input_grad->data_ptr<spec_t>());
 
-          auto Reciprocal_pd = dnnl::eltwise_forward::primitive_desc(eng, dnnl::prop_kind::forward_training,
-                              dnnl::algorithm::eltwise_pow, mat_md, mat_md, float(1.0), float(-0.5));
-          auto Reciprocal = dnnl::eltwise_forward(Reciprocal_pd);
+          auto Reciprocal = hetu::cpu::GetOrCreateDNNLEltwise(
+                            dnnl::algorithm::eltwise_pow, mat_md, mat_md, float(1.0), float(-0.5));
 
           std::unordered_map<int, dnnl::memory> sqrt_args;
           sqrt_args.insert({DNNL_ARG_SRC, src_mem});
           sqrt_args.insert({DNNL_ARG_DST, dst_mem});      
 
-          dnnl::stream engine_stream(eng);
-          Reciprocal.execute(engine_stream, sqrt_args);
+          auto& engine_stream = hetu::cpu::GetDNNLStream();
+          Reciprocal->prim.execute(engine_stream, sqrt_args);
           engine_stream.wait();
         },"ReciprocalSqrt");
     });
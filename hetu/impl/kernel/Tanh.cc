@@ -85,22 +85,21 @@ void TanhCpu(const NDArray& input, NDArray& output, const Stream& stream) {
     input->dtype(), spec_t, "TanhCpu", [&]() {
       auto _future = cpu_stream.EnqueueTask(
         [stream, input, output, size]() {
-          dnnl::engine eng(dnnl::engine::kind::cpu, 0);
+          const auto& eng = hetu::cpu::GetDNNLEngine();
           auto dnnltype = hetu::cpu::dtype_to_dnnltype(input->dtype());
           auto mat_md = dnnl::memory::desc(input->shape(), dnnltype, input->stride());
           auto src_mem = dnnl::memory(mat_md, eng, input->data_ptr<spec_t>());
           auto dst_mem = dnnl::memory(mat_md, eng, output->data_ptr<spec_t>());
 
-          auto Tanh_pd = dnnl::eltwise_forward::primitive_desc(eng, dnnl::prop_kind::forward_training,
-                              dnnl::algorithm::eltwise_tanh, mat_md, mat_md, float(0.0), float(0.0));
-          auto Tanh = dnnl::eltwise_forward(Tanh_pd);
+          auto Tanh = hetu::cpu::GetOrCreateDNNLEltwise(
+                            dnnl::algorithm::eltwise_tanh, mat_md, mat_md, float(0.0), float(0.0));
 
           std::unordered_map<int, dnnl::memory> tanh_args;
           tanh_args.insert({DNNL_ARG_SRC, src_mem});
           tanh_args.insert({DNNL_ARG_DST, dst_mem});      
 
-          dnnl::stream engine_stream(eng);
-          Tanh.execute(engine_stream, tanh_args);
+          auto& engine_stream = hetu::cpu::GetDNNLStream();
+          Tanh->prim.execute(engine_stream, tanh_args);
           engine_stream.wait();
           engine_stream.wait();
         },"Tanh");
@@ -0,0 +1,56 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/core/stream.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/impl/utils/common_utils.h"
+
+namespace hetu {
+namespace impl {
+
+template <typename spec_t>
+void update_scale_cpu(spec_t* scale, int* growth_tracker,
+                      const float* found_inf, double growth_factor,
+                      double backoff_factor, int growth_interval) {
+  if (*found_inf) {
+    *scale = static_cast<spec_t>((*scale) * backoff_factor);
+    *growth_tracker = 0;
+  } else {
+    int successful = (*growth_tracker) + 1;
+    if (successful == growth_interval) {
+      *scale = static_cast<spec_t>((*scale) * growth_factor);
+      *growth_tracker = 0;
+    } else {
+      *growth_tracker = successful;
+    }
+  }
+}
+
+void UpdateScaleCpu(NDArray& scale, NDArray& growth_tracker,
+                    const NDArray& found_inf, double growth_factor,
+                    double backoff_factor, int growth_interval,
+                    const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(scale);
+  HT_ASSERT_SAME_DEVICE(scale, growth_tracker);
+  HT_ASSERT_SAME_DEVICE(scale, found_inf);
+
+  size_t size = scale->numel();
+  if (size == 0)
+    return;
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
+    scale->dtype(), spec_t, "UpdateScaleCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [scale, growth_tracker, found_inf, growth_factor, backoff_factor,
+         growth_interval]() {
+          update_scale_cpu<spec_t>(
+            scale->data_ptr<spec_t>(), growth_tracker->data_ptr<int>(),
+            found_inf->data_ptr<float>(), growth_factor, backoff_factor,
+            growth_interval);
+        },
+        "UpdateScale");
+    });
+  NDArray::MarkUsedBy({scale, growth_tracker, found_inf}, stream);
+}
+
+} // namespace impl
+} // namespace hetu
@@ -0,0 +1,139 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/core/stream.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/impl/utils/common_utils.h"
+#include "hetu/impl/utils/omp_utils.h"
+
+namespace hetu {
+namespace impl {
+
+// vocab_parallel_logits: [batch_size * seq_len, vocab_size], splited by tp in vocab_size dimension
+// labels: [batch_size, seq_len], duplicate
+// predicted_logits_partial: [batch_size * seq_len]
+// log_sum_exp_logits: [batch_size * seq_len]
+template <typename spec_t>
+void vocab_parallel_cross_entropy_cpu(const spec_t* vocab_parallel_logits,
+                                      const int64_t* labels, size_t n_rows,
+                                      size_t n_cols,
+                                      const int64_t vocab_start_index,
+                                      const int64_t vocab_end_index,
+                                      const int64_t ignored_index,
+                                      spec_t* predicted_logits_partial,
+                                      spec_t* log_sum_exp_logits) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (size_t idx = 0; idx < n_rows; idx++) {
+    if (labels[idx] == ignored_index) {
+      predicted_logits_partial[idx] = 0;
+      log_sum_exp_logits[idx] = 0;
+      continue;
+    }
+    if (labels[idx] < vocab_start_index || labels[idx] >= vocab_end_index) {
+      predicted_logits_partial[idx] = 0;
+    } else {
+      predicted_logits_partial[idx] =
+        vocab_parallel_logits[idx * n_cols + labels[idx] - vocab_start_index];
+    }
+  }
+}
+
+void VocabParallelCrossEntropyCpu(const NDArray& vocab_parallel_logits,
+                                  const NDArray& labels,
+                                  const int64_t vocab_start_index,
+                                  const int64_t vocab_end_index,
+                                  const int64_t ignored_index,
+                                  NDArray& predicted_logits_partial,
+                                  NDArray& log_sum_exp_logits,
+                                  const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(vocab_parallel_logits);
+  HT_ASSERT_SAME_DEVICE(vocab_parallel_logits, labels);
+  HT_ASSERT_SAME_DEVICE(vocab_parallel_logits, predicted_logits_partial);
+  HT_ASSERT_SAME_DEVICE(vocab_parallel_logits, log_sum_exp_logits);
+  size_t n_rows = vocab_parallel_logits->shape(0); // batch_size * seq_len
+  size_t n_cols = vocab_parallel_logits->shape(1); // vocab_size
+  if (n_rows == 0)
+    return;
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(
+    vocab_parallel_logits->dtype(), spec_t, "VocabParallelCrossEntropyCpu",
+    [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [vocab_parallel_logits, labels, n_rows, n_cols, vocab_start_index,
+         vocab_end_index, ignored_index, predicted_logits_partial,
+         log_sum_exp_logits]() {
+          vocab_parallel_cross_entropy_cpu<spec_t>(
+            vocab_parallel_logits->data_ptr<spec_t>(),
+            labels->data_ptr<int64_t>(), n_rows, n_cols, vocab_start_index,
+            vocab_end_index, ignored_index,
+            predicted_logits_partial->data_ptr<spec_t>(),
+            log_sum_exp_logits->data_ptr<spec_t>());
+        },
+        "VocabParallelCrossEntropy");
+    });
+  NDArray::MarkUsedBy({vocab_parallel_logits, labels,
+                       predicted_logits_partial, log_sum_exp_logits},
+                      stream);
+}
+
+// softmax: [batch_size * seq_len, vocab_size], splited by tp in vocab_size dimension
+// labels: [batch_size, seq_len], duplicate
+// grad = (softmax(prediction) - labels) * grad_loss
+template <typename spec_t>
+void vocab_parallel_cross_entropy_gradient_cpu(
+  const spec_t* softmax, const int64_t* labels, size_t n_rows, size_t n_cols,
+  const int64_t vocab_start_index, const spec_t* grad_loss, spec_t* output) {
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (size_t idx = 0; idx < n_rows; idx++) {
+    const spec_t* in = softmax + idx * n_cols;
+    spec_t* out = output + idx * n_cols;
+    float grad = static_cast<float>(grad_loss[idx]);
+#pragma omp simd
+    for (size_t col_idx = 0; col_idx < n_cols; col_idx++)
+      out[col_idx] = static_cast<spec_t>(static_cast<float>(in[col_idx]) * grad);
+    // Labels out of this vocab partition do not contribute.
+    int64_t predict_idx = labels[idx] - vocab_start_index;
+    if (predict_idx >= 0 && predict_idx < static_cast<int64_t>(n_cols))
+      out[predict_idx] =
+        static_cast<spec_t>((static_cast<float>(in[predict_idx]) - 1.0f) * grad);
+  }
+}
+
+void VocabParallelCrossEntropyGradientCpu(const NDArray& softmax,
+                                          const NDArray& labels,
+                                          const int64_t vocab_start_index,
+                                          const int64_t vocab_end_index,
+                                          const int64_t ignored_index,
+                                          const NDArray& grad_loss,
+                                          NDArray& output,
+                                          const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(softmax);
+  HT_ASSERT_SAME_DEVICE(softmax, labels);
+  HT_ASSERT_SAME_DEVICE(softmax, grad_loss);
+  HT_ASSERT_SAME_DEVICE(softmax, output);
+  size_t n_rows = softmax->shape(0); // batch_size * seq_len
+  size_t n_cols = softmax->shape(1); // vocab_size
+  if (n_rows == 0)
+    return;
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(
+    softmax->dtype(), spec_t, "VocabParallelCrossEntropyGradientCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [softmax, labels, n_rows, n_cols, vocab_start_index, grad_loss,
+         output]() {
+          vocab_parallel_cross_entropy_gradient_cpu<spec_t>(
+            softmax->data_ptr<spec_t>(), labels->data_ptr<int64_t>(), n_rows,
+            n_cols, vocab_start_index, grad_loss->data_ptr<spec_t>(),
+            output->data_ptr<spec_t>());
+        },
+        "VocabParallelCrossEntropyGradient");
+    });
+  NDArray::MarkUsedBy({softmax, labels, grad_loss, output}, stream);
+}
+
+} // namespace impl
+} // namespace hetu
@@ -0,0 +1,217 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/core/stream.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/impl/utils/common_utils.h"
+#include "hetu/impl/utils/omp_utils.h"
+#include <algorithm>
+#include <cmath>
+
+namespace hetu {
+namespace impl {
+
+namespace {
+
+// Blockwise quantization in the same format as the CUDA kernels: each block
+// of `blocksize` elements is scaled by its absolute maximum, which is
+// stored in `absmax`. INT8 stores the index of the nearest value in a
+// sorted 256-entry `code`; FLOAT4 and NFLOAT4 pack two 4-bit values per
+// byte, the first element in the high nibble.
+
+// Values of the 16 FP4 codes (sign bit, then 3 bits), normalized to [-1, 1].
+constexpr float kFP4Values[16] = {
+  0.0f,        5.208333333e-03f, 0.66666667f,  1.0f,
+  0.33333333f, 0.5f,             0.16666667f,  0.25f,
+  -0.0f,       -5.208333333e-03f, -0.66666667f, -1.0f,
+  -0.33333333f, -0.5f,           -0.16666667f, -0.25f};
+
+// Quantiles of N(0, 1) normalized to [-1, 1] (NF4).
+constexpr float kNF4Values[16] = {
+  -1.0f,
+  -0.6961928009986877f,
+  -0.5250730514526367f,
+  -0.39491748809814453f,
+  -0.28444138169288635f,
+  -0.18477343022823334f,
+  -0.09105003625154495f,
+  0.0f,
+  0.07958029955625534f,
+  0.16093020141124725f,
+  0.24611230194568634f,
+  0.33791524171829224f,
+  0.44070982933044434f,
+  0.5626170039176941f,
+  0.7229568362236023f,
+  1.0f};
+
+inline uint8_t QuantizeFP4(float x) {
+  uint8_t sign = x < 0 ? 0b1000 : 0b0000;
+  x = std::fabs(x);
+  if (x > 0.29166667f) {
+    if (x > 0.583333f)
+      return (x > 0.8333333f ? 0b0011 : 0b0010) + sign;
+    return (x > 0.4166667f ? 0b0101 : 0b0100) + sign;
+  }
+  if (x > 0.0859375f)
+    return (x > 0.20833333f ? 0b0111 : 0b0110) + sign;
+  return (x > 0.00260417f ? 0b0001 : 0b0000) + sign;
+}
+
+inline uint8_t QuantizeNF4(float x) {
+  // Midpoints between adjacent NF4 values.
+  uint8_t q = 0;
+  while (q < 15 && x > 0.5f * (kNF4Values[q] + kNF4Values[q + 1]))
+    q++;
+  return q;
+}
+
+inline uint8_t QuantizeDynamic(const float* code, float x) {
+  const float* it = std::lower_bound(code, code + 256, x);
+  if (it == code)
+    return 0;
+  if (it == code + 256)
+    return 255;
+  return (x - *(it - 1)) <= (*it - x) ? it - code - 1 : it - code;
+}
+
+template <typename spec_t>
+void quantization_cpu(const spec_t* input, float* absmax, const float* code,
+                      uint8_t* output, size_t size, int64_t blocksize,
+                      DataType qtype) {
+  int64_t num_blocks = DIVUP(size, blocksize);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int64_t block = 0; block < num_blocks; block++) {
+    size_t begin = block * blocksize;
+    size_t end = MIN(begin + blocksize, size);
+    float local_abs_max = 0;
+    for (size_t i = begin; i < end; i++)
+      local_abs_max = MAX(local_abs_max, std::fabs(static_cast<float>(input[i])));
+    absmax[block] = local_abs_max;
+    float scale = local_abs_max > 0 ? 1.0f / local_abs_max : 0.0f;
+    if (qtype == kInt8) {
+      for (size_t i = begin; i < end; i++)
+        output[i] = QuantizeDynamic(code, static_cast<float>(input[i]) * scale);
+    } else {
+      // Blocks have an even size, so a byte never straddles two blocks.
+      auto quantize = qtype == kFloat4 ? QuantizeFP4 : QuantizeNF4;
+      for (size_t i = begin; i < end; i += 2) {
+        uint8_t hi = quantize(static_cast<float>(input[i]) * scale);
+        uint8_t lo = i + 1 < end
+          ? quantize(static_cast<float>(input[i + 1]) * scale)
+          : 0;
+        output[i / 2] = (hi << 4) | lo;
+      }
+    }
+  }
+}
+
+template <typename spec_t>
+void dequantization_cpu(const uint8_t* input, const float* absmax,
+                        const float* code, spec_t* output, size_t size,
+                        int64_t blocksize, DataType qtype) {
+  const float* values = qtype == kInt8 ? code
+    : qtype == kFloat4                 ? kFP4Values
+                                       : kNF4Values;
+  int64_t num_blocks = DIVUP(size, blocksize);
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int64_t block = 0; block < num_blocks; block++) {
+    size_t begin = block * blocksize;
+    size_t end = MIN(begin + blocksize, size);
+    float local_abs_max = absmax[block];
+    if (qtype == kInt8) {
+      for (size_t i = begin; i < end; i++)
+        output[i] = static_cast<spec_t>(values[input[i]] * local_abs_max);
+    } else {
+      for (size_t i = begin; i < end; i++) {
+        uint8_t q = (i % 2 == 0) ? (input[i / 2] >> 4) : (input[i / 2] & 0x0F);
+        output[i] = static_cast<spec_t>(values[q] * local_abs_max);
+      }
+    }
+  }
+}
+
+void CheckQuantizationArgs(const NDArray& absmax, const NDArray& code,
+                           DataType qtype, size_t size, int64_t blocksize) {
+  HT_ASSERT(qtype == kInt8 || qtype == kFloat4 || qtype == kNFloat4)
+    << "Not support this quantization type:" << qtype;
+  HT_ASSERT(blocksize > 0 && (qtype == kInt8 || blocksize % 2 == 0))
+    << "Invalid blocksize " << blocksize << " for " << qtype;
+  HT_ASSERT(absmax->dtype() == kFloat32 &&
+            absmax->numel() >= DIVUP(size, blocksize))
+    << "absmax must be a float32 array of at least " << DIVUP(size, blocksize)
+    << " elements, got " << absmax->numel() << " " << absmax->dtype();
+  if (qtype == kInt8)
+    HT_ASSERT(code.is_defined() && code->dtype() == kFloat32 &&
+              code->numel() == 256)
+      << "INT8 quantization requires a float32 code of 256 values";
+}
+
+} // namespace
+
+// `stochastic` rounding is not used by the CUDA kernels either.
+void QuantizationCpu(const NDArray& input, NDArray& absmax,
+                     const NDArray& code, NDArray& output, int64_t blocksize,
+                     bool stochastic, const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(input);
+  HT_ASSERT_SAME_DEVICE(input, output);
+  HT_ASSERT_SAME_DEVICE(input, absmax);
+  HT_ASSERT_SAME_SHAPE(input, output);
+  HT_ASSERT(input->is_contiguous() && output->is_contiguous())
+    << "Quantization only supports contiguous arrays.";
+
+  size_t size = input->numel();
+  if (size == 0)
+    return;
+  CheckQuantizationArgs(absmax, code, output->dtype(), size, blocksize);
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(input->dtype(), spec_t, "QuantizationCpu", [&]() {
+    auto _future = cpu_stream.EnqueueTask(
+      [input, absmax, code, output, size, blocksize]() {
+        quantization_cpu<spec_t>(
+          input->data_ptr<spec_t>(), absmax->data_ptr<float>(),
+          code.is_defined() ? code->data_ptr<float>() : nullptr,
+          static_cast<uint8_t*>(output->raw_data_ptr()), size, blocksize,
+          output->dtype());
+      },
+      "Quantization");
+  });
+  NDArray::MarkUsedBy({input, absmax, code, output}, stream);
+}
+
+void DeQuantizationCpu(const NDArray& input, NDArray& absmax,
+                       const NDArray& code, NDArray& output, int64_t blocksize,
+                       const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(input);
+  HT_ASSERT_SAME_DEVICE(input, output);
+  HT_ASSERT_SAME_DEVICE(input, absmax);
+  HT_ASSERT_SAME_SHAPE(input, output);
+  HT_ASSERT(input->is_contiguous() && output->is_contiguous())
+    << "DeQuantization only supports contiguous arrays.";
+
+  size_t size = output->numel();
+  if (size == 0)
+    return;
+  CheckQuantizationArgs(absmax, code, input->dtype(), size, blocksize);
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(
+    output->dtype(), spec_t, "DeQuantizationCpu", [&]() {
+      auto _future = cpu_stream.EnqueueTask(
+        [input, absmax, code, output, size, blocksize]() {
+          dequantization_cpu<spec_t>(
+            static_cast<const uint8_t*>(input->raw_data_ptr()),
+            absmax->data_ptr<float>(),
+            code.is_defined() ? code->data_ptr<float>() : nullptr,
+            output->data_ptr<spec_t>(), size, blocksize, input->dtype());
+        },
+        "DeQuantization");
+    });
+  NDArray::MarkUsedBy({input, absmax, code, output}, stream);
+}
+
+} // namespace impl
+} // namespace hetu
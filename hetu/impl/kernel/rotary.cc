@@ -0,0 +1,111 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/core/stream.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/impl/utils/common_utils.h"
+#include "hetu/impl/utils/cpu_math.h"
+#include "hetu/impl/utils/omp_utils.h"
+
+namespace hetu {
+namespace impl {
+
+namespace {
+
+// x1, x2, out1, out2: [batch_size, seq_len, nheads, rotary_dim]
+// cos, sin: [seq_len, 1, rotary_dim]
+// Each (batch, seq, head) row is rotated as a whole so that cos/sin of a
+// position are loaded once per row, and the inner loop vectorizes when
+// the last dims are contiguous.
+template <typename spec_t, bool conj>
+void rotary_cpu(const NDArray& x1, const NDArray& x2, const NDArray& cos,
+                const NDArray& sin, NDArray& out1, NDArray& out2) {
+  using acc_t = hetu::cpu::acc_type<spec_t>;
+  const int64_t batch_size = x1->shape(0), seq_len = x1->shape(1),
+                nheads = x1->shape(2), rotary_dim = x1->shape(3);
+  const auto* x1_ptr = x1->data_ptr<spec_t>();
+  const auto* x2_ptr = x2->data_ptr<spec_t>();
+  const auto* cos_ptr = cos->data_ptr<spec_t>();
+  const auto* sin_ptr = sin->data_ptr<spec_t>();
+  auto* out1_ptr = out1->data_ptr<spec_t>();
+  auto* out2_ptr = out2->data_ptr<spec_t>();
+  const auto &x1_st = x1->stride(), &x2_st = x2->stride(),
+             &out1_st = out1->stride(), &out2_st = out2->stride();
+  const int64_t cos_st0 = cos->stride(0), cos_st2 = cos->stride(2),
+                sin_st0 = sin->stride(0), sin_st2 = sin->stride(2);
+  const bool unit_stride = x1_st[3] == 1 && x2_st[3] == 1 &&
+    out1_st[3] == 1 && out2_st[3] == 1 && cos_st2 == 1 && sin_st2 == 1;
+  const int64_t num_rows = batch_size * seq_len * nheads;
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static)
+#endif
+  for (int64_t row = 0; row < num_rows; row++) {
+    int64_t h = row % nheads;
+    int64_t s = (row / nheads) % seq_len;
+    int64_t b = row / (nheads * seq_len);
+    const spec_t* a = x1_ptr + b * x1_st[0] + s * x1_st[1] + h * x1_st[2];
+    const spec_t* c = x2_ptr + b * x2_st[0] + s * x2_st[1] + h * x2_st[2];
+    const spec_t* cs = cos_ptr + s * cos_st0;
+    const spec_t* sn = sin_ptr + s * sin_st0;
+    spec_t* o1 = out1_ptr + b * out1_st[0] + s * out1_st[1] + h * out1_st[2];
+    spec_t* o2 = out2_ptr + b * out2_st[0] + s * out2_st[1] + h * out2_st[2];
+    auto rotate = [&](int64_t a_off, int64_t c_off, int64_t cs_off,
+                      int64_t sn_off, int64_t o1_off, int64_t o2_off) {
+      acc_t u = static_cast<acc_t>(a[a_off]);
+      acc_t v = static_cast<acc_t>(c[c_off]);
+      acc_t cv = static_cast<acc_t>(cs[cs_off]);
+      acc_t sv = static_cast<acc_t>(sn[sn_off]);
+      if (conj) {
+        o1[o1_off] = static_cast<spec_t>(u * cv + v * sv);
+        o2[o2_off] = static_cast<spec_t>(v * cv - u * sv);
+      } else {
+        o1[o1_off] = static_cast<spec_t>(u * cv - v * sv);
+        o2[o2_off] = static_cast<spec_t>(u * sv + v * cv);
+      }
+    };
+    if (unit_stride) {
+#pragma omp simd
+      for (int64_t r = 0; r < rotary_dim; r++)
+        rotate(r, r, r, r, r, r);
+    } else {
+      for (int64_t r = 0; r < rotary_dim; r++)
+        rotate(r * x1_st[3], r * x2_st[3], r * cos_st2, r * sin_st2,
+               r * out1_st[3], r * out2_st[3]);
+    }
+  }
+}
+
+} // namespace
+
+void RotaryCpu(const NDArray& x1, const NDArray& x2, const NDArray& cos,
+               const NDArray& sin, NDArray& out1, NDArray& out2, bool conj,
+               const Stream& stream) {
+  HT_ASSERT_CPU_DEVICE(x1);
+  HT_ASSERT_SAME_DEVICE(x1, x2);
+  HT_ASSERT_SAME_DEVICE(x1, cos);
+  HT_ASSERT_SAME_DEVICE(x1, sin);
+  HT_ASSERT_SAME_DEVICE(x1, out1);
+  HT_ASSERT_SAME_DEVICE(x1, out2);
+  HT_ASSERT(x1->ndim() == 4 && cos->ndim() == 3 && sin->ndim() == 3)
+    << "Rotary expects inputs of [batch_size, seq_len, nheads, rotary_dim] "
+    << "and cos/sin of [seq_len, 1, rotary_dim], got " << x1->shape()
+    << " and " << cos->shape();
+
+  size_t size = x1->numel();
+  if (size == 0)
+    return;
+
+  CPUStream cpu_stream(stream);
+  HT_DISPATCH_FLOATING_TYPES(x1->dtype(), spec_t, "RotaryCpu", [&]() {
+    auto _future = cpu_stream.EnqueueTask(
+      [x1, x2, cos, sin, out1, out2, conj]() mutable {
+        if (conj)
+          rotary_cpu<spec_t, true>(x1, x2, cos, sin, out1, out2);
+        else
+          rotary_cpu<spec_t, false>(x1, x2, cos, sin, out1, out2);
+      },
+      "Rotary");
+  });
+  NDArray::MarkUsedBy({x1, x2, cos, sin, out1, out2}, stream);
+}
+
+} // namespace impl
+} // namespace hetu
@@ -2,6 +2,11 @@
 #include "hetu/impl/stream/CPUStream.h"
 #include "hetu/impl/stream/CUDAStream.h"
 #include <mutex>
+#include <algorithm>
+#include <unordered_set>
+#include <cstdlib>
+#include <cerrno>
+#include <sys/mman.h>
 
 namespace hetu {
 namespace impl {
@@ -14,41 +19,282 @@ inline static void batch_sync_dependent_events(
     kv.second->Sync();
 }
 
+constexpr size_t kMinBlockSize = 64;
+constexpr size_t kBlockAlignment = 64;
+constexpr size_t kMaxSmallBlockSize = 262144; // 256KiB
+constexpr size_t kHugePageSize = 2097152; // 2MiB
+constexpr size_t kThreadCacheBytes = 4194304; // 4MiB
+constexpr size_t kThreadCacheBlocksPerClass = 64;
+
+// Size classes: 64 bytes, then 4 evenly spaced classes in each (2^p, 2^(p+1)],
+// so the rounding wastes at most 25% of a block.
+inline static size_t SizeClassIndex(size_t num_bytes) {
+  if (num_bytes <= kMinBlockSize)
+    return 0;
+  size_t p = 63 - __builtin_clzll(num_bytes - 1);
+  size_t step = static_cast<size_t>(1) << (p - 2);
+  size_t k = DIVUP(num_bytes - (static_cast<size_t>(1) << p), step);
+  return 1 + (p - 6) * 4 + (k - 1);
+}
+
+inline static size_t SizeClassBytes(size_t class_idx) {
+  if (class_idx == 0)
+    return kMinBlockSize;
+  size_t p = (class_idx - 1) / 4 + 6;
+  size_t k = (class_idx - 1) % 4 + 1;
+  return (static_cast<size_t>(1) << p) + k * (static_cast<size_t>(1) << (p - 2));
+}
+
+const size_t kNumSizeClasses = SizeClassIndex(static_cast<size_t>(1) << 62) + 1;
+const size_t kNumSmallSizeClasses = SizeClassIndex(kMaxSmallBlockSize) + 1;
+
+inline static void UpdatePeak(std::atomic<size_t>& peak, size_t value) {
+  size_t cur = peak.load(std::memory_order_relaxed);
+  while (cur < value &&
+         !peak.compare_exchange_weak(cur, value, std::memory_order_relaxed)) {}
+}
+
+static void* MmapHugePageAligned(size_t num_bytes) {
+  size_t len = num_bytes + kHugePageSize;
+  void* raw = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (raw == MAP_FAILED)
+    return nullptr;
+  uintptr_t start = reinterpret_cast<uintptr_t>(raw);
+  uintptr_t aligned = DIVUP(start, kHugePageSize) * kHugePageSize;
+  if (aligned > start)
+    munmap(raw, aligned - start);
+  size_t tail = start + len - (aligned + num_bytes);
+  if (tail > 0)
+    munmap(reinterpret_cast<void*>(aligned + num_bytes), tail);
+#ifdef MADV_HUGEPAGE
+  madvise(reinterpret_cast<void*>(aligned), num_bytes, MADV_HUGEPAGE);
+#endif
+  return reinterpret_cast<void*>(aligned);
+}
+
+// Pools that are still alive. Per-thread caches may outlive pools that are
+// destroyed at exit, so they check this before flushing back. Both are
+// leaked on purpose since worker threads exit during static destruction.
+static std::mutex& live_cpu_memory_pools_mtx() {
+  static auto* mtx = new std::mutex();
+  return *mtx;
+}
+
+static std::unordered_set<CPUMemoryPool*>& live_cpu_memory_pools() {
+  static auto* pools = new std::unordered_set<CPUMemoryPool*>();
+  return *pools;
+}
+
+// Set once the thread cache of the calling thread has been destroyed, so
+// that frees issued by later thread-exit destructors bypass it.
+static thread_local bool thread_cache_destroyed = false;
+
 } // namespace
 
-CPUMemoryPool::CPUMemoryPool() : MemoryPool(Device(kCPU), "CPUMemPool") {
-  _data_ptr_info.reserve(8192);
+struct CPUMemoryPool::ThreadCache {
+  std::mutex mtx;
+  CPUMemoryPool* pool{nullptr};
+  std::vector<std::vector<void*>> blocks;
+  size_t cached_bytes{0};
+
+  ThreadCache() : blocks(kNumSmallSizeClasses) {}
+
+  ~ThreadCache() {
+    thread_cache_destroyed = true;
+    std::lock_guard<std::mutex> lock(live_cpu_memory_pools_mtx());
+    if (pool != nullptr && live_cpu_memory_pools().count(pool) > 0) {
+      pool->_FlushThreadCache(this);
+      std::lock_guard<std::mutex> caches_lock(pool->_thread_caches_mtx);
+      auto& caches = pool->_thread_caches;
+      caches.erase(std::remove(caches.begin(), caches.end(), this),
+                   caches.end());
+    }
+  }
+};
+
+CPUMemoryPool::CPUMemoryPool(size_t max_cached_bytes, bool use_huge_pages)
+: MemoryPool(Device(kCPU), "CPUMemPool"),
+  _max_cached_bytes(max_cached_bytes),
+  _use_huge_pages(use_huge_pages),
+  _free_blocks(kNumSizeClasses) {
+  for (auto& shard : _info_shards)
+    shard.table.reserve(8192 / kNumInfoShards);
   _free_on_alloc_stream_fn =
     std::bind(CPUMemoryPool::_FreeOnAllocStream, this, std::placeholders::_1);
   _free_on_join_stream_fn =
     std::bind(CPUMemoryPool::_FreeOnJoinStream, this, std::placeholders::_1);
+  std::lock_guard<std::mutex> lock(live_cpu_memory_pools_mtx());
+  live_cpu_memory_pools().insert(this);
 }
 
 CPUMemoryPool::~CPUMemoryPool() {
-  std::lock_guard<std::mutex> lock(_mtx);
+  // The pending frees lock the free lists, so we must not hold `_mtx` here.
   CPUStream(Stream(Device(kCPU), kJoinStream)).Sync();
+  {
+    std::lock_guard<std::mutex> lock(live_cpu_memory_pools_mtx());
+    live_cpu_memory_pools().erase(this);
+  }
+  EmptyCache();
+}
+
+CPUMemoryPool::ThreadCache* CPUMemoryPool::_GetThreadCache() {
+  if (thread_cache_destroyed)
+    return nullptr;
+  static thread_local ThreadCache cache;
+  if (cache.pool == this)
+    return &cache;
+  if (cache.pool != nullptr)
+    return nullptr; // only the first pool used by a thread gets a cache
+  cache.pool = this;
+  std::lock_guard<std::mutex> lock(_thread_caches_mtx);
+  _thread_caches.push_back(&cache);
+  return &cache;
+}
+
+void CPUMemoryPool::_FlushThreadCache(ThreadCache* cache) {
+  std::lock_guard<std::mutex> cache_lock(cache->mtx);
+  std::lock_guard<std::mutex> lock(_mtx);
+  for (size_t i = 0; i < cache->blocks.size(); i++) {
+    auto& blocks = cache->blocks[i];
+    _free_blocks[i].insert(_free_blocks[i].end(), blocks.begin(),
+                           blocks.end());
+    blocks.clear();
+  }
+  cache->cached_bytes = 0;
+}
+
+void* CPUMemoryPool::_SystemAlloc(size_t num_bytes) {
+  void* ptr = nullptr;
+  if (_use_huge_pages && num_bytes >= kHugePageSize) {
+    ptr = MmapHugePageAligned(num_bytes);
+    if (ptr == nullptr) {
+      EmptyCache();
+      ptr = MmapHugePageAligned(num_bytes);
+    }
+    HT_BAD_ALLOC_IF(ptr == nullptr)
+      << "Failed to allocate " << num_bytes
+      << " bytes of host memory. Error: " << strerror(errno);
+    _huge_page_reserved += num_bytes;
+  } else {
+    int err = posix_memalign(&ptr, kBlockAlignment, num_bytes);
+    if (err != 0) {
+      EmptyCache();
+      err = posix_memalign(&ptr, kBlockAlignment, num_bytes);
+    }
+    HT_BAD_ALLOC_IF(err != 0)
+      << "Failed to allocate " << num_bytes
+      << " bytes of host memory. Error: " << strerror(err);
+  }
+  _sys_alloc_cnt++;
+  UpdatePeak(_peak_reserved, _reserved += num_bytes);
+  return ptr;
+}
+
+void CPUMemoryPool::_SystemFree(void* ptr, size_t num_bytes) {
+  if (_use_huge_pages && num_bytes >= kHugePageSize) {
+    munmap(ptr, num_bytes);
+    _huge_page_reserved -= num_bytes;
+  } else {
+    free(ptr);
+  }
+  _sys_free_cnt++;
+  _reserved -= num_bytes;
+}
+
+void* CPUMemoryPool::_AcquireBlock(size_t class_idx, size_t class_bytes,
+                                   bool& is_new) {
+  is_new = false;
+  if (class_idx < kNumSmallSizeClasses) {
+    auto* cache = _GetThreadCache();
+    if (cache != nullptr) {
+      std::lock_guard<std::mutex> lock(cache->mtx);
+      auto& blocks = cache->blocks[class_idx];
+      if (!blocks.empty()) {
+        void* ptr = blocks.back();
+        blocks.pop_back();
+        cache->cached_bytes -= class_bytes;
+        _cached -= class_bytes;
+        _thread_cache_hit_cnt++;
+        return ptr;
+      }
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(_mtx);
+    auto& blocks = _free_blocks[class_idx];
+    if (!blocks.empty()) {
+      void* ptr = blocks.back();
+      blocks.pop_back();
+      _cached -= class_bytes;
+      _cache_hit_cnt++;
+      return ptr;
+    }
+  }
+  is_new = true;
+  return _SystemAlloc(class_bytes);
+}
+
+void CPUMemoryPool::_ReleaseBlock(void* ptr, size_t class_idx,
+                                  size_t class_bytes, bool to_thread_cache) {
+  if (_cached.load() + class_bytes > _max_cached_bytes) {
+    _SystemFree(ptr, class_bytes);
+    return;
+  }
+  _cached += class_bytes;
+  if (to_thread_cache && class_idx < kNumSmallSizeClasses) {
+    auto* cache = _GetThreadCache();
+    if (cache != nullptr) {
+      std::lock_guard<std::mutex> lock(cache->mtx);
+      auto& blocks = cache->blocks[class_idx];
+      if (blocks.size() < kThreadCacheBlocksPerClass &&
+          cache->cached_bytes + class_bytes <= kThreadCacheBytes) {
+        blocks.push_back(ptr);
+        cache->cached_bytes += class_bytes;
+        return;
+      }
+    }
+  }
+  std::lock_guard<std::mutex> lock(_mtx);
+  _free_blocks[class_idx].push_back(ptr);
+}
+
+void CPUMemoryPool::EmptyCache() {
+  {
+    std::lock_guard<std::mutex> lock(_thread_caches_mtx);
+    for (auto* cache : _thread_caches)
+      _FlushThreadCache(cache);
+  }
+  std::vector<std::vector<void*>> free_blocks(kNumSizeClasses);
+  {
+    std::lock_guard<std::mutex> lock(_mtx);
+    free_blocks.swap(_free_blocks);
+  }
+  for (size_t i = 0; i < free_blocks.size(); i++) {
+    size_t class_bytes = SizeClassBytes(i);
+    for (void* ptr : free_blocks[i]) {
+      _SystemFree(ptr, class_bytes);
+      _cached -= class_bytes;
+    }
+  }
 }
 
 DataPtr CPUMemoryPool::AllocDataSpace(size_t num_bytes, const Stream& stream) {
   if (num_bytes == 0)
     return DataPtr{nullptr, 0, Device(kCPU), static_cast<uint64_t>(-1)};
 
-  std::lock_guard<std::mutex> lock(_mtx);
   auto alignment = get_data_alignment();
   size_t aligned_num_bytes = DIVUP(num_bytes, alignment) * alignment;
-  
-  // Currently the allocation on host memory is blocking. Remember to check for
-  // the synchronization of allocation stream when freeing or waiting 
-  // if the allocation becomes non-blocking.
-  void* ptr;
-  int err = posix_memalign(&ptr, alignment, aligned_num_bytes);
-  HT_BAD_ALLOC_IF(err != 0)
-    << "Failed to allocate " << aligned_num_bytes
-    << " bytes of host memory. Error: " << strerror(err);
-  DataPtr data_ptr{ptr, aligned_num_bytes, Device(kCPU), next_id()};
-  data_ptr.is_new_malloc = true;
-  _allocated += aligned_num_bytes;
-  _peak_allocated = MAX(_peak_allocated, _allocated);
+  size_t class_idx = SizeClassIndex(aligned_num_bytes);
+  size_t class_bytes = SizeClassBytes(class_idx);
+
+  // Cached blocks only come back once the streams using them are done (see
+  // `FreeDataSpace`), so the allocation itself is still blocking.
+  bool is_new;
+  void* ptr = _AcquireBlock(class_idx, class_bytes, is_new);
+  DataPtr data_ptr{ptr, aligned_num_bytes, Device(kCPU), _next_data_ptr_id++};
+  data_ptr.is_new_malloc = is_new;
+  UpdatePeak(_peak_allocated, _allocated += class_bytes);
   _alloc_cnt++;
 
   // Note: The `stream` argument might be a non-CPU stream
@@ -59,9 +305,10 @@ DataPtr CPUMemoryPool::AllocDataSpace(size_t num_bytes, const Stream& stream) {
   // before the join stream can deallocate the memory.
   Stream alloc_stream =
     stream.device().is_cpu() ? stream : Stream(Device(kCPU), kJoinStream);
-  auto insertion = _data_ptr_info.emplace(
-    data_ptr.id, 
-    CPUDataPtrInfo(data_ptr.ptr, aligned_num_bytes, alloc_stream));
+  auto& shard = _info_shard(data_ptr.id);
+  std::lock_guard<std::mutex> lock(shard.mtx);
+  auto insertion = shard.table.emplace(
+    data_ptr.id, CPUDataPtrInfo(data_ptr.ptr, class_bytes, alloc_stream));
   HT_RUNTIME_ERROR_IF(!insertion.second)
     << "Failed to insert data " << data_ptr << " to info";
 
@@ -80,14 +327,15 @@ DataPtr CPUMemoryPool::BorrowDataSpace(void* ptr, size_t num_bytes,
   if (num_bytes == 0)
     return DataPtr{nullptr, 0, Device(kCPU), static_cast<DataPtrId>(-1)};
   
-  std::lock_guard<std::mutex> lock(_mtx);
   // Note: The borrowed memory must be ready, so we use blocking stream here
-  DataPtr data_ptr{ptr, num_bytes, Device(kCPU), next_id()};
+  DataPtr data_ptr{ptr, num_bytes, Device(kCPU), _next_data_ptr_id++};
   Stream alloc_stream = Stream(Device(kCPU), kBlockingStream);
+  auto& shard = _info_shard(data_ptr.id);
+  std::lock_guard<std::mutex> lock(shard.mtx);
   auto insertion =
-    _data_ptr_info.emplace(data_ptr.id,
-                           CPUDataPtrInfo(data_ptr.ptr, data_ptr.size,
-                                          alloc_stream, std::move(deleter)));
+    shard.table.emplace(data_ptr.id,
+                        CPUDataPtrInfo(data_ptr.ptr, data_ptr.size,
+                                       alloc_stream, std::move(deleter)));
   HT_RUNTIME_ERROR_IF(!insertion.second)
     << "Failed to insert data " << data_ptr << " to info";
   _borrow_cnt++;
@@ -99,10 +347,11 @@ void CPUMemoryPool::FreeDataSpace(DataPtr data_ptr) {
   if (data_ptr.ptr == nullptr || data_ptr.size == 0)
     return;
 
-  std::lock_guard<std::mutex> lock(_mtx);
+  auto& shard = _info_shard(data_ptr.id);
+  std::unique_lock<std::mutex> lock(shard.mtx);
 
-  auto it = _data_ptr_info.find(data_ptr.id);
-  HT_RUNTIME_ERROR_IF(it == _data_ptr_info.end())
+  auto it = shard.table.find(data_ptr.id);
+  HT_RUNTIME_ERROR_IF(it == shard.table.end())
     << "Cannot find data " << data_ptr << " from info";
   auto& alloc_stream = it->second.alloc_stream;
   auto& dependent_events = it->second.dependent_events;
@@ -112,19 +361,21 @@ void CPUMemoryPool::FreeDataSpace(DataPtr data_ptr) {
   //     --- enqueue an async task in allocation stream to free directly.
   // (2) Used by streams other than allocation stream:
   //     --- enqueue an async task in join stream to wait for the events.
-  // `FreeDataSpace` would first hold the mutex and determine which case to go,
-  // and then the free fn holds the mutex later.
+  // The freed block goes back to the cache only when the task runs, so it
+  // is never handed out while a stream may still touch it.
   if (dependent_events.empty() ||
       (dependent_events.size() == 1 &&
         dependent_events.begin()->first == alloc_stream)) {
-    // If we do not ignore the blocking stream, it will immediately call the 
-    // `_free_on_alloc_stream_fn` and try to acquire the mutex, 
-    // leading to deadlock.
     if (!alloc_stream.is_blocking()) {
       CPUStream(alloc_stream)
         .EnqueueTask(
           [this, data_ptr]() { this->_free_on_alloc_stream_fn(data_ptr); },
           "FreeOnAllocStream");
+    } else {
+      // Blocks allocated on the blocking stream (including borrowed ones)
+      // are ready to be reused or handed back to their deleters.
+      lock.unlock();
+      _ReleaseDataPtr(data_ptr, false, false);
     }
   } else {
     CPUStream(Stream(Device(kCPU), kJoinStream))
@@ -134,43 +385,68 @@ void CPUMemoryPool::FreeDataSpace(DataPtr data_ptr) {
   }
 }
 
-void CPUMemoryPool::_FreeOnAllocStream(CPUMemoryPool* const pool,
-                                       DataPtr data_ptr) {
-  std::lock_guard<std::mutex> lock(pool->_mtx);
-  auto it = pool->_data_ptr_info.find(data_ptr.id);
-  HT_RUNTIME_ERROR_IF(it == pool->_data_ptr_info.end())
-    << "Cannot find data " << data_ptr << " in from info";
-  if (it->second.deleter) {
-    it->second.deleter(data_ptr);
+void CPUMemoryPool::_ReleaseDataPtr(DataPtr data_ptr, bool on_stream_worker,
+                                    bool wait_dependent_events) {
+  auto& shard = _info_shard(data_ptr.id);
+  std::unique_lock<std::mutex> lock(shard.mtx);
+  auto it = shard.table.find(data_ptr.id);
+  HT_RUNTIME_ERROR_IF(it == shard.table.end())
+    << "Cannot find data " << data_ptr << " from info";
+  if (wait_dependent_events) {
+    // Note: Currently the allocation on host memory is blocking, 
+    // so it is ok if the allocation stream is not marked.
+    auto& dependent_events = it->second.dependent_events;
+    // We do not need to lock the memory pool when waiting for the events
+    lock.unlock();
+    batch_sync_dependent_events(dependent_events);
+    lock.lock();
+  }
+  auto info = std::move(it->second);
+  shard.table.erase(it);
+  lock.unlock();
+  if (info.deleter) {
+    info.deleter(data_ptr);
   } else {
-    free(data_ptr.ptr);
+    size_t class_idx = SizeClassIndex(info.num_bytes);
+    // Stream workers rarely allocate, so blocks they release go to the
+    // shared free lists instead of hoarding in their own thread caches.
+    _ReleaseBlock(info.ptr, class_idx, info.num_bytes, !on_stream_worker);
+    _allocated -= info.num_bytes;
   }
-  pool->_allocated -= data_ptr.size;
-  pool->_data_ptr_info.erase(it);
-  pool->_free_cnt++;
+  _free_cnt++;
+}
+
+void CPUMemoryPool::_FreeOnAllocStream(CPUMemoryPool* const pool,
+                                       DataPtr data_ptr) {
+  pool->_ReleaseDataPtr(data_ptr, true, false);
 }
 
 void CPUMemoryPool::_FreeOnJoinStream(CPUMemoryPool* const pool,
                                       DataPtr data_ptr) {
-  std::unique_lock<std::mutex> lock(pool->_mtx);
-  auto it = pool->_data_ptr_info.find(data_ptr.id);
-  HT_RUNTIME_ERROR_IF(it == pool->_data_ptr_info.end())
-    << "Cannot find data " << data_ptr << " from info";
-  // Note: Currently the allocation on host memory is blocking, 
-  // so it is ok if the allocation stream is not marked.
-  auto& dependent_events = it->second.dependent_events;
-  // We do not need to lock the memory pool when waiting for the events
-  lock.unlock();
-  batch_sync_dependent_events(dependent_events);
-  if (it->second.deleter) {
-    it->second.deleter(data_ptr);
-  } else {
-    free(data_ptr.ptr);
+  pool->_ReleaseDataPtr(data_ptr, true, true);
+}
+
+// Work of the allocation stream is ordered before the free enqueued on it,
+// so its usage needs no event as long as no other stream uses the data.
+// Returns true if the usage by `stream` is covered that way. Otherwise, an
+// event is recorded on the allocation stream if its usage was skipped, so
+// that the free on the join stream waits for it as well.
+bool CPUMemoryPool::_MarkedByAllocStream(CPUDataPtrInfo& info,
+                                         const Stream& stream) {
+  auto& dependent_events = info.dependent_events;
+  if (stream == info.alloc_stream) {
+    if (dependent_events.empty()) {
+      info.used_by_alloc_stream = true;
+      return true;
+    }
+  } else if (info.used_by_alloc_stream &&
+             dependent_events.find(info.alloc_stream) ==
+               dependent_events.end()) {
+    auto event = std::make_shared<CPUEvent>(false);
+    event->Record(info.alloc_stream);
+    dependent_events[info.alloc_stream] = std::move(event);
   }
-  lock.lock();
-  pool->_allocated -= data_ptr.size;
-  pool->_data_ptr_info.erase(it);
-  pool->_free_cnt++;
+  return false;
 }
 
 void CPUMemoryPool::MarkDataSpaceUsedByStream(DataPtr data_ptr,
@@ -178,10 +454,13 @@ void CPUMemoryPool::MarkDataSpaceUsedByStream(DataPtr data_ptr,
   if (data_ptr.ptr == nullptr || data_ptr.size == 0 || stream.is_blocking())
     return;
 
-  std::lock_guard<std::mutex> lock(_mtx);
-  auto it = _data_ptr_info.find(data_ptr.id);
-  HT_RUNTIME_ERROR_IF(it == _data_ptr_info.end())
+  auto& shard = _info_shard(data_ptr.id);
+  std::lock_guard<std::mutex> lock(shard.mtx);
+  auto it = shard.table.find(data_ptr.id);
+  HT_RUNTIME_ERROR_IF(it == shard.table.end())
     << "Cannot find data " << data_ptr << " from info";
+  if (_MarkedByAllocStream(it->second, stream))
+    return;
   auto& dependent_events = it->second.dependent_events;
 
   if (stream.device().is_cpu()) {
@@ -205,26 +484,31 @@ void CPUMemoryPool::MarkDataSpacesUsedByStream(DataPtrList& data_ptrs,
   if (stream.is_blocking())
     return;
 
-  std::lock_guard<std::mutex> lock(_mtx);
-  // share the event
+  // share the event, which is only recorded if some data needs it
   std::shared_ptr<Event> event = nullptr;
-  if (stream.device().is_cpu()) {
-    event = std::make_shared<CPUEvent>(false);
-    event->Record(stream);
-  } else if (stream.device().is_cuda()) {
-    event = std::make_shared<CUDAEvent>(stream.device(), false);
-    event->Record(stream);
-  } else {
-    HT_RUNTIME_ERROR << "CPU arrays must be used on cpu or cuda streams. Got "
-                     << stream;
-    __builtin_unreachable();
-  }
   for (auto& data_ptr : data_ptrs) {
     if (data_ptr.ptr == nullptr || data_ptr.size == 0)
       continue;
-    auto it = _data_ptr_info.find(data_ptr.id);
-    HT_RUNTIME_ERROR_IF(it == _data_ptr_info.end())
+    auto& shard = _info_shard(data_ptr.id);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    auto it = shard.table.find(data_ptr.id);
+    HT_RUNTIME_ERROR_IF(it == shard.table.end())
       << "Cannot find data " << data_ptr << " from info";
+    if (_MarkedByAllocStream(it->second, stream))
+      continue;
+    if (event == nullptr) {
+      if (stream.device().is_cpu()) {
+        event = std::make_shared<CPUEvent>(false);
+        event->Record(stream);
+      } else if (stream.device().is_cuda()) {
+        event = std::make_shared<CUDAEvent>(stream.device(), false);
+        event->Record(stream);
+      } else {
+        HT_RUNTIME_ERROR
+          << "CPU arrays must be used on cpu or cuda streams. Got " << stream;
+        __builtin_unreachable();
+      }
+    }
     it->second.dependent_events[stream] = event;
     _mark_cnt++;
   }
@@ -234,15 +518,26 @@ std::future<void> CPUMemoryPool::WaitDataSpace(DataPtr data_ptr, bool async) {
   if (data_ptr.ptr == nullptr || data_ptr.size == 0)
     return async ? std::async([]() {}) : std::future<void>();
 
-  std::lock_guard<std::mutex> lock(_mtx);
-  auto it = _data_ptr_info.find(data_ptr.id);
-  HT_RUNTIME_ERROR_IF(it == _data_ptr_info.end())
+  auto& shard = _info_shard(data_ptr.id);
+  std::lock_guard<std::mutex> lock(shard.mtx);
+  auto it = shard.table.find(data_ptr.id);
+  HT_RUNTIME_ERROR_IF(it == shard.table.end())
     << "Cannot find data " << data_ptr << " from info";
   auto& alloc_stream = it->second.alloc_stream;
   auto& dependent_events = it->second.dependent_events;
 
   std::future<void> future;
-  if (dependent_events.empty()) {
+  if (dependent_events.empty() && it->second.used_by_alloc_stream) {
+    // The allocation stream used the data without marking it, so we wait
+    // for what it has enqueued so far.
+    auto event = std::make_shared<CPUEvent>(false);
+    event->Record(alloc_stream);
+    if (async) {
+      future = std::async([event]() mutable { event->Sync(); });
+    } else {
+      event->Sync();
+    }
+  } else if (dependent_events.empty()) {
     // Note: Currently the allocation on host memory is blocking, 
     // so we can do nothing here.
     if (async) {
@@ -274,22 +569,61 @@ std::future<void> CPUMemoryPool::WaitDataSpace(DataPtr data_ptr, bool async) {
 void CPUMemoryPool::PrintSummary() {
   HT_LOG_INFO << name() << ": alloc=" << _allocated << " bytes, "
     << "peak_alloc=" << _peak_allocated << " bytes, "
+    << "reserved=" << _reserved << " bytes, "
+    << "peak_reserved=" << _peak_reserved << " bytes, "
+    << "cached=" << _cached << " bytes, "
+    << "huge_page_reserved=" << _huge_page_reserved << " bytes, "
     << "alloc_cnt=" << _alloc_cnt << ", "
     << "borrow_cnt=" << _borrow_cnt << ", "
     << "free_cnt=" << _free_cnt << ", "
-    << "mark_cnt=" << _mark_cnt;
+    << "mark_cnt=" << _mark_cnt << ", "
+    << "thread_cache_hit_cnt=" << _thread_cache_hit_cnt << ", "
+    << "cache_hit_cnt=" << _cache_hit_cnt << ", "
+    << "sys_alloc_cnt=" << _sys_alloc_cnt << ", "
+    << "sys_free_cnt=" << _sys_free_cnt;
 }
 
 namespace {
 
 static std::once_flag cpu_memory_pool_register_flag;
 
+static size_t ParseMaxCachedSize() {
+  const char* max_cached_str = std::getenv("HETU_CPU_MEMPOOL_MAX_CACHED_MB");
+  if (max_cached_str != NULL) {
+    try {
+      return static_cast<size_t>(std::stoul(max_cached_str)) * 1024 * 1024;
+    } catch (const std::exception& e) {
+      HT_LOG_WARN
+        << "Invalid HETU_CPU_MEMPOOL_MAX_CACHED_MB: " << max_cached_str
+        << " is set, please provide an integer"
+        << ", default value will be used in this process.";
+    }
+  }
+  return std::numeric_limits<size_t>::max();
+}
+
+static bool ParseUseHugePages() {
+  const char* huge_page_str = std::getenv("HETU_CPU_MEMPOOL_HUGE_PAGE");
+  if (huge_page_str != NULL) {
+    try {
+      return std::stoi(huge_page_str) != 0;
+    } catch (const std::exception& e) {
+      HT_LOG_WARN
+        << "Invalid HETU_CPU_MEMPOOL_HUGE_PAGE: " << huge_page_str
+        << " is set, please provide an integer"
+        << ", default value will be used in this process.";
+    }
+  }
+  return true;
+}
+
 struct CPUMemoryPoolRegister {
   CPUMemoryPoolRegister() {
     std::call_once(cpu_memory_pool_register_flag, []() {
       RegisterMemoryPoolCtor(
           Device(kCPU), []() -> std::shared_ptr<MemoryPool> {
-            return std::make_shared<CPUMemoryPool>();
+            return std::make_shared<CPUMemoryPool>(ParseMaxCachedSize(),
+                                                   ParseUseHugePages());
           });
     });
   }
@@ -3,13 +3,29 @@
 #include "hetu/core/memory_pool.h"
 #include "hetu/utils/task_queue.h"
 #include <functional>
+#include <array>
+#include <atomic>
+#include <limits>
 
 namespace hetu {
 namespace impl {
 
+// A caching allocator for host memory. Freed blocks are kept in size-classed
+// free lists (4 classes per power of two) and handed out again instead of
+// going back to libc. As before, a block is only released after the streams
+// using it are done with it: on its allocation stream, or on the join stream
+// after waiting for every stream that used it.
+//
+// - Small blocks (<= 256KiB) go through a per-thread cache first, so most
+//   allocations of small tensors do not touch the shared free lists.
+// - Blocks of at least 2MiB are mmap-ed on 2MiB boundaries and advised to
+//   use transparent huge pages (HETU_CPU_MEMPOOL_HUGE_PAGE=0 disables it).
+// - HETU_CPU_MEMPOOL_MAX_CACHED_MB bounds the cached bytes. Blocks freed
+//   beyond the bound return to the system, and 0 disables caching.
 class CPUMemoryPool final : public MemoryPool {
  public:
-  CPUMemoryPool();
+  CPUMemoryPool(size_t max_cached_bytes = std::numeric_limits<size_t>::max(),
+                bool use_huge_pages = true);
 
   ~CPUMemoryPool();
 
@@ -27,6 +43,10 @@ class CPUMemoryPool final : public MemoryPool {
 
   void PrintSummary();
 
+  // Returns all cached blocks, including those in per-thread caches,
+  // to the system.
+  void EmptyCache();
+
   inline size_t get_data_alignment() const noexcept {
     return 16;
   }
@@ -38,6 +58,9 @@ class CPUMemoryPool final : public MemoryPool {
     Stream alloc_stream;
     DataPtrDeleter deleter;
     std::unordered_map<Stream, std::shared_ptr<Event>> dependent_events;
+    // Whether the allocation stream used the data without being marked in
+    // `dependent_events`, see `_MarkedByAllocStream`.
+    bool used_by_alloc_stream = false;
 
     CPUDataPtrInfo(void* ptr_, size_t num_bytes_, Stream alloc_stream_,
                    DataPtrDeleter deleter_ = {})
@@ -47,19 +70,62 @@ class CPUMemoryPool final : public MemoryPool {
       deleter{std::move(deleter_)} {}
   };
 
+  // The info table is sharded by data ptr id so that concurrent
+  // allocations and frees do not serialize on a single mutex.
+  struct InfoShard {
+    std::mutex mtx;
+    std::unordered_map<uint64_t, CPUDataPtrInfo> table;
+  };
+  static constexpr size_t kNumInfoShards = 32;
+
+  struct ThreadCache;
+  friend struct ThreadCache;
+
+  inline InfoShard& _info_shard(DataPtrId id) {
+    return _info_shards[id % kNumInfoShards];
+  }
+
+  void* _AcquireBlock(size_t class_idx, size_t class_bytes, bool& is_new);
+  void _ReleaseBlock(void* ptr, size_t class_idx, size_t class_bytes,
+                     bool to_thread_cache);
+  void* _SystemAlloc(size_t num_bytes);
+  void _SystemFree(void* ptr, size_t num_bytes);
+  void _ReleaseDataPtr(DataPtr data_ptr, bool on_stream_worker,
+                       bool wait_dependent_events);
+  bool _MarkedByAllocStream(CPUDataPtrInfo& info, const Stream& stream);
+  ThreadCache* _GetThreadCache();
+  void _FlushThreadCache(ThreadCache* cache);
+
   static void _FreeOnAllocStream(CPUMemoryPool* const pool, DataPtr ptr);
   static void _FreeOnJoinStream(CPUMemoryPool* const pool, DataPtr ptr);
 
-  std::unordered_map<uint64_t, CPUDataPtrInfo> _data_ptr_info;
+  std::array<InfoShard, kNumInfoShards> _info_shards;
   std::function<void(DataPtr)> _free_on_alloc_stream_fn;
   std::function<void(DataPtr)> _free_on_join_stream_fn;
-
-  size_t _allocated{0};
-  size_t _peak_allocated{0};
-  uint64_t _alloc_cnt{0};
-  uint64_t _borrow_cnt{0};
-  uint64_t _free_cnt{0};
-  uint64_t _mark_cnt{0};
+  std::atomic<DataPtrId> _next_data_ptr_id{0};
+
+  const size_t _max_cached_bytes;
+  const bool _use_huge_pages;
+  // Free lists indexed by size class, protected by `_mtx`.
+  std::vector<std::vector<void*>> _free_blocks;
+  // Registered per-thread caches, protected by `_thread_caches_mtx`.
+  std::vector<ThreadCache*> _thread_caches;
+  std::mutex _thread_caches_mtx;
+
+  std::atomic<size_t> _allocated{0};
+  std::atomic<size_t> _peak_allocated{0};
+  std::atomic<size_t> _reserved{0};
+  std::atomic<size_t> _peak_reserved{0};
+  std::atomic<size_t> _cached{0};
+  std::atomic<size_t> _huge_page_reserved{0};
+  std::atomic<uint64_t> _alloc_cnt{0};
+  std::atomic<uint64_t> _borrow_cnt{0};
+  std::atomic<uint64_t> _free_cnt{0};
+  std::atomic<uint64_t> _mark_cnt{0};
+  std::atomic<uint64_t> _thread_cache_hit_cnt{0};
+  std::atomic<uint64_t> _cache_hit_cnt{0};
+  std::atomic<uint64_t> _sys_alloc_cnt{0};
+  std::atomic<uint64_t> _sys_free_cnt{0};
 };
 
 } // namespace impl
@@ -0,0 +1,47 @@
+#include "hetu/impl/memory/HostStagingPool.h"
+#include "hetu/impl/utils/cuda_utils.h"
+#include <cctype>
+#include <fstream>
+
+namespace hetu {
+namespace impl {
+
+namespace {
+
+static int GetCUDADeviceNumaNode(const Device& device) {
+  if (!device.is_cuda())
+    return -1;
+  char bus_id[32];
+  if (cudaDeviceGetPCIBusId(bus_id, sizeof(bus_id), device.index()) !=
+      cudaSuccess)
+    return -1;
+  std::string path = "/sys/bus/pci/devices/";
+  for (const char* c = bus_id; *c != '\0'; c++)
+    path.push_back(std::tolower(*c));
+  std::ifstream ifs(path + "/numa_node");
+  int numa_node = -1;
+  if (!(ifs >> numa_node))
+    return -1;
+  return numa_node;
+}
+
+struct CUDAHostStagingHooksRegister {
+  CUDAHostStagingHooksRegister() {
+    HostStagingHooks hooks;
+    hooks.pin = [](void* ptr, size_t num_bytes) {
+      CUDA_CALL(cudaHostRegister(ptr, num_bytes, cudaHostRegisterDefault));
+    };
+    hooks.unpin = [](void* ptr, size_t num_bytes) {
+      CUDA_CALL(cudaHostUnregister(ptr));
+    };
+    hooks.device_numa_node = GetCUDADeviceNumaNode;
+    RegisterHostStagingHooks(std::move(hooks));
+  }
+};
+
+static CUDAHostStagingHooksRegister cuda_host_staging_hooks_register;
+
+} // namespace
+
+} // namespace impl
+} // namespace hetu
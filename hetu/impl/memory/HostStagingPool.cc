@@ -0,0 +1,266 @@
+#include "hetu/impl/memory/HostStagingPool.h"
+#include <fstream>
+#include <mutex>
+#include <cstdlib>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace hetu {
+namespace impl {
+
+namespace {
+
+constexpr size_t kStagingPageSize = 4096;
+constexpr size_t kStagingMinBufferSize = 65536; // 64KiB
+constexpr int kMpolBind = 2; // MPOL_BIND in <numaif.h>
+
+// Function-local so that hooks can be registered from the static
+// initializers of other translation units.
+static std::mutex& host_staging_hooks_mutex() {
+  static std::mutex mtx;
+  return mtx;
+}
+
+static HostStagingHooks& registered_host_staging_hooks() {
+  static HostStagingHooks hooks;
+  return hooks;
+}
+
+static int DetectNumNumaNodes() {
+  // e.g., "0" or "0-3"
+  std::ifstream ifs("/sys/devices/system/node/online");
+  std::string online;
+  if (!(ifs >> online))
+    return 1;
+  auto pos = online.find_last_of("-,");
+  try {
+    return std::stoi(pos == std::string::npos ? online
+                                               : online.substr(pos + 1)) + 1;
+  } catch (const std::exception& e) {
+    return 1;
+  }
+}
+
+static int CurrentNumaNode() {
+#ifdef SYS_getcpu
+  unsigned cpu = 0, node = 0;
+  if (syscall(SYS_getcpu, &cpu, &node, nullptr) == 0)
+    return static_cast<int>(node);
+#endif
+  return 0;
+}
+
+static void MbindToNumaNode(void* ptr, size_t num_bytes, int numa_node) {
+#ifdef SYS_mbind
+  if (numa_node < 0 || numa_node >= 64)
+    return;
+  unsigned long nodemask = 1UL << numa_node;
+  if (syscall(SYS_mbind, ptr, num_bytes, kMpolBind, &nodemask,
+              sizeof(nodemask) * 8, 0) != 0) {
+    HT_LOG_DEBUG << "Failed to bind " << num_bytes
+                 << " bytes of staging memory to NUMA node " << numa_node
+                 << ": " << strerror(errno);
+  }
+#endif
+}
+
+static HostStagingHooks FillDefaultHooks(HostStagingHooks hooks) {
+  if (!hooks.pin)
+    hooks.pin = [](void*, size_t) {};
+  if (!hooks.unpin)
+    hooks.unpin = [](void*, size_t) {};
+  if (!hooks.bind_to_numa_node)
+    hooks.bind_to_numa_node = MbindToNumaNode;
+  if (!hooks.device_numa_node)
+    hooks.device_numa_node = [](const Device&) { return -1; };
+  return hooks;
+}
+
+static size_t ParseStagingArenaSize() {
+  const char* arena_str = std::getenv("HETU_HOST_STAGING_ARENA_MB");
+  size_t arena_mb = 256;
+  if (arena_str != NULL) {
+    try {
+      arena_mb = std::stoul(arena_str);
+    } catch (const std::exception& e) {
+      HT_LOG_WARN
+        << "Invalid HETU_HOST_STAGING_ARENA_MB: " << arena_str << " is set"
+        << ", please provide an integer"
+        << ", default value will be used in this process.";
+    }
+  }
+  return MAX(arena_mb, 1UL) * 1024 * 1024;
+}
+
+} // namespace
+
+void RegisterHostStagingHooks(HostStagingHooks hooks) {
+  std::lock_guard<std::mutex> lock(host_staging_hooks_mutex());
+  registered_host_staging_hooks() = std::move(hooks);
+}
+
+// Size classes: 64KiB, then 4 evenly spaced classes in each
+// (2^p, 2^(p+1)], all of which are multiples of the page size.
+size_t HostStagingPool::SizeClassBytes(size_t num_bytes) {
+  if (num_bytes <= kStagingMinBufferSize)
+    return kStagingMinBufferSize;
+  size_t p = 63 - __builtin_clzll(num_bytes - 1);
+  size_t step = static_cast<size_t>(1) << (p - 2);
+  return DIVUP(num_bytes, step) * step;
+}
+
+HostStagingPool::HostStagingPool(size_t arena_bytes, int num_numa_nodes,
+                                 HostStagingHooks hooks)
+: _arena_bytes(DIVUP(arena_bytes, kStagingPageSize) * kStagingPageSize),
+  _num_numa_nodes(num_numa_nodes),
+  _hooks(FillDefaultHooks(std::move(hooks))),
+  _partitions(num_numa_nodes) {
+  HT_VALUE_ERROR_IF(arena_bytes == 0) << "Arena size must be positive";
+  HT_VALUE_ERROR_IF(num_numa_nodes <= 0)
+    << "Number of NUMA nodes must be positive, got " << num_numa_nodes;
+}
+
+HostStagingPool::~HostStagingPool() {
+  std::lock_guard<std::mutex> lock(_mtx);
+  for (auto& partition : _partitions) {
+    for (auto& arena : partition.arenas) {
+      _hooks.unpin(arena.base, arena.num_bytes);
+      munmap(arena.base, arena.num_bytes);
+    }
+  }
+}
+
+void* HostStagingPool::_CarveFromArenas(NumaPartition& partition,
+                                        size_t num_bytes, int numa_node) {
+  for (auto& arena : partition.arenas) {
+    if (arena.num_bytes - arena.offset >= num_bytes) {
+      void* ptr = static_cast<char*>(arena.base) + arena.offset;
+      arena.offset += num_bytes;
+      return ptr;
+    }
+  }
+  // Buffers larger than an arena get a dedicated one.
+  size_t arena_bytes = MAX(_arena_bytes, num_bytes);
+  void* base = mmap(nullptr, arena_bytes, PROT_READ | PROT_WRITE,
+                    MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  HT_BAD_ALLOC_IF(base == MAP_FAILED)
+    << "Failed to allocate " << arena_bytes
+    << " bytes of host staging memory. Error: " << strerror(errno);
+  // Bind before pinning, since pinning faults the pages in.
+  _hooks.bind_to_numa_node(base, arena_bytes, numa_node);
+  _hooks.pin(base, arena_bytes);
+  partition.arenas.push_back({base, arena_bytes, num_bytes});
+  partition.stats.num_arenas++;
+  partition.stats.pinned_bytes += arena_bytes;
+  return base;
+}
+
+void* HostStagingPool::Acquire(size_t num_bytes, int numa_node) {
+  if (numa_node < 0)
+    numa_node = CurrentNumaNode();
+  numa_node = numa_node % _num_numa_nodes;
+  size_t buffer_bytes = SizeClassBytes(num_bytes);
+
+  std::lock_guard<std::mutex> lock(_mtx);
+  auto& partition = _partitions[numa_node];
+  partition.stats.acquire_cnt++;
+  void* ptr;
+  auto it = partition.free_buffers.find(buffer_bytes);
+  if (it != partition.free_buffers.end() && !it->second.empty()) {
+    ptr = it->second.back();
+    it->second.pop_back();
+    partition.stats.cached_bytes -= buffer_bytes;
+    partition.stats.reuse_cnt++;
+    _buffers[ptr].in_use = true;
+  } else {
+    ptr = _CarveFromArenas(partition, buffer_bytes, numa_node);
+    _buffers[ptr] = {numa_node, buffer_bytes, true};
+  }
+  partition.stats.in_use_bytes += buffer_bytes;
+  return ptr;
+}
+
+void HostStagingPool::Recycle(void* ptr) {
+  std::lock_guard<std::mutex> lock(_mtx);
+  auto it = _buffers.find(ptr);
+  HT_RUNTIME_ERROR_IF(it == _buffers.end())
+    << "Buffer " << ptr << " does not belong to the host staging pool";
+  auto& buffer = it->second;
+  HT_RUNTIME_ERROR_IF(!buffer.in_use)
+    << "Buffer " << ptr << " has been recycled twice";
+  buffer.in_use = false;
+  auto& partition = _partitions[buffer.numa_node];
+  partition.free_buffers[buffer.num_bytes].push_back(ptr);
+  partition.stats.in_use_bytes -= buffer.num_bytes;
+  partition.stats.cached_bytes += buffer.num_bytes;
+}
+
+DataPtr HostStagingPool::AllocDataSpace(size_t num_bytes,
+                                        const Device& device) {
+  void* ptr = Acquire(num_bytes, NumaNodeOf(device));
+  return BorrowToMemoryPool(Device(kCPU), ptr, num_bytes,
+                            [this](DataPtr data_ptr) {
+                              this->Recycle(data_ptr.ptr);
+                            });
+}
+
+int HostStagingPool::NumaNodeOf(const Device& device) const {
+  return _hooks.device_numa_node(device);
+}
+
+int HostStagingPool::NumaNodeOf(void* ptr) const {
+  std::lock_guard<std::mutex> lock(_mtx);
+  auto it = _buffers.find(ptr);
+  return it == _buffers.end() ? -1 : it->second.numa_node;
+}
+
+HostStagingPool::Stats HostStagingPool::stats(int numa_node) const {
+  HT_VALUE_ERROR_IF(numa_node < 0 || numa_node >= _num_numa_nodes)
+    << "Invalid NUMA node " << numa_node;
+  std::lock_guard<std::mutex> lock(_mtx);
+  return _partitions[numa_node].stats;
+}
+
+HostStagingPool::Stats HostStagingPool::stats() const {
+  Stats ret;
+  for (int i = 0; i < _num_numa_nodes; i++) {
+    auto s = stats(i);
+    ret.num_arenas += s.num_arenas;
+    ret.pinned_bytes += s.pinned_bytes;
+    ret.in_use_bytes += s.in_use_bytes;
+    ret.cached_bytes += s.cached_bytes;
+    ret.acquire_cnt += s.acquire_cnt;
+    ret.reuse_cnt += s.reuse_cnt;
+  }
+  return ret;
+}
+
+void HostStagingPool::PrintSummary() const {
+  for (int i = 0; i < _num_numa_nodes; i++) {
+    auto s = stats(i);
+    HT_LOG_INFO << "HostStagingPool(node " << i << "): "
+      << "arenas=" << s.num_arenas << ", "
+      << "pinned=" << s.pinned_bytes << " bytes, "
+      << "in_use=" << s.in_use_bytes << " bytes, "
+      << "cached=" << s.cached_bytes << " bytes, "
+      << "acquire_cnt=" << s.acquire_cnt << ", "
+      << "reuse_cnt=" << s.reuse_cnt;
+  }
+}
+
+HostStagingPool& GetHostStagingPool() {
+  // Leaked on purpose: buffers may be recycled by stream workers during
+  // static destruction.
+  static HostStagingPool* pool = []() {
+    std::lock_guard<std::mutex> lock(host_staging_hooks_mutex());
+    return new HostStagingPool(ParseStagingArenaSize(), DetectNumNumaNodes(),
+                               registered_host_staging_hooks());
+  }();
+  return *pool;
+}
+
+} // namespace impl
+} // namespace hetu
@@ -0,0 +1,115 @@
+#pragma once
+
+#include "hetu/core/memory_pool.h"
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+namespace hetu {
+namespace impl {
+
+// Platform hooks of the host staging pool. They are injectable so that the
+// allocate/recycle logic and NUMA placement can be exercised without CUDA.
+struct HostStagingHooks {
+  // Page-locks [ptr, ptr + num_bytes). Called once per arena.
+  std::function<void(void*, size_t)> pin;
+  // Undoes `pin` before an arena is unmapped.
+  std::function<void(void*, size_t)> unpin;
+  // Binds the (untouched) pages of [ptr, ptr + num_bytes) to a NUMA node.
+  std::function<void(void*, size_t, int)> bind_to_numa_node;
+  // Returns the NUMA node closest to a device, or -1 if unknown.
+  std::function<int(const Device&)> device_numa_node;
+};
+
+// Hooks used by the process-wide pool returned by `GetHostStagingPool`.
+// Must be called before the pool is first used, e.g., at static
+// initialization (see CUDAHostStagingHooks.cu).
+void RegisterHostStagingHooks(HostStagingHooks hooks);
+
+// A pool of page-locked host buffers for D2H/H2D staging (e.g., activation
+// offloading). Memory is obtained in large arenas, each bound to one NUMA
+// node and pinned exactly once. Buffers are carved from the arenas, rounded
+// to size classes, and recycled by size across micro-batches and steps
+// instead of being allocated from scratch.
+class HostStagingPool final {
+ public:
+  struct Stats {
+    size_t num_arenas{0};
+    size_t pinned_bytes{0};
+    size_t in_use_bytes{0};
+    size_t cached_bytes{0};
+    uint64_t acquire_cnt{0};
+    uint64_t reuse_cnt{0};
+  };
+
+  HostStagingPool(size_t arena_bytes, int num_numa_nodes,
+                  HostStagingHooks hooks = {});
+
+  ~HostStagingPool();
+
+  // Returns a page-aligned buffer of at least `num_bytes` on `numa_node`.
+  // A negative `numa_node` means the node of the calling thread.
+  void* Acquire(size_t num_bytes, int numa_node = -1);
+
+  // Makes a buffer returned by `Acquire` available for reuse.
+  void Recycle(void* ptr);
+
+  // Acquires a buffer near `device` and wraps it as a CPU data ptr. The
+  // buffer is recycled when the CPU memory pool frees the data ptr, i.e.,
+  // after all streams that used it are done with it.
+  DataPtr AllocDataSpace(size_t num_bytes, const Device& device);
+
+  int NumaNodeOf(const Device& device) const;
+
+  int NumaNodeOf(void* ptr) const;
+
+  Stats stats() const;
+
+  Stats stats(int numa_node) const;
+
+  void PrintSummary() const;
+
+  inline int num_numa_nodes() const noexcept {
+    return _num_numa_nodes;
+  }
+
+  inline size_t arena_bytes() const noexcept {
+    return _arena_bytes;
+  }
+
+  static size_t SizeClassBytes(size_t num_bytes);
+
+ private:
+  struct Arena {
+    void* base;
+    size_t num_bytes;
+    size_t offset;
+  };
+
+  struct Buffer {
+    int numa_node;
+    size_t num_bytes;
+    bool in_use;
+  };
+
+  struct NumaPartition {
+    std::vector<Arena> arenas;
+    std::unordered_map<size_t, std::vector<void*>> free_buffers;
+    Stats stats;
+  };
+
+  void* _CarveFromArenas(NumaPartition& partition, size_t num_bytes,
+                         int numa_node);
+
+  const size_t _arena_bytes;
+  const int _num_numa_nodes;
+  HostStagingHooks _hooks;
+  std::vector<NumaPartition> _partitions;
+  std::unordered_map<void*, Buffer> _buffers;
+  mutable std::mutex _mtx;
+};
+
+HostStagingPool& GetHostStagingPool();
+
+} // namespace impl
+} // namespace hetu
@@ -1,4 +1,5 @@
 #include "hetu/impl/profiler/profiler.h"
+#include "hetu/impl/utils/dnnl_utils.h"
 
 namespace hetu {
 namespace impl {
@@ -12,6 +13,21 @@ ProfileId Profile::_next_profile_id() {
   return _global_profile_id++;
 }
 
+std::pair<uint64_t, uint64_t> Profile::_dnnl_primitive_cache_counts() {
+  auto stats = hetu::cpu::GetDNNLPrimitiveCacheStats();
+  return {stats.hits, stats.misses};
+}
+
+std::vector<std::pair<std::string, uint64_t>>
+Profile::get_dnnl_primitive_cache_view() {
+  auto stats = hetu::cpu::GetDNNLPrimitiveCacheStats();
+  return {{"hits", stats.hits - _dnnl_primitive_cache_base.first},
+          {"misses", stats.misses - _dnnl_primitive_cache_base.second},
+          {"evictions", stats.evictions},
+          {"size", stats.size},
+          {"capacity", stats.capacity}};
+}
+
 void Profile::Init() {
   // exit handler
   auto status = std::atexit([]() {
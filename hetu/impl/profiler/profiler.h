@@ -27,7 +27,8 @@ class Profile {
   Profile(bool enabled = true, bool use_cpu = false, bool use_cuda = false,
           bool record_shapes = false, bool profile_memory = false)
   : _id(_next_profile_id()), _enabled(enabled), _use_cpu(use_cpu), _use_cuda(use_cuda),
-    _record_shapes(record_shapes), _profile_memory(profile_memory), _device(Device()) {}
+    _record_shapes(record_shapes), _profile_memory(profile_memory), _device(Device()),
+    _dnnl_primitive_cache_base(_dnnl_primitive_cache_counts()) {}
 
   Profile(const Profile&) = delete;
   Profile& operator=(const Profile&) = delete;
@@ -156,10 +157,17 @@ class Profile {
     sync_op();
     return  _op_record;
   }
+
+  // Hits and misses of the dnnl primitive cache (shared by all CPU kernels)
+  // since this profile was created. Steady-state training on CPU should
+  // report no misses, i.e., no primitive creation.
+  std::vector<std::pair<std::string, uint64_t>> get_dnnl_primitive_cache_view();
  
  private:
   static ProfileId _next_profile_id();
 
+  static std::pair<uint64_t, uint64_t> _dnnl_primitive_cache_counts();
+
  protected:
   ProfileId _id;
   bool _enabled;
@@ -171,6 +179,7 @@ class Profile {
   std::vector<std::pair<std::string, double>> _graph_view_record;
   std::vector<OpProfilerInfo> _op_record;
   std::vector<hetu::graph::Operator> _ops;
+  std::pair<uint64_t, uint64_t> _dnnl_primitive_cache_base;
 
   static void InitOnce() {
     std::call_once(Profile::_init_flag, Profile::Init);
@@ -1,28 +1,50 @@
 #include "hetu/impl/stream/CPUStream.h"
-#include "hetu/utils/task_queue.h"
+#include "hetu/utils/work_stealing_executor.h"
 #include <mutex>
+#include <cstdlib>
 
 namespace hetu {
 namespace impl {
 
 namespace {
 
-static std::once_flag
-  cpu_stream_task_queue_init_flags[HT_NUM_STREAMS_PER_DEVICE];
-static std::vector<std::unique_ptr<TaskQueue>>
-  cpu_stream_task_queues(HT_NUM_STREAMS_PER_DEVICE);
+static std::once_flag cpu_stream_executor_init_flag;
+static std::unique_ptr<WorkStealingExecutor> cpu_stream_executor;
 
-static void InitTaskQueueForCPUStream(StreamIndex stream_index) {
-  HT_ASSERT(cpu_stream_task_queues[stream_index] == nullptr)
-    << "CPUStream task queues must be initialized by calling "
-    << "InitTaskQueueForCPUStreamOnce";
-  cpu_stream_task_queues[stream_index].reset(
-    new TaskQueue("CPUStream(" + std::to_string(stream_index) + ")", 1));
+// Tasks on CPU streams (e.g., MPI collectives) may block their worker, so
+// by default every non-blocking stream can hold a worker at the same time,
+// just like the former one-thread-per-stream task queues.
+static size_t ParseNumCPUStreamWorkers() {
+  size_t num_workers = HT_NUM_STREAMS_PER_DEVICE - 1;
+  const char* num_workers_str = std::getenv("HETU_CPU_STREAM_NUM_WORKERS");
+  if (num_workers_str != NULL) {
+    try {
+      num_workers = std::stoul(num_workers_str);
+    } catch (const std::exception& e) {
+      HT_LOG_WARN
+        << "Invalid HETU_CPU_STREAM_NUM_WORKERS: " << num_workers_str
+        << " is set, please provide an integer"
+        << ", default value will be used in this process.";
+    }
+    if (num_workers == 0) {
+      HT_LOG_WARN << "HETU_CPU_STREAM_NUM_WORKERS must be positive"
+                  << ", 1 worker will be used in this process.";
+      num_workers = 1;
+    }
+  }
+  return num_workers;
+}
+
+static void InitCPUStreamExecutor() {
+  HT_ASSERT(cpu_stream_executor == nullptr)
+    << "CPUStream executor must be initialized by calling "
+    << "InitCPUStreamExecutorOnce";
+  cpu_stream_executor.reset(new WorkStealingExecutor(
+    "CPUStream", ParseNumCPUStreamWorkers(), HT_NUM_STREAMS_PER_DEVICE));
 }
 
-static void InitTaskQueueForCPUStreamOnce(StreamIndex stream_index) {
-  std::call_once(cpu_stream_task_queue_init_flags[stream_index],
-                 InitTaskQueueForCPUStream, stream_index);
+static void InitCPUStreamExecutorOnce() {
+  std::call_once(cpu_stream_executor_init_flag, InitCPUStreamExecutor);
 }
 
 } // namespace
@@ -42,15 +64,26 @@ std::future<void> CPUStream::EnqueueTask(std::function<void()> f,
     f();
     return std::future<void>();
   } else {
-    InitTaskQueueForCPUStreamOnce(_stream_id);
-    return cpu_stream_task_queues[_stream_id]->Enqueue(f, name);
+    InitCPUStreamExecutorOnce();
+    return cpu_stream_executor->Enqueue(_stream_id, std::move(f), name);
+  }
+}
+
+void CPUStream::EnqueueWait(std::shared_ptr<TaskDependency> dependency) {
+  if (_stream_id == kBlockingStream) {
+    std::promise<void> satisfied;
+    auto future = satisfied.get_future();
+    if (dependency->AddWaiter([&satisfied] { satisfied.set_value(); }))
+      future.wait();
+  } else {
+    InitCPUStreamExecutorOnce();
+    cpu_stream_executor->EnqueueWait(_stream_id, std::move(dependency));
   }
 }
 
 void CPUStream::Sync() {
-  if (_stream_id == kBlockingStream ||
-      cpu_stream_task_queues[_stream_id] == nullptr ||
-      !cpu_stream_task_queues[_stream_id]->running())
+  if (_stream_id == kBlockingStream || cpu_stream_executor == nullptr ||
+      !cpu_stream_executor->running())
     return;
   // Walkaround: Instead of blocking the task queues,
   // we create an event for simplicity.
@@ -60,7 +93,7 @@ void CPUStream::Sync() {
 }
 
 void SynchronizeAllCPUStreams() {
-  for (size_t i = 0; i < cpu_stream_task_queues.size(); i++)
+  for (StreamIndex i = 0; i < HT_NUM_STREAMS_PER_DEVICE; i++)
     CPUStream(Stream(kCPU, i)).Sync();
 }
 
@@ -1,9 +1,11 @@
 #pragma once
 
 #include "hetu/core/stream.h"
+#include "hetu/utils/work_stealing_executor.h"
 #include <functional>
 #include <chrono>
 #include <condition_variable>
+#include <mutex>
 #include <future>
 
 namespace hetu {
@@ -16,6 +18,10 @@ class CPUStream final {
   std::future<void> EnqueueTask(std::function<void()> f,
                                 const std::string& name = "");
 
+  // Later tasks of this stream will not start until `dependency` is
+  // satisfied. The stream is parked rather than blocking a worker.
+  void EnqueueWait(std::shared_ptr<TaskDependency> dependency);
+
   void Sync();
 
   inline StreamIndex stream_id() const noexcept {
@@ -36,32 +42,75 @@ inline CPUStream GetCPUComputingStream() {
 
 void SynchronizeAllCPUStreams();
 
-class CPUEvent final : public Event {
+// Completion state of one CPUEvent::Record. A new state is created on each
+// record so that streams blocked on a previous record are not affected.
+class CPUEventState final : public TaskDependency {
  public:
-  CPUEvent(bool enable_timing = true) : Event(Device(kCPU), enable_timing) {
-    _record_fn = std::bind(CPUEvent::_Record, this);
-    _block_fn = std::bind(CPUEvent::_Block, this);
+  void Complete(bool enable_timing) {
+    std::vector<std::function<void()>> waiters;
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (enable_timing)
+        _recorded_at = std::chrono::steady_clock::now();
+      _completed = true;
+      waiters.swap(_waiters);
+    }
+    _completed_signal.notify_all();
+    for (auto& waiter : waiters)
+      waiter();
+  }
+
+  void Wait() {
+    std::unique_lock<std::mutex> lock(_mutex);
+    _completed_signal.wait(lock, [this] { return _completed; });
+  }
+
+  bool AddWaiter(std::function<void()> resume) override {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_completed)
+      return false;
+    _waiters.push_back(std::move(resume));
+    return true;
+  }
+
+  inline std::chrono::time_point<std::chrono::steady_clock>
+  recorded_at() const {
+    return _recorded_at;
   }
 
+ private:
+  std::mutex _mutex;
+  std::condition_variable _completed_signal;
+  bool _completed{false};
+  std::vector<std::function<void()>> _waiters;
+  std::chrono::time_point<std::chrono::steady_clock> _recorded_at;
+};
+
+class CPUEvent final : public Event {
+ public:
+  CPUEvent(bool enable_timing = true) : Event(Device(kCPU), enable_timing) {}
+
   inline bool IsRecorded() {
     return _recorded;
   }
 
   inline void Record(const Stream& stream) {
-    _record_fn_completed = false;
-    _record_future = CPUStream(stream).EnqueueTask(_record_fn, "Event_Record");
+    auto state = std::make_shared<CPUEventState>();
+    _state = state;
+    bool timing = enable_timing();
+    CPUStream(stream).EnqueueTask(
+      [state, timing]() { state->Complete(timing); }, "Event_Record");
     _recorded = true;
   }
 
   inline void Sync() {
     HT_ASSERT(_recorded) << "Event has not been recorded";
-    if (!_record_fn_completed && _record_future.valid())
-      _record_future.wait();
+    _state->Wait();
   }
 
   inline void Block(const Stream& stream) {
     HT_ASSERT(_recorded) << "Event has not been recorded";
-    CPUStream(stream).EnqueueTask(_block_fn, "Event_Block");
+    CPUStream(stream).EnqueueWait(_state);
   }
 
   inline int64_t TimeSince(const Event& event) const {
@@ -74,26 +123,12 @@ class CPUEvent final : public Event {
       return 0;
     else
       return std::chrono::duration_cast<std::chrono::nanoseconds>(
-        _recorded_at - e._recorded_at).count();
+        _state->recorded_at() - e._state->recorded_at()).count();
   }
 
  private:
-  static void _Record(CPUEvent* const event) {
-    if (event->enable_timing())
-      event->_recorded_at = std::chrono::steady_clock::now();
-    event->_record_fn_completed = true;
-  }
-
-  static void _Block(CPUEvent* const event) {
-    event->Sync();
-  }
-
-  std::chrono::time_point<std::chrono::steady_clock> _recorded_at;
   bool _recorded{false};
-  bool _record_fn_completed;
-  std::future<void> _record_future;
-  std::function<void()> _record_fn;
-  std::function<void()> _block_fn;
+  std::shared_ptr<CPUEventState> _state;
 };
 
 } // namespace impl
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "hetu/core/float16.h"
+#include "hetu/core/bfloat16.h"
+#include <cstdint>
+
+namespace hetu {
+namespace cpu {
+
+// Data type during accumulation for high precision.
+template <typename spec_t>
+struct AccType {
+  using type = spec_t;
+};
+template <>
+struct AccType<hetu::float16> {
+  using type = float;
+};
+template <>
+struct AccType<hetu::bfloat16> {
+  using type = float;
+};
+
+template <typename spec_t>
+using acc_type = typename AccType<spec_t>::type;
+
+// Finalizer of SplitMix64.
+inline uint64_t SplitMix64(uint64_t x) {
+  x += 0x9E3779B97F4A7C15ULL;
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+// Counter-based uniform random numbers in [0, 1). The idx-th number only
+// depends on (key, idx), so parallel loops produce the same numbers
+// regardless of the number of threads, and masks can be regenerated in the
+// backward pass instead of being stored. `key` should be `SplitMix64(seed)`.
+inline float CounterUniform(uint64_t key, uint64_t idx) {
+  return static_cast<float>(SplitMix64(key ^ (idx * 0xD1B54A32D192ED03ULL)) >>
+                            40) *
+    (1.0f / 16777216.0f);
+}
+
+} // namespace cpu
+} // namespace hetu
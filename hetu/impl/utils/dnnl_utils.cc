@@ -0,0 +1,120 @@
+#include "hetu/impl/utils/dnnl_utils.h"
+#include "hetu/common/logging.h"
+#include <list>
+#include <mutex>
+#include <unordered_map>
+
+namespace hetu {
+namespace cpu {
+
+namespace {
+
+static size_t ParseDNNLPrimitiveCacheCapacity() {
+  const char* capacity_str = std::getenv("HETU_DNNL_PRIMITIVE_CACHE_CAPACITY");
+  size_t capacity = 1024;
+  if (capacity_str != NULL) {
+    try {
+      capacity = std::stoul(capacity_str);
+    } catch (const std::exception& e) {
+      HT_LOG_WARN
+        << "Invalid HETU_DNNL_PRIMITIVE_CACHE_CAPACITY: " << capacity_str
+        << " is set, please provide an integer"
+        << ", default value will be used in this process.";
+    }
+  }
+  return capacity;
+}
+
+} // namespace
+
+const dnnl::engine& GetDNNLEngine() {
+  static const dnnl::engine engine(dnnl::engine::kind::cpu, 0);
+  return engine;
+}
+
+dnnl::stream& GetDNNLStream() {
+  thread_local dnnl::stream engine_stream(GetDNNLEngine());
+  return engine_stream;
+}
+
+struct DNNLPrimitiveCache::Impl {
+  using Entry = std::pair<DNNLPrimitiveKey, std::shared_ptr<void>>;
+
+  size_t capacity;
+  mutable std::mutex mtx;
+  std::list<Entry> lru_list;
+  std::unordered_map<DNNLPrimitiveKey, std::list<Entry>::iterator,
+                     DNNLPrimitiveKeyHash>
+    table;
+  uint64_t hits{0};
+  uint64_t misses{0};
+  uint64_t evictions{0};
+};
+
+DNNLPrimitiveCache::DNNLPrimitiveCache(size_t capacity)
+: _impl(new Impl()) {
+  _impl->capacity = capacity;
+  _impl->table.reserve(capacity);
+}
+
+DNNLPrimitiveCache& DNNLPrimitiveCache::Get() {
+  // Intentionally leaked so that kernels running in exit handlers
+  // can still use the cache.
+  static DNNLPrimitiveCache* cache =
+    new DNNLPrimitiveCache(ParseDNNLPrimitiveCacheCapacity());
+  return *cache;
+}
+
+std::shared_ptr<void> DNNLPrimitiveCache::Lookup(const DNNLPrimitiveKey& key) {
+  std::lock_guard<std::mutex> lock(_impl->mtx);
+  auto it = _impl->table.find(key);
+  if (it == _impl->table.end()) {
+    _impl->misses++;
+    return nullptr;
+  }
+  _impl->hits++;
+  // move to the front as the most recently used one
+  _impl->lru_list.splice(_impl->lru_list.begin(), _impl->lru_list, it->second);
+  return it->second->second;
+}
+
+void DNNLPrimitiveCache::Insert(const DNNLPrimitiveKey& key,
+                                std::shared_ptr<void> entry) {
+  std::lock_guard<std::mutex> lock(_impl->mtx);
+  if (_impl->capacity == 0)
+    return;
+  auto it = _impl->table.find(key);
+  if (it != _impl->table.end()) {
+    // Another thread has created the same primitive in the meantime.
+    _impl->lru_list.splice(_impl->lru_list.begin(), _impl->lru_list,
+                           it->second);
+    return;
+  }
+  _impl->lru_list.emplace_front(key, std::move(entry));
+  _impl->table.emplace(key, _impl->lru_list.begin());
+  while (_impl->lru_list.size() > _impl->capacity) {
+    _impl->table.erase(_impl->lru_list.back().first);
+    _impl->lru_list.pop_back();
+    _impl->evictions++;
+  }
+}
+
+void DNNLPrimitiveCache::Clear() {
+  std::lock_guard<std::mutex> lock(_impl->mtx);
+  _impl->table.clear();
+  _impl->lru_list.clear();
+}
+
+DNNLPrimitiveCacheStats DNNLPrimitiveCache::stats() const {
+  std::lock_guard<std::mutex> lock(_impl->mtx);
+  DNNLPrimitiveCacheStats ret;
+  ret.hits = _impl->hits;
+  ret.misses = _impl->misses;
+  ret.evictions = _impl->evictions;
+  ret.size = _impl->lru_list.size();
+  ret.capacity = _impl->capacity;
+  return ret;
+}
+
+} // namespace cpu
+} // namespace hetu
@@ -2,7 +2,12 @@
 
 #include "hetu/common/macros.h"
 #include "hetu/core/device.h"
+#include "hetu/core/dtype.h"
 #include "oneapi/dnnl/dnnl.hpp"
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
 namespace hetu {
 namespace cpu {
@@ -138,5 +143,230 @@ inline dnnl::memory::data_type dtype_to_dnnltype(DataType dtype) {
   } 
 }
 
+/******************************************************
+ * Shared engine, streams and primitive cache
+ ******************************************************/
+
+// The process-wide CPU engine. All dnnl-backed kernels should create their
+// memory objects and primitives on it instead of building a new engine
+// inside every task.
+const dnnl::engine& GetDNNLEngine();
+
+// The dnnl stream of the calling thread. A CPUStream worker runs one task at
+// a time (and blocking streams run on the caller), so a thread-local
+// in-order stream is never shared between concurrently running tasks.
+dnnl::stream& GetDNNLStream();
+
+// Key of the primitive cache, made of the op kind followed by everything
+// that affects the primitive descriptor (dtype, dims, strides, algorithms,
+// flags and scalar attributes).
+class DNNLPrimitiveKey {
+ public:
+  explicit DNNLPrimitiveKey(const char* op_kind)
+  : _op_kind(op_kind), _hash(std::hash<std::string>()(_op_kind)) {}
+
+  DNNLPrimitiveKey& operator<<(int64_t value) {
+    _values.push_back(value);
+    _hash ^= std::hash<int64_t>()(value) + 0x9e3779b9 + (_hash << 6) +
+      (_hash >> 2);
+    return *this;
+  }
+
+  DNNLPrimitiveKey& operator<<(const std::vector<int64_t>& values) {
+    *this << static_cast<int64_t>(values.size());
+    for (auto value : values)
+      *this << value;
+    return *this;
+  }
+
+  DNNLPrimitiveKey& operator<<(float value) {
+    int32_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return *this << static_cast<int64_t>(bits);
+  }
+
+  DNNLPrimitiveKey& operator<<(double value) {
+    int64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return *this << bits;
+  }
+
+  DNNLPrimitiveKey& operator<<(const dnnl::memory::desc& md) {
+    return *this << md.get_data_type() << md.get_format_kind()
+                 << md.get_dims() << md.get_strides();
+  }
+
+  template <typename T,
+            typename = std::enable_if_t<std::is_enum<T>::value ||
+                                        std::is_integral<T>::value>>
+  DNNLPrimitiveKey& operator<<(T value) {
+    return *this << static_cast<int64_t>(value);
+  }
+
+  bool operator==(const DNNLPrimitiveKey& other) const {
+    return _hash == other._hash && _op_kind == other._op_kind &&
+      _values == other._values;
+  }
+
+  size_t hash() const noexcept {
+    return _hash;
+  }
+
+  const std::string& op_kind() const noexcept {
+    return _op_kind;
+  }
+
+ private:
+  std::string _op_kind;
+  std::vector<int64_t> _values;
+  size_t _hash;
+};
+
+struct DNNLPrimitiveKeyHash {
+  size_t operator()(const DNNLPrimitiveKey& key) const noexcept {
+    return key.hash();
+  }
+};
+
+template <typename Primitive>
+struct DNNLCachedPrimitive {
+  typename Primitive::primitive_desc pd;
+  Primitive prim;
+
+  DNNLCachedPrimitive(typename Primitive::primitive_desc pd_)
+  : pd(std::move(pd_)), prim(pd) {}
+};
+
+struct DNNLPrimitiveCacheStats {
+  uint64_t hits{0};
+  uint64_t misses{0};
+  uint64_t evictions{0};
+  size_t size{0};
+  size_t capacity{0};
+};
+
+// A thread-safe LRU cache of created primitives (together with their
+// primitive descriptors, which are needed to query workspace or statistics
+// memory descriptors). The capacity can be set via
+// HETU_DNNL_PRIMITIVE_CACHE_CAPACITY (0 disables caching).
+class DNNLPrimitiveCache {
+ public:
+  static DNNLPrimitiveCache& Get();
+
+  std::shared_ptr<void> Lookup(const DNNLPrimitiveKey& key);
+
+  void Insert(const DNNLPrimitiveKey& key, std::shared_ptr<void> entry);
+
+  void Clear();
+
+  DNNLPrimitiveCacheStats stats() const;
+
+ private:
+  DNNLPrimitiveCache(size_t capacity);
+
+  struct Impl;
+  std::unique_ptr<Impl> _impl;
+};
+
+template <typename Primitive, typename PrimitiveDescCreator>
+inline std::shared_ptr<DNNLCachedPrimitive<Primitive>>
+GetOrCreateDNNLPrimitive(const DNNLPrimitiveKey& key,
+                         PrimitiveDescCreator&& create_pd) {
+  auto& cache = DNNLPrimitiveCache::Get();
+  auto cached = cache.Lookup(key);
+  if (cached)
+    return std::static_pointer_cast<DNNLCachedPrimitive<Primitive>>(cached);
+  auto entry = std::make_shared<DNNLCachedPrimitive<Primitive>>(create_pd());
+  cache.Insert(key, entry);
+  return entry;
+}
+
+inline std::shared_ptr<DNNLCachedPrimitive<dnnl::reduction>>
+GetOrCreateDNNLReduction(dnnl::algorithm alg, const dnnl::memory::desc& src_md,
+                         const dnnl::memory::desc& dst_md, float p = 0.f,
+                         float eps = 0.f) {
+  DNNLPrimitiveKey key("reduction");
+  key << alg << src_md << dst_md << p << eps;
+  return GetOrCreateDNNLPrimitive<dnnl::reduction>(key, [&]() {
+    return dnnl::reduction::primitive_desc(GetDNNLEngine(), alg, src_md,
+                                           dst_md, p, eps);
+  });
+}
+
+inline std::shared_ptr<DNNLCachedPrimitive<dnnl::binary>>
+GetOrCreateDNNLBinary(dnnl::algorithm alg, const dnnl::memory::desc& src0_md,
+                      const dnnl::memory::desc& src1_md,
+                      const dnnl::memory::desc& dst_md) {
+  DNNLPrimitiveKey key("binary");
+  key << alg << src0_md << src1_md << dst_md;
+  return GetOrCreateDNNLPrimitive<dnnl::binary>(key, [&]() {
+    return dnnl::binary::primitive_desc(GetDNNLEngine(), alg, src0_md,
+                                        src1_md, dst_md);
+  });
+}
+
+inline std::shared_ptr<DNNLCachedPrimitive<dnnl::eltwise_forward>>
+GetOrCreateDNNLEltwise(dnnl::algorithm alg, const dnnl::memory::desc& src_md,
+                       const dnnl::memory::desc& dst_md, float alpha = 0.f,
+                       float beta = 0.f) {
+  DNNLPrimitiveKey key("eltwise");
+  key << alg << src_md << dst_md << alpha << beta;
+  return GetOrCreateDNNLPrimitive<dnnl::eltwise_forward>(key, [&]() {
+    return dnnl::eltwise_forward::primitive_desc(
+      GetDNNLEngine(), dnnl::prop_kind::forward_training, alg, src_md, dst_md,
+      alpha, beta);
+  });
+}
+
+inline std::shared_ptr<DNNLCachedPrimitive<dnnl::eltwise_backward>>
+GetOrCreateDNNLEltwiseBackward(dnnl::algorithm alg,
+                               const dnnl::memory::desc& diff_src_md,
+                               const dnnl::memory::desc& diff_dst_md,
+                               const dnnl::memory::desc& src_md,
+                               float alpha = 0.f, float beta = 0.f) {
+  DNNLPrimitiveKey key("eltwise_backward");
+  key << alg << diff_src_md << diff_dst_md << src_md << alpha << beta;
+  return GetOrCreateDNNLPrimitive<dnnl::eltwise_backward>(key, [&]() {
+    auto fwd_pd = dnnl::eltwise_forward::primitive_desc(
+      GetDNNLEngine(), dnnl::prop_kind::forward_training, alg, src_md, src_md,
+      alpha, beta);
+    return dnnl::eltwise_backward::primitive_desc(
+      GetDNNLEngine(), alg, diff_src_md, diff_dst_md, src_md, alpha, beta,
+      fwd_pd);
+  });
+}
+
+inline std::shared_ptr<DNNLCachedPrimitive<dnnl::softmax_forward>>
+GetOrCreateDNNLSoftmax(dnnl::algorithm alg, const dnnl::memory::desc& src_md,
+                       const dnnl::memory::desc& dst_md, int axis) {
+  DNNLPrimitiveKey key("softmax");
+  key << alg << src_md << dst_md << axis;
+  return GetOrCreateDNNLPrimitive<dnnl::softmax_forward>(key, [&]() {
+    return dnnl::softmax_forward::primitive_desc(
+      GetDNNLEngine(), dnnl::prop_kind::forward_training, alg, src_md, dst_md,
+      axis);
+  });
+}
+
+inline std::shared_ptr<DNNLCachedPrimitive<dnnl::softmax_backward>>
+GetOrCreateDNNLSoftmaxBackward(dnnl::algorithm alg,
+                               const dnnl::memory::desc& diff_src_md,
+                               const dnnl::memory::desc& diff_dst_md,
+                               const dnnl::memory::desc& dst_md, int axis) {
+  DNNLPrimitiveKey key("softmax_backward");
+  key << alg << diff_src_md << diff_dst_md << dst_md << axis;
+  return GetOrCreateDNNLPrimitive<dnnl::softmax_backward>(key, [&]() {
+    auto fwd_pd = dnnl::softmax_forward::primitive_desc(
+      GetDNNLEngine(), dnnl::prop_kind::forward_training, alg, diff_src_md,
+      dst_md, axis);
+    return dnnl::softmax_backward::primitive_desc(
+      GetDNNLEngine(), alg, diff_src_md, diff_dst_md, dst_md, axis, fwd_pd);
+  });
+}
+
+inline DNNLPrimitiveCacheStats GetDNNLPrimitiveCacheStats() {
+  return DNNLPrimitiveCache::Get().stats();
+}
+
 } // namespace cpu
 } // namespace hetu
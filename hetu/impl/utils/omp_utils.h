@@ -26,6 +26,14 @@ inline static int OMP_GET_NUM_THREADS() {
   return ret;
 }
 
+inline static int OMP_GET_MAX_THREADS() {
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
 inline static int OMP_GET_THREAD_ID() {
 #ifdef _OPENMP
   return omp_get_thread_num();
@@ -0,0 +1,237 @@
+#pragma once
+
+#include "hetu/core/ndarray_meta.h"
+#include "hetu/impl/utils/omp_utils.h"
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+
+namespace hetu {
+namespace impl {
+
+// Strided iteration on CPU, the host counterpart of offset_calculator.cuh.
+// Instead of recovering a multi-dimensional index with divisions for every
+// element, the layout is first simplified and then walked row by row:
+//   1. dimensions of size 1 are dropped, the rest are ordered by the
+//      destination stride, and dimensions that are contiguous with their
+//      neighbours in both arrays are merged;
+//   2. the innermost dimension is walked with constant strides;
+//   3. the outer dimensions are split among threads, each thread finding its
+//      first row with divisions once and then advancing like an odometer.
+// Strides are in elements.
+
+// Copies below this many elements are not worth waking up other threads.
+constexpr int64_t kStridedCopyParallelThreshold = 32768;
+// Edge of the square tiles used when transposing.
+constexpr int64_t kStridedCopyTileSize = 32;
+
+struct StridedLayout {
+  int ndim{0};
+  int64_t shape[HT_MAX_NDIM];
+  int64_t src_stride[HT_MAX_NDIM];
+  int64_t dst_stride[HT_MAX_NDIM];
+
+  int64_t numel() const {
+    int64_t ret = 1;
+    for (int i = 0; i < ndim; i++)
+      ret *= shape[i];
+    return ret;
+  }
+
+  // Simplifies a copy of an array of `shape` between `src_stride` and
+  // `dst_stride`. The result always has at least one dimension.
+  static StridedLayout Make(const HTShape& shape, const HTStride& src_stride,
+                            const HTStride& dst_stride) {
+    HT_ASSERT(shape.size() == src_stride.size() &&
+              shape.size() == dst_stride.size())
+      << "Mismatched strided copy of shape " << shape << " from strides "
+      << src_stride << " to strides " << dst_stride;
+    int order[HT_MAX_NDIM];
+    int n = 0;
+    for (size_t i = 0; i < shape.size(); i++)
+      if (shape[i] != 1)
+        order[n++] = i;
+    // Outer to inner by the destination stride, then by the source stride,
+    // so that writes are as sequential as possible.
+    std::stable_sort(order, order + n, [&](int a, int b) {
+      if (dst_stride[a] != dst_stride[b])
+        return dst_stride[a] > dst_stride[b];
+      return src_stride[a] > src_stride[b];
+    });
+    StridedLayout layout;
+    for (int k = 0; k < n; k++) {
+      int i = order[k];
+      int last = layout.ndim - 1;
+      if (last >= 0 &&
+          layout.src_stride[last] == shape[i] * src_stride[i] &&
+          layout.dst_stride[last] == shape[i] * dst_stride[i]) {
+        layout.shape[last] *= shape[i];
+        layout.src_stride[last] = src_stride[i];
+        layout.dst_stride[last] = dst_stride[i];
+      } else {
+        layout.shape[layout.ndim] = shape[i];
+        layout.src_stride[layout.ndim] = src_stride[i];
+        layout.dst_stride[layout.ndim] = dst_stride[i];
+        layout.ndim++;
+      }
+    }
+    if (layout.ndim == 0) {
+      layout.ndim = 1;
+      layout.shape[0] = 1;
+      layout.src_stride[0] = 1;
+      layout.dst_stride[0] = 1;
+    }
+    return layout;
+  }
+};
+
+// Calls `fn(unit, src_offset, dst_offset)` for `num_units` units, whose
+// offsets follow the odometer over `shape` (outer to inner) with the given
+// strides. Units are split among threads if `parallel`.
+template <typename Func>
+inline void StridedForEachUnit(int ndim, const int64_t* shape,
+                               const int64_t* src_stride,
+                               const int64_t* dst_stride, int64_t num_units,
+                               bool parallel, Func&& fn) {
+  auto run = [&](int64_t begin, int64_t end) {
+    if (begin >= end)
+      return;
+    int64_t index[HT_MAX_NDIM];
+    int64_t src_offset = 0, dst_offset = 0;
+    int64_t rest = begin;
+    for (int i = ndim - 1; i >= 0; i--) {
+      index[i] = rest % shape[i];
+      rest /= shape[i];
+      src_offset += index[i] * src_stride[i];
+      dst_offset += index[i] * dst_stride[i];
+    }
+    for (int64_t unit = begin; unit < end; unit++) {
+      fn(unit, src_offset, dst_offset);
+      for (int i = ndim - 1; i >= 0; i--) {
+        src_offset += src_stride[i];
+        dst_offset += dst_stride[i];
+        if (++index[i] < shape[i])
+          break;
+        src_offset -= shape[i] * src_stride[i];
+        dst_offset -= shape[i] * dst_stride[i];
+        index[i] = 0;
+      }
+    }
+  };
+#ifdef _OPENMP
+  if (parallel && num_units > 1) {
+#pragma omp parallel
+    {
+      int64_t num_threads = omp_get_num_threads();
+      int64_t thread_id = omp_get_thread_num();
+      int64_t chunk = DIVUP(num_units, num_threads);
+      run(MIN(thread_id * chunk, num_units),
+          MIN((thread_id + 1) * chunk, num_units));
+    }
+    return;
+  }
+#endif
+  run(0, num_units);
+}
+
+// Calls `fn(src_offset, dst_offset, size, src_inner_stride,
+// dst_inner_stride)` for every row of the innermost dimension of a copy of
+// an array of `shape` between the given strides.
+template <typename Func>
+inline void StridedForEachRow(const HTShape& shape, const HTStride& src_stride,
+                              const HTStride& dst_stride, bool parallel,
+                              Func&& fn) {
+  auto layout = StridedLayout::Make(shape, src_stride, dst_stride);
+  int inner = layout.ndim - 1;
+  int64_t num_rows = layout.numel() / layout.shape[inner];
+  int64_t row_size = layout.shape[inner];
+  int64_t src_inner = layout.src_stride[inner];
+  int64_t dst_inner = layout.dst_stride[inner];
+  StridedForEachUnit(
+    inner, layout.shape, layout.src_stride, layout.dst_stride, num_rows,
+    parallel && layout.numel() >= kStridedCopyParallelThreshold,
+    [&](int64_t, int64_t src_offset, int64_t dst_offset) {
+      fn(src_offset, dst_offset, row_size, src_inner, dst_inner);
+    });
+}
+
+// Copies an array of `shape` from `src` with `src_stride` to `dst` with
+// `dst_stride`. When the source is contiguous along another dimension than
+// the destination, i.e., a transpose, the two dimensions are copied in
+// square tiles so that both sides stay in cache.
+template <typename spec_t>
+void StridedCopy(const spec_t* src, spec_t* dst, const HTShape& shape,
+                 const HTStride& src_stride, const HTStride& dst_stride) {
+  auto layout = StridedLayout::Make(shape, src_stride, dst_stride);
+  int64_t numel = layout.numel();
+  if (numel == 0)
+    return;
+  bool parallel = numel >= kStridedCopyParallelThreshold;
+  int inner = layout.ndim - 1;
+  int tiled = -1;
+  if (layout.src_stride[inner] != 1 && layout.dst_stride[inner] == 1 &&
+      layout.shape[inner] >= kStridedCopyTileSize) {
+    for (int i = 0; i < inner; i++)
+      if (layout.src_stride[i] == 1 &&
+          layout.shape[i] >= kStridedCopyTileSize)
+        tiled = i;
+  }
+
+  if (tiled < 0) {
+    int64_t row_size = layout.shape[inner];
+    int64_t src_inner = layout.src_stride[inner];
+    int64_t dst_inner = layout.dst_stride[inner];
+    StridedForEachUnit(
+      inner, layout.shape, layout.src_stride, layout.dst_stride,
+      numel / row_size, parallel,
+      [&](int64_t, int64_t src_offset, int64_t dst_offset) {
+        const spec_t* s = src + src_offset;
+        spec_t* d = dst + dst_offset;
+        if (src_inner == 1 && dst_inner == 1) {
+          std::memcpy(d, s, row_size * sizeof(spec_t));
+        } else {
+          for (int64_t k = 0; k < row_size; k++)
+            d[k * dst_inner] = s[k * src_inner];
+        }
+      });
+    return;
+  }
+
+  // Move the tiled dimension next to the inner one and iterate over the
+  // outer dimensions plus the tile rows of the tiled dimension.
+  int64_t shape_[HT_MAX_NDIM], src_[HT_MAX_NDIM], dst_[HT_MAX_NDIM];
+  int n = 0;
+  for (int i = 0; i < inner; i++) {
+    if (i == tiled)
+      continue;
+    shape_[n] = layout.shape[i];
+    src_[n] = layout.src_stride[i];
+    dst_[n] = layout.dst_stride[i];
+    n++;
+  }
+  constexpr int64_t T = kStridedCopyTileSize;
+  int64_t rows = layout.shape[tiled], cols = layout.shape[inner];
+  int64_t row_dst_stride = layout.dst_stride[tiled];
+  int64_t col_src_stride = layout.src_stride[inner];
+  shape_[n] = DIVUP(rows, T);
+  src_[n] = T;
+  dst_[n] = T * row_dst_stride;
+  n++;
+  int64_t num_units = numel / (rows * cols) * shape_[n - 1];
+  StridedForEachUnit(
+    n, shape_, src_, dst_, num_units, parallel,
+    [&](int64_t unit, int64_t src_offset, int64_t dst_offset) {
+      int64_t tile_rows = MIN(T, rows - (unit % shape_[n - 1]) * T);
+      for (int64_t c0 = 0; c0 < cols; c0 += T) {
+        int64_t tile_cols = MIN(T, cols - c0);
+        const spec_t* s = src + src_offset + c0 * col_src_stride;
+        spec_t* d = dst + dst_offset + c0;
+        for (int64_t r = 0; r < tile_rows; r++)
+          for (int64_t c = 0; c < tile_cols; c++)
+            d[r * row_dst_stride + c] = s[r + c * col_src_stride];
+      }
+    });
+}
+
+} // namespace impl
+} // namespace hetu
@@ -102,6 +102,11 @@ class ContextStore {
     return result;
   }  
 
+  void clear() {
+    _ctx.clear();
+    _ctx_ndarray.clear();
+  }
+
  private:
   std::unordered_map<std::string, std::string> _ctx;
   std::unordered_map<std::string, NDArray> _ctx_ndarray;
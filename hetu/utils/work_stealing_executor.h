@@ -0,0 +1,422 @@
+#pragma once
+
+#include "hetu/common/macros.h"
+#include <functional>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <thread>
+#include <future>
+#include <random>
+
+namespace hetu {
+
+// Something a task queue can wait on without occupying a worker,
+// e.g., an event recorded on another queue.
+class TaskDependency {
+ public:
+  virtual ~TaskDependency() = default;
+
+  // Returns false if the dependency has already been satisfied. Otherwise,
+  // `resume` is kept and invoked exactly once when it gets satisfied.
+  virtual bool AddWaiter(std::function<void()> resume) = 0;
+};
+
+// Chase-Lev deque (Le et al., PPoPP'13). The owner pushes and pops at the
+// bottom while thieves steal from the top. Items must be raw pointers and
+// nullptr is reserved for "empty or lost the race".
+template <typename T>
+class WorkStealingDeque final {
+  static_assert(std::is_pointer<T>::value,
+                "WorkStealingDeque only holds pointers");
+
+  struct Array {
+    explicit Array(int64_t capacity)
+    : capacity(capacity), mask(capacity - 1),
+      slots(new std::atomic<T>[capacity]) {}
+
+    T get(int64_t i) const {
+      return slots[i & mask].load(std::memory_order_relaxed);
+    }
+
+    void put(int64_t i, T x) {
+      slots[i & mask].store(x, std::memory_order_relaxed);
+    }
+
+    Array* grow(int64_t bottom, int64_t top) const {
+      Array* ret = new Array(capacity << 1);
+      for (int64_t i = top; i < bottom; i++)
+        ret->put(i, get(i));
+      return ret;
+    }
+
+    const int64_t capacity;
+    const int64_t mask;
+    std::unique_ptr<std::atomic<T>[]> slots;
+  };
+
+ public:
+  explicit WorkStealingDeque(int64_t capacity = 256) {
+    HT_ASSERT(capacity > 0 && (capacity & (capacity - 1)) == 0)
+      << "Capacity must be a power of 2, got " << capacity;
+    _arrays.emplace_back(new Array(capacity));
+    _array.store(_arrays.back().get(), std::memory_order_relaxed);
+  }
+
+  // Owner only.
+  void Push(T x) {
+    int64_t b = _bottom.load(std::memory_order_relaxed);
+    int64_t t = _top.load(std::memory_order_acquire);
+    Array* a = _array.load(std::memory_order_relaxed);
+    if (b - t > a->capacity - 1) {
+      // Retired arrays are kept alive since thieves may still read them.
+      _arrays.emplace_back(a->grow(b, t));
+      a = _arrays.back().get();
+      _array.store(a, std::memory_order_release);
+    }
+    a->put(b, x);
+    std::atomic_thread_fence(std::memory_order_release);
+    _bottom.store(b + 1, std::memory_order_relaxed);
+  }
+
+  // Owner only.
+  T Pop() {
+    int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+    Array* a = _array.load(std::memory_order_relaxed);
+    _bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t t = _top.load(std::memory_order_relaxed);
+    T x = nullptr;
+    if (t <= b) {
+      x = a->get(b);
+      if (t == b) {
+        if (!_top.compare_exchange_strong(t, t + 1,
+                                          std::memory_order_seq_cst,
+                                          std::memory_order_relaxed))
+          x = nullptr;
+        _bottom.store(b + 1, std::memory_order_relaxed);
+      }
+    } else {
+      _bottom.store(b + 1, std::memory_order_relaxed);
+    }
+    return x;
+  }
+
+  // Any thread.
+  T Steal() {
+    int64_t t = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t b = _bottom.load(std::memory_order_acquire);
+    if (t >= b)
+      return nullptr;
+    Array* a = _array.load(std::memory_order_acquire);
+    T x = a->get(t);
+    if (!_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst,
+                                      std::memory_order_relaxed))
+      return nullptr;
+    return x;
+  }
+
+  bool empty() const {
+    return _bottom.load(std::memory_order_relaxed) <=
+      _top.load(std::memory_order_relaxed);
+  }
+
+ private:
+  alignas(64) std::atomic<int64_t> _top{0};
+  alignas(64) std::atomic<int64_t> _bottom{0};
+  std::atomic<Array*> _array;
+  std::vector<std::unique_ptr<Array>> _arrays;
+};
+
+// A pool of workers serving a fixed number of ordered queues. Tasks in the
+// same queue run one after another in enqueue order (like a stream), while
+// different queues are picked up by whichever worker is idle. Runnable
+// queues are scheduled through per-worker Chase-Lev deques, so workers only
+// touch a shared lock when tasks come from outside the pool.
+//
+// A queue may also wait on a TaskDependency. Instead of blocking a worker,
+// the queue is parked and rescheduled once the dependency is satisfied.
+class WorkStealingExecutor final {
+  struct Entry {
+    std::function<void()> fn;
+    std::shared_ptr<TaskDependency> dependency;
+    uint64_t id;
+    std::string name;
+  };
+
+  struct OrderedQueue {
+    std::mutex mutex;
+    std::condition_variable dequeue_signal;
+    std::deque<Entry> entries;
+    bool scheduled{false};
+    size_t index;
+  };
+
+  struct WorkerContext {
+    WorkStealingExecutor* executor{nullptr};
+    size_t worker_id{0};
+  };
+
+  // Number of entries to run before yielding the worker to other queues.
+  static constexpr size_t kRunBudget = 64;
+
+ public:
+  WorkStealingExecutor(const std::string& name, size_t num_workers,
+                       size_t num_queues, uint64_t max_pending_tasks = 10240UL)
+  : _name(name), _max_pending_tasks(max_pending_tasks), _queues(num_queues) {
+    HT_ASSERT(num_workers > 0) << "Number of workers must be positive.";
+    HT_ASSERT(num_queues > 0) << "Number of queues must be positive.";
+    HT_ASSERT(max_pending_tasks > 0) << "Max pending tasks must be positive.";
+    for (size_t i = 0; i < num_queues; i++) {
+      _queues[i].reset(new OrderedQueue());
+      _queues[i]->index = i;
+    }
+    _deques.reserve(num_workers);
+    for (size_t i = 0; i < num_workers; i++)
+      _deques.emplace_back(new WorkStealingDeque<OrderedQueue*>());
+    _workers.reserve(num_workers);
+    for (size_t i = 0; i < num_workers; i++)
+      _workers.emplace_back(&WorkStealingExecutor::_RunWorker, this, i);
+  }
+
+  ~WorkStealingExecutor() {
+    if (!_shutdowned)
+      Shutdown();
+    for (auto& worker : _workers)
+      worker.join();
+  }
+
+  std::future<void> Enqueue(size_t queue_id, std::function<void()> f,
+                            const std::string& name = "") {
+    auto task_f = std::make_shared<std::packaged_task<void()>>(std::move(f));
+    auto future = task_f->get_future();
+    _Push(queue_id, {[task_f] { (*task_f)(); }, nullptr, 0, name});
+    return future;
+  }
+
+  // Tasks enqueued to `queue_id` afterwards will not start until
+  // `dependency` is satisfied.
+  void EnqueueWait(size_t queue_id,
+                   std::shared_ptr<TaskDependency> dependency) {
+    HT_ASSERT(dependency != nullptr) << "Dependency must not be null.";
+    _Push(queue_id, {std::function<void()>(), std::move(dependency), 0,
+                     "Wait"});
+  }
+
+  void Shutdown() {
+    std::unique_lock<std::mutex> lock(_sleep_mutex);
+    _shutdowned = true;
+    _epoch.fetch_add(1, std::memory_order_seq_cst);
+    _sleep_signal.notify_all();
+    for (auto& queue : _queues) {
+      std::lock_guard<std::mutex> queue_lock(queue->mutex);
+      queue->dequeue_signal.notify_all();
+    }
+  }
+
+  const std::string& name() const {
+    return _name;
+  }
+
+  uint64_t max_pending_tasks() const {
+    return _max_pending_tasks;
+  }
+
+  uint64_t num_enqueued_tasks() const {
+    return _num_enqueued_tasks;
+  }
+
+  uint64_t num_steals() const {
+    return _num_steals;
+  }
+
+  int num_workers() const {
+    return _workers.size();
+  }
+
+  int num_queues() const {
+    return _queues.size();
+  }
+
+  bool running() const {
+    return !_shutdowned;
+  }
+
+ private:
+  static WorkerContext& _CurrentWorker() {
+    static thread_local WorkerContext ctx;
+    return ctx;
+  }
+
+  bool _OnWorkerThread() const {
+    return _CurrentWorker().executor == this;
+  }
+
+  void _Push(size_t queue_id, Entry&& entry) {
+    HT_ASSERT(!_shutdowned) << "The executor has been shutdowned.";
+    HT_ASSERT(queue_id < _queues.size())
+      << "Invalid queue id " << queue_id << " for executor " << _name;
+    auto* queue = _queues[queue_id].get();
+    bool need_schedule = false;
+    {
+      std::unique_lock<std::mutex> lock(queue->mutex);
+      // Workers never wait for space, otherwise a task feeding a full
+      // queue could end up waiting for itself.
+      if (!_OnWorkerThread()) {
+        while (queue->entries.size() >= _max_pending_tasks) {
+          queue->dequeue_signal.wait(lock);
+          HT_ASSERT(!_shutdowned) << "The executor has been shutdowned.";
+        }
+      }
+      entry.id = _num_enqueued_tasks++;
+      queue->entries.push_back(std::move(entry));
+      if (!queue->scheduled) {
+        queue->scheduled = true;
+        need_schedule = true;
+      }
+    }
+    if (need_schedule)
+      _Schedule(queue);
+  }
+
+  void _Schedule(OrderedQueue* queue) {
+    auto& ctx = _CurrentWorker();
+    if (ctx.executor == this) {
+      _deques[ctx.worker_id]->Push(queue);
+    } else {
+      std::lock_guard<std::mutex> lock(_inject_mutex);
+      _inject_queue.push_back(queue);
+    }
+    _epoch.fetch_add(1, std::memory_order_seq_cst);
+    if (_num_sleeping.load(std::memory_order_seq_cst) > 0) {
+      std::lock_guard<std::mutex> lock(_sleep_mutex);
+      _sleep_signal.notify_one();
+    }
+  }
+
+  OrderedQueue* _FindWork(size_t worker_id, std::minstd_rand& rng) {
+    OrderedQueue* queue = _deques[worker_id]->Pop();
+    if (queue != nullptr)
+      return queue;
+    {
+      std::lock_guard<std::mutex> lock(_inject_mutex);
+      if (!_inject_queue.empty()) {
+        queue = _inject_queue.front();
+        _inject_queue.pop_front();
+        return queue;
+      }
+    }
+    size_t num_deques = _deques.size();
+    size_t start = rng() % num_deques;
+    for (size_t i = 0; i < num_deques; i++) {
+      size_t victim = (start + i) % num_deques;
+      if (victim == worker_id)
+        continue;
+      queue = _deques[victim]->Steal();
+      if (queue != nullptr) {
+        _num_steals++;
+        return queue;
+      }
+    }
+    return nullptr;
+  }
+
+  // Runs the entries of a scheduled queue. The queue stays "scheduled" until
+  // it is drained, so no two workers ever run the same queue.
+  void _RunQueue(OrderedQueue* queue, const std::string& worker_name,
+                 uint64_t& num_processed) {
+    std::unique_lock<std::mutex> lock(queue->mutex);
+    for (size_t budget = kRunBudget; budget > 0; budget--) {
+      if (queue->entries.empty()) {
+        queue->scheduled = false;
+        return;
+      }
+      auto entry = std::move(queue->entries.front());
+      queue->entries.pop_front();
+      queue->dequeue_signal.notify_one();
+      lock.unlock();
+
+      if (entry.dependency != nullptr) {
+        // The queue must not be touched after a waiter has been
+        // registered, since another thread may have rescheduled it.
+        if (entry.dependency->AddWaiter([this, queue] { _Schedule(queue); }))
+          return;
+      } else {
+        HT_LOG_TRACE << worker_name << " Processing task " << entry.id
+                     << " \"" << entry.name << "\" of queue " << queue->index
+                     << "...";
+        entry.fn();
+        HT_LOG_TRACE << worker_name << " Processed task " << entry.id
+                     << " \"" << entry.name << "\" successfully.";
+        num_processed++;
+      }
+      lock.lock();
+    }
+    // Out of budget. Hand the queue to the back of the shared injection
+    // queue so that other runnable queues get a chance first.
+    lock.unlock();
+    {
+      std::lock_guard<std::mutex> inject_lock(_inject_mutex);
+      _inject_queue.push_back(queue);
+    }
+    _epoch.fetch_add(1, std::memory_order_seq_cst);
+  }
+
+  static void _RunWorker(WorkStealingExecutor* const executor,
+                         size_t worker_id) {
+    auto& ctx = _CurrentWorker();
+    ctx.executor = executor;
+    ctx.worker_id = worker_id;
+    uint64_t num_processed = 0;
+    const std::string worker_name = "WorkStealingExecutor[" +
+      executor->name() + "] Worker[" + std::to_string(worker_id) + "]";
+    std::minstd_rand rng(worker_id + 1);
+    while (true) {
+      uint64_t epoch = executor->_epoch.load(std::memory_order_seq_cst);
+      auto* queue = executor->_FindWork(worker_id, rng);
+      if (queue != nullptr) {
+        executor->_RunQueue(queue, worker_name, num_processed);
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(executor->_sleep_mutex);
+      executor->_num_sleeping.fetch_add(1, std::memory_order_seq_cst);
+      executor->_sleep_signal.wait(lock, [&] {
+        return executor->_shutdowned ||
+          executor->_epoch.load(std::memory_order_seq_cst) != epoch;
+      });
+      executor->_num_sleeping.fetch_sub(1, std::memory_order_seq_cst);
+      if (executor->_shutdowned) {
+        lock.unlock();
+        // Drain whatever is still runnable before leaving.
+        while ((queue = executor->_FindWork(worker_id, rng)) != nullptr)
+          executor->_RunQueue(queue, worker_name, num_processed);
+        if (executor->_deques[worker_id]->empty())
+          break;
+      }
+    }
+    if (num_processed > 0)
+      HT_LOG_DEBUG << worker_name << " Summary: " << num_processed
+                   << " processed task(s).";
+  }
+
+  const std::string _name;
+  uint64_t _max_pending_tasks;
+  std::atomic<uint64_t> _num_enqueued_tasks{0};
+  std::atomic<uint64_t> _num_steals{0};
+  std::vector<std::unique_ptr<OrderedQueue>> _queues;
+  std::vector<std::unique_ptr<WorkStealingDeque<OrderedQueue*>>> _deques;
+
+  std::mutex _inject_mutex;
+  std::deque<OrderedQueue*> _inject_queue;
+
+  std::mutex _sleep_mutex;
+  std::condition_variable _sleep_signal;
+  std::atomic<uint64_t> _epoch{0};
+  std::atomic<int> _num_sleeping{0};
+  std::vector<std::thread> _workers;
+  std::atomic<bool> _shutdowned{false};
+};
+
+} // namespace hetu
@@ -37,9 +37,12 @@ public:
      * \param app_id the globally unique id indicating the application the
      * postoffice serving for \param customer_id the locally unique id
      * indicating the customer of a postoffice \param recv_handle the functino
-     * for processing a received message
+     * for processing a received message \param accept_handle the function
+     * called in the receiving thread of \ref Van once a message is queued,
+     * which should return quickly
      */
-    Customer(int app_id, int customer_id, const RecvHandle &recv_handle);
+    Customer(int app_id, int customer_id, const RecvHandle &recv_handle,
+             const RecvHandle &accept_handle = nullptr);
 
     /**
      * \brief desconstructor
@@ -89,6 +92,8 @@ public:
      * \param recved the received the message
      */
     inline void Accept(const Message &recved) {
+        if (accept_handle_)
+            accept_handle_(recved);
         recv_queue_.Push(recved);
     }
 
@@ -103,6 +108,7 @@ private:
     int customer_id_;
 
     RecvHandle recv_handle_;
+    RecvHandle accept_handle_;
     ThreadsafePQueue recv_queue_;
     // using multithread to speed data processing
     std::vector<std::shared_ptr<std::thread>> recv_threads_;
@@ -19,7 +19,7 @@ struct Node {
     /** \brief the empty value */
     static const int kEmpty;
     /** \brief default constructor */
-    Node() : id(kEmpty), port(kEmpty), is_recovery(false) {
+    Node() : id(kEmpty), port(kEmpty), is_recovery(false), nonce(0) {
     }
     /** \brief node roles */
     enum Role { SERVER, WORKER, SCHEDULER };
@@ -54,6 +54,11 @@ struct Node {
     int port;
     /** \brief whether this node is created by failover */
     bool is_recovery;
+    /**
+     * \brief random number of the process, which tells apart processes
+     * binding the same host and port in turn
+     */
+    uint64_t nonce;
 };
 /**
  * \brief meta info of a system control message
@@ -107,7 +112,7 @@ struct Meta {
     Meta() :
         app_id(kEmpty), customer_id(kEmpty), timestamp(kEmpty), sender(kEmpty),
         recver(kEmpty), request(false), priority(kEmpty),
-        psftype(PsfType::DensePull) {
+        psftype(PsfType::DensePull), codec(0) {
     }
     std::string DebugString() const {
         std::stringstream ss;
@@ -124,6 +129,8 @@ struct Meta {
         } else {
             ss << ", app_id=" << app_id << ", customer_id=" << customer_id
                << ", priority=" << priority << ", psfType=" << psftype;
+            if (codec)
+                ss << ", codec=" << codec;
         }
         return ss.str();
     }
@@ -145,6 +152,8 @@ struct Meta {
     int priority;
     /** \brief server-side computation op for keys */
     PsfType psftype;
+    /** \brief codec of data, see \ref Codec::meta */
+    int codec;
 };
 /**
  * \brief messages that communicated amaong nodes.
@@ -5,6 +5,7 @@
 #define PS_INTERNAL_UTILS_H_
 #include "common/logging.h"
 #include "ps/internal/env.h"
+#include <algorithm>
 namespace ps {
 
 #ifdef _MSC_VER
@@ -45,6 +46,16 @@ inline int GetEnv(const char *key, int default_val) {
     }
 }
 
+/*!
+ * \brief Get the number of threads a server uses to serve one request.
+ * \return PS_SERVER_NUM_THREADS, 4 by default
+ */
+inline int GetServerNumThreads() {
+    static const int num_threads =
+        std::max(GetEnv("PS_SERVER_NUM_THREADS", 4), 1);
+    return num_threads;
+}
+
 #ifndef DISALLOW_COPY_AND_ASSIGN
 #define DISALLOW_COPY_AND_ASSIGN(TypeName)                                     \
     TypeName(const TypeName &);                                                \
@@ -27,7 +27,8 @@ public:
     explicit KVApp(int app_id) {
         obj_.reset(new Customer(
             app_id, app_id,
-            std::bind(&KVApp::Process, this, std::placeholders::_1)));
+            std::bind(&KVApp::Process, this, std::placeholders::_1),
+            std::bind(&KVApp::Peek, this, std::placeholders::_1)));
     }
     std::unique_ptr<Customer> obj_;
 
@@ -38,10 +39,20 @@ private:
         message_handlers[msg.meta.psftype](msg);
     }
 
+    // look at queued requests before they are processed
+    void Peek(const Message &msg) {
+        if (msg.meta.request && msg.meta.psftype < kNumPSfunction
+            && peek_handlers[msg.meta.psftype])
+            peek_handlers[msg.meta.psftype](msg);
+    }
+
     typedef std::function<void(const Message &)> MessageHandle;
     MessageHandle message_handlers[kNumPSfunction];
     template <PsfType, typename>
     friend struct KVAppRegisterHelper;
+
+protected:
+    MessageHandle peek_handlers[kNumPSfunction];
 };
 
 } // namespace ps
@@ -0,0 +1,469 @@
+#pragma once
+
+#include "common/logging.h"
+#include "common/sarray.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <numeric>
+#include <vector>
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace ps {
+
+/*
+  Codecs of PSF payloads. A worker picks the codec of each key and sends it
+  in Meta::codec with every request. The server decodes the request with it,
+  and encodes the response with Codec::responseCodec, whose values are
+  lossless unless the worker asks for fp16 or bf16 responses, so that pulls
+  of int8 requests do not quantize the weights. When a value codec or top-k
+  is on, every SArray<float> of the message is encoded with a header telling
+  how to decode it, and when kVarintOffsets is on, every SArray<size_t> is
+  delta and varint encoded.
+*/
+enum CodecType {
+    kNoCodec = 0,
+    kFp16 = 1,
+    kBf16 = 2,
+    // int8 with a float scale per block, the width of rows by default
+    kInt8 = 3,
+};
+
+constexpr int kValueCodecMask = 0xf;
+constexpr int kVarintOffsets = 1 << 4;
+// sends the top-k of dense pushes, and keeps the rest for later pushes
+constexpr int kTopK = 1 << 5;
+constexpr int kCodecFlagBits = 8;
+// bits of the value codec of responses in Meta::codec, above the flags
+constexpr int kResponseCodecBits = 4;
+
+struct Codec {
+    int flags = 0;
+    // elements sharing a scale of int8
+    size_t block = 1;
+    // fraction of elements in top-k
+    float topk_ratio = 0;
+    // error feedback of top-k, of the same size as the values encoded
+    float *residual = nullptr;
+    // value codec of responses, kNoCodec, kFp16 or kBf16
+    int response = kNoCodec;
+
+    Codec() = default;
+    // the codec packed into Meta::codec by meta()
+    explicit Codec(int meta_codec) :
+        flags(meta_codec & ((1 << kCodecFlagBits) - 1)),
+        block(std::max(meta_codec >> (kCodecFlagBits + kResponseCodecBits),
+                       1)),
+        response(meta_codec >> kCodecFlagBits
+                 & ((1 << kResponseCodecBits) - 1)) {
+    }
+    // packed into Meta::codec
+    int meta() const {
+        return flags | response << kCodecFlagBits
+               | static_cast<int>(block
+                                  << (kCodecFlagBits + kResponseCodecBits));
+    }
+    // codec of the response to a request with this codec. responses are
+    // never sparsified, as there is no residual for them.
+    Codec responseCodec() const {
+        CHECK(response == kNoCodec || response == kFp16 || response == kBf16)
+            << "Unsupported value codec of responses " << response;
+        Codec ret;
+        ret.flags = response | (flags & kVarintOffsets);
+        ret.block = block;
+        return ret;
+    }
+    bool encode_values() const {
+        return flags & (kValueCodecMask | kTopK);
+    }
+    bool encode_offsets() const {
+        return flags & kVarintOffsets;
+    }
+};
+
+namespace codec {
+
+enum PayloadKind : uint32_t {
+    kRaw,
+    kHalf,
+    kBFloat,
+    kQuantized,
+    kSparse,
+};
+
+struct Header {
+    uint32_t kind;
+    uint32_t block;
+    uint64_t numel;
+    // number of scales of kQuantized, or of elements of kSparse
+    uint64_t count;
+};
+
+inline uint16_t FloatToHalf(float value) {
+    uint32_t x;
+    std::memcpy(&x, &value, sizeof(x));
+    uint32_t sign = (x >> 16) & 0x8000;
+    int32_t exponent = static_cast<int32_t>((x >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = x & 0x7fffff;
+    if (((x >> 23) & 0xff) == 0xff)
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    if (exponent >= 31)
+        return sign | 0x7c00;
+    if (exponent <= 0) {
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        uint32_t shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1)))
+            half++;
+        return sign | half;
+    }
+    uint32_t half = sign | (exponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1fff;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1)))
+        half++;
+    return half;
+}
+
+inline float HalfToFloat(uint16_t half) {
+    uint32_t sign = static_cast<uint32_t>(half & 0x8000) << 16;
+    uint32_t exponent = (half >> 10) & 0x1f;
+    uint32_t mantissa = half & 0x3ff;
+    uint32_t x;
+    if (exponent == 0x1f) {
+        x = sign | 0x7f800000 | (mantissa << 13);
+    } else if (exponent == 0) {
+        if (mantissa == 0) {
+            x = sign;
+        } else {
+            // subnormal
+            exponent = 127 - 15 + 1;
+            while (!(mantissa & 0x400)) {
+                mantissa <<= 1;
+                exponent--;
+            }
+            x = sign | (exponent << 23) | ((mantissa & 0x3ff) << 13);
+        }
+    } else {
+        x = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+    }
+    float value;
+    std::memcpy(&value, &x, sizeof(value));
+    return value;
+}
+
+// whether EncodeHalf and DecodeHalf use F16C on this CPU
+inline bool IsHalfVectorized() {
+#if defined(__x86_64__)
+    static const bool has_f16c =
+        __builtin_cpu_supports("avx") && __builtin_cpu_supports("f16c");
+    return has_f16c;
+#else
+    return false;
+#endif
+}
+
+#if defined(__x86_64__)
+// compiled for F16C only and called after checking the CPU, so that the
+// library runs on any x86-64 host. both return the number of elements
+// converted, a multiple of 8.
+__attribute__((target("avx,f16c"))) inline size_t
+EncodeHalfF16C(const float *src, uint16_t *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m128i half = _mm256_cvtps_ph(_mm256_loadu_ps(src + i),
+                                       _MM_FROUND_TO_NEAREST_INT);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), half);
+    }
+    return i;
+}
+
+__attribute__((target("avx,f16c"))) inline size_t
+DecodeHalfF16C(const uint16_t *src, float *dst, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+        _mm256_storeu_ps(dst + i,
+                         _mm256_cvtph_ps(_mm_loadu_si128(
+                             reinterpret_cast<const __m128i *>(src + i))));
+    return i;
+}
+#endif
+
+inline void EncodeHalf(const float *src, uint16_t *dst, size_t n,
+                       bool vectorized = true) {
+    size_t i = 0;
+#if defined(__x86_64__)
+    if (vectorized && IsHalfVectorized())
+        i = EncodeHalfF16C(src, dst, n);
+#endif
+    for (; i < n; i++)
+        dst[i] = FloatToHalf(src[i]);
+}
+
+inline void DecodeHalf(const uint16_t *src, float *dst, size_t n,
+                       bool vectorized = true) {
+    size_t i = 0;
+#if defined(__x86_64__)
+    if (vectorized && IsHalfVectorized())
+        i = DecodeHalfF16C(src, dst, n);
+#endif
+    for (; i < n; i++)
+        dst[i] = HalfToFloat(src[i]);
+}
+
+// rounds to nearest even, NaNs are kept quiet
+inline void EncodeBFloat(const float *src, uint16_t *dst, size_t n) {
+    const uint32_t *bits = reinterpret_cast<const uint32_t *>(src);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t x = bits[i];
+        uint32_t rounded = (x + 0x7fff + ((x >> 16) & 1)) >> 16;
+        bool nan = (x & 0x7fffffff) > 0x7f800000;
+        dst[i] = nan ? static_cast<uint16_t>((x >> 16) | 0x40) : rounded;
+    }
+}
+
+inline void DecodeBFloat(const uint16_t *src, float *dst, size_t n) {
+    uint32_t *bits = reinterpret_cast<uint32_t *>(dst);
+    for (size_t i = 0; i < n; i++)
+        bits[i] = static_cast<uint32_t>(src[i]) << 16;
+}
+
+inline void Quantize(const float *src, float *scales, int8_t *dst, size_t n,
+                     size_t block) {
+    for (size_t begin = 0, b = 0; begin < n; begin += block, b++) {
+        size_t end = std::min(begin + block, n);
+        float max_abs = 0;
+        for (size_t i = begin; i < end; i++)
+            max_abs = std::max(max_abs, std::fabs(src[i]));
+        float scale = max_abs / 127;
+        float inv = scale > 0 ? 1 / scale : 0;
+        scales[b] = scale;
+        for (size_t i = begin; i < end; i++) {
+            float q = src[i] * inv;
+            dst[i] = static_cast<int8_t>(q + (q >= 0 ? 0.5f : -0.5f));
+        }
+    }
+}
+
+inline void Dequantize(const float *scales, const int8_t *src, float *dst,
+                       size_t n, size_t block) {
+    for (size_t begin = 0, b = 0; begin < n; begin += block, b++) {
+        size_t end = std::min(begin + block, n);
+        float scale = scales[b];
+        for (size_t i = begin; i < end; i++)
+            dst[i] = src[i] * scale;
+    }
+}
+
+inline void PutVarint(uint64_t value, std::vector<uint8_t> &out) {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+inline uint64_t GetVarint(const uint8_t *&ptr, const uint8_t *end) {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        CHECK(ptr < end) << "Truncated varint in PSF payload";
+        uint8_t byte = *ptr++;
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80))
+            return value;
+    }
+    LOG(FATAL) << "Malformed varint in PSF payload";
+    return value;
+}
+
+// Deltas of offsets, zigzag encoded so that unsorted offsets also work.
+inline void PutDeltas(const size_t *offsets, size_t n,
+                      std::vector<uint8_t> &out) {
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; i++) {
+        int64_t delta = static_cast<int64_t>(offsets[i] - prev);
+        PutVarint((static_cast<uint64_t>(delta) << 1) ^ (delta >> 63), out);
+        prev = offsets[i];
+    }
+}
+
+inline void GetDeltas(const uint8_t *&ptr, const uint8_t *end,
+                      size_t *offsets, size_t n) {
+    uint64_t prev = 0;
+    for (size_t i = 0; i < n; i++) {
+        uint64_t zigzag = GetVarint(ptr, end);
+        prev += (zigzag >> 1) ^ (~(zigzag & 1) + 1);
+        offsets[i] = prev;
+    }
+}
+
+inline SArray<char> Pack(const Header &header, const void *body,
+                         size_t body_bytes) {
+    SArray<char> ret(sizeof(Header) + body_bytes);
+    std::memcpy(ret.data(), &header, sizeof(Header));
+    if (body_bytes > 0)
+        std::memcpy(ret.data() + sizeof(Header), body, body_bytes);
+    return ret;
+}
+
+inline Header Unpack(const SArray<char> &payload) {
+    CHECK_GE(payload.size(), sizeof(Header)) << "Truncated PSF payload";
+    Header header;
+    std::memcpy(&header, payload.data(), sizeof(Header));
+    return header;
+}
+
+// Top-k of residual + values by magnitude. Selected elements are taken out
+// of the residual, and the rest are kept for later pushes.
+inline SArray<char> EncodeTopK(const SArray<float> &values, float *residual,
+                               float ratio) {
+    size_t n = values.size();
+    for (size_t i = 0; i < n; i++)
+        residual[i] += values[i];
+    size_t k = std::min(
+        n, std::max<size_t>(static_cast<size_t>(std::ceil(n * ratio)), 1));
+    if (n == 0)
+        k = 0;
+    std::vector<size_t> indices(n);
+    std::iota(indices.begin(), indices.end(), 0);
+    if (k < n)
+        std::nth_element(indices.begin(), indices.begin() + k, indices.end(),
+                         [&](size_t lhs, size_t rhs) {
+                             return std::fabs(residual[lhs])
+                                    > std::fabs(residual[rhs]);
+                         });
+    indices.resize(k);
+    std::sort(indices.begin(), indices.end());
+    std::vector<uint8_t> body(k * sizeof(float));
+    float *selected = reinterpret_cast<float *>(body.data());
+    for (size_t i = 0; i < k; i++) {
+        selected[i] = residual[indices[i]];
+        residual[indices[i]] = 0;
+    }
+    PutDeltas(indices.data(), k, body);
+    return Pack({kSparse, 1, n, k}, body.data(), body.size());
+}
+
+} // namespace codec
+
+inline SArray<char> EncodeValues(const SArray<float> &values,
+                                 const Codec &codec) {
+    using namespace codec;
+    size_t n = values.size();
+    if ((codec.flags & kTopK) && codec.residual && codec.topk_ratio > 0)
+        return EncodeTopK(values, codec.residual, codec.topk_ratio);
+    switch (codec.flags & kValueCodecMask) {
+    case kFp16:
+    case kBf16: {
+        bool half = (codec.flags & kValueCodecMask) == kFp16;
+        SArray<char> ret(sizeof(Header) + n * sizeof(uint16_t));
+        Header header{half ? kHalf : kBFloat, 1, n, 0};
+        std::memcpy(ret.data(), &header, sizeof(Header));
+        uint16_t *dst = reinterpret_cast<uint16_t *>(ret.data() + sizeof(Header));
+        if (half)
+            EncodeHalf(values.data(), dst, n);
+        else
+            EncodeBFloat(values.data(), dst, n);
+        return ret;
+    }
+    case kInt8: {
+        size_t block = std::max<size_t>(codec.block, 1);
+        size_t num_blocks = (n + block - 1) / block;
+        SArray<char> ret(sizeof(Header) + num_blocks * sizeof(float) + n);
+        Header header{kQuantized, static_cast<uint32_t>(block), n,
+                      num_blocks};
+        std::memcpy(ret.data(), &header, sizeof(Header));
+        float *scales = reinterpret_cast<float *>(ret.data() + sizeof(Header));
+        Quantize(values.data(), scales,
+                 reinterpret_cast<int8_t *>(scales + num_blocks), n, block);
+        return ret;
+    }
+    default:
+        return Pack({kRaw, 1, n, 0}, values.data(), n * sizeof(float));
+    }
+}
+
+inline SArray<float> DecodeValues(const SArray<char> &payload) {
+    using namespace codec;
+    Header header = Unpack(payload);
+    size_t n = header.numel;
+    const char *body = payload.data() + sizeof(Header);
+    size_t body_bytes = payload.size() - sizeof(Header);
+    SArray<float> ret(n);
+    switch (header.kind) {
+    case kRaw:
+        CHECK_EQ(body_bytes, n * sizeof(float)) << "Malformed PSF payload";
+        std::memcpy(ret.data(), body, body_bytes);
+        break;
+    case kHalf:
+    case kBFloat: {
+        CHECK_EQ(body_bytes, n * sizeof(uint16_t)) << "Malformed PSF payload";
+        // the body is not aligned after varying headers of other arrays
+        std::vector<uint16_t> bits(n);
+        std::memcpy(bits.data(), body, body_bytes);
+        if (header.kind == kHalf)
+            DecodeHalf(bits.data(), ret.data(), n);
+        else
+            DecodeBFloat(bits.data(), ret.data(), n);
+        break;
+    }
+    case kQuantized: {
+        CHECK_EQ(body_bytes, header.count * sizeof(float) + n)
+            << "Malformed PSF payload";
+        std::vector<float> scales(header.count);
+        std::memcpy(scales.data(), body, header.count * sizeof(float));
+        Dequantize(scales.data(),
+                   reinterpret_cast<const int8_t *>(
+                       body + header.count * sizeof(float)),
+                   ret.data(), n, header.block);
+        break;
+    }
+    case kSparse: {
+        size_t k = header.count;
+        CHECK_GE(body_bytes, k * sizeof(float)) << "Malformed PSF payload";
+        std::vector<float> selected(k);
+        std::memcpy(selected.data(), body, k * sizeof(float));
+        std::vector<size_t> indices(k);
+        const uint8_t *ptr =
+            reinterpret_cast<const uint8_t *>(body + k * sizeof(float));
+        GetDeltas(ptr, reinterpret_cast<const uint8_t *>(body + body_bytes),
+                  indices.data(), k);
+        for (size_t i = 0; i < k; i++) {
+            CHECK_LT(indices[i], n) << "Malformed PSF payload";
+            ret[indices[i]] = selected[i];
+        }
+        break;
+    }
+    default:
+        LOG(FATAL) << "Unknown kind of PSF payload " << header.kind;
+    }
+    return ret;
+}
+
+inline SArray<char> EncodeOffsets(const SArray<size_t> &offsets) {
+    std::vector<uint8_t> body;
+    body.reserve(offsets.size() * 2);
+    codec::PutDeltas(offsets.data(), offsets.size(), body);
+    return codec::Pack({codec::kRaw, 1, offsets.size(), 0}, body.data(),
+                       body.size());
+}
+
+inline SArray<size_t> DecodeOffsets(const SArray<char> &payload) {
+    codec::Header header = codec::Unpack(payload);
+    SArray<size_t> ret(header.numel);
+    const uint8_t *ptr =
+        reinterpret_cast<const uint8_t *>(payload.data() + sizeof(header));
+    codec::GetDeltas(
+        ptr, reinterpret_cast<const uint8_t *>(payload.data() + payload.size()),
+        ret.data(), header.numel);
+    return ret;
+}
+
+} // namespace ps
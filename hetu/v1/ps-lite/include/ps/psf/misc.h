@@ -24,7 +24,8 @@ struct PSFData<ParamInit> {
                           double,             // init_b
                           unsigned long long, // seed
                           int,                // opt_type
-                          SArray<float>       // opt arguments
+                          SArray<float>,      // opt arguments
+                          bool                // applied by servers
                           >;
     using Response = tuple<>;
     static void _callback(const Response &response) {
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "common/sarray.h"
+#include "ps/psf/codec.h"
 
 #include <tuple>
 #include <vector>
@@ -30,7 +31,7 @@ public:
     // encode scalar type, put it in target[0]
     template <typename dtype>
     static void _encode(const dtype &t, vector<SArray<char>> &target,
-                        ScalarTag<true>) {
+                        ScalarTag<true>, const Codec &codec) {
         size_t cur_size = target[0].size();
         target[0].resize(cur_size + sizeof(dtype));
         dtype *ptr = reinterpret_cast<dtype *>(target[0].data() + cur_size);
@@ -39,22 +40,38 @@ public:
     // encode sarray type, append it to target(no copy)
     template <typename dtype>
     static void _encode(const dtype &t, vector<SArray<char>> &target,
-                        ScalarTag<false>) {
+                        ScalarTag<false>, const Codec &codec) {
         SArray<char> bytes(t);
         target.push_back(bytes);
     }
+    // encode values and offsets with the codec, if any
+    static void _encode(const SArray<float> &t, vector<SArray<char>> &target,
+                        ScalarTag<false>, const Codec &codec) {
+        if (codec.encode_values())
+            target.push_back(EncodeValues(t, codec));
+        else
+            target.push_back(SArray<char>(t));
+    }
+    static void _encode(const SArray<size_t> &t, vector<SArray<char>> &target,
+                        ScalarTag<false>, const Codec &codec) {
+        if (codec.encode_offsets())
+            target.push_back(EncodeOffsets(t));
+        else
+            target.push_back(SArray<char>(t));
+    }
     // encode a tuple from back to front
-    static void encode(const Tuple &tup, vector<SArray<char>> &target) {
+    static void encode(const Tuple &tup, vector<SArray<char>> &target,
+                       const Codec &codec) {
         auto &t = std::get<N - 1>(tup);
         typedef typename std::remove_reference<decltype(t)>::type dtype;
-        _encode(t, target, typename isScalar<dtype>::Tag());
-        tupleSerializer<Tuple, N - 1>::encode(tup, target);
+        _encode(t, target, typename isScalar<dtype>::Tag(), codec);
+        tupleSerializer<Tuple, N - 1>::encode(tup, target, codec);
     }
     //---------------------------------Decode---------------------------------------
     template <typename dtype>
     static void _decode(dtype &t, const vector<SArray<char>> &target,
                         ScalarTag<true>, size_t &scalar_hint,
-                        size_t &array_hint) {
+                        size_t &array_hint, const Codec &codec) {
         dtype *ptr = reinterpret_cast<dtype *>(target[0].data() + scalar_hint
                                                - sizeof(dtype));
         t = *ptr;
@@ -63,20 +80,39 @@ public:
     template <typename dtype>
     static void _decode(dtype &t, const vector<SArray<char>> &target,
                         ScalarTag<false>, size_t &scalar_hint,
-                        size_t &array_hint) {
+                        size_t &array_hint, const Codec &codec) {
         t = target[array_hint - 1];
         array_hint--;
     }
+    static void _decode(SArray<float> &t, const vector<SArray<char>> &target,
+                        ScalarTag<false>, size_t &scalar_hint,
+                        size_t &array_hint, const Codec &codec) {
+        if (codec.encode_values())
+            t = DecodeValues(target[array_hint - 1]);
+        else
+            t = target[array_hint - 1];
+        array_hint--;
+    }
+    static void _decode(SArray<size_t> &t, const vector<SArray<char>> &target,
+                        ScalarTag<false>, size_t &scalar_hint,
+                        size_t &array_hint, const Codec &codec) {
+        if (codec.encode_offsets())
+            t = DecodeOffsets(target[array_hint - 1]);
+        else
+            t = target[array_hint - 1];
+        array_hint--;
+    }
     // scalar_hint, array_hint, tell where to take the data from target
     static void decode(Tuple &tup, const vector<SArray<char>> &target,
-                       size_t scalar_hint, size_t array_hint) {
+                       size_t scalar_hint, size_t array_hint,
+                       const Codec &codec) {
         // When decode, from front to back
         auto &t = std::get<std::tuple_size<Tuple>::value - N>(tup);
         typedef typename std::remove_reference<decltype(t)>::type dtype;
         _decode(t, target, typename isScalar<dtype>::Tag(), scalar_hint,
-                array_hint);
+                array_hint, codec);
         tupleSerializer<Tuple, N - 1>::decode(tup, target, scalar_hint,
-                                              array_hint);
+                                              array_hint, codec);
     }
 };
 
@@ -84,27 +120,47 @@ public:
 template <typename Tuple>
 class tupleSerializer<Tuple, 0> {
 public:
-    static void encode(const Tuple &tup, vector<SArray<char>> &target) {
+    static void encode(const Tuple &tup, vector<SArray<char>> &target,
+                       const Codec &codec) {
     }
     static void decode(Tuple &tup, const vector<SArray<char>> &target,
-                       size_t scalar_hint, size_t array_hint) {
+                       size_t scalar_hint, size_t array_hint,
+                       const Codec &codec) {
     }
 };
 
 // ------------------------------ Exported APIs
 // ------------------------------------------------
+// Decodes only the first element of a tuple, which must be a scalar, e.g.,
+// the key of a request. It is the last scalar encoded.
+template <typename Tuple>
+typename std::tuple_element<0, Tuple>::type
+tupleDecodeFirst(const vector<SArray<char>> &dest) {
+    using dtype = typename std::tuple_element<0, Tuple>::type;
+    static_assert(isScalar<dtype>::value, "The first element is not scalar");
+    CHECK_GE(dest[0].size(), sizeof(dtype)) << "Truncated PSF message";
+    dtype ret;
+    std::memcpy(&ret, dest[0].data() + dest[0].size() - sizeof(dtype),
+                sizeof(dtype));
+    return ret;
+}
+
 template <typename Tuple>
-void tupleEncode(const Tuple &tup, vector<SArray<char>> &dest) {
+void tupleEncode(const Tuple &tup, vector<SArray<char>> &dest,
+                 const Codec &codec = Codec()) {
     dest.clear();
     dest.push_back(SArray<char>()); // Reserve for scalar types
     dest[0].reserve(sizeof(Tuple));
-    tupleSerializer<Tuple, std::tuple_size<Tuple>::value>::encode(tup, dest);
+    tupleSerializer<Tuple, std::tuple_size<Tuple>::value>::encode(tup, dest,
+                                                                  codec);
 }
 
+// codec is the flags the arrays are encoded with, from Meta::codec
 template <typename Tuple>
-void tupleDecode(Tuple &tup, const vector<SArray<char>> &dest) {
+void tupleDecode(Tuple &tup, const vector<SArray<char>> &dest,
+                 const Codec &codec = Codec()) {
     tupleSerializer<Tuple, std::tuple_size<Tuple>::value>::decode(
-        tup, dest, dest[0].size(), dest.size());
+        tup, dest, dest[0].size(), dest.size(), codec);
 }
 
 } // namespace ps
@@ -4,6 +4,7 @@
 
 #include "common/thread_safe_hash_map.h"
 #include "param.h"
+#include "tiered_table.h"
 #include <algorithm>
 #include <utility>
 #include <mutex>
@@ -31,6 +32,8 @@ public:
 
         auto iter = const_store.find(k);
         if (iter != const_store.end()) {
+            CHECK_NE(iter->second->type(), kTieredTable)
+                << "DensePull is not supported by tiered tables";
             auto &value_set_ = *iter->second;
             size_t data_size = value_set_.size();
             CHECK_EQ(len, data_size) << " size mismatch in DensePull " << k
@@ -58,13 +61,13 @@ public:
             CHECK_EQ(len, iter->second->size())
                 << k << " " << len << " " << iter->second->size()
                 << " size mismatch in DensePush";
+            CHECK_NE(iter->second->type(), kTieredTable)
+                << "DensePush is not supported by tiered tables";
             // write, discard const qualifier
             auto &value_set_ =
                 *const_cast<typename tmap::mapped_type &>(iter->second);
             auto write_lock = value_set_.write_guard();
-#pragma omp parallel for num_threads(4)
-            for (size_t j = 0; j < value_set_.size(); j++)
-                value_set_[j] += vals[j];
+            value_set_.PushDense(vals);
         } else {
             LG << "Key does not exist on PS in DensePull" << k;
         }
@@ -81,6 +84,8 @@ public:
 
         auto iter = const_store.find(k);
         if (iter != const_store.end()) {
+            CHECK_NE(iter->second->type(), kTieredTable)
+                << "DDPushPull is not supported by tiered tables";
             auto &value_set_ =
                 *const_cast<typename tmap::mapped_type &>(iter->second);
             size_t data_size = value_set_.size();
@@ -88,11 +93,8 @@ public:
                 << " size mismatch in DDPushPull " << len << " " << data_size;
             pull_vals.resize(data_size);
             auto write_lock = value_set_.write_guard();
-#pragma omp parallel for num_threads(4)
-            for (size_t j = 0; j < data_size; j++) {
-                value_set_[j] += vals[j];
-                pull_vals[j] = value_set_[j];
-            }
+            value_set_.PushDense(vals);
+            std::copy(value_set_.begin(), value_set_.end(), pull_vals.begin());
         } else {
             LG << "Key does not exist on PS in DensePull" << k;
         }
@@ -112,14 +114,7 @@ public:
                 *std::dynamic_pointer_cast<Param2D<float>>(iter->second);
             size_t width = value_set_.width;
             pull_vals.resize(offset.size() * width);
-            auto read_lock = value_set_.read_guard();
-#pragma omp parallel for num_threads(4)
-            for (size_t j = 0; j < offset.size(); ++j) {
-                auto value_begin = value_set_.data() + offset[j] * width;
-                auto value_end = value_begin + width;
-                auto dst_begin = pull_vals.data() + j * width;
-                std::copy(value_begin, value_end, dst_begin);
-            }
+            value_set_.PullRows(offset, pull_vals);
         } else {
             // error, the key does not exist on PS.
             LF << "[Error] The pulled key: " << k
@@ -146,16 +141,7 @@ public:
                 << " size of vals is " << vals.size() << " size of lens is "
                 << offsets.size() << " size of width is " << width;
 
-            // write, discard const qualifier
-            auto write_lock = value_set_.write_guard();
-#pragma omp parallel for num_threads(4)
-            for (size_t j = 0; j < offsets.size(); ++j) {
-                size_t src_offset = j * width;
-                size_t dst_offset = offsets[j] * width;
-                for (size_t k = 0; k < width; ++k) {
-                    value_set_[dst_offset + k] += vals[src_offset + k];
-                }
-            }
+            value_set_.PushRows(offsets, vals);
         } else {
             // error, the key does not exist on PS.
             LF << "[Error] The pushed key: " << k
@@ -179,6 +165,8 @@ public:
             CHECK_EQ(len, value_set_.size())
                 << " size mismatch in SDPushPull " << k << " " << len << " "
                 << value_set_.size();
+            CHECK_NE(value_set_.type(), kTieredTable)
+                << "SDPushPull is not supported by tiered tables";
 
             // sparsepush phase
             if (vals.size() > 0) {
@@ -187,16 +175,7 @@ public:
                     << " size of vals is " << vals.size() << " size of lens is "
                     << offsets.size() << " size of width is " << width;
 
-                // write, discard const qualifier
-                auto write_lock = value_set_.write_guard();
-#pragma omp parallel for num_threads(4)
-                for (size_t j = 0; j < offsets.size(); ++j) {
-                    size_t src_offset = j * width;
-                    size_t dst_offset = offsets[j] * width;
-                    for (size_t k = 0; k < width; ++k) {
-                        value_set_[dst_offset + k] += vals[src_offset + k];
-                    }
-                }
+                value_set_.PushRows(offsets, vals);
             }
             // densepull phase
             pull_vals.resize(value_set_.size());
@@ -230,30 +209,13 @@ public:
                     << " size of vals is " << vals.size() << " size of lens is "
                     << push_offsets.size() << " size of width is " << width;
 
-                // write, discard const qualifier
-                auto write_lock = value_set_.write_guard();
-#pragma omp parallel for num_threads(4)
-                for (size_t j = 0; j < push_offsets.size(); ++j) {
-                    size_t src_offset = j * width;
-                    size_t dst_offset = push_offsets[j] * width;
-                    for (size_t k = 0; k < width; ++k) {
-                        value_set_[dst_offset + k] += vals[src_offset + k];
-                    }
-                }
+                value_set_.PushRows(push_offsets, vals);
             }
 
             // sparsepull phase
             if (pull_offsets.size() > 0) {
                 pull_vals.resize(pull_offsets.size() * width);
-                auto read_lock = value_set_.read_guard();
-#pragma omp parallel for num_threads(4)
-                for (size_t j = 0; j < pull_offsets.size(); ++j) {
-                    auto val_begin =
-                        value_set_.begin() + pull_offsets[j] * width;
-                    auto val_end = val_begin + width;
-                    auto dst_begin = pull_vals.begin() + j * width;
-                    std::copy(val_begin, val_end, dst_begin);
-                }
+                value_set_.PullRows(pull_offsets, pull_vals);
             }
         } else {
             // error, the key does not exist on PS.
@@ -281,8 +243,9 @@ public:
         double init_a = get<5>(request);
         double init_b = get<6>(request);
         unsigned long long seed = get<7>(request);
-        OptType otype = (OptType)get<8>(request);
         SArray<float> lrs = get<9>(request);
+        // without server optimizers, pushes are added to params
+        OptType otype = get<10>(request) ? (OptType)get<8>(request) : None;
 
         if (!try_init_with_no_conflict(k))
             return;
@@ -297,6 +260,11 @@ public:
             break;
         case kCacheTable:
             newParam = new CacheTable<float>(len, width, otype, lrs);
+            break;
+        case kTieredTable:
+            // rows are initialized on first access
+            newParam = new TieredTable<float>(len, width, otype, lrs,
+                                              init_type, init_a, init_b, seed);
         }
         auto iter = store.find(k);
         iter->second = tmap::mapped_type(newParam);
@@ -304,6 +272,8 @@ public:
         CHECK_EQ(len * width, iter->second->size())
             << k << " " << len << " " << width << " " << iter->second->size()
             << " size mismatch in UniformInit";
+        if (param_type == kTieredTable)
+            return;
         // write, discard const qualifier
         auto &value_set_ =
             *const_cast<typename tmap::mapped_type &>(iter->second);
@@ -392,6 +362,11 @@ public:
         SArray<char> address = get<1>(request);
         auto iter = store.find(k);
         if (iter != store.end()) {
+            if (iter->second->type() == kTieredTable) {
+                std::dynamic_pointer_cast<TieredTable<float>>(iter->second)
+                    ->Save(std::string(address.data(), address.size()));
+                return;
+            }
             auto &value_set_ = *iter->second;
             auto read_lock = value_set_.read_guard();
             std::ofstream fout(
@@ -412,6 +387,11 @@ public:
         SArray<char> address = get<1>(request);
         auto iter = store.find(k);
         if (iter != store.end()) {
+            if (iter->second->type() == kTieredTable) {
+                std::dynamic_pointer_cast<TieredTable<float>>(iter->second)
+                    ->Load(std::string(address.data(), address.size()));
+                return;
+            }
             auto &value_set_ = *iter->second;
             auto write_lock = value_set_.write_guard();
             std::ifstream fin(
@@ -426,6 +406,24 @@ public:
         }
     }
 
+    // Whether rows of the key are worth prefetching, i.e., the key is a
+    // tiered table.
+    bool needs_prefetch(Key k) {
+        auto iter = const_store.find(k);
+        return iter != const_store.end() && iter->second
+               && iter->second->type() == kTieredTable;
+    }
+
+    // Called when a request is queued, so that rows of tiered tables are
+    // loaded before the request is served.
+    void prefetch(Key k, const SArray<size_t> &offsets) {
+        auto iter = const_store.find(k);
+        if (iter != const_store.end() && iter->second
+            && iter->second->type() == kTieredTable)
+            std::dynamic_pointer_cast<Param2D<float>>(iter->second)
+                ->Prefetch(offsets);
+    }
+
 private:
     bool try_init_with_no_conflict(Key key) {
         static std::mutex init_mtx;
@@ -28,6 +28,10 @@ public:
         handler_[static_cast<int>(PsfGroup::kParameterServer)] = std::make_shared<PSHandler<PsfGroup::kParameterServer>>();
         handler_[static_cast<int>(PsfGroup::kSSPControl)] = std::make_shared<PSHandler<PsfGroup::kSSPControl>>();
         handler_[static_cast<int>(PsfGroup::kPReduceScheduler)] = std::make_shared<PSHandler<PsfGroup::kPReduceScheduler>>();
+        // prefetch rows of queued sparse requests
+        peek_handlers[SparsePush] = std::bind(&KVServer::onPeek<SparsePush, 1>, this, std::placeholders::_1);
+        peek_handlers[SparsePull] = std::bind(&KVServer::onPeek<SparsePull, 1>, this, std::placeholders::_1);
+        peek_handlers[SSPushPull] = std::bind(&KVServer::onPeek<SSPushPull, 3>, this, std::placeholders::_1);
     }
 
 private:
@@ -35,19 +39,35 @@ private:
     void onReceive(const Message &msg) {
         typename PSFData<ftype>::Request request;
         typename PSFData<ftype>::Response response;
-        tupleDecode(request, msg.data);
+        Codec codec(msg.meta.codec);
+        tupleDecode(request, msg.data, codec);
         constexpr PsfGroup group = PSFData<ftype>::group;
         auto handler = std::dynamic_pointer_cast<PSHandler<group>>(handler_[static_cast<int>(group)]);
         assert(handler);
         handler->serve(request, response);
         Message rmsg;
-        tupleEncode(response, rmsg.data);
+        Codec response_codec = codec.responseCodec();
+        tupleEncode(response, rmsg.data, response_codec);
         rmsg.meta = msg.meta;
+        rmsg.meta.codec = response_codec.meta();
         rmsg.meta.recver = msg.meta.sender;
         rmsg.meta.request = false;
         Postoffice::Get()->van()->Send(rmsg);
     }
 
+    // prefetches rows of the request at the index of the offsets. only the
+    // key is decoded for tables in memory, which need no prefetching.
+    template <PsfType ftype, size_t offsets_index>
+    void onPeek(const Message &msg) {
+        using Request = typename PSFData<ftype>::Request;
+        auto handler = std::dynamic_pointer_cast<PSHandler<PsfGroup::kParameterServer>>(handler_[static_cast<int>(PsfGroup::kParameterServer)]);
+        if (!handler->needs_prefetch(tupleDecodeFirst<Request>(msg.data)))
+            return;
+        Request request;
+        tupleDecode(request, msg.data, Codec(msg.meta.codec));
+        handler->prefetch(get<0>(request), get<offsets_index>(request));
+    }
+
     /** \brief request handle */
     std::unordered_map<int, std::shared_ptr<PSHandler<PsfGroup::kBaseGroup>>> handler_;
     template <PsfType, typename>
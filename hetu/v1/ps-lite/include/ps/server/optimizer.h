@@ -1,17 +1,16 @@
 #pragma once
 
+#include <atomic>
 #include <cmath>
-#include "ps/server/param.h"
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "ps/internal/utils.h"
+#include "ps/psf/codec.h"
 
 namespace ps {
 
-template <typename V>
-class Param;
-template <typename V>
-class Param2D;
-template <typename V>
-class CacheTable;
-
 enum OptType {
     SGD,
     Momentum,
@@ -21,184 +20,282 @@ enum OptType {
     None,
 };
 
-template <typename V>
-class Optimizer {
-public:
-    virtual void ApplyDense(Param<V> &param, SArray<V> &grads);
-    virtual void ApplySparse(Param2D<V> &param, SArray<size_t> &offsets,
-                             SArray<V> &grads);
-    virtual void ApplyCache(CacheTable<V> &param, SArray<version_t> &updates,
-                            SArray<size_t> &offsets, SArray<V> &grads);
-    virtual void InitStates(size_t size);
-};
+/*
+  States of the rows of a param, allocated on the first update of each row,
+  so that a sparse table only keeps states of the rows pushed to it. Blocks
+  of states are taken from chunks in the order rows are first updated. A
+  dense param is a table of a single row.
 
-template <typename V>
-class SGDOptimizer : public Optimizer<V> {
+  Rows are not accessed concurrently, which is guaranteed by the stripe
+  locks of Param2D.
+*/
+class RowStates {
 public:
-    explicit SGDOptimizer(float learning_rate) : lr(learning_rate) {
+    explicit RowStates(size_t length, size_t block_bytes) :
+        slots_(length, 0), block_bytes_((block_bytes + 15) / 16 * 16),
+        chunk_blocks_(std::min<size_t>(std::max<size_t>(length, 1), 1024)),
+        chunks_(new std::atomic<char *>[(length + chunk_blocks_ - 1)
+                                        / chunk_blocks_]()) {
+        CHECK_LT(length, size_t(UINT32_MAX)) << "Too many rows for states";
     }
-
-    void ApplyDense(Param<V> &param, SArray<V> &grads) {
-#pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < param.size(); ++j) {
-            param[j] -= lr * grads[j];
-        }
+    ~RowStates() {
+        size_t num_chunks =
+            (slots_.size() + chunk_blocks_ - 1) / chunk_blocks_;
+        for (size_t i = 0; i < num_chunks; i++)
+            delete[] chunks_[i].load();
     }
 
-    void ApplySparse(Param2D<V> &param, SArray<size_t> &offsets,
-                     SArray<V> &grads) {
-        size_t width = param.width;
-#pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < offsets.size(); ++j) {
-            size_t src_offset = j * width;
-            size_t dst_offset = offsets[j] * width;
-            for (size_t k = 0; k < width; ++k) {
-                param[dst_offset + k] -= lr * grads[src_offset + k];
-            }
+    /*
+      Returns the states of the row and sets *step to its number of updates,
+      calling init(block) if the row has no states yet.
+    */
+    template <typename F>
+    char *Get(size_t row, uint64_t **step, F &&init) {
+        uint32_t slot = slots_[row];
+        bool created = slot == 0;
+        if (created) {
+            slot = num_slots_++;
+            slots_[row] = slot + 1;
+        } else {
+            slot--;
         }
-    }
-
-    void ApplyCache(CacheTable<V> &param, SArray<version_t> &updates,
-                    SArray<size_t> &offsets, SArray<V> &grads) {
-        size_t width = param.width;
-        // #pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < offsets.size(); ++j) {
-            param.ver[offsets[j]] += updates[j];
-            size_t src_offset = j * width;
-            size_t dst_offset = offsets[j] * width;
-            for (size_t k = 0; k < width; ++k) {
-                param[dst_offset + k] -= lr * grads[src_offset + k];
+        char *chunk = chunks_[slot / chunk_blocks_].load(
+            std::memory_order_acquire);
+        if (!chunk) {
+            std::lock_guard<std::mutex> lock(mtx_);
+            chunk = chunks_[slot / chunk_blocks_].load();
+            if (!chunk) {
+                chunk = new char[chunk_blocks_
+                                 * (sizeof(uint64_t) + block_bytes_)];
+                chunks_[slot / chunk_blocks_].store(chunk,
+                                                    std::memory_order_release);
             }
         }
+        // steps of the chunk, then blocks
+        size_t i = slot % chunk_blocks_;
+        *step = reinterpret_cast<uint64_t *>(chunk) + i;
+        char *block =
+            chunk + chunk_blocks_ * sizeof(uint64_t) + i * block_bytes_;
+        if (created) {
+            **step = 0;
+            init(block);
+        }
+        return block;
     }
 
-    void InitStates(size_t size) {
+    // number of rows with states
+    size_t size() const {
+        return num_slots_;
     }
 
 private:
-    float lr;
+    std::vector<uint32_t> slots_;
+    size_t block_bytes_;
+    size_t chunk_blocks_;
+    std::unique_ptr<std::atomic<char *>[]> chunks_;
+    std::atomic<uint32_t> num_slots_{0};
+    std::mutex mtx_;
 };
 
-// Optimizers below need tests! No correctness guarantees.
+/*
+  Server side optimizers, applying pushed gradients on arrival. Updates are
+  written as kernels over contiguous spans in fp32, vectorized with omp simd.
+  Each row of a table counts its own updates, so Adam corrects the bias of
+  its moments with the steps of the row, as lazy Adam does.
+
+  PS_SERVER_FP16_STATES=1 keeps states in fp16, halving their memory. Second
+  moments are kept as their square roots, which have the range of gradients
+  and do not underflow in fp16.
+*/
 template <typename V>
-class MomentumOptimizer : public Optimizer<V> {
+class Optimizer {
 public:
-    explicit MomentumOptimizer(float learning_rate, float momentum) :
-        lr(learning_rate), moment(momentum) {
+    static constexpr size_t kMaxStates = 2;
+    static constexpr size_t kSpan = 4096;
+
+    virtual ~Optimizer() {
+    }
+
+    // states of length rows of width values
+    void InitStates(size_t length, size_t width) {
+        width_ = width;
+        half_ = GetEnv("PS_SERVER_FP16_STATES", 0) != 0;
+        if (num_states_)
+            states_.reset(new RowStates(
+                length, num_states_ * width
+                            * (half_ ? sizeof(uint16_t) : sizeof(float))));
     }
 
-    void ApplyDense(Param<V> &param, SArray<V> &grads) {
-#pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < param.size(); ++j) {
-            velocity[j] = moment * velocity[j] - lr * grads[j];
-            param[j] = param[j] + velocity[j];
+    // applies grads to a dense param of the width of InitStates
+    void ApplyDense(V *param, const V *grads) {
+        uint64_t *step = &dense_step_;
+        char *block = num_states_ ? Block(0, &step) : nullptr;
+        ++*step;
+        int num_spans = static_cast<int>((width_ + kSpan - 1) / kSpan);
+#pragma omp parallel for num_threads(GetServerNumThreads())
+        for (int i = 0; i < num_spans; i++) {
+            size_t begin = i * kSpan;
+            size_t n = std::min(begin + kSpan, width_) - begin;
+            Apply(block, begin, n, param + begin, grads + begin, *step);
         }
     }
 
-    void ApplySparse(Param2D<V> &param, SArray<size_t> &offsets,
-                     SArray<V> &grads) {
-        size_t width = param.width;
-#pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < offsets.size(); ++j) {
-            size_t src_offset = j * width;
-            size_t dst_offset = offsets[j] * width;
-            for (size_t k = 0; k < width; ++k) {
-                size_t cur_src = src_offset + k;
-                size_t cur_dst = dst_offset + k;
-                velocity[cur_dst] =
-                    moment * velocity[cur_dst] - lr * grads[cur_src];
-                param[cur_dst] = param[cur_dst] + velocity[cur_dst];
+    // applies grad to a row, with the row locked
+    void ApplyRow(size_t row, V *param, const V *grad) {
+        uint64_t step = 0, *row_step = &step;
+        char *block = num_states_ ? Block(row, &row_step) : nullptr;
+        Apply(block, 0, width_, param, grad, ++*row_step);
+    }
+
+    // number of rows with states
+    size_t NumStateRows() const {
+        return states_ ? states_->size() : 0;
+    }
+
+protected:
+    /*
+      initial holds the initial value of each state, and the bits of squared
+      are set for second moments
+    */
+    Optimizer(std::vector<float> initial, unsigned squared) :
+        num_states_(initial.size()), initial_(initial), squared_(squared) {
+        CHECK_LE(num_states_, kMaxStates);
+    }
+
+    // updates n values, states[i] are the n values of the i-th state
+    virtual void Update(V *param, const V *grad, float *const *states,
+                        size_t n, uint64_t step) = 0;
+
+private:
+    char *Block(size_t row, uint64_t **step) {
+        return states_->Get(row, step, [this](char *block) {
+            for (size_t i = 0; i < num_states_; i++) {
+                float value = initial_[i];
+                if (!half_) {
+                    float *dst =
+                        reinterpret_cast<float *>(block) + i * width_;
+                    std::fill(dst, dst + width_, value);
+                    continue;
+                }
+                if (squared_ >> i & 1)
+                    value = std::sqrt(value);
+                uint16_t *dst =
+                    reinterpret_cast<uint16_t *>(block) + i * width_;
+                std::fill(dst, dst + width_, codec::FloatToHalf(value));
             }
-        }
+        });
     }
 
-    void ApplyCache(CacheTable<V> &param, SArray<version_t> &updates,
-                    SArray<size_t> &offsets, SArray<V> &grads) {
-        size_t width = param.width;
-        // #pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < offsets.size(); ++j) {
-            param.ver[offsets[j]] += updates[j];
-            size_t src_offset = j * width;
-            size_t dst_offset = offsets[j] * width;
-            for (size_t k = 0; k < width; ++k) {
-                size_t cur_src = src_offset + k;
-                size_t cur_dst = dst_offset + k;
-                velocity[cur_dst] =
-                    moment * velocity[cur_dst] - lr * grads[cur_src];
-                param[cur_dst] = param[cur_dst] + velocity[cur_dst];
+    // updates values [begin, begin + n) of a row with states in block
+    void Apply(char *block, size_t begin, size_t n, V *param, const V *grad,
+               uint64_t step) {
+        float *states[kMaxStates];
+        if (!half_) {
+            for (size_t i = 0; i < num_states_; i++)
+                states[i] =
+                    reinterpret_cast<float *>(block) + i * width_ + begin;
+            Update(param, grad, states, n, step);
+            return;
+        }
+        static thread_local std::vector<float> scratch;
+        scratch.resize(num_states_ * n);
+        uint16_t *halves = reinterpret_cast<uint16_t *>(block);
+        for (size_t i = 0; i < num_states_; i++) {
+            states[i] = scratch.data() + i * n;
+            codec::DecodeHalf(halves + i * width_ + begin, states[i], n);
+            if (squared_ >> i & 1) {
+                float *s = states[i];
+#pragma omp simd
+                for (size_t k = 0; k < n; k++)
+                    s[k] *= s[k];
+            }
+        }
+        Update(param, grad, states, n, step);
+        for (size_t i = 0; i < num_states_; i++) {
+            if (squared_ >> i & 1) {
+                float *s = states[i];
+#pragma omp simd
+                for (size_t k = 0; k < n; k++)
+                    s[k] = std::sqrt(s[k]);
             }
+            codec::EncodeHalf(states[i], halves + i * width_ + begin, n);
         }
     }
 
-    void InitStates(size_t size) {
-        velocity = new V[size]();
+    size_t num_states_;
+    std::vector<float> initial_;
+    unsigned squared_;
+    size_t width_ = 0;
+    bool half_ = false;
+    std::unique_ptr<RowStates> states_;
+    // updates of stateless dense params
+    uint64_t dense_step_ = 0;
+};
+
+template <typename V>
+class SGDOptimizer : public Optimizer<V> {
+public:
+    explicit SGDOptimizer(float learning_rate) :
+        Optimizer<V>({}, 0), lr(learning_rate) {
+    }
+
+protected:
+    void Update(V *param, const V *grad, float *const *states, size_t n,
+                uint64_t step) {
+#pragma omp simd
+        for (size_t k = 0; k < n; ++k)
+            param[k] -= lr * grad[k];
     }
 
 private:
     float lr;
-    float moment;
-    V *velocity;
 };
 
 template <typename V>
-class NesterovMomentumOptimizer : public Optimizer<V> {
+class MomentumOptimizer : public Optimizer<V> {
 public:
-    explicit NesterovMomentumOptimizer(float learning_rate, float momentum) :
-        lr(learning_rate), moment(momentum) {
+    explicit MomentumOptimizer(float learning_rate, float momentum) :
+        Optimizer<V>({0}, 0), lr(learning_rate), moment(momentum) {
     }
 
-    void ApplyDense(Param<V> &param, SArray<V> &grads) {
-#pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < param.size(); ++j) {
-            V temp = -lr * grads[j];
-            velocity[j] = moment * (velocity[j] + temp);
-            param[j] = param[j] + velocity[j] + temp;
+protected:
+    void Update(V *param, const V *grad, float *const *states, size_t n,
+                uint64_t step) {
+        float *velocity = states[0];
+#pragma omp simd
+        for (size_t k = 0; k < n; ++k) {
+            velocity[k] = moment * velocity[k] - lr * grad[k];
+            param[k] += velocity[k];
         }
     }
 
-    void ApplySparse(Param2D<V> &param, SArray<size_t> &offsets,
-                     SArray<V> &grads) {
-        size_t width = param.width;
-#pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < offsets.size(); ++j) {
-            size_t src_offset = j * width;
-            size_t dst_offset = offsets[j] * width;
-            for (size_t k = 0; k < width; ++k) {
-                size_t cur_src = src_offset + k;
-                size_t cur_dst = dst_offset + k;
-                V temp = -lr * grads[cur_src];
-                velocity[cur_dst] = moment * (velocity[cur_dst] + temp);
-                param[cur_dst] = param[cur_dst] + velocity[cur_dst] + temp;
-            }
-        }
-    }
+private:
+    float lr;
+    float moment;
+};
 
-    void ApplyCache(CacheTable<V> &param, SArray<version_t> &updates,
-                    SArray<size_t> &offsets, SArray<V> &grads) {
-        size_t width = param.width;
-        // #pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < offsets.size(); ++j) {
-            param.ver[offsets[j]] += updates[j];
-            size_t src_offset = j * width;
-            size_t dst_offset = offsets[j] * width;
-            for (size_t k = 0; k < width; ++k) {
-                size_t cur_src = src_offset + k;
-                size_t cur_dst = dst_offset + k;
-                V temp = -lr * grads[cur_src];
-                velocity[cur_dst] = moment * (velocity[cur_dst] + temp);
-                param[cur_dst] = param[cur_dst] + velocity[cur_dst] + temp;
-            }
-        }
+template <typename V>
+class NesterovMomentumOptimizer : public Optimizer<V> {
+public:
+    explicit NesterovMomentumOptimizer(float learning_rate, float momentum) :
+        Optimizer<V>({0}, 0), lr(learning_rate), moment(momentum) {
     }
 
-    void InitStates(size_t size) {
-        velocity = new V[size]();
+protected:
+    void Update(V *param, const V *grad, float *const *states, size_t n,
+                uint64_t step) {
+        float *velocity = states[0];
+#pragma omp simd
+        for (size_t k = 0; k < n; ++k) {
+            float temp = -lr * grad[k];
+            velocity[k] = moment * (velocity[k] + temp);
+            param[k] += velocity[k] + temp;
+        }
     }
 
 private:
     float lr;
     float moment;
-    V *velocity;
 };
 
 template <typename V>
@@ -206,69 +303,24 @@ class AdaGradOptimizer : public Optimizer<V> {
 public:
     explicit AdaGradOptimizer(float learning_rate, float initial,
                               float epsilon) :
-        lr(learning_rate),
-        init(initial), eps(epsilon) {
+        Optimizer<V>({initial}, 1),
+        lr(learning_rate), eps(epsilon) {
     }
 
-    void ApplyDense(Param<V> &param, SArray<V> &grads) {
-#pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < param.size(); ++j) {
-            accum[j] = accum[j] + grads[j] * grads[j];
-            param[j] = param[j] - lr * grads[j] / (sqrt(accum[j]) + eps);
+protected:
+    void Update(V *param, const V *grad, float *const *states, size_t n,
+                uint64_t step) {
+        float *accum = states[0];
+#pragma omp simd
+        for (size_t k = 0; k < n; ++k) {
+            accum[k] += grad[k] * grad[k];
+            param[k] -= lr * grad[k] / (std::sqrt(accum[k]) + eps);
         }
     }
 
-    void ApplySparse(Param2D<V> &param, SArray<size_t> &offsets,
-                     SArray<V> &grads) {
-        size_t width = param.width;
-#pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < offsets.size(); ++j) {
-            size_t src_offset = j * width;
-            size_t dst_offset = offsets[j] * width;
-            for (size_t k = 0; k < width; ++k) {
-                size_t cur_src = src_offset + k;
-                size_t cur_dst = dst_offset + k;
-                accum[cur_dst] =
-                    accum[cur_dst] + grads[cur_src] * grads[cur_src];
-                param[cur_dst] =
-                    param[cur_dst]
-                    - lr * grads[cur_src] / (sqrt(accum[cur_dst]) + eps);
-            }
-        }
-    }
-
-    void ApplyCache(CacheTable<V> &param, SArray<version_t> &updates,
-                    SArray<size_t> &offsets, SArray<V> &grads) {
-        size_t width = param.width;
-        // #pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < offsets.size(); ++j) {
-            param.ver[offsets[j]] += updates[j];
-            size_t src_offset = j * width;
-            size_t dst_offset = offsets[j] * width;
-            for (size_t k = 0; k < width; ++k) {
-                size_t cur_src = src_offset + k;
-                size_t cur_dst = dst_offset + k;
-                accum[cur_dst] =
-                    accum[cur_dst] + grads[cur_src] * grads[cur_src];
-                param[cur_dst] =
-                    param[cur_dst]
-                    - lr * grads[cur_src] / (sqrt(accum[cur_dst]) + eps);
-            }
-        }
-    }
-
-    void InitStates(size_t size) {
-        accum = new V[size];
-#pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < size; ++j)
-            accum[j] = init;
-    }
-
 private:
     float lr;
-    float init;
     float eps;
-    V *accum;
 };
 
 template <typename V>
@@ -276,82 +328,31 @@ class AdamOptimizer : public Optimizer<V> {
 public:
     explicit AdamOptimizer(float learning_rate, float beta1, float beta2,
                            float epsilon) :
-        lr(learning_rate),
-        b1(beta1), b2(beta2), eps(epsilon) {
-        b1t = 1.0;
-        b2t = 1.0;
+        Optimizer<V>({0, 0}, 2),
+        lr(learning_rate), b1(beta1), b2(beta2), eps(epsilon) {
     }
 
-    void ApplyDense(Param<V> &param, SArray<V> &grads) {
-        b1t = b1t * b1;
-        b2t = b2t * b2;
-#pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < param.size(); ++j) {
-            marr[j] = b1 * marr[j] + (1 - b1) * grads[j];
-            varr[j] = b2 * varr[j] + (1 - b2) * grads[j] * grads[j];
-            param[j] =
-                param[j]
-                - lr * marr[j] / (1 - b1t) / (sqrt(varr[j] / (1 - b2t)) + eps);
+protected:
+    void Update(V *param, const V *grad, float *const *states, size_t n,
+                uint64_t step) {
+        float *marr = states[0], *varr = states[1];
+        float beta1 = b1, beta2 = b2, epsilon = eps;
+        // bias corrections of the steps of the row
+        float c1 = lr / (1 - std::pow(beta1, static_cast<double>(step)));
+        float c2 = 1 / (1 - std::pow(beta2, static_cast<double>(step)));
+#pragma omp simd
+        for (size_t k = 0; k < n; ++k) {
+            marr[k] = beta1 * marr[k] + (1 - beta1) * grad[k];
+            varr[k] = beta2 * varr[k] + (1 - beta2) * grad[k] * grad[k];
+            param[k] -= c1 * marr[k] / (std::sqrt(varr[k] * c2) + epsilon);
         }
     }
 
-    void ApplySparse(Param2D<V> &param, SArray<size_t> &offsets,
-                     SArray<V> &grads) {
-        size_t width = param.width;
-#pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < offsets.size(); ++j) {
-            size_t src_offset = j * width;
-            size_t dst_offset = offsets[j] * width;
-            for (size_t k = 0; k < width; ++k) {
-                size_t cur_src = src_offset + k;
-                size_t cur_dst = dst_offset + k;
-                marr[cur_dst] = b1 * marr[cur_dst] + (1 - b1) * grads[cur_src];
-                varr[cur_dst] = b2 * varr[cur_dst]
-                                + (1 - b2) * grads[cur_src] * grads[cur_src];
-                param[cur_dst] =
-                    param[cur_dst]
-                    - lr * marr[cur_dst] / (1 - b1t)
-                          / (sqrt(varr[cur_dst] / (1 - b2t)) + eps);
-            }
-        }
-    }
-
-    void ApplyCache(CacheTable<V> &param, SArray<version_t> &updates,
-                    SArray<size_t> &offsets, SArray<V> &grads) {
-        size_t width = param.width;
-        // #pragma omp parallel for num_threads(4)
-        for (size_t j = 0; j < offsets.size(); ++j) {
-            param.ver[offsets[j]] += updates[j];
-            size_t src_offset = j * width;
-            size_t dst_offset = offsets[j] * width;
-            for (size_t k = 0; k < width; ++k) {
-                size_t cur_src = src_offset + k;
-                size_t cur_dst = dst_offset + k;
-                marr[cur_dst] = b1 * marr[cur_dst] + (1 - b1) * grads[cur_src];
-                varr[cur_dst] = b2 * varr[cur_dst]
-                                + (1 - b2) * grads[cur_src] * grads[cur_src];
-                param[cur_dst] =
-                    param[cur_dst]
-                    - lr * marr[cur_dst] / (1 - b1t)
-                          / (sqrt(varr[cur_dst] / (1 - b2t)) + eps);
-            }
-        }
-    }
-
-    void InitStates(size_t size) {
-        marr = new V[size]();
-        varr = new V[size]();
-    }
-
 private:
     float lr;
     float b1;
     float b2;
     float eps;
-    float b1t;
-    float b2t;
-    V *marr;
-    V *varr;
 };
 
 } // namespace ps
@@ -1,8 +1,12 @@
 #pragma once
 
+#include <algorithm>
+#include <memory>
+#include <numeric>
 #include <vector>
 
 #include "common/shared_mutex.h"
+#include "ps/internal/utils.h"
 #include "ps/psf/PSFunc.h"
 #include "ps/server/optimizer.h"
 
@@ -12,52 +16,96 @@ enum ParamType {
     kParam,
     kParam2D,
     kCacheTable,
+    kTieredTable,
 };
 
+template <typename V>
+class Param;
+
 /*
-  Param with a read-write lock
+  Shared lock of a whole param, which also waits for the row updates in
+  progress
+*/
+template <typename V>
+class param_read_lock {
+    const Param<V> *param_;
+
+public:
+    explicit param_read_lock(const Param<V> &param) : param_(&param) {
+        param_->lock_shared();
+    }
+    param_read_lock(param_read_lock &&other) noexcept : param_(other.param_) {
+        other.param_ = nullptr;
+    }
+    param_read_lock(const param_read_lock &) = delete;
+    ~param_read_lock() {
+        if (param_)
+            param_->unlock_shared();
+    }
+};
+
+/*
+  Param with a read-write lock. Rows of a Param2D are further split into
+  contiguous stripes with their own locks, so that row updates are only
+  serialized within a stripe. Row operations hold the param lock in shared
+  mode and the stripe locks of their rows.
 */
 template <typename V>
 class Param {
 public:
-    explicit Param(size_t size, OptType otype, SArray<float> lrs) {
-        vec_ = new V[size]();
+    /*
+      values of params not in memory are kept by subclasses. Pushed values
+      are added to the param if otype is None, otherwise they are gradients
+      applied by the optimizer of otype on arrival.
+    */
+    explicit Param(size_t size, OptType otype, SArray<float> lrs,
+                   bool in_memory = true) {
+        vec_ = in_memory ? new V[size]() : nullptr;
         size_ = size;
         switch (otype) {
         case SGD:
-            opt = new SGDOptimizer<V>(lrs[0]);
+            opt.reset(new SGDOptimizer<V>(lrs[0]));
             break;
         case Momentum:
-            opt = new MomentumOptimizer<V>(lrs[0], lrs[1]);
+            opt.reset(new MomentumOptimizer<V>(lrs[0], lrs[1]));
             break;
         case NesterovMomentum:
-            opt = new NesterovMomentumOptimizer<V>(lrs[0], lrs[1]);
+            opt.reset(new NesterovMomentumOptimizer<V>(lrs[0], lrs[1]));
             break;
         case AdaGrad:
-            opt = new AdaGradOptimizer<V>(lrs[0], lrs[1], lrs[2]);
+            opt.reset(new AdaGradOptimizer<V>(lrs[0], lrs[1], lrs[2]));
             break;
         case Adam:
-            opt = new AdamOptimizer<V>(lrs[0], lrs[1], lrs[2], lrs[3]);
+            opt.reset(new AdamOptimizer<V>(lrs[0], lrs[1], lrs[2], lrs[3]));
             break;
         case None:
-            opt = nullptr;
             return;
         }
-        opt->InitStates(size);
+        opt->InitStates(1, size);
     }
 
-    ~Param() {
+    virtual ~Param() {
         delete[] vec_;
     }
 
     Param(const Param &) = delete;
 
-    s_lock<4> read_guard() const noexcept {
-        return s_lock<4>(mtx);
+    param_read_lock<V> read_guard() const noexcept {
+        return param_read_lock<V>(*this);
     }
     x_lock<4> write_guard() noexcept {
         return x_lock<4>(mtx);
     }
+    // held by row operations, which lock stripes of their rows in addition
+    s_lock<4> row_guard() const noexcept {
+        return s_lock<4>(mtx);
+    }
+    s_lock<1> stripe_read_guard(size_t stripe) const noexcept {
+        return s_lock<1>(stripe_mtx[stripe]);
+    }
+    x_lock<1> stripe_write_guard(size_t stripe) noexcept {
+        return x_lock<1>(stripe_mtx[stripe]);
+    }
 
     inline const V *data() const {
         return vec_;
@@ -83,9 +131,31 @@ public:
     virtual ParamType type() {
         return kParam;
     }
-    void updateDense(SArray<V> &grads) {
-        auto write_lock = write_guard();
-        opt->ApplyDense(*this, grads);
+    inline Optimizer<V> *optimizer() {
+        return opt.get();
+    }
+    // Pushes vals to the whole param, with the write lock held.
+    virtual void PushDense(const SArray<V> &vals) {
+        if (opt) {
+            opt->ApplyDense(data(), vals.data());
+            return;
+        }
+        V *dst = data();
+        const V *src = vals.data();
+#pragma omp parallel for simd num_threads(GetServerNumThreads())
+        for (size_t j = 0; j < size(); j++)
+            dst[j] += src[j];
+    }
+
+    void lock_shared() const {
+        mtx.lock_shared();
+        for (size_t i = 0; i < num_stripes; i++)
+            stripe_mtx[i].lock_shared();
+    }
+    void unlock_shared() const {
+        for (size_t i = num_stripes; i > 0; i--)
+            stripe_mtx[i - 1].unlock_shared();
+        mtx.unlock_shared();
     }
 
 private:
@@ -94,43 +164,187 @@ private:
     size_t size_;
 
 protected:
-    Optimizer<V> *opt;
+    std::unique_ptr<Optimizer<V>> opt;
+    size_t num_stripes = 0;
+    std::unique_ptr<shared_mutex<1>[]> stripe_mtx;
 };
 
 template <typename V>
 class Param2D : public Param<V> {
 public:
-    explicit Param2D(size_t len, size_t wid, OptType otype, SArray<float> lrs) :
-        Param<V>(len * wid, otype, lrs) {
+    explicit Param2D(size_t len, size_t wid, OptType otype, SArray<float> lrs,
+                     bool in_memory = true) :
+        Param<V>(len * wid, otype, lrs, in_memory) {
         length = len;
         width = wid;
+        // PS_SERVER_NUM_STRIPES stripes, 256 by default
+        size_t max_stripes =
+            std::max(GetEnv("PS_SERVER_NUM_STRIPES", 256), 1);
+        rows_per_stripe = std::max<size_t>(
+            (length + max_stripes - 1) / max_stripes, 1);
+        this->num_stripes = (length + rows_per_stripe - 1) / rows_per_stripe;
+        this->stripe_mtx.reset(new shared_mutex<1>[this->num_stripes]);
+        if (this->opt)
+            this->opt->InitStates(length, width);
     }
-    void updateSparse(SArray<size_t> &offsets, SArray<V> &grads) {
-        auto write_lock = this->write_guard();
-        this->opt->ApplySparse(*this, offsets, grads);
+    inline size_t stripe(size_t row) const {
+        return row / rows_per_stripe;
     }
+
+    /*
+      Calls fn(row, first, last) once for each distinct row of offsets, where
+      [first, last) are the positions of the row in offsets in ascending
+      order, so that duplicate rows can be merged before they are applied.
+      Stripes are visited in parallel with their locks held exclusively.
+    */
+    template <typename F>
+    void UpdateRows(const SArray<size_t> &offsets, F &&fn) {
+        // bucket positions by stripe, then sort each bucket by row
+        size_t num_offsets = offsets.size();
+        std::vector<size_t> bounds(this->num_stripes + 1, 0);
+        for (size_t i = 0; i < num_offsets; i++) {
+            CHECK_LT(offsets[i], length) << "Row out of range in Param2D";
+            bounds[stripe(offsets[i]) + 1]++;
+        }
+        std::partial_sum(bounds.begin(), bounds.end(), bounds.begin());
+        std::vector<size_t> order(num_offsets);
+        {
+            std::vector<size_t> cursor(bounds.begin(), bounds.end() - 1);
+            for (size_t i = 0; i < num_offsets; i++)
+                order[cursor[stripe(offsets[i])]++] = i;
+        }
+        std::vector<size_t> stripes;
+        for (size_t i = 0; i < this->num_stripes; i++)
+            if (bounds[i + 1] > bounds[i])
+                stripes.push_back(i);
+        int num_groups = static_cast<int>(stripes.size());
+        auto row_lock = this->row_guard();
+#pragma omp parallel for num_threads(GetServerNumThreads()) \
+    schedule(dynamic) if (num_groups > 1)
+        for (int g = 0; g < num_groups; g++) {
+            size_t begin = bounds[stripes[g]], end = bounds[stripes[g] + 1];
+            std::sort(order.begin() + begin, order.begin() + end,
+                      [&](size_t lhs, size_t rhs) {
+                          return offsets[lhs] < offsets[rhs]
+                                 || (offsets[lhs] == offsets[rhs]
+                                     && lhs < rhs);
+                      });
+            auto stripe_lock = this->stripe_write_guard(stripes[g]);
+            while (begin < end) {
+                size_t row = offsets[order[begin]], last = begin + 1;
+                while (last < end && offsets[order[last]] == row)
+                    last++;
+                fn(row, order.data() + begin, order.data() + last);
+                begin = last;
+            }
+        }
+    }
+
+    /*
+      Calls fn(i, row) for each position i of offsets, with the stripe of
+      the row locked in shared mode.
+    */
+    template <typename F>
+    void ReadRows(const SArray<size_t> &offsets, F &&fn) const {
+        for (size_t i = 0; i < offsets.size(); i++)
+            CHECK_LT(offsets[i], length) << "Row out of range in Param2D";
+        auto row_lock = this->row_guard();
+#pragma omp parallel for num_threads(GetServerNumThreads())
+        for (size_t i = 0; i < offsets.size(); i++) {
+            size_t row = offsets[i];
+            auto stripe_lock = this->stripe_read_guard(stripe(row));
+            fn(i, row);
+        }
+    }
+
+    // Pushes vals to the rows, rows pushed more than once are merged in the
+    // order of the request instead of racing across threads.
+    virtual void PushRows(const SArray<size_t> &offsets,
+                          const SArray<V> &vals) {
+        UpdateRows(
+            offsets, [&](size_t row, const size_t *first, const size_t *last) {
+                PushRow(row, this->data() + row * width, vals, first, last);
+            });
+    }
+
+    // Pushes vals to every row, with the write lock held. The optimizer
+    // keeps states per row, so it is applied row by row.
+    void PushDense(const SArray<V> &vals) {
+        if (!this->opt) {
+            Param<V>::PushDense(vals);
+            return;
+        }
+        int num_rows = static_cast<int>(length);
+#pragma omp parallel for num_threads(GetServerNumThreads())
+        for (int i = 0; i < num_rows; i++)
+            this->opt->ApplyRow(i, this->data() + i * width,
+                                vals.data() + i * width);
+    }
+
+    virtual void PullRows(const SArray<size_t> &offsets,
+                          SArray<V> &pull_vals) {
+        ReadRows(offsets, [&](size_t j, size_t row) {
+            const V *src = this->data() + row * width;
+            std::copy(src, src + width, pull_vals.data() + j * width);
+        });
+    }
+
+    // Hints that the rows will be accessed soon.
+    virtual void Prefetch(const SArray<size_t> &offsets) {
+    }
+
     ParamType type() {
         return kParam2D;
     }
-    size_t length, width;
+    size_t length, width, rows_per_stripe;
+
+protected:
+    /*
+      Pushes the vals at positions [first, last) to dst, the values of the
+      row, with the row locked. Without an optimizer they are added to the
+      row, otherwise their sum is applied as the gradient of the row.
+    */
+    void PushRow(size_t row, V *dst, const SArray<V> &vals,
+                 const size_t *first, const size_t *last) {
+        const V *src = vals.data() + *first * width;
+        if (!this->opt) {
+            for (auto it = first; it != last; ++it) {
+                src = vals.data() + *it * width;
+#pragma omp simd
+                for (size_t k = 0; k < width; ++k)
+                    dst[k] += src[k];
+            }
+            return;
+        }
+        if (last - first > 1) {
+            static thread_local std::vector<V> merged;
+            merged.assign(src, src + width);
+            V *sum = merged.data();
+            for (auto it = first + 1; it != last; ++it) {
+                src = vals.data() + *it * width;
+#pragma omp simd
+                for (size_t k = 0; k < width; ++k)
+                    sum[k] += src[k];
+            }
+            src = sum;
+        }
+        this->opt->ApplyRow(row, dst, src);
+    }
 };
 
+// Caches of workers apply their updates locally and push them to the table,
+// so pushes are always added.
 template <typename V>
 class CacheTable : public Param2D<V> {
 public:
     explicit CacheTable(size_t len, size_t wid, OptType otype,
                         SArray<float> lrs) :
-        Param2D<V>(len, wid, otype, lrs) {
+        Param2D<V>(len, wid, None, lrs) {
         ver = new version_t[len]();
     }
     ~CacheTable() {
         delete[] ver;
     }
-    void updateCache(SArray<version_t> &updates, SArray<size_t> &offsets,
-                     SArray<V> &grads) {
-        auto write_lock = this->write_guard();
-        this->opt->ApplyCache(*this, updates, offsets, grads);
-    }
     ParamType type() {
         return kCacheTable;
     }
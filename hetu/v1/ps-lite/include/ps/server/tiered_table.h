@@ -0,0 +1,365 @@
+#pragma once
+
+#include "common/thread_pool.h"
+#include "ps/psf/misc.h"
+#include "ps/server/param.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <fcntl.h>
+#include <fstream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace ps {
+
+/*
+  A Param2D larger than memory. Hot rows are cached in memory with CLOCK
+  eviction, one cache shard per stripe, and evicted rows are appended to a
+  row log on disk. Rows never pushed are generated from the initializer on
+  first access. Overwritten records are reclaimed by a background thread,
+  which moves live rows into the other log file stripe by stripe.
+
+  Configured by the environment variables
+  - PS_SERVER_TIERED_DIR: directory of the row logs, /tmp by default
+  - PS_SERVER_CACHE_MB: memory of the cache of each table, 1024 by default
+  - PS_SERVER_PREFETCH_THREADS: threads loading rows of queued requests, 1
+    by default
+  - PS_SERVER_COMPACT_MB: size of overwritten records to start compaction
+    at, 64 by default, as long as they take half of the log
+*/
+template <typename V>
+class TieredTable : public Param2D<V> {
+public:
+    explicit TieredTable(size_t len, size_t wid, OptType otype,
+                         SArray<float> lrs, InitType init_type, double init_a,
+                         double init_b, unsigned long long seed) :
+        Param2D<V>(len, wid, otype, lrs, false),
+        init_type_(init_type), init_a_(init_a), init_b_(init_b), seed_(seed),
+        row_bytes_(wid * sizeof(V)), loc_(len, kNotStored) {
+        // optimizer states would take as much memory as the table
+        CHECK(!this->opt || otype == SGD)
+            << "Tiered tables only support stateless optimizers";
+        std::string dir = GetEnv<std::string>("PS_SERVER_TIERED_DIR", "/tmp");
+        static std::atomic<int> num_tables{0};
+        int id = num_tables++;
+        for (int i = 0; i < 2; i++) {
+            std::string path = dir + "/ps_tiered_" + std::to_string(getpid())
+                               + "_" + std::to_string(id) + "_"
+                               + std::to_string(i) + ".log";
+            fd_[i] = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0600);
+            CHECK_GE(fd_[i], 0) << "Failed to create row log " << path;
+            // removed once closed
+            unlink(path.c_str());
+        }
+        size_t cache_rows = static_cast<size_t>(
+                                std::max(GetEnv("PS_SERVER_CACHE_MB", 1024), 1))
+                            * (1 << 20) / row_bytes_;
+        shard_capacity_ =
+            std::max<size_t>(cache_rows / this->num_stripes, 1);
+        min_compact_bytes_ =
+            static_cast<size_t>(std::max(GetEnv("PS_SERVER_COMPACT_MB", 64), 1))
+            << 20;
+        shards_.reset(new Shard[this->num_stripes]);
+        prefetch_pool_.reset(new ThreadPool(
+            std::max(GetEnv("PS_SERVER_PREFETCH_THREADS", 1), 1)));
+        compactor_ = std::thread(&TieredTable::Compacting, this);
+    }
+
+    ~TieredTable() {
+        // pending prefetches access the table
+        prefetch_pool_.reset();
+        {
+            std::lock_guard<std::mutex> lock(compact_mtx_);
+            stop_ = true;
+        }
+        compact_cond_.notify_all();
+        compactor_.join();
+        close(fd_[0]);
+        close(fd_[1]);
+    }
+
+    ParamType type() {
+        return kTieredTable;
+    }
+
+    void PushRows(const SArray<size_t> &offsets, const SArray<V> &vals) {
+        AccessRows(offsets,
+                   [&](size_t row, V *dst, const size_t *first,
+                       const size_t *last) {
+                       this->PushRow(row, dst, vals, first, last);
+                   },
+                   true);
+    }
+
+    void PullRows(const SArray<size_t> &offsets, SArray<V> &pull_vals) {
+        AccessRows(offsets,
+                   [&](size_t row, V *src, const size_t *first,
+                       const size_t *last) {
+                       for (auto it = first; it != last; ++it)
+                           std::copy(src, src + this->width,
+                                     pull_vals.data() + *it * this->width);
+                   },
+                   false);
+    }
+
+    void Prefetch(const SArray<size_t> &offsets) {
+        // drop hints rather than queueing up behind a slow disk
+        if (num_prefetching_ >= kMaxPrefetching)
+            return;
+        num_prefetching_++;
+        prefetch_pool_->Enqueue([this, offsets]() {
+            AccessRows(
+                offsets,
+                [](size_t, V *, const size_t *, const size_t *) {}, false);
+            num_prefetching_--;
+        });
+    }
+
+    // Rows are saved and loaded in the same format as in-memory params.
+    void Save(const std::string &path) {
+        std::ofstream fout(path, std::ios::binary);
+        ForEachChunk([&](const SArray<size_t> &offsets, SArray<V> &vals) {
+            PullRows(offsets, vals);
+            fout.write(reinterpret_cast<const char *>(vals.data()),
+                       vals.size() * sizeof(V));
+        });
+    }
+
+    void Load(const std::string &path) {
+        std::ifstream fin(path, std::ios::binary);
+        ForEachChunk([&](const SArray<size_t> &offsets, SArray<V> &vals) {
+            fin.read(reinterpret_cast<char *>(vals.data()),
+                     vals.size() * sizeof(V));
+            AccessRows(offsets,
+                       [&](size_t row, V *dst, const size_t *first,
+                           const size_t *last) {
+                           std::copy(vals.data() + *first * this->width,
+                                     vals.data() + (*first + 1) * this->width,
+                                     dst);
+                       },
+                       true);
+        });
+    }
+
+    size_t num_cached_rows() const {
+        size_t ret = 0;
+        for (size_t i = 0; i < this->num_stripes; i++)
+            ret += shards_[i].slots.size();
+        return ret;
+    }
+
+    size_t num_log_bytes() const {
+        return tail_[0] + tail_[1];
+    }
+
+private:
+    static constexpr uint64_t kNotStored = ~uint64_t(0);
+    static constexpr size_t kMaxPrefetching = 64;
+
+    // locations in the row logs, with the log index in the highest bit
+    static inline uint64_t Encode(int log, uint64_t offset) {
+        return (uint64_t(log) << 63) | offset;
+    }
+    static inline int LogOf(uint64_t loc) {
+        return static_cast<int>(loc >> 63);
+    }
+    static inline uint64_t OffsetOf(uint64_t loc) {
+        return loc & ~(uint64_t(1) << 63);
+    }
+
+    struct Shard {
+        std::unordered_map<size_t, size_t> slots; // row -> slot
+        std::vector<size_t> rows;                 // slot -> row
+        std::vector<uint8_t> referenced, dirty;
+        std::vector<V> values;
+        size_t hand = 0;
+    };
+
+    // Calls fn(row, values, first, last) for each distinct row, with the row
+    // cached and its stripe locked.
+    template <typename F>
+    void AccessRows(const SArray<size_t> &offsets, F &&fn, bool write) {
+        this->UpdateRows(
+            offsets, [&](size_t row, const size_t *first, const size_t *last) {
+                Shard &shard = shards_[this->stripe(row)];
+                size_t slot = Cache(shard, row);
+                shard.dirty[slot] |= write;
+                fn(row, shard.values.data() + slot * this->width, first,
+                   last);
+            });
+    }
+
+    // Returns the slot of a row, loading it and evicting another row if
+    // needed. The stripe of the row must be locked exclusively.
+    size_t Cache(Shard &shard, size_t row) {
+        auto iter = shard.slots.find(row);
+        if (iter != shard.slots.end()) {
+            shard.referenced[iter->second] = 1;
+            return iter->second;
+        }
+        size_t slot;
+        if (shard.rows.size() < shard_capacity_) {
+            slot = shard.rows.size();
+            shard.rows.push_back(row);
+            shard.referenced.push_back(0);
+            shard.dirty.push_back(0);
+            shard.values.resize(shard.values.size() + this->width);
+        } else {
+            while (shard.referenced[shard.hand]) {
+                shard.referenced[shard.hand] = 0;
+                shard.hand = (shard.hand + 1) % shard_capacity_;
+            }
+            slot = shard.hand;
+            shard.hand = (shard.hand + 1) % shard_capacity_;
+            if (shard.dirty[slot])
+                Append(shard.rows[slot],
+                       shard.values.data() + slot * this->width);
+            shard.slots.erase(shard.rows[slot]);
+            shard.rows[slot] = row;
+        }
+        V *values = shard.values.data() + slot * this->width;
+        uint64_t loc = loc_[row];
+        if (loc == kNotStored) {
+            Initialize(row, values);
+        } else {
+            ssize_t ret = pread(fd_[LogOf(loc)], values, row_bytes_,
+                                OffsetOf(loc));
+            CHECK_EQ(ret, static_cast<ssize_t>(row_bytes_))
+                << "Failed to read row " << row << " from the row log";
+        }
+        shard.slots[row] = slot;
+        shard.referenced[slot] = 1;
+        shard.dirty[slot] = 0;
+        return slot;
+    }
+
+    // Appends a row to the active log. The stripe of the row must be locked.
+    void Append(size_t row, const V *values) {
+        int log = active_;
+        uint64_t offset = tail_[log].fetch_add(row_bytes_);
+        ssize_t ret = pwrite(fd_[log], values, row_bytes_, offset);
+        CHECK_EQ(ret, static_cast<ssize_t>(row_bytes_))
+            << "Failed to write row " << row << " to the row log";
+        if (loc_[row] != kNotStored)
+            garbage_[LogOf(loc_[row])] += row_bytes_;
+        loc_[row] = Encode(log, offset);
+        if (NeedCompact(log))
+            compact_cond_.notify_one();
+    }
+
+    bool NeedCompact(int log) const {
+        return garbage_[log] >= min_compact_bytes_
+               && garbage_[log] * 2 >= tail_[log];
+    }
+
+    void Initialize(size_t row, V *values) {
+        if (init_type_ == InitType::Constant) {
+            std::fill(values, values + this->width, static_cast<V>(init_a_));
+            return;
+        }
+        std::default_random_engine generator(seed_ + row);
+        if (init_type_ == InitType::Uniform) {
+            std::uniform_real_distribution<V> dist(init_a_, init_b_);
+            for (size_t k = 0; k < this->width; k++)
+                values[k] = dist(generator);
+        } else if (init_type_ == InitType::Normal) {
+            std::normal_distribution<V> dist(init_a_, init_b_);
+            for (size_t k = 0; k < this->width; k++)
+                values[k] = dist(generator);
+        } else if (init_type_ == InitType::TruncatedNormal) {
+            std::normal_distribution<V> dist(init_a_, init_b_);
+            V upper_limit = init_a_ + 2 * init_b_;
+            V lower_limit = init_a_ - 2 * init_b_;
+            for (size_t k = 0; k < this->width; k++) {
+                V temp = dist(generator);
+                while (temp > upper_limit || temp < lower_limit)
+                    temp = dist(generator);
+                values[k] = temp;
+            }
+        }
+    }
+
+    // Moves live rows of the active log into the other one, so that the
+    // active log can be truncated.
+    void Compacting() {
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(compact_mtx_);
+                compact_cond_.wait(
+                    lock, [this] { return stop_ || NeedCompact(active_); });
+                if (stop_)
+                    return;
+            }
+            int old_log = active_;
+            active_ = 1 - old_log;
+            std::vector<V> values(this->width);
+            for (size_t s = 0; s < this->num_stripes; s++) {
+                auto row_lock = this->row_guard();
+                auto stripe_lock = this->stripe_write_guard(s);
+                size_t end =
+                    std::min((s + 1) * this->rows_per_stripe, this->length);
+                for (size_t row = s * this->rows_per_stripe; row < end;
+                     row++) {
+                    uint64_t loc = loc_[row];
+                    if (loc == kNotStored || LogOf(loc) != old_log)
+                        continue;
+                    ssize_t ret = pread(fd_[old_log], values.data(),
+                                        row_bytes_, OffsetOf(loc));
+                    CHECK_EQ(ret, static_cast<ssize_t>(row_bytes_))
+                        << "Failed to read row " << row << " in compaction";
+                    Append(row, values.data());
+                }
+            }
+            CHECK_EQ(ftruncate(fd_[old_log], 0), 0)
+                << "Failed to truncate the row log";
+            tail_[old_log] = 0;
+            garbage_[old_log] = 0;
+        }
+    }
+
+    // Calls fn(offsets, vals) on chunks of consecutive rows.
+    template <typename F>
+    void ForEachChunk(F &&fn) {
+        size_t chunk_rows = std::max<size_t>((16 << 20) / row_bytes_, 1);
+        for (size_t begin = 0; begin < this->length; begin += chunk_rows) {
+            size_t num_rows = std::min(chunk_rows, this->length - begin);
+            SArray<size_t> offsets(num_rows);
+            for (size_t i = 0; i < num_rows; i++)
+                offsets[i] = begin + i;
+            SArray<V> vals(num_rows * this->width);
+            fn(offsets, vals);
+        }
+    }
+
+    InitType init_type_;
+    double init_a_, init_b_;
+    unsigned long long seed_;
+    size_t row_bytes_;
+    // locations of rows, guarded by the locks of stripes
+    std::vector<uint64_t> loc_;
+    size_t shard_capacity_;
+    size_t min_compact_bytes_;
+    std::unique_ptr<Shard[]> shards_;
+    int fd_[2];
+    std::atomic<int> active_{0};
+    std::atomic<uint64_t> tail_[2] = {{0}, {0}};
+    std::atomic<uint64_t> garbage_[2] = {{0}, {0}};
+    std::mutex compact_mtx_;
+    std::condition_variable compact_cond_;
+    bool stop_ = false;
+    std::thread compactor_;
+    std::atomic<size_t> num_prefetching_{0};
+    std::unique_ptr<ThreadPool> prefetch_pool_;
+};
+
+template <typename V>
+constexpr uint64_t TieredTable<V>::kNotStored;
+template <typename V>
+constexpr size_t TieredTable<V>::kMaxPrefetching;
+
+} // namespace ps
@@ -30,6 +30,9 @@ struct TensorMeta {
     /* [node_name --> timestamp to be waited] */
     std::vector<int> ts;
     std::vector<size_t> part;
+    /* codec of requests, and the error feedback of top-k */
+    Codec codec;
+    std::vector<float> residual;
 };
 
 struct SparseInfos {
@@ -64,6 +67,14 @@ private:
         _par = _kvworker.par;
     }
 
+    /* the codec of a partition of a dense tensor at the offset */
+    Codec partCodec(TensorMeta &meta, size_t offset) {
+        Codec codec = meta.codec;
+        if (!meta.residual.empty())
+            codec.residual = meta.residual.data() + offset;
+        return codec;
+    }
+
 public:
     static PSAgent *Get() {
         static PSAgent e;
@@ -121,6 +132,28 @@ public:
         _id2meta[name] = tm;
     }
 
+    /**
+     * \brief set the codec of requests of a tensor, see \ref Codec.
+     *        int8 shares a scale in each row of sparse tensors, and in
+     *        each block of 256 elements of dense tensors. top-k only
+     *        applies to dense pushes. responses are encoded with the
+     *        value codec response, kNoCodec, kFp16 or kBf16, and with
+     *        varint offsets if flags has them.
+     */
+    void setCodec(const int name, int flags, float topk_ratio = 0,
+                  int response = kNoCodec) {
+        CHECK(response == kNoCodec || response == kFp16 || response == kBf16)
+            << "Unsupported value codec of responses " << response;
+        TensorMeta &meta = _id2meta[name];
+        meta.codec.flags = flags;
+        meta.codec.block = meta.ptype == kParam ? 256 : meta.width;
+        meta.codec.topk_ratio = topk_ratio;
+        meta.codec.response = response;
+        meta.residual.clear();
+        if ((flags & kTopK) && meta.ptype == kParam)
+            meta.residual.assign(meta.length, 0);
+    }
+
     void vecPushSparse(const int name, float *dup_index, float *vals,
                        const size_t dup_index_size, int priority = 0) {
         TensorMeta &meta = _id2meta[name];
@@ -169,7 +202,8 @@ public:
                     SArray<size_t>(cp_offset + st_index, cur_index - st_index),
                     SArray<float>(cp_val + st_offset, cur_offset - st_offset));
                 auto cb = getCallBack<SparsePush>();
-                ts[i].second = _kvworker.Request<SparsePush>(request, cb);
+                ts[i].second =
+                    _kvworker.Request<SparsePush>(request, cb, meta.codec);
             } else {
                 ts[i].first = false;
             }
@@ -223,7 +257,8 @@ public:
                         std::vector<std::pair<size_t, std::vector<size_t>>>(
                             st_iter, iter)),
                     cur_len, width);
-                ts[i].second = _kvworker.Request<SparsePull>(request, cb);
+                ts[i].second =
+                    _kvworker.Request<SparsePull>(request, cb, meta.codec);
             } else {
                 ts[i].first = false;
             }
@@ -286,7 +321,8 @@ public:
                 local_length);
             auto cb = getCallBack<SDPushPull>(
                 SArray<float>(out_vals + pull_offset, local_length));
-            meta.ts.push_back(_kvworker.Request<SDPushPull>(request, cb));
+            meta.ts.push_back(
+                _kvworker.Request<SDPushPull>(request, cb, meta.codec));
             cur_len += lens[i];
             pull_offset += local_length;
         }
@@ -369,7 +405,8 @@ public:
                         std::vector<std::pair<size_t, std::vector<size_t>>>(
                             st_iter, out_iter)),
                     cur_len, width);
-                ts[i].second = _kvworker.Request<SSPushPull>(request, cb);
+                ts[i].second =
+                    _kvworker.Request<SSPushPull>(request, cb, meta.codec);
             } else {
                 ts[i].first = false;
             }
@@ -396,7 +433,8 @@ public:
             PSFData<DensePush>::Request request(
                 meta.keys[i], meta.part[i],
                 SArray<float>(vals + cur_len, meta.part[i]));
-            meta.ts.push_back(_kvworker.Request<DensePush>(request, cb));
+            meta.ts.push_back(_kvworker.Request<DensePush>(
+                request, cb, partCodec(meta, cur_len)));
             cur_len += meta.part[i];
         }
     }
@@ -409,7 +447,8 @@ public:
             PSFData<DensePull>::Request request(meta.keys[i], cur_length);
             auto cb = getCallBack<DensePull>(
                 SArray<float>(vals + cur_offset, cur_length));
-            meta.ts.push_back(_kvworker.Request<DensePull>(request, cb));
+            meta.ts.push_back(
+                _kvworker.Request<DensePull>(request, cb, meta.codec));
             cur_offset += cur_length;
         }
     }
@@ -425,21 +464,22 @@ public:
                 SArray<float>(in_vals + cur_len, meta.part[i]));
             auto cb = getCallBack<DDPushPull>(
                 SArray<float>(out_vals + cur_len, meta.part[i]));
-            meta.ts.push_back(_kvworker.Request<DDPushPull>(request, cb));
+            meta.ts.push_back(_kvworker.Request<DDPushPull>(
+                request, cb, partCodec(meta, cur_len)));
             cur_len += meta.part[i];
         }
     }
 
     void ParameterInit(const int name, InitType init_type, double init_a,
                        double init_b, unsigned long long seed, OptType otype,
-                       SArray<float> lrs) {
+                       SArray<float> lrs, bool server_opt) {
         TensorMeta &meta = _id2meta[name];
         /* send pull request to each partition */
         auto cb = getCallBack<ParamInit>();
         for (size_t i = 0; i < meta.keys.size(); i++) {
             PSFData<ParamInit>::Request request(
                 meta.keys[i], meta.ptype, meta.part[i], meta.width, init_type,
-                init_a, init_b, seed, otype, lrs);
+                init_a, init_b, seed, otype, lrs, server_opt);
             meta.ts.push_back(_kvworker.Request<ParamInit>(request, cb));
         }
     }
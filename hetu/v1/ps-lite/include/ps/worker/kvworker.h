@@ -73,9 +73,11 @@ public:
      *
      * \param request create request by PSFData<PsfType>::Request
      * \param cb the callback returned by getCallback<PSfType>(args...)
+     * \param codec the codec of the request and its response
      */
     template <PsfType ftype, typename Tuple, typename CallBack>
-    int Request(const Tuple &request, const CallBack &cb) {
+    int Request(const Tuple &request, const CallBack &cb,
+                const Codec &codec = Codec()) {
         int timestamp = obj_->NewRequest(kServerGroup);
         CallbackStore<ftype>::Get()->store(timestamp, cb);
         // Find the server
@@ -83,7 +85,7 @@ public:
         int target_server_id = par->queryServer(key);
         // Create message
         Message msg;
-        tupleEncode(request, msg.data);
+        tupleEncode(request, msg.data, codec);
         if (logOut.is_open()) {
             for (auto x : msg.data) {
                 loads[ftype].first += x.size();
@@ -94,6 +96,7 @@ public:
         msg.meta.timestamp = timestamp;
         msg.meta.recver = Postoffice::Get()->ServerRankToID(target_server_id);
         msg.meta.psftype = ftype;
+        msg.meta.codec = codec.meta();
         msg.meta.request = true;
         Postoffice::Get()->van()->Send(msg);
         return timestamp;
@@ -108,7 +111,7 @@ private:
                 loads[ftype].second += x.size();
             }
         }
-        tupleDecode(response, msg.data);
+        tupleDecode(response, msg.data, Codec(msg.meta.codec));
         int timestamp = msg.meta.timestamp;
         CallbackStore<ftype>::Get()->run(timestamp, response);
     }
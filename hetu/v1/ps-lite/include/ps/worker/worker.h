@@ -23,7 +23,7 @@ public:
     void parameter_init(int node_name, ParamType ptype, size_t len,
                         size_t width, InitType init_type, double init_a,
                         double init_b, unsigned long long seed, OptType otype,
-                        SArray<float> lrs);
+                        SArray<float> lrs, bool server_opt);
     void parameter_save(int node_name, char *address);
     void parameter_load(int node_name, char *address);
     // for data push&pull
@@ -61,6 +61,9 @@ public:
                      const DLArray *outind, DLArray *out_arr, size_t index_size,
                      DLEvent *evt);
     void wait(int node_name);
+    // set the codec of requests, see ps::Codec
+    void set_codec(int node_name, int flags, float topk_ratio,
+                   int response_flags);
     void clear(int node_name);
     void clear_on_server(int node_name);
 
@@ -3,19 +3,22 @@
  */
 #include "ps/internal/customer.h"
 #include "ps/internal/postoffice.h"
+#include "ps/internal/utils.h"
 namespace ps {
 
 const int Node::kEmpty = std::numeric_limits<int>::max();
 const int Meta::kEmpty = std::numeric_limits<int>::max();
 
 Customer::Customer(int app_id, int customer_id,
-                   const Customer::RecvHandle &recv_handle) :
+                   const Customer::RecvHandle &recv_handle,
+                   const Customer::RecvHandle &accept_handle) :
     app_id_(app_id),
-    customer_id_(customer_id), recv_handle_(recv_handle) {
+    customer_id_(customer_id), recv_handle_(recv_handle),
+    accept_handle_(accept_handle) {
     cur_timestamp = 0;
     Postoffice::Get()->AddCustomer(this);
-    // for debug set num_threads = 5;
-    int num_threads = 5;
+    // requests are served concurrently by PS_NUM_RECV_THREADS threads
+    int num_threads = std::max(GetEnv("PS_NUM_RECV_THREADS", 5), 1);
     for (int i = 0; i < num_threads; i++) {
         recv_threads_.emplace_back(new std::thread(&Customer::Receiving, this));
     }
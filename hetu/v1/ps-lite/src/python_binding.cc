@@ -91,13 +91,32 @@ void BarrierWorker() {
     Postoffice::Get()->Barrier(0, kWorkerGroup);
 }
 
+/**
+ *   args:
+ *       server_opt, whether servers apply pushes as gradients with the
+ *                   optimizer otype, instead of adding them
+ */
 void InitTensor(int node_name, int ptype, int len, int width, int init_type,
                 double init_a, double init_b, unsigned long long seed,
-                int otype, float lrs[], int nlr) {
+                int otype, float lrs[], int nlr, int server_opt) {
     worker.parameter_init(
         node_name, static_cast<ParamType>(ptype), static_cast<size_t>(len),
         static_cast<size_t>(width), static_cast<InitType>(init_type), init_a,
-        init_b, seed, static_cast<OptType>(otype), SArray<float>(lrs, nlr));
+        init_b, seed, static_cast<OptType>(otype), SArray<float>(lrs, nlr),
+        server_opt != 0);
+}
+
+/**
+ *   args:
+ *       flags, a value codec (1 fp16, 2 bf16, 3 int8) or-ed with
+ *              16 for varint offsets and 32 for top-k of dense pushes
+ *       topk_ratio, fraction of elements sent by top-k
+ *       response_flags, the value codec of responses, 0 (lossless) or
+ *              1 fp16 or 2 bf16
+ */
+void SetCodec(int node_name, int flags, float topk_ratio,
+              int response_flags) {
+    worker.set_codec(node_name, flags, topk_ratio, response_flags);
 }
 
 void Clear(int node_name) {
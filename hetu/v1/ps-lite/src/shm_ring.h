@@ -0,0 +1,331 @@
+/**
+ *  Copyright (c) 2015 by Contributors
+ */
+#ifndef PS_SHM_RING_H_
+#define PS_SHM_RING_H_
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "common/logging.h"
+
+namespace ps {
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "atomics in shared memory must be lock free");
+
+/**
+ * \brief a single producer single consumer ring of records in a segment of
+ * /dev/shm, shared by two processes
+ *
+ * The producer reserves a record, fills it and publishes it. The consumer
+ * takes records in order, and releases each of them once done with it, in
+ * any order, so that records can be read in place. Space is given back to
+ * the producer in order, up to the first record not released.
+ *
+ * Messages too large for a record are written as consecutive chunks, see
+ * \ref WriteChunks, so that they keep their order with the other records.
+ */
+class ShmRing {
+public:
+    /** \brief records are aligned to cache lines */
+    static constexpr size_t kAlign = 64;
+
+    enum RecordType : uint32_t { kMessage, kPadding, kChunk };
+
+    struct alignas(kAlign) Record {
+        uint64_t size;
+        std::atomic<uint32_t> released;
+        uint32_t type;
+        char *body() {
+            return reinterpret_cast<char *>(this + 1);
+        }
+    };
+
+    static size_t Align(size_t size) {
+        return (size + kAlign - 1) / kAlign * kAlign;
+    }
+
+    /**
+     * \brief open the ring of the name, and create it with the capacity if it
+     * does not exist. both ends open the same ring, with the same generation.
+     *
+     * The end creating the ring initializes it. A ring is never reused: a
+     * ring left by another process with the name is rejected, as its
+     * generation differs, so names should be unique to the processes.
+     */
+    static std::shared_ptr<ShmRing> Open(const std::string &name,
+                                         size_t capacity,
+                                         uint64_t generation) {
+        size_t bytes = sizeof(Control) + Align(capacity);
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+        bool created = fd >= 0;
+        if (created) {
+            CHECK_EQ(ftruncate(fd, bytes), 0)
+                << "failed to allocate " << name << ": " << strerror(errno);
+        } else {
+            CHECK_EQ(errno, EEXIST) << "failed to create " << name << ": "
+                                    << strerror(errno);
+            fd = shm_open(name.c_str(), O_RDWR, 0600);
+            CHECK_GE(fd, 0) << "failed to open " << name << ": "
+                            << strerror(errno);
+            // the other end may not have sized it yet
+            struct stat st;
+            for (int i = 0;; i++) {
+                CHECK_EQ(fstat(fd, &st), 0) << strerror(errno);
+                if (st.st_size > 0)
+                    break;
+                CHECK_LT(i, kOpenRetries) << "ring " << name << " not sized";
+                usleep(1000);
+            }
+            bytes = st.st_size;
+        }
+        void *addr =
+            mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        CHECK(addr != MAP_FAILED) << "failed to map " << name << ": "
+                                  << strerror(errno);
+        Control *ctrl = static_cast<Control *>(addr);
+        if (created) {
+            ctrl->head.store(0, std::memory_order_relaxed);
+            ctrl->tail.store(0, std::memory_order_relaxed);
+            ctrl->bell.store(0, std::memory_order_relaxed);
+            ctrl->waiting.store(0, std::memory_order_relaxed);
+            ctrl->generation = generation;
+            ctrl->magic.store(kMagic, std::memory_order_release);
+        } else {
+            for (int i = 0;
+                 ctrl->magic.load(std::memory_order_acquire) != kMagic; i++) {
+                CHECK_LT(i, kOpenRetries)
+                    << "ring " << name << " not initialized";
+                usleep(1000);
+            }
+            CHECK_EQ(ctrl->generation, generation)
+                << "ring " << name << " is left by another process";
+        }
+        return std::shared_ptr<ShmRing>(new ShmRing(name, addr, bytes));
+    }
+
+    ~ShmRing() {
+        munmap(ctrl_, bytes_);
+    }
+
+    /** \brief remove the name of the ring, which stays mapped */
+    void Unlink() {
+        shm_unlink(name_.c_str());
+    }
+
+    /**
+     * \brief whether a record of the size is small enough for the ring, so
+     * that it fits in an empty ring even after skipping the end of the ring
+     */
+    bool Fits(size_t size) const {
+        return sizeof(Record) + Align(size) <= capacity_ / 2;
+    }
+
+    /**
+     * \brief reserve a record of the size, waiting for space if the ring is
+     * full. the record is invisible to the consumer until \ref Publish.
+     */
+    Record *Reserve(size_t size) {
+        size = sizeof(Record) + Align(size);
+        CHECK_LE(size, capacity_ / 2);
+        uint64_t head = ctrl_->head.load(std::memory_order_relaxed);
+        size_t contiguous = capacity_ - head % capacity_;
+        size_t needed = contiguous < size ? contiguous + size : size;
+        for (int i = 0; capacity_ - (head - ctrl_->tail.load(
+                                         std::memory_order_acquire))
+                        < needed;
+             i++) {
+            if (i < 64)
+                sched_yield();
+            else
+                usleep(20);
+        }
+        if (contiguous < size) {
+            // skip the end of the ring, so that records are contiguous
+            Record *pad = At(head);
+            pad->size = contiguous;
+            pad->released.store(1, std::memory_order_relaxed);
+            pad->type = kPadding;
+            head += contiguous;
+        }
+        Record *record = At(head);
+        record->size = size;
+        record->released.store(0, std::memory_order_relaxed);
+        record->type = kMessage;
+        reserved_ = head + size;
+        return record;
+    }
+
+    /** \brief the most bytes of a chunk, see \ref WriteChunks */
+    size_t ChunkBytes() const {
+        return (capacity_ / 2 - sizeof(Record)) / kAlign * kAlign
+               - sizeof(uint64_t);
+    }
+
+    /**
+     * \brief write a message of any size as records of chunks, each
+     * published once written. every chunk starts with the size of the
+     * message.
+     */
+    void WriteChunks(const char *data, size_t size) {
+        size_t chunk_bytes = ChunkBytes();
+        for (size_t offset = 0; offset < size; offset += chunk_bytes) {
+            size_t n = std::min(chunk_bytes, size - offset);
+            Record *record = Reserve(sizeof(uint64_t) + n);
+            record->type = kChunk;
+            *reinterpret_cast<uint64_t *>(record->body()) = size;
+            memcpy(record->body() + sizeof(uint64_t), data + offset, n);
+            Publish();
+        }
+    }
+
+    /**
+     * \brief read the message of the chunks starting at record, taken by
+     * \ref Next, into a buffer of new[], and release the chunks
+     * \return nullptr if stop is set before the message is complete
+     */
+    char *ReadChunks(Record *record, size_t *size,
+                     const std::atomic<bool> &stop) {
+        CHECK_EQ(record->type, kChunk);
+        *size = *reinterpret_cast<uint64_t *>(record->body());
+        char *data = new char[*size];
+        size_t chunk_bytes = ChunkBytes();
+        for (size_t offset = 0;;) {
+            size_t n = std::min(chunk_bytes, *size - offset);
+            memcpy(data + offset, record->body() + sizeof(uint64_t), n);
+            Release(record);
+            offset += n;
+            if (offset == *size)
+                return data;
+            while (!(record = Next(100))) {
+                if (stop) {
+                    delete[] data;
+                    return nullptr;
+                }
+            }
+            CHECK_EQ(record->type, kChunk) << "chunks of a message interleaved";
+        }
+    }
+
+    /** \brief make the last reserved record visible to the consumer */
+    void Publish() {
+        ctrl_->head.store(reserved_);
+        ctrl_->bell.fetch_add(1);
+        if (ctrl_->waiting.load())
+            syscall(SYS_futex, &ctrl_->bell, FUTEX_WAKE, 1, nullptr, nullptr,
+                    0);
+    }
+
+    /**
+     * \brief take the next record, waiting for at most timeout_ms
+     * \return nullptr on timeout
+     */
+    Record *Next(int timeout_ms) {
+        for (int i = 0;; i++) {
+            uint64_t read = read_.load(std::memory_order_relaxed);
+            if (read < ctrl_->head.load(std::memory_order_acquire)) {
+                Record *record = At(read);
+                read_.store(read + record->size, std::memory_order_release);
+                if (record->type != kPadding)
+                    return record;
+                Reclaim();
+                continue;
+            }
+            if (i < 256) {
+                sched_yield();
+                continue;
+            }
+            if (i > 256)
+                return nullptr;
+            // sleep until the producer rings the bell
+            uint32_t bell = ctrl_->bell.load();
+            ctrl_->waiting.store(1);
+            if (ctrl_->head.load() == read) {
+                struct timespec timeout = {timeout_ms / 1000,
+                                           timeout_ms % 1000 * 1000000};
+                syscall(SYS_futex, &ctrl_->bell, FUTEX_WAIT, bell, &timeout,
+                        nullptr, 0);
+            }
+            ctrl_->waiting.store(0);
+        }
+    }
+
+    /** \brief give the space of a record taken by \ref Next back */
+    void Release(Record *record) {
+        record->released.store(1, std::memory_order_release);
+        Reclaim();
+    }
+
+private:
+    // marks rings initialized by their creators
+    static constexpr uint64_t kMagic = 0x676e6952536d6850;
+    // waits for the other end to create the ring for about 10 seconds
+    static constexpr int kOpenRetries = 10000;
+
+    // head and tail are in bytes written and freed since the ring is created.
+    // magic is set by the creator once the ring is initialized.
+    struct Control {
+        alignas(kAlign) std::atomic<uint64_t> magic;
+        uint64_t generation;
+        alignas(kAlign) std::atomic<uint64_t> head;
+        alignas(kAlign) std::atomic<uint64_t> tail;
+        alignas(kAlign) std::atomic<uint32_t> bell;
+        std::atomic<uint32_t> waiting;
+    };
+
+    ShmRing(const std::string &name, void *addr, size_t bytes) :
+        name_(name), bytes_(bytes), capacity_(bytes - sizeof(Control)),
+        ctrl_(static_cast<Control *>(addr)),
+        data_(static_cast<char *>(addr) + sizeof(Control)) {
+        CHECK_EQ(capacity_ % kAlign, 0) << "corrupted ring " << name;
+        read_ = tail_ = ctrl_->tail.load();
+    }
+
+    Record *At(uint64_t pos) {
+        return reinterpret_cast<Record *>(data_ + pos % capacity_);
+    }
+
+    // frees released records in order, from the consumer only
+    void Reclaim() {
+        std::lock_guard<std::mutex> lk(reclaim_mu_);
+        uint64_t tail = tail_;
+        while (tail < read_.load(std::memory_order_acquire)) {
+            Record *record = At(tail);
+            if (!record->released.load(std::memory_order_acquire))
+                break;
+            tail += record->size;
+        }
+        if (tail != tail_) {
+            tail_ = tail;
+            ctrl_->tail.store(tail, std::memory_order_release);
+        }
+    }
+
+    std::string name_;
+    size_t bytes_;
+    size_t capacity_;
+    Control *ctrl_;
+    char *data_;
+    // end of the last reserved record, of the producer
+    uint64_t reserved_ = 0;
+    // end of records taken, and of records freed, of the consumer
+    std::atomic<uint64_t> read_;
+    uint64_t tail_;
+    std::mutex reclaim_mu_;
+};
+
+} // namespace ps
+#endif // PS_SHM_RING_H_
@@ -0,0 +1,290 @@
+/**
+ *  Copyright (c) 2015 by Contributors
+ */
+#ifndef PS_SHM_VAN_H_
+#define PS_SHM_VAN_H_
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "ps/internal/threadsafe_queue.h"
+#include "./shm_ring.h"
+#include "./zmq_van.h"
+
+namespace ps {
+
+/**
+ * \brief Van passing data messages between workers and servers on the same
+ * host through rings in /dev/shm, and the others through ZMQ
+ *
+ * Each pair of local nodes has a ring for each direction. Control messages
+ * and messages to remote nodes go through ZMQ. All data messages to a local
+ * node go through its ring, so that they arrive in the order they are sent,
+ * as with ZMQ. Data messages are not ordered with control messages, which
+ * ZMQVan does not rely on.
+ *
+ * Received arrays of at least kCopyBytes are read in place in the ring, and
+ * their space is given back once they are freed. Space is given back in
+ * order, so the sender waits while an array is held, and handlers should copy
+ * what they keep. Messages too large for a record are copied through the
+ * ring in chunks.
+ */
+class ShmVan : public ZMQVan {
+public:
+    ShmVan() {
+    }
+    virtual ~ShmVan() {
+    }
+
+protected:
+    void Stop() override {
+        ZMQVan::Stop();
+        if (zmq_receiver_) {
+            zmq_receiver_->join();
+            zmq_receiver_.reset();
+        }
+        stop_ = true;
+        for (auto &thread : ring_receivers_)
+            thread->join();
+        ring_receivers_.clear();
+        stop_ = false;
+        std::lock_guard<std::mutex> lk(rings_mu_);
+        for (auto &it : senders_)
+            it.second->ring->Unlink();
+        senders_.clear();
+        for (auto &ring : inbound_)
+            ring->Unlink();
+        inbound_.clear();
+    }
+
+    void Connect(const Node &node) override {
+        ZMQVan::Connect(node);
+        // data messages only go between workers and servers
+        if (my_node_.id == Node::kEmpty || node.id == my_node_.id
+            || node.role == my_node_.role || node.role == Node::SCHEDULER
+            || my_node_.role == Node::SCHEDULER
+            || node.hostname != my_node_.hostname)
+            return;
+        std::lock_guard<std::mutex> lk(rings_mu_);
+        if (senders_.count(node.id))
+            return;
+        size_t capacity = static_cast<size_t>(GetEnv("PS_SHM_RING_MB", 32))
+                          << 20;
+        std::shared_ptr<Sender> sender(new Sender());
+        sender->ring = ShmRing::Open(RingName(my_node_, node), capacity,
+                                     Generation(my_node_, node));
+        senders_[node.id] = sender;
+        auto ring = ShmRing::Open(RingName(node, my_node_), capacity,
+                                  Generation(node, my_node_));
+        inbound_.push_back(ring);
+        ring_receivers_.emplace_back(
+            new std::thread(&ShmVan::RingReceiving, this, ring, node.id));
+        PS_VLOG(1) << my_node_.ShortDebugString()
+                   << " shares memory with node " << node.id;
+    }
+
+    int SendMsg(const Message &msg) override {
+        if (msg.meta.control.empty()) {
+            std::shared_ptr<Sender> sender;
+            {
+                std::lock_guard<std::mutex> lk(rings_mu_);
+                auto it = senders_.find(msg.meta.recver);
+                if (it != senders_.end())
+                    sender = it->second;
+            }
+            if (sender)
+                return SendRing(sender.get(), msg);
+        }
+        return ZMQVan::SendMsg(msg);
+    }
+
+    int RecvMsg(Message *msg) override {
+        // only called by the receiving thread of Van
+        if (!zmq_receiver_)
+            zmq_receiver_.reset(new std::thread(&ShmVan::ZMQReceiving, this));
+        Received received;
+        recv_queue_.WaitAndPop(&received);
+        *msg = std::move(received.msg);
+        return received.bytes;
+    }
+
+private:
+    /** \brief arrays smaller than this are copied out of rings */
+    static constexpr size_t kCopyBytes = 4096;
+
+    struct Sender {
+        std::shared_ptr<ShmRing> ring;
+        std::mutex mu;
+    };
+
+    struct Received {
+        Message msg;
+        int bytes;
+    };
+
+    // a message in a record is meta, then arrays aligned to cache lines
+    struct RingMessage {
+        uint32_t meta_size;
+        uint32_t num_data;
+        uint64_t *data_size() {
+            return reinterpret_cast<uint64_t *>(this + 1);
+        }
+    };
+
+    // gives a record back to the ring once all arrays in it are freed
+    struct Pin {
+        std::shared_ptr<ShmRing> ring;
+        ShmRing::Record *record;
+        ~Pin() {
+            ring->Release(record);
+        }
+    };
+
+    static std::string RingName(const Node &sender, const Node &recver) {
+        // nonces tell apart processes of jobs on the same host, and rings left
+        // by a crashed job are never opened again
+        char nonces[40];
+        snprintf(nonces, sizeof(nonces), "%016llx-%016llx",
+                 static_cast<unsigned long long>(sender.nonce),
+                 static_cast<unsigned long long>(recver.nonce));
+        return "/ps-" + std::to_string(sender.id) + "-"
+               + std::to_string(recver.id) + "-" + nonces;
+    }
+
+    static uint64_t Generation(const Node &sender, const Node &recver) {
+        return sender.nonce ^ (recver.nonce * 0x9e3779b97f4a7c15ULL);
+    }
+
+    static size_t MetaOffset(size_t num_data) {
+        return sizeof(RingMessage) + num_data * sizeof(uint64_t);
+    }
+
+    // writes the message to body, of the size computed by the sender
+    static void WriteRingMessage(const Message &msg, const char *meta_buf,
+                                 int meta_size, char *body) {
+        size_t n = msg.data.size();
+        RingMessage *ring_msg = reinterpret_cast<RingMessage *>(body);
+        ring_msg->meta_size = meta_size;
+        ring_msg->num_data = n;
+        memcpy(body + MetaOffset(n), meta_buf, meta_size);
+        size_t offset = MetaOffset(n) + meta_size;
+        for (size_t i = 0; i < n; ++i) {
+            offset = ShmRing::Align(offset);
+            ring_msg->data_size()[i] = msg.data[i].size();
+            memcpy(body + offset, msg.data[i].data(), msg.data[i].size());
+            offset += msg.data[i].size();
+        }
+    }
+
+    int SendRing(Sender *sender, const Message &msg) {
+        int meta_size;
+        char *meta_buf;
+        PackMeta(msg.meta, &meta_buf, &meta_size);
+        size_t n = msg.data.size();
+        size_t size = MetaOffset(n) + meta_size;
+        for (auto &data : msg.data)
+            size = ShmRing::Align(size) + data.size();
+        if (sender->ring->Fits(size)) {
+            std::lock_guard<std::mutex> lk(sender->mu);
+            ShmRing::Record *record = sender->ring->Reserve(size);
+            WriteRingMessage(msg, meta_buf, meta_size, record->body());
+            sender->ring->Publish();
+        } else {
+            // rare, so the message is copied once more to be split
+            std::unique_ptr<char[]> buf(new char[size]);
+            WriteRingMessage(msg, meta_buf, meta_size, buf.get());
+            std::lock_guard<std::mutex> lk(sender->mu);
+            sender->ring->WriteChunks(buf.get(), size);
+        }
+        delete[] meta_buf;
+        return size;
+    }
+
+    void RingReceiving(std::shared_ptr<ShmRing> ring, int sender) {
+        while (!stop_) {
+            ShmRing::Record *record = ring->Next(100);
+            if (!record)
+                continue;
+            Received received;
+            if (record->type == ShmRing::kChunk) {
+                size_t size;
+                char *buf = ring->ReadChunks(record, &size, stop_);
+                if (!buf)
+                    break;
+                // arrays share the buffer of the message
+                std::shared_ptr<char> owner(buf, [](char *p) { delete[] p; });
+                received.bytes = ReadRingMessage(
+                    buf, sender, &received.msg,
+                    [&](char *data, size_t size) {
+                        SArray<char> arr;
+                        arr.reset(data, size, [owner](char *) {});
+                        return arr;
+                    });
+            } else {
+                std::shared_ptr<Pin> pin;
+                char *body = record->body();
+                received.bytes = ReadRingMessage(
+                    body, sender, &received.msg,
+                    [&](char *data, size_t size) {
+                        SArray<char> arr;
+                        if (size >= kCopyBytes) {
+                            if (!pin)
+                                pin.reset(new Pin{ring, record});
+                            arr.reset(data, size, [pin](char *) {});
+                        } else {
+                            arr.CopyFrom(data, size);
+                        }
+                        return arr;
+                    });
+                if (!pin)
+                    ring->Release(record);
+            }
+            recv_queue_.Push(std::move(received));
+        }
+    }
+
+    // reads the message in body, making its arrays with array(data, size)
+    template <typename F>
+    int ReadRingMessage(char *body, int sender, Message *msg, F &&array) {
+        RingMessage *ring_msg = reinterpret_cast<RingMessage *>(body);
+        size_t n = ring_msg->num_data;
+        UnpackMeta(body + MetaOffset(n), ring_msg->meta_size, &msg->meta);
+        msg->meta.sender = sender;
+        msg->meta.recver = my_node_.id;
+        size_t offset = MetaOffset(n) + ring_msg->meta_size;
+        for (size_t i = 0; i < n; ++i) {
+            offset = ShmRing::Align(offset);
+            size_t size = ring_msg->data_size()[i];
+            msg->data.push_back(array(body + offset, size));
+            offset += size;
+        }
+        return offset;
+    }
+
+    void ZMQReceiving() {
+        while (true) {
+            Received received;
+            received.bytes = ZMQVan::RecvMsg(&received.msg);
+            bool terminate = received.bytes == -1
+                             || received.msg.meta.control.cmd
+                                    == Control::TERMINATE;
+            recv_queue_.Push(std::move(received));
+            if (terminate)
+                break;
+        }
+    }
+
+    std::mutex rings_mu_;
+    std::unordered_map<int, std::shared_ptr<Sender>> senders_;
+    std::vector<std::shared_ptr<ShmRing>> inbound_;
+    std::vector<std::unique_ptr<std::thread>> ring_receivers_;
+    std::atomic<bool> stop_{false};
+    /** \brief messages from both ZMQ and rings */
+    ThreadsafeQueue<Received> recv_queue_;
+    std::unique_ptr<std::thread> zmq_receiver_;
+};
+} // namespace ps
+
+#endif // PS_SHM_VAN_H_
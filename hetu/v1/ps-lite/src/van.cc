@@ -4,6 +4,7 @@
 
 #include <chrono>
 #include <thread>
+#include <random>
 
 #include "ps/base.h"
 #include "ps/internal/customer.h"
@@ -17,6 +18,7 @@
 #include "./resender.h"
 #include "./zmq_van.h"
 #include "./p3_van.h"
+#include "./shm_van.h"
 
 namespace ps {
 
@@ -31,6 +33,8 @@ Van *Van::Create(const std::string &type) {
         return new ZMQVan();
     } else if (type == "p3") {
         return new P3Van();
+    } else if (type == "shm") {
+        return new ShmVan();
 #ifdef DMLC_USE_IBVERBS
     } else if (type == "ibverbs") {
         return new IBVerbsVan();
@@ -320,6 +324,8 @@ void Van::Start(int customer_id) {
             // possible
             my_node_.id = Node::kEmpty;
             my_node_.customer_id = customer_id;
+            std::random_device rd;
+            my_node_.nonce = static_cast<uint64_t>(rd()) << 32 | rd();
         }
 
         // bind.
@@ -472,6 +478,8 @@ void Van::PackMetaPB(const Meta &meta, PBMeta *pb) {
     pb->set_request(meta.request);
     pb->set_priority(meta.priority);
     pb->set_customer_id(meta.customer_id);
+    if (meta.codec)
+        pb->set_codec(meta.codec);
     if (!meta.control.empty()) {
         auto ctrl = pb->mutable_control();
         ctrl->set_cmd(meta.control.cmd);
@@ -488,6 +496,7 @@ void Van::PackMetaPB(const Meta &meta, PBMeta *pb) {
             p->set_hostname(n.hostname);
             p->set_is_recovery(n.is_recovery);
             p->set_customer_id(n.customer_id);
+            p->set_nonce(n.nonce);
         }
     }
 }
@@ -503,6 +512,8 @@ void Van::PackMeta(const Meta &meta, char **meta_buf, int *buf_size) {
     pb.set_priority(meta.priority);
     pb.set_customer_id(meta.customer_id);
     pb.set_psftype(meta.psftype);
+    if (meta.codec)
+        pb.set_codec(meta.codec);
     if (!meta.control.empty()) {
         auto ctrl = pb.mutable_control();
         ctrl->set_cmd(meta.control.cmd);
@@ -519,6 +530,7 @@ void Van::PackMeta(const Meta &meta, char **meta_buf, int *buf_size) {
             p->set_hostname(n.hostname);
             p->set_is_recovery(n.is_recovery);
             p->set_customer_id(n.customer_id);
+            p->set_nonce(n.nonce);
         }
     }
 
@@ -542,6 +554,7 @@ void Van::UnpackMeta(const char *meta_buf, int buf_size, Meta *meta) {
     meta->priority = pb.priority();
     meta->customer_id = pb.customer_id();
     meta->psftype = static_cast<PsfType>(pb.psftype());
+    meta->codec = pb.codec();
 
     if (pb.has_control()) {
         const auto &ctrl = pb.control();
@@ -557,6 +570,7 @@ void Van::UnpackMeta(const char *meta_buf, int buf_size, Meta *meta) {
             n.id = p.has_id() ? p.id() : Node::kEmpty;
             n.is_recovery = p.is_recovery();
             n.customer_id = p.customer_id();
+            n.nonce = p.nonce();
             meta->control.node.push_back(n);
         }
     } else {
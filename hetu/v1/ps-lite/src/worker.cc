@@ -6,10 +6,11 @@ Worker::Worker() {
 void Worker::parameter_init(int node_name, ParamType ptype, size_t len,
                             size_t width, InitType init_type, double init_a,
                             double init_b, unsigned long long seed,
-                            OptType otype, SArray<float> lrs) {
+                            OptType otype, SArray<float> lrs,
+                            bool server_opt) {
     PSAgent::Get()->registerTensor(node_name, ptype, len, width);
     PSAgent::Get()->ParameterInit(node_name, init_type, init_a, init_b, seed,
-                                  otype, lrs);
+                                  otype, lrs, server_opt);
     PSAgent::Get()->wait(node_name);
     Postoffice::Get()->Barrier(0, kWorkerGroup);
 }
@@ -196,6 +197,13 @@ void Worker::wait(int node_name) {
     PSAgent::Get()->wait(node_name);
 }
 
+void Worker::set_codec(int node_name, int flags, float topk_ratio,
+                       int response_flags) {
+    // requests in flight keep the codec they are sent with
+    wait(node_name);
+    PSAgent::Get()->setCodec(node_name, flags, topk_ratio, response_flags);
+}
+
 void Worker::clear(int node_name) {
     PSAgent::Get()->clear(node_name);
 }
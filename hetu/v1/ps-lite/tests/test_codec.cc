@@ -0,0 +1,103 @@
+#include <random>
+#include <vector>
+#include "ps/psf/PSFunc.h"
+#include "ps/psf/serializer.h"
+
+using namespace ps;
+
+namespace {
+
+// every non-NaN half converts the same with and without F16C, and the odd
+// length leaves a scalar tail
+void TestHalfVectorized() {
+    const size_t n = (1 << 16) + 5;
+    std::vector<uint16_t> halves(n);
+    for (size_t i = 0; i < n; i++) {
+        uint16_t bits = static_cast<uint16_t>(i);
+        bool nan = (bits & 0x7c00) == 0x7c00 && (bits & 0x3ff);
+        halves[i] = nan ? 0 : bits;
+    }
+    std::vector<float> scalar(n), vectorized(n);
+    codec::DecodeHalf(halves.data(), scalar.data(), n, false);
+    codec::DecodeHalf(halves.data(), vectorized.data(), n, true);
+    CHECK(std::memcmp(scalar.data(), vectorized.data(), n * sizeof(float))
+          == 0)
+        << "decoded halves mismatched";
+
+    // floats around every half, including halfway ones and denormals
+    std::mt19937 rng(0);
+    std::vector<float> values(n);
+    for (size_t i = 0; i < n; i++) {
+        uint32_t x;
+        std::memcpy(&x, &scalar[i], sizeof(x));
+        x += static_cast<uint32_t>(rng() % 0x4000) - 0x2000;
+        if ((x & 0x7f800000) == 0x7f800000)
+            x &= 0x807fffff;
+        std::memcpy(&values[i], &x, sizeof(x));
+    }
+    std::vector<uint16_t> encoded_scalar(n), encoded_vectorized(n);
+    codec::EncodeHalf(values.data(), encoded_scalar.data(), n, false);
+    codec::EncodeHalf(values.data(), encoded_vectorized.data(), n, true);
+    for (size_t i = 0; i < n; i++)
+        CHECK_EQ(encoded_scalar[i], encoded_vectorized[i])
+            << "mismatched halves of " << values[i];
+    LOG(INFO) << "half conversion passed (vectorized: "
+              << codec::IsHalfVectorized() << ")";
+}
+
+// responses are lossless unless fp16 or bf16 is asked for
+void TestResponseCodec() {
+    Codec codec;
+    codec.flags = kInt8 | kVarintOffsets | kTopK;
+    codec.block = 300;
+    Codec response = Codec(codec.meta()).responseCodec();
+    CHECK_EQ(response.flags, kVarintOffsets);
+    CHECK(!response.encode_values());
+
+    SArray<float> weights(1000);
+    for (size_t i = 0; i < weights.size(); i++)
+        weights[i] = 1.f / (i + 3);
+    SArray<float> decoded =
+        DecodeValues(EncodeValues(weights, Codec(response.meta())));
+    CHECK(std::memcmp(decoded.data(), weights.data(),
+                      weights.size() * sizeof(float))
+          == 0)
+        << "lossless responses changed the weights";
+
+    codec.response = kFp16;
+    Codec unpacked(codec.meta());
+    CHECK_EQ(unpacked.flags, codec.flags);
+    CHECK_EQ(unpacked.block, codec.block);
+    CHECK_EQ(unpacked.response, kFp16);
+    response = unpacked.responseCodec();
+    CHECK_EQ(response.flags, kFp16 | kVarintOffsets);
+    decoded = DecodeValues(EncodeValues(weights, Codec(response.meta())));
+    for (size_t i = 0; i < weights.size(); i++)
+        CHECK_EQ(decoded[i], codec::HalfToFloat(codec::FloatToHalf(weights[i])));
+    LOG(INFO) << "response codec passed";
+}
+
+// keys of requests are decoded without the rest of the request
+void TestDecodeKey() {
+    PSFData<SSPushPull>::Request request;
+    get<0>(request) = 12345678901ull;
+    get<1>(request) = SArray<size_t>(10, 3);
+    get<2>(request) = SArray<float>(40, 1.f);
+    get<3>(request) = SArray<size_t>(10, 4);
+    Codec codec;
+    codec.flags = kFp16 | kVarintOffsets;
+    std::vector<SArray<char>> data;
+    tupleEncode(request, data, codec);
+    CHECK_EQ(tupleDecodeFirst<PSFData<SSPushPull>::Request>(data),
+             get<0>(request));
+    LOG(INFO) << "key decoding passed";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    TestHalfVectorized();
+    TestResponseCodec();
+    TestDecodeKey();
+    return 0;
+}
@@ -0,0 +1,152 @@
+#include <atomic>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+#include "ps/server/param.h"
+
+using namespace ps;
+
+namespace {
+
+constexpr size_t kRows = 1000;
+constexpr size_t kWidth = 64;
+constexpr size_t kRowsPerPush = 300;
+
+struct Push {
+    SArray<size_t> offsets;
+    SArray<float> vals;
+};
+
+// pushes with duplicate rows, whose values are small integers if integral,
+// so that their sums are exact in any order
+std::vector<Push> MakePushes(int num_pushes, unsigned seed, bool integral) {
+    std::mt19937 rng(seed);
+    std::vector<Push> pushes(num_pushes);
+    for (auto &push : pushes) {
+        push.offsets = SArray<size_t>(kRowsPerPush);
+        // half of the rows are in the first tenth of the table
+        for (auto &offset : push.offsets)
+            offset = rng() % 2 ? rng() % (kRows / 10) : rng() % kRows;
+        push.vals = SArray<float>(kRowsPerPush * kWidth);
+        std::uniform_real_distribution<float> dist(-1, 1);
+        for (size_t i = 0; i < kRowsPerPush; i++) {
+            float row_value = integral ? static_cast<float>(rng() % 7) : 0;
+            for (size_t k = 0; k < kWidth; k++)
+                push.vals[i * kWidth + k] = integral ? row_value : dist(rng);
+        }
+    }
+    return pushes;
+}
+
+// Applies a push to a table one row at a time on this thread. Without an
+// optimizer, values are added in the order of the push, otherwise the values
+// of duplicate rows are summed in that order and applied once, as Param2D
+// documents.
+void PushSerially(Param2D<float> &table, const Push &push) {
+    if (!table.optimizer()) {
+        for (size_t i = 0; i < kRowsPerPush; i++) {
+            float *dst = table.data() + push.offsets[i] * kWidth;
+            for (size_t k = 0; k < kWidth; k++)
+                dst[k] += push.vals[i * kWidth + k];
+        }
+        return;
+    }
+    std::vector<bool> done(kRowsPerPush, false);
+    std::vector<float> sum(kWidth);
+    for (size_t i = 0; i < kRowsPerPush; i++) {
+        if (done[i])
+            continue;
+        size_t row = push.offsets[i];
+        std::copy(push.vals.data() + i * kWidth,
+                  push.vals.data() + (i + 1) * kWidth, sum.data());
+        for (size_t j = i + 1; j < kRowsPerPush; j++) {
+            if (push.offsets[j] != row)
+                continue;
+            done[j] = true;
+            for (size_t k = 0; k < kWidth; k++)
+                sum[k] += push.vals[j * kWidth + k];
+        }
+        table.optimizer()->ApplyRow(row, table.data() + row * kWidth,
+                                    sum.data());
+    }
+}
+
+void CheckSameTable(const Param2D<float> &table,
+                    const Param2D<float> &expected) {
+    for (size_t i = 0; i < kRows * kWidth; i++)
+        CHECK_EQ(table[i], expected[i])
+            << "row " << i / kWidth << " mismatched the serial run";
+}
+
+// pushes from one thread use several threads per push, one per stripe,
+// and match a serial run bit for bit, optimizers included
+void TestParallelPushMatchesSerial(OptType otype) {
+    SArray<float> lrs = {0.1f, 0.9f, 0.999f, 1e-7f};
+    Param2D<float> table(kRows, kWidth, otype, lrs);
+    Param2D<float> expected(kRows, kWidth, otype, lrs);
+    for (const auto &push : MakePushes(50, otype, false)) {
+        table.PushRows(push.offsets, push.vals);
+        PushSerially(expected, push);
+    }
+    CheckSameTable(table, expected);
+    LOG(INFO) << "parallel pushes with optimizer " << otype << " passed";
+}
+
+// pushes and pulls from several threads at once. pushes add the same value
+// to every element of a row, so pulls see rows either before or after a
+// push but never in between, and the result equals a serial run.
+void TestConcurrentPushPull(OptType otype) {
+    const int num_pushers = 4, pushes_per_thread = 200;
+    // the gradients are integers, so SGD with a rate of 1 is exact as well
+    SArray<float> lrs = {1.f};
+    Param2D<float> table(kRows, kWidth, otype, lrs);
+    Param2D<float> expected(kRows, kWidth, otype, lrs);
+    std::vector<std::vector<Push>> pushes;
+    for (int t = 0; t < num_pushers; t++)
+        pushes.push_back(MakePushes(pushes_per_thread, 100 + t, true));
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < num_pushers; t++) {
+        threads.emplace_back([&, t]() {
+            for (const auto &push : pushes[t])
+                table.PushRows(push.offsets, push.vals);
+        });
+    }
+    std::thread puller([&]() {
+        std::mt19937 rng(0);
+        while (!stop) {
+            SArray<size_t> offsets(kRowsPerPush);
+            for (auto &offset : offsets)
+                offset = rng() % kRows;
+            SArray<float> vals(kRowsPerPush * kWidth);
+            table.PullRows(offsets, vals);
+            for (size_t i = 0; i < kRowsPerPush; i++)
+                for (size_t k = 1; k < kWidth; k++)
+                    CHECK_EQ(vals[i * kWidth + k], vals[i * kWidth])
+                        << "row " << offsets[i] << " is torn";
+        }
+    });
+    for (auto &thread : threads)
+        thread.join();
+    stop = true;
+    puller.join();
+    for (const auto &thread_pushes : pushes)
+        for (const auto &push : thread_pushes)
+            PushSerially(expected, push);
+    CheckSameTable(table, expected);
+    LOG(INFO) << "concurrent pushes with optimizer " << otype << " passed";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    setenv("PS_SERVER_NUM_THREADS", "8", 0);
+    setenv("PS_SERVER_NUM_STRIPES", "16", 0);
+    for (OptType otype : {None, SGD, Momentum, AdaGrad, Adam})
+        TestParallelPushMatchesSerial(otype);
+    for (OptType otype : {None, SGD})
+        TestConcurrentPushPull(otype);
+    return 0;
+}
@@ -0,0 +1,135 @@
+/**
+ *  Copyright (c) 2015 by Contributors
+ */
+#include <sys/wait.h>
+#include <random>
+#include <string>
+#include <vector>
+#include "shm_ring.h"
+
+using namespace ps;
+
+namespace {
+
+constexpr size_t kCapacity = 1 << 16;
+
+std::string TestName(const char *name) {
+    return std::string("/ps-test-") + name + "-" + std::to_string(getpid());
+}
+
+// the content of the i-th message, whose sizes cover both in place records
+// and chunked messages of several times the capacity
+std::string Payload(int i) {
+    static const size_t sizes[] = {0, 1, 63, 64, 4096, 20000, 40000,
+                                   3 * kCapacity + 7};
+    size_t size = sizes[i % (sizeof(sizes) / sizeof(sizes[0]))] + i % 5;
+    std::string payload(size, 0);
+    for (size_t k = 0; k < size; k++)
+        payload[k] = static_cast<char>(i * 31 + k);
+    return payload;
+}
+
+void Send(ShmRing *ring, const std::string &payload) {
+    if (ring->Fits(sizeof(uint64_t) + payload.size())) {
+        ShmRing::Record *record =
+            ring->Reserve(sizeof(uint64_t) + payload.size());
+        *reinterpret_cast<uint64_t *>(record->body()) = payload.size();
+        memcpy(record->body() + sizeof(uint64_t), payload.data(),
+               payload.size());
+        ring->Publish();
+    } else {
+        std::string buf(sizeof(uint64_t), 0);
+        *reinterpret_cast<uint64_t *>(&buf[0]) = payload.size();
+        ring->WriteChunks((buf + payload).data(), buf.size() + payload.size());
+    }
+}
+
+// a ring left by a crashed process is not read by the next one
+void TestStaleRing() {
+    std::string name = TestName("stale");
+    {
+        auto ring = ShmRing::Open(name, kCapacity, 1);
+        Send(ring.get(), "OLDJOB");
+        // crashed without unlinking
+    }
+    pid_t pid = fork();
+    if (pid == 0) {
+        // the same name with another generation is rejected
+        ShmRing::Open(name, kCapacity, 2);
+        _exit(0);
+    }
+    int status;
+    CHECK_EQ(waitpid(pid, &status, 0), pid);
+    CHECK(!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+        << "opened a ring left by another process";
+    shm_unlink(name.c_str());
+
+    // a new ring starts empty
+    auto ring = ShmRing::Open(name, kCapacity, 3);
+    CHECK(ring->Next(10) == nullptr) << "read a record of a previous ring";
+    ring->Unlink();
+    LOG(INFO) << "stale ring passed";
+}
+
+// messages of any size arrive in order across processes, and records are
+// released out of order
+void TestOrderAcrossProcesses() {
+    const int num_messages = 2000;
+    std::string name = TestName("order");
+    std::atomic<bool> stop{false};
+    pid_t pid = fork();
+    if (pid == 0) {
+        auto ring = ShmRing::Open(name, kCapacity, 42);
+        for (int i = 0; i < num_messages; i++)
+            Send(ring.get(), Payload(i));
+        _exit(0);
+    }
+    auto ring = ShmRing::Open(name, kCapacity, 42);
+    std::mt19937 rng(0);
+    // records held by the consumer, released in random order. the producer
+    // waits for them, so they are released before waiting for more.
+    std::vector<ShmRing::Record *> held;
+    auto release_held = [&]() {
+        std::shuffle(held.begin(), held.end(), rng);
+        for (auto *record : held)
+            ring->Release(record);
+        held.clear();
+    };
+    for (int i = 0; i < num_messages; i++) {
+        ShmRing::Record *record;
+        while (!(record = ring->Next(10)))
+            release_held();
+        std::string received;
+        if (record->type == ShmRing::kChunk) {
+            release_held();
+            size_t size;
+            char *buf = ring->ReadChunks(record, &size, stop);
+            CHECK(buf != nullptr);
+            received.assign(buf + sizeof(uint64_t),
+                            *reinterpret_cast<uint64_t *>(buf));
+            CHECK_EQ(received.size() + sizeof(uint64_t), size);
+            delete[] buf;
+        } else {
+            received.assign(record->body() + sizeof(uint64_t),
+                            *reinterpret_cast<uint64_t *>(record->body()));
+            held.push_back(record);
+        }
+        CHECK(received == Payload(i)) << "message " << i << " mismatched";
+        if (held.size() > 3)
+            release_held();
+    }
+    release_held();
+    int status;
+    CHECK_EQ(waitpid(pid, &status, 0), pid);
+    CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    ring->Unlink();
+    LOG(INFO) << "order across processes passed";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    TestStaleRing();
+    TestOrderAcrossProcesses();
+    return 0;
+}
@@ -0,0 +1,140 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+#include "ps/server/tiered_table.h"
+
+using namespace ps;
+
+namespace {
+
+// 8192 rows of 1 KB with a cache of 1 MB, so most pushes evict rows and
+// overwritten records are compacted every few MB of pushes
+constexpr size_t kRows = 8192;
+constexpr size_t kWidth = 256;
+constexpr int kNumPushers = 4;
+constexpr int kPushesPerThread = 400;
+constexpr size_t kRowsPerPush = 256;
+
+std::unique_ptr<TieredTable<float>> MakeTable() {
+    return std::unique_ptr<TieredTable<float>>(new TieredTable<float>(
+        kRows, kWidth, None, SArray<float>(), Constant, 0, 0, 0));
+}
+
+std::string TempPath(const char *name) {
+    return std::string("/tmp/ps-test-tiered-") + name + "-"
+           + std::to_string(getpid());
+}
+
+// every value of a row is the number of pushes of the row, as pushes add
+// ones to whole rows, so torn rows show up as unequal values
+void CheckRow(const float *values, size_t row, float expected) {
+    for (size_t k = 0; k < kWidth; k++)
+        CHECK_EQ(values[k], values[0]) << "row " << row << " is torn";
+    if (expected >= 0)
+        CHECK_EQ(values[0], expected) << "row " << row << " mismatched";
+}
+
+SArray<float> PullAll(TieredTable<float> &table) {
+    SArray<size_t> offsets(kRows);
+    for (size_t i = 0; i < kRows; i++)
+        offsets[i] = i;
+    SArray<float> vals(kRows * kWidth);
+    table.PullRows(offsets, vals);
+    return vals;
+}
+
+// pushes, pulls, prefetches and a save race with eviction and compaction,
+// and every push lands exactly once
+void TestConcurrentAccess() {
+    auto table = MakeTable();
+    std::vector<std::atomic<int>> counts(kRows);
+    for (auto &count : counts)
+        count = 0;
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNumPushers; t++) {
+        threads.emplace_back([&, t]() {
+            std::mt19937 rng(t);
+            // skewed rows, with duplicates in a push
+            std::geometric_distribution<size_t> dist(4.0 / kRows);
+            for (int i = 0; i < kPushesPerThread; i++) {
+                SArray<size_t> offsets(kRowsPerPush);
+                for (auto &offset : offsets)
+                    offset = std::min(dist(rng), kRows - 1);
+                SArray<float> vals(kRowsPerPush * kWidth);
+                std::fill(vals.begin(), vals.end(), 1.f);
+                if (i % 4 == 0)
+                    table->Prefetch(offsets);
+                table->PushRows(offsets, vals);
+                for (auto offset : offsets)
+                    counts[offset]++;
+            }
+        });
+    }
+    std::thread puller([&]() {
+        std::mt19937 rng(kNumPushers);
+        while (!stop) {
+            SArray<size_t> offsets(kRowsPerPush);
+            for (auto &offset : offsets)
+                offset = rng() % kRows;
+            SArray<float> vals(kRowsPerPush * kWidth);
+            table->PullRows(offsets, vals);
+            for (size_t i = 0; i < offsets.size(); i++)
+                CheckRow(vals.data() + i * kWidth, offsets[i], -1);
+        }
+    });
+    std::string path = TempPath("concurrent");
+    std::thread saver([&]() {
+        table->Save(path);
+    });
+    saver.join();
+    for (auto &thread : threads)
+        thread.join();
+    stop = true;
+    puller.join();
+
+    // the save saw every row whole
+    {
+        auto loaded = MakeTable();
+        loaded->Load(path);
+        SArray<float> vals = PullAll(*loaded);
+        for (size_t row = 0; row < kRows; row++) {
+            CheckRow(vals.data() + row * kWidth, row, -1);
+            CHECK_LE(vals[row * kWidth], counts[row]);
+        }
+    }
+    SArray<float> vals = PullAll(*table);
+    for (size_t row = 0; row < kRows; row++)
+        CheckRow(vals.data() + row * kWidth, row, counts[row]);
+    CHECK_LE(table->num_cached_rows(), (1 << 20) / (kWidth * sizeof(float)));
+    // every push evicts rows, which would take several times the table
+    // without compaction
+    CHECK_LT(table->num_log_bytes(), 4 * kRows * kWidth * sizeof(float))
+        << "the row log is not compacted";
+
+    // a final save and load round trip
+    table->Save(path);
+    auto loaded = MakeTable();
+    loaded->Load(path);
+    SArray<float> reloaded = PullAll(*loaded);
+    for (size_t row = 0; row < kRows; row++)
+        CheckRow(reloaded.data() + row * kWidth, row, counts[row]);
+    std::remove(path.c_str());
+    LOG(INFO) << "concurrent access passed";
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+    setenv("PS_SERVER_CACHE_MB", "1", 0);
+    setenv("PS_SERVER_COMPACT_MB", "1", 0);
+    setenv("PS_SERVER_NUM_STRIPES", "64", 0);
+    setenv("PS_SERVER_PREFETCH_THREADS", "2", 0);
+    TestConcurrentAccess();
+    return 0;
+}
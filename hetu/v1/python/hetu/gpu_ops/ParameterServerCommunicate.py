@@ -10,6 +10,17 @@ import numpy as np
 import ctypes
 
 
+def server_optimizer_enabled(optimizer):
+    """Whether servers apply the optimizer, given its config.
+
+    Decided by PS_SERVER_OPTIMIZER on workers only, and passed to servers by
+    InitTensor, so that the learning rate is applied exactly once.
+    Optimizers other than SGD, Momentum, Nesterov, AdaGrad and Adam are not
+    supported on servers.
+    """
+    return os.environ.get('PS_SERVER_OPTIMIZER', '0') != '0' and optimizer[0].value < 5
+
+
 class ParameterServerCommunicateOp(Op):
 
     def __init__(self, nodeA, parameter, optimizer):
@@ -18,9 +29,10 @@ class ParameterServerCommunicateOp(Op):
         self.on_cpu = not self.on_gpu
         self.parameter = parameter
         self.optimizer = optimizer
-        # the optimizer not implemented yet! only SGD is supported, calculate on worker
+        # SGD is calculated on worker, unless PS_SERVER_OPTIMIZER=1, with which
+        # servers apply the gradients with the optimizer (except on caches).
         # the optimizer only support fixed learning rate, no scheduler supported.
-        # TODO: implement optimizer on Servers(already implemented, not in use) and Caches(not implemented yet)
+        # TODO: implement optimizer on Caches(not implemented yet)
         # TODO: implement learning rate scheduler
         self.learning_rate = -optimizer[1][0]
         self.ps_id = ctypes.c_int(self.parameter.id)
@@ -56,6 +68,9 @@ class ParameterServerCommunicateOp(Op):
         self._mult_lr(input_vals[0], stream_handle)
         self._update_event(self._push(input_vals[0], stream_handle))
 
+    def _mult_lr_none(self, input_val, stream_handle):
+        pass
+
     def _mult_lr_sparse_cpu(self, input_val, stream_handle):
         input_val.values[:] = input_val.values.asnumpy() * self.learning_rate
 
@@ -232,6 +247,8 @@ class ParameterServerCommunicateOp(Op):
             self._push = self._push_dense_gpu
             self._pull = self._pull_dense
             self._push_pull = self._push_pull_dense_gpu
+        if server_optimizer_enabled(self.optimizer):
+            self._mult_lr = self._mult_lr_none
         if config.bsp >= 0 and (config.prefetch or not self_sparse):
             self.compute = self._compute_ssp_prefetch
             self.ssp_version = 0
@@ -36,10 +36,12 @@ class BaseInit(object):
             length = self.shape[0]
             width = self.shape[1]
         from .random import get_seed, get_seed_seqnum, step_seqnum
+        from .gpu_ops.ParameterServerCommunicate import server_optimizer_enabled
         step_seqnum(1)
         seed = get_seed() + get_seed_seqnum()
         comm.InitTensor(nid, ctypes.c_int(param_type), ctypes.c_int(length), ctypes.c_int(width),
-                        ctypes.c_int(init_type), ctypes.c_double(arg1), ctypes.c_double(arg2), ctypes.c_ulonglong(seed), opt[0], opt[1], opt[2])
+                        ctypes.c_int(init_type), ctypes.c_double(arg1), ctypes.c_double(arg2), ctypes.c_ulonglong(seed), opt[0], opt[1], opt[2],
+                        ctypes.c_int(server_optimizer_enabled(opt)))
 
 
 class EmptyInit(BaseInit):
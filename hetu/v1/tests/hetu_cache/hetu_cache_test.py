@@ -15,7 +15,7 @@ def test(args):
     length = 10000
     width = 128
     comm.InitTensor(ctypes.c_int(node_id), ctypes.c_int(2), ctypes.c_int(length), ctypes.c_int(width), ctypes.c_int(2), ctypes.c_double(0), ctypes.c_double(0.1), ctypes.c_ulonglong(123),
-                    ctypes.c_int(0), (ctypes.c_float * 1)(0.1), ctypes.c_int(1))
+                    ctypes.c_int(0), (ctypes.c_float * 1)(0.1), ctypes.c_int(1), ctypes.c_int(0))
     cache = CacheSparseTable(limit, length, width, node_id, "LFUOpt")
     for i in tqdm(range(10000)):
         key = np.random.randint(10000, size=1000).astype(np.uint64)
@@ -40,7 +40,7 @@ def test_init_ps(rarr, init_type, init_a, init_b=1.0, sparse=False):
         arr_wid = ctypes.c_int(1)
     itype = ctypes.c_int(init_type_map[init_type])
     comm.InitTensor(ctypes.c_int(0), ctypes.c_int(sparse), arr_len, arr_wid, itype, ctypes.c_double(
-        init_a), ctypes.c_double(init_b), ctypes.c_ulonglong(123), ctypes.c_int(0), (ctypes.c_float * 1)(0.1), ctypes.c_int(1))
+        init_a), ctypes.c_double(init_b), ctypes.c_ulonglong(123), ctypes.c_int(0), (ctypes.c_float * 1)(0.1), ctypes.c_int(1), ctypes.c_int(0))
 
     comm.Pull(ctypes.c_int(0), arr.handle)
     comm.Wait(ctypes.c_int(0))
@@ -101,7 +101,7 @@ def test_api(rarr, rpush, rpull, sparse=False, lr=0.5):
         arr_len = ctypes.c_int(nitem * item_len)
         arr_wid = ctypes.c_int(1)
     comm.InitTensor(ctypes.c_int(0), ctypes.c_int(sparse), arr_len, arr_wid, ctypes.c_int(0), ctypes.c_double(0.0), ctypes.c_double(1.0), ctypes.c_ulonglong(123),
-                    ctypes.c_int(0), (ctypes.c_float * 1)(lr), ctypes.c_int(1))
+                    ctypes.c_int(0), (ctypes.c_float * 1)(lr), ctypes.c_int(1), ctypes.c_int(0))
     if sparse:
         local_arr[:] = 0
         for j in local_push:
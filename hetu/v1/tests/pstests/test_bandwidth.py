@@ -156,7 +156,7 @@ def test(func_name, nitem=2000, item_len=10000, ind_len=500, max_thread=10, ret_
         sparse_init = ctypes.c_int(0)
     for i in range(max_thread):
         comm.InitTensor(i, sparse_init, arr_len, arr_wid, ctypes.c_int(0), ctypes.c_double(0), ctypes.c_double(1), ctypes.c_ulonglong(123),
-                        ctypes.c_int(0), (ctypes.c_float * 1)(0.1), ctypes.c_int(1))
+                        ctypes.c_int(0), (ctypes.c_float * 1)(0.1), ctypes.c_int(1), ctypes.c_int(0))
     t = ThreadPoolExecutor(max_workers=max_thread)
     if ret_ans:
         task_list = [None for i in range(max_thread)]
@@ -0,0 +1,151 @@
+import hetu as ht
+
+import time
+import os
+import yaml
+import tempfile
+import multiprocessing
+import argparse
+import signal
+import numpy as np
+import ctypes
+
+
+# flags of SetCodec, see ps-lite/include/ps/psf/codec.h
+codecs = [
+    ('none', 0),
+    ('fp16', 1),
+    ('bf16', 2),
+    ('int8', 3),
+    ('int8+varint', 3 | 16),
+    ('fp16+varint+topk', 1 | 16 | 32),
+]
+
+
+def start_process(settings, args):
+    for key, value in settings.items():
+        os.environ[key] = str(value)
+    if os.environ['DMLC_ROLE'] == "server":
+        ht.server_init()
+        ht.server_finish()
+    elif os.environ['DMLC_ROLE'] == "worker":
+        ht.worker_init()
+        test(args)
+        ht.worker_finish()
+    elif os.environ['DMLC_ROLE'] == "scheduler":
+        ht.scheduler_init()
+        ht.scheduler_finish()
+    else:
+        raise ValueError("Unknown role", os.environ['DMLC_ROLE'])
+
+
+def signal_handler(signal, frame):
+    print("SIGINT signal caught, stop Training")
+    for proc in process_list:
+        proc.kill()
+    exit(0)
+
+
+def read_loads(path):
+    # bytes sent and received by each getLoads, from the log of the worker
+    loads = []
+    sent, recv = 0, 0
+    for line in open(path):
+        if not line.strip():
+            loads.append((sent, recv))
+            sent, recv = 0, 0
+            continue
+        counts = line.split(':')[1]
+        sent += int(counts.split()[0])
+        recv += int(counts.split()[1])
+    return loads
+
+
+def test(args):
+    # each codec has a sparse table and a dense tensor, which get the same
+    # pushes, so that they can be compared to fp32
+    ctx = ht.cpu(0)
+    rank = int(os.environ["WORKER_ID"])
+    nitem, item_len, ind_len = args.nitem, args.item_len, args.ind_len
+    dense_len = args.dense_len
+    comm = ht.get_worker_communicate()
+    for i, (_, flags) in enumerate(codecs):
+        comm.InitTensor(2 * i, ctypes.c_int(1), ctypes.c_int(nitem), ctypes.c_int(item_len), ctypes.c_int(0), ctypes.c_double(0), ctypes.c_double(0), ctypes.c_ulonglong(123),
+                        ctypes.c_int(0), (ctypes.c_float * 1)(0.1), ctypes.c_int(1), ctypes.c_int(0))
+        comm.InitTensor(2 * i + 1, ctypes.c_int(0), ctypes.c_int(dense_len), ctypes.c_int(1), ctypes.c_int(0), ctypes.c_double(0), ctypes.c_double(0), ctypes.c_ulonglong(123),
+                        ctypes.c_int(0), (ctypes.c_float * 1)(0.1), ctypes.c_int(1), ctypes.c_int(0))
+        comm.SetCodec(2 * i, ctypes.c_int(flags), ctypes.c_float(args.topk_ratio), ctypes.c_int(0))
+        comm.SetCodec(2 * i + 1, ctypes.c_int(flags), ctypes.c_float(args.topk_ratio), ctypes.c_int(0))
+
+    rng = np.random.RandomState(rank)
+    indices = [np.sort(rng.randint(0, nitem, size=(ind_len,))).astype(np.float32)
+               for _ in range(args.iters)]
+    sparse_grads = [rng.normal(size=(ind_len, item_len)).astype(np.float32)
+                    for _ in range(args.iters)]
+    dense_grads = [rng.normal(size=(dense_len,)).astype(np.float32)
+                   for _ in range(args.iters)]
+    outarr = ht.array(np.zeros((ind_len, item_len)), ctx=ctx)
+    dense_out = ht.array(np.zeros((dense_len,)), ctx=ctx)
+    log_dir = tempfile.mkdtemp()
+    comm.startRecord(ctypes.c_char_p(bytes(log_dir, 'utf-8')))
+    comm.BarrierWorker()
+
+    times = []
+    for i, (name, _) in enumerate(codecs):
+        start = time.time()
+        for it in range(args.iters):
+            inind = ht.array(indices[it], ctx=ctx)
+            inarr = ht.array(sparse_grads[it], ctx=ctx)
+            comm.SparsePush(2 * i, inind.handle, inarr.handle, None)
+            comm.SparsePull(2 * i, inind.handle, outarr.handle)
+            comm.Wait(2 * i)
+        sparse_time = time.time() - start
+        start = time.time()
+        for it in range(args.iters):
+            inarr = ht.array(dense_grads[it], ctx=ctx)
+            comm.DDPushPull(2 * i + 1, inarr.handle, dense_out.handle, None)
+            comm.Wait(2 * i + 1)
+        dense_time = time.time() - start
+        comm.getLoads()
+        times.append((sparse_time, dense_time))
+    comm.BarrierWorker()
+
+    reference = None
+    loads = read_loads(os.path.join(log_dir, "loads_{}.txt".format(rank)))
+    for i, (name, _) in enumerate(codecs):
+        comm.SetCodec(2 * i + 1, ctypes.c_int(0), ctypes.c_float(0), ctypes.c_int(0))
+        comm.Pull(2 * i + 1, dense_out.handle)
+        comm.Wait(2 * i + 1)
+        value = dense_out.asnumpy()
+        if reference is None:
+            reference = value
+        error = np.abs(value - reference).max() / np.abs(reference).max()
+        sparse_time, dense_time = times[i]
+        print("worker {} {:>18}: {:8.2f} MB sent, {:8.2f} MB received, {:6.2f} sparse steps/s, {:6.2f} dense steps/s, relative error {:.2e}".format(
+            rank, name, loads[i][0] / 2 ** 20, loads[i][1] / 2 ** 20,
+            args.iters / sparse_time, args.iters / dense_time, error))
+    comm.BarrierWorker()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--config", default='./local_s1_w4.yml')
+    parser.add_argument("--nitem", type=int, default=100000)
+    parser.add_argument("--item-len", type=int, default=64)
+    parser.add_argument("--ind-len", type=int, default=8192)
+    parser.add_argument("--dense-len", type=int, default=1 << 20)
+    parser.add_argument("--iters", type=int, default=20)
+    parser.add_argument("--topk-ratio", type=float, default=0.01)
+    args = parser.parse_args()
+    file_path = args.config
+    settings = yaml.load(open(file_path).read(), Loader=yaml.FullLoader)
+    process_list = []
+    for key, value in settings.items():
+        if key != 'shared':
+            proc = multiprocessing.Process(
+                target=start_process, args=[value, args])
+            process_list.append(proc)
+            proc.start()
+    signal.signal(signal.SIGINT, signal_handler)
+    for proc in process_list:
+        proc.join()
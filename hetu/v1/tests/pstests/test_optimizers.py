@@ -0,0 +1,224 @@
+import hetu as ht
+
+import time
+import os
+import yaml
+import multiprocessing
+import argparse
+import signal
+import numpy as np
+import ctypes
+
+
+# OptType and learning rates of InitTensor, see ps-lite/include/ps/server/optimizer.h
+optimizers = [
+    ('sgd', 0, [0.1]),
+    ('momentum', 1, [0.1, 0.9]),
+    ('nesterov', 2, [0.1, 0.9]),
+    ('adagrad', 3, [0.1, 0.1, 1e-7]),
+    ('adam', 4, [0.01, 0.9, 0.999, 1e-7]),
+]
+
+
+def start_process(settings, args):
+    for key, value in settings.items():
+        os.environ[key] = str(value)
+    os.environ['PS_SERVER_FP16_STATES'] = str(int(args.fp16_states))
+    if os.environ['DMLC_ROLE'] == "server":
+        ht.server_init()
+        ht.server_finish()
+    elif os.environ['DMLC_ROLE'] == "worker":
+        ht.worker_init()
+        test(args)
+        ht.worker_finish()
+    elif os.environ['DMLC_ROLE'] == "scheduler":
+        ht.scheduler_init()
+        ht.scheduler_finish()
+    else:
+        raise ValueError("Unknown role", os.environ['DMLC_ROLE'])
+
+
+def signal_handler(signal, frame):
+    print("SIGINT signal caught, stop Training")
+    for proc in process_list:
+        proc.kill()
+    exit(0)
+
+
+class Reference(object):
+    # updates of rows in float64, each row counts its own steps, and pushes
+    # are added without optimizers (otype 5)
+    def __init__(self, otype, lrs, shape):
+        self.otype, self.lrs = otype, lrs
+        self.param = np.zeros(shape)
+        init = lrs[1] if otype == 3 else 0
+        self.states = [np.full(shape, init, dtype=np.float64)
+                       for _ in range(2)]
+        self.steps = np.zeros(shape[0])
+
+    def update(self, rows, grad):
+        lrs, w = self.lrs, self.param
+        s0, s1 = self.states
+        self.steps[rows] += 1
+        if self.otype == 5:
+            w[rows] += grad
+        elif self.otype == 0:
+            w[rows] -= lrs[0] * grad
+        elif self.otype == 1:
+            s0[rows] = lrs[1] * s0[rows] - lrs[0] * grad
+            w[rows] += s0[rows]
+        elif self.otype == 2:
+            temp = -lrs[0] * grad
+            s0[rows] = lrs[1] * (s0[rows] + temp)
+            w[rows] += s0[rows] + temp
+        elif self.otype == 3:
+            s0[rows] += grad * grad
+            w[rows] -= lrs[0] * grad / (np.sqrt(s0[rows]) + lrs[2])
+        else:
+            t = self.steps[rows][:, None]
+            s0[rows] = lrs[1] * s0[rows] + (1 - lrs[1]) * grad
+            s1[rows] = lrs[2] * s1[rows] + (1 - lrs[2]) * grad * grad
+            w[rows] -= lrs[0] * s0[rows] / (1 - lrs[1] ** t) / \
+                (np.sqrt(s1[rows] / (1 - lrs[2] ** t)) + lrs[3])
+
+
+def init_tensor(comm, nid, ptype, length, width, otype, lrs):
+    # servers apply the optimizer, except on cache tables
+    comm.InitTensor(nid, ctypes.c_int(ptype), ctypes.c_int(length), ctypes.c_int(width), ctypes.c_int(0), ctypes.c_double(0), ctypes.c_double(0), ctypes.c_ulonglong(123),
+                    ctypes.c_int(otype), (ctypes.c_float * len(lrs))(*lrs), ctypes.c_int(len(lrs)), ctypes.c_int(1))
+
+
+def relative_error(value, reference):
+    return np.abs(value - reference).max() / np.abs(reference).max()
+
+
+def test_correctness(comm, args, nid, otype, lrs):
+    # only rows below nitem // 10 are pushed, with duplicates in each push
+    ctx = ht.cpu(0)
+    nitem, item_len, ind_len = args.nitem, args.item_len, args.ind_len
+    sparse_ref = Reference(otype, lrs, (nitem, item_len))
+    dense_ref = Reference(otype, lrs, (1, args.dense_len))
+    rng = np.random.RandomState(otype)
+    for _ in range(args.iters):
+        indices = rng.randint(0, nitem // 10, size=(ind_len,))
+        grads = rng.normal(size=(ind_len, item_len)).astype(np.float32)
+        comm.SparsePush(nid, ht.array(indices.astype(np.float32), ctx=ctx).handle,
+                        ht.array(grads, ctx=ctx).handle, None)
+        comm.Wait(nid)
+        rows, inverse = np.unique(indices, return_inverse=True)
+        merged = np.zeros((len(rows), item_len))
+        np.add.at(merged, inverse, grads)
+        sparse_ref.update(rows, merged)
+
+        grads = rng.normal(size=(args.dense_len,)).astype(np.float32)
+        comm.Push(nid + 1, ht.array(grads, ctx=ctx).handle, None)
+        comm.Wait(nid + 1)
+        dense_ref.update(np.array([0]), grads[None, :])
+
+    sparse_out = ht.array(np.zeros((nitem, item_len)), ctx=ctx)
+    comm.SparsePull(nid, ht.array(np.arange(nitem).astype(np.float32), ctx=ctx).handle,
+                    sparse_out.handle)
+    comm.Wait(nid)
+    dense_out = ht.array(np.zeros((args.dense_len,)), ctx=ctx)
+    comm.Pull(nid + 1, dense_out.handle)
+    comm.Wait(nid + 1)
+    sparse_error = relative_error(sparse_out.asnumpy(), sparse_ref.param)
+    dense_error = relative_error(dense_out.asnumpy(), dense_ref.param[0])
+    # rows never pushed keep their initial values
+    assert not sparse_out.asnumpy()[nitem // 10:].any()
+    return sparse_error, dense_error
+
+
+def test_dense_push_on_tables(comm, args, nid, otype, lrs):
+    # dense pushes update every row of sparse tables and add to cache tables
+    ctx = ht.cpu(0)
+    nrows, item_len = args.dense_rows, args.item_len
+    table_ref = Reference(otype, lrs, (nrows, item_len))
+    cache_ref = Reference(5, lrs, (nrows, item_len))
+    rng = np.random.RandomState(otype)
+    table_out = ht.array(np.zeros((nrows, item_len)), ctx=ctx)
+    for _ in range(args.iters):
+        grads = rng.normal(size=(nrows, item_len)).astype(np.float32)
+        comm.DDPushPull(nid, ht.array(grads, ctx=ctx).handle,
+                        table_out.handle, None)
+        comm.Wait(nid)
+        table_ref.update(np.arange(nrows), grads)
+        comm.Push(nid + 1, ht.array(grads, ctx=ctx).handle, None)
+        comm.Wait(nid + 1)
+        cache_ref.update(np.arange(nrows), grads)
+    cache_out = ht.array(np.zeros((nrows, item_len)), ctx=ctx)
+    comm.Pull(nid + 1, cache_out.handle)
+    comm.Wait(nid + 1)
+    return (relative_error(table_out.asnumpy(), table_ref.param),
+            relative_error(cache_out.asnumpy(), cache_ref.param))
+
+
+def test(args):
+    ctx = ht.cpu(0)
+    rank = int(os.environ["WORKER_ID"])
+    tolerance = 2e-2 if args.fp16_states else 1e-4
+    comm = ht.get_worker_communicate()
+    for i, (name, otype, lrs) in enumerate(optimizers):
+        init_tensor(comm, 4 * i, 1, args.nitem, args.item_len, otype, lrs)
+        init_tensor(comm, 4 * i + 1, 0, args.dense_len, 1, otype, lrs)
+        init_tensor(comm, 4 * i + 100, 1, args.dense_rows, args.item_len, otype, lrs)
+        init_tensor(comm, 4 * i + 101, 2, args.dense_rows, args.item_len, otype, lrs)
+        # the order of updates of several workers is not deterministic
+        if rank == 0:
+            sparse_error, dense_error = test_correctness(
+                comm, args, 4 * i, otype, lrs)
+            print("{:>8}: sparse relative error {:.2e}, dense relative error {:.2e}".format(
+                name, sparse_error, dense_error))
+            assert sparse_error < tolerance and dense_error < tolerance
+            table_error, cache_error = test_dense_push_on_tables(
+                comm, args, 4 * i + 100, otype, lrs)
+            print("{:>8}: dense push on table relative error {:.2e}, on cache table {:.2e}".format(
+                name, table_error, cache_error))
+            assert table_error < tolerance and cache_error < tolerance
+        comm.BarrierWorker()
+
+    nitem, item_len, ind_len = args.nitem, args.item_len, args.ind_len
+    rng = np.random.RandomState(rank)
+    inind = ht.array(rng.randint(0, nitem, size=(
+        ind_len,)).astype(np.float32), ctx=ctx)
+    inarr = ht.array(rng.normal(size=(ind_len, item_len)), ctx=ctx)
+    for i, (name, otype, lrs) in enumerate(optimizers):
+        nid = 4 * i + 2
+        init_tensor(comm, nid, 1, nitem, item_len, otype, lrs)
+        comm.BarrierWorker()
+        start = time.time()
+        for _ in range(args.iters):
+            comm.SparsePush(nid, inind.handle, inarr.handle, None)
+            comm.Wait(nid)
+        comm.BarrierWorker()
+        elapsed = time.time() - start
+        if rank == 0:
+            nworker = int(os.environ["DMLC_NUM_WORKER"])
+            print("{:>8}: {:.1f} M values/s of {} workers".format(
+                name, nworker * args.iters * ind_len * item_len / elapsed / 1e6, nworker))
+    print('Optimizers {} passed.'.format(rank))
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--config", default='./local_s1_w4.yml')
+    parser.add_argument("--nitem", type=int, default=100000)
+    parser.add_argument("--item-len", type=int, default=64)
+    parser.add_argument("--ind-len", type=int, default=8192)
+    parser.add_argument("--dense-len", type=int, default=1 << 16)
+    parser.add_argument("--dense-rows", type=int, default=512)
+    parser.add_argument("--iters", type=int, default=20)
+    parser.add_argument("--fp16-states", action='store_true')
+    args = parser.parse_args()
+    file_path = args.config
+    settings = yaml.load(open(file_path).read(), Loader=yaml.FullLoader)
+    process_list = []
+    for key, value in settings.items():
+        if key != 'shared':
+            proc = multiprocessing.Process(
+                target=start_process, args=[value, args])
+            process_list.append(proc)
+            proc.start()
+    signal.signal(signal.SIGINT, signal_handler)
+    for proc in process_list:
+        proc.join()
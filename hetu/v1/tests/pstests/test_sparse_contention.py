@@ -0,0 +1,113 @@
+import hetu as ht
+
+import time
+import os
+import yaml
+import multiprocessing
+import argparse
+import signal
+import numpy as np
+import ctypes
+
+
+def start_process(settings, args):
+    for key, value in settings.items():
+        os.environ[key] = str(value)
+    if os.environ['DMLC_ROLE'] == "server":
+        ht.server_init()
+        ht.server_finish()
+    elif os.environ['DMLC_ROLE'] == "worker":
+        ht.worker_init()
+        test(args)
+        ht.worker_finish()
+    elif os.environ['DMLC_ROLE'] == "scheduler":
+        ht.scheduler_init()
+        ht.scheduler_finish()
+    else:
+        raise ValueError("Unknown role", os.environ['DMLC_ROLE'])
+
+
+def signal_handler(signal, frame):
+    print("SIGINT signal caught, stop Training")
+    for proc in process_list:
+        proc.kill()
+    exit(0)
+
+
+def test(args):
+    # all workers push to and pull from the same table,
+    # with duplicate rows in every push
+    ctx = ht.cpu(0)
+    rank = int(os.environ["WORKER_ID"])
+    nrank = int(os.environ["DMLC_NUM_WORKER"])
+    nitem, item_len, ind_len = args.nitem, args.item_len, args.ind_len
+    if args.zipf > 0:
+        # skewed keys, with hot rows spread over the table
+        prob = 1 / np.arange(1, nitem + 1) ** args.zipf
+        prob /= prob.sum()
+        perm = np.random.RandomState(0).permutation(nitem)
+
+    comm = ht.get_worker_communicate()
+    # 1 for in-memory tables, 3 for tiered tables
+    comm.InitTensor(0, ctypes.c_int(args.ptype), ctypes.c_int(nitem), ctypes.c_int(item_len), ctypes.c_int(0), ctypes.c_double(0), ctypes.c_double(0), ctypes.c_ulonglong(123),
+                    ctypes.c_int(5), (ctypes.c_float * 1)(0), ctypes.c_int(1), ctypes.c_int(0))
+    inarr = ht.array(np.ones((ind_len, item_len)), ctx=ctx)
+    outarr = ht.array(np.zeros((ind_len, item_len)), ctx=ctx)
+    np.random.seed(rank)
+    comm.BarrierWorker()
+
+    latency = []
+    for _ in range(args.iters):
+        if args.zipf > 0:
+            np_ind = perm[np.random.choice(nitem, size=(ind_len,), p=prob)]
+        else:
+            np_ind = np.random.randint(low=0, high=nitem, size=(ind_len,))
+        np_ind[::8] = 0
+        inind = ht.array(np_ind.astype(np.float32), ctx=ctx)
+        start = time.time()
+        comm.SparsePush(0, inind.handle, inarr.handle, None)
+        comm.SparsePull(0, inind.handle, outarr.handle)
+        comm.Wait(0)
+        latency.append(time.time() - start)
+    latency = np.array(latency) * 1000
+    print("worker {}: {:.0f} rows/s pushed and pulled, latency p50 {:.2f} ms, p99 {:.2f} ms".format(
+        rank, args.iters * ind_len * 2 / latency.sum() * 1000,
+        np.percentile(latency, 50), np.percentile(latency, 99)))
+
+    comm.BarrierWorker()
+    if rank == 0:
+        # sparse pulls work for tiered tables as well
+        table = ht.array(np.zeros((nitem, item_len)), ctx=ctx)
+        allind = ht.array(np.arange(nitem).astype(np.float32), ctx=ctx)
+        comm.SparsePull(0, allind.handle, table.handle)
+        comm.Wait(0)
+        total = table.asnumpy().sum(dtype=np.float64)
+        expected = nrank * args.iters * ind_len * item_len
+        assert np.isclose(total, expected), (total, expected)
+        print("sum of the table: {} (expected {})".format(total, expected))
+    comm.BarrierWorker()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--config", default='./local_s1_w4.yml')
+    parser.add_argument("--nitem", type=int, default=200000)
+    parser.add_argument("--item-len", type=int, default=64)
+    parser.add_argument("--ind-len", type=int, default=4096)
+    parser.add_argument("--iters", type=int, default=100)
+    parser.add_argument("--ptype", type=int, default=1)
+    parser.add_argument("--zipf", type=float, default=0,
+                        help="exponent of the Zipf distribution of keys, uniform if 0")
+    args = parser.parse_args()
+    file_path = args.config
+    settings = yaml.load(open(file_path).read(), Loader=yaml.FullLoader)
+    process_list = []
+    for key, value in settings.items():
+        if key != 'shared':
+            proc = multiprocessing.Process(
+                target=start_process, args=[value, args])
+            process_list.append(proc)
+            proc.start()
+    signal.signal(signal.SIGINT, signal_handler)
+    for proc in process_list:
+        proc.join()
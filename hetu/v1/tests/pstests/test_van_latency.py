@@ -0,0 +1,93 @@
+import hetu as ht
+
+import time
+import os
+import yaml
+import multiprocessing
+import argparse
+import signal
+import numpy as np
+import ctypes
+
+
+def start_process(settings, args):
+    for key, value in settings.items():
+        os.environ[key] = str(value)
+    if os.environ['DMLC_ROLE'] == "server":
+        ht.server_init()
+        ht.server_finish()
+    elif os.environ['DMLC_ROLE'] == "worker":
+        ht.worker_init()
+        test(args)
+        ht.worker_finish()
+    elif os.environ['DMLC_ROLE'] == "scheduler":
+        ht.scheduler_init()
+        ht.scheduler_finish()
+    else:
+        raise ValueError("Unknown role", os.environ['DMLC_ROLE'])
+
+
+def signal_handler(signal, frame):
+    print("SIGINT signal caught, stop Training")
+    for proc in process_list:
+        proc.kill()
+    exit(0)
+
+
+def test(args):
+    # latency of small pulls, and bandwidth of large push-pulls
+    ctx = ht.cpu(0)
+    rank = int(os.environ["WORKER_ID"])
+    van = os.environ["DMLC_PS_VAN_TYPE"]
+    comm = ht.get_worker_communicate()
+    for name, length in enumerate([args.small_len, args.large_len]):
+        comm.InitTensor(name, ctypes.c_int(0), ctypes.c_int(length), ctypes.c_int(1), ctypes.c_int(0), ctypes.c_double(0), ctypes.c_double(0), ctypes.c_ulonglong(123),
+                        ctypes.c_int(0), (ctypes.c_float * 1)(0.1), ctypes.c_int(1), ctypes.c_int(0))
+    small = ht.array(np.zeros((args.small_len,)), ctx=ctx)
+    large_in = ht.array(np.ones((args.large_len,)), ctx=ctx)
+    large_out = ht.array(np.zeros((args.large_len,)), ctx=ctx)
+    comm.BarrierWorker()
+
+    latency = []
+    for _ in range(args.iters):
+        start = time.time()
+        comm.Pull(0, small.handle)
+        comm.Wait(0)
+        latency.append(time.time() - start)
+    latency = np.array(latency) * 1e6
+    comm.BarrierWorker()
+
+    start = time.time()
+    for _ in range(args.large_iters):
+        comm.DDPushPull(1, large_in.handle, large_out.handle, None)
+        comm.Wait(1)
+    bandwidth = args.large_iters * args.large_len * 4 * 2 / \
+        (time.time() - start) / 2 ** 20
+    print("{} worker {}: pull latency p50 {:.1f} us, p99 {:.1f} us, push-pull bandwidth {:.0f} MB/s".format(
+        van, rank, np.percentile(latency, 50), np.percentile(latency, 99), bandwidth))
+    comm.BarrierWorker()
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--config", default='./local_s1_w4.yml')
+    parser.add_argument("--vans", default='zmq,shm')
+    parser.add_argument("--small-len", type=int, default=16)
+    parser.add_argument("--large-len", type=int, default=1 << 20)
+    parser.add_argument("--iters", type=int, default=10000)
+    parser.add_argument("--large-iters", type=int, default=50)
+    args = parser.parse_args()
+    file_path = args.config
+    settings = yaml.load(open(file_path).read(), Loader=yaml.FullLoader)
+    signal.signal(signal.SIGINT, signal_handler)
+    for van in args.vans.split(','):
+        process_list = []
+        for key, value in settings.items():
+            if key != 'shared':
+                value = dict(value, DMLC_PS_VAN_TYPE=van)
+                proc = multiprocessing.Process(
+                    target=start_process, args=[value, args])
+                process_list.append(proc)
+                proc.start()
+        for proc in process_list:
+            proc.join()
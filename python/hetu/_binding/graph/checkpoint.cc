@@ -0,0 +1,57 @@
+#include "hetu/_binding/graph/checkpoint.h"
+#include "hetu/_binding/constants.h"
+#include "hetu/_binding/utils/pybind_common.h"
+#include "hetu/_binding/utils/except.h"
+#include "hetu/_binding/utils/decl_utils.h"
+#include "hetu/_binding/utils/arg_parser.h"
+
+namespace hetu {
+namespace graph {
+
+// Loads whole tensors from the safetensors files saved by all devices, see
+// CheckpointReader. The returned arrays are views of the mapped files unless
+// they are gathered from several shards. Only `names` found in the files are
+// loaded, or every tensor if `names` is not given.
+PyObject* PyLoadCheckpoint(PyObject*, PyObject* args, PyObject* kwargs) {
+  HT_PY_FUNC_BEGIN
+  static PyArgParser parser({
+    "load_checkpoint(List[str] paths, List[str] names=None, bool verify=false)",
+  });
+  auto parsed_args = parser.parse(args, kwargs);
+  if (parsed_args.signature_index() == 0) {
+    CheckpointReader reader(parsed_args.get_string_list(0));
+    HT_VALUE_ERROR_IF(parsed_args.get_bool_or_default(2) && !reader.Verify())
+      << "Checksums of the checkpoint mismatch";
+    auto names = parsed_args.has(1) ? parsed_args.get_string_list(1)
+                                     : reader.names();
+    PyObject* ret = PyDict_New();
+    HT_RUNTIME_ERROR_IF(!ret) << "Failed to alloc dict";
+    for (const auto& name : names) {
+      if (!reader.has(name))
+        continue;
+      PyObject* array = PyNDArray_New(reader.Load(name));
+      HT_RUNTIME_ERROR_IF(PyDict_SetItemString(ret, name.c_str(), array) != 0)
+        << "Failed to insert " << name;
+      Py_DECREF(array);
+    }
+    return ret;
+  } else {
+    HT_PY_PARSER_INCORRECT_SIGNATURE(parsed_args);
+    __builtin_unreachable();
+  }
+  HT_PY_FUNC_END
+}
+
+// NOLINTNEXTLINE
+PyMethodDef PyCheckpoint_methods[] = {
+  {"load_checkpoint", (PyCFunction) PyLoadCheckpoint, METH_VARARGS | METH_KEYWORDS, nullptr},
+  {nullptr}
+};
+
+void AddCheckpointFunctionsToModule(py::module_& m) {
+  HT_RUNTIME_ERROR_IF(0 != PyModule_AddFunctions(m.ptr(), PyCheckpoint_methods))
+    << "Failed to add checkpoint functions";
+}
+
+} // namespace graph
+} // namespace hetu
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <Python.h>
+#include "hetu/graph/checkpoint/checkpoint.h"
+#include "hetu/_binding/core/ndarray.h"
+#include "hetu/_binding/utils/pybind_common.h"
+
+namespace hetu {
+namespace graph {
+
+void AddCheckpointFunctionsToModule(py::module_&);
+
+} // namespace graph
+} // namespace hetu
@@ -38,8 +38,8 @@ inline PyObject* PyDataloader_pynew(PyTypeObject* type, PyObject* args,
   auto* self = reinterpret_cast<PyDataloader*>(unsafe_self);
 
   static PyArgParser parser({
-    "Dataloader(numpy.array raw_data, int batch_size, int num_workers=0, std::string name='default', bool shuffle=false, bool drop_last=true)", 
-    "Dataloader(NDArray raw_data, int batch_size, int num_workers=0, std::string name='default', bool shuffle=false, bool drop_last=true)", 
+    "Dataloader(numpy.array raw_data, int batch_size, int num_workers=0, std::string name='default', bool shuffle=false, bool drop_last=true, int queue_size=3)", 
+    "Dataloader(NDArray raw_data, int batch_size, int num_workers=0, std::string name='default', bool shuffle=false, bool drop_last=true, int queue_size=3)", 
   });
   auto parsed_args = parser.parse(args, kwargs);
   
@@ -54,7 +54,8 @@ inline PyObject* PyDataloader_pynew(PyTypeObject* type, PyObject* args,
                                   parsed_args.get_int64_or_default(2), 
                                   parsed_args.get_string_or_default(3), 
                                   parsed_args.get_bool_or_default(4), 
-                                  parsed_args.get_bool_or_default(5));
+                                  parsed_args.get_bool_or_default(5),
+                                  parsed_args.get_int64_or_default(6));
   } else if (parsed_args.signature_index() == 1) {
     new(&self->dataloader) Dataloader();
     self->dataloader = Dataloader(parsed_args.get_ndarray(0),
@@ -62,7 +63,8 @@ inline PyObject* PyDataloader_pynew(PyTypeObject* type, PyObject* args,
                                   parsed_args.get_int64_or_default(2), 
                                   parsed_args.get_string_or_default(3), 
                                   parsed_args.get_bool_or_default(4), 
-                                  parsed_args.get_bool_or_default(5));
+                                  parsed_args.get_bool_or_default(5),
+                                  parsed_args.get_int64_or_default(6));
   } else {
     Py_TYPE(self)->tp_free(self);
     HT_PY_PARSER_INCORRECT_SIGNATURE(parsed_args);
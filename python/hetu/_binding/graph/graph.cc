@@ -105,6 +105,62 @@ PyObject* PyGraph_merge_strategy(PyGraph* self, PyObject* args, PyObject* kwargs
   HT_PY_FUNC_END
 }
 
+PyObject* PyGraph_save_checkpoint_async(PyGraph* self, PyObject* args, PyObject* kwargs) {
+  HT_PY_FUNC_BEGIN
+  static PyArgParser parser({"save_checkpoint_async(str path, int max_host_bytes=0)"});
+  auto parsed_args = parser.parse(args, kwargs);
+  if (parsed_args.signature_index() == 0) {
+    auto& graph = Graph::GetGraph(self->graph_id);
+    HT_ASSERT(graph.type() == GraphType::DEFINE_AND_RUN)
+      << "Currently only support saving checkpoint of define graph";
+    dynamic_cast<DefineAndRunGraph&>(graph).SaveCheckpointAsync(
+      parsed_args.get_string(0), parsed_args.get_int64_or_default(1));
+    Py_RETURN_NONE;
+  } else {
+    HT_PY_PARSER_INCORRECT_SIGNATURE(parsed_args);
+    __builtin_unreachable();
+  }
+  HT_PY_FUNC_END
+}
+
+PyObject* PyGraph_wait_checkpoint(PyGraph* self) {
+  HT_PY_FUNC_BEGIN
+  auto& graph = Graph::GetGraph(self->graph_id);
+  HT_ASSERT(graph.type() == GraphType::DEFINE_AND_RUN)
+    << "Currently only support saving checkpoint of define graph";
+  dynamic_cast<DefineAndRunGraph&>(graph).WaitCheckpoint();
+  Py_RETURN_NONE;
+  HT_PY_FUNC_END
+}
+
+PyObject* PyGraph_num_exec_plans(PyGraph* self) {
+  HT_PY_FUNC_BEGIN
+  auto& graph = Graph::GetGraph(self->graph_id);
+  HT_ASSERT(graph.type() == GraphType::DEFINE_AND_RUN)
+    << "Only define graphs have exec plans";
+  return PyLong_FromSize_t(
+    dynamic_cast<DefineAndRunGraph&>(graph).num_exec_plans());
+  HT_PY_FUNC_END
+}
+
+PyObject* PyGraph_num_shape_plans(PyGraph* self, PyObject* args, PyObject* kwargs) {
+  HT_PY_FUNC_BEGIN
+  static PyArgParser parser({"num_shape_plans(int exec_plan)"});
+  auto parsed_args = parser.parse(args, kwargs);
+  if (parsed_args.signature_index() == 0) {
+    auto& graph = Graph::GetGraph(self->graph_id);
+    HT_ASSERT(graph.type() == GraphType::DEFINE_AND_RUN)
+      << "Only define graphs have exec plans";
+    return PyLong_FromSize_t(dynamic_cast<DefineAndRunGraph&>(graph)
+                               .GetPlan(parsed_args.get_int64(0))
+                               .shape_plan_pool.size());
+  } else {
+    HT_PY_PARSER_INCORRECT_SIGNATURE(parsed_args);
+    __builtin_unreachable();
+  }
+  HT_PY_FUNC_END
+}
+
 PyObject* PyGraph_run(PyGraph* self, PyObject* args, PyObject* kwargs) {
   HT_PY_FUNC_BEGIN
   static PyArgParser parser({
@@ -323,7 +379,11 @@ PyGetSetDef PyGraph_properties[] = {
 PyMethodDef PyGraph_methods[] = {
   {"run", (PyCFunction) PyGraph_run, METH_VARARGS | METH_KEYWORDS, nullptr }, 
   {"set_num_strategy", (PyCFunction) PyGraph_set_num_strategy, METH_VARARGS | METH_KEYWORDS, nullptr },
-  {"merge_strategy", (PyCFunction) PyGraph_merge_strategy, METH_VARARGS | METH_KEYWORDS, nullptr },  
+  {"merge_strategy", (PyCFunction) PyGraph_merge_strategy, METH_VARARGS | METH_KEYWORDS, nullptr },
+  {"save_checkpoint_async", (PyCFunction) PyGraph_save_checkpoint_async, METH_VARARGS | METH_KEYWORDS, nullptr },
+  {"wait_checkpoint", (PyCFunction) PyGraph_wait_checkpoint, METH_NOARGS, nullptr },  
+  {"num_exec_plans", (PyCFunction) PyGraph_num_exec_plans, METH_NOARGS, nullptr },
+  {"num_shape_plans", (PyCFunction) PyGraph_num_shape_plans, METH_VARARGS | METH_KEYWORDS, nullptr },
   {nullptr}
 };
 
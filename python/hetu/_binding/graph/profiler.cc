@@ -179,6 +179,15 @@ PyObject* PyProfileSummary(PyProfile* self, PyObject* args, PyObject* kwargs) {
       PyDict_SetItemString(py_dict, "optype_with_inputs_view", py_list_optype_with_inputs_view);
       Py_DECREF(py_list_optype_with_inputs_view);
     }
+    PyObject* py_dict_dnnl_cache_view = PyDict_New();
+    for (auto& record : profiler->get_dnnl_primitive_cache_view()) {
+      PyObject* value = PyLong_FromUnsignedLongLong(record.second);
+      PyDict_SetItemString(py_dict_dnnl_cache_view, record.first.c_str(), value);
+      Py_DECREF(value);
+    }
+    PyDict_SetItemString(py_dict, "dnnl_primitive_cache_view", py_dict_dnnl_cache_view);
+    Py_DECREF(py_dict_dnnl_cache_view);
+
     auto graph_view = profiler->get_graph_view();
     if (graph_view.size() == 0)
       return py_dict;
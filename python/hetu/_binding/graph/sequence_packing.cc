@@ -0,0 +1,112 @@
+#include "hetu/_binding/graph/sequence_packing.h"
+#include "hetu/_binding/constants.h"
+#include "hetu/_binding/utils/pybind_common.h"
+#include "hetu/_binding/utils/except.h"
+#include "hetu/_binding/utils/decl_utils.h"
+#include "hetu/_binding/utils/arg_parser.h"
+
+namespace hetu {
+namespace graph {
+
+namespace {
+
+// The returned numpy arrays share memory with the packed arrays.
+PyObject* NumpyList_FromNDArrayList(const NDArrayList& arrays) {
+  PyObject* ret = PyList_New(arrays.size());
+  HT_RUNTIME_ERROR_IF(!ret) << "Failed to alloc list";
+  for (size_t i = 0; i < arrays.size(); i++)
+    PyList_SET_ITEM(ret, i, NDArrayToNumpy(arrays[i], false));
+  return ret;
+}
+
+} // namespace
+
+PyObject* PyPackSequences(PyObject*, PyObject* args, PyObject* kwargs) {
+  HT_PY_FUNC_BEGIN
+  static PyArgParser parser({
+    "pack_sequences(List[numpy.array] seqs, int max_seqlen, int pad_token, int alignment=1, bool static_shape=false, numpy.array batching_option_matrix=None)",
+  });
+  auto parsed_args = parser.parse(args, kwargs);
+  if (parsed_args.signature_index() == 0) {
+    NDArrayList seqs = parsed_args.get_numpy_array_list(0);
+    HT_VALUE_ERROR_IF(seqs.empty()) << "No sequences to pack";
+    std::vector<int64_t> seqlens;
+    for (const auto& seq : seqs)
+      seqlens.push_back(seq->numel());
+    auto* option_matrix = parsed_args.get_numpy_array_optional(5);
+    PackingPlan plan = option_matrix != nullptr
+      ? PlanWithOptionMatrix(seqlens, NDArrayFromNumpy(option_matrix),
+                             parsed_args.get_int64_or_default(3))
+      : PlanFirstFitDecreasing(seqlens, parsed_args.get_int64(1),
+                               parsed_args.get_int64_or_default(3),
+                               parsed_args.get_bool_or_default(4));
+    auto packed = NDArray::empty({plan.num_tokens()}, Device(kCPU),
+                                 seqs.front()->dtype(), kBlockingStream);
+    auto cu_seqlens = NDArray::empty(
+      {plan.num_seqs() + static_cast<int64_t>(plan.num_micro_batches())},
+      Device(kCPU), kInt32, kBlockingStream);
+    PackSequences(seqs, plan, parsed_args.get_int64(2), packed, cu_seqlens);
+    return Py_BuildValue(
+      "(NN)", NumpyList_FromNDArrayList(SplitPackedMicroBatches(plan, packed)),
+      NumpyList_FromNDArrayList(SplitPackedCuSeqlens(plan, cu_seqlens)));
+  } else {
+    HT_PY_PARSER_INCORRECT_SIGNATURE(parsed_args);
+    __builtin_unreachable();
+  }
+  HT_PY_FUNC_END
+}
+
+PyObject* PyBucketAndPackGlobalBatch(PyObject*, PyObject* args,
+                                     PyObject* kwargs) {
+  HT_PY_FUNC_BEGIN
+  static PyArgParser parser({
+    "bucket_and_pack_global_batch(numpy.array global_batch, int pad_token, List[int] bucket_sizes, int alignment=128, bool static_shape=false)",
+  });
+  auto parsed_args = parser.parse(args, kwargs);
+  if (parsed_args.signature_index() == 0) {
+    auto buckets = BucketAndPackGlobalBatch(
+      NDArrayFromNumpy(parsed_args.get_numpy_array(0)),
+      parsed_args.get_int64(1), parsed_args.get_int64_list(2),
+      parsed_args.get_int64_or_default(3), parsed_args.get_bool_or_default(4));
+    PyObject* ret = PyList_New(buckets.size());
+    HT_RUNTIME_ERROR_IF(!ret) << "Failed to alloc list";
+    for (size_t k = 0; k < buckets.size(); k++) {
+      const auto& bucket = buckets[k];
+      PyObject* rows = PyList_New(bucket.rows.size());
+      HT_RUNTIME_ERROR_IF(!rows) << "Failed to alloc list";
+      for (size_t i = 0; i < bucket.rows.size(); i++)
+        PyList_SET_ITEM(rows, i, PyLong_FromLongLong(bucket.rows[i]));
+      PyList_SET_ITEM(
+        ret, k,
+        Py_BuildValue(
+          "(LLNNNN)", static_cast<long long>(bucket.max_seqlen),
+          static_cast<long long>(bucket.min_seqlen), rows,
+          NumpyList_FromNDArrayList(
+            SplitPackedMicroBatches(bucket.plan, bucket.input)),
+          NumpyList_FromNDArrayList(
+            SplitPackedMicroBatches(bucket.plan, bucket.label)),
+          NumpyList_FromNDArrayList(
+            SplitPackedCuSeqlens(bucket.plan, bucket.cu_seqlens))));
+    }
+    return ret;
+  } else {
+    HT_PY_PARSER_INCORRECT_SIGNATURE(parsed_args);
+    __builtin_unreachable();
+  }
+  HT_PY_FUNC_END
+}
+
+// NOLINTNEXTLINE
+PyMethodDef PySequencePacking_methods[] = {
+  {"pack_sequences", (PyCFunction) PyPackSequences, METH_VARARGS | METH_KEYWORDS, nullptr},
+  {"bucket_and_pack_global_batch", (PyCFunction) PyBucketAndPackGlobalBatch, METH_VARARGS | METH_KEYWORDS, nullptr},
+  {nullptr}
+};
+
+void AddSequencePackingFunctionsToModule(py::module_& m) {
+  HT_RUNTIME_ERROR_IF(0 != PyModule_AddFunctions(m.ptr(), PySequencePacking_methods))
+    << "Failed to add sequence packing functions";
+}
+
+} // namespace graph
+} // namespace hetu
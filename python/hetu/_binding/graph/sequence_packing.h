@@ -0,0 +1,15 @@
+#pragma once
+
+#include <Python.h>
+#include "hetu/graph/data/sequence_packing.h"
+#include "hetu/_binding/core/ndarray.h"
+#include "hetu/_binding/utils/numpy.h"
+#include "hetu/_binding/utils/pybind_common.h"
+
+namespace hetu {
+namespace graph {
+
+void AddSequencePackingFunctionsToModule(py::module_&);
+
+} // namespace graph
+} // namespace hetu
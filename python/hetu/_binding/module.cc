@@ -18,6 +18,8 @@
 #include "hetu/_binding/graph/subgraph.h"
 #include "hetu/_binding/graph/adamoptimizer.h"
 #include "hetu/_binding/graph/dataloader.h"
+#include "hetu/_binding/graph/sequence_packing.h"
+#include "hetu/_binding/graph/checkpoint.h"
 #include "hetu/_binding/graph/init/initializer.h"
 #include "hetu/_binding/distributed/comm_group.h"
 #include "hetu/_binding/graph/profiler.h"
@@ -41,6 +43,8 @@ PYBIND11_MODULE(HT_CORE_PY_MODULE, m) {
   hetu::graph::AddPySubGraphTypeToModule(m);
   hetu::graph::AddPyAdamOptimizerTypeToModule(m);
   hetu::graph::AddPyDataloaderTypeToModule(m);
+  hetu::graph::AddSequencePackingFunctionsToModule(m);
+  hetu::graph::AddCheckpointFunctionsToModule(m);
   hetu::graph::AddPyInitializerTypeToModule(m);
   auto internal_sub_module = m.def_submodule("_internal_context");
   hetu::graph::AddOpContextManagingFunctionsToModule(internal_sub_module);
@@ -181,8 +181,10 @@ NDArray NDArrayFromNumpy(PyObject* obj, const HTShape& dynamic_shape, DataType d
                         : meta.numel() * element_size;
   auto storage = std::make_shared<NDArrayStorage>(BorrowToMemoryPool(
     Device(kCPU), ptr, borrow_size, [obj](DataPtr ptr) {
-      py::call_guard<py::gil_scoped_acquire>();
-      // py::gil_scoped_acquire gil;
+      // The storage may be released by a stream worker without the GIL.
+      if (!Py_IsInitialized())
+        return;
+      py::gil_scoped_acquire gil;
       Py_DECREF(obj);
     }));
 
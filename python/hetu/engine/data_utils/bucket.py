@@ -1,3 +1,4 @@
+import hetu
 import numpy as np
 from typing import List
 
@@ -38,58 +39,26 @@ class Bucket:
 
     # 已经默认batch中的数据按照从短到长排序
     def pack_data(self, batching_option_matrix, static_shape: bool):
-        packed_batch = []
-        packed_cu_seqlens_list = []
+        assert len(self._batch) > 0, "currently not support no data after packing"
         # 负载均衡的packing策略
         # batching_option_matrix的第i行第j列表示是否将第i个seq放入第j个micro batch
         if isinstance(batching_option_matrix, np.ndarray):
             assert len(batching_option_matrix.shape) == 2, f"{batching_option_matrix} is not a 2 dim matrix"
-            for micro_batch_id in range(batching_option_matrix.shape[1]):
-                packed_seqs = []
-                cur_cu_seqlen = 0
-                cu_seqlens = [0]
-                for seq_id in range(batching_option_matrix.shape[0]):
-                    if batching_option_matrix[seq_id][micro_batch_id]:
-                        packed_seqs.append(self._batch[seq_id])
-                        cur_cu_seqlen += len(self._batch[seq_id])
-                        cu_seqlens.append(cur_cu_seqlen)
-                # pad to the nearest number that the sequence parallel degree can divide evenly
-                if cur_cu_seqlen % self._alignment != 0:
-                    pad_seqlen = self._alignment - (cur_cu_seqlen % self._alignment) 
-                    packed_seqs.append(np.array([self._pad_token] * pad_seqlen))
-                packed_batch.append(np.concatenate(packed_seqs))
-                packed_cu_seqlens_list.append(np.array(cu_seqlens, dtype=np.int32))   
-        # 简单的贪心packing策略
+            packed_batch, packed_cu_seqlens_list = hetu.pack_sequences(
+                self._batch, int(self._max_seqlen), int(self._pad_token), int(self._alignment),
+                batching_option_matrix=np.ascontiguousarray(batching_option_matrix != 0))
+        # first-fit decreasing packing
+        # static shape开关表示是否支持每个micro batch的shape都动态
         else:
-            # static shape开关表示是否支持每个micro batch的shape都动态
-            is_visited = set()
-            for i in range(len(self._batch)):
-                if i in is_visited:
-                    continue
-                packed_seqs = [self._batch[i]]
-                cur_cu_seqlen = len(self._batch[i])
-                cu_seqlens = [0, cur_cu_seqlen]
-                is_visited.add(i)
-                for j in reversed(range(i + 1, len(self._batch))):
-                    if j not in is_visited and cur_cu_seqlen + len(self._batch[j]) <= self._max_seqlen:
-                        packed_seqs.append(self._batch[j])
-                        cur_cu_seqlen += len(self._batch[j])
-                        cu_seqlens.append(cur_cu_seqlen)
-                        is_visited.add(j)
-                # already support multi shape micro batch
-                if static_shape:
-                    # pad to max_seqlen
-                    if cur_cu_seqlen < self._max_seqlen:
-                        packed_seqs.append(np.array([self._pad_token] * (self._max_seqlen - cur_cu_seqlen)))
-                else:
-                    # pad to the nearest number that the sequence parallel degree can divide evenly
-                    if cur_cu_seqlen % self._alignment != 0:
-                        pad_seqlen = self._alignment - (cur_cu_seqlen % self._alignment) 
-                        packed_seqs.append(np.array([self._pad_token] * pad_seqlen))
-                        # cu_seqlens[-1] += pad_seqlen
-                packed_batch.append(np.concatenate(packed_seqs))
-                packed_cu_seqlens_list.append(np.array(cu_seqlens, dtype=np.int32))
-        assert len(packed_batch) > 0, "currently not support no data after packing"
+            packed_batch, packed_cu_seqlens_list = hetu.pack_sequences(
+                self._batch, int(self._max_seqlen), int(self._pad_token), int(self._alignment),
+                static_shape)
+        self._packed_batch = packed_batch
+        self._packed_cu_seqlens_list = packed_cu_seqlens_list
+
+    def set_packed_data(self, batch, packed_batch, packed_cu_seqlens_list):
+        self._batch = batch
+        self._cu_seqlens_list = [np.array([0, len(seq)], dtype=np.int32) for seq in batch]
         self._packed_batch = packed_batch
         self._packed_cu_seqlens_list = packed_cu_seqlens_list
 
@@ -184,10 +153,18 @@ def get_input_and_label_buckets(global_batch: np.ndarray, pad_token: int, bucket
 
     return buckets
 
-def sort_and_pack_for_global_batch(global_batch, pad_token, bucket_sizes=[32768, 16384, 4096, 0], static=True):
-    buckets = get_input_and_label_buckets(global_batch, pad_token, bucket_sizes) # [(input_bucket, label_bucket), ...]
-    for (input_bucket, label_bucket) in buckets:
-        input_bucket.pack_data(batching_option_matrix=None, static_shape=static)
-        label_bucket.pack_data(batching_option_matrix=None, static_shape=static)
-
-    return buckets
\ No newline at end of file
+def sort_and_pack_for_global_batch(global_batch, pad_token, bucket_sizes=[32768, 16384, 4096, 0], static=True, alignment=128):
+    # bucketed and packed by the native engine, in parallel across buckets
+    global_batch = np.ascontiguousarray(global_batch)
+    seqlens = np.sum(global_batch != pad_token, axis=1) - 1
+    buckets = []
+    for max_seqlen, min_seqlen, rows, inputs, labels, cu_seqlens_list in hetu.bucket_and_pack_global_batch(
+        global_batch, int(pad_token), [int(size) for size in bucket_sizes], alignment, static):
+        input_bucket = Bucket(pad_token, max_seqlen, min_seqlen, alignment)
+        label_bucket = Bucket(pad_token, max_seqlen, min_seqlen, alignment)
+        input_bucket.set_packed_data([global_batch[row][:seqlens[row]] for row in rows],
+                                     inputs, cu_seqlens_list)
+        label_bucket.set_packed_data([global_batch[row][1:seqlens[row] + 1] for row in rows],
+                                     labels, cu_seqlens_list)
+        buckets.append((input_bucket, label_bucket))
+    return buckets
@@ -642,18 +642,10 @@ def load_model(model: hetu.nn.Module, filename: Union[str, os.PathLike],
         if (WEIGHTS_NAME in file and WEIGHTS_FORMAT in file):
             archive_files.append(file)
 
-    archive_opens = []
-    archive_keys = []
-    ptr = 0
     archive_files.sort()
-    for archive in archive_files:
-        archive_opens.append(safe_open(os.path.join(
-        filename, archive), framework="np"))
-        archive_keys.append(archive_opens[ptr].keys())
-        ptr += 1
+    archive_paths = [os.path.join(filename, archive) for archive in archive_files]
     
-    state_dict = {}
-    ac_idx = -1 
+    local_keys = []
     for k in local_state_dict:
         param = hetu_state_dict[k]
         parameter_to_dtype[k] = param.dtype
@@ -663,10 +655,11 @@ def load_model(model: hetu.nn.Module, filename: Union[str, os.PathLike],
         # TODO: implement allgather_inter_group_param()
         if not device_group.contains(local_device):
             continue
-        for i, archive in enumerate(archive_keys):
-            if k in archive_keys[i]:
-                state_dict[k] = hetu.numpy_to_NDArray(archive_opens[i].get_tensor(k), parameter_to_dtype[k])
-                # break
+        local_keys.append(k)
+    # 由native的CheckpointReader直接mmap读取, 不经过numpy拷贝
+    state_dict = {}
+    for k, value in hetu.load_checkpoint(archive_paths, local_keys).items():
+        state_dict[k] = value.to(parameter_to_dtype[k])
         # if ac_idx == 0:
         #     for i, archive in enumerate(archive_opens):
         #         if k in archive_keys[i]:
@@ -1266,37 +1259,25 @@ def save_file(
     save_ed = time.time()
     print('Safetensors_Save_Time = %.4f'%(save_ed - save_st))
 
-def load_file(filename: Union[str, os.PathLike], parameter_to_dtype, device="cpu") -> Dict[str, torch.Tensor]:
+def load_file(filename: Union[str, os.PathLike], parameter_to_dtype, device="cpu") -> Dict[str, hetu.NDArray]:
     """
-    Loads a safetensors file into torch format.
+    Loads a safetensors file into hetu NDArrays, through the memory-mapped
+    native checkpoint reader.
 
     Args:
         filename (`str`, or `os.PathLike`):
             The name of the file which contains the tensors
-        device (`Dict[str, any]`, *optional*, defaults to `cpu`):
-            The device where the tensors need to be located after load.
-            available options are all regular torch device locations
+        parameter_to_dtype (`Dict[str, hetu.dtype]`):
+            The tensors to load, and the dtypes to convert them to.
+        device (`str`, *optional*, defaults to `cpu`):
+            Unused, the tensors are loaded on the CPU.
 
     Returns:
-        `Dict[str, torch.Tensor]`: dictionary that contains name as key, value as `torch.Tensor`
-
-    Example:
-
-    ```python
-    from safetensors.torch import load_file
-
-    file_path = "./my_folder/bert.safetensors"
-    loaded = load_file(file_path)
-    ```
+        `Dict[str, hetu.NDArray]`: dictionary that contains name as key, value as `hetu.NDArray`
     """
     result = {}
-    with safe_open(filename, framework="np") as f:
-        for k in f.keys():
-            # print(f.get_tensor(k))
-            if (k in parameter_to_dtype):
-                # print(parameter_to_dtype[k])
-                # print("load:", k, f.get_tensor(k).dtype, parameter_to_dtype[k], f.get_tensor(k).flatten()[:10])
-                result[k] = hetu.numpy_to_NDArray(f.get_tensor(k), parameter_to_dtype[k])
+    for k, value in hetu.load_checkpoint([os.fspath(filename)], list(parameter_to_dtype.keys())).items():
+        result[k] = value.to(parameter_to_dtype[k])
     return result
 
 
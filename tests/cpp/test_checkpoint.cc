@@ -0,0 +1,302 @@
+#include "hetu/graph/checkpoint/checkpoint.h"
+#include "test_utils.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <thread>
+#include <unistd.h>
+
+using namespace hetu;
+using namespace hetu::graph;
+
+std::string TempPath(const std::string& name) {
+  return "/tmp/hetu_test_checkpoint_" + std::to_string(getpid()) + "_" + name +
+    ".safetensors";
+}
+
+// Element i of the global tensor is i.
+template <typename T>
+NDArray Iota(const HTShape& shape, DataType dtype, int64_t start = 0) {
+  auto ret = NDArray::empty(shape, Device(kCPU), dtype, kBlockingStream);
+  T* data = ret->data_ptr<T>();
+  for (int64_t i = 0; i < ret->numel(); i++)
+    data[i] = static_cast<T>(start + i);
+  return ret;
+}
+
+// The region of an iota tensor of `global_shape`.
+NDArray IotaRegion(const HTShape& global_shape, const ShardRegion& region) {
+  auto ret =
+    NDArray::empty(region.shape, Device(kCPU), kFloat32, kBlockingStream);
+  auto global_stride = Shape2Stride(global_shape);
+  auto stride = Shape2Stride(region.shape);
+  float* data = ret->data_ptr<float>();
+  for (int64_t i = 0; i < ret->numel(); i++) {
+    int64_t global = 0, rest = i;
+    for (size_t d = 0; d < region.shape.size(); d++) {
+      global += (region.begin[d] + rest / stride[d]) * global_stride[d];
+      rest %= stride[d];
+    }
+    data[i] = static_cast<float>(global);
+  }
+  return ret;
+}
+
+template <typename T>
+void CheckEqual(const NDArray& lhs, const NDArray& rhs) {
+  HT_ASSERT(lhs->shape() == rhs->shape())
+    << "Mismatched shapes " << lhs->shape() << " and " << rhs->shape();
+  HT_ASSERT_EQ(lhs->dtype(), rhs->dtype());
+  for (int64_t i = 0; i < lhs->numel(); i++)
+    HT_ASSERT(lhs->data_ptr<T>()[i] == rhs->data_ptr<T>()[i])
+      << "Mismatched element " << i;
+}
+
+void TestCrc32c() {
+  HT_LOG_INFO << "Testing CRC-32C...";
+  // the check value of CRC-32C
+  HT_ASSERT_EQ(Crc32c("123456789", 9), 0xE3069283u);
+  std::string text = "The quick brown fox jumps over the lazy dog";
+  HT_ASSERT_EQ(Crc32c(text.data() + 10, text.size() - 10,
+                      Crc32c(text.data(), 10)),
+               Crc32c(text.data(), text.size()));
+}
+
+void TestRoundTrip(bool direct_io) {
+  HT_LOG_INFO << "Testing checkpoint round trip with direct IO = "
+              << direct_io << "...";
+  auto path = TempPath("round_trip");
+  auto weight = Iota<float>({33, 17}, kFloat32);
+  auto bias = Iota<bfloat16>({17}, kBFloat16, 5);
+  auto step = Iota<int64_t>({}, kInt64, 42);
+  auto empty = NDArray::empty({0, 4}, Device(kCPU), kFloat32, kBlockingStream);
+  auto expected_weight = NDArray::copy(weight);
+  {
+    // small chunks to cover tensors across chunks
+    CheckpointWriter writer(direct_io ? 4096 : 100, direct_io);
+    auto future =
+      writer.Save(path,
+                  {{"weight", weight}, {"bias", bias}, {"step", step},
+                   {"empty", empty}},
+                  {{"format", "pt"}});
+    // the snapshot is taken, so updates do not go into the checkpoint
+    weight->data_ptr<float>()[0] = -1;
+    future.get();
+    writer.Wait();
+  }
+  SafetensorsFile file(path);
+  HT_ASSERT_EQ(file.names().size(), 4);
+  HT_ASSERT_EQ(file.metadata().at("format"), "pt");
+  HT_ASSERT(file.Verify()) << "Checksums mismatch";
+  CheckEqual<float>(file.Get("weight"), expected_weight);
+  CheckEqual<bfloat16>(file.Get("bias"), bias);
+  CheckEqual<int64_t>(file.Get("step"), step);
+  HT_ASSERT(file.Get("empty")->shape() == HTShape({0, 4}));
+  // whole tensors view the mapping, which outlives the reader
+  NDArray view;
+  {
+    CheckpointReader reader({path});
+    view = reader.Load("weight");
+    HT_ASSERT(view->raw_data_ptr() == reader.Load("weight")->raw_data_ptr())
+      << "Saved regions should not be copied";
+  }
+  CheckEqual<float>(view, expected_weight);
+  std::remove(path.c_str());
+}
+
+void TestChecksumMismatch() {
+  HT_LOG_INFO << "Testing checksums of a corrupted checkpoint...";
+  auto path = TempPath("corrupted");
+  {
+    CheckpointWriter writer(256);
+    writer.Save(path, {{"weight", Iota<float>({1000}, kFloat32)}});
+  }
+  HT_ASSERT(SafetensorsFile(path).Verify()) << "Checksums mismatch";
+  {
+    std::fstream io(path, std::ios::in | std::ios::out | std::ios::binary);
+    io.seekp(-10, std::ios::end);
+    io.put('\x7f');
+  }
+  HT_ASSERT(!SafetensorsFile(path).Verify())
+    << "Corruption is not detected";
+  std::remove(path.c_str());
+}
+
+void TestReshard() {
+  HT_LOG_INFO << "Testing resharding of a checkpoint...";
+  const HTShape global_shape = {8, 6};
+  // saved by 4 devices with dim 0 split into 2 and duplicated twice
+  DistributedStates saved_ds(4, {{-1, 2}, {0, 2}}, {0, -1});
+  std::vector<std::string> paths;
+  {
+    CheckpointWriter writer;
+    for (int32_t device = 0; device < 4; device++) {
+      auto region = GetShardRegion(global_shape, saved_ds, device);
+      paths.push_back(TempPath("reshard_" + std::to_string(device)));
+      writer.Save(paths.back(),
+                  {{"weight", IotaRegion(global_shape, region), saved_ds,
+                    device}});
+    }
+    writer.Wait();
+  }
+  CheckpointReader reader(paths);
+  HT_ASSERT(reader.global_shape("weight") == global_shape);
+  HT_ASSERT(reader.Verify()) << "Checksums mismatch";
+  CheckEqual<float>(reader.Load("weight"),
+                    IotaRegion(global_shape, {{0, 0}, global_shape}));
+  // the same states view the saved shards
+  for (int32_t device = 0; device < 4; device++) {
+    auto shard = reader.Load("weight", saved_ds, device);
+    CheckEqual<float>(
+      shard,
+      IotaRegion(global_shape, GetShardRegion(global_shape, saved_ds, device)));
+  }
+  // loaded by 6 devices with dim 0 split into 2 and dim 1 split into 3
+  DistributedStates loaded_ds(6, {{0, 2}, {1, 3}}, {1, 0});
+  for (int32_t device = 0; device < 6; device++) {
+    auto region = GetShardRegion(global_shape, loaded_ds, device);
+    HT_ASSERT(region.shape == HTShape({4, 2}));
+    CheckEqual<float>(reader.Load("weight", loaded_ds, device),
+                      IotaRegion(global_shape, region));
+  }
+  for (const auto& path : paths)
+    std::remove(path.c_str());
+}
+
+void TestHostBudget() {
+  HT_LOG_INFO << "Testing host memory budget of pending saves...";
+  auto first_path = TempPath("budget_0"), second_path = TempPath("budget_1");
+  auto weight = Iota<float>({1000}, kFloat32);
+  size_t num_bytes = weight->numel() * sizeof(float);
+  CheckpointWriter writer(1 << 20, false, num_bytes);
+  // the first snapshot is not ready until the gate opens
+  std::promise<void> gate;
+  auto gate_future = gate.get_future().share();
+  writer.ReserveHostBytes(num_bytes);
+  auto first = writer.SaveSnapshot(first_path, {{"weight", weight}}, {},
+                                   [gate_future]() { gate_future.wait(); });
+  HT_ASSERT_EQ(writer.host_bytes_in_flight(), num_bytes);
+  std::atomic<bool> second_saved{false};
+  auto saver = std::async(std::launch::async, [&]() {
+    writer.Save(second_path, {{"weight", weight}});
+    second_saved = true;
+  });
+  std::this_thread::sleep_for(std::chrono::milliseconds(100));
+  HT_ASSERT(!second_saved) << "The second save should wait for the budget";
+  gate.set_value();
+  saver.get();
+  writer.Wait();
+  HT_ASSERT_EQ(writer.host_bytes_in_flight(), 0);
+  for (const auto& path : {first_path, second_path}) {
+    SafetensorsFile file(path);
+    HT_ASSERT(file.Verify()) << "Checksums mismatch";
+    CheckEqual<float>(file.Get("weight"), weight);
+    std::remove(path.c_str());
+  }
+
+  // failed saves release their reservations as well
+  writer.ReserveHostBytes(num_bytes);
+  writer.SaveSnapshot(first_path, {{"weight", weight}}, {}, []() {
+    HT_RUNTIME_ERROR << "Snapshot failed";
+  });
+  bool caught = false;
+  try {
+    writer.Wait();
+  } catch (const std::exception&) {
+    caught = true;
+  }
+  HT_ASSERT(caught) << "The error of the save is not rethrown";
+  HT_ASSERT_EQ(writer.host_bytes_in_flight(), 0);
+  HT_ASSERT(access(first_path.c_str(), F_OK) != 0)
+    << "Failed saves should not leave files";
+}
+
+void TestMappingsReleased() {
+  HT_LOG_INFO << "Testing release of checkpoint mappings...";
+  const HTShape global_shape = {8, 6};
+  DistributedStates saved_ds(2, {{0, 2}}, {0});
+  std::vector<std::string> paths;
+  {
+    CheckpointWriter writer;
+    for (int32_t device = 0; device < 2; device++) {
+      auto region = GetShardRegion(global_shape, saved_ds, device);
+      paths.push_back(TempPath("release_" + std::to_string(device)));
+      writer.Save(paths.back(),
+                  {{"weight", IotaRegion(global_shape, region), saved_ds,
+                    device}});
+    }
+    writer.Wait();
+  }
+  // loading twice leaves no mappings of the first load behind
+  for (int round = 0; round < 2; round++) {
+    NDArray view;
+    {
+      CheckpointReader reader(paths);
+      for (const auto& path : paths)
+        HT_ASSERT_GT(num_mappings(path), 0);
+      HT_ASSERT_EQ(reader.dtype("weight"), kFloat32);
+      CheckEqual<float>(reader.Load("weight"),
+                        IotaRegion(global_shape, {{0, 0}, global_shape}));
+      view = reader.Load("weight", saved_ds, 1);
+    }
+    // the view keeps its file mapped after the reader is gone
+    SynchronizeAllStreams(Device(kCPU));
+    HT_ASSERT_EQ(num_mappings(paths[0]), 0)
+      << "Mappings of the reader are not released";
+    HT_ASSERT_GT(num_mappings(paths[1]), 0);
+    CheckEqual<float>(
+      view,
+      IotaRegion(global_shape, GetShardRegion(global_shape, saved_ds, 1)));
+    view = NDArray();
+    SynchronizeAllStreams(Device(kCPU));
+    HT_ASSERT_EQ(num_mappings(paths[1]), 0)
+      << "Mappings of views are not released";
+  }
+  for (const auto& path : paths)
+    std::remove(path.c_str());
+}
+
+void BenchmarkCheckpoint(size_t num_bytes = 256 << 20) {
+  int64_t numel = num_bytes / sizeof(float);
+  int64_t num_tensors = 16;
+  std::vector<CheckpointTensor> tensors;
+  for (int64_t i = 0; i < num_tensors; i++)
+    tensors.push_back({"weight_" + std::to_string(i),
+                       Iota<float>({numel / num_tensors}, kFloat32)});
+  for (bool direct_io : {false, true}) {
+    auto path = TempPath("bench");
+    CheckpointWriter writer(64 << 20, direct_io);
+    auto start = std::chrono::steady_clock::now();
+    auto future = writer.Save(path, tensors);
+    double snapshot_sec = std::chrono::duration<double>(
+                            std::chrono::steady_clock::now() - start)
+                            .count();
+    future.get();
+    double sec = std::chrono::duration<double>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+    start = std::chrono::steady_clock::now();
+    HT_ASSERT(SafetensorsFile(path).Verify()) << "Checksums mismatch";
+    double verify_sec = std::chrono::duration<double>(
+                          std::chrono::steady_clock::now() - start)
+                          .count();
+    HT_LOG_INFO << "Saved " << num_bytes / 1e6 << " MB with direct IO = "
+                << direct_io << " in " << sec * 1e3 << " ms ("
+                << num_bytes / sec / 1e9 << " GB/s), blocking for "
+                << snapshot_sec * 1e3 << " ms; verified in "
+                << verify_sec * 1e3 << " ms";
+    std::remove(path.c_str());
+  }
+}
+
+int main(int argc, char** argv) {
+  TestCrc32c();
+  TestRoundTrip(false);
+  TestRoundTrip(true);
+  TestChecksumMismatch();
+  TestReshard();
+  TestHostBudget();
+  TestMappingsReleased();
+  BenchmarkCheckpoint();
+  return 0;
+}
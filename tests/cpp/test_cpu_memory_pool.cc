@@ -0,0 +1,95 @@
+#include "hetu/impl/memory/CPUMemoryPool.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/core/ndarray.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+using namespace hetu;
+using namespace hetu::impl;
+
+void TestBorrowedDeleterFires() {
+  HT_LOG_INFO << "Testing deleters of borrowed data...";
+  CPUMemoryPool pool;
+  std::vector<char> buffer(4096);
+  int num_deleted = 0;
+  DataPtr data_ptr =
+    pool.BorrowDataSpace(buffer.data(), buffer.size(), [&](DataPtr ptr) {
+      HT_ASSERT_EQ(ptr.ptr, buffer.data());
+      num_deleted++;
+    });
+  HT_ASSERT_EQ(num_deleted, 0);
+  // Never used by any stream, so the deleter runs right away.
+  pool.FreeDataSpace(data_ptr);
+  HT_ASSERT_EQ(num_deleted, 1) << "Deleter of borrowed data did not fire";
+
+  // Used by a non-blocking stream, so the deleter runs on the join stream.
+  std::atomic<int> num_deleted_async{0};
+  Stream stream(Device(kCPU), 1);
+  data_ptr = pool.BorrowDataSpace(buffer.data(), buffer.size(),
+                                  [&](DataPtr) { num_deleted_async++; });
+  pool.MarkDataSpaceUsedByStream(data_ptr, stream);
+  pool.FreeDataSpace(data_ptr);
+  CPUStream(stream).Sync();
+  CPUStream(Stream(Device(kCPU), kJoinStream)).Sync();
+  HT_ASSERT_EQ(num_deleted_async.load(), 1)
+    << "Deleter of borrowed data used by streams did not fire";
+  HT_LOG_INFO << "Testing deleters of borrowed data done";
+}
+
+void TestBorrowedStorageReleased() {
+  HT_LOG_INFO << "Testing release of borrowed storages...";
+  std::vector<float> buffer(1024, 1.0f);
+  int num_deleted = 0;
+  {
+    auto storage = std::make_shared<NDArrayStorage>(BorrowToMemoryPool(
+      Device(kCPU), buffer.data(), buffer.size() * sizeof(float),
+      [&](DataPtr) { num_deleted++; }));
+    auto meta = NDArrayMeta()
+                  .set_dtype(kFloat32)
+                  .set_shape({static_cast<int64_t>(buffer.size())})
+                  .set_device(kCPU);
+    NDArray array(meta, storage);
+    HT_ASSERT_EQ(array->data_ptr<float>()[0], 1.0f);
+  }
+  HT_ASSERT_EQ(num_deleted, 1)
+    << "Borrowed storage was not released with its last NDArray";
+  HT_LOG_INFO << "Testing release of borrowed storages done";
+}
+
+// Usage by the allocation stream alone is not marked, but waiting for the
+// data, or using it on another stream, still covers the work enqueued on
+// the allocation stream.
+void TestUsageByAllocStream() {
+  HT_LOG_INFO << "Testing usage by the allocation stream...";
+  CPUMemoryPool pool;
+  Stream alloc_stream(Device(kCPU), kComputingStream);
+  Stream other_stream(Device(kCPU), kH2DStream);
+  for (bool used_by_other_stream : {false, true}) {
+    DataPtr data_ptr = pool.AllocDataSpace(4096, alloc_stream);
+    std::atomic<bool> done{false};
+    CPUStream(alloc_stream).EnqueueTask([&done]() {
+      std::this_thread::sleep_for(std::chrono::milliseconds(50));
+      done = true;
+    }, "Write");
+    pool.MarkDataSpaceUsedByStream(data_ptr, alloc_stream);
+    if (used_by_other_stream)
+      pool.MarkDataSpaceUsedByStream(data_ptr, other_stream);
+    pool.WaitDataSpace(data_ptr, false);
+    HT_ASSERT(done.load())
+      << "Waiting for data returned before its allocation stream used it "
+      << "(used by another stream: " << used_by_other_stream << ")";
+    pool.FreeDataSpace(data_ptr);
+  }
+  CPUStream(alloc_stream).Sync();
+  CPUStream(other_stream).Sync();
+  CPUStream(Stream(Device(kCPU), kJoinStream)).Sync();
+  HT_LOG_INFO << "Testing usage by the allocation stream done";
+}
+
+int main(int argc, char** argv) {
+  TestBorrowedDeleterFires();
+  TestUsageByAllocStream();
+  TestBorrowedStorageReleased();
+  return 0;
+}
@@ -0,0 +1,144 @@
+#include "hetu/impl/stream/CPUStream.h"
+#include "hetu/utils/task_queue.h"
+#include "hetu/utils/work_stealing_executor.h"
+#include <chrono>
+#include <vector>
+
+using namespace hetu;
+using namespace hetu::impl;
+
+constexpr size_t NUM_QUEUES = HT_NUM_STREAMS_PER_DEVICE - 1;
+
+void TestStreamOrder(size_t num_workers, size_t num_tasks = 10000) {
+  HT_LOG_INFO << "Testing stream order with " << num_workers
+              << " worker(s)...";
+  WorkStealingExecutor executor("test", num_workers, NUM_QUEUES);
+  std::vector<std::vector<size_t>> visited(NUM_QUEUES);
+  std::vector<std::future<void>> futures;
+  for (size_t i = 0; i < num_tasks; i++) {
+    size_t q = i % NUM_QUEUES;
+    futures.push_back(
+      executor.Enqueue(q, [&visited, q, i]() { visited[q].push_back(i); }));
+  }
+  for (auto& future : futures)
+    future.wait();
+  for (size_t q = 0; q < NUM_QUEUES; q++) {
+    for (size_t j = 1; j < visited[q].size(); j++)
+      HT_ASSERT_LT(visited[q][j - 1], visited[q][j])
+        << "Tasks of queue " << q << " are out of order";
+  }
+  HT_LOG_INFO << "Testing stream order with " << num_workers
+              << " worker(s) done";
+}
+
+void TestEventBlock() {
+  HT_LOG_INFO << "Testing CPUEvent Record/Block across streams...";
+  // With a single worker, a blocked stream that occupied the worker would
+  // never let the recording stream run.
+  WorkStealingExecutor executor("test", 1, 2);
+  std::atomic<int> step{0};
+  auto state = std::make_shared<CPUEventState>();
+  executor.EnqueueWait(1, state);
+  auto consumer = executor.Enqueue(1, [&step]() {
+    HT_ASSERT_EQ(step.load(), 1) << "Block did not wait for Record";
+    step = 2;
+  });
+  auto producer = executor.Enqueue(0, [&step, state]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    step = 1;
+    state->Complete(false);
+  });
+  producer.wait();
+  consumer.wait();
+  HT_ASSERT_EQ(step.load(), 2);
+
+  CPUEvent event;
+  std::atomic<int> value{0};
+  CPUStream(Stream(kCPU, kComputingStream)).EnqueueTask([&value]() {
+    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    value = 1;
+  });
+  event.Record(Stream(kCPU, kComputingStream));
+  event.Block(Stream(kCPU, kH2DStream));
+  CPUStream(Stream(kCPU, kH2DStream)).EnqueueTask([&value]() {
+    HT_ASSERT_EQ(value.load(), 1) << "Block did not wait for Record";
+    value = 2;
+  });
+  SynchronizeAllCPUStreams();
+  HT_ASSERT_EQ(value.load(), 2);
+  HT_LOG_INFO << "Testing CPUEvent Record/Block across streams done";
+}
+
+template <typename EnqueueFn, typename WaitFn>
+void RunBenchmark(const std::string& name, size_t num_producers,
+                  size_t num_tasks, EnqueueFn enqueue, WaitFn wait_all) {
+  std::atomic<uint64_t> enqueue_ns{0};
+  auto start = std::chrono::steady_clock::now();
+  std::vector<std::thread> producers;
+  for (size_t p = 0; p < num_producers; p++) {
+    producers.emplace_back([&, p]() {
+      uint64_t local_ns = 0;
+      for (size_t i = p; i < num_tasks; i += num_producers) {
+        auto t0 = std::chrono::steady_clock::now();
+        enqueue(i % NUM_QUEUES);
+        local_ns += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                      std::chrono::steady_clock::now() - t0)
+                      .count();
+      }
+      enqueue_ns += local_ns;
+    });
+  }
+  for (auto& producer : producers)
+    producer.join();
+  wait_all();
+  auto total_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    std::chrono::steady_clock::now() - start)
+                    .count();
+  HT_LOG_INFO << name << " (" << num_producers << " producer(s)): "
+              << "enqueue latency " << (enqueue_ns.load() / num_tasks)
+              << " ns/task, throughput "
+              << static_cast<uint64_t>(num_tasks * 1e9 / total_ns)
+              << " tasks/s";
+}
+
+// Compares the former one-TaskQueue-per-stream design with the
+// work-stealing executor on tiny tasks, i.e., scheduling overhead only.
+void BenchmarkEnqueue(size_t num_producers, size_t num_tasks = 200000) {
+  auto task = []() {
+    volatile int x = 0;
+    for (int i = 0; i < 64; i++)
+      x = x + i;
+  };
+  {
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    for (size_t q = 0; q < NUM_QUEUES; q++)
+      queues.emplace_back(new TaskQueue("bench", 1, num_tasks));
+    RunBenchmark(
+      "TaskQueue", num_producers, num_tasks,
+      [&](size_t q) { queues[q]->Enqueue(task); },
+      [&]() {
+        for (auto& queue : queues)
+          queue->Enqueue([]() {}).wait();
+      });
+  }
+  {
+    WorkStealingExecutor executor("bench", NUM_QUEUES, NUM_QUEUES, num_tasks);
+    RunBenchmark(
+      "WorkStealingExecutor", num_producers, num_tasks,
+      [&](size_t q) { executor.Enqueue(q, task); },
+      [&]() {
+        for (size_t q = 0; q < NUM_QUEUES; q++)
+          executor.Enqueue(q, []() {}).wait();
+      });
+    HT_LOG_INFO << "WorkStealingExecutor steals: " << executor.num_steals();
+  }
+}
+
+int main(int argc, char** argv) {
+  for (size_t num_workers : {1, 2, 4, 15})
+    TestStreamOrder(num_workers);
+  TestEventBlock();
+  for (size_t num_producers : {1, 4})
+    BenchmarkEnqueue(num_producers);
+  return 0;
+}
@@ -0,0 +1,300 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/graph/ops/kernel_links.h"
+#include "test_utils.h"
+#include <cmath>
+#include <vector>
+
+using namespace hetu;
+
+void TestRotaryCpu() {
+  HT_LOG_INFO << "Testing Rotary...";
+  Stream stream(Device(kCPU), kComputingStream);
+  int64_t B = 2, S = 9, H = 3, R = 16;
+  auto x1 = NDArray::randn({B, S, H, R});
+  auto x2 = NDArray::randn({B, S, H, R});
+  auto cos = NDArray::randn({S, 1, R});
+  auto sin = NDArray::randn({S, 1, R});
+  auto out1 = NDArray::empty({B, S, H, R});
+  auto out2 = NDArray::empty({B, S, H, R});
+  for (bool conj : {false, true}) {
+    hetu::impl::RotaryCpu(x1, x2, cos, sin, out1, out2, conj, stream);
+    SynchronizeAllStreams();
+    for (size_t i = 0; i < x1->numel(); i++) {
+      int64_t r = i % R, s = (i / (R * H)) % S;
+      float u = x1->data_ptr<float>()[i], v = x2->data_ptr<float>()[i];
+      float c = cos->data_ptr<float>()[s * R + r];
+      float sn = (conj ? -1 : 1) * sin->data_ptr<float>()[s * R + r];
+      HT_ASSERT_FUZZY_EQ(out1->data_ptr<float>()[i], u * c - v * sn, 1e-5, 1e-5)
+        << "Mismatched out1 on position " << i;
+      HT_ASSERT_FUZZY_EQ(out2->data_ptr<float>()[i], u * sn + v * c, 1e-5, 1e-5)
+        << "Mismatched out2 on position " << i;
+    }
+  }
+  HT_LOG_INFO << "Testing Rotary done";
+}
+
+void TestFusedLayerNormCpu() {
+  HT_LOG_INFO << "Testing FusedLayerNorm...";
+  Stream stream(Device(kCPU), kComputingStream);
+  int64_t n1 = 24, n2 = 200;
+  float eps = 1e-5;
+  auto input = NDArray::randn({4, 6, n2});
+  auto scale = NDArray::randn({n2});
+  auto bias = NDArray::randn({n2});
+  auto mean = NDArray::empty({4, 6, 1});
+  auto invvar = NDArray::empty({4, 6, 1});
+  auto output = NDArray::empty({4, 6, n2});
+  auto grad_output = NDArray::randn({4, 6, n2});
+  auto grad_input = NDArray::empty({4, 6, n2});
+  auto grad_scale = NDArray::empty({n2});
+  auto grad_bias = NDArray::empty({n2});
+  hetu::impl::FusedLayerNormCpu(input, scale, bias, mean, invvar, output, 1,
+                                eps, stream);
+  hetu::impl::FusedLayerNormGradientCpu(grad_output, input, scale, bias,
+                                        grad_input, grad_scale, grad_bias,
+                                        mean, invvar, 1, eps, false, stream);
+  SynchronizeAllStreams();
+  const float* x = input->data_ptr<float>();
+  const float* g = scale->data_ptr<float>();
+  const float* dy = grad_output->data_ptr<float>();
+  std::vector<double> ref_grad_scale(n2, 0), ref_grad_bias(n2, 0);
+  for (int64_t i = 0; i < n1; i++) {
+    double mu = 0, var = 0;
+    for (int64_t j = 0; j < n2; j++)
+      mu += x[i * n2 + j];
+    mu /= n2;
+    for (int64_t j = 0; j < n2; j++)
+      var += (x[i * n2 + j] - mu) * (x[i * n2 + j] - mu);
+    double rstd = 1 / std::sqrt(var / n2 + eps);
+    double sum1 = 0, sum2 = 0;
+    for (int64_t j = 0; j < n2; j++) {
+      double xhat = (x[i * n2 + j] - mu) * rstd;
+      double y = xhat * g[j] + bias->data_ptr<float>()[j];
+      HT_ASSERT_FUZZY_EQ(output->data_ptr<float>()[i * n2 + j], y, 1e-4, 1e-4)
+        << "Mismatched output on position " << i * n2 + j;
+      sum1 += dy[i * n2 + j] * g[j];
+      sum2 += dy[i * n2 + j] * g[j] * xhat;
+      ref_grad_scale[j] += dy[i * n2 + j] * xhat;
+      ref_grad_bias[j] += dy[i * n2 + j];
+    }
+    for (int64_t j = 0; j < n2; j++) {
+      double xhat = (x[i * n2 + j] - mu) * rstd;
+      double dx = rstd * (dy[i * n2 + j] * g[j] - sum1 / n2 - xhat * sum2 / n2);
+      HT_ASSERT_FUZZY_EQ(grad_input->data_ptr<float>()[i * n2 + j], dx, 1e-4,
+                         1e-3)
+        << "Mismatched grad_input on position " << i * n2 + j;
+    }
+  }
+  for (int64_t j = 0; j < n2; j++) {
+    HT_ASSERT_FUZZY_EQ(grad_scale->data_ptr<float>()[j], ref_grad_scale[j],
+                       1e-4, 1e-3)
+      << "Mismatched grad_scale on position " << j;
+    HT_ASSERT_FUZZY_EQ(grad_bias->data_ptr<float>()[j], ref_grad_bias[j],
+                       1e-4, 1e-3)
+      << "Mismatched grad_bias on position " << j;
+  }
+  HT_LOG_INFO << "Testing FusedLayerNorm done";
+}
+
+void TestDropoutCpu() {
+  HT_LOG_INFO << "Testing Dropout...";
+  Stream stream(Device(kCPU), kComputingStream);
+  double drop_rate = 0.3;
+  auto input = NDArray::rand({64, 1000}, Device(kCPU), kFloat32, 0.5, 1.5);
+  auto output = NDArray::empty({64, 1000});
+  auto mask = NDArray::empty({64, 1000}, Device(kCPU), kBool);
+  auto output2 = NDArray::empty({64, 1000});
+  auto mask2 = NDArray::empty({64, 1000}, Device(kCPU), kBool);
+  auto grad = NDArray::empty({64, 1000});
+  hetu::impl::DropoutCpu(input, drop_rate, 1234, output, mask, stream);
+  hetu::impl::DropoutCpu(input, drop_rate, 1234, output2, mask2, stream);
+  hetu::impl::DropoutGradientCpu(input, mask, drop_rate, grad, stream);
+  SynchronizeAllStreams();
+  size_t num_kept = 0;
+  for (size_t i = 0; i < input->numel(); i++) {
+    bool keep = mask->data_ptr<bool>()[i];
+    float expected = keep ? input->data_ptr<float>()[i] / (1 - drop_rate) : 0;
+    num_kept += keep;
+    HT_ASSERT_EQ(keep, mask2->data_ptr<bool>()[i])
+      << "Dropout is not deterministic for a fixed seed";
+    HT_ASSERT_FUZZY_EQ(output->data_ptr<float>()[i], expected, 1e-6, 1e-6);
+    HT_ASSERT_FUZZY_EQ(grad->data_ptr<float>()[i], expected, 1e-6, 1e-6);
+  }
+  double keep_ratio = static_cast<double>(num_kept) / input->numel();
+  HT_ASSERT(std::abs(keep_ratio - (1 - drop_rate)) < 0.01)
+    << "Unexpected keep ratio " << keep_ratio;
+  HT_LOG_INFO << "Testing Dropout done";
+}
+
+// Reference attention in double precision.
+// q: [B, Sq, H, D], k/v: [B, Sk, Hk, D], out: [B, Sq, H, D]
+void NaiveAttention(const NDArray& q, const NDArray& k, const NDArray& v,
+                    const NDArray& dout, float softmax_scale, bool is_causal,
+                    std::vector<double>& out, std::vector<double>& dq,
+                    std::vector<double>& dk, std::vector<double>& dv) {
+  int64_t B = q->shape(0), Sq = q->shape(1), H = q->shape(2), D = q->shape(3);
+  int64_t Sk = k->shape(1), Hk = k->shape(2);
+  const float *Q = q->data_ptr<float>(), *K = k->data_ptr<float>(),
+              *V = v->data_ptr<float>(), *dO = dout->data_ptr<float>();
+  out.assign(q->numel(), 0);
+  dq.assign(q->numel(), 0);
+  dk.assign(k->numel(), 0);
+  dv.assign(v->numel(), 0);
+  for (int64_t b = 0; b < B; b++) {
+    for (int64_t h = 0; h < H; h++) {
+      int64_t hk = h / (H / Hk);
+      for (int64_t i = 0; i < Sq; i++) {
+        int64_t num_keys = is_causal ? MIN(i + Sk - Sq + 1, Sk) : Sk;
+        auto q_off = ((b * Sq + i) * H + h) * D;
+        std::vector<double> p(num_keys), dp(num_keys, 0);
+        double max_s = -INFINITY, sum = 0, delta = 0;
+        for (int64_t j = 0; j < num_keys; j++) {
+          auto k_off = ((b * Sk + j) * Hk + hk) * D;
+          double s = 0;
+          for (int64_t d = 0; d < D; d++)
+            s += Q[q_off + d] * K[k_off + d];
+          p[j] = s * softmax_scale;
+          max_s = std::max(max_s, p[j]);
+        }
+        for (auto& val : p)
+          sum += (val = std::exp(val - max_s));
+        for (int64_t j = 0; j < num_keys; j++) {
+          auto v_off = ((b * Sk + j) * Hk + hk) * D;
+          p[j] /= sum;
+          for (int64_t d = 0; d < D; d++) {
+            out[q_off + d] += p[j] * V[v_off + d];
+            dp[j] += dO[q_off + d] * V[v_off + d];
+          }
+        }
+        for (int64_t d = 0; d < D; d++)
+          delta += dO[q_off + d] * out[q_off + d];
+        for (int64_t j = 0; j < num_keys; j++) {
+          auto kv_off = ((b * Sk + j) * Hk + hk) * D;
+          double ds = p[j] * (dp[j] - delta) * softmax_scale;
+          for (int64_t d = 0; d < D; d++) {
+            dq[q_off + d] += ds * K[kv_off + d];
+            dk[kv_off + d] += ds * Q[q_off + d];
+            dv[kv_off + d] += p[j] * dO[q_off + d];
+          }
+        }
+      }
+    }
+  }
+}
+
+void TestFlashAttnCpu(bool is_causal) {
+  HT_LOG_INFO << "Testing FlashAttn (causal = " << is_causal << ")...";
+  Stream stream(Device(kCPU), kComputingStream);
+  // Sequence lengths are not multiples of the tile sizes, and two query
+  // heads share each key/value head.
+  int64_t B = 2, Sq = 70, Sk = 100, H = 4, Hk = 2, D = 32;
+  float softmax_scale = 1.0 / std::sqrt(D);
+  auto q = NDArray::randn({B, Sq, H, D});
+  auto k = NDArray::randn({B, Sk, Hk, D});
+  auto v = NDArray::randn({B, Sk, Hk, D});
+  auto dout = NDArray::randn({B, Sq, H, D});
+  auto out = NDArray::empty({B, Sq, H, D});
+  auto lse = NDArray::empty({B, H, Sq});
+  auto rng_state = NDArray::empty({2}, Device(kCPU), kInt64);
+  auto dq = NDArray::empty({B, Sq, H, D});
+  auto dk = NDArray::empty({B, Sk, Hk, D});
+  auto dv = NDArray::empty({B, Sk, Hk, D});
+  NDArray q_padded, k_padded, v_padded, out_padded, p;
+  hetu::impl::FlashAttnCpu(q, k, v, out, q_padded, k_padded, v_padded,
+                           out_padded, lse, p, rng_state, 0, softmax_scale,
+                           is_causal, false, stream);
+  hetu::impl::FlashAttnGradientCpu(dout, q, k, v, out, lse, rng_state, dq, dk,
+                                   dv, 0, softmax_scale, is_causal, stream);
+  SynchronizeAllStreams();
+  std::vector<double> ref_out, ref_dq, ref_dk, ref_dv;
+  NaiveAttention(q, k, v, dout, softmax_scale, is_causal, ref_out, ref_dq,
+                 ref_dk, ref_dv);
+  auto check = [](const NDArray& arr, const std::vector<double>& ref,
+                  const char* name) {
+    for (size_t i = 0; i < ref.size(); i++)
+      HT_ASSERT_FUZZY_EQ(arr->data_ptr<float>()[i], ref[i], 1e-4, 1e-3)
+        << "Mismatched " << name << " on position " << i;
+  };
+  check(out, ref_out, "out");
+  check(dq, ref_dq, "dq");
+  check(dk, ref_dk, "dk");
+  check(dv, ref_dv, "dv");
+  HT_LOG_INFO << "Testing FlashAttn (causal = " << is_causal << ") done";
+}
+
+void TestNumericCpu() {
+  HT_LOG_INFO << "Testing CheckNumeric and Quantization...";
+  Stream stream(Device(kCPU), kComputingStream);
+  auto input = NDArray::randn({1000});
+  auto flags = NDArray::empty({3});
+  hetu::impl::CheckFiniteCpu(input, flags, stream);
+  SynchronizeAllStreams();
+  HT_ASSERT_EQ(flags->data_ptr<float>()[0], 0.f);
+  input->data_ptr<float>()[123] = -INFINITY;
+  hetu::impl::CheckNumericCpu(input, flags, stream);
+  SynchronizeAllStreams();
+  HT_ASSERT(flags->data_ptr<float>()[0] == 0 &&
+            flags->data_ptr<float>()[1] == 1 &&
+            flags->data_ptr<float>()[2] == 0)
+    << "Unexpected numeric flags";
+
+  int64_t blocksize = 64;
+  input = NDArray::randn({4096});
+  auto absmax = NDArray::empty({4096 / blocksize});
+  for (auto qtype : {kFloat4, kNFloat4}) {
+    auto quantized = NDArray::empty({4096}, Device(kCPU), qtype);
+    auto restored = NDArray::empty({4096});
+    hetu::impl::QuantizationCpu(input, absmax, NDArray(), quantized,
+                                blocksize, false, stream);
+    hetu::impl::DeQuantizationCpu(quantized, absmax, NDArray(), restored,
+                                  blocksize, stream);
+    SynchronizeAllStreams();
+    for (size_t i = 0; i < input->numel(); i++) {
+      // 4-bit codes are at most 1/3 of absmax apart.
+      float bound = absmax->data_ptr<float>()[i / blocksize] / 6 * 1.0001f;
+      HT_ASSERT_LE(std::abs(restored->data_ptr<float>()[i] -
+                            input->data_ptr<float>()[i]),
+                   bound)
+        << "Quantization error is too large on position " << i << " for "
+        << qtype;
+    }
+  }
+  HT_LOG_INFO << "Testing CheckNumeric and Quantization done";
+}
+
+void BenchmarkFlashAttnCpu(int64_t seqlen = 1024, int64_t num_heads = 8,
+                           int64_t head_size = 64) {
+  Stream stream(Device(kCPU), kComputingStream);
+  auto q = NDArray::randn({1, seqlen, num_heads, head_size});
+  auto k = NDArray::randn({1, seqlen, num_heads, head_size});
+  auto v = NDArray::randn({1, seqlen, num_heads, head_size});
+  auto out = NDArray::empty({1, seqlen, num_heads, head_size});
+  auto lse = NDArray::empty({1, num_heads, seqlen});
+  auto rng_state = NDArray::empty({2}, Device(kCPU), kInt64);
+  NDArray q_padded, k_padded, v_padded, out_padded, p;
+  for (bool is_causal : {false, true}) {
+    double ms = time_it([&]() {
+      hetu::impl::FlashAttnCpu(q, k, v, out, q_padded, k_padded, v_padded,
+                               out_padded, lse, p, rng_state, 0,
+                               1.0 / std::sqrt(head_size), is_causal, false,
+                               stream);
+    });
+    double flops = 4.0 * seqlen * seqlen * num_heads * head_size /
+      (is_causal ? 2 : 1);
+    HT_LOG_INFO << "FlashAttn (causal = " << is_causal << ") of seqlen "
+                << seqlen << ", " << num_heads << " heads of size "
+                << head_size << ": " << ms << " ms, "
+                << flops / ms / 1e6 << " GFLOPS";
+  }
+}
+
+int main(int argc, char** argv) {
+  TestRotaryCpu();
+  TestFusedLayerNormCpu();
+  TestDropoutCpu();
+  TestFlashAttnCpu(false);
+  TestFlashAttnCpu(true);
+  TestNumericCpu();
+  BenchmarkFlashAttnCpu();
+  return 0;
+}
@@ -0,0 +1,69 @@
+#include "hetu/graph/headers.h"
+#include "hetu/graph/ops/op_headers.h"
+#include "hetu/graph/init/initializer.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include <chrono>
+
+using namespace hetu;
+using namespace hetu::graph;
+
+Tensor MakeConstant(double value, const HTShape& shape) {
+  return MakeVariableOp(ConstantInitializer(value), shape, kFloat32, false,
+                        DistributedStatesHierarchy(),
+                        OpMeta().set_eager_device(Device(kCPU)));
+}
+
+void TestEagerDispatch(Graph& graph) {
+  HT_LOG_INFO << "Testing eager dispatch...";
+  Graph::push_graph_ctx(graph.id());
+  auto x = MakeConstant(1, {3, 3});
+  auto y = MakeConstant(2, {3, 3});
+  for (int i = 0; i < 8; i++) {
+    // the same dispatch for every iteration, with records of the ops
+    // removed in the last iteration reused
+    auto sum = MakeAddElewiseOp(x, y);
+    // non-contiguous inputs are made contiguous
+    auto prod = MakeMulElewiseOp(sum, MakeTransposeOp(y, {1, 0}));
+    auto ret = prod->get_or_compute();
+    // CPU ops keep computing on their own stream
+    HT_ASSERT_EQ(prod->producer()->instantiation_ctx().stream_index,
+                 kComputingStream)
+      << "Eager CPU op " << prod->producer() << " is not on the computing stream";
+    hetu::impl::SynchronizeAllCPUStreams();
+    HT_ASSERT(ret->shape() == HTShape({3, 3}));
+    for (int64_t j = 0; j < ret->numel(); j++)
+      HT_ASSERT_EQ(ret->data_ptr<float>()[j], 6) << "Element " << j;
+  }
+  Graph::pop_graph_ctx();
+}
+
+// Dispatch latency of small ops, which is mostly framework overhead.
+void BenchmarkEagerDispatch(Graph& graph, int num_ops = 100000) {
+  Graph::push_graph_ctx(graph.id());
+  auto x = MakeConstant(1, {8});
+  for (int i = 0; i < 1000; i++)
+    MakeAddByConstOp(x, 1);
+  hetu::impl::SynchronizeAllCPUStreams();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < num_ops; i++)
+    MakeAddByConstOp(x, 1);
+  double dispatch_ns = std::chrono::duration<double, std::nano>(
+                         std::chrono::steady_clock::now() - start)
+                         .count() /
+    num_ops;
+  hetu::impl::SynchronizeAllCPUStreams();
+  double total_ns = std::chrono::duration<double, std::nano>(
+                      std::chrono::steady_clock::now() - start)
+                      .count() /
+    num_ops;
+  HT_LOG_INFO << "Dispatched " << num_ops << " eager ops in " << dispatch_ns
+              << " ns per op (" << total_ns << " ns per op to finish)";
+  Graph::pop_graph_ctx();
+}
+
+int main(int argc, char** argv) {
+  auto& graph = Graph::get_default_eager_graph();
+  TestEagerDispatch(graph);
+  BenchmarkEagerDispatch(graph);
+  return 0;
+}
@@ -0,0 +1,226 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/graph/headers.h"
+#include "hetu/graph/ops/op_headers.h"
+#include "hetu/graph/ops/kernel_links.h"
+#include "hetu/graph/optim/optimizer.h"
+#include "test_utils.h"
+#include <cmath>
+#include <vector>
+
+using namespace hetu;
+using namespace hetu::graph;
+
+// Ids with many duplicates and a few out-of-range ones, which the gradient
+// kernels must drop.
+NDArray MakeIds(int64_t num_ids, int64_t num_rows) {
+  auto ids = NDArray::empty({num_ids}, Device(kCPU), kInt64);
+  auto* ptr = ids->data_ptr<int64_t>();
+  for (int64_t i = 0; i < num_ids; i++)
+    ptr[i] = (i * 7919) % (num_rows + 8) - 4;
+  return ids;
+}
+
+void TestEmbeddingLookupGradientCpu(int64_t num_ids, int64_t num_rows,
+                                    int64_t length) {
+  HT_LOG_INFO << "Testing EmbeddingLookupGradient with " << num_ids
+              << " ids over " << num_rows << " rows...";
+  Stream stream(Device(kCPU), kComputingStream);
+  auto ids = MakeIds(num_ids, num_rows);
+  auto output_grad = NDArray::randn({num_ids, length});
+  auto dense_grad = NDArray::empty({num_rows, length});
+  auto unique_ids = NDArray::empty({num_ids}, Device(kCPU), kInt64);
+  auto grad_values = NDArray::empty({num_ids, length});
+  hetu::impl::EmbeddingLookupGradientCpu(output_grad, ids, dense_grad, stream);
+  hetu::impl::EmbeddingLookupSparseGradientCpu(output_grad, ids, num_rows,
+                                               unique_ids, grad_values, stream);
+  SynchronizeAllStreams();
+
+  std::vector<double> expected(num_rows * length, 0);
+  const auto* id_ptr = ids->data_ptr<int64_t>();
+  for (int64_t i = 0; i < num_ids; i++) {
+    if (id_ptr[i] < 0 || id_ptr[i] >= num_rows)
+      continue;
+    for (int64_t j = 0; j < length; j++)
+      expected[id_ptr[i] * length + j] +=
+        output_grad->data_ptr<float>()[i * length + j];
+  }
+  for (int64_t i = 0; i < num_rows * length; i++)
+    HT_ASSERT_FUZZY_EQ(dense_grad->data_ptr<float>()[i], expected[i], 1e-4,
+                       1e-4)
+      << "Mismatched dense gradient on position " << i;
+
+  // The indexed slices hold the same rows as the dense gradient.
+  const auto* unique_ptr = unique_ids->data_ptr<int64_t>();
+  int64_t num_unique = 0;
+  while (num_unique < num_ids && unique_ptr[num_unique] >= 0)
+    num_unique++;
+  for (int64_t k = 0; k < num_ids; k++) {
+    if (k < num_unique) {
+      HT_ASSERT(k == 0 || unique_ptr[k] > unique_ptr[k - 1])
+        << "Unique ids are not sorted";
+    } else {
+      HT_ASSERT_EQ(unique_ptr[k], -1) << "Unused ids are not padded";
+    }
+    for (int64_t j = 0; j < length; j++) {
+      double truth = k < num_unique ? expected[unique_ptr[k] * length + j] : 0;
+      HT_ASSERT_FUZZY_EQ(grad_values->data_ptr<float>()[k * length + j],
+                         truth, 1e-4, 1e-4)
+        << "Mismatched sparse gradient on position " << k * length + j;
+    }
+  }
+
+  // Sparse and dense SGD agree. Sparse and dense Adam, both with weight
+  // decay, agree on the touched rows, and sparse Adam leaves untouched rows
+  // as is.
+  auto dense_param = NDArray::randn({num_rows, length});
+  auto sparse_param = NDArray::copy(dense_param);
+  auto adam_param = NDArray::copy(dense_param);
+  auto dense_adam_param = NDArray::copy(dense_param);
+  auto mean = NDArray::zeros({num_rows, length});
+  auto variance = NDArray::zeros({num_rows, length});
+  auto dense_mean = NDArray::zeros({num_rows, length});
+  auto dense_variance = NDArray::zeros({num_rows, length});
+  auto step = NDArray::full({1}, 1, Device(kCPU), kInt64);
+  NDArray velocity;
+  hetu::impl::SGDUpdateCpu(dense_grad, dense_param, velocity, 0.1, 0, false,
+                           stream);
+  hetu::impl::SGDUpdateIndexedSlicesCpu(unique_ids, grad_values, sparse_param,
+                                        velocity, 0.1, 0, false, stream);
+  hetu::impl::AdamUpdateIndexedSlicesCpu(unique_ids, grad_values, adam_param,
+                                         mean, variance, step, 0.1, 0.9,
+                                         0.999, 1e-8, 0.01, false, stream);
+  hetu::impl::AdamCpu(dense_grad, dense_adam_param, dense_mean,
+                      dense_variance, step, 0.1, 0.9, 0.999, 1e-8, 0.01,
+                      false, stream);
+  SynchronizeAllStreams();
+  std::vector<bool> touched(num_rows, false);
+  for (int64_t k = 0; k < num_unique; k++)
+    touched[unique_ptr[k]] = true;
+  for (int64_t i = 0; i < num_rows * length; i++) {
+    HT_ASSERT_FUZZY_EQ(sparse_param->data_ptr<float>()[i],
+                       dense_param->data_ptr<float>()[i], 1e-5, 1e-5)
+      << "Mismatched sparse SGD update on position " << i;
+    if (touched[i / length]) {
+      HT_ASSERT_FUZZY_EQ(adam_param->data_ptr<float>()[i],
+                         dense_adam_param->data_ptr<float>()[i], 1e-5, 1e-5)
+        << "Mismatched sparse Adam update on position " << i;
+    } else {
+      HT_ASSERT_EQ(mean->data_ptr<float>()[i], 0.f)
+        << "Untouched row " << i / length << " is updated by sparse Adam";
+    }
+  }
+  HT_LOG_INFO << "Testing EmbeddingLookupGradient done";
+}
+
+// Trains an embedding table with an eager CPU graph. The gradient comes as
+// indexed slices, the optimizers update the looked-up rows with the sparse
+// kernels, and Adam decays the weights of those rows only. The dense
+// gradient is only set when fetched afterwards.
+void TestSparseEmbeddingTraining(bool adam, int64_t num_ids = 40,
+                                 int64_t num_rows = 64, int64_t length = 8) {
+  HT_LOG_INFO << "Testing sparse embedding training with "
+              << (adam ? "Adam" : "SGD") << "...";
+  const float lr = 0.1, weight_decay = 0.01;
+  const float beta1 = 0.9, beta2 = 0.999, eps = 1e-8;
+  auto& graph = Graph::get_default_eager_graph();
+  Graph::push_graph_ctx(graph.id());
+  auto init = NDArray::randn({num_rows, length});
+  auto ids_array = MakeIds(num_ids, num_rows);
+  auto coef_array = NDArray::randn({num_ids, length});
+  auto op_meta = OpMeta().set_eager_device(Device(kCPU));
+  auto table = MakeParameterOp(init, true, kFloat32, true,
+                               DistributedStatesHierarchy(), op_meta);
+  auto ids = MakeVariableOp(ids_array, false, kInt64, false,
+                            DistributedStatesHierarchy(), op_meta);
+  auto coef = MakeVariableOp(coef_array, false, kFloat32, false,
+                             DistributedStatesHierarchy(), op_meta);
+  auto loss = MakeReduceOp(
+    MakeMulElewiseOp(MakeEmbeddingLookupOp(table, ids), coef), "sum");
+  Tensor train_op;
+  if (adam) {
+    AdamOptimizer optimizer(lr, lr, lr, 0, 1000, "constant", weight_decay,
+                            weight_decay, -1, "constant", beta1, beta2, eps);
+    train_op = optimizer.Minimize(loss);
+  } else {
+    SGDOptimizer optimizer(lr, lr, lr, 0, 1000, "constant", 0);
+    train_op = optimizer.Minimize(loss);
+  }
+  const auto& updates = train_op->producer()->in_dep_linkers();
+  HT_ASSERT(updates.size() == 1 &&
+            updates.front()->producer()->type() ==
+              (adam ? "SparseAdamOp" : "SparseSGDUpdateOp"))
+    << "The table is not updated with its indexed slices";
+  auto updated = table->get_or_compute();
+  // the sparse update leaves the dense gradient unset until it is fetched
+  auto dense_grad = updates.front()->producer()->input(1)->get_or_compute();
+  SynchronizeAllStreams();
+  Graph::pop_graph_ctx();
+
+  // The gradient of row r is the sum of the coefficients of its ids.
+  std::vector<double> grad(num_rows * length, 0);
+  std::vector<bool> touched(num_rows, false);
+  const auto* id_ptr = ids_array->data_ptr<int64_t>();
+  for (int64_t i = 0; i < num_ids; i++) {
+    if (id_ptr[i] < 0 || id_ptr[i] >= num_rows)
+      continue;
+    touched[id_ptr[i]] = true;
+    for (int64_t j = 0; j < length; j++)
+      grad[id_ptr[i] * length + j] +=
+        coef_array->data_ptr<float>()[i * length + j];
+  }
+  for (int64_t i = 0; i < num_rows * length; i++) {
+    double param = init->data_ptr<float>()[i];
+    double expected = param;
+    if (touched[i / length] && !adam) {
+      expected = param - lr * grad[i];
+    } else if (touched[i / length]) {
+      // the first step, with zero states
+      double mean = (1 - beta1) * grad[i];
+      double variance = (1 - beta2) * grad[i] * grad[i];
+      double update = (mean / (1 - beta1)) /
+        (std::sqrt(variance) / std::sqrt(1 - beta2) + eps);
+      expected = param - lr * (update + weight_decay * param);
+    }
+    HT_ASSERT_FUZZY_EQ(updated->data_ptr<float>()[i], expected, 1e-4, 1e-4)
+      << "Mismatched parameter on position " << i << " (row "
+      << (touched[i / length] ? "touched" : "untouched") << ")";
+    HT_ASSERT_FUZZY_EQ(dense_grad->data_ptr<float>()[i], grad[i], 1e-4, 1e-4)
+      << "Mismatched dense gradient on position " << i;
+  }
+  HT_LOG_INFO << "Testing sparse embedding training with "
+              << (adam ? "Adam" : "SGD") << " done";
+}
+
+// Compares the dense gradient, which writes the whole table, with the
+// indexed slices for a small batch over a large table.
+void BenchmarkEmbeddingLookupGradientCpu(int64_t num_ids = 16384,
+                                         int64_t num_rows = 1 << 20,
+                                         int64_t length = 64) {
+  Stream stream(Device(kCPU), kComputingStream);
+  auto ids = MakeIds(num_ids, num_rows);
+  auto output_grad = NDArray::randn({num_ids, length});
+  auto dense_grad = NDArray::empty({num_rows, length});
+  auto unique_ids = NDArray::empty({num_ids}, Device(kCPU), kInt64);
+  auto grad_values = NDArray::empty({num_ids, length});
+  double dense_ms = time_it([&]() {
+    hetu::impl::EmbeddingLookupGradientCpu(output_grad, ids, dense_grad,
+                                           stream);
+  });
+  double sparse_ms = time_it([&]() {
+    hetu::impl::EmbeddingLookupSparseGradientCpu(
+      output_grad, ids, num_rows, unique_ids, grad_values, stream);
+  });
+  HT_LOG_INFO << "EmbeddingLookupGradient of " << num_ids << " ids over "
+              << num_rows << " x " << length << " table: dense " << dense_ms
+              << " ms, sparse " << sparse_ms << " ms";
+}
+
+int main(int argc, char** argv) {
+  TestEmbeddingLookupGradientCpu(1, 10, 4);
+  TestEmbeddingLookupGradientCpu(5000, 300, 16);
+  TestEmbeddingLookupGradientCpu(100000, 50000, 8);
+  TestSparseEmbeddingTraining(false);
+  TestSparseEmbeddingTraining(true);
+  BenchmarkEmbeddingLookupGradientCpu();
+  return 0;
+}
@@ -0,0 +1,198 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/graph/ops/kernel_links.h"
+#include "test_utils.h"
+
+using namespace hetu;
+
+void AssertFuzzyEqual(const NDArray& a, const NDArray& b, double atol,
+                      double rtol) {
+  SynchronizeAllStreams();
+  auto a_ = NDArray::to(NDArray::contiguous(a), Device(kCPU), kFloat32);
+  auto b_ = NDArray::to(NDArray::contiguous(b), Device(kCPU), kFloat32);
+  SynchronizeAllStreams();
+  HT_ASSERT(a_->shape() == b_->shape())
+    << "Mismatched shapes " << a_->shape() << " and " << b_->shape();
+  for (size_t i = 0; i < a_->numel(); i++)
+    HT_ASSERT_FUZZY_EQ(a_->data_ptr<float>()[i], b_->data_ptr<float>()[i],
+                       atol, rtol)
+      << "Mismatched on position " << i;
+}
+
+void AssertMaskEqual(const NDArray& a, const NDArray& b) {
+  SynchronizeAllStreams();
+  for (size_t i = 0; i < a->numel(); i++)
+    HT_ASSERT(a->data_ptr<bool>()[i] == b->data_ptr<bool>()[i])
+      << "Mismatched mask on position " << i;
+}
+
+// The GPT MLP epilogue: dropout(gelu(x * y + bias)). The chain is one of the
+// compile-time specialized kernels and the bias is broadcast.
+FusedProgram MLPProgram(double drop_rate) {
+  FusedProgram program;
+  program.num_inputs = 3;
+  program.instrs = {{FusedOpCode::MUL, 0, 1},
+                    {FusedOpCode::ADD, 3, 2},
+                    {FusedOpCode::GELU, 4},
+                    {FusedOpCode::DROPOUT, 5, -1, drop_rate}};
+  program.outputs = {{6}, {6, true}};
+  return program;
+}
+
+void TestFusedGroupMLP(DataType dtype) {
+  HT_LOG_INFO << "Testing FusedGroup on the MLP chain with " << dtype << "...";
+  Stream stream(Device(kCPU), kComputingStream);
+  HTShape shape = {4, 33, 300};
+  auto x = NDArray::randn(shape, Device(kCPU), dtype);
+  auto y = NDArray::randn(shape, Device(kCPU), dtype);
+  auto bias = NDArray::randn({shape.back()}, Device(kCPU), dtype);
+  uint64_t seed = 2024;
+  NDArrayList outputs = {NDArray::empty(shape, Device(kCPU), dtype),
+                         NDArray::empty(shape, Device(kCPU), kBool)};
+  hetu::impl::FusedGroupCpu({x, y, bias}, MLPProgram(0.1), {seed}, outputs,
+                            stream);
+
+  auto hidden = NDArray::gelu(NDArray::add(NDArray::mul(x, y), bias));
+  auto expected = NDArray::empty(shape, Device(kCPU), dtype);
+  auto expected_mask = NDArray::empty(shape, Device(kCPU), kBool);
+  SynchronizeAllStreams();
+  hetu::impl::DropoutCpu(hidden, 0.1, seed, expected, expected_mask, stream);
+  double tol = dtype == kFloat32 ? 1e-5 : 2e-2;
+  AssertFuzzyEqual(outputs[0], expected, tol, tol);
+  AssertMaskEqual(outputs[1], expected_mask);
+}
+
+// A program that is not a linear chain goes through the block interpreter:
+//   r3 = x - y; r4 = exp(r3); r5 = r4 / r3; r6 = r5 * z; r7 = relu(r6)
+// with a transposed input and an intermediate register as another output.
+void TestFusedGroupInterpreter() {
+  HT_LOG_INFO << "Testing FusedGroup with the block interpreter...";
+  Stream stream(Device(kCPU), kComputingStream);
+  HTShape shape = {70, 513};
+  auto x = NDArray::randn(shape);
+  auto y = NDArray::permute(NDArray::randn({shape[1], shape[0]}), {1, 0});
+  auto z = NDArray::randn({shape[0], 1});
+  FusedProgram program;
+  program.num_inputs = 3;
+  program.instrs = {{FusedOpCode::SUB, 0, 1},
+                    {FusedOpCode::EXP, 3},
+                    {FusedOpCode::DIV, 4, 3},
+                    {FusedOpCode::MUL, 5, 2},
+                    {FusedOpCode::RELU, 6}};
+  program.outputs = {{4}, {7}};
+  NDArrayList outputs = {NDArray::empty(shape), NDArray::empty(shape)};
+  hetu::impl::FusedGroupCpu({x, y, z}, program, {}, outputs, stream);
+
+  auto diff = NDArray::sub(x, y);
+  auto exp = NDArray::exp(diff);
+  auto expected =
+    NDArray::relu(NDArray::mul(NDArray::div(exp, diff), z));
+  AssertFuzzyEqual(outputs[0], exp, 1e-5, 1e-5);
+  AssertFuzzyEqual(outputs[1], expected, 1e-4, 1e-4);
+}
+
+// Compares the fused MLP epilogue with one kernel per op. Traffic counts
+// float reads and writes of every kernel, plus the bool mask.
+void BenchmarkFusedGroupMLP(int64_t tokens = 2048, int64_t hidden = 4096) {
+  Stream stream(Device(kCPU), kComputingStream);
+  HTShape shape = {tokens, hidden};
+  auto x = NDArray::randn(shape);
+  auto y = NDArray::randn(shape);
+  auto bias = NDArray::randn({hidden});
+  auto program = MLPProgram(0.1);
+  NDArrayList outputs = {NDArray::empty(shape),
+                         NDArray::empty(shape, Device(kCPU), kBool)};
+  auto mul_out = NDArray::empty(shape);
+  auto add_out = NDArray::empty(shape);
+  auto gelu_out = NDArray::empty(shape);
+  double fused_ms = time_it([&]() {
+    hetu::impl::FusedGroupCpu({x, y, bias}, program, {1}, outputs, stream);
+  });
+  double unfused_ms = time_it([&]() {
+    NDArray::mul(x, y, kComputingStream, mul_out);
+    NDArray::add(mul_out, bias, kComputingStream, add_out);
+    NDArray::gelu(add_out, kComputingStream, gelu_out);
+    hetu::impl::DropoutCpu(gelu_out, 0.1, 1, outputs[0], outputs[1], stream);
+  });
+  double numel = tokens * hidden;
+  double fused_bytes = numel * (3 * sizeof(float) + sizeof(bool));
+  double unfused_bytes = numel * (9 * sizeof(float) + sizeof(bool));
+  HT_LOG_INFO << "MLP epilogue over " << shape << ": fused moves "
+              << fused_bytes / 1e6 << " MB in " << fused_ms
+              << " ms, unfused moves " << unfused_bytes / 1e6 << " MB in "
+              << unfused_ms << " ms";
+}
+
+// The GPT MLP block, x + dropout(gelu(x W1 + b1) W2 + b2), with the two
+// epilogues fused as the fusion pass would fuse them, against one kernel per
+// op. Both give the same output and mask for the same seed.
+void BenchmarkGPTMLPBlock(int64_t tokens = 512, int64_t hidden = 1024) {
+  Stream stream(Device(kCPU), kComputingStream);
+  int64_t ffn_hidden = 4 * hidden;
+  auto x = NDArray::randn({tokens, hidden});
+  auto w1 = NDArray::randn({hidden, ffn_hidden}, Device(kCPU), kFloat32, 0,
+                           0.02);
+  auto b1 = NDArray::randn({ffn_hidden});
+  auto w2 = NDArray::randn({ffn_hidden, hidden}, Device(kCPU), kFloat32, 0,
+                           0.02);
+  auto b2 = NDArray::randn({hidden});
+  auto fc1_out = NDArray::empty({tokens, ffn_hidden});
+  auto bias1_out = NDArray::empty({tokens, ffn_hidden});
+  auto gelu_out = NDArray::empty({tokens, ffn_hidden});
+  auto fc2_out = NDArray::empty({tokens, hidden});
+  auto bias2_out = NDArray::empty({tokens, hidden});
+  auto dropout_out = NDArray::empty({tokens, hidden});
+  NDArrayList unfused = {NDArray::empty({tokens, hidden}),
+                         NDArray::empty({tokens, hidden}, Device(kCPU), kBool)};
+  NDArrayList fused = {NDArray::empty({tokens, hidden}),
+                       NDArray::empty({tokens, hidden}, Device(kCPU), kBool)};
+  FusedProgram bias_gelu;
+  bias_gelu.num_inputs = 2;
+  bias_gelu.instrs = {{FusedOpCode::ADD, 0, 1}, {FusedOpCode::GELU, 2}};
+  bias_gelu.outputs = {{3}};
+  FusedProgram bias_dropout_residual;
+  bias_dropout_residual.num_inputs = 3;
+  bias_dropout_residual.instrs = {{FusedOpCode::ADD, 0, 1},
+                                  {FusedOpCode::DROPOUT, 3, -1, 0.1},
+                                  {FusedOpCode::ADD, 4, 2}};
+  bias_dropout_residual.outputs = {{5}, {4, true}};
+  const uint64_t seed = 7;
+  const int num_iters = 3;
+
+  double unfused_ms = time_it(
+    [&]() {
+      NDArray::matmul(x, w1, false, false, kComputingStream, fc1_out);
+      NDArray::add(fc1_out, b1, kComputingStream, bias1_out);
+      NDArray::gelu(bias1_out, kComputingStream, gelu_out);
+      NDArray::matmul(gelu_out, w2, false, false, kComputingStream, fc2_out);
+      NDArray::add(fc2_out, b2, kComputingStream, bias2_out);
+      hetu::impl::DropoutCpu(bias2_out, 0.1, seed, dropout_out, unfused[1],
+                             stream);
+      NDArray::add(dropout_out, x, kComputingStream, unfused[0]);
+    },
+    num_iters);
+  NDArrayList gelu_outputs = {gelu_out};
+  double fused_ms = time_it(
+    [&]() {
+      NDArray::matmul(x, w1, false, false, kComputingStream, fc1_out);
+      hetu::impl::FusedGroupCpu({fc1_out, b1}, bias_gelu, {}, gelu_outputs,
+                                stream);
+      NDArray::matmul(gelu_out, w2, false, false, kComputingStream, fc2_out);
+      hetu::impl::FusedGroupCpu({fc2_out, b2, x}, bias_dropout_residual,
+                                {seed}, fused, stream);
+    },
+    num_iters);
+  AssertFuzzyEqual(fused[0], unfused[0], 1e-4, 1e-4);
+  AssertMaskEqual(fused[1], unfused[1]);
+  HT_LOG_INFO << "GPT MLP block of " << tokens << " tokens, hidden size "
+              << hidden << ": fused " << fused_ms << " ms, unfused "
+              << unfused_ms << " ms";
+}
+
+int main(int argc, char** argv) {
+  for (auto dtype : {kFloat32, kFloat16, kBFloat16})
+    TestFusedGroupMLP(dtype);
+  TestFusedGroupInterpreter();
+  BenchmarkFusedGroupMLP();
+  BenchmarkGPTMLPBlock();
+  return 0;
+}
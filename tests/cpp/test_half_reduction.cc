@@ -0,0 +1,106 @@
+#include "hetu/impl/communication/half_reduction.h"
+#include "hetu/impl/communication/mpi_comm_group.h"
+#include "hetu/graph/ops/kernel_links.h"
+#include "test_utils.h"
+#include <cstring>
+
+using namespace hetu;
+using namespace hetu::impl;
+using namespace hetu::impl::comm;
+
+constexpr auto TEST_HALF_DATA_TYPES = {kFloat16, kBFloat16};
+constexpr auto TEST_REDUCTION_TYPES = {kSUM, kPROD, kMAX, kMIN};
+
+bool IsNaNBits(DataType dtype, uint16_t bits) {
+  if (dtype == kFloat16)
+    return (bits & 0x7C00) == 0x7C00 && (bits & 0x03FF) != 0;
+  return (bits & 0x7F80) == 0x7F80 && (bits & 0x007F) != 0;
+}
+
+// Every non-NaN bit pattern (denormals included) meets a scrambled one, and
+// the odd length leaves a scalar tail after the vectorized loop.
+void TestBitIdentical(DataType dtype) {
+  HT_LOG_INFO << "Testing bit-identical half-precision reductions for type "
+              << dtype << " (vectorized: " << IsHalfReductionVectorized(dtype)
+              << ")...";
+  const size_t n = (1 << 16) + 5;
+  std::vector<uint16_t> in(n), inout(n);
+  for (size_t i = 0; i < n; i++) {
+    in[i] = static_cast<uint16_t>(i);
+    inout[i] = static_cast<uint16_t>(i * 40503 + 12345);
+    if (IsNaNBits(dtype, in[i]))
+      in[i] = 0;
+    if (IsNaNBits(dtype, inout[i]))
+      inout[i] = 0x8000;
+  }
+  for (auto red_type : TEST_REDUCTION_TYPES) {
+    auto scalar = inout, vectorized = inout;
+    ReduceHalf(dtype, red_type, in.data(), scalar.data(), n, false);
+    ReduceHalf(dtype, red_type, in.data(), vectorized.data(), n, true);
+    for (size_t i = 0; i < n; i++) {
+      HT_ASSERT_EQ(scalar[i], vectorized[i])
+        << "Mismatched " << red_type << " of " << in[i] << " and " << inout[i]
+        << ": " << scalar[i] << " (scalar) vs. " << vectorized[i];
+    }
+  }
+  // Denormal sums stay denormal or round up into the normals, instead of
+  // being flushed to zero.
+  const uint16_t max_denormal = dtype == kFloat16 ? 0x03FF : 0x007F;
+  std::vector<uint16_t> a(16, 0x0001), b(16, 0x0001);
+  b[1] = max_denormal;
+  b[2] = 0x8001;
+  ReduceHalf(dtype, kSUM, a.data(), b.data(), b.size());
+  HT_ASSERT_EQ(b[0], 0x0002);
+  HT_ASSERT_EQ(b[1], max_denormal + 1);
+  HT_ASSERT_EQ(b[2], 0x0000);
+  HT_LOG_INFO << "Testing bit-identical half-precision reductions for type "
+              << dtype << " done";
+}
+
+// MPI reduces 16-bit floats with user-defined ops. Multiples of 0.5 keep the
+// results exact in both formats.
+void TestHalfPrecisionReductions(DataType dtype,
+                                 const HTShape& shape = {1024, 1023}) {
+  HT_LOG_INFO << "Testing half-precision reductions for type " << dtype
+              << "...";
+  auto group = MPICommunicationGroup::GetOrCreate({});
+  Device device(kCPU);
+  const double scalar_of_rank = (group->rank() + 1) * 0.5;
+  const double reduced_scalar =
+    ((group->size() + 1) * group->size() / 2) * 0.5;
+  NDArray array = NDArray::full(shape, scalar_of_rank, device, dtype);
+  NDArray max_array = NDArray::empty(shape, device, dtype);
+  HTShape input_shape = shape;
+  input_shape[0] *= group->size();
+  NDArray scatter_input =
+    NDArray::full(input_shape, scalar_of_rank, device, dtype);
+  NDArray scattered_array = NDArray::empty(shape, device, dtype);
+  NDArrayList coalesce_inputs = {
+    NDArray::full({3}, scalar_of_rank, device, dtype),
+    NDArray::full(shape, scalar_of_rank, device, dtype)};
+  NDArrayList coalesce_outputs = {NDArray::empty({3}, device, dtype),
+                                  NDArray::empty(shape, device, dtype)};
+  NDArray buffer = NDArray::empty({3 + array->numel()}, device, dtype);
+  SynchronizeAllStreams();
+  group->AllReduce(array, max_array, kMAX);
+  group->AllReduce(array, array);
+  group->ReduceScatter(scatter_input, scattered_array);
+  group->AllReduceCoalesce(coalesce_inputs, coalesce_outputs, buffer);
+  group->Sync();
+  assert_fuzzy_eq(array, reduced_scalar);
+  assert_fuzzy_eq(max_array, group->size() * 0.5);
+  assert_fuzzy_eq(scattered_array, reduced_scalar);
+  for (const auto& output : coalesce_outputs)
+    assert_fuzzy_eq(output, reduced_scalar);
+  group->Barrier(true);
+  HT_LOG_INFO << "Testing half-precision reductions for type " << dtype
+              << " done";
+}
+
+int main(int argc, char** argv) {
+  for (const auto& dtype : TEST_HALF_DATA_TYPES)
+    TestBitIdentical(dtype);
+  for (const auto& dtype : TEST_HALF_DATA_TYPES)
+    TestHalfPrecisionReductions(dtype);
+  return 0;
+}
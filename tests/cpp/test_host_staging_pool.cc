@@ -0,0 +1,115 @@
+#include "hetu/impl/memory/HostStagingPool.h"
+#include <map>
+
+using namespace hetu;
+using namespace hetu::impl;
+
+constexpr size_t ARENA_BYTES = 4 * 1024 * 1024;
+constexpr int NUM_NUMA_NODES = 2;
+
+// Records what the pool asks the platform to do instead of pinning
+// and binding real memory, so that this test runs without CUDA or NUMA.
+struct MockPlatform {
+  std::map<void*, size_t> pinned;
+  std::map<void*, int> bound_node;
+  int num_pin_calls{0};
+
+  HostStagingHooks hooks() {
+    HostStagingHooks hooks;
+    hooks.pin = [this](void* ptr, size_t num_bytes) {
+      HT_ASSERT(pinned.find(ptr) == pinned.end()) << "Arena pinned twice";
+      pinned[ptr] = num_bytes;
+      num_pin_calls++;
+    };
+    hooks.unpin = [this](void* ptr, size_t num_bytes) {
+      HT_ASSERT_EQ(pinned[ptr], num_bytes);
+      pinned.erase(ptr);
+    };
+    hooks.bind_to_numa_node = [this](void* ptr, size_t, int numa_node) {
+      HT_ASSERT(pinned.find(ptr) == pinned.end())
+        << "Arena must be bound before it is pinned";
+      bound_node[ptr] = numa_node;
+    };
+    hooks.device_numa_node = [](const Device& device) {
+      return device.is_cuda() ? device.index() / 4 : -1;
+    };
+    return hooks;
+  }
+
+  int NodeOf(void* ptr) const {
+    auto it = bound_node.upper_bound(ptr);
+    HT_ASSERT(it != bound_node.begin()) << "Pointer is not in any arena";
+    --it;
+    auto pinned_it = pinned.find(it->first);
+    HT_ASSERT(pinned_it != pinned.end());
+    HT_ASSERT(static_cast<char*>(ptr) <
+              static_cast<char*>(it->first) + pinned_it->second)
+      << "Pointer is not in any pinned arena";
+    return it->second;
+  }
+};
+
+void TestRecycleAcrossMicroBatches() {
+  HT_LOG_INFO << "Testing recycling across micro-batches...";
+  MockPlatform platform;
+  {
+    HostStagingPool pool(ARENA_BYTES, NUM_NUMA_NODES, platform.hooks());
+    const std::vector<size_t> sizes = {1000, 300000, 300001, 1048576};
+    for (int micro_batch = 0; micro_batch < 8; micro_batch++) {
+      std::vector<void*> buffers;
+      for (auto size : sizes) {
+        void* ptr = pool.Acquire(size, 0);
+        HT_ASSERT_EQ(reinterpret_cast<uintptr_t>(ptr) % 4096, 0);
+        HT_ASSERT_GE(HostStagingPool::SizeClassBytes(size), size);
+        buffers.push_back(ptr);
+      }
+      for (auto* ptr : buffers)
+        pool.Recycle(ptr);
+    }
+    auto stats = pool.stats(0);
+    HT_ASSERT_EQ(stats.acquire_cnt, 8 * sizes.size());
+    HT_ASSERT_EQ(stats.reuse_cnt, 7 * sizes.size())
+      << "Buffers are not reused after the first micro-batch";
+    HT_ASSERT_EQ(stats.in_use_bytes, 0);
+    HT_ASSERT_EQ(stats.num_arenas, 1);
+    HT_ASSERT_EQ(platform.num_pin_calls, 1) << "Arena should be pinned once";
+    HT_ASSERT_EQ(pool.stats(1).num_arenas, 0);
+  }
+  HT_ASSERT(platform.pinned.empty()) << "Arenas are not unpinned";
+  HT_LOG_INFO << "Testing recycling across micro-batches done";
+}
+
+void TestNumaPartition() {
+  HT_LOG_INFO << "Testing NUMA partition...";
+  MockPlatform platform;
+  HostStagingPool pool(ARENA_BYTES, NUM_NUMA_NODES, platform.hooks());
+  for (int node = 0; node < NUM_NUMA_NODES; node++) {
+    void* ptr = pool.Acquire(123456, node);
+    HT_ASSERT_EQ(pool.NumaNodeOf(ptr), node);
+    HT_ASSERT_EQ(platform.NodeOf(ptr), node);
+    pool.Recycle(ptr);
+    // A buffer recycled on one node is never handed out on another.
+    void* other = pool.Acquire(123456, 1 - node);
+    HT_ASSERT_NE(other, ptr);
+    HT_ASSERT_EQ(platform.NodeOf(other), 1 - node);
+    pool.Recycle(other);
+  }
+  // GPUs 4-7 are attached to node 1 in the mock topology.
+  HT_ASSERT_EQ(pool.NumaNodeOf(Device(kCUDA, 5)), 1);
+  void* ptr = pool.Acquire(4096, pool.NumaNodeOf(Device(kCUDA, 5)));
+  HT_ASSERT_EQ(platform.NodeOf(ptr), 1);
+  pool.Recycle(ptr);
+  // Buffers larger than an arena get a dedicated one.
+  void* large = pool.Acquire(ARENA_BYTES + 1, 0);
+  HT_ASSERT_EQ(platform.NodeOf(large), 0);
+  HT_ASSERT_EQ(pool.stats(0).num_arenas, 2);
+  pool.Recycle(large);
+  pool.PrintSummary();
+  HT_LOG_INFO << "Testing NUMA partition done";
+}
+
+int main(int argc, char** argv) {
+  TestRecycleAcrossMicroBatches();
+  TestNumaPartition();
+  return 0;
+}
@@ -0,0 +1,120 @@
+#include "hetu/graph/memory_plan/memory_planner.h"
+#include "test_utils.h"
+#include <random>
+
+using namespace hetu;
+using namespace hetu::graph;
+
+// Lifetimes of a synthetic transformer-like training step: a forward chain
+// of `num_layers` layers, each producing a few activations with residual
+// connections, and a backward pass that consumes them in reverse order.
+// Every op takes one step.
+std::vector<TensorLifetime> MakeTrainingLifetimes(size_t num_ops,
+                                                  uint64_t seed = 0) {
+  std::mt19937_64 rng(seed);
+  std::uniform_int_distribution<size_t> size_dist(1, 64);
+  constexpr size_t kOpsPerLayer = 8;
+  size_t num_layers = MAX(num_ops / (2 * kOpsPerLayer), size_t(1));
+  size_t num_fw_ops = num_layers * kOpsPerLayer;
+  std::vector<TensorLifetime> lifetimes;
+  TensorId tensor_id = 0;
+  for (size_t step = 0; step < num_fw_ops; step++) {
+    size_t layer_begin = step - step % kOpsPerLayer;
+    // Its mirror op in the backward pass.
+    size_t bw_step = 2 * num_fw_ops - 1 - step;
+    if (step % kOpsPerLayer == 0) {
+      // Layer input, used by the residual add at the end of the layer and
+      // saved for the backward pass.
+      lifetimes.push_back({{0, tensor_id++}, size_dist(rng) * 16, step,
+                           bw_step});
+    } else if (step % 2 == 0) {
+      // Saved activation.
+      lifetimes.push_back({{0, tensor_id++}, size_dist(rng), step, bw_step});
+    } else {
+      // Temporary consumed by the next op.
+      lifetimes.push_back({{0, tensor_id++}, size_dist(rng) * 4, step,
+                           step + 1});
+    }
+    // Gradient of the mirror op, consumed by the next backward op and, for
+    // a layer output, by the residual branch.
+    size_t grad_end = (step == layer_begin) ? MIN(bw_step + kOpsPerLayer,
+                                                 2 * num_fw_ops - 1)
+                                            : bw_step + 1;
+    lifetimes.push_back({{0, tensor_id++}, size_dist(rng) * 4, bw_step,
+                         MIN(grad_end, 2 * num_fw_ops - 1)});
+  }
+  // Parameters of every layer, alive all the time.
+  for (size_t layer = 0; layer < num_layers; layer++)
+    lifetimes.push_back({{0, tensor_id++}, 128, 0, TensorLifetime::FOREVER});
+  std::shuffle(lifetimes.begin(), lifetimes.end(), rng);
+  return lifetimes;
+}
+
+// Checks that tensors alive at the same step never share memory.
+void CheckMemoryPlan(const std::vector<TensorLifetime>& lifetimes,
+                     const MemoryPlan& memory_plan,
+                     const MemoryPlanStats& stats) {
+  HT_ASSERT_EQ(memory_plan.size(), lifetimes.size());
+  for (size_t i = 0; i < lifetimes.size(); i++) {
+    auto [offset_i, size_i] = memory_plan.at(lifetimes[i].tensor_id);
+    HT_ASSERT_EQ(size_i, lifetimes[i].size);
+    HT_ASSERT_LE(offset_i + size_i, stats.planned_size);
+    for (size_t j = i + 1; j < lifetimes.size(); j++) {
+      if (lifetimes[i].end < lifetimes[j].begin ||
+          lifetimes[j].end < lifetimes[i].begin)
+        continue;
+      auto [offset_j, size_j] = memory_plan.at(lifetimes[j].tensor_id);
+      HT_ASSERT(offset_i + size_i <= offset_j || offset_j + size_j <= offset_i)
+        << "Tensors " << lifetimes[i].tensor_id.second << " and "
+        << lifetimes[j].tensor_id.second << " are alive at the same time "
+        << "but overlap in memory";
+    }
+  }
+  HT_ASSERT_LE(stats.peak_live_size, stats.planned_size);
+  HT_ASSERT_LE(stats.planned_size, stats.naive_size);
+}
+
+void TestMemoryPlanner(MemoryPlanStrategy strategy) {
+  HT_LOG_INFO << "Testing MemoryPlanner with "
+              << MemoryPlanStrategy2Str(strategy) << "...";
+  // Hand-written case: a and b are alive together, c reuses a.
+  std::vector<TensorLifetime> lifetimes = {
+    {{0, 0}, 4, 0, 1}, {{0, 1}, 2, 1, 3}, {{0, 2}, 4, 2, 3}};
+  MemoryPlanStats stats;
+  auto memory_plan = MemoryPlanner::Plan(lifetimes, strategy, &stats);
+  CheckMemoryPlan(lifetimes, memory_plan, stats);
+  HT_ASSERT_EQ(stats.planned_size, 6);
+  HT_ASSERT_EQ(stats.peak_live_size, 6);
+  HT_ASSERT_EQ(stats.naive_size, 10);
+
+  for (size_t num_ops : {1, 16, 100, 2000}) {
+    lifetimes = MakeTrainingLifetimes(num_ops, num_ops);
+    memory_plan = MemoryPlanner::Plan(lifetimes, strategy, &stats);
+    CheckMemoryPlan(lifetimes, memory_plan, stats);
+  }
+  HT_LOG_INFO << "Testing MemoryPlanner with "
+              << MemoryPlanStrategy2Str(strategy) << " done";
+}
+
+void BenchmarkMemoryPlanner() {
+  for (size_t num_ops : {10000, 30000, 100000}) {
+    auto lifetimes = MakeTrainingLifetimes(num_ops);
+    for (auto strategy : {MemoryPlanStrategy::BEST_FIT,
+                          MemoryPlanStrategy::GREEDY_BY_SIZE}) {
+      MemoryPlanStats stats;
+      // Planning runs on this thread, so there is nothing to sync.
+      double ms = time_it(
+        [&]() { MemoryPlanner::Plan(lifetimes, strategy, &stats); }, 3,
+        []() {});
+      HT_LOG_INFO << MemoryPlanStrategy2Str(strategy) << " on " << num_ops
+                  << " ops: " << ms << " ms, " << stats;
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  TestMemoryPlanner(MemoryPlanStrategy::BEST_FIT);
+  TestMemoryPlanner(MemoryPlanStrategy::GREEDY_BY_SIZE);
+  BenchmarkMemoryPlanner();
+  return 0;
+}
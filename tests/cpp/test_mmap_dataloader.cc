@@ -0,0 +1,221 @@
+#include "hetu/graph/data/mmap_dataloader.h"
+#include "hetu/impl/stream/CPUStream.h"
+#include "test_utils.h"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <set>
+#include <unistd.h>
+
+using namespace hetu;
+using namespace hetu::graph;
+
+constexpr int64_t SEQ_LEN = 16;
+
+// Writes shards of int64 token ids, where token j of sample i is
+// i * SEQ_LEN + j, so that every sample tells where it comes from.
+std::vector<std::string> WriteShards(const std::vector<int64_t>& shard_samples) {
+  std::vector<std::string> paths;
+  int64_t sample = 0;
+  for (size_t i = 0; i < shard_samples.size(); i++) {
+    paths.push_back("/tmp/hetu_test_mmap_dataloader_" +
+                    std::to_string(getpid()) + "_" + std::to_string(i) +
+                    ".bin");
+    std::vector<int64_t> tokens;
+    for (int64_t s = 0; s < shard_samples[i]; s++, sample++)
+      for (int64_t j = 0; j < SEQ_LEN; j++)
+        tokens.push_back(sample * SEQ_LEN + j);
+    std::ofstream out(paths.back(), std::ios::binary);
+    out.write(reinterpret_cast<const char*>(tokens.data()),
+              tokens.size() * sizeof(int64_t));
+  }
+  return paths;
+}
+
+void RemoveShards(const std::vector<std::string>& paths) {
+  for (const auto& path : paths)
+    std::remove(path.c_str());
+}
+
+// Returns the first sample of the batch after checking that its samples
+// are consecutive.
+int64_t CheckBatch(const NDArray& batch, int64_t batch_size) {
+  HT_ASSERT(batch.is_defined()) << "Batch is undefined";
+  HT_ASSERT(batch->shape() == HTShape({batch_size, SEQ_LEN}))
+    << "Unexpected batch shape " << batch->shape();
+  const int64_t* tokens = batch->data_ptr<int64_t>();
+  int64_t first = tokens[0] / SEQ_LEN;
+  for (int64_t i = 0; i < batch_size * SEQ_LEN; i++)
+    HT_ASSERT_EQ(tokens[i], first * SEQ_LEN + i)
+      << "Mismatched token on position " << i;
+  return first;
+}
+
+void TestDatasetSlice() {
+  HT_LOG_INFO << "Testing slices of a sharded dataset...";
+  auto paths = WriteShards({10, 7, 13});
+  {
+    MmapDataset dataset(paths, {SEQ_LEN}, kInt64);
+    HT_ASSERT_EQ(dataset.num_samples(), 30);
+    HT_ASSERT_EQ(dataset.num_shards(), 3);
+    // inside one shard, the slice views the mapping
+    auto view = dataset.Slice(11, 15);
+    HT_ASSERT_EQ(CheckBatch(view, 4), 11);
+    HT_ASSERT(view->raw_data_ptr() == dataset.Slice(11, 12)->raw_data_ptr())
+      << "Slices inside one shard should not be copied";
+    // across shards, the samples are gathered
+    auto gathered = dataset.Slice(8, 19);
+    HT_ASSERT_EQ(CheckBatch(gathered, 11), 8);
+    // views keep the mapping alive after the dataset is gone
+    auto dangling = std::make_shared<MmapDataset>(paths, HTShape({SEQ_LEN}),
+                                                  kInt64)
+                      ->Slice(20, 30);
+    HT_ASSERT_EQ(CheckBatch(dangling, 10), 20);
+  }
+  RemoveShards(paths);
+}
+
+void TestDataloaderEpochs(bool shuffle, int prefetch_depth, int num_workers) {
+  HT_LOG_INFO << "Testing dataloader with shuffle = " << shuffle
+              << ", prefetch depth = " << prefetch_depth
+              << ", workers = " << num_workers << "...";
+  auto paths = WriteShards({25, 25, 50});
+  {
+    auto dataset =
+      std::make_shared<MmapDataset>(paths, HTShape({SEQ_LEN}), kInt64);
+    const int batch_size = 8;
+    MmapDataloader loader(dataset, batch_size, prefetch_depth, num_workers,
+                          shuffle, true, 42);
+    HT_ASSERT_EQ(loader.batch_num(), 12);
+    std::vector<std::vector<int64_t>> epochs;
+    for (int epoch = 0; epoch < 2; epoch++) {
+      loader.reset(epoch);
+      std::vector<int64_t> firsts;
+      std::set<int64_t> seen;
+      for (NDArray batch = loader.next_batch(); batch.is_defined();
+           batch = loader.next_batch()) {
+        int64_t first = CheckBatch(batch, batch_size);
+        HT_ASSERT_EQ(first % batch_size, 0);
+        HT_ASSERT(seen.insert(first).second) << "Batch read twice";
+        firsts.push_back(first);
+      }
+      HT_ASSERT_EQ(firsts.size(), loader.batch_num());
+      epochs.push_back(firsts);
+    }
+    if (shuffle) {
+      HT_ASSERT(epochs[0] != epochs[1]) << "Epochs are not reshuffled";
+      // the same seed gives the same order
+      MmapDataloader other(dataset, batch_size, 1, 1, true, true, 42);
+      other.reset(1);
+      for (auto first : epochs[1])
+        HT_ASSERT_EQ(CheckBatch(other.next_batch(), batch_size), first);
+    } else {
+      for (size_t i = 0; i < epochs[0].size(); i++)
+        HT_ASSERT_EQ(epochs[0][i], i * batch_size);
+    }
+  }
+  RemoveShards(paths);
+}
+
+void TestDataloaderDPRanks() {
+  HT_LOG_INFO << "Testing dataloader sharded by dp ranks...";
+  auto paths = WriteShards({30, 33});
+  {
+    auto dataset =
+      std::make_shared<MmapDataset>(paths, HTShape({SEQ_LEN}), kInt64);
+    const int dp_nrank = 4, batch_size = 5;
+    std::set<int64_t> seen;
+    for (int rank = 0; rank < dp_nrank; rank++) {
+      MmapDataloader loader(dataset, batch_size, 2, 2, true, false, 7);
+      loader.set_dp_rank(rank, dp_nrank);
+      // 63 samples give 15 to each rank, i.e., 3 full batches
+      HT_ASSERT_EQ(loader.batch_num(), 3);
+      for (NDArray batch = loader.next_batch(); batch.is_defined();
+           batch = loader.next_batch()) {
+        int64_t first = CheckBatch(batch, batch_size);
+        HT_ASSERT(first >= rank * 15 && first + batch_size <= (rank + 1) * 15)
+          << "Batch from " << first << " is not owned by rank " << rank;
+        HT_ASSERT(seen.insert(first).second) << "Batch read by two ranks";
+      }
+    }
+    HT_ASSERT_EQ(seen.size(), dp_nrank * 3);
+  }
+  RemoveShards(paths);
+}
+
+void TestMappingsReleased() {
+  HT_LOG_INFO << "Testing release of dataset mappings...";
+  auto paths = WriteShards({24, 24});
+  // loading twice leaves no mappings of the first load behind
+  for (int round = 0; round < 2; round++) {
+    NDArray view;
+    {
+      auto dataset =
+        std::make_shared<MmapDataset>(paths, HTShape({SEQ_LEN}), kInt64);
+      for (const auto& path : paths)
+        HT_ASSERT_GT(num_mappings(path), 0);
+      HT_ASSERT_EQ(CheckBatch(dataset->Slice(20, 28), 8), 20);
+      view = dataset->Slice(30, 34);
+      // batches are prepared on worker streams
+      MmapDataloader loader(dataset, 8, 2, 2, true, true, round);
+      loader.reset(0);
+      for (NDArray batch = loader.next_batch(); batch.is_defined();
+           batch = loader.next_batch())
+        CheckBatch(batch, 8);
+    }
+    // the view keeps its shard mapped after the dataset is gone
+    SynchronizeAllStreams(Device(kCPU));
+    HT_ASSERT_EQ(num_mappings(paths[0]), 0)
+      << "Mappings of the dataset are not released";
+    HT_ASSERT_GT(num_mappings(paths[1]), 0);
+    HT_ASSERT_EQ(CheckBatch(view, 4), 30);
+    view = NDArray();
+    SynchronizeAllStreams(Device(kCPU));
+    HT_ASSERT_EQ(num_mappings(paths[1]), 0)
+      << "Mappings of views are not released";
+  }
+  RemoveShards(paths);
+}
+
+void BenchmarkDataloader(int64_t num_samples = 1 << 14,
+                         int64_t seq_len = 1024) {
+  std::string path = "/tmp/hetu_bench_mmap_dataloader_" +
+    std::to_string(getpid()) + ".bin";
+  {
+    std::vector<int32_t> tokens(num_samples * seq_len, 1);
+    std::ofstream out(path, std::ios::binary);
+    out.write(reinterpret_cast<const char*>(tokens.data()),
+              tokens.size() * sizeof(int32_t));
+  }
+  {
+    auto dataset =
+      std::make_shared<MmapDataset>(std::vector<std::string>{path},
+                                    HTShape({seq_len}), kInt32);
+    MmapDataloader loader(dataset, 32, 4, 2, true);
+    auto start = std::chrono::steady_clock::now();
+    int64_t checksum = 0;
+    for (NDArray batch = loader.next_batch(); batch.is_defined();
+         batch = loader.next_batch())
+      checksum += batch->data_ptr<int32_t>()[0];
+    double sec = std::chrono::duration<double>(
+                   std::chrono::steady_clock::now() - start)
+                   .count();
+    HT_ASSERT_EQ(checksum, loader.batch_num());
+    HT_LOG_INFO << "Streamed " << loader.batch_num() << " batches ("
+                << num_samples * seq_len * sizeof(int32_t) / 1e6
+                << " MB) in " << sec * 1e3 << " ms";
+  }
+  std::remove(path.c_str());
+}
+
+int main(int argc, char** argv) {
+  TestDatasetSlice();
+  for (bool shuffle : {false, true}) {
+    TestDataloaderEpochs(shuffle, 1, 1);
+    TestDataloaderEpochs(shuffle, 3, 2);
+  }
+  TestDataloaderDPRanks();
+  TestMappingsReleased();
+  BenchmarkDataloader();
+  return 0;
+}
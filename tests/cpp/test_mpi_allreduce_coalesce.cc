@@ -0,0 +1,94 @@
+#include "hetu/impl/communication/mpi_comm_group.h"
+#include "test_utils.h"
+
+using namespace hetu;
+using namespace hetu::impl;
+using namespace hetu::impl::comm;
+
+// Run with `mpirun -np N ./test_mpi_allreduce_coalesce` on a single host.
+// HETU_MPI_BUCKET_SIZE_MB sets the bucket size of the pipeline.
+
+// Mixes tiny arrays with arrays spanning several buckets.
+const HTShapeList TEST_SHAPES = {{3}, {1024, 1023}, {17}, {2, 1500000}, {1}};
+
+void TestAllReduceCoalesce(DataType dtype) {
+  HT_LOG_INFO << "Testing AllReduceCoalesce for type " << dtype << "...";
+  auto& group = MPICommunicationGroup::GetOrCreateWorldwide();
+  const double scalar_of_rank = (group->rank() + 1) * 0.5;
+  const double reduced_scalar =
+    ((group->size() + 1) * group->size() / 2) * 0.5;
+  int64_t total_numel = 0;
+  for (const auto& shape : TEST_SHAPES)
+    total_numel += NumEl(shape);
+
+  // Separate arrays, packed into the buffer.
+  NDArrayList inputs, outputs;
+  for (const auto& shape : TEST_SHAPES) {
+    inputs.push_back(NDArray::full(shape, scalar_of_rank, kCPU, dtype));
+    outputs.push_back(NDArray::empty(shape, kCPU, dtype));
+  }
+  NDArray buffer = NDArray::empty({total_numel}, kCPU, dtype);
+  // Arrays living in a persistent flat buffer, reduced in place.
+  NDArray flat_buffer =
+    NDArray::full({total_numel}, scalar_of_rank, kCPU, dtype);
+  NDArrayList views = MakeCoalescedViews(flat_buffer, TEST_SHAPES);
+  // Separate arrays without a buffer.
+  NDArrayList unbuffered;
+  for (const auto& shape : TEST_SHAPES)
+    unbuffered.push_back(NDArray::full(shape, scalar_of_rank, kCPU, dtype));
+  SynchronizeAllStreams();
+
+  group->AllReduceCoalesce(inputs, outputs, buffer);
+  group->AllReduceCoalesce(views, views, flat_buffer);
+  group->AllReduceCoalesce(unbuffered, unbuffered, NDArray());
+  group->Sync();
+  for (size_t i = 0; i < TEST_SHAPES.size(); i++) {
+    assert_fuzzy_eq(inputs[i], scalar_of_rank);
+    assert_fuzzy_eq(outputs[i], reduced_scalar);
+    assert_fuzzy_eq(views[i], reduced_scalar);
+    assert_fuzzy_eq(unbuffered[i], reduced_scalar);
+  }
+  group->Barrier(true);
+  HT_LOG_INFO << "Testing AllReduceCoalesce for type " << dtype << " done";
+}
+
+// Reports the algorithm bandwidth (bytes of the arrays per second) of
+// coalesced all-reduce over many gradient-sized arrays.
+void BenchmarkAllReduceCoalesce(int64_t num_arrays = 256,
+                                int64_t numel = 65536) {
+  auto& group = MPICommunicationGroup::GetOrCreateWorldwide();
+  HTShapeList shapes(num_arrays, HTShape{numel});
+  NDArrayList arrays;
+  for (const auto& shape : shapes)
+    arrays.push_back(NDArray::full(shape, 1, kCPU, kFloat32));
+  NDArray buffer = NDArray::empty({num_arrays * numel}, kCPU, kFloat32);
+  NDArray flat_buffer = NDArray::full({num_arrays * numel}, 1, kCPU, kFloat32);
+  NDArrayList views = MakeCoalescedViews(flat_buffer, shapes);
+  SynchronizeAllStreams();
+  auto sync = [&]() {
+    group->Sync();
+    group->Barrier(true);
+  };
+  double bytes = num_arrays * numel * sizeof(float);
+  double packed_ms = time_it(
+    [&]() { group->AllReduceCoalesce(arrays, arrays, buffer); }, 10, sync);
+  double flat_ms = time_it(
+    [&]() { group->AllReduceCoalesce(views, views, flat_buffer); }, 10, sync);
+  double unbuffered_ms = time_it(
+    [&]() { group->AllReduceCoalesce(arrays, arrays, NDArray()); }, 10,
+    sync);
+  if (group->rank() == 0)
+    HT_LOG_INFO << "AllReduceCoalesce of " << num_arrays << " x " << numel
+                << " floats over " << group->size() << " ranks: packed "
+                << bytes / packed_ms / 1e6 << " GB/s, flat buffer "
+                << bytes / flat_ms / 1e6 << " GB/s, per-array "
+                << bytes / unbuffered_ms / 1e6 << " GB/s";
+  group->Barrier(true);
+}
+
+int main(int argc, char** argv) {
+  for (auto dtype : {kFloat32, kFloat64, kBFloat16})
+    TestAllReduceCoalesce(dtype);
+  BenchmarkAllReduceCoalesce();
+  return 0;
+}
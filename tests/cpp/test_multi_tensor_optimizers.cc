@@ -0,0 +1,174 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/graph/ops/kernel_links.h"
+#include "test_utils.h"
+#include <cmath>
+
+using namespace hetu;
+
+NDArrayList MakeTensors(const std::vector<int64_t>& sizes, DataType dtype,
+                        double fill_value = NAN) {
+  NDArrayList ret;
+  for (auto size : sizes)
+    ret.push_back(std::isnan(fill_value)
+                    ? NDArray::randn({size}, Device(kCPU), dtype)
+                    : NDArray::full({size}, fill_value, Device(kCPU), dtype));
+  return ret;
+}
+
+NDArrayList CopyTensors(const NDArrayList& tensors, DataType dtype) {
+  NDArrayList ret;
+  for (const auto& tensor : tensors)
+    ret.push_back(NDArray::to(tensor, Device(kCPU), dtype));
+  return ret;
+}
+
+void AssertListFuzzyEq(const NDArrayList& a, const NDArrayList& b,
+                       double atol, double rtol) {
+  SynchronizeAllStreams();
+  for (size_t t = 0; t < a.size(); t++) {
+    auto a_ = NDArray::to(a[t], Device(kCPU), kFloat32);
+    auto b_ = NDArray::to(b[t], Device(kCPU), kFloat32);
+    SynchronizeAllStreams();
+    for (size_t i = 0; i < a_->numel(); i++)
+      HT_ASSERT_FUZZY_EQ(a_->data_ptr<float>()[i], b_->data_ptr<float>()[i],
+                         atol, rtol)
+        << "Mismatched on position " << i << " of tensor " << t;
+  }
+}
+
+// Sizes cover tensors smaller than, equal to and spanning several chunks.
+const std::vector<int64_t> TEST_SIZES = {3, 1, 65536, 200003, 70000};
+
+NDArrayList MakeSteps(size_t num_steps) {
+  NDArrayList ret;
+  for (size_t i = 0; i < num_steps; i++)
+    ret.push_back(NDArray::full({1}, 1, Device(kCPU), kInt64));
+  return ret;
+}
+
+void TestMultiTensorAdamCpu() {
+  HT_LOG_INFO << "Testing MultiTensorAdam...";
+  Stream stream(Device(kCPU), kComputingStream);
+  auto grads = MakeTensors(TEST_SIZES, kFloat32);
+  auto params = MakeTensors(TEST_SIZES, kFloat32);
+  auto ref_params = CopyTensors(params, kFloat32);
+  auto means = MakeTensors(TEST_SIZES, kFloat32, 0);
+  auto variances = MakeTensors(TEST_SIZES, kFloat32, 0);
+  auto ref_means = MakeTensors(TEST_SIZES, kFloat32, 0);
+  auto ref_variances = MakeTensors(TEST_SIZES, kFloat32, 0);
+  auto steps = MakeSteps(TEST_SIZES.size());
+  auto ref_steps = MakeSteps(TEST_SIZES.size());
+  NDArray found_inf;
+  // Per-tensor steps advance their own step.
+  for (int i = 0; i < 3; i++) {
+    hetu::impl::MultiTensorAdamCpu(grads, params, {}, means, variances, steps,
+                                   1e-2, 0.9, 0.999, 1e-8, 0.01, 1.0, 0,
+                                   found_inf, true, stream);
+    for (size_t t = 0; t < params.size(); t++)
+      hetu::impl::AdamCpu(grads[t], ref_params[t], ref_means[t],
+                          ref_variances[t], ref_steps[t], 1e-2, 0.9, 0.999,
+                          1e-8, 0.01, true, stream);
+  }
+  SynchronizeAllStreams();
+  for (size_t t = 0; t < params.size(); t++) {
+    HT_ASSERT_EQ(steps[t]->data_ptr<int64_t>()[0], 4);
+    HT_ASSERT_EQ(ref_steps[t]->data_ptr<int64_t>()[0], 4);
+  }
+  AssertListFuzzyEq(params, ref_params, 1e-6, 1e-5);
+  AssertListFuzzyEq(variances, ref_variances, 1e-6, 1e-5);
+
+  // A non-finite gradient skips the whole step.
+  grads[3]->data_ptr<float>()[1234] = INFINITY;
+  found_inf = NDArray::empty({1});
+  auto before = CopyTensors(params, kFloat32);
+  hetu::impl::MultiTensorAdamCpu(grads, params, {}, means, variances, steps,
+                                 1e-2, 0.9, 0.999, 1e-8, 0.01, 1.0, 0,
+                                 found_inf, true, stream);
+  SynchronizeAllStreams();
+  HT_ASSERT_EQ(found_inf->data_ptr<float>()[0], 1.f);
+  HT_ASSERT_EQ(steps[0]->data_ptr<int64_t>()[0], 4);
+  AssertListFuzzyEq(params, before, 0, 0);
+  HT_LOG_INFO << "Testing MultiTensorAdam done";
+}
+
+void TestMultiTensorSGDCpu(DataType dtype) {
+  HT_LOG_INFO << "Testing MultiTensorSGDUpdate for type " << dtype << "...";
+  Stream stream(Device(kCPU), kComputingStream);
+  bool low_precision = dtype == kFloat16 || dtype == kBFloat16;
+  auto grads = MakeTensors(TEST_SIZES, dtype);
+  auto params = MakeTensors(TEST_SIZES, dtype);
+  // Half-precision parameters are updated through float32 master copies.
+  auto masters = low_precision ? CopyTensors(params, kFloat32) : NDArrayList();
+  auto ref_params = CopyTensors(params, kFloat32);
+  auto velocities = MakeTensors(TEST_SIZES, kFloat32, 0);
+  auto ref_velocities = MakeTensors(TEST_SIZES, kFloat32, 0);
+  if (!low_precision)
+    velocities = CopyTensors(velocities, dtype);
+  // Unscale by 0.5 and clip to a global norm of 10.
+  float grad_scale = 0.5, max_grad_norm = 10;
+  double sum_squares = 0;
+  for (const auto& grad : CopyTensors(grads, kFloat32)) {
+    SynchronizeAllStreams();
+    for (size_t i = 0; i < grad->numel(); i++)
+      sum_squares += std::pow(grad->data_ptr<float>()[i] * grad_scale, 2);
+  }
+  double coef =
+    grad_scale * max_grad_norm / (std::sqrt(sum_squares) + 1e-6);
+  NDArray found_inf = NDArray::empty({1});
+  for (int i = 0; i < 2; i++) {
+    hetu::impl::MultiTensorSGDUpdateCpu(grads, params, masters, velocities,
+                                        0.1, 0.9, false, grad_scale,
+                                        max_grad_norm, found_inf, stream);
+    for (size_t t = 0; t < params.size(); t++) {
+      auto scaled_grad = NDArray::mul(NDArray::to(grads[t], Device(kCPU),
+                                                  kFloat32),
+                                      coef);
+      hetu::impl::SGDUpdateCpu(scaled_grad, ref_params[t], ref_velocities[t],
+                               0.1, 0.9, false, stream);
+    }
+  }
+  SynchronizeAllStreams();
+  HT_ASSERT_EQ(found_inf->data_ptr<float>()[0], 0.f);
+  AssertListFuzzyEq(low_precision ? masters : params, ref_params, 1e-5, 1e-4);
+  if (low_precision)
+    AssertListFuzzyEq(params, masters, 1e-2, 1e-2);
+  HT_LOG_INFO << "Testing MultiTensorSGDUpdate for type " << dtype << " done";
+}
+
+// Compares one multi-tensor Adam step with per-tensor Adam steps over many
+// small parameters. Bandwidth counts reads and writes of params, grads and
+// both states.
+void BenchmarkMultiTensorAdamCpu(int64_t num_tensors = 400,
+                                 int64_t size = 16384) {
+  Stream stream(Device(kCPU), kComputingStream);
+  std::vector<int64_t> sizes(num_tensors, size);
+  auto grads = MakeTensors(sizes, kFloat32, 1e-3);
+  auto params = MakeTensors(sizes, kFloat32, 1);
+  auto means = MakeTensors(sizes, kFloat32, 0);
+  auto variances = MakeTensors(sizes, kFloat32, 0);
+  auto steps = MakeSteps(num_tensors);
+  NDArray found_inf;
+  double fused_ms = time_it([&]() {
+    hetu::impl::MultiTensorAdamCpu(grads, params, {}, means, variances, steps,
+                                   1e-3, 0.9, 0.999, 1e-8, 0, 1.0, 0,
+                                   found_inf, false, stream);
+  });
+  double per_tensor_ms = time_it([&]() {
+    for (int64_t t = 0; t < num_tensors; t++)
+      hetu::impl::AdamCpu(grads[t], params[t], means[t], variances[t],
+                          steps[t], 1e-3, 0.9, 0.999, 1e-8, 0, false, stream);
+  });
+  double bytes = 7.0 * num_tensors * size * sizeof(float);
+  HT_LOG_INFO << "Adam over " << num_tensors << " tensors of " << size
+              << " floats: multi-tensor " << bytes / fused_ms / 1e6
+              << " GB/s, per-tensor " << bytes / per_tensor_ms / 1e6
+              << " GB/s";
+}
+
+int main(int argc, char** argv) {
+  TestMultiTensorAdamCpu();
+  for (auto dtype : {kFloat32, kFloat16, kBFloat16})
+    TestMultiTensorSGDCpu(dtype);
+  BenchmarkMultiTensorAdamCpu();
+  return 0;
+}
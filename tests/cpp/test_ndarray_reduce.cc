@@ -0,0 +1,163 @@
+#include "hetu/core/ndarray.h"
+#include "hetu/graph/ops/kernel_links.h"
+#include "test_utils.h"
+#include <cmath>
+
+using namespace hetu;
+
+constexpr auto TEST_DATA_TYPES = {kFloat32, kFloat64, kFloat16,
+                                  kBFloat16, kInt32,  kInt64};
+constexpr auto TEST_REDUCTION_TYPES = {kSUM, kMEAN, kPROD, kMAX, kMIN};
+
+void FillPattern(NDArray& array) {
+  HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
+    array->dtype(), spec_t, "FillPattern", [&]() {
+      auto* ptr = array->data_ptr<spec_t>();
+      for (size_t i = 0; i < array->numel(); i++)
+        ptr[i] = static_cast<spec_t>((i * 7) % 5 * 0.125 + 0.75);
+    });
+}
+
+// Reduces `input` over `axes` element by element in double precision.
+std::vector<double> NaiveReduce(const NDArray& input, const HTAxes& axes,
+                                ReductionType red_type) {
+  auto parsed_axes = NDArrayMeta::ParseAxes(axes, input->ndim());
+  std::vector<bool> reduced(input->ndim(), false);
+  for (auto axis : parsed_axes)
+    reduced[axis] = true;
+  auto out_shape = NDArrayMeta::Reduce(input->shape(), parsed_axes, false);
+  int64_t num_outputs = NumEl(out_shape);
+  int64_t num_reduced = input->numel() / MAX(num_outputs, 1);
+  double init = red_type == kPROD ? 1
+    : red_type == kMAX            ? -INFINITY
+    : red_type == kMIN            ? INFINITY
+                                  : 0;
+  std::vector<double> ret(num_outputs, init);
+  HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
+    input->dtype(), spec_t, "NaiveReduce", [&]() {
+      const auto* ptr = input->data_ptr<spec_t>();
+      for (size_t i = 0; i < input->numel(); i++) {
+        int64_t rest = i, offset = 0, out_idx = 0, out_mul = 1;
+        for (int64_t d = input->ndim() - 1; d >= 0; d--) {
+          int64_t idx = rest % input->shape(d);
+          rest /= input->shape(d);
+          offset += idx * input->stride(d);
+          if (!reduced[d]) {
+            out_idx += idx * out_mul;
+            out_mul *= input->shape(d);
+          }
+        }
+        double val = static_cast<double>(ptr[offset]);
+        double& acc = ret[out_idx];
+        if (red_type == kPROD)
+          acc *= val;
+        else if (red_type == kMAX)
+          acc = std::max(acc, val);
+        else if (red_type == kMIN)
+          acc = std::min(acc, val);
+        else
+          acc += val;
+      }
+    });
+  if (red_type == kMEAN)
+    for (auto& val : ret)
+      val /= num_reduced;
+  return ret;
+}
+
+void TestReduce(const NDArray& input, const HTAxes& axes,
+                ReductionType red_type, double rtol) {
+  auto output = NDArray::reduce(input, red_type, axes);
+  SynchronizeAllStreams();
+  auto expected = NaiveReduce(input, axes, red_type);
+  HT_ASSERT_EQ(output->numel(), expected.size());
+  HT_DISPATCH_INTEGER_AND_FLOATING_TYPES(
+    output->dtype(), spec_t, "TestReduce", [&]() {
+      const auto* ptr = output->data_ptr<spec_t>();
+      for (size_t i = 0; i < expected.size(); i++) {
+        // Integer means are truncated.
+        double truth = static_cast<double>(static_cast<spec_t>(expected[i]));
+        HT_ASSERT_FUZZY_EQ(static_cast<double>(ptr[i]), truth, 1e-6, rtol)
+          << "Mismatched on position " << i << " of " << red_type
+          << " over axes " << axes << " for shape " << input->shape()
+          << " and stride " << input->stride();
+      }
+    });
+}
+
+void TestReduceCpu(DataType dtype) {
+  HT_LOG_INFO << "Testing NDArray Reduce for type " << dtype << "...";
+  bool low_precision = dtype == kFloat16 || dtype == kBFloat16;
+  double rtol = low_precision ? 2e-2 : 1e-5;
+  auto array = NDArray::empty({6, 33, 40}, Device(kCPU), dtype);
+  FillPattern(array);
+  std::vector<NDArray> inputs = {
+    array,
+    // non-contiguous views
+    NDArray::permute(array, {2, 0, 1}),
+    NDArray::as_strided(array, {6, 11, 20}, {1320, 120, 2}, 1),
+  };
+  const std::vector<HTAxes> axes_list = {{},     {0},    {1},   {2},
+                                         {0, 2}, {1, 2}, {-1, 0}};
+  for (const auto& input : inputs) {
+    for (const auto& axes : axes_list) {
+      for (auto red_type : TEST_REDUCTION_TYPES) {
+        // Products of thousands of elements over- or underflow.
+        if (red_type == kPROD && axes.size() != 1)
+          continue;
+        TestReduce(input, axes, red_type,
+                   red_type == kPROD ? MAX(rtol, 1e-4) : rtol);
+      }
+    }
+  }
+  // Max and min propagate NaNs.
+  if (dtype == kFloat32) {
+    auto with_nan = NDArray::full({4, 1000}, 1.0, Device(kCPU), dtype);
+    SynchronizeAllStreams();
+    with_nan->data_ptr<float>()[2 * 1000 + 517] = NAN;
+    for (auto red_type : {kMAX, kMIN}) {
+      auto output = NDArray::reduce(with_nan, red_type, {1});
+      SynchronizeAllStreams();
+      for (int i = 0; i < 4; i++)
+        HT_ASSERT_EQ(std::isnan(output->data_ptr<float>()[i]), i == 2)
+          << "NaN is not propagated by " << red_type;
+    }
+  }
+  HT_LOG_INFO << "Testing NDArray Reduce for type " << dtype << " done";
+}
+
+// Compares the native reduction kernels with the oneDNN-based ones, which
+// only support SUM and MEAN.
+void BenchmarkReduceCpu(const HTShape& shape = {2048, 4096}) {
+  auto input = NDArray::rand(shape, Device(kCPU), kFloat32);
+  const std::vector<HTAxes> axes_list = {{0}, {1}, {}};
+  for (const auto& axes : axes_list) {
+    for (auto red_type : {kSUM, kMEAN}) {
+      auto out_shape = NDArrayMeta::Reduce(shape, axes, true);
+      auto native_out = NDArray::empty(out_shape, Device(kCPU), kFloat32);
+      auto dnnl_out = NDArray::empty(out_shape, Device(kCPU), kFloat32);
+      Stream stream(Device(kCPU), kComputingStream);
+      double native_ms = time_it([&]() {
+        hetu::impl::ReduceCpu(input, native_out, axes, red_type, stream);
+      }, 20);
+      double dnnl_ms = time_it([&]() {
+        hetu::impl::DNNLReduceCpu(input, dnnl_out, axes, red_type, stream);
+      }, 20);
+      for (size_t i = 0; i < native_out->numel(); i++)
+        HT_ASSERT_FUZZY_EQ(native_out->data_ptr<float>()[i],
+                           dnnl_out->data_ptr<float>()[i], 1e-4, 1e-4)
+          << "Mismatched on position " << i << " of " << red_type
+          << " over axes " << axes;
+      HT_LOG_INFO << red_type << " over axes " << axes << " of " << shape
+                  << ": native " << native_ms << " ms, dnnl " << dnnl_ms
+                  << " ms";
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  for (const auto& dtype : TEST_DATA_TYPES)
+    TestReduceCpu(dtype);
+  BenchmarkReduceCpu();
+  return 0;
+}
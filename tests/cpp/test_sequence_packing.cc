@@ -0,0 +1,233 @@
+#include "hetu/graph/data/sequence_packing.h"
+#include "test_utils.h"
+#include <chrono>
+#include <random>
+
+using namespace hetu;
+using namespace hetu::graph;
+
+constexpr int64_t PAD_TOKEN = -1;
+
+// Every sequence is packed exactly once and no micro batch overflows.
+void CheckPlan(const PackingPlan& plan, const std::vector<int64_t>& seqlens,
+               int64_t max_seqlen, int64_t alignment) {
+  std::vector<int> packed_times(seqlens.size(), 0);
+  HT_ASSERT_EQ(plan.micro_batches.size(), plan.packed_seqlens.size());
+  for (size_t i = 0; i < plan.num_micro_batches(); i++) {
+    int64_t num_tokens = 0;
+    for (auto seq : plan.micro_batches[i]) {
+      packed_times[seq]++;
+      num_tokens += seqlens[seq];
+    }
+    HT_ASSERT(num_tokens <= max_seqlen)
+      << "Micro batch " << i << " has " << num_tokens << " tokens";
+    HT_ASSERT(plan.packed_seqlens[i] >= num_tokens &&
+              plan.packed_seqlens[i] % alignment == 0)
+      << "Invalid packed seqlen " << plan.packed_seqlens[i] << " of "
+      << num_tokens << " tokens";
+  }
+  for (size_t seq = 0; seq < seqlens.size(); seq++)
+    HT_ASSERT_EQ(packed_times[seq], 1) << "Sequence " << seq;
+}
+
+void TestFirstFitDecreasing() {
+  HT_LOG_INFO << "Testing first-fit decreasing packing...";
+  auto plan = PlanFirstFitDecreasing({3, 7, 1, 5, 4}, 10, 4);
+  HT_ASSERT(plan.micro_batches ==
+            std::vector<std::vector<int64_t>>({{1, 0}, {3, 4, 2}}))
+    << "Unexpected micro batches";
+  HT_ASSERT(plan.packed_seqlens == std::vector<int64_t>({12, 12}))
+    << "Unexpected packed seqlens " << plan.packed_seqlens;
+  auto static_plan = PlanFirstFitDecreasing({3, 7, 1, 5, 4}, 10, 4, true);
+  HT_ASSERT(static_plan.packed_seqlens == std::vector<int64_t>({10, 10}))
+    << "Unexpected static packed seqlens " << static_plan.packed_seqlens;
+
+  std::mt19937_64 rng(2024);
+  std::uniform_int_distribution<int64_t> dist(0, 4096);
+  std::vector<int64_t> seqlens(2000);
+  for (auto& seqlen : seqlens)
+    seqlen = dist(rng);
+  CheckPlan(PlanFirstFitDecreasing(seqlens, 4096, 128), seqlens, 4096, 128);
+}
+
+void TestOptionMatrix() {
+  HT_LOG_INFO << "Testing packing with a batching option matrix...";
+  std::vector<int64_t> seqlens = {5, 9, 2, 6};
+  auto option_matrix = NDArray::empty({4, 3}, Device(kCPU), kBool);
+  const bool options[4][3] = {{1, 0, 0}, {0, 1, 0}, {1, 0, 0}, {0, 0, 1}};
+  std::copy(&options[0][0], &options[0][0] + 12,
+            option_matrix->data_ptr<bool>());
+  auto plan = PlanWithOptionMatrix(seqlens, option_matrix, 8);
+  HT_ASSERT(plan.micro_batches ==
+            std::vector<std::vector<int64_t>>({{0, 2}, {1}, {3}}))
+    << "Unexpected micro batches";
+  HT_ASSERT(plan.packed_seqlens == std::vector<int64_t>({8, 16, 8}))
+    << "Unexpected packed seqlens " << plan.packed_seqlens;
+}
+
+void TestPackSequences() {
+  HT_LOG_INFO << "Testing packing sequences into preallocated arrays...";
+  std::vector<int64_t> seqlens = {6, 3, 9, 1, 4};
+  NDArrayList seqs;
+  for (size_t i = 0; i < seqlens.size(); i++) {
+    seqs.push_back(NDArray::empty({seqlens[i]}, Device(kCPU), kInt32));
+    for (int64_t j = 0; j < seqlens[i]; j++)
+      seqs.back()->data_ptr<int32_t>()[j] = i * 100 + j;
+  }
+  auto plan = PlanFirstFitDecreasing(seqlens, 10, 4);
+  auto packed = NDArray::empty({plan.num_tokens()}, Device(kCPU), kInt32);
+  auto cu_seqlens = NDArray::empty(
+    {plan.num_seqs() + static_cast<int64_t>(plan.num_micro_batches())},
+    Device(kCPU), kInt32);
+  PackSequences(seqs, plan, PAD_TOKEN, packed, cu_seqlens);
+
+  auto micro_batches = SplitPackedMicroBatches(plan, packed);
+  auto cu_seqlens_list = SplitPackedCuSeqlens(plan, cu_seqlens);
+  HT_ASSERT_EQ(micro_batches.size(), plan.num_micro_batches());
+  for (size_t i = 0; i < plan.num_micro_batches(); i++) {
+    const int32_t* tokens = micro_batches[i]->data_ptr<int32_t>();
+    const int32_t* cu = cu_seqlens_list[i]->data_ptr<int32_t>();
+    HT_ASSERT_EQ(cu_seqlens_list[i]->numel(),
+                 plan.micro_batches[i].size() + 1);
+    HT_ASSERT_EQ(cu[0], 0);
+    for (size_t k = 0; k < plan.micro_batches[i].size(); k++) {
+      int64_t seq = plan.micro_batches[i][k];
+      HT_ASSERT_EQ(cu[k + 1] - cu[k], seqlens[seq]);
+      for (int64_t j = 0; j < seqlens[seq]; j++)
+        HT_ASSERT_EQ(tokens[cu[k] + j], seq * 100 + j);
+    }
+    for (int64_t j = cu[plan.micro_batches[i].size()];
+         j < plan.packed_seqlens[i]; j++)
+      HT_ASSERT_EQ(tokens[j], PAD_TOKEN) << "Position " << j;
+  }
+}
+
+// Rows of `num_tokens[r]` tokens right padded to `row_len`. Token j of row
+// r is r * row_len + j.
+NDArray MakeGlobalBatch(const std::vector<int64_t>& num_tokens,
+                        int64_t row_len) {
+  int64_t num_rows = num_tokens.size();
+  auto global_batch = NDArray::empty({num_rows, row_len}, Device(kCPU), kInt64);
+  int64_t* data = global_batch->data_ptr<int64_t>();
+  for (int64_t r = 0; r < num_rows; r++)
+    for (int64_t j = 0; j < row_len; j++)
+      data[r * row_len + j] = j < num_tokens[r] ? r * row_len + j : PAD_TOKEN;
+  return global_batch;
+}
+
+void TestBucketAndPackGlobalBatch() {
+  HT_LOG_INFO << "Testing bucketing and packing a global batch...";
+  const int64_t row_len = 512;
+  std::vector<int64_t> bucket_sizes = {512, 256, 64, 0};
+  std::mt19937_64 rng(7);
+  std::uniform_int_distribution<int64_t> dist(1, row_len);
+  std::vector<int64_t> num_tokens(300);
+  for (auto& n : num_tokens)
+    n = dist(rng);
+  auto global_batch = MakeGlobalBatch(num_tokens, row_len);
+  auto buckets =
+    BucketAndPackGlobalBatch(global_batch, PAD_TOKEN, bucket_sizes, 32);
+  HT_ASSERT_EQ(buckets.size(), 3);
+
+  std::vector<int> packed_times(num_tokens.size(), 0);
+  for (const auto& bucket : buckets) {
+    std::vector<int64_t> seqlens;
+    for (auto r : bucket.rows) {
+      seqlens.push_back(num_tokens[r] - 1);
+      HT_ASSERT(seqlens.back() > bucket.min_seqlen &&
+                seqlens.back() <= bucket.max_seqlen)
+        << "Row " << r << " is not in bucket (" << bucket.min_seqlen << ", "
+        << bucket.max_seqlen << "]";
+      packed_times[r]++;
+    }
+    CheckPlan(bucket.plan, seqlens, bucket.max_seqlen, 32);
+    auto inputs = SplitPackedMicroBatches(bucket.plan, bucket.input);
+    auto labels = SplitPackedMicroBatches(bucket.plan, bucket.label);
+    auto cu_seqlens_list = SplitPackedCuSeqlens(bucket.plan, bucket.cu_seqlens);
+    for (size_t i = 0; i < bucket.plan.num_micro_batches(); i++) {
+      const int64_t* input = inputs[i]->data_ptr<int64_t>();
+      const int64_t* label = labels[i]->data_ptr<int64_t>();
+      const int32_t* cu = cu_seqlens_list[i]->data_ptr<int32_t>();
+      for (size_t k = 0; k < bucket.plan.micro_batches[i].size(); k++) {
+        int64_t r = bucket.rows[bucket.plan.micro_batches[i][k]];
+        HT_ASSERT_EQ(cu[k + 1] - cu[k], num_tokens[r] - 1);
+        for (int64_t j = 0; j < num_tokens[r] - 1; j++) {
+          HT_ASSERT_EQ(input[cu[k] + j], r * row_len + j);
+          HT_ASSERT_EQ(label[cu[k] + j], r * row_len + j + 1);
+        }
+      }
+    }
+  }
+  for (size_t r = 0; r < num_tokens.size(); r++)
+    HT_ASSERT_EQ(packed_times[r], num_tokens[r] > 1 ? 1 : 0) << "Row " << r;
+}
+
+// Packs global batches whose row lengths follow several synthetic
+// distributions. Efficiency is the fraction of packed tokens that are not
+// padding.
+void BenchmarkBucketAndPack(int64_t num_rows = 512, int64_t row_len = 16384) {
+  std::vector<int64_t> bucket_sizes = {16384, 8192, 4096, 1024, 0};
+  std::mt19937_64 rng(1);
+  std::vector<std::pair<std::string, std::function<int64_t()>>> dists = {
+    {"uniform",
+     [&]() {
+       return std::uniform_int_distribution<int64_t>(2, row_len)(rng);
+     }},
+    {"lognormal",
+     [&]() {
+       double len = std::lognormal_distribution<double>(7.0, 1.0)(rng);
+       return std::clamp<int64_t>(len, 2, row_len);
+     }},
+    {"bimodal", [&]() {
+       bool is_long = std::bernoulli_distribution(0.1)(rng);
+       double len =
+         std::normal_distribution<double>(is_long ? 12000 : 600, 200)(rng);
+       return std::clamp<int64_t>(len, 2, row_len);
+     }}};
+  for (auto& dist : dists) {
+    std::vector<int64_t> num_tokens(num_rows);
+    for (auto& n : num_tokens)
+      n = dist.second();
+    auto global_batch = MakeGlobalBatch(num_tokens, row_len);
+    std::vector<PackedBucket> buckets;
+    double ms = time_it(
+      [&]() {
+        buckets =
+          BucketAndPackGlobalBatch(global_batch, PAD_TOKEN, bucket_sizes, 128);
+      },
+      5, []() {});
+    int64_t valid = 0, packed = 0, num_micro_batches = 0;
+    for (const auto& bucket : buckets) {
+      for (auto r : bucket.rows)
+        valid += num_tokens[r] - 1;
+      packed += bucket.plan.num_tokens();
+      num_micro_batches += bucket.plan.num_micro_batches();
+    }
+    HT_LOG_INFO << "Packed " << num_rows << " " << dist.first
+                << " sequences into " << num_micro_batches
+                << " micro batches in " << ms << " ms, efficiency "
+                << double(valid) / packed << " vs. "
+                << double(valid) / (num_rows * row_len) << " if padded";
+  }
+
+  std::vector<int64_t> seqlens(1 << 20);
+  for (auto& seqlen : seqlens)
+    seqlen = std::uniform_int_distribution<int64_t>(1, 4096)(rng);
+  auto start = std::chrono::steady_clock::now();
+  auto plan = PlanFirstFitDecreasing(seqlens, 4096);
+  double sec =
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+      .count();
+  HT_LOG_INFO << "Planned " << seqlens.size() << " sequences into "
+              << plan.num_micro_batches() << " micro batches in "
+              << sec * 1e3 << " ms";
+}
+
+int main(int argc, char** argv) {
+  TestFirstFitDecreasing();
+  TestOptionMatrix();
+  TestPackSequences();
+  TestBucketAndPackGlobalBatch();
+  BenchmarkBucketAndPack();
+  return 0;
+}
@@ -0,0 +1,111 @@
+#include "hetu/impl/utils/strided_copy.h"
+#include "test_utils.h"
+#include <random>
+
+using namespace hetu;
+using namespace hetu::impl;
+
+// Reference copy that recovers every index with divisions.
+template <typename spec_t>
+void NaiveStridedCopy(const spec_t* src, spec_t* dst, const HTShape& shape,
+                      const HTStride& src_stride, const HTStride& dst_stride) {
+  int64_t numel = NumEl(shape);
+  for (int64_t idx = 0; idx < numel; idx++) {
+    int64_t rest = idx, src_offset = 0, dst_offset = 0;
+    for (int i = static_cast<int>(shape.size()) - 1; i >= 0; i--) {
+      src_offset += (rest % shape[i]) * src_stride[i];
+      dst_offset += (rest % shape[i]) * dst_stride[i];
+      rest /= shape[i];
+    }
+    dst[dst_offset] = src[src_offset];
+  }
+}
+
+// Span of the elements addressed by non-negative strides.
+int64_t StridedSpan(const HTShape& shape, const HTStride& stride) {
+  if (NumEl(shape) == 0)
+    return 0;
+  int64_t span = 1;
+  for (size_t i = 0; i < shape.size(); i++)
+    span += (shape[i] - 1) * stride[i];
+  return span;
+}
+
+void CheckStridedCopy(const HTShape& shape, const HTStride& src_stride,
+                      const HTStride& dst_stride) {
+  std::vector<float> src(StridedSpan(shape, src_stride));
+  std::iota(src.begin(), src.end(), 0.0f);
+  std::vector<float> dst(StridedSpan(shape, dst_stride), -1.0f);
+  std::vector<float> expected(dst);
+  StridedCopy(src.data(), dst.data(), shape, src_stride, dst_stride);
+  NaiveStridedCopy(src.data(), expected.data(), shape, src_stride,
+                   dst_stride);
+  HT_ASSERT(dst == expected)
+    << "Wrong strided copy of shape " << shape << " from strides "
+    << src_stride << " to strides " << dst_stride;
+}
+
+HTStride Permute(const HTStride& stride, const HTAxes& perm) {
+  HTStride ret(perm.size());
+  for (size_t i = 0; i < perm.size(); i++)
+    ret[i] = stride[perm[i]];
+  return ret;
+}
+
+void TestStridedCopy() {
+  HT_LOG_INFO << "Testing StridedCopy...";
+  // Contiguous, including size-1 and empty dimensions.
+  CheckStridedCopy({7, 1, 5}, Shape2Stride({7, 1, 5}), Shape2Stride({7, 1, 5}));
+  CheckStridedCopy({3, 0, 2}, Shape2Stride({3, 0, 2}), Shape2Stride({3, 0, 2}));
+  CheckStridedCopy({}, {}, {});
+  // Transposes, tiled or not, with ragged tiles.
+  for (HTShape in_shape : HTShapeList{{70, 45}, {3, 33, 65}, {2, 5, 3, 4}}) {
+    HTAxes perm(in_shape.size());
+    std::iota(perm.rbegin(), perm.rend(), 0);
+    HTShape out_shape = Permute(in_shape, perm);
+    CheckStridedCopy(out_shape, Permute(Shape2Stride(in_shape), perm),
+                     Shape2Stride(out_shape));
+  }
+  CheckStridedCopy({4, 64, 40}, Permute(Shape2Stride({40, 4, 64}), {1, 2, 0}),
+                   Shape2Stride({4, 64, 40}));
+  // Slice of a larger array and its gradient.
+  CheckStridedCopy({5, 6, 7}, Shape2Stride({9, 10, 11}),
+                   Shape2Stride({5, 6, 7}));
+  CheckStridedCopy({5, 6, 7}, Shape2Stride({5, 6, 7}),
+                   Shape2Stride({9, 10, 11}));
+  // Concat gradient, i.e., a slice along the middle axis.
+  CheckStridedCopy({8, 3, 16}, Shape2Stride({8, 10, 16}),
+                   Shape2Stride({8, 3, 16}));
+  // Broadcasting source with zero strides.
+  CheckStridedCopy({6, 50, 40}, {0, 1, 0}, Shape2Stride({6, 50, 40}));
+  // Large enough to run in parallel.
+  CheckStridedCopy({3, 257, 129}, {1, 3 * 129, 3},
+                   Shape2Stride({3, 257, 129}));
+  HT_LOG_INFO << "Testing StridedCopy done";
+}
+
+// Reports the bandwidth (bytes read and written per second) of transposing
+// a float matrix, compared with the reference copy.
+void BenchmarkStridedCopy(int64_t rows = 2048, int64_t cols = 2048) {
+  std::vector<float> src(rows * cols, 1.0f), dst(rows * cols);
+  HTShape shape = {cols, rows};
+  HTStride src_stride = {1, cols};
+  HTStride dst_stride = Shape2Stride(shape);
+  double bytes = 2.0 * rows * cols * sizeof(float);
+  auto no_sync = []() {};
+  double strided_ms = time_it([&]() {
+    StridedCopy(src.data(), dst.data(), shape, src_stride, dst_stride);
+  }, 10, no_sync);
+  double naive_ms = time_it([&]() {
+    NaiveStridedCopy(src.data(), dst.data(), shape, src_stride, dst_stride);
+  }, 10, no_sync);
+  HT_LOG_INFO << "Transpose of " << rows << " x " << cols
+              << " floats: StridedCopy " << bytes / strided_ms / 1e6
+              << " GB/s, reference " << bytes / naive_ms / 1e6 << " GB/s";
+}
+
+int main(int argc, char** argv) {
+  TestStridedCopy();
+  BenchmarkStridedCopy();
+  return 0;
+}
@@ -3,6 +3,9 @@
 #include "hetu/core/ndarray.h"
 #include "hetu/impl/utils/ndarray_utils.h"
 #include "hetu/impl/utils/dispatch.h"
+#include <chrono>
+#include <fstream>
+#include <sstream>
 
 using hetu::operator<<;
 
@@ -71,3 +74,40 @@ void assert_fuzzy_eq(const hetu::NDArray& data, double value,
       }
     });
 }
+
+// The number of mappings of `path` in this process, e.g., to check that
+// mmap-ed files are released.
+size_t num_mappings(const std::string& path) {
+  std::ifstream maps("/proc/self/maps");
+  size_t ret = 0;
+  std::string line;
+  while (std::getline(maps, line)) {
+    std::istringstream fields(line);
+    std::string field, mapped;
+    for (int i = 0; i < 5; i++)
+      fields >> field;
+    fields >> mapped;
+    ret += mapped == path;
+  }
+  return ret;
+}
+
+void sync_all_streams() {
+  hetu::SynchronizeAllStreams();
+}
+
+// Milliseconds of one call of `fn`, averaged over `num_iters` calls after a
+// warm-up call. `sync` waits for the work of the calls.
+template <typename Fn, typename Sync = void (*)()>
+double time_it(Fn&& fn, int num_iters = 10, Sync sync = sync_all_streams) {
+  fn();
+  sync();
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < num_iters; i++)
+    fn();
+  sync();
+  return std::chrono::duration<double, std::milli>(
+           std::chrono::steady_clock::now() - start)
+           .count() /
+    num_iters;
+}
@@ -0,0 +1,53 @@
+import hetu
+import numpy as np
+import os
+import tempfile
+import unittest
+from safetensors.numpy import load_file
+
+class TestCheckpointAsync(unittest.TestCase):
+
+    _num_steps_after_save = 4
+
+    def test_snapshot_matches_weights_at_save(self):
+        local_device = hetu.local_device()
+        device_group = hetu.DeviceGroup([local_device])
+        ds_dup = hetu.DistributedStates(1, {-1: 1}, [-1])
+        g = hetu.graph('define_and_run')
+        with g:
+            n, dim = 8, 16
+            x = hetu.placeholder(hetu.float32, [n, dim], ds=ds_dup, device_group=device_group, name='x')
+            y = hetu.placeholder(hetu.float32, [n, dim], ds=ds_dup, device_group=device_group, name='y')
+            w = hetu.Tensor(np.random.normal(0, 1, (dim, dim)), dtype=hetu.float32, requires_grad=True,
+                            ds=ds_dup, device_group=device_group, name='w')
+            w2 = hetu.Tensor(np.random.normal(0, 1, (dim, dim)), dtype=hetu.float32, requires_grad=True,
+                             ds=ds_dup, device_group=device_group, name='w2')
+            pred = hetu.sigmoid(hetu.matmul(hetu.matmul(x, w), w2))
+            loss = hetu.binary_cross_entropy(pred, y, 'mean', name='bce_loss')
+            optimizer = hetu.SGDOptimizer(init_lr=0.1, max_lr=0.1, min_lr=0.1, lr_warmup_steps=0,
+                                           lr_decay_steps=1000, lr_decay_style='constant')
+            train_op = optimizer.minimize(loss)
+
+            def step():
+                feed_dict = {x: np.random.normal(0, 1, (n, dim)), y: np.zeros((n, dim))}
+                return g.graph.run(loss, [loss, w, w2, train_op], feed_dict=feed_dict)
+
+            # the weights fetched by a step are the ones after its update
+            ret = step()
+            expected = {'w': ret[1].numpy(force=True), 'w2': ret[2].numpy(force=True)}
+            with tempfile.TemporaryDirectory() as tmp_dir:
+                path = os.path.join(tmp_dir, 'model.safetensors')
+                g.graph.save_checkpoint_async(path)
+                # later updates must not leak into the snapshot
+                for _ in range(TestCheckpointAsync._num_steps_after_save):
+                    ret = step()
+                g.graph.wait_checkpoint()
+                self.assertFalse(np.array_equal(ret[1].numpy(force=True), expected['w']))
+                saved = load_file(path)
+                for name, value in expected.items():
+                    self.assertTrue(np.array_equal(saved[name], value),
+                                    f'{name} in the checkpoint differs from the weights at save time')
+
+if __name__ == '__main__':
+    hetu.init_comm_group(1)
+    unittest.main()
@@ -0,0 +1,34 @@
+import hetu
+import numpy as np
+import os
+import tempfile
+import unittest
+from safetensors.numpy import save_file
+
+class TestCheckpointLoader(unittest.TestCase):
+
+    def test_load_matches_saved(self):
+        tensors = {
+            'w': np.random.normal(0, 1, (8, 16)).astype(np.float32),
+            'b': np.arange(16, dtype=np.float32),
+            'step': np.array([3], dtype=np.int64),
+        }
+        with tempfile.TemporaryDirectory() as tmp_dir:
+            path = os.path.join(tmp_dir, 'model.safetensors')
+            save_file(tensors, path)
+            loaded = hetu.load_checkpoint([path])
+            self.assertEqual(sorted(loaded.keys()), sorted(tensors.keys()))
+            for name, value in tensors.items():
+                self.assertTrue(np.array_equal(loaded[name].numpy(force=True), value),
+                                f'{name} differs from the saved one')
+            # names missing from the files are skipped
+            loaded = hetu.load_checkpoint([path], ['w', 'missing'], verify=True)
+            self.assertEqual(list(loaded.keys()), ['w'])
+            # the arrays outlive the reader, and converting them copies
+            w = loaded['w'].to(hetu.float16)
+            del loaded
+            self.assertTrue(np.allclose(w.numpy(force=True).astype(np.float32), tensors['w'],
+                                        rtol=1e-3, atol=1e-3))
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,58 @@
+import hetu
+import math
+import numpy as np
+import os
+import unittest
+
+class TestElementwiseFusion(unittest.TestCase):
+
+    # Trains an MLP with a tanh GeLU and a residual connection and returns
+    # the losses of every step and the final weights. The bias additions, the
+    # GeLU and the residual, as well as their gradients, are chains of
+    # elementwise ops on CPU, which are fused unless
+    # HETU_ELEMENTWISE_FUSION=OFF.
+    def train(self, fusion, num_steps=4, seed=0):
+        os.environ['HETU_ELEMENTWISE_FUSION'] = 'ON' if fusion else 'OFF'
+        rng = np.random.default_rng(seed)
+        local_device = hetu.local_device()
+        device_group = hetu.DeviceGroup([local_device])
+        ds_dup = hetu.DistributedStates(1, {-1: 1}, [-1])
+        n, dim, hidden = 8, 16, 64
+        g = hetu.graph('define_and_run')
+        with g:
+            x = hetu.placeholder(hetu.float32, [n, dim], ds=ds_dup, device_group=device_group, name='x')
+            y = hetu.placeholder(hetu.float32, [n, dim], ds=ds_dup, device_group=device_group, name='y')
+            def param(shape, name):
+                return hetu.Tensor(rng.normal(0, 0.5, shape), dtype=hetu.float32, requires_grad=True,
+                                   ds=ds_dup, device_group=device_group, name=name)
+            w1, b1 = param((dim, hidden), 'w1'), param((hidden,), 'b1')
+            w2, b2 = param((hidden, dim), 'w2'), param((dim,), 'b2')
+            h = hetu.matmul(x, w1) + b1
+            h = 0.5 * h * (1.0 + hetu.tanh(math.sqrt(2.0 / math.pi) * (h + 0.044715 * (h * h * h))))
+            out = x + (hetu.matmul(h, w2) + b2)
+            pred = hetu.sigmoid(out)
+            loss = hetu.binary_cross_entropy(pred, y, 'mean', name='bce_loss')
+            optimizer = hetu.SGDOptimizer(init_lr=0.1, max_lr=0.1, min_lr=0.1, lr_warmup_steps=0,
+                                           lr_decay_steps=1000, lr_decay_style='constant')
+            train_op = optimizer.minimize(loss)
+            losses = []
+            for _ in range(num_steps):
+                feed_dict = {x: rng.normal(0, 1, (n, dim)), y: (rng.random((n, dim)) > 0.5).astype(np.float32)}
+                results = g.graph.run(loss, [loss, train_op], feed_dict=feed_dict)
+                losses.append(results[0].numpy(force=True))
+            feed_dict = {x: rng.normal(0, 1, (n, dim)), y: np.zeros((n, dim), dtype=np.float32)}
+            results = g.graph.run(loss, [loss, w1, w2], feed_dict=feed_dict)
+            weights = [results[1].numpy(force=True), results[2].numpy(force=True)]
+        os.environ.pop('HETU_ELEMENTWISE_FUSION')
+        return np.array(losses), weights
+
+    def test_fused_graph_matches_unfused_graph(self):
+        fused_losses, fused_weights = self.train(True)
+        unfused_losses, unfused_weights = self.train(False)
+        np.testing.assert_allclose(fused_losses, unfused_losses, rtol=1e-5, atol=1e-6)
+        for fused, unfused in zip(fused_weights, unfused_weights):
+            np.testing.assert_allclose(fused, unfused, rtol=1e-5, atol=1e-6)
+
+if __name__ == '__main__':
+    hetu.init_comm_group(1)
+    unittest.main()
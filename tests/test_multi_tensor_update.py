@@ -0,0 +1,65 @@
+import hetu
+import numpy as np
+import os
+import unittest
+
+class TestMultiTensorUpdate(unittest.TestCase):
+
+    # Trains a two-layer MLP and returns the losses of every step. The dense
+    # updates of its four parameters form one multi-tensor group on CPU
+    # unless HETU_MULTI_TENSOR_UPDATE=OFF.
+    def train(self, make_optimizer, multi_tensor, num_steps=4, seed=0):
+        os.environ['HETU_MULTI_TENSOR_UPDATE'] = 'ON' if multi_tensor else 'OFF'
+        rng = np.random.default_rng(seed)
+        local_device = hetu.local_device()
+        device_group = hetu.DeviceGroup([local_device])
+        ds_dup = hetu.DistributedStates(1, {-1: 1}, [-1])
+        n, dim, hidden = 8, 16, 32
+        g = hetu.graph('define_and_run')
+        with g:
+            x = hetu.placeholder(hetu.float32, [n, dim], ds=ds_dup, device_group=device_group, name='x')
+            y = hetu.placeholder(hetu.float32, [n, dim], ds=ds_dup, device_group=device_group, name='y')
+            def param(shape, name):
+                return hetu.Tensor(rng.normal(0, 0.5, shape), dtype=hetu.float32, requires_grad=True,
+                                   ds=ds_dup, device_group=device_group, name=name)
+            w1, b1 = param((dim, hidden), 'w1'), param((hidden,), 'b1')
+            w2, b2 = param((hidden, dim), 'w2'), param((dim,), 'b2')
+            h = hetu.relu(hetu.matmul(x, w1) + b1)
+            pred = hetu.sigmoid(hetu.matmul(h, w2) + b2)
+            loss = hetu.binary_cross_entropy(pred, y, 'mean', name='bce_loss')
+            train_op = make_optimizer().minimize(loss)
+            losses = []
+            for _ in range(num_steps):
+                feed_dict = {x: rng.normal(0, 1, (n, dim)), y: (rng.random((n, dim)) > 0.5).astype(np.float32)}
+                results = g.graph.run(loss, [loss, train_op], feed_dict=feed_dict)
+                losses.append(results[0].numpy(force=True))
+        os.environ.pop('HETU_MULTI_TENSOR_UPDATE')
+        return np.array(losses)
+
+    def check_equivalence(self, make_optimizer):
+        fused = self.train(make_optimizer, True)
+        unfused = self.train(make_optimizer, False)
+        np.testing.assert_allclose(fused, unfused, rtol=1e-5, atol=1e-6)
+
+    def test_sgd(self):
+        self.check_equivalence(lambda: hetu.SGDOptimizer(
+            init_lr=0.1, max_lr=0.1, min_lr=0.1, lr_warmup_steps=0,
+            lr_decay_steps=1000, lr_decay_style='constant'))
+
+    def test_momentum(self):
+        self.check_equivalence(lambda: hetu.SGDOptimizer(
+            init_lr=0.1, max_lr=0.1, min_lr=0.1, lr_warmup_steps=0,
+            lr_decay_steps=1000, lr_decay_style='constant', momentum=0.9,
+            nesterov=True))
+
+    def test_adam(self):
+        # the steps advance, so later bias corrections and the weight decay
+        # are covered as well
+        self.check_equivalence(lambda: hetu.AdamOptimizer(
+            init_lr=1e-2, max_lr=1e-2, min_lr=1e-2, lr_warmup_steps=0,
+            lr_decay_steps=1000, lr_decay_style='constant', start_wd=0.01,
+            end_wd=0.01))
+
+if __name__ == '__main__':
+    hetu.init_comm_group(1)
+    unittest.main()
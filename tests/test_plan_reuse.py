@@ -0,0 +1,57 @@
+import hetu
+import numpy as np
+import unittest
+
+class TestPlanReuse(unittest.TestCase):
+
+    def test_exec_and_shape_plans_are_reused(self):
+        local_device = hetu.local_device()
+        device_group = hetu.DeviceGroup([local_device])
+        ds_dup = hetu.DistributedStates(1, {-1: 1}, [-1])
+        g = hetu.graph('define_and_run')
+        with g:
+            n, dim = 8, 16
+            x = hetu.placeholder(hetu.float32, [n, dim], ds=ds_dup, device_group=device_group, name='x')
+            y = hetu.placeholder(hetu.float32, [n, dim], ds=ds_dup, device_group=device_group, name='y')
+            w = hetu.Tensor(np.random.normal(0, 1, (dim, dim)), dtype=hetu.float32, requires_grad=True,
+                            ds=ds_dup, device_group=device_group, name='w')
+            pred = hetu.sigmoid(hetu.matmul(x, w))
+            loss = hetu.binary_cross_entropy(pred, y, 'mean', name='bce_loss')
+            optimizer = hetu.SGDOptimizer(init_lr=0.1, max_lr=0.1, min_lr=0.1, lr_warmup_steps=0,
+                                           lr_decay_steps=1000, lr_decay_style='constant')
+            train_op = optimizer.minimize(loss)
+
+            def run(fetches, batch_size, y_first=False):
+                feed = [(x, np.random.normal(0, 1, (batch_size, dim))), (y, np.zeros((batch_size, dim)))]
+                if y_first:
+                    feed.reverse()
+                g.graph.run(loss, fetches, feed_dict=dict(feed))
+
+            def assert_plans(num_shape_plans):
+                self.assertEqual(g.graph.num_exec_plans(), len(num_shape_plans))
+                for i, num in enumerate(num_shape_plans):
+                    self.assertEqual(g.graph.num_shape_plans(i), num)
+
+            run([loss, train_op], n)
+            assert_plans([1])
+            # the same fetches in another order and the same shapes fed in
+            # another order reuse both plans
+            run([train_op, loss], n, y_first=True)
+            assert_plans([1])
+            # other shapes reuse the exec plan with a new shape plan, which
+            # is reused in turn, as is the first one
+            run([loss, train_op], n // 2)
+            assert_plans([2])
+            run([loss, train_op], n // 2, y_first=True)
+            run([loss, train_op], n)
+            assert_plans([2])
+            # fetches outside of the plan miss and add an exec plan
+            run([loss, w, train_op], n)
+            assert_plans([2, 1])
+            run([loss, train_op], n)
+            run([loss, w, train_op], n)
+            assert_plans([2, 1])
+
+if __name__ == '__main__':
+    hetu.init_comm_group(1)
+    unittest.main()
@@ -0,0 +1,38 @@
+import hetu
+import numpy as np
+import gc
+import sys
+import unittest
+
+class TestSequencePacking(unittest.TestCase):
+
+    _num_steps = 16
+
+    def test_pack_sequences_releases_inputs(self):
+        seqs = [np.arange(1, n + 1, dtype=np.int64) for n in (5, 17, 3, 9, 30)]
+        before = [sys.getrefcount(seq) for seq in seqs]
+        for _ in range(TestSequencePacking._num_steps):
+            packed, cu_seqlens = hetu.pack_sequences(seqs, 32, 0)
+            self.assertEqual(len(packed), len(cu_seqlens))
+            num_tokens = sum(int(np.count_nonzero(p)) for p in packed)
+            self.assertEqual(num_tokens, sum(seq.size for seq in seqs))
+            del packed, cu_seqlens
+        gc.collect()
+        after = [sys.getrefcount(seq) for seq in seqs]
+        self.assertEqual(before, after)
+
+    def test_bucket_and_pack_global_batch_releases_inputs(self):
+        global_batch = np.zeros((8, 64), dtype=np.int64)
+        for i, n in enumerate((10, 64, 33, 7, 50, 21, 64, 2)):
+            global_batch[i, :n] = np.arange(1, n + 1)
+        before = sys.getrefcount(global_batch)
+        for _ in range(TestSequencePacking._num_steps):
+            buckets = hetu.bucket_and_pack_global_batch(
+                global_batch, 0, [64, 16, 0], alignment=1)
+            self.assertEqual(len(buckets), 2)
+            del buckets
+        gc.collect()
+        self.assertEqual(before, sys.getrefcount(global_batch))
+
+if __name__ == '__main__':
+    unittest.main()